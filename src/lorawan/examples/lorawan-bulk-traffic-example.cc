@@ -0,0 +1,160 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+
+/*
+ * Generate periodic uplinks for a large number of end devices, either with a
+ * LoRaWANEndDeviceApplication and PacketSocket per end device
+ * (--useApplications=true) or with a single LoRaWANBulkTrafficGenerator for
+ * all end devices, and count the events that are scheduled.
+ *
+ * ./waf --run "lorawan-bulk-traffic-example --nEndDevices=10000 --useApplications=true"
+ * ./waf --run "lorawan-bulk-traffic-example --nEndDevices=10000 --useApplications=false"
+ */
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/lorawan-module.h>
+#include <ns3/system-wall-clock-ms.h>
+
+#include <iostream>
+
+#include "lorawan-counting-map-scheduler.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANBulkTrafficExample");
+
+static uint64_t g_nUplinks = 0;
+
+static void
+UplinkSent (uint32_t deviceAddr, uint8_t msgType, Ptr<const Packet> p)
+{
+  g_nUplinks++;
+}
+
+int main (int argc, char *argv[])
+{
+  uint32_t nEndDevices = 10000;
+  uint32_t nPackets = 3;
+  double period = 600.0;
+  double discRadius = 2000.0;
+  bool useApplications = false;
+
+  CommandLine cmd;
+  cmd.AddValue ("nEndDevices", "Number of end devices[Default:10000]", nEndDevices);
+  cmd.AddValue ("nPackets", "Number of uplinks sent by every end device[Default:3]", nPackets);
+  cmd.AddValue ("period", "Period between uplinks of an end device in seconds[Default:600]", period);
+  cmd.AddValue ("discRadius", "The radius of the disc (in meters) in which end devices are placed[Default:2000.0]", discRadius);
+  cmd.AddValue ("useApplications", "Install a LoRaWANEndDeviceApplication on every end device instead of a LoRaWANBulkTrafficGenerator[Default:false]", useApplications);
+  cmd.Parse (argc, argv);
+
+  ObjectFactory schedulerFactory;
+  schedulerFactory.SetTypeId (CountingMapScheduler::GetTypeId ());
+  Simulator::SetScheduler (schedulerFactory);
+
+  RngSeedManager::SetSeed (12345);
+  RngSeedManager::SetRun (1);
+
+  NodeContainer endDeviceNodes;
+  NodeContainer gatewayNodes;
+  endDeviceNodes.Create (nEndDevices);
+  gatewayNodes.Create (1);
+
+  Ptr<UniformDiscPositionAllocator> positionAllocator = CreateObject<UniformDiscPositionAllocator> ();
+  positionAllocator->SetRho (discRadius);
+  positionAllocator->AssignStreams (2000000);
+
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator (positionAllocator);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (endDeviceNodes);
+  mobility.Install (gatewayNodes);
+
+  LoRaWANHelper lorawanHelper;
+  lorawanHelper.SetNbRep (1);
+  NetDeviceContainer endDevices = lorawanHelper.Install (endDeviceNodes);
+  lorawanHelper.SetDeviceType (LORAWAN_DT_GATEWAY);
+  NetDeviceContainer gateways = lorawanHelper.Install (gatewayNodes);
+  lorawanHelper.AssignStreams (endDevices, 0);
+  lorawanHelper.AssignStreams (gateways, nEndDevices);
+
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (gatewayNodes);
+
+  LoRaWANNetworkServerHelper nsHelper;
+  Ptr<LoRaWANNetworkServer> networkServer = nsHelper.Create ();
+  ApplicationContainer gatewayApps = nsHelper.InstallGateways (networkServer, gatewayNodes);
+  gatewayApps.Start (Seconds (0.0));
+
+  const Time stopTime = Seconds (nPackets * period);
+  Ptr<LoRaWANBulkTrafficGenerator> generator;
+  if (useApplications)
+    {
+      packetSocket.Install (endDeviceNodes);
+
+      Ptr<UniformRandomVariable> offset = CreateObject<UniformRandomVariable> ();
+      offset->SetStream (1000000);
+      std::ostringstream iat;
+      iat << "ns3::ConstantRandomVariable[Constant=" << period << "]";
+      for (uint32_t i = 0; i < nEndDevices; i++)
+        {
+          Ptr<LoRaWANEndDeviceApplication> app = CreateObject<LoRaWANEndDeviceApplication> ();
+          app->SetAttribute ("DataRateIndex", UintegerValue (5));
+          app->SetAttribute ("UpstreamIAT", StringValue (iat.str ()));
+          app->TraceConnectWithoutContext ("USMsgTransmitted", MakeCallback (&UplinkSent));
+          endDeviceNodes.Get (i)->AddApplication (app);
+          app->SetStartTime (Seconds (offset->GetValue (0.0, period)));
+          app->SetStopTime (stopTime);
+        }
+    }
+  else
+    {
+      generator = CreateObject<LoRaWANBulkTrafficGenerator> ();
+      generator->SetAttribute ("Period", TimeValue (Seconds (period)));
+      generator->SetAttribute ("DataRateIndex", UintegerValue (5));
+      generator->AssignStreams (1000000);
+      generator->TraceConnectWithoutContext ("USMsgTransmitted", MakeCallback (&UplinkSent));
+      generator->Install (endDevices);
+      generator->Start (Seconds (0.0));
+      generator->Stop (stopTime);
+    }
+
+  // Do not count the events that set up the simulation
+  CountingMapScheduler::ResetNEvents ();
+
+  SystemWallClockMs clock;
+  clock.Start ();
+  Simulator::Stop (stopTime + Seconds (period));
+  Simulator::Run ();
+  int64_t elapsed = clock.End ();
+
+  std::cout << "end devices: " << nEndDevices
+            << ", traffic source: " << (useApplications ? "applications" : "bulk generator")
+            << ", uplinks: " << g_nUplinks
+            << ", events: " << CountingMapScheduler::GetNEvents ();
+  if (generator)
+    std::cout << ", generator events: " << generator->GetTimerWheel ().GetNEvents ();
+  std::cout << ", wall (ms): " << elapsed << std::endl;
+
+  generator = 0;
+  Simulator::Destroy ();
+
+  return 0;
+}
@@ -0,0 +1,190 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+
+/*
+ * Compare the cost of SingleModelSpectrumChannel and LoRaWANSpectrumChannel
+ * for an increasing number of end devices. Every end device sends a number of
+ * unconfirmed uplinks on a random channel. For every network size, the number
+ * of signal deliveries done by the channel (i.e. the number of path loss
+ * calculations) and the wall clock time of the simulation are printed.
+ * LoRaWANSpectrumChannel is run both without and with cached link gains (see
+ * the CacheLinkGains and MaxCachedLinks attributes).
+ *
+ * ./waf --run "lorawan-channel-benchmark --maxEndDevices=3200"
+ */
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/lorawan-module.h>
+#include <ns3/propagation-loss-model.h>
+#include <ns3/propagation-delay-model.h>
+#include <ns3/single-model-spectrum-channel.h>
+#include <ns3/system-wall-clock-ms.h>
+
+#include <iostream>
+#include <iomanip>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANChannelBenchmark");
+
+static uint64_t g_nDeliveries = 0;
+static uint64_t g_nReceived = 0;
+
+static void
+PathLoss (Ptr<SpectrumPhy> txPhy, Ptr<SpectrumPhy> rxPhy, double lossDb)
+{
+  g_nDeliveries++;
+}
+
+static bool
+GatewayReceive (Ptr<NetDevice> device, Ptr<const Packet> p, uint16_t protocol, const Address &from)
+{
+  g_nReceived++;
+  return true;
+}
+
+static void
+RunBenchmark (uint32_t nEndDevices, uint32_t nGateways, bool useLoRaWANChannel, bool cacheLinkGains, uint32_t maxCachedLinks, uint32_t nPackets, double period, double discRadius)
+{
+  RngSeedManager::SetSeed (12345);
+  RngSeedManager::SetRun (1);
+  g_nDeliveries = 0;
+  g_nReceived = 0;
+
+  NodeContainer endDeviceNodes;
+  NodeContainer gatewayNodes;
+  endDeviceNodes.Create (nEndDevices);
+  gatewayNodes.Create (nGateways);
+
+  // Use the same node positions for both channel types
+  Ptr<UniformDiscPositionAllocator> positionAllocator = CreateObject<UniformDiscPositionAllocator> ();
+  positionAllocator->SetRho (discRadius);
+  positionAllocator->AssignStreams (2000000);
+
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator (positionAllocator);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (endDeviceNodes);
+  mobility.Install (gatewayNodes);
+
+  LoRaWANHelper lorawanHelper;
+  if (!useLoRaWANChannel)
+    {
+      Ptr<SingleModelSpectrumChannel> channel = CreateObject<SingleModelSpectrumChannel> ();
+      channel->AddPropagationLossModel (CreateObject<LogDistancePropagationLossModel> ());
+      channel->SetPropagationDelayModel (CreateObject<ConstantSpeedPropagationDelayModel> ());
+      lorawanHelper.SetChannel (channel);
+    }
+  else
+    {
+      lorawanHelper.GetChannel ()->SetAttribute ("CacheLinkGains", BooleanValue (cacheLinkGains));
+      lorawanHelper.GetChannel ()->SetAttribute ("MaxCachedLinks", UintegerValue (maxCachedLinks));
+    }
+  lorawanHelper.GetChannel ()->TraceConnectWithoutContext ("PathLoss", MakeCallback (&PathLoss));
+  lorawanHelper.SetNbRep (1);
+
+  NetDeviceContainer endDevices = lorawanHelper.Install (endDeviceNodes);
+  lorawanHelper.SetDeviceType (LORAWAN_DT_GATEWAY);
+  NetDeviceContainer gateways = lorawanHelper.Install (gatewayNodes);
+  lorawanHelper.AssignStreams (endDevices, 0);
+  lorawanHelper.AssignStreams (gateways, nEndDevices);
+
+  for (NetDeviceContainer::Iterator it = gateways.Begin (); it != gateways.End (); ++it)
+    {
+      Ptr<LoRaWANNetDevice> gw = DynamicCast<LoRaWANNetDevice> (*it);
+      // Count at the net device, as GetMacs would build the macs and phys of
+      // every channel and data rate
+      gw->SetReceiveCallback (MakeCallback (&GatewayReceive));
+    }
+
+  Ptr<UniformRandomVariable> offset = CreateObject<UniformRandomVariable> ();
+  offset->SetStream (1000000);
+  Ptr<UniformRandomVariable> channelIndex = CreateObject<UniformRandomVariable> ();
+  channelIndex->SetStream (1000001);
+
+  for (NetDeviceContainer::Iterator it = endDevices.Begin (); it != endDevices.End (); ++it)
+    {
+      Ptr<LoRaWANNetDevice> dev = DynamicCast<LoRaWANNetDevice> (*it);
+      double start = offset->GetValue (0.0, period);
+      for (uint32_t i = 0; i < nPackets; i++)
+        {
+          LoRaWANDataRequestParams params;
+          params.m_loraWANChannelIndex = channelIndex->GetInteger (0, 2); // default EU868 uplink channels
+          params.m_loraWANDataRateIndex = 5;
+          params.m_loraWANCodeRate = 3;
+          params.m_msgType = LORAWAN_UNCONFIRMED_DATA_UP;
+          params.m_requestHandle = 1;
+          params.m_numberOfTransmissions = 1;
+
+          Simulator::Schedule (Seconds (start + i*period), &LoRaWANMac::sendMACPayloadRequest, dev->GetMac (), params, Create<Packet> (20));
+        }
+    }
+
+  SystemWallClockMs clock;
+  clock.Start ();
+  Simulator::Stop (Seconds ((nPackets + 1) * period));
+  Simulator::Run ();
+  int64_t elapsed = clock.End ();
+  Simulator::Destroy ();
+
+  std::string channelName = useLoRaWANChannel ? (cacheLinkGains ? "LoRaWANSpectrumChannel+cache" : "LoRaWANSpectrumChannel") : "SingleModelSpectrumChannel";
+  std::cout << std::setw (10) << nEndDevices
+            << std::setw (30) << channelName
+            << std::setw (14) << g_nDeliveries
+            << std::setw (10) << g_nReceived
+            << std::setw (12) << elapsed << std::endl;
+}
+
+int main (int argc, char *argv[])
+{
+  uint32_t minEndDevices = 100;
+  uint32_t maxEndDevices = 1600;
+  uint32_t nGateways = 1;
+  uint32_t nPackets = 2;
+  double period = 600.0;
+  double discRadius = 2000.0;
+  uint32_t maxCachedLinks = 0;
+
+  CommandLine cmd;
+  cmd.AddValue ("minEndDevices", "Number of end devices in the smallest network[Default:100]", minEndDevices);
+  cmd.AddValue ("maxEndDevices", "Number of end devices in the largest network[Default:1600]", maxEndDevices);
+  cmd.AddValue ("nGateways", "Number of LoRaWAN gateways [Default:1]", nGateways);
+  cmd.AddValue ("nPackets", "Number of uplinks sent by every end device[Default:2]", nPackets);
+  cmd.AddValue ("period", "Period between uplinks of an end device in seconds[Default:600]", period);
+  cmd.AddValue ("discRadius", "The radius of the disc (in meters) in which end devices and gateways are placed[Default:2000.0]", discRadius);
+  cmd.AddValue ("maxCachedLinks", "Maximum number of cached gateway links per transmitter, 0 to cache all links[Default:0]", maxCachedLinks);
+  cmd.Parse (argc, argv);
+
+  std::cout << std::setw (10) << "nodes"
+            << std::setw (30) << "channel"
+            << std::setw (14) << "deliveries"
+            << std::setw (10) << "received"
+            << std::setw (12) << "wall (ms)" << std::endl;
+
+  for (uint32_t n = minEndDevices; n <= maxEndDevices; n *= 2)
+    {
+      RunBenchmark (n, nGateways, false, false, 0, nPackets, period, discRadius);
+      RunBenchmark (n, nGateways, true, false, 0, nPackets, period, discRadius);
+      RunBenchmark (n, nGateways, true, true, maxCachedLinks, nPackets, period, discRadius);
+    }
+
+  return 0;
+}
@@ -0,0 +1,212 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+
+/*
+ * Actuator latency: the network server generates DS commands for actuators
+ * (--dsIAT seconds in between commands per actuator), which send an US
+ * status report every --usIAT seconds. The example runs the same scenario
+ * with Class A and with Class C actuators and prints the fraction of the
+ * DS commands that were received and the latency from the generation of a
+ * command at the network server until its reception by the actuator. Class A
+ * actuators only receive commands in the receive windows of their status
+ * reports, whereas the network server pushes commands to Class C actuators.
+ * All pushed commands share the RW2 channel and its duty cycle, which limits
+ * the number of commands per hour that a gateway can push.
+ *
+ * ./waf --run "lorawan-class-c-example --nEndDevices=20"
+ */
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/lorawan-module.h>
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANClassCExample");
+
+// Generation time of the DS commands, by the counter in their payload
+static std::map<uint64_t, Time> g_generated;
+static std::vector<double> g_latencies;
+
+// The DS payload ends with the counter, the end device still sees the frame
+// header in front of it
+static bool
+GetCounter (Ptr<const Packet> packet, uint64_t &counter)
+{
+  if (packet->GetSize () < sizeof (uint64_t))
+    return false;
+  packet->CreateFragment (packet->GetSize () - sizeof (uint64_t), sizeof (uint64_t))->CopyData ((uint8_t *)&counter, sizeof (uint64_t));
+  return true;
+}
+
+static void
+DSMsgGenerated (uint32_t deviceAddr, uint8_t txRemaining, uint8_t msgType, Ptr<const Packet> packet)
+{
+  uint64_t counter;
+  if (GetCounter (packet, counter))
+    g_generated[counter] = Simulator::Now ();
+}
+
+static void
+DSMsgReceived (uint32_t deviceAddr, uint8_t msgType, Ptr<const Packet> packet, uint8_t rw)
+{
+  uint64_t counter;
+  if (!GetCounter (packet, counter))
+    return;
+  std::map<uint64_t, Time>::iterator it = g_generated.find (counter);
+  if (it == g_generated.end ())
+    return;
+  g_latencies.push_back ((Simulator::Now () - it->second).GetSeconds ());
+  g_generated.erase (it);
+}
+
+static void
+CounterChanged (uint32_t *counter, uint32_t oldValue, uint32_t newValue)
+{
+  *counter = newValue;
+}
+
+static double
+Percentile (const std::vector<double> &sorted, double p)
+{
+  if (sorted.empty ())
+    return 0.0;
+  return sorted[std::min<size_t> (sorted.size () - 1, p * sorted.size ())];
+}
+
+static void
+RunActuators (LoRaWANDeviceType deviceType, uint32_t nEndDevices, uint32_t nGateways, double discRadius, double usIAT, double dsIAT, double duration)
+{
+  RngSeedManager::SetSeed (12345);
+  RngSeedManager::SetRun (1);
+
+  g_generated.clear ();
+  g_latencies.clear ();
+
+  NodeContainer endDeviceNodes;
+  NodeContainer gatewayNodes;
+  endDeviceNodes.Create (nEndDevices);
+  gatewayNodes.Create (nGateways);
+
+  Ptr<UniformDiscPositionAllocator> positionAllocator = CreateObject<UniformDiscPositionAllocator> ();
+  positionAllocator->SetRho (discRadius);
+  positionAllocator->AssignStreams (2000000);
+
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator (positionAllocator);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (endDeviceNodes);
+  mobility.Install (gatewayNodes);
+
+  LoRaWANHelper lorawanHelper;
+  lorawanHelper.SetNbRep (1);
+  lorawanHelper.SetDeviceType (deviceType);
+  NetDeviceContainer endDevices = lorawanHelper.Install (endDeviceNodes);
+  lorawanHelper.SetDeviceType (LORAWAN_DT_GATEWAY);
+  NetDeviceContainer gateways = lorawanHelper.Install (gatewayNodes);
+  lorawanHelper.AssignStreams (endDevices, 0);
+  lorawanHelper.AssignStreams (gateways, nEndDevices);
+
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (endDeviceNodes);
+  packetSocket.Install (gatewayNodes);
+
+  std::ostringstream dsIATString;
+  dsIATString << "ns3::ExponentialRandomVariable[Mean=" << dsIAT << "]";
+  LoRaWANNetworkServerHelper nsHelper;
+  nsHelper.SetAttribute ("GenerateDataDown", BooleanValue (true));
+  nsHelper.SetAttribute ("DownstreamIAT", StringValue (dsIATString.str ()));
+  Ptr<LoRaWANNetworkServer> networkServer = nsHelper.Create ();
+  networkServer->AssignStreams (1000002);
+  ApplicationContainer gatewayApps = nsHelper.InstallGateways (networkServer, gatewayNodes);
+  gatewayApps.Start (Seconds (0.0));
+  gatewayApps.Stop (Seconds (duration));
+  networkServer->TraceConnectWithoutContext ("DSMsgGenerated", MakeCallback (&DSMsgGenerated));
+
+  uint32_t nClassCSent = 0;
+  networkServer->TraceConnectWithoutContext ("nrClassCSent", MakeBoundCallback (&CounterChanged, &nClassCSent));
+
+  std::ostringstream usIATString;
+  usIATString << "ns3::ExponentialRandomVariable[Mean=" << usIAT << "]";
+  Ptr<UniformRandomVariable> start = CreateObject<UniformRandomVariable> ();
+  start->SetStream (1000000);
+  for (uint32_t i = 0; i < nEndDevices; i++)
+    {
+      Ptr<LoRaWANEndDeviceApplication> edApp = CreateObject<LoRaWANEndDeviceApplication> ();
+      edApp->SetAttribute ("UpstreamIAT", StringValue (usIATString.str ()));
+      edApp->TraceConnectWithoutContext ("DSMsgReceived", MakeCallback (&DSMsgReceived));
+      edApp->AssignStreams (3000000 + 3 * i);
+      endDeviceNodes.Get (i)->AddApplication (edApp);
+      edApp->SetStartTime (Seconds (start->GetValue (0.0, usIAT)));
+      edApp->SetStopTime (Seconds (duration));
+    }
+
+  Simulator::Stop (Seconds (duration));
+  Simulator::Run ();
+
+  std::sort (g_latencies.begin (), g_latencies.end ());
+  double meanLatency = 0.0;
+  for (double latency : g_latencies)
+    meanLatency += latency;
+  if (!g_latencies.empty ())
+    meanLatency /= g_latencies.size ();
+  const uint32_t nGenerated = g_latencies.size () + g_generated.size ();
+
+  std::cout << (deviceType == LORAWAN_DT_END_DEVICE_CLASS_C ? "Class C" : "Class A")
+            << " end devices: " << nEndDevices
+            << ", DS commands: " << nGenerated
+            << ", received: " << (nGenerated == 0 ? 0.0 : 100.0 * g_latencies.size () / nGenerated) << "%"
+            << ", pushed: " << nClassCSent
+            << ", latency (s) mean: " << meanLatency
+            << " p50: " << Percentile (g_latencies, 0.5)
+            << " p95: " << Percentile (g_latencies, 0.95)
+            << " max: " << (g_latencies.empty () ? 0.0 : g_latencies.back ()) << std::endl;
+
+  Simulator::Destroy ();
+}
+
+int main (int argc, char *argv[])
+{
+  uint32_t nEndDevices = 20;
+  uint32_t nGateways = 1;
+  double discRadius = 2000.0;
+  double usIAT = 600.0;
+  double dsIAT = 600.0;
+  double duration = 3600.0;
+
+  CommandLine cmd;
+  cmd.AddValue ("nEndDevices", "Number of actuators[Default:20]", nEndDevices);
+  cmd.AddValue ("nGateways", "Number of LoRaWAN gateways [Default:1]", nGateways);
+  cmd.AddValue ("discRadius", "The radius of the disc (in meters) in which end devices and gateways are placed[Default:2000.0]", discRadius);
+  cmd.AddValue ("usIAT", "Mean time in seconds in between the status reports of an actuator[Default:600]", usIAT);
+  cmd.AddValue ("dsIAT", "Mean time in seconds in between the commands for an actuator[Default:600]", dsIAT);
+  cmd.AddValue ("duration", "Duration of the simulation in seconds[Default:3600]", duration);
+  cmd.Parse (argc, argv);
+
+  RunActuators (LORAWAN_DT_END_DEVICE_CLASS_A, nEndDevices, nGateways, discRadius, usIAT, dsIAT, duration);
+  RunActuators (LORAWAN_DT_END_DEVICE_CLASS_C, nEndDevices, nGateways, discRadius, usIAT, dsIAT, duration);
+
+  return 0;
+}
@@ -0,0 +1,73 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#ifndef LORAWAN_COUNTING_MAP_SCHEDULER_H
+#define LORAWAN_COUNTING_MAP_SCHEDULER_H
+
+#include <ns3/map-scheduler.h>
+
+namespace ns3 {
+
+/**
+ * MapScheduler that counts the number of inserted events, shared by the
+ * examples that report the load on the simulator scheduler.
+ */
+class CountingMapScheduler : public MapScheduler
+{
+public:
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::LoRaWANExampleCountingMapScheduler")
+      .SetParent<MapScheduler> ()
+      .SetGroupName ("LoRaWAN")
+      .AddConstructor<CountingMapScheduler> ()
+    ;
+    return tid;
+  }
+
+  virtual void Insert (const Scheduler::Event &ev)
+  {
+    NEvents ()++;
+    MapScheduler::Insert (ev);
+  }
+
+  /**
+   * \return the number of events inserted since the last ResetNEvents
+   */
+  static uint64_t GetNEvents (void)
+  {
+    return NEvents ();
+  }
+
+  static void ResetNEvents (void)
+  {
+    NEvents () = 0;
+  }
+
+private:
+  static uint64_t &NEvents (void)
+  {
+    static uint64_t nEvents = 0;
+    return nEvents;
+  }
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_COUNTING_MAP_SCHEDULER_H */
@@ -0,0 +1,246 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+
+
+/*
+ * Measure the cost of verifying the MIC and decrypting the FRMPayload of US
+ * packets in the network server. US packets with a MIC and an encrypted
+ * FRMPayload of a large number of end devices are passed directly to the
+ * network server of a single gateway, so that no PHY or MAC events are
+ * involved. The US packets arrive at multiples of --arrivalResolution
+ * milliseconds, the network server verifies the MICs of the US packets that
+ * arrive at the same time in batches of --batchSize packets. --crypto selects
+ * AES-NI, the portable AES implementation, or no crypto at all.
+ *
+ * The MICs and the encryption of the US packets are computed before the
+ * simulation starts, at which point the MIC computation itself is timed one
+ * frame at a time and in batches.
+ *
+ * ./waf --run "lorawan-crypto-benchmark --nEndDevices=100000 --crypto=aesni --batchSize=64"
+ * ./waf --run "lorawan-crypto-benchmark --nEndDevices=100000 --crypto=portable --batchSize=1"
+ * ./waf --run "lorawan-crypto-benchmark --nEndDevices=100000 --crypto=none"
+ */
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/lorawan-module.h>
+#include <ns3/system-wall-clock-ms.h>
+
+#include <iostream>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANCryptoBenchmark");
+
+static const uint32_t g_frmPayloadSize = 8;
+static const uint32_t g_frameSize = 1 + 8 + g_frmPayloadSize; // MHDR, FHDR and FPort, FRMPayload
+
+/**
+ * An US data frame as sent by an end device: the MHDR and MACPayload, with
+ * the encrypted FRMPayload, and the MIC.
+ */
+typedef struct
+{
+  uint8_t m_frame[g_frameSize];
+  uint32_t m_mic;
+} BenchmarkFrame;
+
+static Ptr<LoRaWANNetworkServer> g_networkServer;
+static Ptr<LoRaWANGatewayApplication> g_gateway;
+static std::vector<BenchmarkFrame> g_frames;
+static uint32_t g_nPackets;
+static uint32_t g_nUSReceived;
+static uint32_t g_nMicFailures;
+static Time g_period;
+
+static void
+USMsgReceived (uint32_t deviceAddr, uint8_t msgType, Ptr<const Packet> p)
+{
+  g_nUSReceived++;
+}
+
+static void
+MicFailuresChanged (uint32_t oldValue, uint32_t newValue)
+{
+  g_nMicFailures = newValue;
+}
+
+static void
+BuildFrame (BenchmarkFrame &frame, uint32_t deviceAddr, uint16_t fCnt)
+{
+  uint8_t *bytes = frame.m_frame;
+  bytes[0] = LORAWAN_UNCONFIRMED_DATA_UP << 5;
+  for (uint32_t i = 0; i < 4; i++)
+    bytes[1 + i] = deviceAddr >> (8 * i);
+  bytes[5] = 0;
+  bytes[6] = fCnt;
+  bytes[7] = fCnt >> 8;
+  bytes[8] = 1;
+  for (uint32_t i = 0; i < g_frmPayloadSize; i++)
+    bytes[9 + i] = i;
+  frame.m_mic = 0;
+}
+
+/**
+ * Pass an US packet of an end device to the network server, as if the gateway
+ * received it, and schedule the next US packet.
+ */
+static void
+ReceiveUSPacket (uint32_t deviceIndex, uint32_t fCnt)
+{
+  const BenchmarkFrame &frame = g_frames[deviceIndex * g_nPackets + fCnt];
+  Ptr<Packet> packet = Create<Packet> (frame.m_frame + 1, g_frameSize - 1);
+
+  LoRaWANPhyParamsTag phyParamsTag;
+  phyParamsTag.SetChannelIndex (0);
+  phyParamsTag.SetDataRateIndex (5);
+  phyParamsTag.SetCodeRate (3);
+  packet->AddPacketTag (phyParamsTag);
+
+  LoRaWANMsgTypeTag msgTypeTag;
+  msgTypeTag.SetMsgType (LORAWAN_UNCONFIRMED_DATA_UP);
+  packet->AddPacketTag (msgTypeTag);
+  packet->AddPacketTag (LoRaWANMicTag (frame.m_mic));
+
+  g_networkServer->HandleUSPacket (g_gateway, Address (), packet);
+
+  if (fCnt + 1 < g_nPackets)
+    Simulator::Schedule (g_period, &ReceiveUSPacket, deviceIndex, fCnt + 1);
+}
+
+int main (int argc, char *argv[])
+{
+  uint32_t nEndDevices = 100000;
+  uint32_t nPackets = 10;
+  double period = 60.0;
+  double arrivalResolution = 10.0;
+  uint32_t batchSize = 64;
+  std::string crypto = "aesni";
+
+  CommandLine cmd;
+  cmd.AddValue ("nEndDevices", "Number of end devices[Default:100000]", nEndDevices);
+  cmd.AddValue ("nPackets", "Number of uplinks sent by every end device[Default:10]", nPackets);
+  cmd.AddValue ("period", "Period between uplinks of an end device in seconds[Default:60]", period);
+  cmd.AddValue ("arrivalResolution", "US packets arrive at multiples of this number of ms[Default:10]", arrivalResolution);
+  cmd.AddValue ("batchSize", "Maximum number of US packets of which the network server verifies the MICs at once[Default:64]", batchSize);
+  cmd.AddValue ("crypto", "aesni, portable or none[Default:aesni]", crypto);
+  cmd.Parse (argc, argv);
+
+  if (crypto != "aesni" && crypto != "portable" && crypto != "none") {
+    std::cerr << "Unknown crypto " << crypto << std::endl;
+    return 1;
+  }
+  if (crypto == "aesni" && !LoRaWANCrypto::HaveAesNi ())
+    std::cout << "The processor does not support AES-NI, using the portable AES implementation" << std::endl;
+  LoRaWANCrypto::SetUseAesNi (crypto == "aesni");
+
+  RngSeedManager::SetSeed (12345);
+  RngSeedManager::SetRun (1);
+
+  // Encrypt the US packets and compute their MICs with the default session
+  // keys that the network server also derives
+  g_nPackets = nPackets;
+  g_frames.resize (nEndDevices * nPackets);
+  std::vector<LoRaWANKey> nwkSKeys (nEndDevices);
+  std::vector<LoRaWANMicJob> jobs (g_frames.size ());
+  for (uint32_t i = 0; i < nEndDevices; i++) {
+    LoRaWANKey appSKey;
+    LoRaWANCrypto::DeriveDefaultSessionKeys (i + 1, nwkSKeys[i], appSKey);
+    for (uint32_t j = 0; j < nPackets; j++) {
+      const uint32_t k = i * nPackets + j;
+      BuildFrame (g_frames[k], i + 1, j);
+      LoRaWANCrypto::CryptFrame (nwkSKeys[i], appSKey, true, g_frames[k].m_frame, g_frameSize);
+      jobs[k].m_key = &nwkSKeys[i];
+      jobs[k].m_frame = g_frames[k].m_frame;
+      jobs[k].m_length = g_frameSize;
+      jobs[k].m_uplink = true;
+      jobs[k].m_mic = 0;
+    }
+  }
+
+  SystemWallClockMs clock;
+  clock.Start ();
+  for (uint32_t k = 0; k < jobs.size (); k++)
+    g_frames[k].m_mic = LoRaWANCrypto::ComputeFrameMic (*jobs[k].m_key, true, jobs[k].m_frame, jobs[k].m_length);
+  const int64_t singleElapsed = clock.End ();
+  clock.Start ();
+  for (uint32_t k = 0; k < jobs.size (); k += batchSize)
+    LoRaWANCrypto::ComputeFrameMics (&jobs[k], std::min<uint32_t> (batchSize, jobs.size () - k));
+  const int64_t batchElapsed = clock.End ();
+  for (uint32_t k = 0; k < jobs.size (); k++)
+    NS_ABORT_MSG_UNLESS (jobs[k].m_mic == g_frames[k].m_mic, "The MIC of a batch differs from the MIC of a single frame");
+
+  // A single gateway, the end devices only exist in the network server
+  NodeContainer gatewayNodes;
+  gatewayNodes.Create (1);
+
+  MobilityHelper mobility;
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (gatewayNodes);
+
+  LoRaWANHelper lorawanHelper;
+  lorawanHelper.SetDeviceType (LORAWAN_DT_GATEWAY);
+  lorawanHelper.Install (gatewayNodes);
+
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (gatewayNodes);
+
+  LoRaWANNetworkServerHelper nsHelper;
+  nsHelper.SetAttribute ("Crypto", BooleanValue (crypto != "none"));
+  nsHelper.SetAttribute ("CryptoBatchSize", UintegerValue (batchSize));
+  g_networkServer = nsHelper.Create ();
+  for (uint32_t i = 0; i < nEndDevices; i++)
+    g_networkServer->AddHomeEndDevice (Ipv4Address (i + 1));
+  ApplicationContainer gatewayApps = nsHelper.InstallGateways (g_networkServer, gatewayNodes);
+  g_gateway = DynamicCast<LoRaWANGatewayApplication> (gatewayApps.Get (0));
+  g_networkServer->TraceConnectWithoutContext ("USMsgReceived", MakeCallback (&USMsgReceived));
+  g_networkServer->TraceConnectWithoutContext ("nrUSMicFailures", MakeCallback (&MicFailuresChanged));
+
+  g_period = Seconds (period);
+  Ptr<UniformRandomVariable> offset = CreateObject<UniformRandomVariable> ();
+  offset->SetStream (1000000);
+  const uint64_t nSlots = std::max<uint64_t> (1, period * 1000 / arrivalResolution);
+  for (uint32_t i = 0; i < nEndDevices; i++) {
+    const uint64_t slot = offset->GetInteger (0, nSlots - 1);
+    Simulator::Schedule (MicroSeconds (slot * arrivalResolution * 1000), &ReceiveUSPacket, i, 0);
+  }
+
+  clock.Start ();
+  Simulator::Stop (Seconds ((nPackets + 1) * period));
+  Simulator::Run ();
+  const int64_t elapsed = clock.End ();
+
+  std::cout << "end devices: " << nEndDevices
+            << ", uplinks: " << g_frames.size ()
+            << ", crypto: " << crypto
+            << ", batch size: " << batchSize
+            << ", MIC single (ms): " << singleElapsed
+            << ", MIC batched (ms): " << batchElapsed
+            << ", received: " << g_nUSReceived
+            << ", MIC failures: " << g_nMicFailures
+            << ", wall (ms): " << elapsed << std::endl;
+
+  g_gateway = 0;
+  g_networkServer = 0;
+  Simulator::Destroy ();
+
+  return 0;
+}
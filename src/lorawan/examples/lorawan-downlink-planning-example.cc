@@ -0,0 +1,174 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+
+/*
+ * Compare the missed receive windows of the network server with and without
+ * downlink planning (see the PlanDownlinks attribute of
+ * LoRaWANNetworkServer) under a downlink heavy load. Every end device sends
+ * confirmed US packets, so that every US packet needs an ack. The US packets
+ * are passed directly to the network server, as if they were received by
+ * --nGatewaysPerUS random gateways with a random SNR. The acks are sent by
+ * the gateways.
+ *
+ * ./waf --run "lorawan-downlink-planning-example --planDownlinks=0"
+ * ./waf --run "lorawan-downlink-planning-example --planDownlinks=1"
+ */
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/lorawan-module.h>
+
+#include <iostream>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANDownlinkPlanningExample");
+
+static Ptr<LoRaWANNetworkServer> g_networkServer;
+static std::vector<Ptr<LoRaWANGatewayApplication> > g_gateways;
+static uint32_t g_nGatewaysPerUS;
+static Time g_period;
+static Ptr<UniformRandomVariable> g_random;
+
+static void
+CounterChanged (uint32_t *counter, uint32_t oldValue, uint32_t newValue)
+{
+  *counter = newValue;
+}
+
+/**
+ * Pass a confirmed US packet of an end device to the network server, as if
+ * several gateways received it, and schedule the next US packet.
+ */
+static void
+ReceiveUSPacket (uint32_t deviceAddr, uint32_t fCnt)
+{
+  const uint8_t channelIndex = g_random->GetInteger (0, 6);
+  const uint8_t dataRateIndex = g_random->GetInteger (0, 5);
+  const uint32_t firstGateway = g_random->GetInteger (0, g_gateways.size () - 1);
+  for (uint32_t k = 0; k < g_nGatewaysPerUS && k < g_gateways.size (); k++)
+    {
+      Ptr<Packet> packet = Create<Packet> (10);
+
+      LoRaWANFrameHeader fhdr;
+      fhdr.setDevAddr (Ipv4Address (deviceAddr));
+      fhdr.setFrameCounter (fCnt);
+      fhdr.setFramePort (1);
+      packet->AddHeader (fhdr);
+
+      LoRaWANPhyParamsTag phyParamsTag;
+      phyParamsTag.SetChannelIndex (channelIndex);
+      phyParamsTag.SetDataRateIndex (dataRateIndex);
+      phyParamsTag.SetCodeRate (1);
+      packet->AddPacketTag (phyParamsTag);
+
+      LoRaWANMsgTypeTag msgTypeTag;
+      msgTypeTag.SetMsgType (LORAWAN_CONFIRMED_DATA_UP);
+      packet->AddPacketTag (msgTypeTag);
+
+      LoRaWANRxMetadataTag rxMetadataTag;
+      rxMetadataTag.SetSnr (g_random->GetValue (-20.0, 10.0));
+      packet->AddPacketTag (rxMetadataTag);
+
+      g_networkServer->HandleUSPacket (g_gateways[(firstGateway + k) % g_gateways.size ()], Address (), packet);
+    }
+
+  Simulator::Schedule (g_period, &ReceiveUSPacket, deviceAddr, fCnt + 1);
+}
+
+int main (int argc, char *argv[])
+{
+  uint32_t nEndDevices = 1000;
+  uint32_t nGateways = 8;
+  uint32_t nGatewaysPerUS = 3;
+  double period = 600.0;
+  double duration = 3600.0;
+  bool planDownlinks = true;
+
+  CommandLine cmd;
+  cmd.AddValue ("nEndDevices", "Number of end devices[Default:1000]", nEndDevices);
+  cmd.AddValue ("nGateways", "Number of gateways[Default:8]", nGateways);
+  cmd.AddValue ("nGatewaysPerUS", "Number of gateways that receive a US packet[Default:3]", nGatewaysPerUS);
+  cmd.AddValue ("period", "Period between US packets of an end device in seconds[Default:600]", period);
+  cmd.AddValue ("duration", "Duration of the simulation in seconds[Default:3600]", duration);
+  cmd.AddValue ("planDownlinks", "Plan DS transmissions in the TX plans of the gateways[Default:true]", planDownlinks);
+  cmd.Parse (argc, argv);
+
+  RngSeedManager::SetSeed (12345);
+  RngSeedManager::SetRun (1);
+
+  NodeContainer gatewayNodes;
+  gatewayNodes.Create (nGateways);
+
+  MobilityHelper mobility;
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (gatewayNodes);
+
+  LoRaWANHelper lorawanHelper;
+  lorawanHelper.SetDeviceType (LORAWAN_DT_GATEWAY);
+  lorawanHelper.Install (gatewayNodes);
+
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (gatewayNodes);
+
+  LoRaWANNetworkServerHelper nsHelper;
+  nsHelper.SetAttribute ("PlanDownlinks", BooleanValue (planDownlinks));
+  g_networkServer = nsHelper.Create ();
+  for (uint32_t i = 0; i < nEndDevices; i++)
+    g_networkServer->AddHomeEndDevice (Ipv4Address (i + 1));
+  ApplicationContainer gatewayApps = nsHelper.InstallGateways (g_networkServer, gatewayNodes);
+  for (uint32_t i = 0; i < gatewayApps.GetN (); i++)
+    g_gateways.push_back (DynamicCast<LoRaWANGatewayApplication> (gatewayApps.Get (i)));
+
+  g_nGatewaysPerUS = nGatewaysPerUS;
+  g_period = Seconds (period);
+  g_random = CreateObject<UniformRandomVariable> ();
+  g_random->SetStream (1000001);
+
+  // The first US packet of an end device has frame counter 1, as frame
+  // counter 0 is taken as a duplicate during the first second
+  Ptr<UniformRandomVariable> offset = CreateObject<UniformRandomVariable> ();
+  offset->SetStream (1000000);
+  for (uint32_t i = 0; i < nEndDevices; i++)
+    Simulator::Schedule (Seconds (offset->GetValue (0.0, period)), &ReceiveUSPacket, i + 1, 1);
+
+  uint32_t nRW1Sent = 0, nRW2Sent = 0, nRW1Missed = 0, nRW2Missed = 0, nRW1Deferred = 0;
+  g_networkServer->TraceConnectWithoutContext ("nrRW1Sent", MakeBoundCallback (&CounterChanged, &nRW1Sent));
+  g_networkServer->TraceConnectWithoutContext ("nrRW2Sent", MakeBoundCallback (&CounterChanged, &nRW2Sent));
+  g_networkServer->TraceConnectWithoutContext ("nrRW1Missed", MakeBoundCallback (&CounterChanged, &nRW1Missed));
+  g_networkServer->TraceConnectWithoutContext ("nrRW2Missed", MakeBoundCallback (&CounterChanged, &nRW2Missed));
+  g_networkServer->TraceConnectWithoutContext ("nrRW1Deferred", MakeBoundCallback (&CounterChanged, &nRW1Deferred));
+
+  Simulator::Stop (Seconds (duration));
+  Simulator::Run ();
+
+  std::cout << "plan downlinks: " << planDownlinks
+            << ", RW1 sent: " << nRW1Sent
+            << ", RW2 sent: " << nRW2Sent
+            << ", RW1 missed: " << nRW1Missed
+            << ", RW1 deferred to RW2: " << nRW1Deferred
+            << ", RW2 missed: " << nRW2Missed << std::endl;
+
+  g_gateways.clear ();
+  g_networkServer = 0;
+  Simulator::Destroy ();
+
+  return 0;
+}
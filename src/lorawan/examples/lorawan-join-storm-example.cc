@@ -0,0 +1,184 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+
+/*
+ * Join storm: all end devices of a network boot within --bootWindow seconds
+ * (e.g. after a power outage) and join by over-the-air activation. Every end
+ * device uses a random data rate. JoinRequests collide and JoinAccepts are
+ * limited by the duty cycle of the gateways, so end devices retry with a
+ * growing random back-off (see the JoinBackoffBase and JoinBackoffMax
+ * attributes of LoRaWANEndDeviceApplication). For every number of end devices
+ * in --nEndDevices, the example prints the fraction of end devices that
+ * joined, the join throughput and the join latency.
+ *
+ * ./waf --run "lorawan-join-storm-example --nEndDevices=100,200,500,1000"
+ */
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/lorawan-module.h>
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANJoinStormExample");
+
+static std::vector<double> g_latencies;
+static uint64_t g_nJoinRequests = 0;
+
+static void
+Joined (uint32_t deviceAddr, Time latency, uint32_t nJoinRequests)
+{
+  g_latencies.push_back (latency.GetSeconds ());
+  g_nJoinRequests += nJoinRequests;
+}
+
+static void
+CounterChanged (uint32_t *counter, uint32_t oldValue, uint32_t newValue)
+{
+  *counter = newValue;
+}
+
+static double
+Percentile (const std::vector<double> &sorted, double p)
+{
+  if (sorted.empty ())
+    return 0.0;
+  return sorted[std::min<size_t> (sorted.size () - 1, p * sorted.size ())];
+}
+
+static void
+RunJoinStorm (uint32_t nEndDevices, uint32_t nGateways, double discRadius, double bootWindow, double duration)
+{
+  RngSeedManager::SetSeed (12345);
+  RngSeedManager::SetRun (1);
+
+  g_latencies.clear ();
+  g_nJoinRequests = 0;
+
+  NodeContainer endDeviceNodes;
+  NodeContainer gatewayNodes;
+  endDeviceNodes.Create (nEndDevices);
+  gatewayNodes.Create (nGateways);
+
+  Ptr<UniformDiscPositionAllocator> positionAllocator = CreateObject<UniformDiscPositionAllocator> ();
+  positionAllocator->SetRho (discRadius);
+  positionAllocator->AssignStreams (2000000);
+
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator (positionAllocator);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (endDeviceNodes);
+  mobility.Install (gatewayNodes);
+
+  LoRaWANHelper lorawanHelper;
+  lorawanHelper.SetNbRep (1);
+  NetDeviceContainer endDevices = lorawanHelper.Install (endDeviceNodes);
+  lorawanHelper.SetDeviceType (LORAWAN_DT_GATEWAY);
+  NetDeviceContainer gateways = lorawanHelper.Install (gatewayNodes);
+  lorawanHelper.AssignStreams (endDevices, 0);
+  lorawanHelper.AssignStreams (gateways, nEndDevices);
+
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (endDeviceNodes);
+  packetSocket.Install (gatewayNodes);
+
+  // End devices are not registered: the network server learns them from
+  // their JoinRequests
+  LoRaWANNetworkServerHelper nsHelper;
+  Ptr<LoRaWANNetworkServer> networkServer = nsHelper.Create ();
+  ApplicationContainer gatewayApps = nsHelper.InstallGateways (networkServer, gatewayNodes);
+  gatewayApps.Start (Seconds (0.0));
+  gatewayApps.Stop (Seconds (duration));
+
+  uint32_t nRejected = 0, nAccepts = 0;
+  networkServer->TraceConnectWithoutContext ("nrJoinRequestsRejected", MakeBoundCallback (&CounterChanged, &nRejected));
+  networkServer->TraceConnectWithoutContext ("nrJoinAcceptsSent", MakeBoundCallback (&CounterChanged, &nAccepts));
+
+  Ptr<UniformRandomVariable> boot = CreateObject<UniformRandomVariable> ();
+  boot->SetStream (1000000);
+  Ptr<UniformRandomVariable> dataRateIndex = CreateObject<UniformRandomVariable> ();
+  dataRateIndex->SetStream (1000001);
+
+  for (uint32_t i = 0; i < nEndDevices; i++)
+    {
+      Ptr<LoRaWANEndDeviceApplication> edApp = CreateObject<LoRaWANEndDeviceApplication> ();
+      edApp->SetAttribute ("OTAA", BooleanValue (true));
+      edApp->SetAttribute ("DataRateIndex", UintegerValue (dataRateIndex->GetInteger (0, 5)));
+      edApp->SetAttribute ("UpstreamIAT", StringValue ("ns3::ConstantRandomVariable[Constant=3600.0]"));
+      edApp->TraceConnectWithoutContext ("Joined", MakeCallback (&Joined));
+      edApp->AssignStreams (3000000 + 3 * i);
+      endDeviceNodes.Get (i)->AddApplication (edApp);
+      edApp->SetStartTime (Seconds (boot->GetValue (0.0, bootWindow)));
+      edApp->SetStopTime (Seconds (duration));
+    }
+
+  Simulator::Stop (Seconds (duration));
+  Simulator::Run ();
+
+  std::sort (g_latencies.begin (), g_latencies.end ());
+  double meanLatency = 0.0;
+  for (double latency : g_latencies)
+    meanLatency += latency;
+  if (!g_latencies.empty ())
+    meanLatency /= g_latencies.size ();
+  const double lastJoin = g_latencies.empty () ? 0.0 : g_latencies.back ();
+
+  std::cout << "end devices: " << nEndDevices
+            << ", joined: " << g_latencies.size ()
+            << " (" << 100.0 * g_latencies.size () / nEndDevices << "%)"
+            << ", joins/min: " << 60.0 * g_latencies.size () / duration
+            << ", JoinRequests/join: " << (g_latencies.empty () ? 0.0 : (double)g_nJoinRequests / g_latencies.size ())
+            << ", JoinAccepts: " << nAccepts
+            << ", replayed DevNonces: " << nRejected
+            << ", latency (s) mean: " << meanLatency
+            << " p50: " << Percentile (g_latencies, 0.5)
+            << " p95: " << Percentile (g_latencies, 0.95)
+            << " max: " << lastJoin << std::endl;
+
+  Simulator::Destroy ();
+}
+
+int main (int argc, char *argv[])
+{
+  std::string nEndDevices = "100,200,500,1000";
+  uint32_t nGateways = 1;
+  double discRadius = 2000.0;
+  double bootWindow = 10.0;
+  double duration = 3600.0;
+
+  CommandLine cmd;
+  cmd.AddValue ("nEndDevices", "Comma separated list of numbers of end devices[Default:100,200,500,1000]", nEndDevices);
+  cmd.AddValue ("nGateways", "Number of LoRaWAN gateways [Default:1]", nGateways);
+  cmd.AddValue ("discRadius", "The radius of the disc (in meters) in which end devices and gateways are placed[Default:2000.0]", discRadius);
+  cmd.AddValue ("bootWindow", "Period in seconds in which the end devices boot[Default:10]", bootWindow);
+  cmd.AddValue ("duration", "Duration of the simulation in seconds[Default:3600]", duration);
+  cmd.Parse (argc, argv);
+
+  std::istringstream counts (nEndDevices);
+  std::string count;
+  while (std::getline (counts, count, ','))
+    RunJoinStorm (std::stoul (count), nGateways, discRadius, bootWindow, duration);
+
+  return 0;
+}
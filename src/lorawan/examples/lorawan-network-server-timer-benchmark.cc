@@ -0,0 +1,165 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+
+
+/*
+ * Measure the load that the RW1, RW2 and DS timers of the network server put
+ * on the simulator scheduler. US packets of a large number of end devices are
+ * passed directly to the network server of a single gateway, so that no PHY
+ * or MAC events are involved. The network server keeps its timers in a timer
+ * wheel with a resolution of --timerResolution milliseconds, all timers that
+ * expire in the same tick share one simulator event. With
+ * --timerResolution=0, every timer is a simulator event.
+ *
+ * ./waf --run "lorawan-network-server-timer-benchmark --nEndDevices=100000 --timerResolution=0"
+ * ./waf --run "lorawan-network-server-timer-benchmark --nEndDevices=100000 --timerResolution=1"
+ */
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/lorawan-module.h>
+#include <ns3/system-wall-clock-ms.h>
+
+#include <iostream>
+
+#include "lorawan-counting-map-scheduler.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANNetworkServerTimerBenchmark");
+
+static Ptr<LoRaWANNetworkServer> g_networkServer;
+static Ptr<LoRaWANGatewayApplication> g_gateway;
+static uint32_t g_nPackets;
+static Time g_period;
+static Ptr<UniformRandomVariable> g_channelIndex;
+static Ptr<UniformRandomVariable> g_dataRateIndex;
+
+/**
+ * Pass an US packet of an end device to the network server, as if the gateway
+ * received it, and schedule the next US packet.
+ */
+static void
+ReceiveUSPacket (uint32_t deviceAddr, uint32_t fCnt)
+{
+  Ptr<Packet> packet = Create<Packet> (8);
+
+  LoRaWANFrameHeader fhdr;
+  fhdr.setDevAddr (Ipv4Address (deviceAddr));
+  fhdr.setFrameCounter (fCnt);
+  fhdr.setFramePort (1);
+  packet->AddHeader (fhdr);
+
+  LoRaWANPhyParamsTag phyParamsTag;
+  phyParamsTag.SetChannelIndex (g_channelIndex->GetInteger (0, 2));
+  phyParamsTag.SetDataRateIndex (g_dataRateIndex->GetInteger (0, 5));
+  phyParamsTag.SetCodeRate (3);
+  packet->AddPacketTag (phyParamsTag);
+
+  LoRaWANMsgTypeTag msgTypeTag;
+  msgTypeTag.SetMsgType (LORAWAN_UNCONFIRMED_DATA_UP);
+  packet->AddPacketTag (msgTypeTag);
+
+  g_networkServer->HandleUSPacket (g_gateway, Address (), packet);
+
+  if (fCnt + 1 < g_nPackets)
+    Simulator::Schedule (g_period, &ReceiveUSPacket, deviceAddr, fCnt + 1);
+}
+
+int main (int argc, char *argv[])
+{
+  uint32_t nEndDevices = 100000;
+  uint32_t nPackets = 10;
+  double period = 60.0;
+  double timerResolution = 1.0;
+
+  CommandLine cmd;
+  cmd.AddValue ("nEndDevices", "Number of end devices[Default:100000]", nEndDevices);
+  cmd.AddValue ("nPackets", "Number of uplinks sent by every end device[Default:10]", nPackets);
+  cmd.AddValue ("period", "Period between uplinks of an end device in seconds[Default:60]", period);
+  cmd.AddValue ("timerResolution", "Resolution of the timer wheel of the network server in ms, 0 disables the wheel[Default:1]", timerResolution);
+  cmd.Parse (argc, argv);
+
+  ObjectFactory schedulerFactory;
+  schedulerFactory.SetTypeId (CountingMapScheduler::GetTypeId ());
+  Simulator::SetScheduler (schedulerFactory);
+
+  RngSeedManager::SetSeed (12345);
+  RngSeedManager::SetRun (1);
+
+  // A single gateway, the end devices only exist in the network server
+  NodeContainer gatewayNodes;
+  gatewayNodes.Create (1);
+
+  MobilityHelper mobility;
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (gatewayNodes);
+
+  LoRaWANHelper lorawanHelper;
+  lorawanHelper.SetDeviceType (LORAWAN_DT_GATEWAY);
+  lorawanHelper.Install (gatewayNodes);
+
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (gatewayNodes);
+
+  LoRaWANNetworkServerHelper nsHelper;
+  nsHelper.SetAttribute ("TimerResolution", TimeValue (MicroSeconds (timerResolution * 1000)));
+  g_networkServer = nsHelper.Create ();
+  for (uint32_t i = 0; i < nEndDevices; i++)
+    g_networkServer->AddHomeEndDevice (Ipv4Address (i + 1));
+  ApplicationContainer gatewayApps = nsHelper.InstallGateways (g_networkServer, gatewayNodes);
+  g_gateway = DynamicCast<LoRaWANGatewayApplication> (gatewayApps.Get (0));
+
+  g_nPackets = nPackets;
+  g_period = Seconds (period);
+  g_channelIndex = CreateObject<UniformRandomVariable> ();
+  g_channelIndex->SetStream (1000001);
+  g_dataRateIndex = CreateObject<UniformRandomVariable> ();
+  g_dataRateIndex->SetStream (1000002);
+
+  Ptr<UniformRandomVariable> offset = CreateObject<UniformRandomVariable> ();
+  offset->SetStream (1000000);
+  for (uint32_t i = 0; i < nEndDevices; i++)
+    Simulator::Schedule (Seconds (offset->GetValue (0.0, period)), &ReceiveUSPacket, i + 1, 0);
+
+  // Do not count the events that set up the simulation
+  CountingMapScheduler::ResetNEvents ();
+
+  SystemWallClockMs clock;
+  clock.Start ();
+  Simulator::Stop (Seconds ((nPackets + 1) * period));
+  Simulator::Run ();
+  int64_t elapsed = clock.End ();
+
+  const LoRaWANTimerWheel &wheel = g_networkServer->GetTimerWheel ();
+  std::cout << "end devices: " << nEndDevices
+            << ", uplinks: " << nEndDevices * nPackets
+            << ", timer resolution (ms): " << timerResolution
+            << ", timers: " << wheel.GetNExpired ()
+            << ", timer events: " << wheel.GetNEvents ()
+            << ", events: " << CountingMapScheduler::GetNEvents ()
+            << ", wall (ms): " << elapsed << std::endl;
+
+  g_gateway = 0;
+  g_networkServer = 0;
+  Simulator::Destroy ();
+
+  return 0;
+}
@@ -0,0 +1,158 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+
+/*
+ * Count the number of events that are scheduled in a large LoRaWAN network.
+ * Every end device sends a number of unconfirmed uplinks on a random channel
+ * and with a random data rate. A gateway PHY only schedules an event for the
+ * signals it actually receives: signals with another data rate or that are
+ * not received for any other reason are removed from the interference
+ * without an event (see LoRaWANPhy::RemoveExpiredSignals). With
+ * --detachSleepingRx=true, end devices are not delivered any transmissions
+ * while their transceiver is off (see the DetachSleepingRx attribute of
+ * LoRaWANSpectrumChannel).
+ *
+ * ./waf --run "lorawan-scheduler-load-example --nEndDevices=5000"
+ */
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/lorawan-module.h>
+#include <ns3/system-wall-clock-ms.h>
+
+#include <iostream>
+
+#include "lorawan-counting-map-scheduler.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANSchedulerLoadExample");
+
+static uint64_t g_nReceived = 0;
+
+static bool
+GatewayReceive (Ptr<NetDevice> device, Ptr<const Packet> p, uint16_t protocol, const Address &from)
+{
+  g_nReceived++;
+  return true;
+}
+
+int main (int argc, char *argv[])
+{
+  uint32_t nEndDevices = 5000;
+  uint32_t nGateways = 1;
+  uint32_t nPackets = 1;
+  double period = 600.0;
+  double discRadius = 2000.0;
+  bool detachSleepingRx = false;
+
+  CommandLine cmd;
+  cmd.AddValue ("nEndDevices", "Number of end devices[Default:5000]", nEndDevices);
+  cmd.AddValue ("nGateways", "Number of LoRaWAN gateways [Default:1]", nGateways);
+  cmd.AddValue ("nPackets", "Number of uplinks sent by every end device[Default:1]", nPackets);
+  cmd.AddValue ("period", "Period between uplinks of an end device in seconds[Default:600]", period);
+  cmd.AddValue ("discRadius", "The radius of the disc (in meters) in which end devices and gateways are placed[Default:2000.0]", discRadius);
+  cmd.AddValue ("detachSleepingRx", "Do not deliver transmissions to end devices that are not listening[Default:false]", detachSleepingRx);
+  cmd.Parse (argc, argv);
+
+  ObjectFactory schedulerFactory;
+  schedulerFactory.SetTypeId (CountingMapScheduler::GetTypeId ());
+  Simulator::SetScheduler (schedulerFactory);
+
+  RngSeedManager::SetSeed (12345);
+  RngSeedManager::SetRun (1);
+
+  NodeContainer endDeviceNodes;
+  NodeContainer gatewayNodes;
+  endDeviceNodes.Create (nEndDevices);
+  gatewayNodes.Create (nGateways);
+
+  Ptr<UniformDiscPositionAllocator> positionAllocator = CreateObject<UniformDiscPositionAllocator> ();
+  positionAllocator->SetRho (discRadius);
+  positionAllocator->AssignStreams (2000000);
+
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator (positionAllocator);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (endDeviceNodes);
+  mobility.Install (gatewayNodes);
+
+  LoRaWANHelper lorawanHelper;
+  lorawanHelper.GetChannel ()->SetAttribute ("DetachSleepingRx", BooleanValue (detachSleepingRx));
+  lorawanHelper.SetNbRep (1);
+
+  NetDeviceContainer endDevices = lorawanHelper.Install (endDeviceNodes);
+  lorawanHelper.SetDeviceType (LORAWAN_DT_GATEWAY);
+  NetDeviceContainer gateways = lorawanHelper.Install (gatewayNodes);
+  lorawanHelper.AssignStreams (endDevices, 0);
+  lorawanHelper.AssignStreams (gateways, nEndDevices);
+
+  for (NetDeviceContainer::Iterator it = gateways.Begin (); it != gateways.End (); ++it)
+    {
+      Ptr<LoRaWANNetDevice> gw = DynamicCast<LoRaWANNetDevice> (*it);
+      // Count at the net device, as GetMacs would build the macs and phys of
+      // every channel and data rate
+      gw->SetReceiveCallback (MakeCallback (&GatewayReceive));
+    }
+
+  Ptr<UniformRandomVariable> offset = CreateObject<UniformRandomVariable> ();
+  offset->SetStream (1000000);
+  Ptr<UniformRandomVariable> channelIndex = CreateObject<UniformRandomVariable> ();
+  channelIndex->SetStream (1000001);
+  Ptr<UniformRandomVariable> dataRateIndex = CreateObject<UniformRandomVariable> ();
+  dataRateIndex->SetStream (1000002);
+
+  for (NetDeviceContainer::Iterator it = endDevices.Begin (); it != endDevices.End (); ++it)
+    {
+      Ptr<LoRaWANNetDevice> dev = DynamicCast<LoRaWANNetDevice> (*it);
+      double start = offset->GetValue (0.0, period);
+      for (uint32_t i = 0; i < nPackets; i++)
+        {
+          LoRaWANDataRequestParams params;
+          params.m_loraWANChannelIndex = channelIndex->GetInteger (0, 2); // default EU868 uplink channels
+          params.m_loraWANDataRateIndex = dataRateIndex->GetInteger (0, 5);
+          params.m_loraWANCodeRate = 3;
+          params.m_msgType = LORAWAN_UNCONFIRMED_DATA_UP;
+          params.m_requestHandle = 1;
+          params.m_numberOfTransmissions = 1;
+
+          Simulator::Schedule (Seconds (start + i*period), &LoRaWANMac::sendMACPayloadRequest, dev->GetMac (), params, Create<Packet> (20));
+        }
+    }
+
+  // Do not count the events that set up the simulation
+  CountingMapScheduler::ResetNEvents ();
+
+  SystemWallClockMs clock;
+  clock.Start ();
+  Simulator::Stop (Seconds ((nPackets + 1) * period));
+  Simulator::Run ();
+  int64_t elapsed = clock.End ();
+  Simulator::Destroy ();
+
+  std::cout << "end devices: " << nEndDevices
+            << ", gateways: " << nGateways
+            << ", uplinks: " << nEndDevices * nPackets
+            << ", received: " << g_nReceived
+            << ", events: " << CountingMapScheduler::GetNEvents ()
+            << ", wall (ms): " << elapsed << std::endl;
+
+  return 0;
+}
@@ -20,6 +20,7 @@
 
 #include "lorawan-helper.h"
 #include <ns3/lorawan-net-device.h>
+#include <ns3/lorawan-spectrum-channel.h>
 #include <ns3/simulator.h>
 #include <ns3/mobility-model.h>
 #include <ns3/single-model-spectrum-channel.h>
@@ -27,6 +28,11 @@
 #include <ns3/propagation-loss-model.h>
 #include <ns3/propagation-delay-model.h>
 #include <ns3/names.h>
+#include <ns3/config.h>
+#include <ns3/string.h>
+
+#include <algorithm>
+#include <sstream>
 
 namespace ns3 {
 
@@ -35,7 +41,7 @@ NS_LOG_COMPONENT_DEFINE ("LoRaWANHelper");
 /* ... */
 LoRaWANHelper::LoRaWANHelper (void) : m_deviceType (LORAWAN_DT_END_DEVICE_CLASS_A)
 {
-  m_channel = CreateObject<SingleModelSpectrumChannel> ();
+  m_channel = CreateObject<LoRaWANSpectrumChannel> ();
 
   Ptr<LogDistancePropagationLossModel> lossModel = CreateObject<LogDistancePropagationLossModel> ();
   m_channel->AddPropagationLossModel (lossModel);
@@ -85,6 +91,25 @@ LoRaWANHelper::SetNbRep (uint8_t nbRep)
   m_nbRep = nbRep;
 }
 
+void
+LoRaWANHelper::SetRegion (LoRaWANRegion region, uint8_t channelGroup)
+{
+  LoRaWAN::SetRegion (region, channelGroup);
+
+  size_t nUplinkChannels = 1;
+  for (uint8_t dr = 0; dr < LoRaWAN::m_supportedDataRates.size (); dr++)
+    nUplinkChannels = std::max (nUplinkChannels, LoRaWAN::GetUplinkChannels (dr).size ());
+  std::ostringstream channelRandomVariable;
+  channelRandomVariable << "ns3::UniformRandomVariable[Min=0|Max=" << nUplinkChannels - 1 << "]";
+  Config::SetDefault ("ns3::LoRaWANEndDeviceApplication::ChannelRandomVariable", StringValue (channelRandomVariable.str ()));
+}
+
+void
+LoRaWANHelper::SetRegion (LoRaWANRegion region)
+{
+  SetRegion (region, LoRaWAN::GetRegionProfile (region).m_defaultChannelGroup);
+}
+
 void
 LoRaWANHelper::EnableLogComponents (enum LogLevel level)
 {
@@ -100,6 +125,8 @@ LoRaWANHelper::EnableLogComponents (enum LogLevel level)
   LogComponentEnable ("LoRaWANNetDevice", level);
   LogComponentEnable ("LoRaWANInterferenceHelper", level);
   LogComponentEnable ("LoRaWANSpectrumSignalParameters", level);
+  LogComponentEnable ("LoRaWANSpectrumChannel", level);
+  LogComponentEnable ("LoRaWANGatewayPhy", level);
   LogComponentEnable ("LoRaWANEndDeviceApplication", level);
   LogComponentEnable ("LoRaWANFrameHeader", level);
 }
@@ -40,7 +40,7 @@ class LoRaWANHelper {
 public:
   /**
    * \brief Create a LoRaWAN helper in an empty state.  By default, a
-   * SingleModelSpectrumChannel is created, with a 
+   * LoRaWANSpectrumChannel is created, with a
    * LogDistancePropagationLossModel and a ConstantSpeedPropagationDelayModel.
    *
    * To change the channel type, loss model, or delay model, the Get/Set
@@ -95,6 +95,23 @@ public:
    */
   void SetNbRep (uint8_t rep);
 
+  /**
+   * \brief Use the channels, data rates and sub bands of a LoRaWAN region,
+   * see LoRaWAN::SetRegion. Also sets the default of the ChannelRandomVariable
+   * attribute of LoRaWANEndDeviceApplication to the uplink channels of the
+   * region. Should be called before devices and applications are created.
+   * \param region the region
+   * \param channelGroup the group of eight 125 kHz uplink channels (and one
+   * 500 kHz uplink channel) used in US915 and AU915
+   */
+  static void SetRegion (LoRaWANRegion region, uint8_t channelGroup);
+
+  /**
+   * \brief Use a LoRaWAN region with its default channel group
+   * \param region the region
+   */
+  static void SetRegion (LoRaWANRegion region);
+
   /**
    * \brief Install a LoRaWANNetDevice and the associated structures (e.g., channel) in the nodes.
    * \param c a set of nodes
@@ -0,0 +1,84 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include "lorawan-network-server-helper.h"
+#include <ns3/lorawan-net-device.h>
+#include <ns3/ipv4-address.h>
+#include <ns3/log.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANNetworkServerHelper");
+
+LoRaWANNetworkServerHelper::LoRaWANNetworkServerHelper (void)
+{
+  m_factory.SetTypeId ("ns3::LoRaWANNetworkServer");
+}
+
+void
+LoRaWANNetworkServerHelper::SetAttribute (std::string name, const AttributeValue &value)
+{
+  m_factory.Set (name, value);
+}
+
+Ptr<LoRaWANNetworkServer>
+LoRaWANNetworkServerHelper::Create (void) const
+{
+  Ptr<LoRaWANNetworkServer> networkServer = m_factory.Create<LoRaWANNetworkServer> ();
+  networkServer->Initialize ();
+  return networkServer;
+}
+
+ApplicationContainer
+LoRaWANNetworkServerHelper::InstallGateways (Ptr<LoRaWANNetworkServer> networkServer, NodeContainer c) const
+{
+  ApplicationContainer apps;
+  for (NodeContainer::Iterator i = c.Begin (); i != c.End (); i++)
+    {
+      Ptr<LoRaWANGatewayApplication> app = CreateObject<LoRaWANGatewayApplication> ();
+      app->SetNetworkServer (networkServer);
+      (*i)->AddApplication (app);
+      apps.Add (app);
+    }
+  return apps;
+}
+
+void
+LoRaWANNetworkServerHelper::AddEndDevices (Ptr<LoRaWANNetworkServer> networkServer, NodeContainer c) const
+{
+  for (NodeContainer::Iterator i = c.Begin (); i != c.End (); i++)
+    {
+      Address devAddr = (*i)->GetDevice (0)->GetAddress ();
+      if (!Ipv4Address::IsMatchingType (devAddr))
+        {
+          NS_LOG_ERROR ("Node " << (*i)->GetId () << " does not have a LoRaWAN device address");
+          continue;
+        }
+      networkServer->AddHomeEndDevice (Ipv4Address::ConvertFrom (devAddr));
+    }
+}
+
+void
+LoRaWANNetworkServerHelper::EnableRoaming (Ptr<LoRaWANNetworkServer> networkServer1, Ptr<LoRaWANNetworkServer> networkServer2)
+{
+  networkServer1->AddRoamingPartner (networkServer2);
+  networkServer2->AddRoamingPartner (networkServer1);
+}
+
+}
@@ -0,0 +1,87 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#ifndef LORAWAN_NETWORK_SERVER_HELPER_H
+#define LORAWAN_NETWORK_SERVER_HELPER_H
+
+#include <ns3/lorawan.h>
+#include <ns3/lorawan-gateway-application.h>
+#include <ns3/object-factory.h>
+#include <ns3/node-container.h>
+#include <ns3/application-container.h>
+
+namespace ns3 {
+
+/**
+ * \brief helps to create LoRaWANNetworkServer objects and to attach gateways
+ * and end devices to them
+ *
+ * Every network server serves its own gateways and end devices, which allows
+ * to simulate several networks that share the spectrum. Network servers that
+ * are roaming partners forward US packets to each other, so that a network
+ * can also be split over several network servers.
+ */
+class LoRaWANNetworkServerHelper {
+public:
+  LoRaWANNetworkServerHelper (void);
+
+  /**
+   * \brief Set an attribute of the LoRaWANNetworkServer objects created by this helper
+   * \param name the name of the attribute
+   * \param value the value of the attribute
+   */
+  void SetAttribute (std::string name, const AttributeValue &value);
+
+  /**
+   * \brief Create a network server
+   * \returns the network server
+   */
+  Ptr<LoRaWANNetworkServer> Create (void) const;
+
+  /**
+   * \brief Install a LoRaWANGatewayApplication that is attached to a network
+   * server on every gateway node
+   * \param networkServer the network server
+   * \param c a set of gateway nodes with a LoRaWANNetDevice
+   * \returns A container holding the gateway applications.
+   */
+  ApplicationContainer InstallGateways (Ptr<LoRaWANNetworkServer> networkServer, NodeContainer c) const;
+
+  /**
+   * \brief Make a network server the home network server of a set of end
+   * devices, see LoRaWANNetworkServer::AddHomeEndDevice. This should be done
+   * before the simulation starts.
+   * \param networkServer the network server
+   * \param c a set of end device nodes with a LoRaWANNetDevice
+   */
+  void AddEndDevices (Ptr<LoRaWANNetworkServer> networkServer, NodeContainer c) const;
+
+  /**
+   * \brief Make two network servers roaming partners of each other, see
+   * LoRaWANNetworkServer::AddRoamingPartner
+   */
+  static void EnableRoaming (Ptr<LoRaWANNetworkServer> networkServer1, Ptr<LoRaWANNetworkServer> networkServer2);
+
+private:
+  ObjectFactory m_factory; //!< factory for the network servers
+};
+
+}
+
+#endif /* LORAWAN_NETWORK_SERVER_HELPER_H */
@@ -0,0 +1,90 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include "lorawan-radio-energy-model-helper.h"
+#include <ns3/lorawan-net-device.h>
+#include <ns3/log.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANRadioEnergyModelHelper");
+
+LoRaWANRadioEnergyModelHelper::LoRaWANRadioEnergyModelHelper ()
+{
+  m_radioEnergy.SetTypeId ("ns3::LoRaWANRadioEnergyModel");
+  m_depletionCallback.Nullify ();
+  m_rechargedCallback.Nullify ();
+}
+
+LoRaWANRadioEnergyModelHelper::~LoRaWANRadioEnergyModelHelper ()
+{
+}
+
+void
+LoRaWANRadioEnergyModelHelper::Set (std::string name, const AttributeValue &v)
+{
+  m_radioEnergy.Set (name, v);
+}
+
+void
+LoRaWANRadioEnergyModelHelper::SetDepletionCallback (LoRaWANRadioEnergyModel::LoRaWANRadioEnergyCallback callback)
+{
+  m_depletionCallback = callback;
+}
+
+void
+LoRaWANRadioEnergyModelHelper::SetRechargedCallback (LoRaWANRadioEnergyModel::LoRaWANRadioEnergyCallback callback)
+{
+  m_rechargedCallback = callback;
+}
+
+DeviceEnergyModelContainer
+LoRaWANRadioEnergyModelHelper::Install (NetDeviceContainer devices) const
+{
+  DeviceEnergyModelContainer container;
+  for (NetDeviceContainer::Iterator it = devices.Begin (); it != devices.End (); ++it)
+    container.Add (DoInstall (*it, 0));
+  return container;
+}
+
+Ptr<DeviceEnergyModel>
+LoRaWANRadioEnergyModelHelper::DoInstall (Ptr<NetDevice> device,
+                                          Ptr<EnergySource> source) const
+{
+  NS_ASSERT (device != NULL);
+  Ptr<LoRaWANNetDevice> lorawanDevice = DynamicCast<LoRaWANNetDevice> (device);
+  if (!lorawanDevice)
+    NS_FATAL_ERROR ("NetDevice type is not LoRaWANNetDevice!");
+  if (lorawanDevice->GetDeviceType () == LORAWAN_DT_GATEWAY)
+    NS_FATAL_ERROR ("The LoRaWANRadioEnergyModel is only defined for end devices");
+
+  Ptr<LoRaWANRadioEnergyModel> model = m_radioEnergy.Create<LoRaWANRadioEnergyModel> ();
+  if (source)
+    {
+      model->SetEnergySource (source);
+      source->AppendDeviceEnergyModel (model);
+    }
+  model->SetEnergyDepletionCallback (m_depletionCallback);
+  model->SetEnergyRechargedCallback (m_rechargedCallback);
+  model->SetPhy (lorawanDevice->GetPhy ());
+  device->AggregateObject (model);
+  return model;
+}
+
+} // namespace ns3
@@ -0,0 +1,81 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#ifndef LORAWAN_RADIO_ENERGY_MODEL_HELPER_H
+#define LORAWAN_RADIO_ENERGY_MODEL_HELPER_H
+
+#include <ns3/energy-model-helper.h>
+#include <ns3/lorawan-radio-energy-model.h>
+
+namespace ns3 {
+
+/**
+ * \ingroup lorawan
+ *
+ * \brief Installs a LoRaWANRadioEnergyModel on LoRaWAN end device net
+ * devices, either with an EnergySource (see DeviceEnergyModelHelper::Install)
+ * or without one. The model is also aggregated to the net device.
+ */
+class LoRaWANRadioEnergyModelHelper : public DeviceEnergyModelHelper
+{
+public:
+  LoRaWANRadioEnergyModelHelper ();
+  ~LoRaWANRadioEnergyModelHelper ();
+
+  /**
+   * \param name the name of the attribute to set
+   * \param v the value of the attribute
+   *
+   * Sets an attribute of the LoRaWANRadioEnergyModel objects created by this helper.
+   */
+  void Set (std::string name, const AttributeValue &v);
+
+  /**
+   * \param callback Callback function for energy depletion handling.
+   */
+  void SetDepletionCallback (LoRaWANRadioEnergyModel::LoRaWANRadioEnergyCallback callback);
+
+  /**
+   * \param callback Callback function for energy recharged handling.
+   */
+  void SetRechargedCallback (LoRaWANRadioEnergyModel::LoRaWANRadioEnergyCallback callback);
+
+  using DeviceEnergyModelHelper::Install;
+
+  /**
+   * \param devices the LoRaWAN end device net devices
+   * \returns the installed LoRaWANRadioEnergyModels
+   *
+   * Installs a LoRaWANRadioEnergyModel without an EnergySource on each net
+   * device: the models only keep track of the consumed charge and energy.
+   */
+  DeviceEnergyModelContainer Install (NetDeviceContainer devices) const;
+
+private:
+  virtual Ptr<DeviceEnergyModel> DoInstall (Ptr<NetDevice> device,
+                                            Ptr<EnergySource> source) const;
+
+  ObjectFactory m_radioEnergy;
+  LoRaWANRadioEnergyModel::LoRaWANRadioEnergyCallback m_depletionCallback;
+  LoRaWANRadioEnergyModel::LoRaWANRadioEnergyCallback m_rechargedCallback;
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_RADIO_ENERGY_MODEL_HELPER_H */
@@ -0,0 +1,154 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include "lorawan-adr.h"
+#include "lorawan.h"
+#include <ns3/log.h>
+#include <cmath>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANAdr");
+
+LoRaWANAdrHistory::LoRaWANAdrHistory () : m_maxHead(0), m_maxSize(0), m_nSamples(0) {}
+
+void
+LoRaWANAdrHistory::SetCapacity (uint32_t capacity)
+{
+  m_snr.assign (capacity, 0.0);
+  m_maxSeq.assign (capacity, 0);
+  Clear ();
+}
+
+uint32_t
+LoRaWANAdrHistory::GetCapacity (void) const
+{
+  return m_snr.size ();
+}
+
+uint32_t
+LoRaWANAdrHistory::GetSize (void) const
+{
+  return m_nSamples < m_snr.size () ? m_nSamples : m_snr.size ();
+}
+
+bool
+LoRaWANAdrHistory::IsFull (void) const
+{
+  return !m_snr.empty () && m_nSamples >= m_snr.size ();
+}
+
+void
+LoRaWANAdrHistory::Clear (void)
+{
+  m_maxHead = 0;
+  m_maxSize = 0;
+  m_nSamples = 0;
+}
+
+void
+LoRaWANAdrHistory::Add (double snr)
+{
+  const uint32_t capacity = m_snr.size ();
+  NS_ASSERT (capacity > 0);
+
+  const uint32_t seq = m_nSamples++;
+
+  // The sample that drops out of the history can only be the first element
+  // of the max queue
+  if (m_maxSize > 0 && seq - m_maxSeq [m_maxHead] >= capacity) {
+    m_maxHead = (m_maxHead + 1) % capacity;
+    m_maxSize--;
+  }
+
+  m_snr [seq % capacity] = snr;
+
+  // Samples that are not larger than the new sample can never be the maximum
+  while (m_maxSize > 0 && m_snr [m_maxSeq [(m_maxHead + m_maxSize - 1) % capacity] % capacity] <= snr)
+    m_maxSize--;
+
+  m_maxSeq [(m_maxHead + m_maxSize) % capacity] = seq;
+  m_maxSize++;
+}
+
+void
+LoRaWANAdrHistory::UpdateLast (double snr)
+{
+  if (m_nSamples == 0) {
+    Add (snr);
+    return;
+  }
+
+  const uint32_t capacity = m_snr.size ();
+  const uint32_t seq = m_nSamples - 1;
+  if (snr <= m_snr [seq % capacity])
+    return;
+
+  // The last sample is always the last element of the max queue
+  m_snr [seq % capacity] = snr;
+  m_maxSize--;
+  while (m_maxSize > 0 && m_snr [m_maxSeq [(m_maxHead + m_maxSize - 1) % capacity] % capacity] <= snr)
+    m_maxSize--;
+
+  m_maxSeq [(m_maxHead + m_maxSize) % capacity] = seq;
+  m_maxSize++;
+}
+
+double
+LoRaWANAdrHistory::GetMaxSnr (void) const
+{
+  NS_ASSERT (m_maxSize > 0);
+  return m_snr [m_maxSeq [m_maxHead] % m_snr.size ()];
+}
+
+bool
+LoRaWANAdr::GetLinkAdrSettings (double maxSnr, double installationMargin, uint8_t &dataRateIndex, uint8_t &txPowerIndex)
+{
+  const double margin = maxSnr - LoRaWAN::GetDemodulationFloor (dataRateIndex) - installationMargin;
+  int nStep = std::floor (margin / 3.0);
+
+  // The highest data rate and the lowest TX power depend on the region, e.g.
+  // DR3 (SF7 at 125 kHz) in US915
+  const LoRaWANRegionProfile &profile = LoRaWAN::GetRegionProfile (LoRaWAN::GetRegion ());
+  const uint8_t maxDataRateIndex = profile.m_maxAdrDataRateIndex;
+  uint8_t newDataRateIndex = dataRateIndex;
+  uint8_t newTxPowerIndex = txPowerIndex;
+  while (nStep > 0 && newDataRateIndex < maxDataRateIndex) {
+    newDataRateIndex++;
+    nStep--;
+  }
+  while (nStep > 0 && newTxPowerIndex < profile.m_maxTxPowerIndex) {
+    newTxPowerIndex++;
+    nStep--;
+  }
+  while (nStep < 0 && newTxPowerIndex > 0) {
+    newTxPowerIndex--;
+    nStep++;
+  }
+
+  NS_LOG_DEBUG ("Link margin " << margin << " dB: DR" << (uint32_t)dataRateIndex << " -> DR" << (uint32_t)newDataRateIndex
+                << ", TX power index " << (uint32_t)txPowerIndex << " -> " << (uint32_t)newTxPowerIndex);
+
+  bool changed = newDataRateIndex != dataRateIndex || newTxPowerIndex != txPowerIndex;
+  dataRateIndex = newDataRateIndex;
+  txPowerIndex = newTxPowerIndex;
+  return changed;
+}
+
+} // namespace ns3
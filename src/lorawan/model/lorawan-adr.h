@@ -0,0 +1,124 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#ifndef LORAWAN_ADR_H
+#define LORAWAN_ADR_H
+
+#include <stdint.h>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup lorawan
+ *
+ * The SNRs of the last N US transmissions of an end device, as kept by the
+ * network server for adaptive data rate. The samples are stored in a ring
+ * buffer of N elements. The maximum SNR over the buffer is tracked with a
+ * queue of decreasing SNRs (also a ring buffer), so that adding a sample and
+ * getting the maximum are both amortized O(1).
+ */
+class LoRaWANAdrHistory
+{
+public:
+  LoRaWANAdrHistory ();
+
+  /**
+   * Set the number of samples kept and clear the history. No memory is used
+   * until the capacity is set.
+   *
+   * \param capacity the number of samples
+   */
+  void SetCapacity (uint32_t capacity);
+  uint32_t GetCapacity (void) const;
+
+  /**
+   * \return the number of samples in the history
+   */
+  uint32_t GetSize (void) const;
+
+  /**
+   * \return whether the history holds capacity samples
+   */
+  bool IsFull (void) const;
+
+  void Clear (void);
+
+  /**
+   * Add the SNR of a new US transmission. The oldest sample is dropped when
+   * the history is full.
+   *
+   * \param snr the SNR in dB
+   */
+  void Add (double snr);
+
+  /**
+   * Update the SNR of the last US transmission when another gateway received
+   * it with a higher SNR. Adds a sample when the history is empty.
+   *
+   * \param snr the SNR in dB
+   */
+  void UpdateLast (double snr);
+
+  /**
+   * \return the maximum SNR in the history, the history should not be empty
+   */
+  double GetMaxSnr (void) const;
+
+private:
+  std::vector<double> m_snr;       //!< ring buffer of samples, indexed by sequence number modulo capacity
+  std::vector<uint32_t> m_maxSeq;  //!< ring buffer of sequence numbers of samples with decreasing SNR
+  uint32_t m_maxHead;              //!< index of the first element of m_maxSeq
+  uint32_t m_maxSize;              //!< number of elements in m_maxSeq
+  uint32_t m_nSamples;             //!< number of samples added since the last Clear
+};
+
+/**
+ * \ingroup lorawan
+ *
+ * The adaptive data rate algorithm of the network server. The link margin of
+ * an end device is the maximum SNR of its last US transmissions above the
+ * demodulation floor of the current data rate (see
+ * LoRaWAN::GetDemodulationFloor), minus an installation margin. Every 3 dB of
+ * margin is used to first increase the data rate up to
+ * LoRaWANRegionProfile::m_maxAdrDataRateIndex and then to decrease the TX
+ * power down to LoRaWANRegionProfile::m_maxTxPowerIndex. A negative margin
+ * increases the TX power up to the maximum. The data rate is never decreased.
+ * In LoRaWAN the end device does that itself when it stops receiving DS
+ * frames (ADRACKReq and ADR_ACK_LIMIT), but that back-off is not modelled, so
+ * an end device keeps the data rate that ADR assigned.
+ */
+class LoRaWANAdr
+{
+public:
+  /**
+   * Get the data rate and TX power of an end device.
+   *
+   * \param maxSnr the maximum SNR of the last US transmissions in dB
+   * \param installationMargin the installation margin in dB
+   * \param dataRateIndex the current data rate index, updated on return
+   * \param txPowerIndex the current TX power index, updated on return
+   * \return whether the data rate or TX power changed
+   */
+  static bool GetLinkAdrSettings (double maxSnr, double installationMargin, uint8_t &dataRateIndex, uint8_t &txPowerIndex);
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_ADR_H */
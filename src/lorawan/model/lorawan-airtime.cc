@@ -0,0 +1,116 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include "lorawan-airtime.h"
+#include "lorawan.h"
+#include <ns3/log.h>
+#include <cmath>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANAirtime");
+
+// SF7, 125 kHz, CR 4/5, 20 byte payload, 8 preamble symbols, CRC and explicit
+// header: 43 payload symbols and 56.576 ms (Semtech LoRa calculator)
+static_assert (LoRaWANAirtime::CalculatePayloadSymbols (20, 7, 1, true, false) == 43, "Wrong number of payload symbols");
+static_assert (LoRaWANAirtime::CalculateTimeOnAirNs (20, 7, 125000, 1, 8, true, false) == 56576000, "Wrong time on air");
+
+LoRaWANAirtime::AirtimeTable::AirtimeTable ()
+{
+  m_region = LoRaWAN::GetRegion ();
+  const uint32_t nDataRates = LoRaWAN::m_supportedDataRates.size ();
+  m_payloadSymbols.resize (GetIndex (nDataRates, 1, 0, false, false));
+  m_quarterSymbolNs.resize (nDataRates);
+  m_nominalDataRate.resize (nDataRates);
+
+  for (uint8_t dr = 0; dr < nDataRates; dr++)
+    {
+      const uint8_t sf = LoRaWAN::m_supportedDataRates [dr].spreadingFactor;
+      const uint32_t bandwidth = LoRaWAN::m_supportedDataRates [dr].bandWith;
+      if (bandwidth == 0) // RFU data rate
+        continue;
+
+      m_quarterSymbolNs[dr] = CalculateQuarterSymbolNs (sf, bandwidth);
+      // data rate is number of bits per symbol (i.e. SF) times number of symbols per second (i.e. Rs, symbol rate)
+      m_nominalDataRate[dr] = sf * (bandwidth / std::pow (2.0, sf));
+
+      for (uint8_t cr = 1; cr <= 4; cr++)
+        {
+          for (uint32_t pl = 0; pl <= 255; pl++)
+            {
+              for (uint8_t mode = 0; mode < 4; mode++)
+                {
+                  const bool crcOn = mode & 1;
+                  const bool implicitHeader = mode & 2;
+                  m_payloadSymbols[GetIndex (dr, cr, pl, crcOn, implicitHeader)] = CalculatePayloadSymbols (pl, sf, cr, crcOn, implicitHeader);
+                }
+            }
+        }
+    }
+}
+
+uint32_t
+LoRaWANAirtime::AirtimeTable::GetIndex (uint8_t dataRateIndex, uint8_t codeRate, uint8_t payloadLength, bool crcOn, bool implicitHeader)
+{
+  return ((((dataRateIndex * 4 + (codeRate - 1)) * 2 + crcOn) * 2 + implicitHeader) << 8) + payloadLength;
+}
+
+const LoRaWANAirtime::AirtimeTable &
+LoRaWANAirtime::GetTable (void)
+{
+  static AirtimeTable table;
+  if (table.m_region != LoRaWAN::GetRegion ())
+    table = AirtimeTable ();
+  return table;
+}
+
+Time
+LoRaWANAirtime::GetTimeOnAir (uint8_t dataRateIndex, uint8_t codeRate, uint8_t payloadLength, uint8_t preambleLength, bool crcOn, bool implicitHeader)
+{
+  NS_ASSERT (dataRateIndex < LoRaWAN::m_supportedDataRates.size ());
+  NS_ASSERT (codeRate >= 1 && codeRate <= 4);
+
+  const AirtimeTable &table = GetTable ();
+  const uint32_t nQuarterSymbols = CalculatePreambleQuarterSymbols (preambleLength)
+    + 4 * table.m_payloadSymbols[AirtimeTable::GetIndex (dataRateIndex, codeRate, payloadLength, crcOn, implicitHeader)];
+  return NanoSeconds (nQuarterSymbols * table.m_quarterSymbolNs[dataRateIndex]);
+}
+
+Time
+LoRaWANAirtime::GetPreambleTime (uint8_t dataRateIndex, uint8_t preambleLength)
+{
+  NS_ASSERT (dataRateIndex < LoRaWAN::m_supportedDataRates.size ());
+  return NanoSeconds (CalculatePreambleQuarterSymbols (preambleLength) * GetTable ().m_quarterSymbolNs[dataRateIndex]);
+}
+
+Time
+LoRaWANAirtime::GetSymbolTime (uint8_t dataRateIndex)
+{
+  NS_ASSERT (dataRateIndex < LoRaWAN::m_supportedDataRates.size ());
+  return NanoSeconds (4 * GetTable ().m_quarterSymbolNs[dataRateIndex]);
+}
+
+double
+LoRaWANAirtime::GetNominalDataRate (uint8_t dataRateIndex)
+{
+  NS_ASSERT (dataRateIndex < LoRaWAN::m_supportedDataRates.size ());
+  return GetTable ().m_nominalDataRate[dataRateIndex];
+}
+
+} // namespace ns3
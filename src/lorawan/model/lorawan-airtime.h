@@ -0,0 +1,174 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#ifndef LORAWAN_AIRTIME_H
+#define LORAWAN_AIRTIME_H
+
+#include "lorawan.h"
+#include <ns3/nstime.h>
+#include <stdint.h>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup lorawan
+ *
+ * Time on air of LoRa transmissions, per $4.1.1.7 'Time on air' in the SX1272
+ * data sheet. Low data rate optimization (DE) is not used.
+ *
+ * The symbol counts and durations are integer arithmetic only: the duration of
+ * a quarter symbol is a whole number of nanoseconds for all LoRa bandwidths.
+ * The constexpr functions can be evaluated at compile time. The functions that
+ * take a data rate index (see LoRaWAN::m_supportedDataRates) look up the
+ * number of payload symbols in a table, which is built once for all data
+ * rates, code rates, CRC and header modes and payload lengths. They can be
+ * used by the MAC, the network server and scheduling tools alike.
+ */
+class LoRaWANAirtime
+{
+public:
+  /**
+   * The numerator of the conditional part of the number of payload symbols.
+   *
+   * \param payloadLength the PHY payload length in bytes
+   * \param sf the spreading factor
+   * \param crcOn whether the payload CRC is present
+   * \param implicitHeader whether the implicit header mode is used
+   * \return 8 PL - 4 SF + 28 + 16 CRC - 20 IH
+   */
+  static constexpr int32_t GetPayloadSymbolsNumerator (uint8_t payloadLength, uint8_t sf, bool crcOn, bool implicitHeader)
+  {
+    return 8 * payloadLength - 4 * sf + 28 + (crcOn ? 16 : 0) - (implicitHeader ? 20 : 0);
+  }
+
+  /**
+   * \param payloadLength the PHY payload length in bytes
+   * \param sf the spreading factor
+   * \param codeRate the code rate (1 to 4 for 4/5 to 4/8)
+   * \param crcOn whether the payload CRC is present
+   * \param implicitHeader whether the implicit header mode is used
+   * \return the number of payload symbols, including the 8 symbols of the
+   * header and the first bits of the payload
+   */
+  static constexpr uint16_t CalculatePayloadSymbols (uint8_t payloadLength, uint8_t sf, uint8_t codeRate, bool crcOn, bool implicitHeader)
+  {
+    return 8 + (GetPayloadSymbolsNumerator (payloadLength, sf, crcOn, implicitHeader) > 0
+                ? (GetPayloadSymbolsNumerator (payloadLength, sf, crcOn, implicitHeader) + 4 * sf - 1) / (4 * sf) * (codeRate + 4)
+                : 0);
+  }
+
+  /**
+   * \param sf the spreading factor
+   * \param bandwidth the bandwidth in Hz
+   * \return the duration of a quarter symbol in nanoseconds
+   */
+  static constexpr int64_t CalculateQuarterSymbolNs (uint8_t sf, uint32_t bandwidth)
+  {
+    return (static_cast<int64_t> (1) << sf) * 1000000000 / (4 * static_cast<int64_t> (bandwidth));
+  }
+
+  /**
+   * \param preambleLength the number of programmed preamble symbols
+   * \return the number of preamble quarter symbols (4.25 symbols are added to
+   * the programmed preamble)
+   */
+  static constexpr uint32_t CalculatePreambleQuarterSymbols (uint8_t preambleLength)
+  {
+    return 4 * preambleLength + 17;
+  }
+
+  /**
+   * \param payloadLength the PHY payload length in bytes
+   * \param sf the spreading factor
+   * \param bandwidth the bandwidth in Hz
+   * \param codeRate the code rate (1 to 4 for 4/5 to 4/8)
+   * \param preambleLength the number of programmed preamble symbols
+   * \param crcOn whether the payload CRC is present
+   * \param implicitHeader whether the implicit header mode is used
+   * \return the time on air in nanoseconds
+   */
+  static constexpr int64_t CalculateTimeOnAirNs (uint8_t payloadLength, uint8_t sf, uint32_t bandwidth, uint8_t codeRate, uint8_t preambleLength, bool crcOn, bool implicitHeader)
+  {
+    return (CalculatePreambleQuarterSymbols (preambleLength) + 4 * CalculatePayloadSymbols (payloadLength, sf, codeRate, crcOn, implicitHeader))
+           * CalculateQuarterSymbolNs (sf, bandwidth);
+  }
+
+  /**
+   * Get the time on air of a transmission.
+   *
+   * \param dataRateIndex the index of the data rate in LoRaWAN::m_supportedDataRates
+   * \param codeRate the code rate (1 to 4 for 4/5 to 4/8)
+   * \param payloadLength the PHY payload length in bytes
+   * \param preambleLength the number of programmed preamble symbols
+   * \param crcOn whether the payload CRC is present
+   * \param implicitHeader whether the implicit header mode is used
+   * \return the time on air
+   */
+  static Time GetTimeOnAir (uint8_t dataRateIndex, uint8_t codeRate, uint8_t payloadLength, uint8_t preambleLength = 8, bool crcOn = true, bool implicitHeader = false);
+
+  /**
+   * \param dataRateIndex the index of the data rate in LoRaWAN::m_supportedDataRates
+   * \param preambleLength the number of programmed preamble symbols
+   * \return the time on air of the preamble
+   */
+  static Time GetPreambleTime (uint8_t dataRateIndex, uint8_t preambleLength = 8);
+
+  /**
+   * \param dataRateIndex the index of the data rate in LoRaWAN::m_supportedDataRates
+   * \return the duration of a symbol
+   */
+  static Time GetSymbolTime (uint8_t dataRateIndex);
+
+  /**
+   * \param dataRateIndex the index of the data rate in LoRaWAN::m_supportedDataRates
+   * \return the nominal (i.e. uncoded) bit rate in bits per second: SF times
+   * the symbol rate
+   */
+  static double GetNominalDataRate (uint8_t dataRateIndex);
+
+private:
+  /**
+   * The precomputed values of all data rates.
+   */
+  struct AirtimeTable
+  {
+    AirtimeTable ();
+
+    /**
+     * \return the index of a payload length in m_payloadSymbols
+     */
+    static uint32_t GetIndex (uint8_t dataRateIndex, uint8_t codeRate, uint8_t payloadLength, bool crcOn, bool implicitHeader);
+
+    std::vector<uint16_t> m_payloadSymbols; //!< number of payload symbols, see GetIndex
+    std::vector<int64_t> m_quarterSymbolNs; //!< quarter symbol duration per data rate
+    std::vector<double> m_nominalDataRate;  //!< nominal bit rate per data rate
+    LoRaWANRegion m_region;                 //!< region of the data rates
+  };
+
+  /**
+   * \return the table, which is built on first use and rebuilt when the
+   * region changes
+   */
+  static const AirtimeTable &GetTable (void);
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_AIRTIME_H */
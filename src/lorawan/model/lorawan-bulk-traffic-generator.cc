@@ -0,0 +1,419 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include "lorawan-bulk-traffic-generator.h"
+#include "lorawan.h"
+#include "lorawan-net-device.h"
+#include "lorawan-mac.h"
+#include "lorawan-frame-header.h"
+#include <ns3/log.h>
+#include <ns3/simulator.h>
+#include <ns3/random-variable-stream.h>
+#include <ns3/ipv4-address.h>
+#include <ns3/uinteger.h>
+#include <ns3/boolean.h>
+#include <ns3/enum.h>
+#include <ns3/trace-source-accessor.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANBulkTrafficGenerator");
+
+NS_OBJECT_ENSURE_REGISTERED (LoRaWANBulkTrafficGenerator);
+
+TypeId
+LoRaWANBulkTrafficGenerator::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoRaWANBulkTrafficGenerator")
+    .SetParent<Object> ()
+    .SetGroupName ("LoRaWAN")
+    .AddConstructor<LoRaWANBulkTrafficGenerator> ()
+    .AddAttribute ("Profile",
+                   "The traffic profile of all end devices.",
+                   EnumValue (LORAWAN_BULK_TRAFFIC_PERIODIC),
+                   MakeEnumAccessor (&LoRaWANBulkTrafficGenerator::m_profile),
+                   MakeEnumChecker (LORAWAN_BULK_TRAFFIC_PERIODIC, "Periodic",
+                                    LORAWAN_BULK_TRAFFIC_POISSON, "Poisson",
+                                    LORAWAN_BULK_TRAFFIC_TRACE, "Trace"))
+    .AddAttribute ("Period",
+                   "The period between uplinks of an end device in the periodic profile, "
+                   "the mean inter arrival time in the Poisson profile.",
+                   TimeValue (Seconds (600)),
+                   MakeTimeAccessor (&LoRaWANBulkTrafficGenerator::m_period),
+                   MakeTimeChecker (Seconds (0)))
+    .AddAttribute ("Jitter",
+                   "The maximum deviation from Period of the time between uplinks in the periodic profile.",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&LoRaWANBulkTrafficGenerator::m_jitter),
+                   MakeTimeChecker (Seconds (0)))
+    .AddAttribute ("PacketSize",
+                   "The size of the PHYPayload of uplinks, as the PacketSize attribute of LoRaWANEndDeviceApplication.",
+                   UintegerValue (21),
+                   MakeUintegerAccessor (&LoRaWANBulkTrafficGenerator::m_pktSize),
+                   MakeUintegerChecker<uint32_t> (8 + 1 + 4, 255))
+    .AddAttribute ("DataRateIndex",
+                   "The data rate of the uplinks of end devices that are installed.",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&LoRaWANBulkTrafficGenerator::m_dataRateIndex),
+                   MakeUintegerChecker<uint8_t> ())
+    .AddAttribute ("ConfirmedDataUp",
+                   "Send Confirmed Data Up MAC packets. False means Unconfirmed data up packets are sent.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&LoRaWANBulkTrafficGenerator::m_confirmedData),
+                   MakeBooleanChecker ())
+    .AddAttribute ("FramePort",
+                   "The frame port of uplinks.",
+                   UintegerValue (1),
+                   MakeUintegerAccessor (&LoRaWANBulkTrafficGenerator::m_framePort),
+                   MakeUintegerChecker<uint8_t> (1, 223))
+    .AddAttribute ("TimerResolution",
+                   "The resolution of the timer wheel for the next TX times of the end devices. TX times are rounded up "
+                   "to the resolution and all end devices that send at the same time share a simulator event. "
+                   "Zero schedules a simulator event for every uplink.",
+                   TimeValue (MilliSeconds (1)),
+                   MakeTimeAccessor (&LoRaWANBulkTrafficGenerator::SetTimerResolution,
+                                     &LoRaWANBulkTrafficGenerator::GetTimerResolution),
+                   MakeTimeChecker (Seconds (0)))
+    .AddTraceSource ("USMsgTransmitted", "An US message is sent",
+                     MakeTraceSourceAccessor (&LoRaWANBulkTrafficGenerator::m_usMsgTransmittedTrace),
+                     "ns3::Packet::TracedCallback")
+  ;
+  return tid;
+}
+
+LoRaWANBulkTrafficGenerator::LoRaWANBulkTrafficGenerator ()
+  : m_profile (LORAWAN_BULK_TRAFFIC_PERIODIC),
+    m_pktSize (21),
+    m_dataRateIndex (0),
+    m_confirmedData (false),
+    m_framePort (1),
+    m_running (false),
+    m_nUplinks (0)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_timerWheel.SetExpireCallback (MakeCallback (&LoRaWANBulkTrafficGenerator::TimerExpired, this));
+  m_uniformRandomVariable = CreateObject<UniformRandomVariable> ();
+  m_iatRandomVariable = CreateObject<ExponentialRandomVariable> ();
+}
+
+LoRaWANBulkTrafficGenerator::~LoRaWANBulkTrafficGenerator ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+LoRaWANBulkTrafficGenerator::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_timerWheel.Clear ();
+  m_timerWheel.SetExpireCallback (MakeNullCallback<void, uint32_t, uint8_t> ());
+  m_devices.clear ();
+  m_payloads.clear ();
+  Object::DoDispose ();
+}
+
+void
+LoRaWANBulkTrafficGenerator::Install (NetDeviceContainer devices)
+{
+  NS_LOG_FUNCTION (this);
+
+  NS_ABORT_MSG_UNLESS (m_dataRateIndex < LoRaWAN::m_supportedDataRates.size () && LoRaWAN::IsUplinkDataRate (m_dataRateIndex),
+                       "DataRateIndex " << (uint32_t)m_dataRateIndex << " is not an uplink data rate");
+
+  for (NetDeviceContainer::Iterator i = devices.Begin (); i != devices.End (); ++i)
+    {
+      Ptr<LoRaWANNetDevice> device = DynamicCast<LoRaWANNetDevice> (*i);
+      if (!device || device->GetDeviceType () == LORAWAN_DT_GATEWAY)
+        NS_FATAL_ERROR ("LoRaWANBulkTrafficGenerator can only be installed on end devices");
+
+      const uint32_t deviceIndex = m_devices.size ();
+      m_devices.push_back (device);
+      m_fCntUp.push_back (0);
+      m_dataRateIndexes.push_back (m_dataRateIndex);
+      if (m_running)
+        ScheduleNextTx (deviceIndex, true);
+    }
+}
+
+uint32_t
+LoRaWANBulkTrafficGenerator::GetNDevices (void) const
+{
+  return m_devices.size ();
+}
+
+Ptr<LoRaWANNetDevice>
+LoRaWANBulkTrafficGenerator::GetDevice (uint32_t deviceIndex) const
+{
+  NS_ASSERT (deviceIndex < m_devices.size ());
+  return m_devices[deviceIndex];
+}
+
+void
+LoRaWANBulkTrafficGenerator::SetDataRateIndex (uint32_t deviceIndex, uint8_t dataRateIndex)
+{
+  NS_LOG_FUNCTION (this << deviceIndex << (uint32_t)dataRateIndex);
+  NS_ASSERT (deviceIndex < m_devices.size ());
+
+  if (dataRateIndex < LoRaWAN::m_supportedDataRates.size () && LoRaWAN::IsUplinkDataRate (dataRateIndex))
+    m_dataRateIndexes[deviceIndex] = dataRateIndex;
+  else
+    NS_LOG_ERROR (this << " " << (uint32_t)dataRateIndex << " is an invalid data rate index");
+}
+
+uint8_t
+LoRaWANBulkTrafficGenerator::GetDataRateIndex (uint32_t deviceIndex) const
+{
+  NS_ASSERT (deviceIndex < m_devices.size ());
+  return m_dataRateIndexes[deviceIndex];
+}
+
+void
+LoRaWANBulkTrafficGenerator::AddTraceEntry (uint32_t deviceIndex, Time time)
+{
+  NS_LOG_FUNCTION (this << deviceIndex << time);
+  NS_ASSERT_MSG (!m_running, "Trace entries can only be added before the generator is started");
+
+  if (deviceIndex >= m_traces.size ())
+    m_traces.resize (deviceIndex + 1);
+  m_traces[deviceIndex].push_back (time);
+}
+
+uint32_t
+LoRaWANBulkTrafficGenerator::ReadTraceFile (std::string filename)
+{
+  NS_LOG_FUNCTION (this << filename);
+
+  std::ifstream file (filename.c_str ());
+  NS_ABORT_MSG_UNLESS (file.is_open (), "Unable to open trace file " << filename);
+
+  uint32_t nEntries = 0;
+  std::string line;
+  while (std::getline (file, line))
+    {
+      if (line.empty () || line[0] == '#')
+        continue;
+
+      std::istringstream iss (line);
+      double seconds;
+      uint32_t deviceIndex;
+      if (!(iss >> seconds >> deviceIndex))
+        {
+          NS_LOG_WARN (this << " Ignoring malformed line in " << filename << ": " << line);
+          continue;
+        }
+      AddTraceEntry (deviceIndex, Seconds (seconds));
+      nEntries++;
+    }
+  return nEntries;
+}
+
+void
+LoRaWANBulkTrafficGenerator::Start (Time delay)
+{
+  NS_LOG_FUNCTION (this << delay);
+  Simulator::Schedule (delay, &LoRaWANBulkTrafficGenerator::StartGeneration, this);
+}
+
+void
+LoRaWANBulkTrafficGenerator::Stop (Time delay)
+{
+  NS_LOG_FUNCTION (this << delay);
+  Simulator::Schedule (delay, &LoRaWANBulkTrafficGenerator::StopGeneration, this);
+}
+
+uint64_t
+LoRaWANBulkTrafficGenerator::GetNUplinks (void) const
+{
+  return m_nUplinks;
+}
+
+const LoRaWANTimerWheel &
+LoRaWANBulkTrafficGenerator::GetTimerWheel (void) const
+{
+  return m_timerWheel;
+}
+
+int64_t
+LoRaWANBulkTrafficGenerator::AssignStreams (int64_t stream)
+{
+  NS_LOG_FUNCTION (this << stream);
+  m_uniformRandomVariable->SetStream (stream);
+  m_iatRandomVariable->SetStream (stream + 1);
+  return 2;
+}
+
+void
+LoRaWANBulkTrafficGenerator::SetTimerResolution (Time resolution)
+{
+  m_timerWheel.SetResolution (resolution);
+}
+
+Time
+LoRaWANBulkTrafficGenerator::GetTimerResolution (void) const
+{
+  return m_timerWheel.GetResolution ();
+}
+
+void
+LoRaWANBulkTrafficGenerator::StartGeneration (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_running)
+    return;
+  m_running = true;
+
+  if (m_profile == LORAWAN_BULK_TRAFFIC_TRACE)
+    {
+      m_traces.resize (m_devices.size ());
+      m_traceCursors.assign (m_devices.size (), 0);
+      for (uint32_t i = 0; i < m_traces.size (); i++)
+        std::sort (m_traces[i].begin (), m_traces[i].end ());
+    }
+
+  for (uint32_t i = 0; i < m_devices.size (); i++)
+    ScheduleNextTx (i, true);
+}
+
+void
+LoRaWANBulkTrafficGenerator::StopGeneration (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_running = false;
+  m_timerWheel.Clear ();
+}
+
+void
+LoRaWANBulkTrafficGenerator::TimerExpired (uint32_t deviceIndex, uint8_t timerType)
+{
+  NS_LOG_FUNCTION (this << deviceIndex);
+
+  if (!m_running)
+    return;
+
+  GenerateUplink (deviceIndex);
+  ScheduleNextTx (deviceIndex, false);
+}
+
+void
+LoRaWANBulkTrafficGenerator::ScheduleNextTx (uint32_t deviceIndex, bool first)
+{
+  Time delay;
+  switch (m_profile)
+    {
+    case LORAWAN_BULK_TRAFFIC_PERIODIC:
+      if (first)
+        delay = Seconds (m_uniformRandomVariable->GetValue (0.0, m_period.GetSeconds ()));
+      else if (m_jitter.IsStrictlyPositive ())
+        delay = std::max (Seconds (0), m_period + Seconds (m_uniformRandomVariable->GetValue (-m_jitter.GetSeconds (), m_jitter.GetSeconds ())));
+      else
+        delay = m_period;
+      break;
+    case LORAWAN_BULK_TRAFFIC_POISSON:
+      if (first)
+        delay = Seconds (m_uniformRandomVariable->GetValue (0.0, m_period.GetSeconds ()));
+      else
+        delay = Seconds (m_iatRandomVariable->GetValue (m_period.GetSeconds (), 0.0));
+      break;
+    case LORAWAN_BULK_TRAFFIC_TRACE:
+      {
+        const std::vector<Time> &trace = m_traces[deviceIndex];
+        uint32_t &cursor = m_traceCursors[deviceIndex];
+        const Time now = Simulator::Now ();
+        // Entries before the start of the generator are skipped, later entries
+        // that are due already (e.g. within the same tick) are sent right away
+        if (first)
+          while (cursor < trace.size () && trace[cursor] < now)
+            cursor++;
+        if (cursor >= trace.size ())
+          return;
+        delay = std::max (Seconds (0), trace[cursor++] - now);
+        break;
+      }
+    default:
+      NS_FATAL_ERROR (this << " Unsupported traffic profile " << m_profile);
+    }
+
+  m_timerWheel.Schedule (delay, deviceIndex, 0);
+}
+
+void
+LoRaWANBulkTrafficGenerator::GenerateUplink (uint32_t deviceIndex)
+{
+  const uint8_t dataRateIndex = m_dataRateIndexes[deviceIndex];
+  const std::vector<uint8_t> &uplinkChannels = LoRaWAN::GetUplinkChannels (dataRateIndex);
+  NS_ASSERT (!uplinkChannels.empty ());
+  const uint8_t channelIndex = uplinkChannels[m_uniformRandomVariable->GetInteger (0, uplinkChannels.size () - 1)];
+
+  SendUplink (deviceIndex, m_pktSize, dataRateIndex, channelIndex);
+}
+
+Ptr<Packet>
+LoRaWANBulkTrafficGenerator::GetPayload (uint32_t size)
+{
+  // The FRMPayload of every uplink is a copy of one of these packets, copies
+  // share its (zero filled) buffer
+  if (size >= m_payloads.size ())
+    m_payloads.resize (size + 1);
+  if (!m_payloads[size])
+    m_payloads[size] = Create<Packet> (size);
+  return m_payloads[size];
+}
+
+void
+LoRaWANBulkTrafficGenerator::SendUplink (uint32_t deviceIndex, uint32_t pktSize, uint8_t dataRateIndex, uint8_t channelIndex)
+{
+  NS_LOG_FUNCTION (this << deviceIndex << pktSize << (uint32_t)dataRateIndex << (uint32_t)channelIndex);
+  NS_ASSERT (deviceIndex < m_devices.size ());
+
+  Ptr<LoRaWANNetDevice> device = m_devices[deviceIndex];
+  const Ipv4Address deviceAddr = Ipv4Address::ConvertFrom (device->GetAddress ());
+
+  LoRaWANFrameHeader fhdr;
+  fhdr.setDevAddr (deviceAddr);
+  fhdr.setAdr (false);
+  fhdr.setAck (false);
+  fhdr.setFramePending (false);
+  fhdr.setFrameCounter (m_fCntUp[deviceIndex]++);
+  fhdr.setFramePort (m_framePort);
+
+  // 8 bytes for the frame header, 1B for the MAC header and 4B for the MIC
+  Ptr<Packet> packet = GetPayload (pktSize > 8 + 1 + 4 ? pktSize - (8 + 1 + 4) : 0)->Copy ();
+  packet->AddHeader (fhdr); // Packet now represents MACPayload
+
+  LoRaWANDataRequestParams params;
+  params.m_loraWANChannelIndex = channelIndex;
+  params.m_loraWANDataRateIndex = dataRateIndex;
+  params.m_loraWANCodeRate = 3;
+  params.m_msgType = m_confirmedData ? LORAWAN_CONFIRMED_DATA_UP : LORAWAN_UNCONFIRMED_DATA_UP;
+  params.m_requestHandle = 0;
+  params.m_numberOfTransmissions = m_confirmedData ? DEFAULT_NUMBER_US_TRANSMISSIONS : device->GetNbRep ();
+
+  m_usMsgTransmittedTrace (deviceAddr.Get (), params.m_msgType, packet);
+  device->GetMac ()->sendMACPayloadRequest (params, packet);
+  m_nUplinks++;
+}
+
+} // namespace ns3
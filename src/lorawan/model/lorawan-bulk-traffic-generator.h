@@ -0,0 +1,237 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#ifndef LORAWAN_BULK_TRAFFIC_GENERATOR_H
+#define LORAWAN_BULK_TRAFFIC_GENERATOR_H
+
+#include <ns3/object.h>
+#include <ns3/nstime.h>
+#include <ns3/ptr.h>
+#include <ns3/packet.h>
+#include <ns3/traced-callback.h>
+#include <ns3/net-device-container.h>
+#include "lorawan-timer-wheel.h"
+#include <vector>
+#include <string>
+
+namespace ns3 {
+
+class LoRaWANNetDevice;
+class UniformRandomVariable;
+class ExponentialRandomVariable;
+
+/**
+ * \ingroup lorawan
+ *
+ * The traffic profiles of LoRaWANBulkTrafficGenerator.
+ */
+typedef enum
+{
+  LORAWAN_BULK_TRAFFIC_PERIODIC = 0, //!< Uplinks every Period, plus a uniform jitter in [-Jitter, Jitter]
+  LORAWAN_BULK_TRAFFIC_POISSON = 1,  //!< Exponential inter arrival times with mean Period
+  LORAWAN_BULK_TRAFFIC_TRACE = 2,    //!< Uplinks at the times added with AddTraceEntry
+} LoRaWANBulkTrafficProfile;
+
+/**
+ * \ingroup lorawan
+ *
+ * Generates US data for a whole population of end devices, without a
+ * LoRaWANEndDeviceApplication and PacketSocket per end device. The next TX
+ * times of all end devices are kept in a single LoRaWANTimerWheel, so all
+ * end devices that send in the same tick of the wheel share one simulator
+ * event. An uplink is a copy of a FRMPayload packet that is built once and
+ * shared by all uplinks (ns-3 packets are copy-on-write), with a frame
+ * header, and is passed to the MAC of the end device with
+ * LoRaWANMac::sendMACPayloadRequest.
+ *
+ * End devices are identified by the order in which they were installed. The
+ * generator only sends uplinks: the end devices do not join, do not apply
+ * MAC commands and do not set the Ack bit for confirmed DS packets, so the
+ * generator should not be combined with OTAA or ADR. The TX times are
+ * rounded up to the TimerResolution.
+ */
+class LoRaWANBulkTrafficGenerator : public Object
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  LoRaWANBulkTrafficGenerator ();
+  virtual ~LoRaWANBulkTrafficGenerator ();
+
+  /**
+   * Add end devices to the population. The index of an end device is the
+   * number of end devices that were installed before it.
+   *
+   * \param devices LoRaWANNetDevices of end devices
+   */
+  void Install (NetDeviceContainer devices);
+
+  /**
+   * \return the number of installed end devices
+   */
+  uint32_t GetNDevices (void) const;
+
+  /**
+   * \param deviceIndex an end device
+   * \return the LoRaWANNetDevice of the end device
+   */
+  Ptr<LoRaWANNetDevice> GetDevice (uint32_t deviceIndex) const;
+
+  /**
+   * \param deviceIndex an end device
+   * \param dataRateIndex the data rate of its uplinks, by default the
+   * DataRateIndex attribute at the time the end device was installed
+   */
+  void SetDataRateIndex (uint32_t deviceIndex, uint8_t dataRateIndex);
+  uint8_t GetDataRateIndex (uint32_t deviceIndex) const;
+
+  /**
+   * Add an uplink of an end device for the trace profile.
+   *
+   * \param deviceIndex the end device
+   * \param time the simulation time of the uplink
+   */
+  void AddTraceEntry (uint32_t deviceIndex, Time time);
+
+  /**
+   * Add the uplinks of a text file for the trace profile. Every line holds
+   * the time of an uplink in seconds and the index of the end device,
+   * separated by white space. Empty lines and lines starting with # are
+   * skipped.
+   *
+   * \param filename the trace file
+   * \return the number of uplinks that were added
+   */
+  uint32_t ReadTraceFile (std::string filename);
+
+  /**
+   * Start generating uplinks after a delay. The first uplink of an end device
+   * is sent at a random time within one Period, or at its first trace entry.
+   *
+   * \param delay the delay
+   */
+  void Start (Time delay);
+
+  /**
+   * Stop generating uplinks after a delay.
+   *
+   * \param delay the delay
+   */
+  void Stop (Time delay);
+
+  /**
+   * Pass an uplink of an end device to its MAC right away, whether or not the
+   * generator is started, e.g. to replay a log of uplinks (see
+   * LoRaWANUplinkReplay). The uplink is counted and traced like the uplinks
+   * of the traffic profile.
+   *
+   * \param deviceIndex the end device
+   * \param pktSize the size of the PHYPayload, at least 13 bytes
+   * \param dataRateIndex the data rate
+   * \param channelIndex the channel
+   */
+  void SendUplink (uint32_t deviceIndex, uint32_t pktSize, uint8_t dataRateIndex, uint8_t channelIndex);
+
+  /**
+   * \return the number of uplinks passed to the MACs of the end devices
+   */
+  uint64_t GetNUplinks (void) const;
+
+  const LoRaWANTimerWheel &GetTimerWheel (void) const;
+
+  /**
+   * \brief Assign a fixed random variable stream number to the random
+   * variables used by this model.
+   *
+   * \param stream first stream index to use
+   * \return the number of stream indices assigned by this model
+   */
+  int64_t AssignStreams (int64_t stream);
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  void StartGeneration (void);
+  void StopGeneration (void);
+
+  /**
+   * Called by the timer wheel when the next TX time of an end device is
+   * reached.
+   */
+  void TimerExpired (uint32_t deviceIndex, uint8_t timerType);
+
+  /**
+   * Schedule the next uplink of an end device, if any.
+   *
+   * \param deviceIndex the end device
+   * \param first whether this is the first uplink of the end device
+   */
+  void ScheduleNextTx (uint32_t deviceIndex, bool first);
+
+  /**
+   * Pass an uplink of the traffic profile of an end device to its MAC.
+   *
+   * \param deviceIndex the end device
+   */
+  void GenerateUplink (uint32_t deviceIndex);
+
+  /**
+   * \param size the size of a FRMPayload
+   * \return the packet that is shared by all FRMPayloads of this size
+   */
+  Ptr<Packet> GetPayload (uint32_t size);
+
+  void SetTimerResolution (Time resolution);
+  Time GetTimerResolution (void) const;
+
+  // Per end device state, indexed by device index
+  std::vector<Ptr<LoRaWANNetDevice> > m_devices;
+  std::vector<uint32_t> m_fCntUp;         //!< Uplink frame counters
+  std::vector<uint8_t> m_dataRateIndexes; //!< Data rates of the uplinks
+  std::vector<std::vector<Time> > m_traces; //!< Uplink times of the trace profile, sorted when started
+  std::vector<uint32_t> m_traceCursors;   //!< Next trace entry of every end device
+
+  LoRaWANBulkTrafficProfile m_profile;
+  Time m_period;
+  Time m_jitter;
+  uint32_t m_pktSize;         //!< Size of PHYPayloads
+  uint8_t m_dataRateIndex;    //!< Data rate of end devices that are installed
+  bool m_confirmedData;
+  uint8_t m_framePort;
+
+  std::vector<Ptr<Packet> > m_payloads; //!< FRMPayloads shared by all uplinks, by size
+  LoRaWANTimerWheel m_timerWheel; //!< Next TX times of all end devices
+  bool m_running;
+  uint64_t m_nUplinks;
+
+  Ptr<UniformRandomVariable> m_uniformRandomVariable; //!< rng for start offsets, jitter and channels
+  Ptr<ExponentialRandomVariable> m_iatRandomVariable; //!< rng for Poisson inter arrival times
+
+  /// Traced Callback: transmitted packets, as the USMsgTransmitted trace source of LoRaWANEndDeviceApplication.
+  TracedCallback<uint32_t, uint8_t, Ptr<const Packet> > m_usMsgTransmittedTrace;
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_BULK_TRAFFIC_GENERATOR_H */
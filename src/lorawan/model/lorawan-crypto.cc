@@ -0,0 +1,687 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include "lorawan-crypto.h"
+#include <ns3/log.h>
+#include <ns3/assert.h>
+#include <ns3/packet.h>
+#include <algorithm>
+#include <cstring>
+
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+#define LORAWAN_AESNI 1
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANCrypto");
+
+/****************************************************************************
+ ************************ AES-128 *******************************************
+ ****************************************************************************/
+
+/**
+ * The S-box and the lookup tables of the rounds of AES, computed once.
+ */
+typedef struct LoRaWANAesTables {
+  LoRaWANAesTables ();
+
+  uint8_t m_sbox[256];
+  uint8_t m_invSbox[256];
+  uint32_t m_te[4][256];  //!< SubBytes, ShiftRows and MixColumns of a byte of a column
+} LoRaWANAesTables;
+
+static inline uint8_t
+RotateLeft8 (uint8_t x, uint32_t n)
+{
+  return (x << n) | (x >> (8 - n));
+}
+
+static inline uint32_t
+RotateRight32 (uint32_t x, uint32_t n)
+{
+  return (x >> n) | (x << (32 - n));
+}
+
+static inline uint8_t
+XTime (uint8_t x)
+{
+  return (x << 1) ^ (x & 0x80 ? 0x1b : 0x00);
+}
+
+/**
+ * Multiply in GF(2^8).
+ */
+static inline uint8_t
+Multiply (uint8_t x, uint8_t y)
+{
+  uint8_t product = 0;
+  for (; y; y >>= 1, x = XTime (x))
+    if (y & 1)
+      product ^= x;
+  return product;
+}
+
+static inline uint32_t
+GetU32 (const uint8_t *p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline void
+PutU32 (uint8_t *p, uint32_t x)
+{
+  p[0] = x >> 24;
+  p[1] = x >> 16;
+  p[2] = x >> 8;
+  p[3] = x;
+}
+
+LoRaWANAesTables::LoRaWANAesTables ()
+{
+  // The S-box is the multiplicative inverse in GF(2^8) followed by an affine
+  // transformation. p runs over all non-zero elements as powers of 3, q over
+  // their inverses.
+  uint8_t p = 1;
+  uint8_t q = 1;
+  do {
+    p = p ^ (p << 1) ^ (p & 0x80 ? 0x1b : 0x00);
+    q ^= q << 1;
+    q ^= q << 2;
+    q ^= q << 4;
+    if (q & 0x80)
+      q ^= 0x09;
+    m_sbox[p] = q ^ RotateLeft8 (q, 1) ^ RotateLeft8 (q, 2) ^ RotateLeft8 (q, 3) ^ RotateLeft8 (q, 4) ^ 0x63;
+  } while (p != 1);
+  m_sbox[0] = 0x63;
+  for (uint32_t x = 0; x < 256; x++)
+    m_invSbox[m_sbox[x]] = x;
+
+  for (uint32_t x = 0; x < 256; x++) {
+    const uint8_t s = m_sbox[x];
+    const uint32_t te = ((uint32_t)XTime (s) << 24) | ((uint32_t)s << 16) | ((uint32_t)s << 8) | (uint8_t)(XTime (s) ^ s);
+    for (uint32_t k = 0; k < 4; k++)
+      m_te[k][x] = RotateRight32 (te, 8 * k);
+  }
+}
+
+static const LoRaWANAesTables &
+GetAesTables (void)
+{
+  static const LoRaWANAesTables tables;
+  return tables;
+}
+
+static void
+ExpandKey (const uint8_t key[16], uint8_t roundKeys[176])
+{
+  static const uint8_t rcon[10] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36};
+  const uint8_t *sbox = GetAesTables ().m_sbox;
+
+  uint32_t w[44];
+  for (uint32_t i = 0; i < 4; i++)
+    w[i] = GetU32 (key + 4 * i);
+  for (uint32_t i = 4; i < 44; i++) {
+    uint32_t t = w[i - 1];
+    if (i % 4 == 0)
+      t = (((uint32_t)sbox[(t >> 16) & 0xff] << 24) | ((uint32_t)sbox[(t >> 8) & 0xff] << 16)
+           | ((uint32_t)sbox[t & 0xff] << 8) | sbox[t >> 24]) ^ ((uint32_t)rcon[i / 4 - 1] << 24);
+    w[i] = w[i - 4] ^ t;
+  }
+  for (uint32_t i = 0; i < 44; i++)
+    PutU32 (roundKeys + 4 * i, w[i]);
+}
+
+static void
+EncryptPortable (const uint8_t roundKeys[176], const uint8_t in[16], uint8_t out[16])
+{
+  const LoRaWANAesTables &tables = GetAesTables ();
+  const uint32_t *te0 = tables.m_te[0];
+  const uint32_t *te1 = tables.m_te[1];
+  const uint32_t *te2 = tables.m_te[2];
+  const uint32_t *te3 = tables.m_te[3];
+  const uint8_t *sbox = tables.m_sbox;
+
+  uint32_t s0 = GetU32 (in) ^ GetU32 (roundKeys);
+  uint32_t s1 = GetU32 (in + 4) ^ GetU32 (roundKeys + 4);
+  uint32_t s2 = GetU32 (in + 8) ^ GetU32 (roundKeys + 8);
+  uint32_t s3 = GetU32 (in + 12) ^ GetU32 (roundKeys + 12);
+  for (uint32_t r = 1; r < 10; r++) {
+    const uint8_t *rk = roundKeys + 16 * r;
+    const uint32_t t0 = te0[s0 >> 24] ^ te1[(s1 >> 16) & 0xff] ^ te2[(s2 >> 8) & 0xff] ^ te3[s3 & 0xff] ^ GetU32 (rk);
+    const uint32_t t1 = te0[s1 >> 24] ^ te1[(s2 >> 16) & 0xff] ^ te2[(s3 >> 8) & 0xff] ^ te3[s0 & 0xff] ^ GetU32 (rk + 4);
+    const uint32_t t2 = te0[s2 >> 24] ^ te1[(s3 >> 16) & 0xff] ^ te2[(s0 >> 8) & 0xff] ^ te3[s1 & 0xff] ^ GetU32 (rk + 8);
+    const uint32_t t3 = te0[s3 >> 24] ^ te1[(s0 >> 16) & 0xff] ^ te2[(s1 >> 8) & 0xff] ^ te3[s2 & 0xff] ^ GetU32 (rk + 12);
+    s0 = t0;
+    s1 = t1;
+    s2 = t2;
+    s3 = t3;
+  }
+
+  // The last round does not have MixColumns
+  const uint8_t *rk = roundKeys + 160;
+  PutU32 (out, (((uint32_t)sbox[s0 >> 24] << 24) | ((uint32_t)sbox[(s1 >> 16) & 0xff] << 16)
+                | ((uint32_t)sbox[(s2 >> 8) & 0xff] << 8) | sbox[s3 & 0xff]) ^ GetU32 (rk));
+  PutU32 (out + 4, (((uint32_t)sbox[s1 >> 24] << 24) | ((uint32_t)sbox[(s2 >> 16) & 0xff] << 16)
+                    | ((uint32_t)sbox[(s3 >> 8) & 0xff] << 8) | sbox[s0 & 0xff]) ^ GetU32 (rk + 4));
+  PutU32 (out + 8, (((uint32_t)sbox[s2 >> 24] << 24) | ((uint32_t)sbox[(s3 >> 16) & 0xff] << 16)
+                    | ((uint32_t)sbox[(s0 >> 8) & 0xff] << 8) | sbox[s1 & 0xff]) ^ GetU32 (rk + 8));
+  PutU32 (out + 12, (((uint32_t)sbox[s3 >> 24] << 24) | ((uint32_t)sbox[(s0 >> 16) & 0xff] << 16)
+                     | ((uint32_t)sbox[(s1 >> 8) & 0xff] << 8) | sbox[s2 & 0xff]) ^ GetU32 (rk + 12));
+}
+
+/**
+ * The inverse cipher, byte by byte. The state is stored column by column, as
+ * the round keys are.
+ */
+static void
+DecryptPortable (const uint8_t roundKeys[176], const uint8_t in[16], uint8_t out[16])
+{
+  const uint8_t *invSbox = GetAesTables ().m_invSbox;
+
+  uint8_t s[16];
+  for (uint32_t i = 0; i < 16; i++)
+    s[i] = in[i] ^ roundKeys[160 + i];
+  for (uint32_t r = 9; ; r--) {
+    // InvShiftRows, InvSubBytes and AddRoundKey, row i of column c moves to
+    // column c + i
+    uint8_t t[16];
+    for (uint32_t c = 0; c < 4; c++)
+      for (uint32_t i = 0; i < 4; i++)
+        t[4 * ((c + i) % 4) + i] = invSbox[s[4 * c + i]];
+    for (uint32_t i = 0; i < 16; i++)
+      t[i] ^= roundKeys[16 * r + i];
+    if (r == 0) {
+      memcpy (out, t, 16);
+      return;
+    }
+
+    // InvMixColumns
+    for (uint32_t c = 0; c < 4; c++) {
+      const uint8_t *a = t + 4 * c;
+      s[4 * c] = Multiply (a[0], 14) ^ Multiply (a[1], 11) ^ Multiply (a[2], 13) ^ Multiply (a[3], 9);
+      s[4 * c + 1] = Multiply (a[0], 9) ^ Multiply (a[1], 14) ^ Multiply (a[2], 11) ^ Multiply (a[3], 13);
+      s[4 * c + 2] = Multiply (a[0], 13) ^ Multiply (a[1], 9) ^ Multiply (a[2], 14) ^ Multiply (a[3], 11);
+      s[4 * c + 3] = Multiply (a[0], 11) ^ Multiply (a[1], 13) ^ Multiply (a[2], 9) ^ Multiply (a[3], 14);
+    }
+  }
+}
+
+#ifdef LORAWAN_AESNI
+/**
+ * Encrypt a block per lane with AES-NI, every lane with its own key. The
+ * rounds of the lanes are interleaved, so that the AESENC instructions of
+ * different lanes are pipelined.
+ */
+__attribute__ ((target ("aes,sse2")))
+static void
+EncryptLanesAesNi (const LoRaWANKey *const *keys, uint8_t (*blocks)[16], uint32_t n)
+{
+  __m128i s[LoRaWANCrypto::m_nLanes];
+  for (uint32_t j = 0; j < n; j++)
+    s[j] = _mm_xor_si128 (_mm_loadu_si128 ((const __m128i *)blocks[j]), _mm_loadu_si128 ((const __m128i *)keys[j]->m_roundKeys));
+  for (uint32_t r = 1; r < 10; r++)
+    for (uint32_t j = 0; j < n; j++)
+      s[j] = _mm_aesenc_si128 (s[j], _mm_loadu_si128 ((const __m128i *)(keys[j]->m_roundKeys + 16 * r)));
+  for (uint32_t j = 0; j < n; j++)
+    _mm_storeu_si128 ((__m128i *)blocks[j], _mm_aesenclast_si128 (s[j], _mm_loadu_si128 ((const __m128i *)(keys[j]->m_roundKeys + 160))));
+}
+#endif
+
+/**
+ * Encrypt a block per lane in place, every lane with its own key.
+ */
+static void
+EncryptLanes (const LoRaWANKey *const *keys, uint8_t (*blocks)[16], uint32_t n)
+{
+  NS_ASSERT (n <= LoRaWANCrypto::m_nLanes);
+#ifdef LORAWAN_AESNI
+  if (LoRaWANCrypto::GetUseAesNi ()) {
+    EncryptLanesAesNi (keys, blocks, n);
+    return;
+  }
+#endif
+  for (uint32_t j = 0; j < n; j++)
+    EncryptPortable (keys[j]->m_roundKeys, blocks[j], blocks[j]);
+}
+
+/****************************************************************************
+ ************************ LoRaWANKey ****************************************
+ ****************************************************************************/
+
+static void
+DoubleSubkey (const uint8_t in[16], uint8_t out[16])
+{
+  const uint8_t carry = in[0] & 0x80;
+  for (uint32_t i = 0; i < 15; i++)
+    out[i] = (in[i] << 1) | (in[i + 1] >> 7);
+  out[15] = (in[15] << 1) ^ (carry ? 0x87 : 0x00);
+}
+
+LoRaWANKey::LoRaWANKey ()
+{
+  const uint8_t zero[16] = {0};
+  Set (zero);
+}
+
+LoRaWANKey::LoRaWANKey (const uint8_t key[16])
+{
+  Set (key);
+}
+
+void
+LoRaWANKey::Set (const uint8_t key[16])
+{
+  memcpy (m_key, key, 16);
+  ExpandKey (m_key, m_roundKeys);
+
+  const uint8_t zero[16] = {0};
+  uint8_t l[16];
+  EncryptPortable (m_roundKeys, zero, l);
+  DoubleSubkey (l, m_k1);
+  DoubleSubkey (m_k1, m_k2);
+}
+
+void
+LoRaWANKey::Get (uint8_t key[16]) const
+{
+  memcpy (key, m_key, 16);
+}
+
+bool
+LoRaWANKey::SetHex (std::string hex)
+{
+  if (hex.size () != 32)
+    return false;
+
+  uint8_t key[16];
+  for (uint32_t i = 0; i < 32; i++) {
+    const char c = hex[i];
+    uint8_t nibble;
+    if (c >= '0' && c <= '9')
+      nibble = c - '0';
+    else if (c >= 'a' && c <= 'f')
+      nibble = c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F')
+      nibble = c - 'A' + 10;
+    else
+      return false;
+    key[i / 2] = i % 2 == 0 ? nibble << 4 : key[i / 2] | nibble;
+  }
+  Set (key);
+  return true;
+}
+
+std::string
+LoRaWANKey::GetHex (void) const
+{
+  static const char digits[] = "0123456789abcdef";
+  std::string hex (32, '0');
+  for (uint32_t i = 0; i < 16; i++) {
+    hex[2 * i] = digits[m_key[i] >> 4];
+    hex[2 * i + 1] = digits[m_key[i] & 0x0f];
+  }
+  return hex;
+}
+
+bool
+LoRaWANKey::operator== (const LoRaWANKey &other) const
+{
+  return memcmp (m_key, other.m_key, 16) == 0;
+}
+
+bool
+LoRaWANKey::operator!= (const LoRaWANKey &other) const
+{
+  return !(*this == other);
+}
+
+/****************************************************************************
+ ************************ LoRaWANCrypto *************************************
+ ****************************************************************************/
+
+const uint32_t LoRaWANCrypto::m_nLanes;
+bool LoRaWANCrypto::m_useAesNi = LoRaWANCrypto::HaveAesNi ();
+
+bool
+LoRaWANCrypto::HaveAesNi (void)
+{
+#ifdef LORAWAN_AESNI
+  __builtin_cpu_init ();
+  return __builtin_cpu_supports ("aes") && __builtin_cpu_supports ("sse2");
+#else
+  return false;
+#endif
+}
+
+void
+LoRaWANCrypto::SetUseAesNi (bool useAesNi)
+{
+  m_useAesNi = useAesNi && HaveAesNi ();
+}
+
+bool
+LoRaWANCrypto::GetUseAesNi (void)
+{
+  return m_useAesNi;
+}
+
+void
+LoRaWANCrypto::Encrypt (const LoRaWANKey &key, const uint8_t in[16], uint8_t out[16])
+{
+  const LoRaWANKey *keys[1] = {&key};
+  uint8_t block[1][16];
+  memcpy (block[0], in, 16);
+  EncryptLanes (keys, block, 1);
+  memcpy (out, block[0], 16);
+}
+
+void
+LoRaWANCrypto::Decrypt (const LoRaWANKey &key, const uint8_t in[16], uint8_t out[16])
+{
+  DecryptPortable (key.m_roundKeys, in, out);
+}
+
+/**
+ * A CMAC of LoRaWANCrypto, of a first block followed by data.
+ */
+typedef struct LoRaWANCmacLane {
+  const LoRaWANKey *m_key;
+  const uint8_t *m_prefix;  //!< A block that precedes m_data, or 0
+  const uint8_t *m_data;
+  uint32_t m_length;        //!< Length of m_data
+  uint8_t m_mac[16];
+} LoRaWANCmacLane;
+
+static uint32_t
+GetCmacBlocks (const LoRaWANCmacLane &lane)
+{
+  const uint32_t length = (lane.m_prefix ? 16 : 0) + lane.m_length;
+  return length == 0 ? 1 : (length + 15) / 16;
+}
+
+/**
+ * Get a block of the input of a CMAC, the last block is padded and XORed
+ * with the subkey.
+ */
+static void
+GetCmacBlock (const LoRaWANCmacLane &lane, uint32_t block, uint32_t nBlocks, uint8_t out[16])
+{
+  const uint32_t prefixLength = lane.m_prefix ? 16 : 0;
+  if (block == 0 && lane.m_prefix) {
+    memcpy (out, lane.m_prefix, 16);
+  } else {
+    const uint32_t offset = 16 * block - prefixLength;
+    const uint32_t n = std::min<uint32_t> (16, lane.m_length - offset);
+    memcpy (out, lane.m_data + offset, n);
+    if (n < 16) {
+      out[n] = 0x80;
+      memset (out + n + 1, 0, 15 - n);
+    }
+  }
+
+  if (block == nBlocks - 1) {
+    const uint32_t length = prefixLength + lane.m_length;
+    const uint8_t *subkey = length > 0 && length % 16 == 0 ? lane.m_key->m_k1 : lane.m_key->m_k2;
+    for (uint32_t i = 0; i < 16; i++)
+      out[i] ^= subkey[i];
+  }
+}
+
+/**
+ * Compute the CMACs of a number of lanes, m_nLanes lanes at a time.
+ */
+static void
+CmacLanes (LoRaWANCmacLane *lanes, uint32_t n)
+{
+  const uint32_t nLanes = LoRaWANCrypto::m_nLanes;
+  for (uint32_t base = 0; base < n; base += nLanes) {
+    const uint32_t m = std::min (nLanes, n - base);
+    LoRaWANCmacLane *lane = lanes + base;
+
+    const LoRaWANKey *keys[nLanes];
+    uint32_t nBlocks[nLanes];
+    uint32_t maxBlocks = 0;
+    uint8_t state[nLanes][16];
+    for (uint32_t j = 0; j < m; j++) {
+      keys[j] = lane[j].m_key;
+      nBlocks[j] = GetCmacBlocks (lane[j]);
+      maxBlocks = std::max (maxBlocks, nBlocks[j]);
+      memset (state[j], 0, 16);
+    }
+
+    // Lanes that are done are encrypted as well, their MAC is already stored
+    for (uint32_t block = 0; block < maxBlocks; block++) {
+      for (uint32_t j = 0; j < m; j++) {
+        if (block >= nBlocks[j])
+          continue;
+        uint8_t in[16];
+        GetCmacBlock (lane[j], block, nBlocks[j], in);
+        for (uint32_t i = 0; i < 16; i++)
+          state[j][i] ^= in[i];
+      }
+      EncryptLanes (keys, state, m);
+      for (uint32_t j = 0; j < m; j++)
+        if (block == nBlocks[j] - 1)
+          memcpy (lane[j].m_mac, state[j], 16);
+    }
+  }
+}
+
+void
+LoRaWANCrypto::Cmac (const LoRaWANKey &key, const uint8_t *data, uint32_t length, uint8_t mac[16])
+{
+  LoRaWANCmacLane lane;
+  lane.m_key = &key;
+  lane.m_prefix = 0;
+  lane.m_data = data;
+  lane.m_length = length;
+  CmacLanes (&lane, 1);
+  memcpy (mac, lane.m_mac, 16);
+}
+
+// Offsets in the MHDR and MACPayload of a data frame
+static const uint32_t g_devAddrOffset = 1;
+static const uint32_t g_fCtrlOffset = 5;
+static const uint32_t g_fCntOffset = 6;
+static const uint32_t g_fOptsOffset = 8;
+
+/**
+ * Make the B0 block of the MIC or the Ai blocks of the encryption of a frame.
+ */
+static void
+MakeFrameBlock (uint8_t block[16], uint8_t first, bool uplink, const uint8_t *frame, uint8_t last)
+{
+  block[0] = first;
+  block[1] = block[2] = block[3] = block[4] = 0;
+  block[5] = uplink ? 0 : 1;
+  memcpy (block + 6, frame + g_devAddrOffset, 4);
+  block[10] = frame[g_fCntOffset];
+  block[11] = frame[g_fCntOffset + 1];
+  block[12] = block[13] = 0; // the 16 most significant bits of the frame counter
+  block[14] = 0;
+  block[15] = last;
+}
+
+uint32_t
+LoRaWANCrypto::ComputeFrameMic (const LoRaWANKey &nwkSKey, bool uplink, const uint8_t *frame, uint32_t length)
+{
+  LoRaWANMicJob job;
+  job.m_key = &nwkSKey;
+  job.m_frame = frame;
+  job.m_length = length;
+  job.m_uplink = uplink;
+  ComputeFrameMics (&job, 1);
+  return job.m_mic;
+}
+
+void
+LoRaWANCrypto::ComputeFrameMics (LoRaWANMicJob *jobs, uint32_t n)
+{
+  for (uint32_t base = 0; base < n; base += m_nLanes) {
+    const uint32_t m = std::min (m_nLanes, n - base);
+    LoRaWANMicJob *job = jobs + base;
+
+    LoRaWANCmacLane lanes[m_nLanes];
+    uint8_t b0[m_nLanes][16];
+    for (uint32_t j = 0; j < m; j++) {
+      NS_ASSERT (job[j].m_length >= g_fOptsOffset && job[j].m_length < 256);
+      MakeFrameBlock (b0[j], 0x49, job[j].m_uplink, job[j].m_frame, job[j].m_length);
+      lanes[j].m_key = job[j].m_key;
+      lanes[j].m_prefix = b0[j];
+      lanes[j].m_data = job[j].m_frame;
+      lanes[j].m_length = job[j].m_length;
+    }
+    CmacLanes (lanes, m);
+    for (uint32_t j = 0; j < m; j++) {
+      const uint8_t *mac = lanes[j].m_mac;
+      job[j].m_mic = mac[0] | (mac[1] << 8) | (mac[2] << 16) | ((uint32_t)mac[3] << 24);
+    }
+  }
+}
+
+uint32_t
+LoRaWANCrypto::CryptFrame (const LoRaWANKey &nwkSKey, const LoRaWANKey &appSKey, bool uplink, uint8_t *frame, uint32_t length)
+{
+  NS_ASSERT (length >= g_fOptsOffset);
+
+  // The FPort follows the frame options, there is no FRMPayload without it
+  const uint32_t offset = g_fOptsOffset + (frame[g_fCtrlOffset] & 0x0f) + 1;
+  if (offset >= length)
+    return length;
+  const LoRaWANKey *key = frame[offset - 1] == 0 ? &nwkSKey : &appSKey;
+
+  // The FRMPayload is XORed with the encrypted Ai blocks, i = 1, 2, ...
+  const LoRaWANKey *keys[m_nLanes];
+  for (uint32_t j = 0; j < m_nLanes; j++)
+    keys[j] = key;
+  uint8_t blocks[m_nLanes][16];
+  const uint32_t nBlocks = (length - offset + 15) / 16;
+  for (uint32_t base = 0; base < nBlocks; base += m_nLanes) {
+    const uint32_t m = std::min (m_nLanes, nBlocks - base);
+    for (uint32_t j = 0; j < m; j++)
+      MakeFrameBlock (blocks[j], 0x01, uplink, frame, base + j + 1);
+    EncryptLanes (keys, blocks, m);
+    for (uint32_t j = 0; j < m; j++) {
+      uint8_t *p = frame + offset + 16 * (base + j);
+      const uint32_t k = std::min<uint32_t> (16, frame + length - p);
+      for (uint32_t i = 0; i < k; i++)
+        p[i] ^= blocks[j][i];
+    }
+  }
+  return offset;
+}
+
+uint32_t
+LoRaWANCrypto::ComputeJoinMic (const LoRaWANKey &appKey, const uint8_t *frame, uint32_t length)
+{
+  uint8_t mac[16];
+  Cmac (appKey, frame, length, mac);
+  return mac[0] | (mac[1] << 8) | (mac[2] << 16) | ((uint32_t)mac[3] << 24);
+}
+
+void
+LoRaWANCrypto::EncryptJoinAccept (const LoRaWANKey &appKey, uint8_t *frame, uint32_t length)
+{
+  NS_ASSERT (length >= 1 && (length - 1) % 16 == 0);
+  for (uint32_t i = 1; i < length; i += 16)
+    Decrypt (appKey, frame + i, frame + i);
+}
+
+void
+LoRaWANCrypto::DecryptJoinAccept (const LoRaWANKey &appKey, uint8_t *frame, uint32_t length)
+{
+  NS_ASSERT (length >= 1 && (length - 1) % 16 == 0);
+  for (uint32_t i = 1; i < length; i += 16)
+    Encrypt (appKey, frame + i, frame + i);
+}
+
+void
+LoRaWANCrypto::SetPacketTail (Ptr<Packet> p, const uint8_t *tail, uint32_t length)
+{
+  NS_ASSERT (length <= p->GetSize ());
+  if (length == 0)
+    return;
+  p->RemoveAtEnd (length);
+  p->AddAtEnd (Create<Packet> (tail, length));
+}
+
+void
+LoRaWANCrypto::DeriveSessionKeys (const LoRaWANKey &appKey, uint32_t appNonce, uint32_t netId, uint16_t devNonce,
+                                  LoRaWANKey &nwkSKey, LoRaWANKey &appSKey)
+{
+  // 0x01 or 0x02 | AppNonce | NetID | DevNonce | pad16, in little endian order
+  uint8_t block[16] = {0};
+  for (uint32_t i = 0; i < 3; i++) {
+    block[1 + i] = appNonce >> (8 * i);
+    block[4 + i] = netId >> (8 * i);
+  }
+  block[7] = devNonce;
+  block[8] = devNonce >> 8;
+
+  uint8_t key[16];
+  block[0] = 0x01;
+  Encrypt (appKey, block, key);
+  nwkSKey.Set (key);
+  block[0] = 0x02;
+  Encrypt (appKey, block, key);
+  appSKey.Set (key);
+}
+
+// The key from which the default session keys and AppKeys are derived
+static const uint8_t g_rootKey[16] = {0x6e, 0x73, 0x2d, 0x33, 0x2d, 0x6c, 0x6f, 0x72,
+                                      0x61, 0x77, 0x61, 0x6e, 0x2d, 0x61, 0x62, 0x70}; // "ns-3-lorawan-abp"
+
+void
+LoRaWANCrypto::DeriveDefaultSessionKeys (uint32_t devAddr, LoRaWANKey &nwkSKey, LoRaWANKey &appSKey)
+{
+  static const LoRaWANKey root (g_rootKey);
+
+  uint8_t block[16] = {0};
+  for (uint32_t i = 0; i < 4; i++)
+    block[1 + i] = devAddr >> (8 * i);
+
+  uint8_t key[16];
+  block[0] = 0x01;
+  Encrypt (root, block, key);
+  nwkSKey.Set (key);
+  block[0] = 0x02;
+  Encrypt (root, block, key);
+  appSKey.Set (key);
+}
+
+void
+LoRaWANCrypto::DeriveDefaultAppKey (uint64_t devEui, LoRaWANKey &appKey)
+{
+  static const LoRaWANKey root (g_rootKey);
+
+  // 0x03 | DevEUI | pad16, the DevEUI in little endian order
+  uint8_t block[16] = {0};
+  block[0] = 0x03;
+  for (uint32_t i = 0; i < 8; i++)
+    block[1 + i] = devEui >> (8 * i);
+
+  uint8_t key[16];
+  Encrypt (root, block, key);
+  appKey.Set (key);
+}
+
+} // namespace ns3
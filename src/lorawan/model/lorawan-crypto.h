@@ -0,0 +1,223 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#ifndef LORAWAN_CRYPTO_H
+#define LORAWAN_CRYPTO_H
+
+#include <ns3/ptr.h>
+#include <stdint.h>
+#include <string>
+
+namespace ns3 {
+
+class Packet;
+
+/**
+ * \ingroup lorawan
+ *
+ * An AES-128 key with its expanded key schedule and the CMAC subkeys, so
+ * that the key is expanded once when it is set instead of for every frame.
+ */
+class LoRaWANKey
+{
+public:
+  /**
+   * The all zero key.
+   */
+  LoRaWANKey ();
+  explicit LoRaWANKey (const uint8_t key[16]);
+
+  void Set (const uint8_t key[16]);
+  void Get (uint8_t key[16]) const;
+
+  /**
+   * \param hex the key as 32 hexadecimal digits
+   * \return false if hex is not a valid key, the key is not changed then
+   */
+  bool SetHex (std::string hex);
+  std::string GetHex (void) const;
+
+  bool operator== (const LoRaWANKey &other) const;
+  bool operator!= (const LoRaWANKey &other) const;
+
+  uint8_t m_key[16];
+  uint8_t m_roundKeys[176]; //!< The 11 round keys
+  uint8_t m_k1[16];  //!< CMAC subkey K1
+  uint8_t m_k2[16];  //!< CMAC subkey K2
+};
+
+/**
+ * \ingroup lorawan
+ *
+ * A MIC computation for LoRaWANCrypto::ComputeFrameMics.
+ */
+typedef struct LoRaWANMicJob {
+  const LoRaWANKey *m_key;  //!< The NwkSKey
+  const uint8_t *m_frame;   //!< MHDR and MACPayload, without the MIC
+  uint32_t m_length;        //!< Length of m_frame
+  bool m_uplink;            //!< Direction of the frame
+  uint32_t m_mic;           //!< The computed MIC, the bytes of the MIC in little endian order
+} LoRaWANMicJob;
+
+/**
+ * \ingroup lorawan
+ *
+ * The cryptographic functions of LoRaWAN 1.0: AES-128, AES-CMAC, the MIC and
+ * the encryption of the FRMPayload of data frames, the MIC of JoinRequests and
+ * JoinAccepts and the encryption of JoinAccepts, and the derivation of
+ * session keys.
+ *
+ * AES is implemented with lookup tables, and with the AES-NI instructions on
+ * x86 processors that support them (detected at run time). AES-NI encrypts
+ * several independent blocks in parallel, so ComputeFrameMics interleaves
+ * the CMACs of up to m_nLanes frames, which is how a network server verifies
+ * the MICs of many uplinks.
+ */
+class LoRaWANCrypto
+{
+public:
+  static const uint32_t m_nLanes = 4; //!< Frames of which the CMACs are interleaved
+
+  /**
+   * Encrypt a block.
+   */
+  static void Encrypt (const LoRaWANKey &key, const uint8_t in[16], uint8_t out[16]);
+
+  /**
+   * Decrypt a block. Only the network server decrypts, once per JoinAccept,
+   * so decryption always uses the portable implementation.
+   */
+  static void Decrypt (const LoRaWANKey &key, const uint8_t in[16], uint8_t out[16]);
+
+  /**
+   * AES-CMAC (RFC 4493).
+   */
+  static void Cmac (const LoRaWANKey &key, const uint8_t *data, uint32_t length, uint8_t mac[16]);
+
+  /**
+   * Compute the MIC of a data frame, using the DevAddr and FCnt of its frame
+   * header.
+   *
+   * \param nwkSKey the network session key
+   * \param uplink the direction of the frame
+   * \param frame the MHDR and MACPayload
+   * \param length the length of frame
+   * \return the MIC, the bytes of the MIC in little endian order
+   */
+  static uint32_t ComputeFrameMic (const LoRaWANKey &nwkSKey, bool uplink, const uint8_t *frame, uint32_t length);
+
+  /**
+   * Compute the MICs of a batch of data frames.
+   *
+   * \param jobs the frames, m_mic is set
+   * \param n the number of frames
+   */
+  static void ComputeFrameMics (LoRaWANMicJob *jobs, uint32_t n);
+
+  /**
+   * Encrypt or decrypt the FRMPayload of a data frame in place. The
+   * FRMPayload of FPort 0 (MAC commands) is encrypted with the NwkSKey, other
+   * FRMPayloads with the AppSKey.
+   *
+   * \param nwkSKey the network session key
+   * \param appSKey the application session key
+   * \param uplink the direction of the frame
+   * \param frame the MHDR and MACPayload
+   * \param length the length of frame
+   * \return the offset of the FRMPayload in frame, length if there is no FRMPayload
+   */
+  static uint32_t CryptFrame (const LoRaWANKey &nwkSKey, const LoRaWANKey &appSKey, bool uplink, uint8_t *frame, uint32_t length);
+
+  /**
+   * Compute the MIC of a JoinRequest or a JoinAccept, the AES-CMAC of the
+   * MHDR and the join payload with the AppKey.
+   *
+   * \param appKey the AppKey of the end device
+   * \param frame the MHDR and the JoinRequest or the decrypted JoinAccept
+   * \param length the length of frame
+   * \return the MIC, the bytes of the MIC in little endian order
+   */
+  static uint32_t ComputeJoinMic (const LoRaWANKey &appKey, const uint8_t *frame, uint32_t length);
+
+  /**
+   * Encrypt a JoinAccept and its MIC in place, as the network server does.
+   * The blocks that follow the MHDR are decrypted with the AppKey, so that an
+   * end device only needs AES encryption to read the JoinAccept.
+   *
+   * \param appKey the AppKey of the end device
+   * \param frame the MHDR, the JoinAccept and the MIC
+   * \param length the length of frame, the MHDR and a multiple of 16 bytes
+   */
+  static void EncryptJoinAccept (const LoRaWANKey &appKey, uint8_t *frame, uint32_t length);
+
+  /**
+   * Decrypt a JoinAccept and its MIC in place, as an end device does.
+   *
+   * \see EncryptJoinAccept
+   */
+  static void DecryptJoinAccept (const LoRaWANKey &appKey, uint8_t *frame, uint32_t length);
+
+  /**
+   * Replace the last bytes of a packet, e.g. by the (de)crypted FRMPayload.
+   * The headers and the packet tags of the packet are kept.
+   */
+  static void SetPacketTail (Ptr<Packet> p, const uint8_t *tail, uint32_t length);
+
+  /**
+   * Derive the session keys of over-the-air activation from the AppKey and
+   * the nonces of the JoinRequest and JoinAccept.
+   */
+  static void DeriveSessionKeys (const LoRaWANKey &appKey, uint32_t appNonce, uint32_t netId, uint16_t devNonce,
+                                 LoRaWANKey &nwkSKey, LoRaWANKey &appSKey);
+
+  /**
+   * Derive the session keys of an end device that is activated by
+   * personalization from its device address. Both the MAC of the end device
+   * and the network server use these keys unless other keys are set, so that
+   * no keys have to be configured.
+   */
+  static void DeriveDefaultSessionKeys (uint32_t devAddr, LoRaWANKey &nwkSKey, LoRaWANKey &appSKey);
+
+  /**
+   * Derive the AppKey of an end device that joins by over-the-air activation
+   * from its DevEUI, for end devices of which no AppKey is configured. Every
+   * end device has its own AppKey then, so that an end device does not
+   * accept the JoinAccepts of other end devices.
+   */
+  static void DeriveDefaultAppKey (uint64_t devEui, LoRaWANKey &appKey);
+
+  /**
+   * \return whether the processor supports AES-NI
+   */
+  static bool HaveAesNi (void);
+
+  /**
+   * Use AES-NI if the processor supports it (the default), or the portable
+   * implementation, e.g. to compare both.
+   */
+  static void SetUseAesNi (bool useAesNi);
+  static bool GetUseAesNi (void);
+
+private:
+  static bool m_useAesNi;
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_CRYPTO_H */
@@ -43,9 +43,15 @@
 #include "lorawan-net-device.h"
 #include "lorawan-enddevice-application.h"
 #include "lorawan-frame-header.h"
+#include "lorawan-mac-command.h"
+#include "lorawan-join-header.h"
+#include "lorawan-airtime.h"
+#include "lorawan-crypto.h"
 #include "ns3/udp-socket-factory.h"
 #include "ns3/string.h"
 #include "ns3/pointer.h"
+#include <algorithm>
+#include <cmath>
 
 namespace ns3 {
 
@@ -59,7 +65,10 @@ LoRaWANEndDeviceApplication::GetTypeId (void)
   // Construct default value for the channel random variable:
   std::stringstream channelRandomVariableSS;
   const uint32_t channelRandomVariableDefaultMin = 0;
-  const uint32_t channelRandomVariableDefaultMax = (LoRaWAN::m_supportedChannels.size () - 1) - 1; // additional -1 as not to use the 10% RDC channel as an upstream channel
+  uint32_t nUplinkChannels = 1;
+  for (uint8_t dr = 0; dr < LoRaWAN::m_supportedDataRates.size (); dr++)
+    nUplinkChannels = std::max<uint32_t> (nUplinkChannels, LoRaWAN::GetUplinkChannels (dr).size ());
+  const uint32_t channelRandomVariableDefaultMax = nUplinkChannels - 1; // e.g. the 10% RDC channel in EU868 is not an upstream channel
   channelRandomVariableSS << "ns3::UniformRandomVariable[Min=" << channelRandomVariableDefaultMin << "|Max=" << channelRandomVariableDefaultMax << "]";
   std::cout << "LoRaWANEndDeviceApplication::GetTypeId: " << channelRandomVariableSS.str() << std::endl;
 
@@ -82,6 +91,11 @@ LoRaWANEndDeviceApplication::GetTypeId (void)
                    BooleanValue (false),
                    MakeBooleanAccessor (&LoRaWANEndDeviceApplication::m_confirmedData),
                    MakeBooleanChecker ())
+    .AddAttribute ("ADR",
+                   "Set the ADR bit in US packets, so that the network server controls the data rate and TX power of this end device.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&LoRaWANEndDeviceApplication::m_adr),
+                   MakeBooleanChecker ())
     .AddAttribute ("ChannelRandomVariable", "A RandomVariableStream used to pick the channel for upstream transmissions.",
                    StringValue (channelRandomVariableSS.str ()),
                    MakePointerAccessor (&LoRaWANEndDeviceApplication::m_channelRandomVariable),
@@ -97,12 +111,50 @@ LoRaWANEndDeviceApplication::GetTypeId (void)
                    UintegerValue (0),
                    MakeUintegerAccessor (&LoRaWANEndDeviceApplication::m_maxBytes),
                    MakeUintegerChecker<uint64_t> ())
+    .AddAttribute ("OTAA",
+                   "Join the network by over-the-air activation before sending US data. "
+                   "False means the end device is activated by personalization, with the device address assigned by LoRaWANHelper.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&LoRaWANEndDeviceApplication::m_otaa),
+                   MakeBooleanChecker ())
+    .AddAttribute ("DevEUI",
+                   "The DevEUI sent in JoinRequests, zero means the node id plus one.",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&LoRaWANEndDeviceApplication::m_devEui),
+                   MakeUintegerChecker<uint64_t> ())
+    .AddAttribute ("AppEUI",
+                   "The AppEUI sent in JoinRequests.",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&LoRaWANEndDeviceApplication::m_appEui),
+                   MakeUintegerChecker<uint64_t> ())
+    .AddAttribute ("AppKey",
+                   "The AppKey as 32 hexadecimal digits, which signs the JoinRequests and JoinAccepts and from which "
+                   "the session keys are derived when the end device joins. It should equal the AppKey of the end device in the network server (see "
+                   "LoRaWANNetworkServer::SetAppKey). Empty means the AppKey derived from the DevEUI, which is the default "
+                   "of the network server as well (see LoRaWANCrypto::DeriveDefaultAppKey).",
+                   StringValue (""),
+                   MakeStringAccessor (&LoRaWANEndDeviceApplication::m_appKey),
+                   MakeStringChecker ())
+    .AddAttribute ("JoinBackoffBase",
+                   "The maximum random back-off before the second JoinRequest of a join. "
+                   "The maximum back-off doubles with every JoinRequest, up to JoinBackoffMax.",
+                   TimeValue (Seconds (10)),
+                   MakeTimeAccessor (&LoRaWANEndDeviceApplication::m_joinBackoffBase),
+                   MakeTimeChecker (Seconds (0)))
+    .AddAttribute ("JoinBackoffMax",
+                   "The upper limit of the maximum random back-off between JoinRequests.",
+                   TimeValue (Seconds (3600)),
+                   MakeTimeAccessor (&LoRaWANEndDeviceApplication::m_joinBackoffMax),
+                   MakeTimeChecker (Seconds (0)))
     .AddTraceSource ("USMsgTransmitted", "An US message is sent",
                      MakeTraceSourceAccessor (&LoRaWANEndDeviceApplication::m_usMsgTransmittedTrace),
                      "ns3::Packet::TracedCallback")
-    .AddTraceSource ("DSMsgReceived", "An acknowledgement for an US message has been received.",
+    .AddTraceSource ("DSMsgReceived", "A DS message has been received in RW1 (1), RW2 (2) or, by a Class C end device, in between uplinks (0).",
                      MakeTraceSourceAccessor (&LoRaWANEndDeviceApplication::m_dsMsgReceivedTrace),
                      "ns3::Packet::TracedCallback")
+    .AddTraceSource ("Joined", "The end device received a JoinAccept and has a new session.",
+                     MakeTraceSourceAccessor (&LoRaWANEndDeviceApplication::m_joinedTrace),
+                     "ns3::LoRaWANEndDeviceApplication::JoinedTracedCallback")
   ;
   return tid;
 }
@@ -117,10 +169,19 @@ LoRaWANEndDeviceApplication::LoRaWANEndDeviceApplication ()
     m_fCntUp (0),
     m_fCntDown (0),
     m_setAck (false),
-    m_totalRx (0)
+    m_macAnswers (),
+    m_totalRx (0),
+    m_otaa (false),
+    m_joined (false),
+    m_devEui (0),
+    m_appEui (0),
+    m_devNonce (0),
+    m_nJoinRequests (0)
 {
   NS_LOG_FUNCTION (this);
 
+  m_joinRandomVariable = CreateObject<UniformRandomVariable> ();
+
   //m_channelRandomVariable = CreateObject <UniformRandomVariable> (); // random variable between 0 and size(channels) - 2
   //m_channelRandomVariable->SetAttribute ("Min", DoubleValue (0.0));
   //const uint32_t max = (LoRaWAN::m_supportedChannels.size () - 1) - 1; // additional -1 as not to use the 10% RDC channel as an upstream channel
@@ -150,7 +211,7 @@ LoRaWANEndDeviceApplication::SetDataRateIndex (uint32_t index)
 {
   NS_LOG_FUNCTION (this << index);
 
-  if (index <= LoRaWAN::m_supportedDataRates.size () - 1)
+  if (index < LoRaWAN::m_supportedDataRates.size () && LoRaWAN::IsUplinkDataRate (index))
     m_dataRateIndex = index;
   else
     NS_LOG_ERROR (this << " " << index << " is an invalid data rate index");
@@ -169,7 +230,48 @@ LoRaWANEndDeviceApplication::AssignStreams (int64_t stream)
   NS_LOG_FUNCTION (this << stream);
   m_channelRandomVariable->SetStream (stream);
   m_upstreamIATRandomVariable->SetStream (stream + 1);
-  return 2;
+  m_joinRandomVariable->SetStream (stream + 2);
+  return 3;
+}
+
+void
+LoRaWANEndDeviceApplication::Rejoin (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  if (!m_otaa) {
+    NS_LOG_WARN (this << " Rejoin requires OTAA");
+    return;
+  }
+
+  CancelEvents ();
+  StartJoin ();
+}
+
+bool
+LoRaWANEndDeviceApplication::IsJoined (void) const
+{
+  return !m_otaa || m_joined;
+}
+
+uint64_t
+LoRaWANEndDeviceApplication::GetDevEui (void) const
+{
+  return m_devEui != 0 ? m_devEui : GetNode ()->GetId () + 1;
+}
+
+void
+LoRaWANEndDeviceApplication::DoInitialize (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  // An end device that did not join yet has no device address, so that the
+  // network server does not populate its end device table with it
+  if (m_otaa)
+    GetNode ()->GetDevice (0)->SetAddress (Ipv4Address::GetAny ());
+
+  // chain up
+  Application::DoInitialize ();
 }
 
 void
@@ -212,7 +314,10 @@ void LoRaWANEndDeviceApplication::StartApplication () // Called at time specifie
   // If we are not yet connected, there is nothing to do here
   // The ConnectionComplete upcall will start timers at that time
   //if (!m_connected) return;
-  m_txEvent = Simulator::ScheduleNow (&LoRaWANEndDeviceApplication::SendPacket, this);
+  if (m_otaa && !m_joined)
+    StartJoin ();
+  else
+    m_txEvent = Simulator::ScheduleNow (&LoRaWANEndDeviceApplication::SendPacket, this);
 }
 
 void LoRaWANEndDeviceApplication::StopApplication () // Called at time specified by Stop
@@ -235,6 +340,7 @@ void LoRaWANEndDeviceApplication::CancelEvents ()
   NS_LOG_FUNCTION (this);
 
   Simulator::Cancel (m_txEvent);
+  Simulator::Cancel (m_joinEvent);
 }
 
 
@@ -265,17 +371,35 @@ void LoRaWANEndDeviceApplication::SendPacket ()
   Ipv4Address myAddress = Ipv4Address::ConvertFrom (GetNode ()->GetDevice (0)->GetAddress ());
   LoRaWANFrameHeader fhdr;
   fhdr.setDevAddr (myAddress);
+  fhdr.setAdr (m_adr);
   fhdr.setAck (m_setAck);
   fhdr.setFramePending (false);
   fhdr.setFrameCounter (m_fCntUp++); // increment frame counter
   // FPort: we will send FRMPayload so set the frame port
   fhdr.setFramePort (m_framePort);
 
+  // Piggyback the answers to MAC commands in the frame options, answers that
+  // do not fit are sent in the next US packet
+  if (!m_macAnswers.empty ()) {
+    const uint32_t maxLength = std::min<uint32_t> (LORAWAN_FHDR_MAX_FOPTSLEN, m_pktSize > 8 + 1 + 4 ? m_pktSize - (8 + 1 + 4) : 0);
+    uint32_t length = 0;
+    while (length < m_macAnswers.size ()) {
+      const uint8_t answerLength = LoRaWANGetMacCommandLength (m_macAnswers[length], false);
+      if (length + answerLength > maxLength)
+        break;
+      length += answerLength;
+    }
+    if (length > 0) {
+      fhdr.setFrameOptions (&m_macAnswers[0], length);
+      m_macAnswers.erase (m_macAnswers.begin (), m_macAnswers.begin () + length);
+    }
+  }
+
   // Construct MACPayload
   // PHYPayload: MHDR | MACPayload | MIC
   // MACPayload: FHDR | FPort | FRMPayload
   Ptr<Packet> packet;
-  uint8_t frmPayloadSize = m_pktSize  - fhdr.GetSerializedSize() - 1 - 4;  // subtract 8 bytes for frame header, 1B for MAC header and 4B for MAC MIC
+  uint8_t frmPayloadSize = m_pktSize  - fhdr.GetSerializedSize() - 1 - 4;  // subtract 8 bytes plus the frame options for frame header, 1B for MAC header and 4B for MAC MIC
   if (frmPayloadSize >= sizeof(uint64_t)) { // check whether payload size is large enough to hold 64 bit integer
     // send decrementing counter as payload (note: globally shared counter)
     uint8_t* payload = new uint8_t[frmPayloadSize](); // the parenthesis initialize the allocated memory to zero
@@ -294,8 +418,11 @@ void LoRaWANEndDeviceApplication::SendPacket ()
   packet->AddHeader (fhdr); // Packet now represents MACPayload
 
   // Select channel to use:
-  uint32_t channelIndex = m_channelRandomVariable->GetInteger ();
-  NS_ASSERT (channelIndex <= LoRaWAN::m_supportedChannels.size () - 2); // -2 because end devices should not use the special high power channel for US traffic
+  // The random variable indexes the uplink channels of the data rate, so
+  // end devices do not use e.g. the special high power channel for US traffic
+  const std::vector<uint8_t> &uplinkChannels = LoRaWAN::GetUplinkChannels (m_dataRateIndex);
+  NS_ASSERT (!uplinkChannels.empty ());
+  uint32_t channelIndex = uplinkChannels[m_channelRandomVariable->GetInteger () % uplinkChannels.size ()];
 
   LoRaWANPhyParamsTag phyParamsTag;
   phyParamsTag.SetChannelIndex (channelIndex);
@@ -337,6 +464,97 @@ void LoRaWANEndDeviceApplication::SendPacket ()
   ScheduleNextTx ();
 }
 
+void LoRaWANEndDeviceApplication::StartJoin ()
+{
+  NS_LOG_FUNCTION (this);
+
+  m_joined = false;
+  m_nJoinRequests = 0;
+  m_joinStartTime = Simulator::Now ();
+  Ptr<LoRaWANNetDevice> netDevice = DynamicCast<LoRaWANNetDevice> (GetNode ()->GetDevice (0));
+  netDevice->SetAddress (Ipv4Address::GetAny ());
+
+  // The MAC computes the MIC of JoinRequests and verifies JoinAccepts with
+  // the AppKey
+  LoRaWANKey appKey;
+  if (m_appKey.empty () || !appKey.SetHex (m_appKey)) {
+    if (!m_appKey.empty ())
+      NS_LOG_ERROR (this << " Invalid AppKey " << m_appKey << ", using the default AppKey");
+    LoRaWANCrypto::DeriveDefaultAppKey (GetDevEui (), appKey);
+  }
+  netDevice->GetMac ()->SetAppKey (appKey);
+  m_joinEvent = Simulator::ScheduleNow (&LoRaWANEndDeviceApplication::SendJoinRequest, this);
+}
+
+void LoRaWANEndDeviceApplication::SendJoinRequest ()
+{
+  NS_LOG_FUNCTION (this);
+
+  NS_ASSERT (m_joinEvent.IsExpired ());
+
+  // The DevNonce is random, so the network server may reject a JoinRequest
+  // of which the DevNonce was used before by this end device
+  const uint16_t devNonce = m_joinRandomVariable->GetInteger (0, 0xFFFF);
+  m_devNonce = devNonce;
+  LoRaWANJoinRequestHeader joinRequest (m_appEui, GetDevEui (), devNonce);
+  Ptr<Packet> packet = Create<Packet> (0);
+  packet->AddHeader (joinRequest);
+
+  const std::vector<uint8_t> &uplinkChannels = LoRaWAN::GetUplinkChannels (m_dataRateIndex);
+  NS_ASSERT (!uplinkChannels.empty ());
+  uint32_t channelIndex = uplinkChannels[m_channelRandomVariable->GetInteger () % uplinkChannels.size ()];
+
+  LoRaWANPhyParamsTag phyParamsTag;
+  phyParamsTag.SetChannelIndex (channelIndex);
+  phyParamsTag.SetDataRateIndex (m_dataRateIndex);
+  phyParamsTag.SetCodeRate (3);
+  packet->AddPacketTag (phyParamsTag);
+
+  LoRaWANMsgTypeTag msgTypeTag;
+  msgTypeTag.SetMsgType (LORAWAN_JOIN_REQUEST);
+  packet->AddPacketTag (msgTypeTag);
+
+  m_usMsgTransmittedTrace (Ipv4Address::GetAny ().Get (), msgTypeTag.GetMsgType (), packet);
+
+  Ptr<LoRaWANNetDevice> netDevice = DynamicCast<LoRaWANNetDevice> (GetNode ()->GetDevice (0));
+  netDevice->SetMTUSpreadingFactor(LoRaWAN::m_supportedDataRates [m_dataRateIndex].spreadingFactor);
+
+  int16_t r = m_socket->Send (packet);
+  if (r < 0) {
+    NS_LOG_ERROR(this << "PacketSocket::Send failed and returned " << static_cast<int16_t>(r) << ". Errno is set to " << m_socket->GetErrno ());
+  } else {
+    NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds ()
+        << "s LoRaWANEndDevice application on node #"
+        << GetNode()->GetId()
+        << " sent JoinRequest with DevNonce " << devNonce);
+  }
+  m_nJoinRequests++;
+
+  // Send the next JoinRequest when no JoinAccept was received in the RWs of
+  // this one, after a random back-off of which the maximum doubles with every
+  // JoinRequest. JoinRequests also respect the join duty cycle of the EU868
+  // regional parameters: 1% in the first hour of a join, 0.1% in the next 10
+  // hours and 0.01% afterwards.
+  const Time airTime = LoRaWANAirtime::GetTimeOnAir (m_dataRateIndex, 3, 1 + joinRequest.GetSerializedSize () + 4);
+  const Time acceptAirTime = LoRaWANAirtime::GetTimeOnAir (LoRaWAN::m_RW2DataRateIndex, 3, 1 + LoRaWANJoinAcceptHeader ().GetSerializedSize () + 4);
+  const Time joinTime = Simulator::Now () - m_joinStartTime;
+  uint32_t dutyCycleLimit = 100;
+  if (joinTime >= Seconds (11 * 3600))
+    dutyCycleLimit = 10000;
+  else if (joinTime >= Seconds (3600))
+    dutyCycleLimit = 1000;
+  const Time timeOff = std::max (airTime + MicroSeconds (JOIN_ACCEPT_DELAY2) + acceptAirTime, airTime * (dutyCycleLimit - 1));
+
+  Time maxBackoff = m_joinBackoffBase;
+  for (uint32_t k = 1; k < m_nJoinRequests && maxBackoff < m_joinBackoffMax; k++)
+    maxBackoff = maxBackoff * 2;
+  maxBackoff = std::min (maxBackoff, m_joinBackoffMax);
+  const Time backoff = Seconds (m_joinRandomVariable->GetValue (0.0, maxBackoff.GetSeconds ()));
+
+  NS_LOG_LOGIC (this << " next JoinRequest in " << timeOff + backoff);
+  m_joinEvent = Simulator::Schedule (timeOff + backoff, &LoRaWANEndDeviceApplication::SendJoinRequest, this);
+}
+
 void LoRaWANEndDeviceApplication::HandleRead (Ptr<Socket> socket)
 {
   NS_LOG_FUNCTION (this << socket);
@@ -386,12 +604,17 @@ LoRaWANEndDeviceApplication::HandleDSPacket (Ptr<Packet> p, Address from)
     NS_LOG_WARN (this << " LoRaWANMsgTypeTag packet tag is missing from packet");
   }
 
+  if (msgTypeTag.GetMsgType () == LORAWAN_JOIN_ACCEPT)
+    HandleJoinAccept (p);
+  else
+    ProcessMacCommands (p);
+
   // Was packet received in first or second receive window?
   // -> Look at Mac state
   Ptr<LoRaWANNetDevice> netDevice = DynamicCast<LoRaWANNetDevice> (GetNode ()->GetDevice (0));
   Ptr<LoRaWANMac> mac = netDevice->GetMac ();
   LoRaWANMacState state = mac->GetLoRaWANMacState ();
-  NS_ASSERT (state == MAC_RW1 || state == MAC_RW2);
+  NS_ASSERT (state == MAC_RW1 || state == MAC_RW2 || netDevice->GetDeviceType () == LORAWAN_DT_END_DEVICE_CLASS_C);
 
   // Log packet reception
   Ipv4Address myAddress = Ipv4Address::ConvertFrom (GetNode ()->GetDevice (0)->GetAddress ());
@@ -400,6 +623,164 @@ LoRaWANEndDeviceApplication::HandleDSPacket (Ptr<Packet> p, Address from)
     m_dsMsgReceivedTrace (deviceAddress, msgTypeTag.GetMsgType(), p, 1);
   else if (state == MAC_RW2)
     m_dsMsgReceivedTrace (deviceAddress, msgTypeTag.GetMsgType(), p, 2);
+  else // Class C end device, in between uplinks
+    m_dsMsgReceivedTrace (deviceAddress, msgTypeTag.GetMsgType(), p, 0);
+}
+
+void
+LoRaWANEndDeviceApplication::ProcessMacCommands (Ptr<const Packet> p)
+{
+  NS_LOG_FUNCTION (this << p);
+
+  // The frame port is only present when there is a FRMPayload, the length of
+  // the frame options is only known after peeking at the frame header
+  Ptr<Packet> payload = p->Copy ();
+  LoRaWANFrameHeader fhdr;
+  payload->PeekHeader (fhdr);
+  fhdr.setSerializeFramePort (payload->GetSize () > fhdr.GetSerializedSize ());
+  payload->RemoveHeader (fhdr);
+
+  double snr = 0.0;
+  LoRaWANRxMetadataTag rxMetadataTag;
+  if (p->PeekPacketTag (rxMetadataTag))
+    snr = rxMetadataTag.GetSnr ();
+
+  if (fhdr.getFrameOptionsLength () > 0) {
+    uint8_t frameOptions[LORAWAN_FHDR_MAX_FOPTSLEN];
+    const uint8_t length = fhdr.getFrameOptions (frameOptions);
+    ExecuteMacCommands (Create<Packet> (frameOptions, length), snr);
+  }
+  if (fhdr.getSerializeFramePort () && fhdr.getFramePort () == LORAWAN_MAC_COMMAND_FRAME_PORT)
+    ExecuteMacCommands (payload, snr);
+}
+
+void
+LoRaWANEndDeviceApplication::ExecuteMacCommands (Ptr<Packet> commands, double snr)
+{
+  NS_LOG_FUNCTION (this << commands << snr);
+
+  Ptr<LoRaWANNetDevice> netDevice = DynamicCast<LoRaWANNetDevice> (GetNode ()->GetDevice (0));
+  Ptr<LoRaWANMac> mac = netDevice->GetMac ();
+  while (commands->GetSize () > 0) {
+    uint8_t cid;
+    commands->CopyData (&cid, 1);
+    const uint8_t length = LoRaWANGetMacCommandLength (cid, true);
+    if (length == 0 || commands->GetSize () < length) {
+      NS_LOG_WARN (this << " Unsupported MAC command with CID " << (uint32_t)cid << ", ignoring remaining MAC commands");
+      break;
+    }
+
+    if (cid == LORAWAN_CID_LINK_ADR) {
+      LoRaWANLinkAdrReqHeader linkAdrReq;
+      commands->RemoveHeader (linkAdrReq);
+      NS_LOG_DEBUG (this << " Received LinkADRReq: DR" << (uint32_t)linkAdrReq.GetDataRateIndex () << ", TX power index " << (uint32_t)linkAdrReq.GetTxPowerIndex ());
+
+      // A value of 0xF means that the current setting should be kept. A
+      // setting is only acked when it was applied, so that the network
+      // server does not assume a data rate or TX power that is not used.
+      uint8_t status = 0x01; // channel mask ack
+      if (linkAdrReq.GetDataRateIndex () != 0xF)
+        SetDataRateIndex (linkAdrReq.GetDataRateIndex ());
+      if (linkAdrReq.GetDataRateIndex () == 0xF || GetDataRateIndex () == linkAdrReq.GetDataRateIndex ())
+        status |= 0x02; // data rate ack
+      if (linkAdrReq.GetTxPowerIndex () != 0xF)
+        mac->SetTxPowerIndex (linkAdrReq.GetTxPowerIndex ());
+      if (linkAdrReq.GetTxPowerIndex () == 0xF || mac->GetTxPowerIndex () == linkAdrReq.GetTxPowerIndex ())
+        status |= 0x04; // power ack
+
+      m_macAnswers.push_back (LORAWAN_CID_LINK_ADR);
+      m_macAnswers.push_back (status);
+    } else if (cid == LORAWAN_CID_DUTY_CYCLE) {
+      LoRaWANDutyCycleReqHeader dutyCycleReq;
+      commands->RemoveHeader (dutyCycleReq);
+      NS_LOG_DEBUG (this << " Received DutyCycleReq: MaxDCycle " << (uint32_t)dutyCycleReq.GetMaxDutyCycle ());
+
+      mac->SetMaxDutyCycle (dutyCycleReq.GetMaxDutyCycle ());
+      m_macAnswers.push_back (LORAWAN_CID_DUTY_CYCLE);
+    } else if (cid == LORAWAN_CID_RX_PARAM_SETUP) {
+      LoRaWANRxParamSetupReqHeader rxParamSetupReq;
+      commands->RemoveHeader (rxParamSetupReq);
+      NS_LOG_DEBUG (this << " Received RXParamSetupReq: RX1DROffset " << (uint32_t)rxParamSetupReq.GetRx1DROffset () << ", RX2 DR" << (uint32_t)rxParamSetupReq.GetRx2DataRateIndex ());
+
+      // The second receive window is the same for all end devices, so only
+      // the RX1DROffset can be changed. The request is applied only when all
+      // of its settings are acknowledged.
+      uint8_t status = 0;
+      if (rxParamSetupReq.GetFrequency () == LoRaWAN::m_supportedChannels[LoRaWAN::m_RW2ChannelIndex].m_fc)
+        status |= 0x01; // channel ack
+      if (rxParamSetupReq.GetRx2DataRateIndex () == LoRaWAN::m_RW2DataRateIndex)
+        status |= 0x02; // RX2 data rate ack
+      if (rxParamSetupReq.GetRx1DROffset () <= 5)
+        status |= 0x04; // RX1DROffset ack
+      if (status == 0x07)
+        mac->SetRX1DROffset (rxParamSetupReq.GetRx1DROffset ());
+
+      m_macAnswers.push_back (LORAWAN_CID_RX_PARAM_SETUP);
+      m_macAnswers.push_back (status);
+    } else if (cid == LORAWAN_CID_DEV_STATUS) {
+      LoRaWANDevStatusReqHeader devStatusReq;
+      commands->RemoveHeader (devStatusReq);
+      NS_LOG_DEBUG (this << " Received DevStatusReq");
+
+      // The battery level is not modelled
+      LoRaWANDevStatusAnsHeader devStatusAns (255, (int8_t)std::max (-32.0, std::min (31.0, std::round (snr))));
+      Ptr<Packet> answer = Create<Packet> (0);
+      answer->AddHeader (devStatusAns);
+      const uint32_t offset = m_macAnswers.size ();
+      m_macAnswers.resize (offset + answer->GetSize ());
+      answer->CopyData (&m_macAnswers[offset], answer->GetSize ());
+    } else {
+      // LinkCheckAns, which is not requested by this end device
+      commands->RemoveAtStart (length);
+    }
+  }
+}
+
+void
+LoRaWANEndDeviceApplication::HandleJoinAccept (Ptr<const Packet> p)
+{
+  NS_LOG_FUNCTION (this << p);
+
+  // With crypto, the MAC only delivers JoinAccepts of which the MIC matches
+  // the AppKey of this end device. Without crypto, the network server tags
+  // a JoinAccept with the DevEUI of the end device it is meant for.
+  Ptr<LoRaWANNetDevice> netDevice = DynamicCast<LoRaWANNetDevice> (GetNode ()->GetDevice (0));
+  BooleanValue crypto;
+  netDevice->GetMac ()->GetAttribute ("Crypto", crypto);
+  LoRaWANDevEuiTag devEuiTag;
+  if (!m_otaa || m_joined || (!crypto.Get () && (!p->PeekPacketTag (devEuiTag) || devEuiTag.GetDevEui () != GetDevEui ()))) {
+    NS_LOG_DEBUG (this << " Ignoring JoinAccept that is not meant for this end device");
+    return;
+  }
+
+  LoRaWANJoinAcceptHeader joinAccept;
+  p->PeekHeader (joinAccept);
+  NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds ()
+               << "s end device on node #" << GetNode()->GetId()
+               << " joined with device address " << joinAccept.GetDevAddr ()
+               << " after " << m_nJoinRequests << " JoinRequests");
+
+  Simulator::Cancel (m_joinEvent);
+  netDevice->SetAddress (joinAccept.GetDevAddr ());
+
+  // The JoinAccept answers the last JoinRequest, as the RWs of earlier
+  // JoinRequests are closed
+  LoRaWANKey nwkSKey;
+  LoRaWANKey appSKey;
+  LoRaWANCrypto::DeriveSessionKeys (netDevice->GetMac ()->GetAppKey (), joinAccept.GetAppNonce (), joinAccept.GetNetId (), m_devNonce, nwkSKey, appSKey);
+  netDevice->GetMac ()->SetSessionKeys (nwkSKey, appSKey);
+  netDevice->GetMac ()->SetRX1DROffset (joinAccept.GetRx1DROffset ());
+  netDevice->GetMac ()->SetMaxDutyCycle (0);
+  m_fCntUp = 0;
+  m_fCntDown = 0;
+  m_setAck = false;
+  m_macAnswers.clear ();
+  m_joined = true;
+
+  m_joinedTrace (joinAccept.GetDevAddr ().Get (), Simulator::Now () - m_joinStartTime, m_nJoinRequests);
+
+  // Start sending US data, as StartApplication does for an activated end device
+  m_txEvent = Simulator::ScheduleNow (&LoRaWANEndDeviceApplication::SendPacket, this);
 }
 
 void LoRaWANEndDeviceApplication::ConnectionSucceeded (Ptr<Socket> socket)
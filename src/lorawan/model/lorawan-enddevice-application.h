@@ -32,11 +32,15 @@
 #include "ns3/ptr.h"
 #include "ns3/data-rate.h"
 #include "ns3/traced-callback.h"
+#include "ns3/nstime.h"
+#include <vector>
+#include <string>
 
 namespace ns3 {
 
 class Address;
 class RandomVariableStream;
+class UniformRandomVariable;
 class Socket;
 
 /**
@@ -47,6 +51,11 @@ class Socket;
  * based of the OnOffApplication, though it has changed drastically in that
  * US messages are generated according to a random variable (can be fixed) and
  * not according to a CBR requirement.
+ *
+ * When OTAA is set, the end device first joins the network by over-the-air
+ * activation: it sends JoinRequests until a JoinAccept assigns it a device
+ * address, and only then starts sending US data. Until it joined, the end
+ * device has address 0.0.0.0.
 */
 class LoRaWANEndDeviceApplication : public Application
 {
@@ -89,7 +98,30 @@ public:
   */
   int64_t AssignStreams (int64_t stream);
 
+  /**
+   * Forget the current session and join the network again, as an end device
+   * does after a reboot. Only used when OTAA is set.
+   */
+  void Rejoin (void);
+
+  /**
+   * \return whether the end device has a session, always true without OTAA
+   */
+  bool IsJoined (void) const;
+
+  uint64_t GetDevEui (void) const;
+
+  /**
+   * TracedCallback signature for a completed join.
+   *
+   * \param [in] deviceAddr The device address assigned by the JoinAccept.
+   * \param [in] latency The time since the first JoinRequest of the join.
+   * \param [in] nJoinRequests The number of JoinRequests that were sent.
+   */
+  typedef void (* JoinedTracedCallback) (uint32_t deviceAddr, Time latency, uint32_t nJoinRequests);
+
 protected:
+  virtual void DoInitialize (void);
   virtual void DoDispose (void);
 private:
   // inherited from Application base class.
@@ -112,6 +144,38 @@ private:
 
   void HandleDSPacket (Ptr<Packet> p, Address from);
 
+  /**
+   * \brief Apply the MAC commands in the frame options of a DS packet and in
+   * its FRMPayload when it was sent on frame port 0
+   * \param p the DS packet, starting with the frame header
+   */
+  void ProcessMacCommands (Ptr<const Packet> p);
+
+  /**
+   * \brief Apply MAC commands and queue their answers for the next US packet
+   * \param commands the MAC commands, the packet is consumed
+   * \param snr SNR of the DS packet in dB, for the DevStatusAns
+   */
+  void ExecuteMacCommands (Ptr<Packet> commands, double snr);
+
+  /**
+   * \brief Start a join: reset the join state and send the first JoinRequest
+   */
+  void StartJoin ();
+
+  /**
+   * \brief Send a JoinRequest and schedule the next one in case no JoinAccept
+   * is received
+   */
+  void SendJoinRequest ();
+
+  /**
+   * \brief Start a session with the device address of a JoinAccept that is
+   * meant for this end device
+   * \param p the JoinAccept, starting with the LoRaWANJoinAcceptHeader
+   */
+  void HandleJoinAccept (Ptr<const Packet> p);
+
   Ptr<Socket>     m_socket;       //!< Associated socket
   bool            m_connected;    //!< True if connected
   Ptr<RandomVariableStream> m_channelRandomVariable;	//!< rng for channel selection for upstream TX
@@ -123,18 +187,37 @@ private:
   uint64_t        m_totBytes;     //!< Total bytes sent so far
   EventId         m_txEvent;     //!< Event id for next start or stop event
   bool 		  m_confirmedData; //<! Send upstream data as Confirmed Data Up MAC packets
+  bool            m_adr;          //!< Set the ADR bit in US packets
 
   uint8_t         m_framePort;	  //!< Frame port
   uint32_t        m_fCntUp;       //!< Uplink frame counter
   uint32_t        m_fCntDown;     //!< Downlink frame counter
   bool            m_setAck;      //!< Set the Ack bit in the next transmission
+  std::vector<uint8_t> m_macAnswers; //!< Answers to MAC commands, sent in the frame options of the next US packets
   uint64_t        m_totalRx;      //!< Total bytes received
 
+  // Over-the-air activation
+  bool            m_otaa;         //!< Join by over-the-air activation
+  bool            m_joined;       //!< Whether the end device has a session
+  uint64_t        m_devEui;       //!< DevEUI, zero means derived from the node id
+  uint64_t        m_appEui;       //!< AppEUI
+  std::string     m_appKey;       //!< AppKey, as hexadecimal digits
+  uint16_t        m_devNonce;     //!< DevNonce of the last JoinRequest
+  Time            m_joinBackoffBase; //!< Maximum back-off after the first JoinRequest of a join
+  Time            m_joinBackoffMax;  //!< Maximum back-off between JoinRequests
+  Ptr<UniformRandomVariable> m_joinRandomVariable; //!< rng for DevNonces and join back-offs
+  Time            m_joinStartTime; //!< Time of the first JoinRequest of the current join
+  uint32_t        m_nJoinRequests; //!< Number of JoinRequests sent in the current join
+  EventId         m_joinEvent;    //!< Event id for the next JoinRequest
+
   /// Traced Callback: transmitted packets.
   TracedCallback<uint32_t, uint8_t, Ptr<const Packet>> m_usMsgTransmittedTrace;
 
   /// Traced Callback: received packets, source address, receive window.
   TracedCallback<uint32_t, uint8_t, Ptr<const Packet>, uint8_t> m_dsMsgReceivedTrace;
+
+  /// Traced Callback: completed joins.
+  TracedCallback<uint32_t, Time, uint32_t> m_joinedTrace;
 private:
   /**
    * \brief Schedule the next packet transmission
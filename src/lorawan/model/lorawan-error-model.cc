@@ -19,6 +19,7 @@
  */
 #include "lorawan-error-model.h"
 #include <ns3/log.h>
+#include <ns3/boolean.h>
 
 #include <cmath>
 
@@ -35,11 +36,19 @@ LoRaWANErrorModel::GetTypeId (void)
     .SetParent<Object> ()
     .SetGroupName ("LoRaWAN")
     .AddConstructor<LoRaWANErrorModel> ()
+    .AddAttribute ("UseLookupTable",
+                   "Determine chunk success rates by means of a precomputed "
+                   "table of log(1 - BER) per spreading factor and code rate "
+                   "instead of evaluating the BER curves for every chunk.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&LoRaWANErrorModel::m_useLookupTable),
+                   MakeBooleanChecker ())
   ;
   return tid;
 }
 
 LoRaWANErrorModel::LoRaWANErrorModel (void)
+  : m_useLookupTable (false)
 {
   /**
   * Coefficients from exp1_log_model_curvefit_truncated_output.txt
@@ -97,10 +106,11 @@ LoRaWANErrorModel::LoRaWANErrorModel (void)
 double
 LoRaWANErrorModel::getBER (double snr_db, uint32_t bandWidth, LoRaSpreadingFactor spreadingFactor, uint8_t codeRate) const
 {
-  NS_ASSERT( bandWidth == 125e3 );
+  NS_ASSERT( bandWidth == 125e3 || bandWidth == 250e3 || bandWidth == 500e3 );
   NS_ASSERT( spreadingFactor == LORAWAN_SF7 || spreadingFactor == LORAWAN_SF8 || spreadingFactor == LORAWAN_SF9 || spreadingFactor == LORAWAN_SF10 || spreadingFactor == LORAWAN_SF11 || spreadingFactor == LORAWAN_SF12);
   NS_ASSERT( codeRate == 1 || codeRate == 3 );
-  // Note only bandwidth 125kHz is supported
+  // Note the BER curves were derived for 125kHz. The SNR is measured over the
+  // channel bandwidth, so the same curves are used for 250 and 500kHz channels.
 
   double snr_db_rounded = snr_db;
 
@@ -125,13 +135,7 @@ LoRaWANErrorModel::getBER (double snr_db, uint32_t bandWidth, LoRaSpreadingFacto
   }
 
   // Get index for coeffients in arrays:
-  uint8_t coefIndex = (spreadingFactor-7)*2;
-  if (codeRate == 3)
-    coefIndex+=1;
-
-  if (coefIndex >= LORAWAN_ERROR_MODEL_NR_COEFF) {
-    NS_FATAL_ERROR (this << "invalid coef index");
-  }
+  uint8_t coefIndex = GetCoefficientIndex (spreadingFactor, codeRate);
 
   // log10(BER) = a*exp(b*x) + c*exp(d*x) where x is the SNR in dB
   double log_ber = m_aCoefficients[coefIndex]*exp (m_bCoefficients[coefIndex]*snr_db_rounded);
@@ -145,27 +149,117 @@ LoRaWANErrorModel::getBER (double snr_db, uint32_t bandWidth, LoRaSpreadingFacto
 double
 LoRaWANErrorModel::GetChunkSuccessRate (double snr_db, uint32_t nbits, uint32_t bandWidth, LoRaSpreadingFactor spreadingFactor, uint8_t codeRate) const
 {
-  NS_ASSERT( bandWidth == 125e3 );
+  NS_ASSERT( bandWidth == 125e3 || bandWidth == 250e3 || bandWidth == 500e3 );
   NS_ASSERT( spreadingFactor == LORAWAN_SF7 || spreadingFactor == LORAWAN_SF8 || spreadingFactor == LORAWAN_SF9 || spreadingFactor == LORAWAN_SF10 || spreadingFactor == LORAWAN_SF11 || spreadingFactor == LORAWAN_SF12);
   NS_ASSERT( codeRate == 1 || codeRate == 3 );
 
-  double ber = getBER (snr_db, bandWidth, spreadingFactor, codeRate);
+  double retval;
+  if (m_useLookupTable)
+    {
+      // (1 - BER)^nbits = exp(nbits * log(1 - BER))
+      retval = exp (nbits * LookupLogSuccessRate (snr_db, GetCoefficientIndex (spreadingFactor, codeRate)));
+    }
+  else
+    {
+      double ber = getBER (snr_db, bandWidth, spreadingFactor, codeRate);
 
-  if (ber > 1.0)
-    NS_FATAL_ERROR (this << "BER is great than 1.0");
+      if (ber > 1.0)
+        NS_FATAL_ERROR (this << "BER is great than 1.0");
 
-  ber = std::min (ber, 1.0);
-  double retval = pow (1.0 - ber, nbits);
+      ber = std::min (ber, 1.0);
+      retval = pow (1.0 - ber, nbits);
+    }
 
   NS_LOG_LOGIC (this << " snr_db = " << snr_db << ", nbits = " << nbits << ", spreadingFactor = " << static_cast<uint32_t>(spreadingFactor) << ", codeRate = " << static_cast<uint32_t>(codeRate) << ". ChunkSuccesRate = " << retval);
 
   return retval;
 }
 
+void
+LoRaWANErrorModel::GetChunkSuccessRates (const std::vector<LoRaWANErrorModelChunk> &chunks, std::vector<double> &successRates) const
+{
+  NS_LOG_FUNCTION (this << chunks.size ());
+
+  const uint32_t n = chunks.size ();
+  successRates.resize (n);
+
+  if (!m_useLookupTable)
+    {
+      for (uint32_t i = 0; i < n; i++)
+        successRates[i] = GetChunkSuccessRate (chunks[i].snr_db, chunks[i].nbits, 125e3, chunks[i].spreadingFactor, chunks[i].codeRate);
+      return;
+    }
+
+  // First look up the exponents of all chunks, then evaluate all exponentials
+  // in a separate loop without branches so that the compiler can vectorize it
+  for (uint32_t i = 0; i < n; i++)
+    successRates[i] = chunks[i].nbits * LookupLogSuccessRate (chunks[i].snr_db, GetCoefficientIndex (chunks[i].spreadingFactor, chunks[i].codeRate));
+
+  double *rates = successRates.data ();
+  for (uint32_t i = 0; i < n; i++)
+    rates[i] = exp (rates[i]);
+}
+
+uint8_t
+LoRaWANErrorModel::GetCoefficientIndex (LoRaSpreadingFactor spreadingFactor, uint8_t codeRate)
+{
+  uint8_t coefIndex = (spreadingFactor-7)*2;
+  if (codeRate == 3)
+    coefIndex+=1;
+
+  if (coefIndex >= LORAWAN_ERROR_MODEL_NR_COEFF) {
+    NS_FATAL_ERROR ("LoRaWANErrorModel: invalid coef index");
+  }
+  return coefIndex;
+}
+
+const std::vector<double>&
+LoRaWANErrorModel::GetLookupTable (void) const
+{
+  // The curve fitting coefficients are the same for every error model, so a
+  // single table is shared by all error models
+  static std::vector<double> table;
+  if (table.empty ())
+    {
+      NS_LOG_LOGIC (this << " building lookup table");
+      table.resize (LORAWAN_ERROR_MODEL_NR_COEFF * LORAWAN_ERROR_MODEL_TABLE_SIZE);
+      for (uint8_t coefIndex = 0; coefIndex < LORAWAN_ERROR_MODEL_NR_COEFF; coefIndex++)
+        {
+          LoRaSpreadingFactor spreadingFactor = static_cast<LoRaSpreadingFactor> (7 + coefIndex / 2);
+          uint8_t codeRate = (coefIndex % 2) ? 3 : 1;
+          for (uint32_t i = 0; i < LORAWAN_ERROR_MODEL_TABLE_SIZE; i++)
+            {
+              double snr_db = LORAWAN_ERROR_MODEL_TABLE_MIN_SNR + static_cast<double> (i) / LORAWAN_ERROR_MODEL_TABLE_RESOLUTION;
+              double ber = std::min (getBER (snr_db, 125e3, spreadingFactor, codeRate), 1.0);
+              table[coefIndex * LORAWAN_ERROR_MODEL_TABLE_SIZE + i] = log1p (-ber);
+            }
+        }
+    }
+  return table;
+}
+
+double
+LoRaWANErrorModel::LookupLogSuccessRate (double snr_db, uint8_t coefIndex) const
+{
+  const double *row = &GetLookupTable ()[coefIndex * LORAWAN_ERROR_MODEL_TABLE_SIZE];
+
+  // getBER clamps the SNR to at most 0 dB and at least the minimum SNR of
+  // the spreading factor, which is not lower than the start of the table
+  double x = (snr_db - LORAWAN_ERROR_MODEL_TABLE_MIN_SNR) * LORAWAN_ERROR_MODEL_TABLE_RESOLUTION;
+  if (x <= 0.0)
+    return row[0];
+  if (x >= LORAWAN_ERROR_MODEL_TABLE_SIZE - 1)
+    return row[LORAWAN_ERROR_MODEL_TABLE_SIZE - 1];
+
+  uint32_t i = static_cast<uint32_t> (x);
+  double frac = x - i;
+  return row[i] + frac * (row[i + 1] - row[i]);
+}
+
 double
 LoRaWANErrorModel::getSNRCutoffForRX (uint32_t bandWidth, LoRaSpreadingFactor spreadingFactor, uint8_t codeRate) const
 {
-  NS_ASSERT( bandWidth == 125e3);
+  NS_ASSERT( bandWidth == 125e3 || bandWidth == 250e3 || bandWidth == 500e3 );
   NS_ASSERT( spreadingFactor == LORAWAN_SF7 || spreadingFactor == LORAWAN_SF8 || spreadingFactor == LORAWAN_SF9 || spreadingFactor == LORAWAN_SF10 || spreadingFactor == LORAWAN_SF11 || spreadingFactor == LORAWAN_SF12);
   NS_ASSERT( codeRate == 1 || codeRate == 3);
 
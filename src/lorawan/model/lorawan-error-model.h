@@ -22,6 +22,7 @@
 
 #include "lorawan.h"
 #include <ns3/object.h>
+#include <vector>
 
 namespace ns3 {
 
@@ -49,6 +50,31 @@ namespace ns3 {
  */
 #define LORAWAN_ERROR_MODEL_NR_COEFF 2*6
 
+/**
+ * In lookup table mode (see the UseLookupTable attribute), log(1 - BER) is
+ * tabulated for every spreading factor and coding rate on an SNR grid from
+ * LORAWAN_ERROR_MODEL_TABLE_MIN_SNR dB up to 0 dB, with
+ * LORAWAN_ERROR_MODEL_TABLE_RESOLUTION grid points per dB. Values in between
+ * grid points are linearly interpolated.
+ */
+#define LORAWAN_ERROR_MODEL_TABLE_MIN_SNR -26
+#define LORAWAN_ERROR_MODEL_TABLE_RESOLUTION 100
+#define LORAWAN_ERROR_MODEL_TABLE_SIZE (-LORAWAN_ERROR_MODEL_TABLE_MIN_SNR*LORAWAN_ERROR_MODEL_TABLE_RESOLUTION + 1)
+
+/**
+ * \ingroup lorawan
+ *
+ * A chunk of a LoRa reception for which the success rate has to be
+ * determined, see LoRaWANErrorModel::GetChunkSuccessRates
+ */
+typedef struct
+{
+  double snr_db;                       //!< SNR expressed in dB
+  uint32_t nbits;                      //!< number of bits in the chunk
+  LoRaSpreadingFactor spreadingFactor; //!< spreading factor of the reception
+  uint8_t codeRate;                    //!< code rate of the reception
+} LoRaWANErrorModelChunk;
+
 class LoRaWANErrorModel : public Object
 {
 public:
@@ -70,6 +96,17 @@ public:
    */
   double GetChunkSuccessRate (double snr_db, uint32_t nbits, uint32_t bandwidth, LoRaSpreadingFactor spreadingFactor, uint8_t codeRate) const;
 
+  /**
+   * Return the chunk success rates for a batch of chunks, e.g. the chunks of
+   * all concurrent receptions of a gateway. All chunks should use a 125 kHz
+   * bandwidth.
+   *
+   * \param chunks the chunks
+   * \param successRates the success rates of the chunks, in the same order
+   * as chunks (output)
+   */
+  void GetChunkSuccessRates (const std::vector<LoRaWANErrorModelChunk> &chunks, std::vector<double> &successRates) const;
+
   double getBER(double snr_db, uint32_t bandwidth, LoRaSpreadingFactor spreadingFactor, uint8_t codeRate) const;
 
   /**
@@ -80,11 +117,41 @@ public:
    */
   double getSNRCutoffForRX (uint32_t bandwidth, LoRaSpreadingFactor spreadingFactor, uint8_t codeRate) const;
 private:
+  /**
+   * \return the index of the curve fitting coefficients of a spreading
+   * factor and code rate
+   */
+  static uint8_t GetCoefficientIndex (LoRaSpreadingFactor spreadingFactor, uint8_t codeRate);
+
+  /**
+   * Look up log(1 - BER) in the lookup table.
+   *
+   * \param snr_db SNR expressed in dB
+   * \param coefIndex the index of the spreading factor and code rate (see
+   * GetCoefficientIndex)
+   * \return the natural logarithm of 1 - BER
+   */
+  double LookupLogSuccessRate (double snr_db, uint8_t coefIndex) const;
+
+  /**
+   * Get the lookup table, which is shared by all LoRaWANErrorModel objects
+   * and is built on first use.
+   *
+   * \return log(1 - BER) per grid point (index = coefIndex *
+   * LORAWAN_ERROR_MODEL_TABLE_SIZE + grid point)
+   */
+  const std::vector<double>& GetLookupTable (void) const;
+
   /**
    * Array of precalculated curve fitting coefficients.
    */
   double m_aCoefficients[LORAWAN_ERROR_MODEL_NR_COEFF];
   double m_bCoefficients[LORAWAN_ERROR_MODEL_NR_COEFF];
+
+  /**
+   * Use the lookup table instead of evaluating the BER curves.
+   */
+  bool m_useLookupTable;
 };
 
 
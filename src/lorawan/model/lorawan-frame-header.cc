@@ -21,19 +21,23 @@
 #include "lorawan-mac.h"
 #include <ns3/log.h>
 #include <ns3/address-utils.h>
+#include <cstring>
 
 namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("LoRaWANFrameHeader");
 
-LoRaWANFrameHeader::LoRaWANFrameHeader () : m_devAddr((uint32_t)0), m_frameControl(0), m_frameCounter(0), m_serializeFramePort(false)
+LoRaWANFrameHeader::LoRaWANFrameHeader () : m_devAddr((uint32_t)0), m_frameControl(0), m_frameCounter(0), m_framePort(0), m_serializeFramePort(false)
 {
 }
 
 LoRaWANFrameHeader::LoRaWANFrameHeader (Ipv4Address devAddr, bool adr, bool adrAckReq, bool ack, bool framePending, uint8_t FOptsLen, uint16_t frameCounter, uint16_t framePort) : m_devAddr(devAddr), m_frameCounter(frameCounter), m_framePort(framePort)
 {
-  // adr, adrackreq and fopts are not implemented for now
+  // adrackreq is not implemented for now, the frame options should be set
+  // with setFrameOptions
+  NS_ASSERT (FOptsLen == 0);
   m_frameControl = 0;
+  setAdr(adr);
   setAck(ack);
   setFramePending(framePending);
 
@@ -57,6 +61,21 @@ LoRaWANFrameHeader::setDevAddr (Ipv4Address addr)
   m_devAddr = addr;
 }
 
+bool
+LoRaWANFrameHeader::getAdr () const
+{
+  return (m_frameControl & LORAWAN_FHDR_ADR_MASK);
+}
+
+void
+LoRaWANFrameHeader::setAdr (bool adr)
+{
+  if (adr)
+    m_frameControl |= LORAWAN_FHDR_ADR_MASK;
+  else
+    m_frameControl &= ~LORAWAN_FHDR_ADR_MASK;
+}
+
 bool
 LoRaWANFrameHeader::getAck () const
 {
@@ -112,6 +131,28 @@ LoRaWANFrameHeader::setFramePort (uint8_t framePort)
   m_framePort = framePort;
 }
 
+uint8_t
+LoRaWANFrameHeader::getFrameOptionsLength () const
+{
+  return m_frameControl & LORAWAN_FHDR_FOPTSLEN_MASK;
+}
+
+uint8_t
+LoRaWANFrameHeader::getFrameOptions (uint8_t* buffer) const
+{
+  const uint8_t length = getFrameOptionsLength ();
+  std::memcpy (buffer, m_frameOptions, length);
+  return length;
+}
+
+void
+LoRaWANFrameHeader::setFrameOptions (const uint8_t* frameOptions, uint8_t length)
+{
+  NS_ASSERT (length <= LORAWAN_FHDR_MAX_FOPTSLEN);
+  std::memcpy (m_frameOptions, frameOptions, length);
+  m_frameControl = (m_frameControl & ~LORAWAN_FHDR_FOPTSLEN_MASK) | length;
+}
+
 bool
 LoRaWANFrameHeader::getSerializeFramePort () const
 {
@@ -145,6 +186,9 @@ LoRaWANFrameHeader::Print (std::ostream &os) const
 {
   os << "Device Address = " << std::hex << m_devAddr  << ", frameControl = " << (uint16_t)m_frameControl << ", Frame Counter = " << std::dec << (uint32_t) m_frameCounter;
 
+  if (getFrameOptionsLength () > 0)
+    os << ", Frame Options Length = " << (uint32_t)getFrameOptionsLength ();
+
   if (m_serializeFramePort)
     os << ", Frame Port = " << (uint32_t)m_framePort;
 }
@@ -169,7 +213,7 @@ LoRaWANFrameHeader::Serialize (Buffer::Iterator start) const
   i.WriteU32 (m_devAddr.Get ());
   i.WriteU8 (m_frameControl);
   i.WriteU16 (m_frameCounter);
-  // TODO: frame options ...
+  i.Write (m_frameOptions, getFrameOptionsLength ());
   if (m_serializeFramePort)
     i.WriteU8 (m_framePort);
 }
@@ -188,22 +232,26 @@ LoRaWANFrameHeader::Deserialize (Buffer::Iterator start)
   nBytes += 1;
   uint8_t frameControl = i.ReadU8();
   m_frameControl = 0;
+  if (frameControl & LORAWAN_FHDR_ADR_MASK) {
+    setAdr(true);
+  }
   if (frameControl & LORAWAN_FHDR_ACK_MASK) {
     setAck(true);
   }
   if (frameControl & LORAWAN_FHDR_FPENDING_MASK) { // this is only valid for downstream frames ...
     setFramePending(true);
   }
-  if (frameControl & LORAWAN_FHDR_FOPTSLEN_MASK) {
-    NS_LOG_WARN(this << " Frame Options not supported in current LoRaWAN implementation");
-  }
 
   // Frame counter
   nBytes += 2;
   uint16_t frameCounter = i.ReadU16();
   setFrameCounter(frameCounter);
 
-  // TODO: frame options ...
+  // Frame options
+  const uint8_t frameOptionsLength = frameControl & LORAWAN_FHDR_FOPTSLEN_MASK;
+  nBytes += frameOptionsLength;
+  i.Read (m_frameOptions, frameOptionsLength);
+  m_frameControl |= frameOptionsLength;
 
   // The header does not indicate whether Frame Port is present, instead it
   // should be present if there is any Frame Payload. The caller should set
@@ -28,6 +28,7 @@
 #define LORAWAN_FHDR_ACK_MASK 0x20
 #define LORAWAN_FHDR_FPENDING_MASK 0x10
 #define LORAWAN_FHDR_FOPTSLEN_MASK 0x0F
+#define LORAWAN_FHDR_MAX_FOPTSLEN 15
 
 namespace ns3 {
 
@@ -46,6 +47,9 @@ public:
   Ipv4Address getDevAddr(void) const;
   void setDevAddr(Ipv4Address);
 
+  bool getAdr() const;
+  void setAdr(bool);
+
   bool getAck() const;
   void setAck(bool);
 
@@ -61,6 +65,26 @@ public:
   bool getSerializeFramePort() const;
   void setSerializeFramePort(bool);
 
+  /**
+   * \return the length of the frame options (FOpts) in bytes
+   */
+  uint8_t getFrameOptionsLength() const;
+
+  /**
+   * Copy the frame options, which are MAC commands, to buffer.
+   *
+   * \param buffer should hold at least getFrameOptionsLength() bytes
+   * \return the length of the frame options
+   */
+  uint8_t getFrameOptions(uint8_t* buffer) const;
+
+  /**
+   * Set the frame options, which are MAC commands piggybacked on the frame
+   * ($4.3.1.6 in LoRaWAN spec). At most LORAWAN_FHDR_MAX_FOPTSLEN bytes fit
+   * in the frame header.
+   */
+  void setFrameOptions(const uint8_t* frameOptions, uint8_t length);
+
   /**
    * \brief Get the type ID.
    * \return the object TypeId
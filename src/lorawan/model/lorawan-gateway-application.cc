@@ -37,19 +37,216 @@
 #include "lorawan-net-device.h"
 #include "lorawan-gateway-application.h"
 #include "lorawan-frame-header.h"
+#include "lorawan-mac-command.h"
+#include "lorawan-join-header.h"
+#include "lorawan-airtime.h"
 #include "ns3/udp-socket-factory.h"
 #include "ns3/string.h"
 #include "ns3/pointer.h"
+#include "ns3/boolean.h"
+#include "ns3/enum.h"
+#include "ns3/double.h"
+#include <algorithm>
+#include <limits>
 
 namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("LoRaWANGatewayApplication");
 
+NS_OBJECT_ENSURE_REGISTERED (LoRaWANNetworkServer);
 NS_OBJECT_ENSURE_REGISTERED (LoRaWANGatewayApplication);
 
 Ptr<LoRaWANNetworkServer> LoRaWANNetworkServer::m_ptr = NULL;
 
-LoRaWANNetworkServer::LoRaWANNetworkServer () : m_endDevices(), m_pktSize(0), m_generateDataDown(false), m_confirmedData(false), m_endDevicesPopulated(false), m_downstreamIATRandomVariable(nullptr), m_nrRW1Sent(0), m_nrRW2Sent(0), m_nrRW1Missed(0), m_nrRW2Missed(0) {}
+const uint32_t LoRaWANNSDSQueuePool::m_nullIndex;
+
+LoRaWANNSDSQueuePool::LoRaWANNSDSQueuePool () : m_elements(), m_next(), m_freeHead(m_nullIndex), m_size(0), m_peakSize(0) {}
+
+uint32_t
+LoRaWANNSDSQueuePool::PushBack (LoRaWANNSDSQueue &queue)
+{
+  uint32_t index = m_freeHead;
+  if (index != m_nullIndex) {
+    m_freeHead = m_next[index];
+  } else {
+    index = m_elements.size ();
+    m_elements.push_back (LoRaWANNSDSQueueElement ());
+    m_next.push_back (m_nullIndex);
+  }
+
+  m_next[index] = m_nullIndex;
+  if (queue.m_size == 0)
+    queue.m_head = index;
+  else
+    m_next[queue.m_tail] = index;
+  queue.m_tail = index;
+  queue.m_size++;
+  m_size++;
+  if (m_size > m_peakSize)
+    m_peakSize = m_size;
+  return index;
+}
+
+void
+LoRaWANNSDSQueuePool::PopFront (LoRaWANNSDSQueue &queue)
+{
+  NS_ASSERT (queue.m_size > 0);
+
+  const uint32_t index = queue.m_head;
+  queue.m_head = m_next[index];
+  queue.m_size--;
+  if (queue.m_size == 0)
+    queue.m_head = queue.m_tail = m_nullIndex;
+
+  m_elements[index].m_downstreamPacket = 0; // release the packet
+  m_next[index] = m_freeHead;
+  m_freeHead = index;
+  m_size--;
+}
+
+void
+LoRaWANNSDSQueuePool::Clear (LoRaWANNSDSQueue &queue)
+{
+  while (queue.m_size > 0)
+    PopFront (queue);
+}
+
+LoRaWANNSDSQueueElement &
+LoRaWANNSDSQueuePool::Front (const LoRaWANNSDSQueue &queue)
+{
+  NS_ASSERT (queue.m_size > 0);
+  return m_elements[queue.m_head];
+}
+
+LoRaWANNSDSQueueElement &
+LoRaWANNSDSQueuePool::Get (uint32_t index)
+{
+  return m_elements[index];
+}
+
+uint32_t
+LoRaWANNSDSQueuePool::GetCapacity (void) const
+{
+  return m_elements.size ();
+}
+
+uint32_t
+LoRaWANNSDSQueuePool::GetSize (void) const
+{
+  return m_size;
+}
+
+uint32_t
+LoRaWANNSDSQueuePool::GetPeakSize (void) const
+{
+  return m_peakSize;
+}
+
+const uint32_t LoRaWANEndDeviceTableNS::m_invalidIndex;
+
+LoRaWANEndDeviceTableNS::LoRaWANEndDeviceTableNS () {}
+
+uint32_t
+LoRaWANEndDeviceTableNS::Find (uint32_t deviceAddr) const
+{
+  if (deviceAddr < m_directIndex.size () && m_directIndex[deviceAddr] != m_invalidIndex)
+    return m_directIndex[deviceAddr];
+
+  if (m_sparseIndex.empty ())
+    return m_invalidIndex;
+  auto it = m_sparseIndex.find (deviceAddr);
+  return it != m_sparseIndex.end () ? it->second : m_invalidIndex;
+}
+
+uint32_t
+LoRaWANEndDeviceTableNS::Add (Ipv4Address deviceAddr)
+{
+  const uint32_t addr = deviceAddr.Get ();
+  NS_ASSERT (Find (addr) == m_invalidIndex);
+
+  const uint32_t i = GetSize ();
+  m_deviceAddress.push_back (addr);
+  m_fCntUp.push_back (0);
+  m_fCntDown.push_back (0);
+  m_lastSeen.push_back (Time (0));
+  m_lastDataRateIndex.push_back (0);
+  m_lastChannelIndex.push_back (0);
+  m_lastCodeRate.push_back (0);
+  m_rx1DROffset.push_back (0); // default
+  m_setAck.push_back (false);
+  m_framePending.push_back (false);
+  m_adr.push_back (false);
+  m_nwkSKey.push_back (LoRaWANKey ());
+  m_appSKey.push_back (LoRaWANKey ());
+  LoRaWANCrypto::DeriveDefaultSessionKeys (addr, m_nwkSKey.back (), m_appSKey.back ());
+  m_info.push_back (LoRaWANEndDeviceInfoNS ());
+  m_stats.push_back (LoRaWANEndDeviceStatsNS ());
+
+  // Only grow the direct lookup table up to a few times the number of end
+  // devices, so that a single large address does not allocate a huge table
+  if (addr < m_directIndex.size () || addr <= 2 * GetSize () + 1024) {
+    if (addr >= m_directIndex.size ())
+      m_directIndex.resize (addr + 1, m_invalidIndex);
+    m_directIndex[addr] = i;
+  } else {
+    m_sparseIndex[addr] = i;
+  }
+
+  return i;
+}
+
+void
+LoRaWANEndDeviceTableNS::Reserve (uint32_t n)
+{
+  m_deviceAddress.reserve (n);
+  m_fCntUp.reserve (n);
+  m_fCntDown.reserve (n);
+  m_lastSeen.reserve (n);
+  m_lastDataRateIndex.reserve (n);
+  m_lastChannelIndex.reserve (n);
+  m_lastCodeRate.reserve (n);
+  m_rx1DROffset.reserve (n);
+  m_setAck.reserve (n);
+  m_framePending.reserve (n);
+  m_adr.reserve (n);
+  m_nwkSKey.reserve (n);
+  m_appSKey.reserve (n);
+  m_info.reserve (n);
+  m_stats.reserve (n);
+}
+
+uint32_t
+LoRaWANEndDeviceTableNS::GetSize (void) const
+{
+  return m_deviceAddress.size ();
+}
+
+void
+LoRaWANEndDeviceTableNS::Clear (void)
+{
+  m_deviceAddress.clear ();
+  m_fCntUp.clear ();
+  m_fCntDown.clear ();
+  m_lastSeen.clear ();
+  m_lastDataRateIndex.clear ();
+  m_lastChannelIndex.clear ();
+  m_lastCodeRate.clear ();
+  m_rx1DROffset.clear ();
+  m_setAck.clear ();
+  m_framePending.clear ();
+  m_adr.clear ();
+  m_nwkSKey.clear ();
+  m_appSKey.clear ();
+  m_info.clear ();
+  m_stats.clear ();
+  m_directIndex.clear ();
+  m_sparseIndex.clear ();
+}
+
+LoRaWANNetworkServer::LoRaWANNetworkServer () : m_endDevices(), m_downstreamQueuePool(), m_homeDeviceAddrs(), m_roamingPartners(), m_joinedEndDevices(), m_appKeys(), m_crypto(false), m_cryptoBatchSize(64), m_joinAddressBase(0x01000000), m_nextJoinAddress(0), m_appNonce(0), m_pktSize(0), m_generateDataDown(false), m_confirmedData(false), m_endDevicesPopulated(false), m_selectBestGateway(true), m_planDownlinks(true), m_maxDSQueueSize(0), m_dsQueueDropPolicy(LORAWAN_QUEUE_DROP_TAIL), m_adrHistoryLength(20), m_adrInstallationMargin(10.0), m_classCRetryInterval(MilliSeconds (100)), m_downstreamIATRandomVariable(nullptr), m_nrRW1Sent(0), m_nrRW2Sent(0), m_nrRW1Missed(0), m_nrRW2Missed(0), m_nrClassCSent(0), m_nrRW1Deferred(0), m_nrAdrRequestsSent(0), m_nrUSForwarded(0), m_nrUSDropped(0), m_nrUSMicFailures(0), m_nrJoinRequestsReceived(0), m_nrJoinRequestsRejected(0), m_nrJoinAcceptsSent(0), m_dsQueueSize(0), m_nrDSQueueDrops(0), m_nrMacCommandsSent(0), m_nrMacCommandsPiggybacked(0)
+{
+  m_timerWheel.SetExpireCallback (MakeCallback (&LoRaWANNetworkServer::TimerExpired, this));
+}
 
 TypeId
 LoRaWANNetworkServer::GetTypeId (void)
@@ -78,6 +275,77 @@ LoRaWANNetworkServer::GetTypeId (void)
                    StringValue ("ns3::ExponentialRandomVariable[Mean=10]"),
                    MakePointerAccessor (&LoRaWANNetworkServer::m_downstreamIATRandomVariable),
                    MakePointerChecker <RandomVariableStream>())
+    .AddAttribute ("SelectBestGateway",
+                   "Send DS packets via the gateway with the highest link margin for the last US packet of the end device."
+                   "False means the first gateway that received the US packet is used.",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&LoRaWANNetworkServer::m_selectBestGateway),
+                   MakeBooleanChecker ())
+    .AddAttribute ("PlanDownlinks",
+                   "Reserve the TX interval of every DS transmission in the TX plan of its gateway, taking the airtime "
+                   "and the duty cycle of the sub band into account. A DS transmission is only assigned to a gateway and "
+                   "receive window where it does not collide with DS transmissions that are planned for other end devices. "
+                   "False means a gateway is selected when the receive window opens, based on its state at that time.",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&LoRaWANNetworkServer::m_planDownlinks),
+                   MakeBooleanChecker ())
+    .AddAttribute ("MaxDSQueueSize",
+                   "The maximum number of DS packets that are queued for an end device, zero means unlimited.",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&LoRaWANNetworkServer::m_maxDSQueueSize),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("DSQueueDropPolicy",
+                   "What to drop when a DS packet is generated for an end device of which the DS queue is full. "
+                   "A confirmed DS packet that was sent and waits for an ack is never dropped.",
+                   EnumValue (LORAWAN_QUEUE_DROP_TAIL),
+                   MakeEnumAccessor (&LoRaWANNetworkServer::m_dsQueueDropPolicy),
+                   MakeEnumChecker (LORAWAN_QUEUE_DROP_TAIL, "DropTail",
+                                    LORAWAN_QUEUE_DROP_HEAD, "DropHead"))
+    .AddAttribute ("AdrHistoryLength",
+                   "The number of US packets over which the maximum SNR is taken for adaptive data rate. "
+                   "ADR is only used for end devices that set the ADR bit, zero disables ADR.",
+                   UintegerValue (20),
+                   MakeUintegerAccessor (&LoRaWANNetworkServer::m_adrHistoryLength),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("AdrInstallationMargin",
+                   "The link margin in dB that adaptive data rate keeps on top of the demodulation floor.",
+                   DoubleValue (10.0),
+                   MakeDoubleAccessor (&LoRaWANNetworkServer::m_adrInstallationMargin),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("TimerResolution",
+                   "The resolution of the timer wheel for the RW and DS timers of end devices. Timers are rounded up "
+                   "to the resolution and all timers that expire at the same time share a simulator event. "
+                   "Zero schedules a simulator event for every timer.",
+                   TimeValue (MilliSeconds (1)),
+                   MakeTimeAccessor (&LoRaWANNetworkServer::SetTimerResolution,
+                                     &LoRaWANNetworkServer::GetTimerResolution),
+                   MakeTimeChecker (Seconds (0)))
+    .AddAttribute ("JoinAddressBase",
+                   "The first device address that is allocated to end devices that join by over-the-air activation. "
+                   "It should be far from the addresses that LoRaWANHelper assigns, and differ between network servers.",
+                   UintegerValue (0x01000000),
+                   MakeUintegerAccessor (&LoRaWANNetworkServer::m_joinAddressBase),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("ClassCRetryInterval",
+                   "The minimum time after which the network server retries to push a DS packet to a Class C end "
+                   "device when none of its gateways could send it.",
+                   TimeValue (MilliSeconds (100)),
+                   MakeTimeAccessor (&LoRaWANNetworkServer::m_classCRetryInterval),
+                   MakeTimeChecker (MilliSeconds (1)))
+    .AddAttribute ("Crypto",
+                   "Verify the MIC and decrypt the FRMPayload of US data packets, and encrypt the FRMPayload and "
+                   "compute the MIC of DS data packets. False skips all cryptography, e.g. for radio studies, "
+                   "the Crypto attribute of the MACs of the end devices should be false as well then.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&LoRaWANNetworkServer::m_crypto),
+                   MakeBooleanChecker ())
+    .AddAttribute ("CryptoBatchSize",
+                   "The maximum number of US packets of which the MICs are verified at once. US packets are queued "
+                   "until the batch is full or until all US packets of the current time step are received. "
+                   "One verifies every US packet as soon as it is received.",
+                   UintegerValue (64),
+                   MakeUintegerAccessor (&LoRaWANNetworkServer::m_cryptoBatchSize),
+                   MakeUintegerChecker<uint32_t> (1))
     .AddTraceSource ("nrRW1Sent",
                      "The number of times that a DS packet was sent in RW1 by this network server",
                      MakeTraceSourceAccessor (&LoRaWANNetworkServer::m_nrRW1Sent),
@@ -94,6 +362,58 @@ LoRaWANNetworkServer::GetTypeId (void)
                      "The number of times RW2 was missed for all end devics served by this network server",
                      MakeTraceSourceAccessor (&LoRaWANNetworkServer::m_nrRW2Missed),
                      "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource ("nrRW1Deferred",
+                     "The number of times that a DS packet was planned in RW2 instead of RW1, as RW2 uses less duty cycle",
+                     MakeTraceSourceAccessor (&LoRaWANNetworkServer::m_nrRW1Deferred),
+                     "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource ("nrClassCSent",
+                     "The number of DS packets that were pushed to Class C end devices outside of their receive windows",
+                     MakeTraceSourceAccessor (&LoRaWANNetworkServer::m_nrClassCSent),
+                     "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource ("nrAdrRequestsSent",
+                     "The number of LinkADRReq MAC commands sent by this network server",
+                     MakeTraceSourceAccessor (&LoRaWANNetworkServer::m_nrAdrRequestsSent),
+                     "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource ("nrUSForwarded",
+                     "The number of US packets forwarded to a roaming partner by this network server",
+                     MakeTraceSourceAccessor (&LoRaWANNetworkServer::m_nrUSForwarded),
+                     "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource ("nrUSDropped",
+                     "The number of US packets of end devices that are not served by this network server nor by a roaming partner",
+                     MakeTraceSourceAccessor (&LoRaWANNetworkServer::m_nrUSDropped),
+                     "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource ("nrUSMicFailures",
+                     "The number of US packets and JoinRequests that were dropped by this network server because of an invalid MIC",
+                     MakeTraceSourceAccessor (&LoRaWANNetworkServer::m_nrUSMicFailures),
+                     "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource ("nrJoinRequestsReceived",
+                     "The number of JoinRequests with a new DevNonce received by this network server",
+                     MakeTraceSourceAccessor (&LoRaWANNetworkServer::m_nrJoinRequestsReceived),
+                     "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource ("nrJoinRequestsRejected",
+                     "The number of JoinRequests with a DevNonce that was used before, which are ignored by this network server",
+                     MakeTraceSourceAccessor (&LoRaWANNetworkServer::m_nrJoinRequestsRejected),
+                     "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource ("nrJoinAcceptsSent",
+                     "The number of JoinAccepts sent by this network server",
+                     MakeTraceSourceAccessor (&LoRaWANNetworkServer::m_nrJoinAcceptsSent),
+                     "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource ("DSQueueSize",
+                     "The number of DS packets queued for all end devices of this network server",
+                     MakeTraceSourceAccessor (&LoRaWANNetworkServer::m_dsQueueSize),
+                     "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource ("nrDSQueueDrops",
+                     "The number of DS packets dropped by this network server because the DS queue of the end device was full",
+                     MakeTraceSourceAccessor (&LoRaWANNetworkServer::m_nrDSQueueDrops),
+                     "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource ("nrMacCommandsSent",
+                     "The number of MAC commands sent by this network server, including LinkADRReqs",
+                     MakeTraceSourceAccessor (&LoRaWANNetworkServer::m_nrMacCommandsSent),
+                     "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource ("nrMacCommandsPiggybacked",
+                     "The number of MAC commands sent by this network server in the frame options of a DS packet with data or an ack",
+                     MakeTraceSourceAccessor (&LoRaWANNetworkServer::m_nrMacCommandsPiggybacked),
+                     "ns3::TracedValueCallback::Uint32")
     .AddTraceSource ("DSMsgGenerated",
                      "A DS msg for an end device has been generated by this network server",
                      MakeTraceSourceAccessor (&LoRaWANNetworkServer::m_dsMsgGeneratedTrace),
@@ -114,6 +434,10 @@ LoRaWANNetworkServer::GetTypeId (void)
                      "An US msg has been received by this network server",
                      MakeTraceSourceAccessor (&LoRaWANNetworkServer::m_usMsgReceivedTrace),
                      "ns3::TracedValueCallback::LoRaWANDSMessageTracedCallback")
+    .AddTraceSource ("DevStatus",
+                     "A DevStatusAns has been received by this network server",
+                     MakeTraceSourceAccessor (&LoRaWANNetworkServer::m_devStatusTrace),
+                     "ns3::TracedValueCallback::LoRaWANDevStatusTracedCallback")
   ;
   return tid;
 }
@@ -133,25 +457,47 @@ LoRaWANNetworkServer::PopulateEndDevices (void)
   if (m_endDevicesPopulated)
     return;
 
-  // Populate m_endDevices based on ns3::NodeList
-  for (NodeList::Iterator it = NodeList::Begin (); it != NodeList::End (); ++it)
-  {
-    Ptr<Node> nodePtr(*it);
-    Address devAddr = nodePtr->GetDevice (0)->GetAddress();
-    if (Ipv4Address::IsMatchingType (devAddr)) {
-      Ipv4Address ipv4DevAddr = Ipv4Address::ConvertFrom (devAddr);
-      if (ipv4DevAddr.IsEqual (Ipv4Address(0xffffffff))) { // gateway?
+  // Populate m_endDevices based on the registered end devices or on
+  // ns3::NodeList, allocate the table at once
+  std::vector<Ipv4Address> deviceAddrs (m_homeDeviceAddrs);
+  if (m_homeDeviceAddrs.empty ()) {
+    deviceAddrs.reserve (NodeList::GetNNodes ());
+    for (NodeList::Iterator it = NodeList::Begin (); it != NodeList::End (); ++it)
+    {
+      Ptr<Node> nodePtr(*it);
+      Address devAddr = nodePtr->GetDevice (0)->GetAddress();
+      if (Ipv4Address::IsMatchingType (devAddr)) {
+        Ipv4Address ipv4DevAddr = Ipv4Address::ConvertFrom (devAddr);
+        if (ipv4DevAddr.IsEqual (Ipv4Address(0xffffffff))) { // gateway?
+          continue;
+        }
+        if (ipv4DevAddr.IsEqual (Ipv4Address::GetAny ())) { // end device that did not join yet
+          continue;
+        }
+        deviceAddrs.push_back (ipv4DevAddr);
+      } else {
+        NS_LOG_ERROR (this << " Unable to allocate device address");
         continue;
       }
+    }
+  }
 
-      // Construct LoRaWANEndDeviceInfoNS object
-      LoRaWANEndDeviceInfoNS info = InitEndDeviceInfo (ipv4DevAddr);
-      uint32_t key = ipv4DevAddr.Get ();
-      m_endDevices[key] = info; // store object
-    } else {
-      NS_LOG_ERROR (this << " Unable to allocate device address");
+  m_endDevices.Reserve (m_endDevices.GetSize () + deviceAddrs.size ());
+  for (auto it = deviceAddrs.cbegin (); it != deviceAddrs.cend (); it++)
+    if (m_endDevices.Find (it->Get ()) == LoRaWANEndDeviceTableNS::m_invalidIndex)
+      AddEndDevice (*it);
+
+  // Class C end devices are reachable in between their US transmissions
+  for (NodeList::Iterator it = NodeList::Begin (); it != NodeList::End (); ++it)
+  {
+    if ((*it)->GetNDevices () == 0)
       continue;
-    }
+    Ptr<LoRaWANNetDevice> device = DynamicCast<LoRaWANNetDevice> ((*it)->GetDevice (0));
+    if (!device || device->GetDeviceType () != LORAWAN_DT_END_DEVICE_CLASS_C)
+      continue;
+    const uint32_t i = m_endDevices.Find (Ipv4Address::ConvertFrom (device->GetAddress ()).Get ());
+    if (i != LoRaWANEndDeviceTableNS::m_invalidIndex)
+      m_endDevices.m_info[i].m_classC = true;
   }
   m_endDevicesPopulated = true;
 }
@@ -161,27 +507,178 @@ LoRaWANNetworkServer::DoDispose (void)
 {
   NS_LOG_FUNCTION (this);
 
+  m_usBatchEvent.Cancel ();
+  m_usBatch.clear ();
+  m_timerWheel.Clear ();
+  m_endDevices.Clear ();
+  m_appKeys.clear ();
+  m_homeDeviceAddrs.clear ();
+  m_roamingPartners.clear ();
+  m_joinedEndDevices.clear ();
   Object::DoDispose ();
 }
 
-LoRaWANEndDeviceInfoNS
-LoRaWANNetworkServer::InitEndDeviceInfo (Ipv4Address ipv4DevAddr)
+uint32_t
+LoRaWANNetworkServer::AddEndDevice (Ipv4Address ipv4DevAddr)
 {
-  uint32_t key = ipv4DevAddr.Get ();
-
-  // Construct LoRaWANEndDeviceInfoNS object
-  LoRaWANEndDeviceInfoNS info;
-  info.m_deviceAddress = ipv4DevAddr;
-  info.m_rx1DROffset = 0; // default
-  info.m_setAck = false;
+  const uint32_t i = m_endDevices.Add (ipv4DevAddr);
 
   if (m_generateDataDown) {
     Time t = Seconds (this->m_downstreamIATRandomVariable->GetValue ());
-    info.m_downstreamTimer = Simulator::Schedule (t, &LoRaWANNetworkServer::DSTimerExpired, this, key);
+    m_timerWheel.Schedule (t, i, LORAWAN_NS_DS_TIMER);
     NS_LOG_DEBUG (this << " DS Traffic Timer for node " << ipv4DevAddr << " scheduled at " << t);
   }
 
-  return info;
+  return i;
+}
+
+const LoRaWANEndDeviceTableNS &
+LoRaWANNetworkServer::GetEndDevices (void) const
+{
+  return m_endDevices;
+}
+
+uint32_t
+LoRaWANNetworkServer::FindJoinedEndDevice (uint64_t devEui) const
+{
+  auto it = m_joinedEndDevices.find (devEui);
+  return it != m_joinedEndDevices.end () ? it->second : LoRaWANEndDeviceTableNS::m_invalidIndex;
+}
+
+void
+LoRaWANNetworkServer::AddHomeEndDevice (Ipv4Address deviceAddr)
+{
+  NS_LOG_FUNCTION (this << deviceAddr);
+  NS_ASSERT_MSG (!m_endDevicesPopulated, "End devices should be registered before the gateways start");
+  m_homeDeviceAddrs.push_back (deviceAddr);
+}
+
+bool
+LoRaWANNetworkServer::IsHomeNetworkServer (Ipv4Address deviceAddr)
+{
+  // A network server without gateways is only populated here
+  PopulateEndDevices ();
+  return m_endDevices.Find (deviceAddr.Get ()) != LoRaWANEndDeviceTableNS::m_invalidIndex;
+}
+
+bool
+LoRaWANNetworkServer::QueueMacCommand (Ipv4Address deviceAddr, const Header &command)
+{
+  NS_LOG_FUNCTION (this << deviceAddr);
+
+  PopulateEndDevices ();
+  const uint32_t i = m_endDevices.Find (deviceAddr.Get ());
+  if (i == LoRaWANEndDeviceTableNS::m_invalidIndex) {
+    NS_LOG_WARN (this << " Not queueing MAC command for unknown end device " << deviceAddr);
+    return false;
+  }
+
+  Ptr<Packet> p = Create<Packet> (0);
+  p->AddHeader (command);
+  uint8_t cid = 0;
+  if (p->GetSize () > 0)
+    p->CopyData (&cid, 1);
+  if (p->GetSize () == 0 || LoRaWANGetMacCommandLength (cid, true) != p->GetSize () || cid == LORAWAN_CID_LINK_ADR) {
+    NS_LOG_WARN (this << " Not queueing unsupported MAC command with CID " << (uint32_t)cid);
+    return false;
+  }
+
+  LoRaWANEndDeviceInfoNS &info = m_endDevices.m_info[i];
+  if (cid == LORAWAN_CID_RX_PARAM_SETUP) {
+    LoRaWANRxParamSetupReqHeader rxParamSetupReq;
+    p->PeekHeader (rxParamSetupReq);
+    info.m_requestedRx1DROffset = rxParamSetupReq.GetRx1DROffset ();
+  }
+
+  const uint32_t offset = info.m_macCommands.size ();
+  info.m_macCommands.resize (offset + p->GetSize ());
+  p->CopyData (&info.m_macCommands[offset], p->GetSize ());
+
+  if (info.m_classC)
+    SendClassCDSPacket (i);
+  return true;
+}
+
+bool
+LoRaWANNetworkServer::QueueDSPacket (Ipv4Address deviceAddr, Ptr<Packet> payload, uint8_t framePort, bool confirmed)
+{
+  NS_LOG_FUNCTION (this << deviceAddr << payload << (uint32_t)framePort << confirmed);
+
+  PopulateEndDevices ();
+  const uint32_t i = m_endDevices.Find (deviceAddr.Get ());
+  if (i == LoRaWANEndDeviceTableNS::m_invalidIndex) {
+    NS_LOG_WARN (this << " Not queueing DS packet for unknown end device " << deviceAddr);
+    return false;
+  }
+
+  if (!MakeRoomInDSQueue (i))
+    return false;
+  PushDSPacket (i, payload, framePort, confirmed);
+
+  if (m_endDevices.m_info[i].m_classC)
+    SendClassCDSPacket (i);
+  return true;
+}
+
+bool
+LoRaWANNetworkServer::SetClassC (Ipv4Address deviceAddr, bool classC)
+{
+  NS_LOG_FUNCTION (this << deviceAddr << classC);
+
+  PopulateEndDevices ();
+  const uint32_t i = m_endDevices.Find (deviceAddr.Get ());
+  if (i == LoRaWANEndDeviceTableNS::m_invalidIndex) {
+    NS_LOG_WARN (this << " Unknown end device " << deviceAddr);
+    return false;
+  }
+
+  m_endDevices.m_info[i].m_classC = classC;
+  if (classC)
+    SendClassCDSPacket (i);
+  return true;
+}
+
+bool
+LoRaWANNetworkServer::SetSessionKeys (Ipv4Address deviceAddr, const LoRaWANKey &nwkSKey, const LoRaWANKey &appSKey)
+{
+  NS_LOG_FUNCTION (this << deviceAddr);
+
+  PopulateEndDevices ();
+  const uint32_t i = m_endDevices.Find (deviceAddr.Get ());
+  if (i == LoRaWANEndDeviceTableNS::m_invalidIndex) {
+    NS_LOG_WARN (this << " Unknown end device " << deviceAddr);
+    return false;
+  }
+
+  m_endDevices.m_nwkSKey[i] = nwkSKey;
+  m_endDevices.m_appSKey[i] = appSKey;
+  return true;
+}
+
+void
+LoRaWANNetworkServer::SetAppKey (uint64_t devEui, const LoRaWANKey &appKey)
+{
+  NS_LOG_FUNCTION (this << devEui);
+  m_appKeys[devEui] = appKey;
+}
+
+LoRaWANKey
+LoRaWANNetworkServer::GetAppKey (uint64_t devEui) const
+{
+  auto it = m_appKeys.find (devEui);
+  if (it != m_appKeys.end ())
+    return it->second;
+  LoRaWANKey appKey;
+  LoRaWANCrypto::DeriveDefaultAppKey (devEui, appKey);
+  return appKey;
+}
+
+void
+LoRaWANNetworkServer::AddRoamingPartner (Ptr<LoRaWANNetworkServer> partner)
+{
+  NS_LOG_FUNCTION (this << partner);
+  NS_ASSERT (partner != this);
+  m_roamingPartners.push_back (partner);
 }
 
 Ptr<LoRaWANNetworkServer>
@@ -202,6 +699,120 @@ LoRaWANNetworkServer::HandleUSPacket (Ptr<LoRaWANGatewayApplication> lastGW, Add
 
   // PacketSocketAddress fromAddress = PacketSocketAddress::ConvertFrom (from);
 
+  // A JoinRequest does not have a frame header
+  LoRaWANMsgTypeTag joinMsgTypeTag;
+  if (packet->PeekPacketTag (joinMsgTypeTag) && joinMsgTypeTag.GetMsgType () == LORAWAN_JOIN_REQUEST) {
+    HandleJoinRequest (lastGW, packet);
+    return;
+  }
+
+  if (!m_crypto) {
+    ProcessUSPacket (lastGW, from, packet);
+    return;
+  }
+
+  // Verify the MICs of the US packets that are received at the same time
+  // together
+  LoRaWANNSUSPacket element;
+  element.m_gateway = lastGW;
+  element.m_from = from;
+  element.m_packet = packet;
+  m_usBatch.push_back (element);
+  if (m_usBatch.size () >= m_cryptoBatchSize)
+    VerifyUSBatch ();
+  else if (!m_usBatchEvent.IsRunning ())
+    m_usBatchEvent = Simulator::ScheduleNow (&LoRaWANNetworkServer::VerifyUSBatch, this);
+}
+
+void
+LoRaWANNetworkServer::VerifyUSBatch (void)
+{
+  NS_LOG_FUNCTION (this << m_usBatch.size ());
+
+  m_usBatchEvent.Cancel ();
+  m_usBatchProcessing.swap (m_usBatch);
+  const uint32_t n = m_usBatchProcessing.size ();
+  const uint32_t frameSize = LORAWAN_MAX_PHY_PAYLOAD_SIZE;
+  if (m_usBatchFrames.size () < n * frameSize)
+    m_usBatchFrames.resize (n * frameSize);
+
+  // Copy the MHDR and MACPayload of every packet of an end device of this
+  // network server into a job. The keys of the jobs are set once all end
+  // devices are added, as adding an end device may move the keys.
+  const uint32_t invalidMic = LoRaWANEndDeviceTableNS::m_invalidIndex;
+  const uint32_t notServed = invalidMic - 1;
+  std::vector<uint32_t> jobIndexes (n, invalidMic);
+  std::vector<uint32_t> deviceIndexes;
+  std::vector<uint32_t> receivedMics;
+  m_usBatchJobs.clear ();
+  for (uint32_t k = 0; k < n; k++) {
+    Ptr<Packet> packet = m_usBatchProcessing[k].m_packet;
+    uint8_t *frame = &m_usBatchFrames[k * frameSize];
+    const uint32_t length = packet->GetSize () + 1;
+    LoRaWANMsgTypeTag msgTypeTag;
+    LoRaWANMicTag micTag;
+    if (length < 8 || length > frameSize - 4 || !packet->PeekPacketTag (msgTypeTag) || !packet->PeekPacketTag (micTag))
+      continue;
+
+    frame[0] = msgTypeTag.GetMsgType () << 5;
+    packet->CopyData (frame + 1, length - 1);
+    const uint32_t deviceAddr = frame[1] | (frame[2] << 8) | (frame[3] << 16) | ((uint32_t)frame[4] << 24);
+    uint32_t i = m_endDevices.Find (deviceAddr);
+    if (i == LoRaWANEndDeviceTableNS::m_invalidIndex && !m_homeDeviceAddrs.empty ()) {
+      jobIndexes[k] = notServed;
+      continue;
+    } else if (i == LoRaWANEndDeviceTableNS::m_invalidIndex) { // not found, so add the end device (note this should have already happened in PopulateEndDevices()):
+      NS_LOG_WARN (this << " end device with address = " << Ipv4Address (deviceAddr) << " not found in m_endDevices, allocating");
+      i = AddEndDevice (Ipv4Address (deviceAddr));
+    }
+
+    jobIndexes[k] = m_usBatchJobs.size ();
+    deviceIndexes.push_back (i);
+    receivedMics.push_back (micTag.GetMic ());
+    LoRaWANMicJob job;
+    job.m_key = 0;
+    job.m_frame = frame;
+    job.m_length = length;
+    job.m_uplink = true;
+    job.m_mic = 0;
+    m_usBatchJobs.push_back (job);
+  }
+  for (uint32_t j = 0; j < m_usBatchJobs.size (); j++)
+    m_usBatchJobs[j].m_key = &m_endDevices.m_nwkSKey[deviceIndexes[j]];
+  if (!m_usBatchJobs.empty ())
+    LoRaWANCrypto::ComputeFrameMics (&m_usBatchJobs[0], m_usBatchJobs.size ());
+
+  for (uint32_t k = 0; k < n; k++) {
+    LoRaWANNSUSPacket &element = m_usBatchProcessing[k];
+    const uint32_t j = jobIndexes[k];
+    if (j == notServed) {
+      // Forwarded to the home network server or dropped
+      ProcessUSPacket (element.m_gateway, element.m_from, element.m_packet);
+      continue;
+    }
+    if (j == invalidMic || m_usBatchJobs[j].m_mic != receivedMics[j]) {
+      NS_LOG_INFO (this << " Dropping US packet with an invalid MIC");
+      m_nrUSMicFailures++;
+      if (j != invalidMic)
+        m_endDevices.m_stats[deviceIndexes[j]].m_nUSMicFailures += 1;
+      continue;
+    }
+
+    const LoRaWANMicJob &job = m_usBatchJobs[j];
+    const uint32_t i = deviceIndexes[j];
+    uint8_t *frame = &m_usBatchFrames[k * frameSize];
+    const uint32_t offset = LoRaWANCrypto::CryptFrame (m_endDevices.m_nwkSKey[i], m_endDevices.m_appSKey[i], true, frame, job.m_length);
+    LoRaWANCrypto::SetPacketTail (element.m_packet, frame + offset, job.m_length - offset);
+    ProcessUSPacket (element.m_gateway, element.m_from, element.m_packet);
+  }
+  m_usBatchProcessing.clear ();
+}
+
+void
+LoRaWANNetworkServer::ProcessUSPacket (Ptr<LoRaWANGatewayApplication> lastGW, Address from, Ptr<Packet> packet)
+{
+  NS_LOG_FUNCTION (this);
+
   // Decode Frame header
   LoRaWANFrameHeader frmHdr;
   frmHdr.setSerializeFramePort (true); // Assume that frame Header contains Frame Port so set this to true so that RemoveHeader will deserialize the FPort
@@ -211,57 +822,95 @@ LoRaWANNetworkServer::HandleUSPacket (Ptr<LoRaWANGatewayApplication> lastGW, Add
   Ipv4Address deviceAddr = frmHdr.getDevAddr ();
   //NS_LOG_INFO(this << "Received packet from device addr = " << deviceAddr);
   uint32_t key = deviceAddr.Get ();
-  auto it = m_endDevices.find (key);
-  if (it == m_endDevices.end ()) { // not found, so create a new struct and insert it (note this should have already happened in DoInitialize()):
+  uint32_t i = m_endDevices.Find (key);
+  if (i == LoRaWANEndDeviceTableNS::m_invalidIndex && !m_homeDeviceAddrs.empty ()) {
+    // The end device belongs to another network, forward the US packet to
+    // its home network server if that is a roaming partner
+    packet->AddHeader (frmHdr);
+    for (auto it = m_roamingPartners.begin (); it != m_roamingPartners.end (); it++) {
+      if ((*it)->IsHomeNetworkServer (deviceAddr)) {
+        NS_LOG_DEBUG (this << " Forwarding US packet of end device " << deviceAddr << " to roaming partner " << *it);
+        m_nrUSForwarded++;
+        (*it)->HandleUSPacket (lastGW, from, packet);
+        return;
+      }
+    }
+    NS_LOG_INFO (this << " Dropping US packet of end device " << deviceAddr << " that is not served by this network server");
+    m_nrUSDropped++;
+    return;
+  } else if (i == LoRaWANEndDeviceTableNS::m_invalidIndex) { // not found, so add the end device (note this should have already happened in PopulateEndDevices()):
     NS_LOG_WARN (this << " end device with address = " << deviceAddr << " not found in m_endDevices, allocating");
-
-    LoRaWANEndDeviceInfoNS info = InitEndDeviceInfo (deviceAddr);
-    m_endDevices[key] = info;
-    it = m_endDevices.find (key);
+    i = AddEndDevice (deviceAddr);
   }
+  LoRaWANEndDeviceInfoNS &info = m_endDevices.m_info[i];
+  LoRaWANEndDeviceStatsNS &stats = m_endDevices.m_stats[i];
 
   // Always update number of received upstream packets:
-  it->second.m_nUSPackets += 1;
+  stats.m_nUSPackets += 1;
 
   // Always update last seen GWs:
-  if ((Simulator::Now () - it->second.m_lastSeen) > Seconds(1.0)) { // assume a new upstream transmission, so clear the vector of seenGWs
-    it->second.m_lastGWs.clear ();
+  const bool newTransmission = AddRxGateway (i, lastGW, packet);
+  const LoRaWANGatewayRxInfoNS &gwInfo = info.m_lastGWs.back ();
+
+  // Keep the SNR history for ADR, taking the best SNR over all gateways that
+  // received the US transmission
+  if (frmHdr.getAdr () && gwInfo.m_haveMetadata && m_adrHistoryLength > 0) {
+    if (info.m_adrHistory.GetCapacity () != m_adrHistoryLength)
+      info.m_adrHistory.SetCapacity (m_adrHistoryLength);
+    if (newTransmission)
+      info.m_adrHistory.Add (gwInfo.m_snr);
+    else
+      info.m_adrHistory.UpdateLast (gwInfo.m_snr);
   }
-  it->second.m_lastGWs.push_back (lastGW);
 
   // Check for duplicate.
   // Depending on the frame counter and received time, we can classify the US Packet as:
   // i) The first time the NS sees the US Packet: i.e. new frame counter up value
   // ii) Retransmission of a previously transmitted US Packet (then the NS has to reply with an Ack): i.e. frame counter up already seen, seen longer than 1 second ago
   // iii) The same transmission received by a second Gateway (in this case we can drop the packet): i.e. frame counter up already seen, seen shorter than 1 second ago
-  bool firstRX = it->second.m_nUSPackets == 0;
+  bool firstRX = stats.m_nUSPackets == 0 || info.m_newSession;
   bool processMACAck = true;
-  if (frmHdr.getFrameCounter () <= it->second.m_fCntUp && !firstRX) {
-    Time t = Simulator::Now () - it->second.m_lastSeen;
+  if (frmHdr.getFrameCounter () <= m_endDevices.m_fCntUp[i] && !firstRX) {
+    Time t = Simulator::Now () - m_endDevices.m_lastSeen[i];
     if (t <= Seconds (1.0)) { // assume US packet is really a duplicate received by a second gateway
       // Duplicate, drop packet
-      it->second.m_nUSDuplicates += 1;
-      NS_LOG_INFO (this << " Duplicate detected: " << frmHdr.getFrameCounter () << " <= " << it->second.m_fCntUp << " &&  t = " << t << " < 1 second => dropping packet");
+      stats.m_nUSDuplicates += 1;
+      NS_LOG_INFO (this << " Duplicate detected: " << frmHdr.getFrameCounter () << " <= " << m_endDevices.m_fCntUp[i] << " &&  t = " << t << " < 1 second => dropping packet");
       // TODO: add trace for dropping duplicate packets?
       return;
     } else { // assume US packet is a retransmission
-      it->second.m_nUSRetransmission += 1;
+      stats.m_nUSRetransmission += 1;
       processMACAck = false; // as we have already receive this US packet is a retransmission, we should not process the Ack flag set in the MAC header (but we should still open a RW or reply with an Ack if necessary)
     }
   } else { // new US frame counter value -> update number of unique packets received and US frame counter
-    it->second.m_nUniqueUSPackets += 1;
-    it->second.m_fCntUp = frmHdr.getFrameCounter (); // update US frame counter
+    stats.m_nUniqueUSPackets += 1;
+    m_endDevices.m_fCntUp[i] = frmHdr.getFrameCounter (); // update US frame counter
+    info.m_newSession = false;
   }
 
-  // Update fields in LoRaWANEndDeviceInfoNS:
-  it->second.m_lastSeen = Simulator::Now ();
+  // Update fields in the end device table:
+  m_endDevices.m_lastSeen[i] = Simulator::Now ();
+  m_endDevices.m_adr[i] = frmHdr.getAdr ();
+
+  // Answers to MAC commands are piggybacked in the frame options
+  if (processMACAck && frmHdr.getFrameOptionsLength () > 0) {
+    uint8_t frameOptions[LORAWAN_FHDR_MAX_FOPTSLEN];
+    const uint8_t length = frmHdr.getFrameOptions (frameOptions);
+    ProcessMacAnswers (i, frameOptions, length);
+  }
+  if (processMACAck && info.m_adrAnswerPending) {
+    // The LinkADRReq or its LinkADRAns was lost, the end device still uses
+    // the previous TX power and the LinkADRReq is sent again
+    NS_LOG_DEBUG (this << " No LinkADRAns from end device " << Ipv4Address (deviceAddr));
+    info.m_adrAnswerPending = false;
+  }
 
   // Parse PhyRx Packet Tag
   LoRaWANPhyParamsTag phyParamsTag;
   if (packet->RemovePacketTag (phyParamsTag)) {
-    it->second.m_lastChannelIndex = phyParamsTag.GetChannelIndex ();
-    it->second.m_lastDataRateIndex = phyParamsTag.GetDataRateIndex ();
-    it->second.m_lastCodeRate = phyParamsTag.GetCodeRate ();
+    m_endDevices.m_lastChannelIndex[i] = phyParamsTag.GetChannelIndex ();
+    m_endDevices.m_lastDataRateIndex[i] = phyParamsTag.GetDataRateIndex ();
+    m_endDevices.m_lastCodeRate[i] = phyParamsTag.GetCodeRate ();
   } else {
     NS_LOG_WARN (this << " LoRaWANPhyParamsTag not found on packet.");
   }
@@ -272,7 +921,7 @@ LoRaWANNetworkServer::HandleUSPacket (Ptr<LoRaWANGatewayApplication> lastGW, Add
     LoRaWANMsgType msgType = msgTypeTag.GetMsgType();
 
     if (msgType == LORAWAN_CONFIRMED_DATA_UP) {
-      it->second.m_setAck = true; // Set ack bit in next DS msg
+      m_endDevices.m_setAck[i] = true; // Set ack bit in next DS msg
       NS_LOG_DEBUG (this << " Received Confirmed Data UP. Next DS Packet will have Ack bit set");
     }
   } else {
@@ -284,20 +933,19 @@ LoRaWANNetworkServer::HandleUSPacket (Ptr<LoRaWANGatewayApplication> lastGW, Add
 
   // Parse Ack flag:
   if (processMACAck && frmHdr.getAck ()) {
-    it->second.m_nUSAcks += 1;
-
-    if (!it->second.m_downstreamQueue.empty ()) { // there is a DS message in the queue
-      if (it->second.m_downstreamQueue.front()->m_downstreamMsgType == LORAWAN_CONFIRMED_DATA_DOWN) { // End device confirmed reception of DS packet, so we can remove it:
-        LoRaWANNSDSQueueElement* ptr = it->second.m_downstreamQueue.front();
+    stats.m_nUSAcks += 1;
 
+    if (info.m_downstreamQueue.m_size > 0) { // there is a DS message in the queue
+      LoRaWANNSDSQueueElement &element = m_downstreamQueuePool.Front (info.m_downstreamQueue);
+      if (element.m_downstreamMsgType == LORAWAN_CONFIRMED_DATA_DOWN) { // End device confirmed reception of DS packet, so we can remove it:
         // LOG that network server received an Acknowledgment for a DS packet
-        m_dsMsgAckdTrace (key, ptr->m_downstreamTransmissionsRemaining, ptr->m_downstreamMsgType, ptr->m_downstreamPacket);
+        m_dsMsgAckdTrace (key, element.m_downstreamTransmissionsRemaining, element.m_downstreamMsgType, element.m_downstreamPacket);
 
-        this->DeleteFirstDSQueueElement (key);
+        this->DeleteFirstDSQueueElement (i);
 
         NS_LOG_DEBUG (this << " Received Ack for Confirmed DS packet, removing packet from DS queue for end device " << deviceAddr);
       } else {
-        NS_LOG_ERROR (this << " Upstream frame has Ack bit set, but downstream frame msg type is not Confirmed (msgType = " << it->second.m_downstreamQueue.front()->m_downstreamMsgType << ")");
+        NS_LOG_ERROR (this << " Upstream frame has Ack bit set, but downstream frame msg type is not Confirmed (msgType = " << element.m_downstreamMsgType << ")");
       }
     } else {
       // One occurence of this condition is when the NS receives a retransmission that re-acknowledges a previously send DS confirmed packet
@@ -308,146 +956,538 @@ LoRaWANNetworkServer::HandleUSPacket (Ptr<LoRaWANGatewayApplication> lastGW, Add
   }
 
   // We should always schedule a timer, even when m_downstreamPacket is NULL as a new DS packet might be generated between now and RW1
-  if (it->second.m_rw1Timer.IsRunning()) {
-    NS_LOG_ERROR (this << " Scheduling RW1 timer while RW1 timer was already scheduled for " << it->second.m_rw1Timer.GetTs ());
+  if (info.m_rw1Expiry > Simulator::Now ()) {
+    NS_LOG_ERROR (this << " Scheduling RW1 timer while RW1 timer was already scheduled for " << info.m_rw1Expiry);
   }
   Time receiveDelay = MicroSeconds (RECEIVE_DELAY1);
-  it->second.m_rw1Timer = Simulator::Schedule (receiveDelay, &LoRaWANNetworkServer::RW1TimerExpired, this, key);
+  info.m_rw1Expiry = m_timerWheel.Schedule (receiveDelay, i, LORAWAN_NS_RW1_TIMER);
 }
 
 bool
-LoRaWANNetworkServer::HaveSomethingToSendToEndDevice (uint32_t deviceAddr)
+LoRaWANNetworkServer::AddRxGateway (uint32_t deviceIndex, Ptr<LoRaWANGatewayApplication> gateway, Ptr<Packet> packet)
+{
+  LoRaWANEndDeviceInfoNS &info = m_endDevices.m_info[deviceIndex];
+  if ((Simulator::Now () - m_endDevices.m_lastSeen[deviceIndex]) > Seconds(1.0)) { // assume a new upstream transmission, so clear the vector of seenGWs
+    info.m_lastGWs.clear ();
+  }
+  const bool newTransmission = info.m_lastGWs.empty ();
+  LoRaWANGatewayRxInfoNS gwInfo;
+  gwInfo.m_gateway = gateway;
+  LoRaWANRxMetadataTag rxMetadataTag;
+  gwInfo.m_haveMetadata = packet->RemovePacketTag (rxMetadataTag);
+  gwInfo.m_rssi = rxMetadataTag.GetRssi ();
+  gwInfo.m_snr = rxMetadataTag.GetSnr ();
+  info.m_lastGWs.push_back (gwInfo);
+  return newTransmission;
+}
+
+void
+LoRaWANNetworkServer::HandleJoinRequest (Ptr<LoRaWANGatewayApplication> lastGW, Ptr<Packet> packet)
 {
-  uint32_t key = deviceAddr;
-  auto it_ed = m_endDevices.find (key);
+  NS_LOG_FUNCTION (this);
 
-  return it_ed->second.m_downstreamQueue.size() > 0 || it_ed->second.m_setAck;
+  // The DevEUI does not tell which network server is the home network server
+  // of an end device, so JoinRequests are not forwarded to roaming partners
+  if (!m_homeDeviceAddrs.empty ()) {
+    NS_LOG_INFO (this << " Dropping JoinRequest, only network servers without registered end devices accept JoinRequests");
+    m_nrUSDropped++;
+    return;
+  }
+
+  LoRaWANJoinRequestHeader joinRequest;
+  packet->PeekHeader (joinRequest);
+  const uint64_t devEui = joinRequest.GetDevEui ();
+  const uint16_t devNonce = joinRequest.GetDevNonce ();
+
+  // The MIC of a JoinRequest is the CMAC of its MHDR and payload with the
+  // AppKey of the end device
+  if (m_crypto) {
+    uint8_t frame[LORAWAN_MAX_PHY_PAYLOAD_SIZE];
+    const uint32_t length = packet->GetSize () + 1;
+    LoRaWANMicTag micTag;
+    bool validMic = length <= sizeof (frame) && packet->PeekPacketTag (micTag);
+    if (validMic) {
+      frame[0] = LORAWAN_JOIN_REQUEST << 5;
+      packet->CopyData (frame + 1, length - 1);
+      validMic = LoRaWANCrypto::ComputeJoinMic (GetAppKey (devEui), frame, length) == micTag.GetMic ();
+    }
+    if (!validMic) {
+      NS_LOG_INFO (this << " Dropping JoinRequest of DevEUI " << devEui << " with an invalid MIC");
+      m_nrUSMicFailures++;
+      const uint32_t i = FindJoinedEndDevice (devEui);
+      if (i != LoRaWANEndDeviceTableNS::m_invalidIndex)
+        m_endDevices.m_stats[i].m_nUSMicFailures += 1;
+      return;
+    }
+  }
+  packet->RemoveHeader (joinRequest);
+
+  // Allocate a device address on the first JoinRequest of an end device. An
+  // end device that joins again keeps its device index and address.
+  uint32_t i = FindJoinedEndDevice (devEui);
+  if (i == LoRaWANEndDeviceTableNS::m_invalidIndex) {
+    if (m_nextJoinAddress < m_joinAddressBase)
+      m_nextJoinAddress = m_joinAddressBase;
+    while (m_endDevices.Find (m_nextJoinAddress) != LoRaWANEndDeviceTableNS::m_invalidIndex)
+      m_nextJoinAddress++;
+    i = AddEndDevice (Ipv4Address (m_nextJoinAddress++));
+    m_endDevices.m_info[i].m_devEui = devEui;
+    m_joinedEndDevices[devEui] = i;
+    NS_LOG_DEBUG (this << " Allocated device address " << Ipv4Address (m_endDevices.m_deviceAddress[i]) << " to DevEUI " << devEui);
+  }
+  LoRaWANEndDeviceInfoNS &info = m_endDevices.m_info[i];
+  LoRaWANEndDeviceStatsNS &stats = m_endDevices.m_stats[i];
+  stats.m_nUSPackets += 1;
+
+  // The same JoinRequest received by a second gateway
+  const bool newTransmission = AddRxGateway (i, lastGW, packet);
+  if (!newTransmission && devNonce == info.m_lastDevNonce) {
+    stats.m_nUSDuplicates += 1;
+    return;
+  }
+  info.m_lastDevNonce = devNonce;
+  m_endDevices.m_lastSeen[i] = Simulator::Now ();
+
+  // Ignore replayed JoinRequests
+  auto nonceIt = std::lower_bound (info.m_devNonces.begin (), info.m_devNonces.end (), devNonce);
+  if (nonceIt != info.m_devNonces.end () && *nonceIt == devNonce) {
+    NS_LOG_INFO (this << " Rejecting JoinRequest of DevEUI " << devEui << " with DevNonce " << devNonce << " that was used before");
+    m_nrJoinRequestsRejected++;
+    return;
+  }
+  info.m_devNonces.insert (nonceIt, devNonce);
+  stats.m_nUniqueUSPackets += 1;
+  m_nrJoinRequestsReceived++;
+
+  LoRaWANPhyParamsTag phyParamsTag;
+  if (packet->RemovePacketTag (phyParamsTag)) {
+    m_endDevices.m_lastChannelIndex[i] = phyParamsTag.GetChannelIndex ();
+    m_endDevices.m_lastDataRateIndex[i] = phyParamsTag.GetDataRateIndex ();
+    m_endDevices.m_lastCodeRate[i] = phyParamsTag.GetCodeRate ();
+  } else {
+    NS_LOG_WARN (this << " LoRaWANPhyParamsTag not found on packet.");
+  }
+
+  m_usMsgReceivedTrace (m_endDevices.m_deviceAddress[i], LORAWAN_JOIN_REQUEST, packet);
+
+  // The JoinAccept is sent in the RWs of the JoinRequest, which open after
+  // JOIN_ACCEPT_DELAY1 and JOIN_ACCEPT_DELAY2
+  if (info.m_rw1Expiry > Simulator::Now ()) {
+    NS_LOG_ERROR (this << " Scheduling RW1 timer while RW1 timer was already scheduled for " << info.m_rw1Expiry);
+  }
+  info.m_joinAcceptPending = true;
+  info.m_rw1Expiry = m_timerWheel.Schedule (MicroSeconds (JOIN_ACCEPT_DELAY1), i, LORAWAN_NS_RW1_TIMER);
+}
+
+Time
+LoRaWANNetworkServer::GetReceiveDelay2 (uint32_t deviceIndex) const
+{
+  return MicroSeconds (m_endDevices.m_info[deviceIndex].m_joinAcceptPending ? JOIN_ACCEPT_DELAY2 : RECEIVE_DELAY2);
+}
+
+bool
+LoRaWANNetworkServer::HaveSomethingToSendToEndDevice (uint32_t deviceIndex)
+{
+  const LoRaWANEndDeviceInfoNS &info = m_endDevices.m_info[deviceIndex];
+  return info.m_joinAcceptPending || info.m_downstreamQueue.m_size > 0 || m_endDevices.m_setAck[deviceIndex] || info.m_adrRequestPending || !info.m_macCommands.empty ();
 }
 
 void
-LoRaWANNetworkServer::RW1TimerExpired (uint32_t deviceAddr)
+LoRaWANNetworkServer::RW1TimerExpired (uint32_t deviceIndex)
 {
-  NS_LOG_FUNCTION (this << deviceAddr);
+  NS_LOG_FUNCTION (this << deviceIndex);
 
-  uint32_t key = deviceAddr;
-  auto it_ed = m_endDevices.find (key);
+  const uint32_t i = deviceIndex;
+  LoRaWANEndDeviceInfoNS &info = m_endDevices.m_info[i];
+
+  // All gateways have reported the US transmission by now, so its SNR is final
+  if (m_endDevices.m_adr[i])
+    UpdateAdr (i);
 
   // Check whether any GW in lastGWs can send a downstream transmission immediately (i.e. right now) in RW1
-  bool foundGW = false;
-  // The RW1 LoRa channel and data rate are the same as used in the last US transmission
-  const uint8_t dsChannelIndex = it_ed->second.m_lastChannelIndex;
-  const uint8_t dsDataRateIndex = it_ed->second.m_lastDataRateIndex;;
-  for (auto it_gw = it_ed->second.m_lastGWs.cbegin(); it_gw != it_ed->second.m_lastGWs.cend(); it_gw++) {
-    if ((*it_gw)->CanSendImmediatelyOnChannel (dsChannelIndex, dsDataRateIndex)) {
-      foundGW = true;
-      this->SendDSPacket (deviceAddr, *it_gw, true, false);
-      break;
+  // The RW1 LoRa channel is the same as used in the last US transmission, or mapped on it (e.g. US915)
+  const uint8_t dsChannelIndex = LoRaWAN::GetRX1ChannelIndex (m_endDevices.m_lastChannelIndex[i]);
+  const uint8_t dsDataRateIndex = LoRaWAN::GetRX1DataRateIndex (m_endDevices.m_lastDataRateIndex[i], m_endDevices.m_rx1DROffset[i]);
+  const Time now = Simulator::Now ();
+  const Time airTime = m_planDownlinks ? GetDSAirtime (i, dsDataRateIndex) : Time ();
+  Ptr<LoRaWANGatewayApplication> gw = SelectDSGateway (i, dsChannelIndex, dsDataRateIndex, now, airTime);
+
+  // With planning, the gateway for RW2 is selected now as well, so that DS
+  // transmissions of other end devices in the meantime do not take it. When
+  // both windows are feasible, the window that keeps its sub band off for
+  // the shortest time is used.
+  Ptr<LoRaWANGatewayApplication> rw2GW = 0;
+  Time rw2AirTime;
+  Time rw2Start;
+  if (airTime.IsStrictlyPositive ()) {
+    rw2AirTime = GetDSAirtime (i, LoRaWAN::m_RW2DataRateIndex);
+    rw2Start = m_timerWheel.GetExpiryTime ((m_endDevices.m_lastSeen[i] + GetReceiveDelay2 (i)) - now);
+    rw2GW = SelectDSGateway (i, LoRaWAN::m_RW2ChannelIndex, LoRaWAN::m_RW2DataRateIndex, rw2Start, rw2AirTime);
+    if (gw && rw2GW && rw2GW->GetTimeOff (LoRaWAN::m_RW2ChannelIndex, rw2AirTime) < gw->GetTimeOff (dsChannelIndex, airTime)) {
+      NS_LOG_DEBUG (this << " Deferring DS transmission to " << Ipv4Address (m_endDevices.m_deviceAddress[i]) << " to RW2");
+      gw = 0;
+      m_nrRW1Deferred++;
+    } else if (!gw) {
+      m_nrRW1Missed++;
     }
   }
 
+  bool foundGW = gw != 0;
+  if (foundGW) {
+    if (airTime.IsStrictlyPositive ())
+      gw->ReserveTx (now, dsChannelIndex, airTime);
+    this->SendDSPacket (i, gw, true, false);
+
+    // The remaining DS packets of a Class C end device are pushed after RW1
+    if (info.m_classC)
+      ScheduleClassCTimer (i, GetDSAirtime (i, dsDataRateIndex) + m_classCRetryInterval);
+  }
+
   if (!foundGW) {
     NS_LOG_DEBUG (this << " No gateway available for transmission in RW1, scheduling timer for DS transmission in RW2");
 
     // Increment m_nrRW1Missed only if there is something to send:
-    if (HaveSomethingToSendToEndDevice (deviceAddr)) {
+    if (!airTime.IsStrictlyPositive () && HaveSomethingToSendToEndDevice (i)) {
       m_nrRW1Missed++;
     }
 
-    if (it_ed->second.m_rw2Timer.IsRunning()) {
-      NS_LOG_ERROR (this << " Scheduling RW2 timer while RW2 timer was already scheduled for " << it_ed->second.m_rw2Timer.GetTs ());
+    if (info.m_rw2Expiry > Simulator::Now ()) {
+      NS_LOG_ERROR (this << " Scheduling RW2 timer while RW2 timer was already scheduled for " << info.m_rw2Expiry);
+    }
+    if (info.m_rw2GW) {
+      info.m_rw2GW->ReleaseTx (info.m_rw2Expiry);
+      info.m_rw2GW = 0;
     }
 
     // Time receiveDelay = MicroSeconds (RECEIVE_DELAY2);
-    Time receiveDelay = (it_ed->second.m_lastSeen + MicroSeconds (RECEIVE_DELAY2)) - Simulator::Now ();
+    Time receiveDelay = (m_endDevices.m_lastSeen[i] + GetReceiveDelay2 (i)) - Simulator::Now ();
     NS_ASSERT (receiveDelay > 0);
-    it_ed->second.m_rw2Timer = Simulator::Schedule (receiveDelay, &LoRaWANNetworkServer::RW2TimerExpired, this, key);
+    info.m_rw2Expiry = m_timerWheel.Schedule (receiveDelay, i, LORAWAN_NS_RW2_TIMER);
+
+    if (rw2GW) {
+      NS_ASSERT (info.m_rw2Expiry == rw2Start);
+      rw2GW->ReserveTx (rw2Start, LoRaWAN::m_RW2ChannelIndex, rw2AirTime);
+      info.m_rw2GW = rw2GW;
+    }
   }
 }
 
 void
-LoRaWANNetworkServer::RW2TimerExpired (uint32_t deviceAddr)
+LoRaWANNetworkServer::RW2TimerExpired (uint32_t deviceIndex)
 {
-  NS_LOG_FUNCTION (this << deviceAddr);
-
-  uint32_t key = deviceAddr;
-  auto it_ed = m_endDevices.find (key);
+  NS_LOG_FUNCTION (this << deviceIndex);
 
   // Check whether any GW in lastGWs can send a downstream transmission immediately (i.e. right now) in RW2
   // The RW2 LoRa channel is a fixed channel depending on the region, for EU this is the high power 869.525 MHz channel
   const uint8_t dsChannelIndex = LoRaWAN::m_RW2ChannelIndex;
   const uint8_t dsDataRateIndex = LoRaWAN::m_RW2DataRateIndex;
-  bool foundGW = false;
-  for (auto it_gw = it_ed->second.m_lastGWs.cbegin(); it_gw != it_ed->second.m_lastGWs.cend(); it_gw++) {
-    if ((*it_gw)->CanSendImmediatelyOnChannel (dsChannelIndex, dsDataRateIndex)) {
-      foundGW = true;
-      this->SendDSPacket (deviceAddr, *it_gw, false, true);
-      break;
-    }
+
+  // The DS packet may have changed since the reservation was made (e.g. a DS
+  // packet was generated in the meantime), so release the reservation and
+  // select a gateway for the packet that is sent now. The released interval
+  // is still free, unless the packet became longer.
+  const Time now = Simulator::Now ();
+  LoRaWANEndDeviceInfoNS &info = m_endDevices.m_info[deviceIndex];
+  if (info.m_rw2GW) {
+    info.m_rw2GW->ReleaseTx (info.m_rw2Expiry);
+    info.m_rw2GW = 0;
+  }
+
+  const Time airTime = m_planDownlinks ? GetDSAirtime (deviceIndex, dsDataRateIndex) : Time ();
+  Ptr<LoRaWANGatewayApplication> gw = SelectDSGateway (deviceIndex, dsChannelIndex, dsDataRateIndex, now, airTime);
+  bool foundGW = gw != 0;
+  if (foundGW) {
+    if (airTime.IsStrictlyPositive ())
+      gw->ReserveTx (now, dsChannelIndex, airTime);
+    this->SendDSPacket (deviceIndex, gw, false, true);
   }
 
   if (!foundGW) {
     // Increment m_nrRW2Missed only if there is something to send:
-    if (HaveSomethingToSendToEndDevice (deviceAddr)) {
+    if (HaveSomethingToSendToEndDevice (deviceIndex)) {
       m_nrRW2Missed++;
-      NS_LOG_INFO (this << " Unable to send DS transmission to device addr " << deviceAddr << " in RW1 and RW2, no gateway was available.");
+      NS_LOG_INFO (this << " Unable to send DS transmission to device addr " << Ipv4Address (m_endDevices.m_deviceAddress[deviceIndex]) << " in RW1 and RW2, no gateway was available.");
+    }
+    // The end device will send a new JoinRequest
+    info.m_joinAcceptPending = false;
+  }
+
+  // The remaining DS packets of a Class C end device are pushed after RW2
+  if (info.m_classC)
+    ScheduleClassCTimer (deviceIndex, GetDSAirtime (deviceIndex, dsDataRateIndex) + m_classCRetryInterval);
+}
+
+Ptr<LoRaWANGatewayApplication>
+LoRaWANNetworkServer::SelectDSGateway (uint32_t deviceIndex, uint8_t channelIndex, uint8_t dataRateIndex, Time start, Time airTime) const
+{
+  // The link margin is the SNR of the US packet above the demodulation floor
+  // of the DS data rate. Gateways without metadata are ranked last, in order
+  // of reception.
+  const LoRaWANEndDeviceInfoNS &info = m_endDevices.m_info[deviceIndex];
+  const double demodulationFloor = LoRaWAN::GetDemodulationFloor (dataRateIndex);
+  Ptr<LoRaWANGatewayApplication> bestGW = 0;
+  double bestMargin = -std::numeric_limits<double>::infinity ();
+  for (auto it_gw = info.m_lastGWs.cbegin (); it_gw != info.m_lastGWs.cend (); it_gw++) {
+    const double margin = it_gw->m_haveMetadata ? it_gw->m_snr - demodulationFloor : -std::numeric_limits<double>::infinity ();
+    if (bestGW && margin <= bestMargin)
+      continue;
+
+    // A gateway that is transmitting or that has exhausted its duty cycle can not be used
+    if (start <= Simulator::Now () && !it_gw->m_gateway->CanSendImmediatelyOnChannel (channelIndex, dataRateIndex))
+      continue;
+
+    // Nor can a gateway of which the transmission would collide with a planned transmission
+    if (airTime.IsStrictlyPositive () && !it_gw->m_gateway->CanReserveTx (start, channelIndex, airTime))
+      continue;
+
+    bestGW = it_gw->m_gateway;
+    bestMargin = margin;
+    if (!m_selectBestGateway)
+      break;
+  }
+
+  if (bestGW)
+    NS_LOG_DEBUG (this << " Selected GW #" << bestGW->GetNode ()->GetId () << " with link margin " << bestMargin << " dB for DS transmission to " << Ipv4Address (m_endDevices.m_deviceAddress[deviceIndex]));
+  return bestGW;
+}
+
+Time
+LoRaWANNetworkServer::GetDSAirtime (uint32_t deviceIndex, uint8_t dataRateIndex)
+{
+  // Same selection as in SendDSPacket
+  const LoRaWANEndDeviceInfoNS &info = m_endDevices.m_info[deviceIndex];
+  uint32_t payloadSize;
+  bool framePort;
+  if (info.m_joinAcceptPending) {
+    // MAC header (1 byte), JoinAccept without frame header and MIC (4 bytes)
+    const uint32_t phyPayloadSize = 1 + LoRaWANJoinAcceptHeader ().GetSerializedSize () + 4;
+    return LoRaWANAirtime::GetTimeOnAir (dataRateIndex, m_endDevices.m_lastCodeRate[deviceIndex], phyPayloadSize);
+  } else if (info.m_downstreamQueue.m_size > 0) {
+    const LoRaWANNSDSQueueElement &element = m_downstreamQueuePool.Front (info.m_downstreamQueue);
+    payloadSize = element.m_downstreamPacket->GetSize ();
+    framePort = element.m_downstreamFramePort > 0;
+  } else if (m_endDevices.m_setAck[deviceIndex] || info.m_adrRequestPending || !info.m_macCommands.empty ()) {
+    payloadSize = 0;
+    framePort = false;
+  } else {
+    return Time ();
+  }
+
+  // Frame header without options (7 bytes) and frame port, followed by the
+  // MAC commands that fit in the frame options
+  const uint32_t macPayloadSize = 7 + (framePort ? 1 : 0) + payloadSize;
+  const uint32_t maxMACPayloadSize = LoRaWANMac::GetMaxMACPayloadSize (dataRateIndex);
+  bool linkAdrReq;
+  uint32_t nCommands;
+  const uint8_t frameOptionsLength = GetMacCommands (deviceIndex, maxMACPayloadSize > macPayloadSize ? maxMACPayloadSize - macPayloadSize : 0, nullptr, linkAdrReq, nCommands);
+
+  // MAC header (1 byte), MACPayload and MIC (4 bytes)
+  const uint32_t phyPayloadSize = 1 + macPayloadSize + frameOptionsLength + 4;
+  return LoRaWANAirtime::GetTimeOnAir (dataRateIndex, m_endDevices.m_lastCodeRate[deviceIndex], phyPayloadSize);
+}
+
+uint8_t
+LoRaWANNetworkServer::GetMacCommands (uint32_t deviceIndex, uint8_t maxLength, uint8_t *buffer, bool &linkAdrReq, uint32_t &nCommands) const
+{
+  const LoRaWANEndDeviceInfoNS &info = m_endDevices.m_info[deviceIndex];
+  maxLength = std::min<uint8_t> (maxLength, LORAWAN_FHDR_MAX_FOPTSLEN);
+  uint8_t length = 0;
+  linkAdrReq = false;
+  nCommands = 0;
+
+  LoRaWANLinkAdrReqHeader linkAdrReqHeader (info.m_adrDataRateIndex, info.m_adrTxPowerIndex);
+  if (info.m_adrRequestPending && linkAdrReqHeader.GetSerializedSize () <= maxLength) {
+    if (buffer) {
+      Buffer serialized (linkAdrReqHeader.GetSerializedSize ());
+      serialized.AddAtStart (linkAdrReqHeader.GetSerializedSize ());
+      linkAdrReqHeader.Serialize (serialized.Begin ());
+      serialized.CopyData (buffer, linkAdrReqHeader.GetSerializedSize ());
     }
+    length += linkAdrReqHeader.GetSerializedSize ();
+    linkAdrReq = true;
+    nCommands++;
+  }
+
+  // Queued MAC commands are sent in order, a MAC command that does not fit
+  // waits for the next DS packet
+  uint32_t offset = 0;
+  while (offset < info.m_macCommands.size ()) {
+    const uint8_t commandLength = LoRaWANGetMacCommandLength (info.m_macCommands[offset], true);
+    if (length + commandLength > maxLength)
+      break;
+    if (buffer)
+      std::copy (&info.m_macCommands[offset], &info.m_macCommands[offset] + commandLength, buffer + length);
+    length += commandLength;
+    offset += commandLength;
+    nCommands++;
   }
+
+  return length;
 }
 
 void
-LoRaWANNetworkServer::SendDSPacket (uint32_t deviceAddr, Ptr<LoRaWANGatewayApplication> gatewayPtr, bool RW1, bool RW2)
+LoRaWANNetworkServer::ProcessMacAnswers (uint32_t deviceIndex, const uint8_t *answers, uint8_t length)
 {
-  // Search device in m_endDevices:
-  auto it = m_endDevices.find (deviceAddr);
-  if (it == m_endDevices.end ()) { // end device not found
-    NS_LOG_ERROR (this << " Could not find device info struct in m_endDevices for dev addr " << deviceAddr << ". Aborting DS Transmission");
+  NS_LOG_FUNCTION (this << deviceIndex << (uint32_t)length);
+
+  LoRaWANEndDeviceInfoNS &info = m_endDevices.m_info[deviceIndex];
+  const uint32_t deviceAddr = m_endDevices.m_deviceAddress[deviceIndex];
+  uint8_t offset = 0;
+  while (offset < length) {
+    const uint8_t cid = answers[offset];
+    const uint8_t answerLength = LoRaWANGetMacCommandLength (cid, false);
+    if (answerLength == 0 || offset + answerLength > length) {
+      NS_LOG_WARN (this << " Unsupported MAC command with CID " << (uint32_t)cid << " from end device " << Ipv4Address (deviceAddr) << ", ignoring remaining MAC commands");
+      break;
+    }
+
+    if (cid == LORAWAN_CID_RX_PARAM_SETUP) {
+      // The end device only applies the request when all settings are acked
+      const uint8_t status = answers[offset + 1];
+      if ((status & 0x07) == 0x07)
+        m_endDevices.m_rx1DROffset[deviceIndex] = info.m_requestedRx1DROffset;
+      else
+        NS_LOG_WARN (this << " End device " << Ipv4Address (deviceAddr) << " rejected RXParamSetupReq with status " << (uint32_t)status);
+    } else if (cid == LORAWAN_CID_DEV_STATUS) {
+      Buffer buffer (answerLength);
+      buffer.AddAtStart (answerLength);
+      buffer.Begin ().Write (answers + offset, answerLength);
+      LoRaWANDevStatusAnsHeader devStatusAns;
+      devStatusAns.Deserialize (buffer.Begin ());
+      NS_LOG_DEBUG (this << " End device " << Ipv4Address (deviceAddr) << " DevStatusAns: battery " << (uint32_t)devStatusAns.GetBattery () << ", margin " << (int32_t)devStatusAns.GetMargin ());
+      m_devStatusTrace (deviceAddr, devStatusAns.GetBattery (), devStatusAns.GetMargin ());
+    } else if (cid == LORAWAN_CID_LINK_ADR && info.m_adrAnswerPending) {
+      // The end device applies every setting that it acks. The SNRs in the
+      // history are no longer valid after a change, and a rejected request
+      // is only sent again once the history is full again.
+      const uint8_t status = answers[offset + 1];
+      if (status & 0x04)
+        info.m_txPowerIndex = info.m_adrTxPowerIndex;
+      if ((status & 0x07) != 0x07)
+        NS_LOG_WARN (this << " End device " << Ipv4Address (deviceAddr) << " rejected LinkADRReq with status " << (uint32_t)status);
+      info.m_adrAnswerPending = false;
+      info.m_adrHistory.Clear ();
+    }
+    offset += answerLength;
+  }
+}
+
+void
+LoRaWANNetworkServer::UpdateAdr (uint32_t deviceIndex)
+{
+  NS_LOG_FUNCTION (this << deviceIndex);
+
+  // Wait for a full history, which is cleared after every LinkADRAns
+  LoRaWANEndDeviceInfoNS &info = m_endDevices.m_info[deviceIndex];
+  if (info.m_adrRequestPending || info.m_adrAnswerPending || !info.m_adrHistory.IsFull ())
     return;
+
+  uint8_t dataRateIndex = m_endDevices.m_lastDataRateIndex[deviceIndex];
+  uint8_t txPowerIndex = info.m_txPowerIndex;
+  if (LoRaWANAdr::GetLinkAdrSettings (info.m_adrHistory.GetMaxSnr (), m_adrInstallationMargin, dataRateIndex, txPowerIndex)) {
+    info.m_adrRequestPending = true;
+    info.m_adrDataRateIndex = dataRateIndex;
+    info.m_adrTxPowerIndex = txPowerIndex;
+    NS_LOG_DEBUG (this << " ADR: end device " << Ipv4Address (m_endDevices.m_deviceAddress[deviceIndex]) << " should use DR" << (uint32_t)dataRateIndex << " and TX power index " << (uint32_t)txPowerIndex);
   }
+}
 
-  // Check if we have a last known GW for the device:
-  // bool haveGW = it->second.m_lastGWs.size () > 0;
-  // if (!haveGW) {
-  //   NS_LOG_ERROR (this << " lastGW is not set for dev addr " << deviceAddr << ". Aborting DS Transmission");
-  //   return;
-  // }
-  // Ptr <LoRaWANGatewayApplication> lastGW = *it->second.m_lastGWs.begin ();
+void
+LoRaWANNetworkServer::SendDSPacket (uint32_t deviceIndex, Ptr<LoRaWANGatewayApplication> gatewayPtr, bool RW1, bool RW2)
+{
+  const uint32_t i = deviceIndex;
+  if (i >= m_endDevices.GetSize ()) { // end device not found
+    NS_LOG_ERROR (this << " Invalid device index " << deviceIndex << ". Aborting DS Transmission");
+    return;
+  }
+  LoRaWANEndDeviceInfoNS &info = m_endDevices.m_info[i];
+  LoRaWANEndDeviceStatsNS &stats = m_endDevices.m_stats[i];
+  const uint32_t deviceAddr = m_endDevices.m_deviceAddress[i];
 
   // Figure out which DS packet to send
   LoRaWANNSDSQueueElement elementToSend;
   bool deleteQueueElement = false;
-  if (it->second.m_downstreamQueue.size() > 0) {
-    LoRaWANNSDSQueueElement* element = it->second.m_downstreamQueue.front ();
+  bool sendMacCommandsOnly = false;
+  bool sendJoinAccept = false;
+  if (info.m_joinAcceptPending) {
+    // The JoinAccept starts a new session, so the state of the previous
+    // session, including its pending DS packets, is dropped
+    NS_LOG_DEBUG (this << " Generating JoinAccept for DevEUI " << info.m_devEui << " with dev addr " << Ipv4Address (deviceAddr));
+    m_endDevices.m_fCntUp[i] = 0;
+    m_endDevices.m_fCntDown[i] = 0;
+    m_endDevices.m_setAck[i] = false;
+    m_endDevices.m_framePending[i] = false;
+    m_endDevices.m_adr[i] = false;
+    info.m_txPowerIndex = 0;
+    info.m_adrRequestPending = false;
+    info.m_adrAnswerPending = false;
+    info.m_adrHistory.Clear ();
+    info.m_macCommands.clear ();
+    m_downstreamQueuePool.Clear (info.m_downstreamQueue);
+    m_dsQueueSize = m_downstreamQueuePool.GetSize ();
+    info.m_newSession = true;
+
+    LoRaWANJoinAcceptHeader joinAccept;
+    joinAccept.SetAppNonce (m_appNonce++);
+    if (m_crypto)
+      LoRaWANCrypto::DeriveSessionKeys (GetAppKey (info.m_devEui), joinAccept.GetAppNonce (), joinAccept.GetNetId (), info.m_lastDevNonce,
+                                        m_endDevices.m_nwkSKey[i], m_endDevices.m_appSKey[i]);
+    joinAccept.SetDevAddr (Ipv4Address (deviceAddr));
+    joinAccept.SetRx1DROffset (m_endDevices.m_rx1DROffset[i]);
+    joinAccept.SetRx2DataRateIndex (LoRaWAN::m_RW2DataRateIndex);
+    joinAccept.SetRxDelay (RECEIVE_DELAY1 / 1000000);
+    elementToSend.m_downstreamPacket = Create<Packet> (0);
+    elementToSend.m_downstreamPacket->AddHeader (joinAccept);
+    // Without crypto, the end device recognizes its JoinAccept by this tag
+    // instead of by the MIC
+    if (!m_crypto)
+      elementToSend.m_downstreamPacket->AddPacketTag (LoRaWANDevEuiTag (info.m_devEui));
+    elementToSend.m_downstreamMsgType = LORAWAN_JOIN_ACCEPT;
+    elementToSend.m_downstreamFramePort = 0;
+    elementToSend.m_downstreamTransmissionsRemaining = 0;
+    sendJoinAccept = true;
+  } else if (info.m_downstreamQueue.m_size > 0) {
+    LoRaWANNSDSQueueElement &element = m_downstreamQueuePool.Front (info.m_downstreamQueue);
 
     // Bookkeeping for Confirmed packets:
-    if (element->m_downstreamMsgType == LORAWAN_CONFIRMED_DATA_DOWN) {
+    if (element.m_downstreamMsgType == LORAWAN_CONFIRMED_DATA_DOWN) {
       // Count number of retransmissions:
-      if (element->m_isRetransmission) {
-        it->second.m_nDSRetransmission++;
+      if (element.m_isRetransmission) {
+        stats.m_nDSRetransmission++;
       }
 
       // Update for next transmission:
-      element->m_downstreamTransmissionsRemaining--; // decrement
-      element->m_isRetransmission = true;
+      element.m_downstreamTransmissionsRemaining--; // decrement
+      element.m_isRetransmission = true;
     }
 
     // Should we delete pending packet after transmission?
-    if (element->m_downstreamMsgType != LORAWAN_CONFIRMED_DATA_DOWN) { // delete the queueelement object after the send operation
+    if (element.m_downstreamMsgType != LORAWAN_CONFIRMED_DATA_DOWN) { // delete the queueelement object after the send operation
       deleteQueueElement = true;
     } else {
-      if (element->m_downstreamTransmissionsRemaining == 0) {// in case of CONFIRMED_DATA_DOWN, delete the pending transmission when the number of remaining transmissions has reached 1
+      if (element.m_downstreamTransmissionsRemaining == 0) {// in case of CONFIRMED_DATA_DOWN, delete the pending transmission when the number of remaining transmissions has reached 1
         deleteQueueElement = true;
 
         // LOG that network server will delete DS packet from queue
-        m_dsMsgDroppedTrace (deviceAddr, 0, element->m_downstreamMsgType, element->m_downstreamPacket);
+        m_dsMsgDroppedTrace (deviceAddr, 0, element.m_downstreamMsgType, element.m_downstreamPacket);
       }
     }
 
-    elementToSend.m_downstreamPacket = element->m_downstreamPacket;
-    elementToSend.m_downstreamMsgType = element->m_downstreamMsgType;
-    elementToSend.m_downstreamFramePort = element->m_downstreamFramePort;
-    elementToSend.m_downstreamTransmissionsRemaining = element->m_downstreamTransmissionsRemaining;
+    elementToSend.m_downstreamPacket = element.m_downstreamPacket;
+    elementToSend.m_downstreamMsgType = element.m_downstreamMsgType;
+    elementToSend.m_downstreamFramePort = element.m_downstreamFramePort;
+    elementToSend.m_downstreamTransmissionsRemaining = element.m_downstreamTransmissionsRemaining;
   } else {
-    if (!it->second.m_setAck) {
+    if (!m_endDevices.m_setAck[i] && (info.m_adrRequestPending || !info.m_macCommands.empty ())) {
+      // Pending MAC commands are piggybacked on DS packets with data or an
+      // ack, otherwise they are sent in the frame options of an empty DS packet
+      NS_LOG_DEBUG (this << " Generating empty downstream packet to send MAC commands for dev addr " << deviceAddr);
+      elementToSend.m_downstreamPacket = Create<Packet> (0);
+      elementToSend.m_downstreamMsgType = LORAWAN_UNCONFIRMED_DATA_DOWN;
+      elementToSend.m_downstreamFramePort = 0;
+      elementToSend.m_downstreamTransmissionsRemaining = 0;
+      sendMacCommandsOnly = true;
+    } else if (!m_endDevices.m_setAck[i]) {
       // Not really a warning as there is just no need to send a DS packet (i.e. no data and no Ack)
       NS_LOG_INFO (this << " No downstream packet found nor is ack bit set for dev addr " << deviceAddr << ". Aborting DS transmission");
       return;
@@ -460,8 +1500,9 @@ LoRaWANNetworkServer::SendDSPacket (uint32_t deviceAddr, Ptr<LoRaWANGatewayAppli
     }
   }
 
-  // LOG DS msg transmission
-  uint8_t rwNumber = RW1 ? 1 : 2;
+  // LOG DS msg transmission, a DS packet that is pushed to a Class C end
+  // device outside of its receive windows is logged with rwNumber 0
+  uint8_t rwNumber = RW1 ? 1 : (RW2 ? 2 : 0);
   m_dsMsgTransmittedTrace (deviceAddr, elementToSend.m_downstreamTransmissionsRemaining, elementToSend.m_downstreamMsgType, elementToSend.m_downstreamPacket, rwNumber);
 
   // Make a copy here, this is u
@@ -471,35 +1512,77 @@ LoRaWANNetworkServer::SendDSPacket (uint32_t deviceAddr, Ptr<LoRaWANGatewayAppli
   else
     p = elementToSend.m_downstreamPacket->Copy (); // make a copy, so that we don't alter elementToSend.m_downstreamPacket as we might re-use this packet later (e.g. retransmission)
 
-  // Construct Frame Header:
-  LoRaWANFrameHeader fhdr;
-  fhdr.setDevAddr (Ipv4Address (deviceAddr));
-  fhdr.setAck (it->second.m_setAck);
-  fhdr.setFramePending (it->second.m_framePending);
-  fhdr.setFrameCounter (it->second.m_fCntDown++);
-  if (elementToSend.m_downstreamFramePort > 0)
-    fhdr.setFramePort (elementToSend.m_downstreamFramePort);
-
-  p->AddHeader (fhdr);
-
-  // Add Phy Packet tag to specify channel, data rate and code rate:
+  // Channel, data rate and code rate of the DS transmission:
   uint8_t dsChannelIndex;
   uint8_t dsDataRateIndex;
   if (RW1) {
-    dsChannelIndex = it->second.m_lastChannelIndex;
-    dsDataRateIndex = LoRaWAN::GetRX1DataRateIndex (it->second.m_lastDataRateIndex, it->second.m_rx1DROffset);
-  } else if (RW2) {
+    dsChannelIndex = LoRaWAN::GetRX1ChannelIndex (m_endDevices.m_lastChannelIndex[i]);
+    dsDataRateIndex = LoRaWAN::GetRX1DataRateIndex (m_endDevices.m_lastDataRateIndex[i], m_endDevices.m_rx1DROffset[i]);
+  } else if (RW2 || info.m_classC) {
     dsChannelIndex = LoRaWAN::m_RW2ChannelIndex;
     dsDataRateIndex = LoRaWAN::m_RW2DataRateIndex;
   } else {
-    NS_FATAL_ERROR (this << " Either RW1 or RW2 should be true");
+    NS_FATAL_ERROR (this << " Either RW1 or RW2 should be true for a Class A end device");
     return;
   }
 
+  // Construct Frame Header, a JoinAccept does not have one:
+  bool sendAdrRequest = false;
+  uint32_t nMacCommands = 0;
+  uint8_t macCommandsLength = 0;
+  if (!sendJoinAccept) {
+    LoRaWANFrameHeader fhdr;
+    fhdr.setDevAddr (Ipv4Address (deviceAddr));
+    fhdr.setAck (m_endDevices.m_setAck[i]);
+    fhdr.setFramePending (m_endDevices.m_framePending[i]);
+    fhdr.setFrameCounter (m_endDevices.m_fCntDown[i]++);
+    if (elementToSend.m_downstreamFramePort > 0)
+      fhdr.setFramePort (elementToSend.m_downstreamFramePort);
+
+    // Piggyback the pending MAC commands that fit in the frame options
+    const uint32_t macPayloadSize = fhdr.GetSerializedSize () + p->GetSize ();
+    const uint32_t maxMACPayloadSize = LoRaWANMac::GetMaxMACPayloadSize (dsDataRateIndex);
+    uint8_t frameOptions[LORAWAN_FHDR_MAX_FOPTSLEN];
+    macCommandsLength = GetMacCommands (i, maxMACPayloadSize > macPayloadSize ? maxMACPayloadSize - macPayloadSize : 0, frameOptions, sendAdrRequest, nMacCommands);
+    fhdr.setFrameOptions (frameOptions, macCommandsLength);
+
+    p->AddHeader (fhdr);
+
+    // Encrypt the FRMPayload and compute the MIC over the encrypted frame,
+    // the MAC of the gateway appends the MIC
+    if (m_crypto && p->GetSize () < LORAWAN_MAX_PHY_PAYLOAD_SIZE - 4) {
+      uint8_t frame[LORAWAN_MAX_PHY_PAYLOAD_SIZE];
+      const uint32_t length = p->GetSize () + 1;
+      frame[0] = elementToSend.m_downstreamMsgType << 5;
+      p->CopyData (frame + 1, length - 1);
+      const uint32_t offset = LoRaWANCrypto::CryptFrame (m_endDevices.m_nwkSKey[i], m_endDevices.m_appSKey[i], false, frame, length);
+      LoRaWANCrypto::SetPacketTail (p, frame + offset, length - offset);
+      p->AddPacketTag (LoRaWANMicTag (LoRaWANCrypto::ComputeFrameMic (m_endDevices.m_nwkSKey[i], false, frame, length)));
+    }
+  } else if (m_crypto) {
+    // Compute the MIC of the JoinAccept with the AppKey, then encrypt the
+    // JoinAccept together with its MIC. The MAC of the gateway appends the
+    // encrypted MIC.
+    uint8_t frame[LORAWAN_MAX_PHY_PAYLOAD_SIZE];
+    const uint32_t length = p->GetSize () + 1;
+    NS_ASSERT (length + 4 <= sizeof (frame));
+    frame[0] = LORAWAN_JOIN_ACCEPT << 5;
+    p->CopyData (frame + 1, length - 1);
+    const LoRaWANKey appKey = GetAppKey (info.m_devEui);
+    const uint32_t mic = LoRaWANCrypto::ComputeJoinMic (appKey, frame, length);
+    for (uint32_t k = 0; k < 4; k++)
+      frame[length + k] = mic >> (8 * k);
+    LoRaWANCrypto::EncryptJoinAccept (appKey, frame, length + 4);
+    LoRaWANCrypto::SetPacketTail (p, frame + 1, length - 1);
+    const uint8_t *encryptedMic = frame + length;
+    p->AddPacketTag (LoRaWANMicTag (encryptedMic[0] | (encryptedMic[1] << 8) | (encryptedMic[2] << 16) | ((uint32_t)encryptedMic[3] << 24)));
+  }
+
+  // Add Phy Packet tag to specify channel, data rate and code rate:
   LoRaWANPhyParamsTag phyParamsTag;
   phyParamsTag.SetChannelIndex (dsChannelIndex);
   phyParamsTag.SetDataRateIndex (dsDataRateIndex);
-  phyParamsTag.SetCodeRate (it->second.m_lastCodeRate);
+  phyParamsTag.SetCodeRate (m_endDevices.m_lastCodeRate[i]);
   p->AddPacketTag (phyParamsTag);
 
   // Set Msg type
@@ -508,46 +1591,69 @@ LoRaWANNetworkServer::SendDSPacket (uint32_t deviceAddr, Ptr<LoRaWANGatewayAppli
   p->AddPacketTag (msgTypeTag);
 
   // Update DS Packet counters:
-  it->second.m_nDSPacketsSent += 1;
+  stats.m_nDSPacketsSent += 1;
   if (RW1) {
     m_nrRW1Sent++;
-    it->second.m_nDSPacketsSentRW1 += 1;
+    stats.m_nDSPacketsSentRW1 += 1;
   } else if (RW2) {
-    it->second.m_nDSPacketsSentRW2 += 1;
+    stats.m_nDSPacketsSentRW2 += 1;
     m_nrRW2Sent++;
+  } else {
+    stats.m_nDSPacketsSentClassC += 1;
+    m_nrClassCSent++;
   }
-  if (it->second.m_setAck)
-    it->second.m_nDSAcks += 1;
+  if (m_endDevices.m_setAck[i])
+    stats.m_nDSAcks += 1;
 
   // Store gatewayPtr as last DS GW:
-  it->second.m_lastDSGW = gatewayPtr;
+  info.m_lastDSGW = gatewayPtr;
 
   // Ask gateway application on lastseenGW to send the DS packet:
   gatewayPtr->SendDSPacket (p);
-  NS_LOG_DEBUG (this << " Sent DS Packet to device addr " << deviceAddr << " via GW #" << gatewayPtr->GetNode()->GetId() << " in RW" << (RW1 ? "1" : "2"));
+  NS_LOG_DEBUG (this << " Sent DS Packet to device addr " << Ipv4Address (deviceAddr) << " via GW #" << gatewayPtr->GetNode()->GetId() << " in RW" << (uint32_t)rwNumber);
 
   // Reset data structures
-  it->second.m_setAck = false; // we only sent an Ack once, see Note on page 75 of LoRaWAN std
+  m_endDevices.m_setAck[i] = false; // we only sent an Ack once, see Note on page 75 of LoRaWAN std
+  if (sendAdrRequest) {
+    // The request is applied when the end device acks it, see ProcessMacAnswers
+    info.m_adrRequestPending = false;
+    info.m_adrAnswerPending = true;
+    stats.m_nAdrRequests += 1;
+    m_nrAdrRequestsSent++;
+  }
+  if (nMacCommands > 0) {
+    const uint32_t queuedLength = macCommandsLength - (sendAdrRequest ? LoRaWANLinkAdrReqHeader ().GetSerializedSize () : 0);
+    info.m_macCommands.erase (info.m_macCommands.begin (), info.m_macCommands.begin () + queuedLength);
+    m_nrMacCommandsSent += nMacCommands;
+    if (!sendMacCommandsOnly)
+      m_nrMacCommandsPiggybacked += nMacCommands;
+  }
+  if (sendJoinAccept) {
+    info.m_joinAcceptPending = false;
+    m_nrJoinAcceptsSent++;
+  }
 
   // For some cases (see deleteQueueElement bool), remove the pending DS packet here
   if (deleteQueueElement) {
-    this->DeleteFirstDSQueueElement (deviceAddr);
+    this->DeleteFirstDSQueueElement (i);
   }
 }
 
 void
-LoRaWANNetworkServer::DSTimerExpired (uint32_t deviceAddr)
+LoRaWANNetworkServer::DSTimerExpired (uint32_t deviceIndex)
 {
-  NS_LOG_FUNCTION (this << deviceAddr);
+  NS_LOG_FUNCTION (this << deviceIndex);
 
-  auto it = m_endDevices.find (deviceAddr);
-  if (it == m_endDevices.end ()) { // end device not found
-    NS_LOG_ERROR (this << " Could not find device info struct in m_endDevices for dev addr " << deviceAddr);
+  const uint32_t i = deviceIndex;
+  if (i >= m_endDevices.GetSize ()) { // end device not found
+    NS_LOG_ERROR (this << " Invalid device index " << deviceIndex);
     return;
   }
+  LoRaWANEndDeviceInfoNS &info = m_endDevices.m_info[i];
+  const uint32_t deviceAddr = m_endDevices.m_deviceAddress[i];
 
   // Generate a Downstream packet
-  if (it->second.m_downstreamQueue.size () > 0)
+  if (info.m_downstreamQueue.m_size > 0)
     NS_LOG_INFO(this << " DS queue for end device " << Ipv4Address(deviceAddr) << " is not empty");
 
   NS_ASSERT (m_pktSize >= 8 + 1 + 4); // should be able to send at least frame header, MAC header and MAC MIC
@@ -557,6 +1663,9 @@ LoRaWANNetworkServer::DSTimerExpired (uint32_t deviceAddr)
     generatePacket = false;
   }
 
+  if (generatePacket && !MakeRoomInDSQueue (i))
+    generatePacket = false;
+
   if (generatePacket) {
     uint8_t frmPayloadSize = m_pktSize - (8 + 1 + 4);
 
@@ -576,42 +1685,183 @@ LoRaWANNetworkServer::DSTimerExpired (uint32_t deviceAddr)
       packet = Create<Packet> (frmPayloadSize);
     }
 
-    LoRaWANNSDSQueueElement* element = new LoRaWANNSDSQueueElement ();
-    element->m_downstreamPacket = packet;
-    element->m_downstreamFramePort = 1;
-    if (m_confirmedData) {
-      element->m_downstreamMsgType = LORAWAN_CONFIRMED_DATA_DOWN;
-      element->m_downstreamTransmissionsRemaining = DEFAULT_NUMBER_DS_TRANSMISSIONS;
-    } else {
-      element->m_downstreamMsgType = LORAWAN_UNCONFIRMED_DATA_DOWN;
-      element->m_downstreamTransmissionsRemaining = 1;
-    }
-    element->m_isRetransmission = false;
-    it->second.m_downstreamQueue.push_back (element);
-    it->second.m_nDSPacketsGenerated += 1;
-
-    m_dsMsgGeneratedTrace (deviceAddr, element->m_downstreamTransmissionsRemaining, element->m_downstreamMsgType, element->m_downstreamPacket);
-    NS_LOG_DEBUG (this << " Added downstream packet with size " << m_pktSize  << " to DS queue for end device " << Ipv4Address(deviceAddr) << ". queue size = " << it->second.m_downstreamQueue.size());
+    PushDSPacket (i, packet, 1, m_confirmedData);
+    if (info.m_classC)
+      SendClassCDSPacket (i);
   }
 
   // Reschedule timer:
   Time t = Seconds (this->m_downstreamIATRandomVariable->GetValue ());
-  it->second.m_downstreamTimer = Simulator::Schedule (t, &LoRaWANNetworkServer::DSTimerExpired, this, deviceAddr);
-  NS_LOG_DEBUG (this << " DS Traffic Timer for end device " << it->second.m_deviceAddress << " scheduled at " << t);
+  m_timerWheel.Schedule (t, i, LORAWAN_NS_DS_TIMER);
+  NS_LOG_DEBUG (this << " DS Traffic Timer for end device " << Ipv4Address (deviceAddr) << " scheduled at " << t);
+}
+
+bool
+LoRaWANNetworkServer::MakeRoomInDSQueue (uint32_t deviceIndex)
+{
+  // Make room in a full DS queue. The first DS packet is not dropped when
+  // it is a confirmed DS packet that was sent and waits for an ack.
+  const LoRaWANEndDeviceInfoNS &info = m_endDevices.m_info[deviceIndex];
+  if (m_maxDSQueueSize == 0 || info.m_downstreamQueue.m_size < m_maxDSQueueSize)
+    return true;
+
+  const uint32_t deviceAddr = m_endDevices.m_deviceAddress[deviceIndex];
+  m_endDevices.m_stats[deviceIndex].m_nDSQueueDrops += 1;
+  m_nrDSQueueDrops++;
+  if (m_dsQueueDropPolicy == LORAWAN_QUEUE_DROP_HEAD && !m_downstreamQueuePool.Front (info.m_downstreamQueue).m_isRetransmission) {
+    NS_LOG_DEBUG (this << " DS queue of end device " << Ipv4Address (deviceAddr) << " is full, dropping the oldest DS packet");
+    this->DeleteFirstDSQueueElement (deviceIndex);
+    return true;
+  } else {
+    NS_LOG_DEBUG (this << " DS queue of end device " << Ipv4Address (deviceAddr) << " is full, dropping the new DS packet");
+    return false;
+  }
 }
 
 void
-LoRaWANNetworkServer::DeleteFirstDSQueueElement (uint32_t deviceAddr)
+LoRaWANNetworkServer::PushDSPacket (uint32_t deviceIndex, Ptr<Packet> packet, uint8_t framePort, bool confirmed)
 {
-  auto it = m_endDevices.find (deviceAddr);
-  if (it == m_endDevices.end ()) { // end device not found
-    NS_LOG_ERROR (this << " Could not find device info struct in m_endDevices for dev addr " << deviceAddr << ". Unable to delete DS queue element.");
+  LoRaWANEndDeviceInfoNS &info = m_endDevices.m_info[deviceIndex];
+  const uint32_t deviceAddr = m_endDevices.m_deviceAddress[deviceIndex];
+
+  LoRaWANNSDSQueueElement &element = m_downstreamQueuePool.Get (m_downstreamQueuePool.PushBack (info.m_downstreamQueue));
+  m_dsQueueSize = m_downstreamQueuePool.GetSize ();
+  element.m_downstreamPacket = packet;
+  element.m_downstreamFramePort = framePort;
+  if (confirmed) {
+    element.m_downstreamMsgType = LORAWAN_CONFIRMED_DATA_DOWN;
+    element.m_downstreamTransmissionsRemaining = DEFAULT_NUMBER_DS_TRANSMISSIONS;
+  } else {
+    element.m_downstreamMsgType = LORAWAN_UNCONFIRMED_DATA_DOWN;
+    element.m_downstreamTransmissionsRemaining = 1;
+  }
+  element.m_isRetransmission = false;
+  m_endDevices.m_stats[deviceIndex].m_nDSPacketsGenerated += 1;
+
+  m_dsMsgGeneratedTrace (deviceAddr, element.m_downstreamTransmissionsRemaining, element.m_downstreamMsgType, element.m_downstreamPacket);
+  NS_LOG_DEBUG (this << " Added downstream packet with size " << packet->GetSize () << " to DS queue for end device " << Ipv4Address(deviceAddr) << ". queue size = " << info.m_downstreamQueue.m_size);
+}
+
+bool
+LoRaWANNetworkServer::HaveClassCDSPacket (uint32_t deviceIndex)
+{
+  // A JoinAccept and acks are only sent in the receive windows. A confirmed
+  // DS packet is pushed once, its retransmissions are sent in the receive
+  // windows that follow the next US transmission.
+  const LoRaWANEndDeviceInfoNS &info = m_endDevices.m_info[deviceIndex];
+  if (info.m_joinAcceptPending)
+    return false;
+  if (info.m_downstreamQueue.m_size > 0)
+    return !m_downstreamQueuePool.Front (info.m_downstreamQueue).m_isRetransmission;
+  return info.m_adrRequestPending || !info.m_macCommands.empty ();
+}
+
+void
+LoRaWANNetworkServer::SendClassCDSPacket (uint32_t deviceIndex)
+{
+  NS_LOG_FUNCTION (this << deviceIndex);
+
+  const uint32_t i = deviceIndex;
+  LoRaWANEndDeviceInfoNS &info = m_endDevices.m_info[i];
+  if (!info.m_classC || !HaveClassCDSPacket (i))
+    return;
+
+  // DS packets that are queued while the receive windows of a US transmission
+  // are pending are sent in these receive windows
+  const Time now = Simulator::Now ();
+  if (info.m_rw1Expiry > now || info.m_rw2Expiry > now)
+    return;
+
+  if (info.m_lastGWs.empty ()) {
+    NS_LOG_DEBUG (this << " No gateway known for Class C end device " << Ipv4Address (m_endDevices.m_deviceAddress[i]) << ", waiting for a US transmission");
     return;
   }
 
-  LoRaWANNSDSQueueElement* ptr = it->second.m_downstreamQueue.front ();
-  delete ptr;
-  it->second.m_downstreamQueue.pop_front ();
+  // Class C end devices listen on the RW2 channel and data rate
+  const uint8_t dsChannelIndex = LoRaWAN::m_RW2ChannelIndex;
+  const uint8_t dsDataRateIndex = LoRaWAN::m_RW2DataRateIndex;
+  const Time airTime = GetDSAirtime (i, dsDataRateIndex);
+  Ptr<LoRaWANGatewayApplication> gw = SelectDSGateway (i, dsChannelIndex, dsDataRateIndex, now, m_planDownlinks ? airTime : Time ());
+  if (!gw) {
+    // Retry when the sub band of the first gateway is available again
+    Time delay = m_classCRetryInterval;
+    for (auto it_gw = info.m_lastGWs.cbegin (); it_gw != info.m_lastGWs.cend (); it_gw++) {
+      const Time available = it_gw->m_gateway->GetSubBandAvailableTime (dsChannelIndex) - now;
+      if (it_gw == info.m_lastGWs.cbegin () || available < delay)
+        delay = available;
+    }
+    ScheduleClassCTimer (i, std::max (delay, m_classCRetryInterval));
+    return;
+  }
+
+  if (m_planDownlinks)
+    gw->ReserveTx (now, dsChannelIndex, airTime);
+  this->SendDSPacket (i, gw, false, false);
+
+  // Push the next DS packet once this one has been sent
+  ScheduleClassCTimer (i, airTime);
+}
+
+void
+LoRaWANNetworkServer::ScheduleClassCTimer (uint32_t deviceIndex, Time delay)
+{
+  LoRaWANEndDeviceInfoNS &info = m_endDevices.m_info[deviceIndex];
+  if (!info.m_classC || info.m_classCExpiry > Simulator::Now () || !HaveClassCDSPacket (deviceIndex))
+    return;
+
+  info.m_classCExpiry = m_timerWheel.Schedule (delay, deviceIndex, LORAWAN_NS_CLASS_C_TIMER);
+}
+
+void
+LoRaWANNetworkServer::DeleteFirstDSQueueElement (uint32_t deviceIndex)
+{
+  if (deviceIndex >= m_endDevices.GetSize ()) { // end device not found
+    NS_LOG_ERROR (this << " Invalid device index " << deviceIndex << ". Unable to delete DS queue element.");
+    return;
+  }
+
+  m_downstreamQueuePool.PopFront (m_endDevices.m_info[deviceIndex].m_downstreamQueue);
+  m_dsQueueSize = m_downstreamQueuePool.GetSize ();
+}
+
+void
+LoRaWANNetworkServer::TimerExpired (uint32_t deviceIndex, uint8_t timerType)
+{
+  switch (timerType) {
+    case LORAWAN_NS_RW1_TIMER:
+      RW1TimerExpired (deviceIndex);
+      break;
+    case LORAWAN_NS_RW2_TIMER:
+      RW2TimerExpired (deviceIndex);
+      break;
+    case LORAWAN_NS_DS_TIMER:
+      DSTimerExpired (deviceIndex);
+      break;
+    case LORAWAN_NS_CLASS_C_TIMER:
+      SendClassCDSPacket (deviceIndex);
+      break;
+    default:
+      NS_LOG_ERROR (this << " Unknown timer type " << (uint32_t)timerType);
+  }
+}
+
+void
+LoRaWANNetworkServer::SetTimerResolution (Time resolution)
+{
+  NS_LOG_FUNCTION (this << resolution);
+  m_timerWheel.SetResolution (resolution);
+}
+
+Time
+LoRaWANNetworkServer::GetTimerResolution (void) const
+{
+  return m_timerWheel.GetResolution ();
+}
+
+const LoRaWANTimerWheel &
+LoRaWANNetworkServer::GetTimerWheel (void) const
+{
+  return m_timerWheel;
 }
 
 int64_t
@@ -650,6 +1900,11 @@ LoRaWANGatewayApplication::GetTypeId (void)
     .SetParent<Application> ()
     .SetGroupName("Applications")
     .AddConstructor<LoRaWANGatewayApplication> ()
+    .AddAttribute ("NetworkServer",
+                   "The network server of this gateway. Gateways without a network server use a network server that is shared by all such gateways.",
+                   PointerValue (),
+                   MakePointerAccessor (&LoRaWANGatewayApplication::m_lorawanNSPtr),
+                   MakePointerChecker<LoRaWANNetworkServer> ())
     .AddTraceSource ("Tx", "A new packet is created and is sent",
                      MakeTraceSourceAccessor (&LoRaWANGatewayApplication::m_txTrace),
                      "ns3::Packet::TracedCallback")
@@ -667,7 +1922,8 @@ LoRaWANGatewayApplication::DoInitialize (void)
 {
   NS_LOG_FUNCTION (this);
 
-  this->m_lorawanNSPtr = LoRaWANNetworkServer::getLoRaWANNetworkServerPointer ();
+  if (!m_lorawanNSPtr)
+    m_lorawanNSPtr = LoRaWANNetworkServer::getLoRaWANNetworkServerPointer ();
 
   // chain up
   Application::DoInitialize ();
@@ -679,10 +1935,15 @@ LoRaWANGatewayApplication::DoDispose (void)
   NS_LOG_FUNCTION (this);
 
   m_socket = 0;
-  this->m_lorawanNSPtr = nullptr;
-  // clear ref count in static member, as to destroy the LoRaWANNetworkServer object.
+  m_txPlan.Clear ();
+  // Dispose the network server, which breaks the reference cycles with its
+  // gateways and roaming partners, and clear ref count in static member, as
+  // to destroy the default LoRaWANNetworkServer object.
   // Note we should only destroy the NS object when the simulation is stopped and all gateway applications are destroyed.
   // So we assume that a gateway is not destroyed before the end of the simulation
+  if (m_lorawanNSPtr)
+    m_lorawanNSPtr->Dispose ();
+  this->m_lorawanNSPtr = nullptr;
 
   if (LoRaWANNetworkServer::haveLoRaWANNetworkServerObject ())
     LoRaWANNetworkServer::clearLoRaWANNetworkServerPointer ();
@@ -709,7 +1970,22 @@ int64_t
 LoRaWANGatewayApplication::AssignStreams (int64_t stream)
 {
   NS_LOG_FUNCTION (this << stream);
-  return LoRaWANNetworkServer::getLoRaWANNetworkServerPointer ()->AssignStreams (stream);
+  if (!m_lorawanNSPtr)
+    m_lorawanNSPtr = LoRaWANNetworkServer::getLoRaWANNetworkServerPointer ();
+  return m_lorawanNSPtr->AssignStreams (stream);
+}
+
+void
+LoRaWANGatewayApplication::SetNetworkServer (Ptr<LoRaWANNetworkServer> networkServer)
+{
+  NS_LOG_FUNCTION (this << networkServer);
+  m_lorawanNSPtr = networkServer;
+}
+
+Ptr<LoRaWANNetworkServer>
+LoRaWANGatewayApplication::GetNetworkServer (void) const
+{
+  return m_lorawanNSPtr;
 }
 
 bool
@@ -727,6 +2003,84 @@ LoRaWANGatewayApplication::CanSendImmediatelyOnChannel (uint8_t channelIndex, ui
   }
 }
 
+bool
+LoRaWANGatewayApplication::CanReserveTx (Time start, uint8_t channelIndex, Time airTime)
+{
+  NS_LOG_FUNCTION (this << start << (unsigned)channelIndex << airTime);
+
+  Ptr<LoRaWANNetDevice> device = DynamicCast<LoRaWANNetDevice> (GetNode ()->GetDevice (0));
+  if (!device || !device->GetMacRDC ()) {
+    NS_LOG_ERROR (this << " Cannot get RDC of the LoRaWANNetDevice belonging to this gateway");
+    return false;
+  }
+
+  m_txPlan.Prune (Simulator::Now ());
+
+  // The RDC knows the time off of past transmissions, the plan that of future ones
+  Ptr<LoRaWANMac::LoRaWANMacRDC> rdc = device->GetMacRDC ();
+  const uint8_t subBandIndex = rdc->GetSubBandIndexForChannelIndex (channelIndex);
+  if (rdc->GetSubBandAvailableTime (subBandIndex) > start)
+    return false;
+
+  return m_txPlan.IsFeasible (start, airTime, subBandIndex, rdc->GetDutyCycleLimitForSubBand (subBandIndex));
+}
+
+void
+LoRaWANGatewayApplication::ReserveTx (Time start, uint8_t channelIndex, Time airTime)
+{
+  NS_LOG_FUNCTION (this << start << (unsigned)channelIndex << airTime);
+
+  Ptr<LoRaWANNetDevice> device = DynamicCast<LoRaWANNetDevice> (GetNode ()->GetDevice (0));
+  if (!device || !device->GetMacRDC ()) {
+    NS_LOG_ERROR (this << " Cannot get RDC of the LoRaWANNetDevice belonging to this gateway");
+    return;
+  }
+
+  Ptr<LoRaWANMac::LoRaWANMacRDC> rdc = device->GetMacRDC ();
+  const uint8_t subBandIndex = rdc->GetSubBandIndexForChannelIndex (channelIndex);
+  m_txPlan.Reserve (start, airTime, subBandIndex, rdc->GetDutyCycleLimitForSubBand (subBandIndex));
+}
+
+void
+LoRaWANGatewayApplication::ReleaseTx (Time start)
+{
+  NS_LOG_FUNCTION (this << start);
+  m_txPlan.Release (start);
+}
+
+Time
+LoRaWANGatewayApplication::GetTimeOff (uint8_t channelIndex, Time airTime)
+{
+  Ptr<LoRaWANNetDevice> device = DynamicCast<LoRaWANNetDevice> (GetNode ()->GetDevice (0));
+  if (!device || !device->GetMacRDC ()) {
+    NS_LOG_ERROR (this << " Cannot get RDC of the LoRaWANNetDevice belonging to this gateway");
+    return Time::Max ();
+  }
+
+  Ptr<LoRaWANMac::LoRaWANMacRDC> rdc = device->GetMacRDC ();
+  const uint8_t subBandIndex = rdc->GetSubBandIndexForChannelIndex (channelIndex);
+  return airTime * (rdc->GetDutyCycleLimitForSubBand (subBandIndex) - 1);
+}
+
+Time
+LoRaWANGatewayApplication::GetSubBandAvailableTime (uint8_t channelIndex)
+{
+  Ptr<LoRaWANNetDevice> device = DynamicCast<LoRaWANNetDevice> (GetNode ()->GetDevice (0));
+  if (!device || !device->GetMacRDC ()) {
+    NS_LOG_ERROR (this << " Cannot get RDC of the LoRaWANNetDevice belonging to this gateway");
+    return Time::Max ();
+  }
+
+  Ptr<LoRaWANMac::LoRaWANMacRDC> rdc = device->GetMacRDC ();
+  return rdc->GetSubBandAvailableTime (rdc->GetSubBandIndexForChannelIndex (channelIndex));
+}
+
+const LoRaWANGatewayTxPlan &
+LoRaWANGatewayApplication::GetTxPlan (void) const
+{
+  return m_txPlan;
+}
+
 void LoRaWANGatewayApplication::SendDSPacket (Ptr<Packet> p)
 {
   NS_LOG_FUNCTION (this);
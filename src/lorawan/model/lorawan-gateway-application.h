@@ -29,8 +29,13 @@
 #include "ns3/traced-value.h"
 #include "ns3/simple-ref-count.h"
 #include "ns3/random-variable-stream.h"
+#include "ns3/header.h"
+#include "lorawan-adr.h"
+#include "lorawan-timer-wheel.h"
+#include "lorawan-gateway-tx-plan.h"
+#include "lorawan-crypto.h"
 #include <unordered_map>
-#include <deque>
+#include <vector>
 
 namespace ns3 {
 
@@ -58,6 +63,17 @@ namespace TracedValueCallback {
  */
 
   typedef void (* LoRaWANDSMessageTracedCallback) (uint32_t deviceAddr, uint8_t txRemaining, uint8_t msgType, Ptr<const Packet> packet);
+
+/**
+ * \ingroup lorawan
+ * TracedCallback signature for DevStatusAns MAC commands received by the NS
+ *
+ * \param [in] deviceAddr The device address of the end device.
+ * \param [in] battery Battery level of the end device, see LoRaWANDevStatusAnsHeader.
+ * \param [in] margin Demodulation margin of the end device in dB.
+ */
+
+  typedef void (* LoRaWANDevStatusTracedCallback) (uint32_t deviceAddr, uint8_t battery, int8_t margin);
 }  // namespace TracedValueCallback
 
 class Address;
@@ -73,26 +89,146 @@ typedef struct LoRaWANNSDSQueueElement {
   bool 		  m_isRetransmission;
 } LoRaWANNSDSQueueElement;
 
+/**
+ * The DS queue of an end device: a FIFO of elements in a
+ * LoRaWANNSDSQueuePool, linked by index.
+ */
+typedef struct LoRaWANNSDSQueue {
+  LoRaWANNSDSQueue () : m_head(0xffffffff), m_tail(0xffffffff), m_size(0) {}
+
+  uint32_t        m_head;  //!< pool index of the first element
+  uint32_t        m_tail;  //!< pool index of the last element
+  uint32_t        m_size;  //!< number of elements in the queue
+} LoRaWANNSDSQueue;
+
+/**
+ * Pool of DS queue elements shared by all end devices of a network server.
+ * The elements are stored in one vector and linked into the per device
+ * queues (LoRaWANNSDSQueue) by index. Freed elements are kept on a free list
+ * and reused, so generating DS packets does not allocate once the pool has
+ * grown to the peak number of queued packets.
+ *
+ * The pool counts the elements that are queued, which gives the occupancy of
+ * the DS queues of all end devices.
+ *
+ * References to elements are invalidated by PushBack.
+ */
+class LoRaWANNSDSQueuePool
+{
+public:
+  static const uint32_t m_nullIndex = 0xffffffff;
+
+  LoRaWANNSDSQueuePool ();
+
+  /**
+   * Append a new element to a queue.
+   *
+   * \param queue the queue
+   * \return the pool index of the element
+   */
+  uint32_t PushBack (LoRaWANNSDSQueue &queue);
+
+  /**
+   * Remove the first element of a queue and return it to the pool.
+   *
+   * \param queue the queue, which should not be empty
+   */
+  void PopFront (LoRaWANNSDSQueue &queue);
+
+  /**
+   * Return all elements of a queue to the pool.
+   *
+   * \param queue the queue
+   */
+  void Clear (LoRaWANNSDSQueue &queue);
+
+  LoRaWANNSDSQueueElement &Front (const LoRaWANNSDSQueue &queue);
+  LoRaWANNSDSQueueElement &Get (uint32_t index);
+
+  /**
+   * \return the number of elements in the pool, queued or free
+   */
+  uint32_t GetCapacity (void) const;
+
+  /**
+   * \return the number of queued elements, summed over all queues
+   */
+  uint32_t GetSize (void) const;
+
+  /**
+   * \return the largest number of elements that were queued at the same time
+   */
+  uint32_t GetPeakSize (void) const;
+
+private:
+  std::vector<LoRaWANNSDSQueueElement> m_elements;
+  std::vector<uint32_t> m_next; //!< next element in the queue or in the free list
+  uint32_t m_freeHead;          //!< first element of the free list
+  uint32_t m_size;              //!< number of queued elements
+  uint32_t m_peakSize;          //!< largest m_size so far
+};
+
+/**
+ * A gateway that received the last US transmission of an end device, and the
+ * link quality of the reception (see LoRaWANRxMetadataTag).
+ */
+typedef struct LoRaWANGatewayRxInfoNS {
+  Ptr<LoRaWANGatewayApplication> m_gateway;
+  bool            m_haveMetadata; //!< whether m_rssi and m_snr are known
+  double          m_rssi;         //!< RSSI of the reception in dBm
+  double          m_snr;          //!< SNR of the reception in dB
+} LoRaWANGatewayRxInfoNS;
+
+/**
+ * The state of an end device that is not accessed for every US packet, see
+ * LoRaWANEndDeviceTableNS.
+ */
 typedef struct LoRaWANEndDeviceInfoNS {
-  LoRaWANEndDeviceInfoNS () : m_deviceAddress(), m_rx1DROffset(0), m_lastDSGW(nullptr), m_lastGWs(),
-	m_lastDataRateIndex(0), m_lastChannelIndex(0), m_lastCodeRate(0), m_lastSeen(0),
-	m_framePending(false),m_setAck(false), m_fCntUp(0), m_fCntDown(0),
-	m_nUSPackets(0), m_nUniqueUSPackets(0), m_nUSRetransmission(0), m_nUSDuplicates(0), m_nUSAcks(0),
-	m_nDSPacketsGenerated(0), m_nDSPacketsSent(0), m_nDSPacketsSentRW1(0), m_nDSPacketsSentRW2(0), m_nDSRetransmission(0), m_nDSAcks(0),
-	m_rw1Timer(), m_rw2Timer(), m_downstreamQueue(),m_downstreamTimer() {}
+  LoRaWANEndDeviceInfoNS () : m_lastDSGW(nullptr), m_lastGWs(),
+	m_adrHistory(), m_txPowerIndex(0), m_adrRequestPending(false), m_adrAnswerPending(false), m_adrDataRateIndex(0), m_adrTxPowerIndex(0),
+	m_macCommands(), m_requestedRx1DROffset(0),
+	m_rw1Expiry(), m_rw2Expiry(), m_rw2GW(nullptr), m_classC(false), m_classCExpiry(), m_devEui(0), m_devNonces(), m_lastDevNonce(0), m_joinAcceptPending(false), m_newSession(false),
+	m_downstreamQueue() {}
 
-  Ipv4Address     m_deviceAddress;
-  uint8_t 	  m_rx1DROffset;
   Ptr<LoRaWANGatewayApplication> m_lastDSGW;
-  std::vector< Ptr<LoRaWANGatewayApplication> > m_lastGWs;
-  uint8_t         m_lastDataRateIndex;
-  uint8_t         m_lastChannelIndex;
-  uint8_t         m_lastCodeRate;
-  Time            m_lastSeen;
-  bool            m_framePending;
-  bool            m_setAck;
-  uint32_t        m_fCntUp;       //!< Uplink frame counter
-  uint32_t        m_fCntDown;     //!< Downlink frame counter
+  std::vector<LoRaWANGatewayRxInfoNS> m_lastGWs; //!< Gateways that received the last US transmission, in order of reception
+
+  LoRaWANAdrHistory m_adrHistory; //!< SNRs of the last US packets, allocated on the first US packet with the ADR bit
+  uint8_t         m_txPowerIndex; //!< TX power index of the end device, as last acked in a LinkADRAns
+  bool            m_adrRequestPending; //!< A LinkADRReq should be sent in the next DS packet
+  bool            m_adrAnswerPending; //!< A LinkADRReq was sent, its LinkADRAns is expected in the next US packet
+  uint8_t         m_adrDataRateIndex; //!< Data rate index of the pending LinkADRReq
+  uint8_t         m_adrTxPowerIndex; //!< TX power index of the pending LinkADRReq
+
+  std::vector<uint8_t> m_macCommands; //!< Queued MAC commands other than LinkADRReq, see LoRaWANNetworkServer::QueueMacCommand
+  uint8_t         m_requestedRx1DROffset; //!< RX1DROffset of the last RXParamSetupReq, applied on its RXParamSetupAns
+
+  Time            m_rw1Expiry; //!< Expiration time of the last RW1 timer
+  Time            m_rw2Expiry; //!< Expiration time of the last RW2 timer
+  Ptr<LoRaWANGatewayApplication> m_rw2GW; //!< Gateway with a TX reservation at m_rw2Expiry, see PlanDownlinks
+
+  bool            m_classC; //!< The end device is a Class C end device, see LoRaWANNetworkServer::SetClassC
+  Time            m_classCExpiry; //!< Expiration time of the last Class C timer
+
+  // Over-the-air activation
+  uint64_t        m_devEui; //!< DevEUI of an end device that joined, zero for other end devices
+  std::vector<uint16_t> m_devNonces; //!< DevNonces of accepted JoinRequests, sorted
+  uint16_t        m_lastDevNonce; //!< DevNonce of the last JoinRequest
+  bool            m_joinAcceptPending; //!< A JoinAccept should be sent in the RWs of the last JoinRequest
+  bool            m_newSession; //!< No US data packet was received since the last JoinAccept
+
+  // Pending downstream traffic
+  LoRaWANNSDSQueue m_downstreamQueue;
+} LoRaWANEndDeviceInfoNS;
+
+/**
+ * Statistics of an end device, see LoRaWANEndDeviceTableNS.
+ */
+typedef struct LoRaWANEndDeviceStatsNS {
+  LoRaWANEndDeviceStatsNS () :
+	m_nUSPackets(0), m_nUniqueUSPackets(0), m_nUSRetransmission(0), m_nUSDuplicates(0), m_nUSAcks(0),
+	m_nDSPacketsGenerated(0), m_nDSPacketsSent(0), m_nDSPacketsSentRW1(0), m_nDSPacketsSentRW2(0), m_nDSPacketsSentClassC(0), m_nDSRetransmission(0), m_nDSAcks(0),
+	m_nAdrRequests(0), m_nDSQueueDrops(0), m_nUSMicFailures(0) {}
 
   uint32_t 	  m_nUSPackets;   //!< The total number of received US packets
   uint32_t 	  m_nUniqueUSPackets;   //!< Number of received unique US packets (i.e. with a new US frame counter)
@@ -104,17 +240,103 @@ typedef struct LoRaWANEndDeviceInfoNS {
   uint32_t 	  m_nDSPacketsSent;   //!< The total number of sent DS packets
   uint32_t 	  m_nDSPacketsSentRW1;   //!< The number of sent DS packets in RW1
   uint32_t 	  m_nDSPacketsSentRW2;   //!< The number of sent DS packets in RW2
+  uint32_t 	  m_nDSPacketsSentClassC;   //!< The number of DS packets sent to a Class C end device in between uplinks
   uint32_t 	  m_nDSRetransmission;   //!< Number of retransmissions sent for of DS packets
   uint32_t        m_nDSAcks;  //!< Number of downstream acks sent
+  uint32_t        m_nAdrRequests; //!< Number of LinkADRReq commands sent
+  uint32_t        m_nDSQueueDrops; //!< Number of DS packets dropped because the DS queue was full
+  uint32_t        m_nUSMicFailures; //!< Number of US packets dropped because of an invalid MIC
+} LoRaWANEndDeviceStatsNS;
 
-  EventId	  m_rw1Timer;
-  EventId	  m_rw2Timer;
+/**
+ * The end devices of a network server, stored densely by device index. The
+ * fields that are read or written for every US packet are kept in separate
+ * arrays (struct of arrays), so that processing an US packet touches few
+ * cache lines. The remaining state is in m_info and the statistics are in
+ * m_stats, both indexed by device index as well.
+ *
+ * Device addresses are mapped to device indexes with a direct lookup table
+ * as long as the addresses are dense (as allocated by LoRaWANHelper), and
+ * with a hash map for addresses that are far outside the range of known
+ * addresses.
+ */
+class LoRaWANEndDeviceTableNS
+{
+public:
+  static const uint32_t m_invalidIndex = 0xffffffff;
 
-  // Pending downstream traffic
-  std::deque<LoRaWANNSDSQueueElement* > m_downstreamQueue;
+  LoRaWANEndDeviceTableNS ();
 
-  EventId 	  m_downstreamTimer; // DS traffic generator timer
-} LoRaWANEndDeviceInfoNS;
+  /**
+   * \param deviceAddr the device address
+   * \return the device index, or m_invalidIndex if the device is unknown
+   */
+  uint32_t Find (uint32_t deviceAddr) const;
+
+  /**
+   * Add an end device with default state.
+   *
+   * \param deviceAddr the device address, which should be unknown
+   * \return the device index
+   */
+  uint32_t Add (Ipv4Address deviceAddr);
+
+  /**
+   * \param n the number of end devices to allocate memory for
+   */
+  void Reserve (uint32_t n);
+
+  uint32_t GetSize (void) const;
+
+  void Clear (void);
+
+  // Hot fields
+  std::vector<uint32_t> m_deviceAddress;
+  std::vector<uint32_t> m_fCntUp;       //!< Uplink frame counter
+  std::vector<uint32_t> m_fCntDown;     //!< Downlink frame counter
+  std::vector<Time>     m_lastSeen;
+  std::vector<uint8_t>  m_lastDataRateIndex;
+  std::vector<uint8_t>  m_lastChannelIndex;
+  std::vector<uint8_t>  m_lastCodeRate;
+  std::vector<uint8_t>  m_rx1DROffset;
+  std::vector<uint8_t>  m_setAck;       //!< Set the Ack bit in the next DS packet
+  std::vector<uint8_t>  m_framePending;
+  std::vector<uint8_t>  m_adr;          //!< ADR bit of the last US packet
+
+  // Session keys, the default keys of the device address (see
+  // LoRaWANCrypto::DeriveDefaultSessionKeys) until the end device joins or
+  // LoRaWANNetworkServer::SetSessionKeys is called
+  std::vector<LoRaWANKey> m_nwkSKey;
+  std::vector<LoRaWANKey> m_appSKey;
+
+  std::vector<LoRaWANEndDeviceInfoNS> m_info;
+  std::vector<LoRaWANEndDeviceStatsNS> m_stats;
+
+private:
+  std::vector<uint32_t> m_directIndex;  //!< device index by device address, for dense addresses
+  std::unordered_map<uint32_t, uint32_t> m_sparseIndex; //!< device index by device address, for other addresses
+};
+
+/**
+ * A US packet that waits for the verification of its MIC in the network
+ * server, see LoRaWANNetworkServer::VerifyUSBatch.
+ */
+typedef struct LoRaWANNSUSPacket {
+  Ptr<LoRaWANGatewayApplication> m_gateway;
+  Address m_from;
+  Ptr<Packet> m_packet;
+} LoRaWANNSUSPacket;
+
+/**
+ * The timers of an end device in the network server, see LoRaWANTimerWheel.
+ */
+typedef enum
+{
+  LORAWAN_NS_RW1_TIMER = 0,
+  LORAWAN_NS_RW2_TIMER,
+  LORAWAN_NS_DS_TIMER,
+  LORAWAN_NS_CLASS_C_TIMER,
+} LoRaWANNSTimerType;
 
 //class LoRaWANNetworkServer : public SimpleRefCount<LoRaWANNetworkServer>
 class LoRaWANNetworkServer : public Object
@@ -127,8 +349,126 @@ public:
   virtual void DoDispose (void);
 
   void PopulateEndDevices (void);
-  LoRaWANEndDeviceInfoNS InitEndDeviceInfo (Ipv4Address);
 
+  /**
+   * Add an end device to the end device table and start its DS traffic
+   * generator.
+   *
+   * \return the device index
+   */
+  uint32_t AddEndDevice (Ipv4Address);
+
+  const LoRaWANEndDeviceTableNS &GetEndDevices (void) const;
+
+  /**
+   * \param devEui the DevEUI of an end device that joined by over-the-air activation
+   * \return the device index, or LoRaWANEndDeviceTableNS::m_invalidIndex if no JoinRequest of the end device was received
+   */
+  uint32_t FindJoinedEndDevice (uint64_t devEui) const;
+
+  /**
+   * Register an end device for which this network server is the home network
+   * server. Once end devices are registered, PopulateEndDevices only adds the
+   * registered end devices instead of all end devices in the simulation, and
+   * US packets of other end devices are forwarded to a roaming partner or
+   * dropped.
+   *
+   * \param deviceAddr the device address
+   */
+  void AddHomeEndDevice (Ipv4Address deviceAddr);
+
+  /**
+   * \param deviceAddr the device address
+   * \return whether this network server is the home network server of the end device
+   */
+  bool IsHomeNetworkServer (Ipv4Address deviceAddr);
+
+  /**
+   * Queue a MAC command (e.g. a LoRaWANDevStatusReqHeader) for an end device.
+   * Queued MAC commands are piggybacked in the frame options of the next DS
+   * packets (data or ack) of the end device. When there is nothing else to
+   * send, a DS packet without FRMPayload is sent for the MAC commands.
+   * The LinkADRReq of ADR is not queued, it is generated by UpdateAdr.
+   *
+   * \param deviceAddr the device address
+   * \param command the MAC command, including its CID
+   * \return false if the end device is unknown or the MAC command is not supported
+   */
+  bool QueueMacCommand (Ipv4Address deviceAddr, const Header &command);
+
+  /**
+   * Queue a DS data packet for an end device. Like the DS packets generated
+   * by the network server (see GenerateDataDown), the packet is sent in the
+   * RWs after an uplink of the end device, or right away to a Class C end
+   * device.
+   *
+   * \param deviceAddr the end device
+   * \param payload the FRMPayload
+   * \param framePort the frame port, 1 to 223
+   * \param confirmed whether the end device should Ack the packet
+   * \return false if the end device is unknown or its DS queue is full
+   */
+  bool QueueDSPacket (Ipv4Address deviceAddr, Ptr<Packet> payload, uint8_t framePort, bool confirmed);
+
+  /**
+   * Set whether an end device is a Class C end device. The class of the end
+   * devices of which the LoRaWANNetDevice is found in ns3::NodeList is set
+   * when the end devices are populated, this function is needed for other end
+   * devices (e.g. end devices that joined).
+   *
+   * DS packets and MAC commands for a Class C end device are sent as soon as
+   * they are queued, on the RW2 channel and data rate, through a gateway
+   * that received the last uplink of the end device. The RW timers do not
+   * have to expire first. A confirmed DS packet is only sent once this way,
+   * it is retransmitted in the RWs of the next uplink until it is Acked.
+   *
+   * \param deviceAddr the end device
+   * \param classC whether the end device is a Class C end device
+   * \return false if the end device is unknown
+   */
+  bool SetClassC (Ipv4Address deviceAddr, bool classC);
+
+  /**
+   * Set the session keys of an end device, e.g. of an end device that is
+   * activated by personalization with other keys than the default keys of
+   * its device address.
+   *
+   * \param deviceAddr the end device
+   * \param nwkSKey the network session key
+   * \param appSKey the application session key
+   * \return false if the end device is unknown
+   */
+  bool SetSessionKeys (Ipv4Address deviceAddr, const LoRaWANKey &nwkSKey, const LoRaWANKey &appSKey);
+
+  /**
+   * Set the AppKey of an end device that joins by over-the-air activation,
+   * with which the MICs of its JoinRequests are verified and its JoinAccepts
+   * are encrypted, and from which the session keys are derived when the
+   * JoinAccept is sent. The AppKey of other end devices is derived from their
+   * DevEUI, like the default AppKey of LoRaWANEndDeviceApplication (see
+   * LoRaWANCrypto::DeriveDefaultAppKey).
+   *
+   * \param devEui the DevEUI of the end device
+   * \param appKey the AppKey
+   */
+  void SetAppKey (uint64_t devEui, const LoRaWANKey &appKey);
+
+  /**
+   * Forward US packets of end devices that are not served by this network
+   * server, but by the partner, to the partner (passive roaming). The partner
+   * answers through the gateway of this network server that received the US
+   * packet. Roaming is one way, call AddRoamingPartner on the partner as well
+   * for the other direction.
+   *
+   * \param partner the network server of the other network
+   */
+  void AddRoamingPartner (Ptr<LoRaWANNetworkServer> partner);
+
+  /**
+   * The network server that is used by gateways that are not attached to a
+   * network server (see the NetworkServer attribute of
+   * LoRaWANGatewayApplication). It is created on first use.
+   */
   static void clearLoRaWANNetworkServerPointer () { LoRaWANNetworkServer::m_ptr = nullptr; }
   static bool haveLoRaWANNetworkServerObject () { return LoRaWANNetworkServer::m_ptr != NULL; }
   static Ptr<LoRaWANNetworkServer> getLoRaWANNetworkServerPointer ();
@@ -136,33 +476,257 @@ public:
   void SetConfirmedDataDown (bool confirmedData);
   bool GetConfirmedDataDown (void) const;
 
+  /**
+   * Handle a US packet that was received by a gateway. When Crypto is
+   * enabled, data packets are queued until CryptoBatchSize packets are
+   * queued or until the end of the current time step, and then verified and
+   * decrypted as a batch by VerifyUSBatch.
+   */
   void HandleUSPacket (Ptr<LoRaWANGatewayApplication>, Address from, Ptr<Packet> packet);
-  void RW1TimerExpired (uint32_t deviceAddr);
-  void RW2TimerExpired (uint32_t deviceAddr);
-  void SendDSPacket (uint32_t deviceAddr, Ptr<LoRaWANGatewayApplication> gatewayPtr, bool RW1, bool RW2);
-  bool HaveSomethingToSendToEndDevice (uint32_t deviceAddr);
-  void DSTimerExpired (uint32_t deviceAddr);
-  void DeleteFirstDSQueueElement (uint32_t deviceAddr);
+
+  // The following functions take the index of the end device in the end
+  // device table, not its address
+  void RW1TimerExpired (uint32_t deviceIndex);
+  void RW2TimerExpired (uint32_t deviceIndex);
+  void SendDSPacket (uint32_t deviceIndex, Ptr<LoRaWANGatewayApplication> gatewayPtr, bool RW1, bool RW2);
+  bool HaveSomethingToSendToEndDevice (uint32_t deviceIndex);
+  void DSTimerExpired (uint32_t deviceIndex);
+  void DeleteFirstDSQueueElement (uint32_t deviceIndex);
+
+  /**
+   * Try to send the pending DS packet of a Class C end device right away. If
+   * no gateway is available, a Class C timer is scheduled to try again.
+   *
+   * \param deviceIndex the end device
+   */
+  void SendClassCDSPacket (uint32_t deviceIndex);
+
+  /**
+   * Called by the timer wheel when a timer of an end device expires.
+   *
+   * \param deviceIndex the end device
+   * \param timerType the LoRaWANNSTimerType of the timer
+   */
+  void TimerExpired (uint32_t deviceIndex, uint8_t timerType);
+
+  /**
+   * \param resolution the resolution of the timer wheel, zero schedules a
+   * simulator event for every timer
+   */
+  void SetTimerResolution (Time resolution);
+  Time GetTimerResolution (void) const;
+
+  const LoRaWANTimerWheel &GetTimerWheel (void) const;
+
+  /**
+   * Select the gateway for a DS transmission to an end device among the
+   * gateways that received its last US transmission. Only gateways that can
+   * send immediately (i.e. that are not transmitting and not restricted by
+   * the duty cycle) are considered. If SelectBestGateway is set, the gateway
+   * with the highest link margin is selected, otherwise the first gateway
+   * that received the US transmission.
+   *
+   * When an airtime is given, the transmission should also fit in the TX
+   * plan of the gateway (see LoRaWANGatewayApplication::CanReserveTx) at the
+   * given start time. A gateway only has to be able to send immediately when
+   * the transmission starts now.
+   *
+   * \param deviceIndex the end device
+   * \param channelIndex the channel of the DS transmission
+   * \param dataRateIndex the data rate of the DS transmission
+   * \param start the start of the DS transmission
+   * \param airTime the duration of the DS transmission, zero to ignore the TX plans
+   * \return the gateway, or 0 if no gateway can send the DS transmission
+   */
+  Ptr<LoRaWANGatewayApplication> SelectDSGateway (uint32_t deviceIndex, uint8_t channelIndex, uint8_t dataRateIndex,
+                                                  Time start = Time (), Time airTime = Time ()) const;
+
+  /**
+   * Get the airtime of the DS packet that SendDSPacket would send to an end
+   * device.
+   *
+   * \param deviceIndex the end device
+   * \param dataRateIndex the data rate of the DS transmission
+   * \return the airtime, or zero if there is nothing to send
+   */
+  Time GetDSAirtime (uint32_t deviceIndex, uint8_t dataRateIndex);
+
+  /**
+   * Get the pending MAC commands of an end device that fit in the frame
+   * options of a DS packet: the LinkADRReq of ADR followed by the queued MAC
+   * commands in order.
+   *
+   * \param deviceIndex the end device
+   * \param maxLength the room for MAC commands in bytes
+   * \param buffer the MAC commands are written here, if not null
+   * \param linkAdrReq set to whether the LinkADRReq is included
+   * \param nCommands set to the number of MAC commands
+   * \return the length of the MAC commands in bytes
+   */
+  uint8_t GetMacCommands (uint32_t deviceIndex, uint8_t maxLength, uint8_t *buffer, bool &linkAdrReq, uint32_t &nCommands) const;
+
+  /**
+   * Process the answers to MAC commands in the frame options of a US packet.
+   *
+   * \param deviceIndex the end device
+   * \param answers the frame options
+   * \param length the length of the frame options
+   */
+  void ProcessMacAnswers (uint32_t deviceIndex, const uint8_t *answers, uint8_t length);
+
+  /**
+   * Run the adaptive data rate algorithm (see LoRaWANAdr) for an end device
+   * that set the ADR bit, once the SNRs of AdrHistoryLength US packets are
+   * known. When the data rate or TX power of the end device should change, a
+   * LinkADRReq is sent in the next DS packet. The TX power of the request is
+   * only assumed once the end device acks it in a LinkADRAns, which also
+   * clears the SNR history. When the next US packet has no LinkADRAns, the
+   * LinkADRReq is sent again.
+   *
+   * \param deviceIndex the end device
+   */
+  void UpdateAdr (uint32_t deviceIndex);
 
   int64_t AssignStreams (int64_t stream);
 private:
+  /**
+   * Add a gateway to the gateways that received the last US transmission of
+   * an end device. US packets that are received more than a second after the
+   * last US packet of the end device start a new US transmission.
+   *
+   * \param deviceIndex the end device
+   * \param gateway the gateway that received the US packet
+   * \param packet the US packet, of which the LoRaWANRxMetadataTag is removed
+   * \return whether the US packet starts a new US transmission
+   */
+  bool AddRxGateway (uint32_t deviceIndex, Ptr<LoRaWANGatewayApplication> gateway, Ptr<Packet> packet);
+
+  /**
+   * Handle a US data packet of which the MIC was verified and the FRMPayload
+   * decrypted, or a packet of an end device that is not served by this
+   * network server.
+   */
+  void ProcessUSPacket (Ptr<LoRaWANGatewayApplication> lastGW, Address from, Ptr<Packet> packet);
+
+  /**
+   * Verify the MICs of the queued US packets, computing the MICs of several
+   * packets at once (see LoRaWANCrypto::ComputeFrameMics), and decrypt their
+   * FRMPayloads. Packets with an invalid MIC are dropped, the others are
+   * processed by ProcessUSPacket in the order in which they were received.
+   */
+  void VerifyUSBatch (void);
+
+  /**
+   * Handle a JoinRequest of an end device. A device address is allocated on
+   * the first JoinRequest of the end device, and a JoinAccept is sent in the
+   * RWs of every JoinRequest with a DevNonce that was not used before.
+   *
+   * \param gateway the gateway that received the JoinRequest
+   * \param packet the JoinRequest, starting with its LoRaWANJoinRequestHeader
+   */
+  void HandleJoinRequest (Ptr<LoRaWANGatewayApplication> gateway, Ptr<Packet> packet);
+
+  /**
+   * \param devEui the DevEUI of an end device
+   * \return the AppKey set with SetAppKey, or the default AppKey of the DevEUI
+   */
+  LoRaWANKey GetAppKey (uint64_t devEui) const;
+
+  /**
+   * \param deviceIndex the end device
+   * \return the delay of RW2 after the last US transmission of the end device
+   */
+  Time GetReceiveDelay2 (uint32_t deviceIndex) const;
+
+  /**
+   * \param deviceIndex the end device
+   * \return whether there is a DS packet or a MAC command that can be sent
+   * to the end device in between uplinks, should it be a Class C end device
+   */
+  bool HaveClassCDSPacket (uint32_t deviceIndex);
+
+  /**
+   * Schedule the Class C timer of an end device, unless it is already
+   * scheduled or there is nothing to send.
+   *
+   * \param deviceIndex the end device
+   * \param delay the delay of the timer
+   */
+  void ScheduleClassCTimer (uint32_t deviceIndex, Time delay);
+
+  /**
+   * Make room for a new DS packet in the DS queue of an end device, see the
+   * MaxDSQueueSize and DSQueueDropPolicy attributes.
+   *
+   * \param deviceIndex the end device
+   * \return false if the new DS packet should be dropped
+   */
+  bool MakeRoomInDSQueue (uint32_t deviceIndex);
+
+  /**
+   * Append a DS data packet to the DS queue of an end device.
+   *
+   * \param deviceIndex the end device
+   * \param packet the FRMPayload
+   * \param framePort the frame port
+   * \param confirmed whether the DS packet is confirmed
+   */
+  void PushDSPacket (uint32_t deviceIndex, Ptr<Packet> packet, uint8_t framePort, bool confirmed);
+
   static Ptr<LoRaWANNetworkServer> m_ptr;
-  std::unordered_map <uint32_t, LoRaWANEndDeviceInfoNS> m_endDevices;
+  LoRaWANEndDeviceTableNS m_endDevices;
+  LoRaWANNSDSQueuePool m_downstreamQueuePool;
+  LoRaWANTimerWheel m_timerWheel; //!< RW1, RW2 and DS timers of all end devices
+  std::vector<Ipv4Address> m_homeDeviceAddrs; //!< Registered end devices, empty if all end devices are served
+  std::vector<Ptr<LoRaWANNetworkServer> > m_roamingPartners;
+  std::unordered_map<uint64_t, uint32_t> m_joinedEndDevices; //!< device index by DevEUI, for end devices that sent a JoinRequest
+  std::unordered_map<uint64_t, LoRaWANKey> m_appKeys; //!< AppKey by DevEUI, see SetAppKey
+  bool m_crypto; //!< Verify MICs and encrypt FRMPayloads
+  uint32_t m_cryptoBatchSize; //!< Maximum number of US packets of which the MICs are verified at once
+  std::vector<LoRaWANNSUSPacket> m_usBatch; //!< US packets waiting for VerifyUSBatch
+  std::vector<LoRaWANNSUSPacket> m_usBatchProcessing; //!< The US packets that VerifyUSBatch processes
+  std::vector<uint8_t> m_usBatchFrames; //!< The MHDR and MACPayload of the packets that VerifyUSBatch processes
+  std::vector<LoRaWANMicJob> m_usBatchJobs;
+  EventId m_usBatchEvent;
+  uint32_t m_joinAddressBase;
+  uint32_t m_nextJoinAddress; //!< Next device address to allocate to an end device that joins
+  uint32_t m_appNonce; //!< AppNonce of the next JoinAccept
   uint16_t m_pktSize;
   bool m_generateDataDown;
   bool m_confirmedData;
   bool m_endDevicesPopulated;
+  bool m_selectBestGateway;
+  bool m_planDownlinks;
+  uint32_t m_maxDSQueueSize; //!< maximum number of DS packets queued per end device, zero means unlimited
+  LoRaWANQueueDropPolicy m_dsQueueDropPolicy;
+  uint32_t m_adrHistoryLength;
+  double m_adrInstallationMargin;
+  Time m_classCRetryInterval; //!< Delay before a Class C DS packet is retried when no gateway was available
   Ptr<RandomVariableStream> m_downstreamIATRandomVariable;
   TracedValue<uint32_t> m_nrRW1Sent; // number of times that a DS packet was sent in RW1 by this NS
   TracedValue<uint32_t> m_nrRW2Sent; // number of times that a DS packet was sent in RW2 by this NS
   TracedValue<uint32_t> m_nrRW1Missed; // number of times that RW1 was missed for all end devices served by this NS
   TracedValue<uint32_t> m_nrRW2Missed; // number of times that RW2 was missed for all end devices served by this NS
+  TracedValue<uint32_t> m_nrClassCSent; // number of times that a DS packet was sent to a Class C end device in between uplinks by this NS
+  TracedValue<uint32_t> m_nrRW1Deferred; // number of times that a DS packet was planned in RW2 instead of RW1 by this NS
+  TracedValue<uint32_t> m_nrAdrRequestsSent; // number of LinkADRReq commands sent by this NS
+  TracedValue<uint32_t> m_nrUSForwarded; // number of US packets forwarded to a roaming partner by this NS
+  TracedValue<uint32_t> m_nrUSDropped; // number of US packets of unknown end devices dropped by this NS
+  TracedValue<uint32_t> m_nrUSMicFailures; // number of US packets with an invalid MIC dropped by this NS
+  TracedValue<uint32_t> m_nrJoinRequestsReceived; // number of JoinRequests with a new DevNonce received by this NS
+  TracedValue<uint32_t> m_nrJoinRequestsRejected; // number of JoinRequests with a replayed DevNonce received by this NS
+  TracedValue<uint32_t> m_nrJoinAcceptsSent; // number of JoinAccepts sent by this NS
+  TracedValue<uint32_t> m_dsQueueSize; // number of DS packets queued for all end devices of this NS
+  TracedValue<uint32_t> m_nrDSQueueDrops; // number of DS packets dropped by this NS because the DS queue of the end device was full
+  TracedValue<uint32_t> m_nrMacCommandsSent; // number of MAC commands sent by this NS, including LinkADRReqs
+  TracedValue<uint32_t> m_nrMacCommandsPiggybacked; // number of MAC commands sent by this NS in a DS packet with data or an ack
 
   TracedCallback<uint32_t, uint8_t, uint8_t, Ptr<const Packet> > m_dsMsgGeneratedTrace;
   TracedCallback<uint32_t, uint8_t, uint8_t, Ptr<const Packet>, uint8_t > m_dsMsgTransmittedTrace;
   TracedCallback<uint32_t, uint8_t, uint8_t, Ptr<const Packet> > m_dsMsgAckdTrace;
   TracedCallback<uint32_t, uint8_t, uint8_t, Ptr<const Packet> > m_dsMsgDroppedTrace;
   TracedCallback<uint32_t, uint8_t, Ptr<const Packet>> m_usMsgReceivedTrace;
+  TracedCallback<uint32_t, uint8_t, int8_t> m_devStatusTrace;
 };
 
 class LoRaWANGatewayApplication : public Application
@@ -209,8 +773,46 @@ public:
    */
   void HandleRead (Ptr<Socket> socket);
 
+  /**
+   * \param networkServer the network server to which received US packets are passed
+   */
+  void SetNetworkServer (Ptr<LoRaWANNetworkServer> networkServer);
+  Ptr<LoRaWANNetworkServer> GetNetworkServer (void) const;
+
   bool CanSendImmediatelyOnChannel (uint8_t channelIndex, uint8_t dataRateIndex);
   void SendDSPacket (Ptr<Packet> p);
+
+  /**
+   * Check whether a DS transmission fits in the TX plan of this gateway and
+   * whether the duty cycle of its sub band, as tracked by the RDC of the
+   * gateway, allows it. Reservations that ended are removed from the plan
+   * first.
+   *
+   * \param start the start of the transmission, not in the past
+   * \param channelIndex the channel of the transmission
+   * \param airTime the duration of the transmission
+   * \return whether the transmission can be reserved
+   */
+  bool CanReserveTx (Time start, uint8_t channelIndex, Time airTime);
+  void ReserveTx (Time start, uint8_t channelIndex, Time airTime);
+  void ReleaseTx (Time start);
+
+  /**
+   * \param channelIndex the channel of a transmission
+   * \param airTime the duration of the transmission
+   * \return the time for which the sub band of the channel is off after the
+   * transmission, Time::Max () if the gateway has no RDC
+   */
+  Time GetTimeOff (uint8_t channelIndex, Time airTime);
+
+  /**
+   * \param channelIndex the channel of a transmission
+   * \return the time at which the duty cycle of the sub band of the channel
+   * allows this gateway to transmit again, which may be in the past,
+   * Time::Max () if the gateway has no RDC
+   */
+  Time GetSubBandAvailableTime (uint8_t channelIndex);
+  const LoRaWANGatewayTxPlan &GetTxPlan (void) const;
 protected:
   virtual void DoInitialize (void);
   virtual void DoDispose (void);
@@ -242,7 +844,8 @@ private:
   /// Traced Callback: transmitted packets.
   TracedCallback<Ptr<const Packet> > m_txTrace;
 
-  Ptr<LoRaWANNetworkServer> m_lorawanNSPtr; //!< Pointer to LoRaWANNetworkServer singleton
+  Ptr<LoRaWANNetworkServer> m_lorawanNSPtr; //!< The network server of this gateway
+  LoRaWANGatewayTxPlan m_txPlan; //!< Planned DS transmissions, shared by all network servers using this gateway
 
 private:
   /**
@@ -0,0 +1,486 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include "lorawan-gateway-phy.h"
+#include "lorawan-phy.h"
+#include "lorawan-spectrum-signal-parameters.h"
+#include "lorawan-spectrum-value-helper.h"
+#include "lorawan-interference-helper.h"
+#include "lorawan-error-model.h"
+#include <ns3/log.h>
+#include <ns3/uinteger.h>
+#include <ns3/boolean.h>
+#include <ns3/double.h>
+#include <ns3/simulator.h>
+#include <ns3/spectrum-value.h>
+
+#include <cmath>
+#include <limits>
+#include <ns3/mobility-model.h>
+#include <ns3/spectrum-channel.h>
+#include <ns3/net-device.h>
+#include <ns3/spectrum-model.h>
+#include <ns3/antenna-model.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANGatewayPhy");
+
+NS_OBJECT_ENSURE_REGISTERED (LoRaWANGatewayPhy);
+
+TypeId
+LoRaWANGatewayPhy::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoRaWANGatewayPhy")
+    .SetParent<SpectrumPhy> ()
+    .SetGroupName ("LoRaWAN")
+    .AddConstructor<LoRaWANGatewayPhy> ()
+    .AddAttribute ("DemodulatorPaths",
+                   "The number of packets that the gateway can demodulate in parallel",
+                   UintegerValue (8), // SX1301
+                   MakeUintegerAccessor (&LoRaWANGatewayPhy::m_nDemodulators),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("CaptureModel",
+                   "Receive LoRa signals with the capture model of the gateway "
+                   "PHY instead of dispatching them to the PHYs of the gateway",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&LoRaWANGatewayPhy::m_captureModel),
+                   MakeBooleanChecker ())
+    .AddAttribute ("CaptureThreshold",
+                   "The minimum SIR in dB for receiving a signal in the presence "
+                   "of signals with the same spreading factor (capture model)",
+                   DoubleValue (6.0),
+                   MakeDoubleAccessor (&LoRaWANGatewayPhy::SetCaptureThreshold,
+                                       &LoRaWANGatewayPhy::GetCaptureThreshold),
+                   MakeDoubleChecker<double> ())
+    .AddTraceSource ("BusyDemodulators",
+                     "The number of demodulator paths locked onto a packet",
+                     MakeTraceSourceAccessor (&LoRaWANGatewayPhy::m_nBusyDemodulators),
+                     "ns3::TracedValueCallback::Uint32")
+  ;
+  return tid;
+}
+
+LoRaWANGatewayPhy::LoRaWANGatewayPhy (void)
+  : m_nDemodulators (8),
+    m_nBusyDemodulators (0),
+    m_captureModel (false)
+{
+  NS_LOG_FUNCTION (this);
+
+  // Inter-SF rejection in dB (desired SF x interfering SF, SF7 to SF12), see
+  // Goursaud and Gorce, "Dedicated networks for IoT: PHY / MAC state of the
+  // art and challenges", EAI endorsed transactions on Internet of Things, 2015
+  static const double sirThresholdDb[N_SF][N_SF] = {
+    {  6, -16, -18, -19, -19, -20},
+    {-24,   6, -20, -22, -22, -22},
+    {-27, -27,   6, -23, -25, -25},
+    {-30, -30, -30,   6, -26, -28},
+    {-33, -33, -33, -33,   6, -29},
+    {-36, -36, -36, -36, -36,   6}
+  };
+  for (uint8_t i = 0; i < N_SF; i++)
+    for (uint8_t j = 0; j < N_SF; j++)
+      m_sirThreshold[i][j] = pow (10.0, sirThresholdDb[i][j] / 10.0);
+
+  LoRaWANSpectrumValueHelper psdHelper;
+  Ptr<SpectrumValue> noise = psdHelper.CreateNoisePowerSpectralDensity ();
+  m_interference = Create<LoRaWANInterferenceHelper> (noise->GetSpectrumModel ());
+  for (uint8_t i = 0; i < LoRaWAN::m_supportedChannels.size (); i++)
+    m_noise.push_back ((*noise)[i]);
+  m_receptions.resize (LoRaWAN::m_supportedChannels.size ());
+  m_errorModel = CreateObject<LoRaWANErrorModel> ();
+}
+
+LoRaWANGatewayPhy::~LoRaWANGatewayPhy (void)
+{
+}
+
+void
+LoRaWANGatewayPhy::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_phys.clear ();
+  m_phyRequestCallback = MakeNullCallback< Ptr<LoRaWANPhy>, uint8_t, uint8_t > ();
+  m_device = 0;
+  m_mobility = 0;
+  m_channel = 0;
+  m_receptions.clear ();
+  m_interference = 0;
+  m_errorModel = 0;
+  SpectrumPhy::DoDispose ();
+}
+
+void
+LoRaWANGatewayPhy::AddPhy (Ptr<LoRaWANPhy> phy)
+{
+  NS_LOG_FUNCTION (this << phy);
+  NS_ASSERT (phy);
+  phy->SetDemodulatorCallbacks (MakeCallback (&LoRaWANGatewayPhy::RequestDemodulator, this),
+                                MakeCallback (&LoRaWANGatewayPhy::ReleaseDemodulator, this));
+  m_phys.push_back (phy);
+}
+
+void
+LoRaWANGatewayPhy::SetPhyRequestCallback (GatewayPhyRequestCallback c)
+{
+  NS_LOG_FUNCTION (this);
+  m_phyRequestCallback = c;
+}
+
+uint32_t
+LoRaWANGatewayPhy::GetNPhys (void) const
+{
+  return m_phys.size ();
+}
+
+uint32_t
+LoRaWANGatewayPhy::GetBusyDemodulators (void) const
+{
+  return m_nBusyDemodulators;
+}
+
+bool
+LoRaWANGatewayPhy::RequestDemodulator (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_nBusyDemodulators >= m_nDemodulators)
+    {
+      NS_LOG_DEBUG (this << " all " << m_nDemodulators << " demodulator paths are busy");
+      return false;
+    }
+  m_nBusyDemodulators++;
+  return true;
+}
+
+void
+LoRaWANGatewayPhy::ReleaseDemodulator (void)
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT (m_nBusyDemodulators.Get () > 0);
+  m_nBusyDemodulators--;
+}
+
+uint8_t
+LoRaWANGatewayPhy::GetSfIndex (LoRaSpreadingFactor sf)
+{
+  NS_ASSERT (sf >= LORAWAN_SF7 && sf <= LORAWAN_SF12);
+  return sf - LORAWAN_SF7;
+}
+
+void
+LoRaWANGatewayPhy::SetSirThreshold (LoRaSpreadingFactor sf, LoRaSpreadingFactor interfererSf, double thresholdDb)
+{
+  NS_LOG_FUNCTION (this << sf << interfererSf << thresholdDb);
+  m_sirThreshold[GetSfIndex (sf)][GetSfIndex (interfererSf)] = pow (10.0, thresholdDb / 10.0);
+}
+
+double
+LoRaWANGatewayPhy::GetSirThreshold (LoRaSpreadingFactor sf, LoRaSpreadingFactor interfererSf) const
+{
+  return 10.0 * log10 (m_sirThreshold[GetSfIndex (sf)][GetSfIndex (interfererSf)]);
+}
+
+void
+LoRaWANGatewayPhy::SetCaptureThreshold (double thresholdDb)
+{
+  NS_LOG_FUNCTION (this << thresholdDb);
+  for (uint8_t i = 0; i < N_SF; i++)
+    m_sirThreshold[i][i] = pow (10.0, thresholdDb / 10.0);
+}
+
+double
+LoRaWANGatewayPhy::GetCaptureThreshold (void) const
+{
+  return 10.0 * log10 (m_sirThreshold[0][0]);
+}
+
+uint32_t
+LoRaWANGatewayPhy::GetNCapturedReceptions (void) const
+{
+  uint32_t n = 0;
+  for (std::vector<std::vector<CapturedReception> >::const_iterator it = m_receptions.begin (); it != m_receptions.end (); ++it)
+    n += it->size ();
+  return n;
+}
+
+uint32_t
+LoRaWANGatewayPhy::GetNSignals (void) const
+{
+  return m_interference->GetNSignals ();
+}
+
+void
+LoRaWANGatewayPhy::SetDevice (Ptr<NetDevice> d)
+{
+  NS_LOG_FUNCTION (this << d);
+  m_device = d;
+}
+
+Ptr<NetDevice>
+LoRaWANGatewayPhy::GetDevice (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return m_device;
+}
+
+void
+LoRaWANGatewayPhy::SetMobility (Ptr<MobilityModel> m)
+{
+  NS_LOG_FUNCTION (this << m);
+  m_mobility = m;
+}
+
+Ptr<MobilityModel>
+LoRaWANGatewayPhy::GetMobility (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_mobility == 0 && !m_phys.empty ())
+    {
+      return m_phys.front ()->GetMobility ();
+    }
+  return m_mobility;
+}
+
+void
+LoRaWANGatewayPhy::SetChannel (Ptr<SpectrumChannel> c)
+{
+  NS_LOG_FUNCTION (this << c);
+  m_channel = c;
+}
+
+Ptr<const SpectrumModel>
+LoRaWANGatewayPhy::GetRxSpectrumModel (void) const
+{
+  NS_LOG_FUNCTION (this);
+  if (m_phys.empty ())
+    {
+      return 0;
+    }
+  return m_phys.front ()->GetRxSpectrumModel ();
+}
+
+Ptr<AntennaModel>
+LoRaWANGatewayPhy::GetRxAntenna (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_phys.empty ())
+    {
+      return 0;
+    }
+  return m_phys.front ()->GetRxAntenna ();
+}
+
+void
+LoRaWANGatewayPhy::StartRx (Ptr<SpectrumSignalParameters> params)
+{
+  NS_LOG_FUNCTION (this << params);
+
+  Ptr<LoRaWANSpectrumSignalParameters> loraWanRxParams = DynamicCast<LoRaWANSpectrumSignalParameters> (params);
+  if (loraWanRxParams)
+    {
+      // The receptions and the noise are sized for the region in effect when
+      // the gateway PHY was created
+      NS_ASSERT_MSG (loraWanRxParams->channelIndex < m_receptions.size (),
+                     "Channel index " << static_cast<uint16_t> (loraWanRxParams->channelIndex) << " is outside the region that the gateway PHY was created for");
+      // The bands of the LoRaWAN SpectrumModel coincide with the channels
+      StartLoRaWANRx (loraWanRxParams, (*params->psd)[loraWanRxParams->channelIndex]);
+      return;
+    }
+
+  if (m_captureModel)
+    return;
+
+  // Non-LoRaWAN signals are passed to all PHYs
+  for (std::vector<Ptr<LoRaWANPhy> >::iterator it = m_phys.begin (); it != m_phys.end (); ++it)
+    {
+      // The channel does not deliver a signal to the PHY that sent it
+      if (PeekPointer (*it) == PeekPointer (params->txPhy))
+        continue;
+
+      (*it)->StartRx (params);
+    }
+}
+
+void
+LoRaWANGatewayPhy::StartLoRaWANRx (Ptr<LoRaWANSpectrumSignalParameters> params, double rxPsd)
+{
+  NS_LOG_FUNCTION (this << params << rxPsd);
+
+  if (m_captureModel)
+    {
+      StartCapturedRx (params, rxPsd);
+      return;
+    }
+
+  // Have the gateway build the PHY of the signal when it does not exist yet
+  if (!m_phyRequestCallback.IsNull ())
+    m_phyRequestCallback (params->channelIndex, params->dataRateIndex);
+
+  for (std::vector<Ptr<LoRaWANPhy> >::iterator it = m_phys.begin (); it != m_phys.end (); ++it)
+    {
+      // The channel does not deliver a signal to the PHY that sent it
+      if (PeekPointer (*it) == PeekPointer (params->txPhy))
+        continue;
+
+      // Only PHYs tuned to the channel of the transmission need to see it,
+      // other PHYs would ignore it anyway.
+      if (params->channelIndex != (*it)->GetCurrentChannelIndex ())
+        continue;
+
+      (*it)->StartLoRaWANRx (params, rxPsd);
+    }
+}
+
+double
+LoRaWANGatewayPhy::GetSirMargin (uint8_t channelIndex, double power, LoRaSpreadingFactor sf, LoRaSpreadingFactor interfererSf) const
+{
+  double interference = m_interference->GetSignalPsd (channelIndex, interfererSf);
+  if (interfererSf == sf)
+    interference -= power; // the signal itself is part of the co-SF interference
+
+  if (interference <= 0.0)
+    return std::numeric_limits<double>::infinity ();
+
+  return power / (interference * m_sirThreshold[GetSfIndex (sf)][GetSfIndex (interfererSf)]);
+}
+
+void
+LoRaWANGatewayPhy::StartCapturedRx (Ptr<LoRaWANSpectrumSignalParameters> params, double power)
+{
+  NS_LOG_FUNCTION (this << params << power);
+
+  // The gateway can not receive its own transmissions
+  if (m_device && params->txPhy->GetDevice () == m_device)
+    return;
+
+  const uint8_t channelIndex = params->channelIndex;
+  const LoRaSpreadingFactor sf = LoRaWAN::m_supportedDataRates [params->dataRateIndex].spreadingFactor;
+
+  m_interference->AddSignal (PeekPointer (params), channelIndex, power, sf);
+  Simulator::Schedule (params->duration, &LoRaWANGatewayPhy::EndCapturedRx, this, params);
+
+  // The new signal only increases the interference of the receptions on its
+  // channel, and only for its spreading factor
+  std::vector<CapturedReception> &receptions = m_receptions[channelIndex];
+  for (std::vector<CapturedReception>::iterator it = receptions.begin (); it != receptions.end (); ++it)
+    it->minMargin = std::min (it->minMargin, GetSirMargin (channelIndex, it->power, it->sf, sf));
+
+  // Find the PHY of the channel and data rate of the signal, PHYs are added
+  // in the order of their index in the gateway net device
+  Ptr<LoRaWANPhy> phy;
+  const int16_t phyIndex = LoRaWAN::GetGatewayPhyIndex (channelIndex, params->dataRateIndex);
+  if (!m_phyRequestCallback.IsNull ())
+    {
+      phy = m_phyRequestCallback (channelIndex, params->dataRateIndex);
+    }
+  else if (phyIndex >= 0 && static_cast<uint32_t> (phyIndex) < m_phys.size () && m_phys[phyIndex]->GetCurrentChannelIndex () == channelIndex
+      && m_phys[phyIndex]->GetCurrentDataRateIndex () == params->dataRateIndex)
+    {
+      phy = m_phys[phyIndex];
+    }
+  else
+    {
+      for (std::vector<Ptr<LoRaWANPhy> >::iterator it = m_phys.begin (); it != m_phys.end (); ++it)
+        {
+          if ((*it)->GetCurrentChannelIndex () == channelIndex && (*it)->GetCurrentDataRateIndex () == params->dataRateIndex)
+            {
+              phy = *it;
+              break;
+            }
+        }
+    }
+  if (phy == 0)
+    {
+      NS_LOG_LOGIC (this << " no PHY for channel " << static_cast<uint16_t> (channelIndex) << " and data rate " << static_cast<uint16_t> (params->dataRateIndex));
+      return;
+    }
+
+  if (!phy->StartCapturedRx (params))
+    return;
+
+  // Check whether the receiver can lock onto the signal
+  const uint32_t bw = LoRaWAN::m_supportedChannels [channelIndex].m_bw;
+  const double snr_db = 10.0 * log10 (power / m_noise[channelIndex]);
+  double margin = std::numeric_limits<double>::infinity ();
+  for (uint8_t i = 0; i < N_SF; i++)
+    margin = std::min (margin, GetSirMargin (channelIndex, power, sf, static_cast<LoRaSpreadingFactor> (LORAWAN_SF7 + i)));
+
+  if (snr_db <= m_errorModel->getSNRCutoffForRX (bw, sf, params->codeRate) || margin < 1.0)
+    {
+      phy->DropCapturedRx (params->packet, LORAWAN_RX_DROP_SINR_TOO_LOW);
+      return;
+    }
+
+  CapturedReception reception;
+  reception.params = params;
+  reception.phy = phy;
+  reception.power = power;
+  reception.sf = sf;
+  reception.preambleEnd = Simulator::Now () + phy->CalculatePreambleTime ();
+  reception.minMargin = margin;
+
+  // A co-SF reception that is still in its preamble is captured by the new
+  // signal, as the new signal is strong enough to be received despite of it
+  for (std::vector<CapturedReception>::iterator it = receptions.begin (); it != receptions.end (); ++it)
+    {
+      if (it->sf == sf && Simulator::Now () < it->preambleEnd)
+        {
+          NS_LOG_DEBUG (this << " reception of " << it->params << " captured by " << params);
+          it->phy->DropCapturedRx (it->params->packet, LORAWAN_RX_DROP_CAPTURED);
+          *it = reception; // take over the demodulator of the captured reception
+          return;
+        }
+    }
+
+  if (!RequestDemodulator ())
+    {
+      phy->DropCapturedRx (params->packet, LORAWAN_RX_DROP_NO_DEMODULATOR);
+      return;
+    }
+  receptions.push_back (reception);
+}
+
+void
+LoRaWANGatewayPhy::EndCapturedRx (Ptr<LoRaWANSpectrumSignalParameters> params)
+{
+  NS_LOG_FUNCTION (this << params);
+
+  // Removing a signal does not affect the minimum margin of any reception
+  m_interference->RemoveSignal (PeekPointer (params));
+
+  std::vector<CapturedReception> &receptions = m_receptions[params->channelIndex];
+  for (std::vector<CapturedReception>::iterator it = receptions.begin (); it != receptions.end (); ++it)
+    {
+      if (it->params == params)
+        {
+          Ptr<LoRaWANPhy> phy = it->phy;
+          const double power = it->power;
+          bool destroyed = it->minMargin < 1.0;
+          *it = receptions.back ();
+          receptions.pop_back ();
+          ReleaseDemodulator ();
+
+          phy->EndCapturedRx (params, power, destroyed);
+          return;
+        }
+    }
+}
+
+} // namespace ns3
@@ -0,0 +1,339 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#ifndef LORAWAN_GATEWAY_PHY_H
+#define LORAWAN_GATEWAY_PHY_H
+
+#include "lorawan.h"
+#include <ns3/spectrum-phy.h>
+#include <ns3/traced-value.h>
+#include <ns3/callback.h>
+#include <ns3/nstime.h>
+#include <vector>
+
+namespace ns3 {
+
+class LoRaWANPhy;
+class LoRaWANErrorModel;
+class LoRaWANInterferenceHelper;
+struct LoRaWANSpectrumSignalParameters;
+class MobilityModel;
+class SpectrumChannel;
+class SpectrumModel;
+class AntennaModel;
+class NetDevice;
+
+/**
+ * \ingroup lorawan
+ *
+ * Get the PHY of a gateway that receives on a channel and data rate, the
+ * gateway may build it (and add it to the LoRaWANGatewayPhy) on demand.
+ *
+ * @return the PHY, or 0 when the gateway does not receive on the channel and
+ * data rate
+ */
+typedef Callback< Ptr<LoRaWANPhy>, uint8_t, uint8_t > GatewayPhyRequestCallback;
+
+/**
+ * \ingroup lorawan
+ *
+ * Shared receiver front-end for a LoRaWAN gateway, modelled after the SX1301
+ * baseband chip.
+ *
+ * A gateway holds one LoRaWANPhy per (channel, data rate) pair. Instead of
+ * attaching every one of these PHYs to the SpectrumChannel, only the
+ * LoRaWANGatewayPhy is attached. Incoming signals are dispatched to the PHYs
+ * that are tuned to the channel of the signal, so that a transmission costs
+ * one channel delivery per gateway instead of one per PHY. When a
+ * GatewayPhyRequestCallback is set, the PHYs are requested from the gateway
+ * as signals arrive, so the gateway only needs to build the PHYs of the
+ * channels that are in use.
+ *
+ * The gateway PHY also owns a bounded pool of demodulator paths: a PHY can
+ * only lock onto a preamble when a demodulator is available, otherwise the
+ * packet is dropped with LORAWAN_RX_DROP_NO_DEMODULATOR.
+ *
+ * When the CaptureModel attribute is set, the gateway PHY receives LoRa
+ * signals itself instead of dispatching them to the PHYs. It keeps the
+ * interference of all signals per channel and spreading factor, and tracks
+ * any number of overlapping receptions:
+ *
+ * - A signal is locked onto when a demodulator is available, its SNR is above
+ *   the cut-off of the error model and its SIR towards the signals of every
+ *   spreading factor is above the threshold of that spreading factor.
+ * - The SIR thresholds form a matrix (desired SF x interfering SF) of
+ *   inter-SF rejection values. The co-SF threshold on the diagonal is the
+ *   CaptureThreshold attribute.
+ * - A co-SF signal that arrives during the preamble of a locked reception
+ *   and is strong enough to capture the receiver, takes over its demodulator.
+ *   The first reception is dropped with LORAWAN_RX_DROP_CAPTURED. After the
+ *   preamble, the demodulator stays locked and the new signal only adds
+ *   interference.
+ * - Every reception keeps the minimum SIR margin over its duration. As the
+ *   interference only increases when a signal starts, only the receptions on
+ *   the channel of the new signal are updated, and only for the spreading
+ *   factor of the new signal. A reception is successful when its margin never
+ *   dropped below the thresholds.
+ *
+ * Successful receptions are pushed up the stack by the PHY of the channel and
+ * data rate of the packet (see LoRaWANPhy::StartCapturedRx). Non-LoRa
+ * signals are not considered by the capture model.
+ */
+class LoRaWANGatewayPhy : public SpectrumPhy
+{
+public:
+  /**
+   * Get the type ID.
+   *
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  LoRaWANGatewayPhy (void);
+  virtual ~LoRaWANGatewayPhy (void);
+
+  /**
+   * Add a PHY to the set of PHYs served by this front-end. Without a
+   * GatewayPhyRequestCallback, PHYs are expected to be added in the order of
+   * their index in the gateway net device (see LoRaWAN::GetGatewayPhyIndex).
+   *
+   * \param phy the PHY to add
+   */
+  void AddPhy (Ptr<LoRaWANPhy> phy);
+
+  /**
+   * Set the callback that is used to get the PHY of the channel and data
+   * rate of an incoming signal.
+   *
+   * \param c the callback
+   */
+  void SetPhyRequestCallback (GatewayPhyRequestCallback c);
+
+  /**
+   * \return the number of PHYs served by this front-end
+   */
+  uint32_t GetNPhys (void) const;
+
+  /**
+   * \return the number of demodulator paths that are currently locked onto a
+   * packet
+   */
+  uint32_t GetBusyDemodulators (void) const;
+
+  /**
+   * Try to reserve a demodulator path for a reception.
+   *
+   * \return true if a demodulator was available and is now reserved
+   */
+  bool RequestDemodulator (void);
+
+  /**
+   * Release a demodulator path that was reserved with RequestDemodulator.
+   */
+  void ReleaseDemodulator (void);
+
+  /**
+   * Set the SIR threshold of the capture model for a desired signal with
+   * spreading factor sf and interfering signals with spreading factor
+   * interfererSf. The co-SF thresholds (sf == interfererSf) are set by the
+   * CaptureThreshold attribute.
+   *
+   * \param sf the spreading factor of the desired signal
+   * \param interfererSf the spreading factor of the interfering signals
+   * \param thresholdDb the minimum SIR in dB
+   */
+  void SetSirThreshold (LoRaSpreadingFactor sf, LoRaSpreadingFactor interfererSf, double thresholdDb);
+
+  /**
+   * \param sf the spreading factor of the desired signal
+   * \param interfererSf the spreading factor of the interfering signals
+   * \return the SIR threshold in dB
+   */
+  double GetSirThreshold (LoRaSpreadingFactor sf, LoRaSpreadingFactor interfererSf) const;
+
+  /**
+   * \return the number of ongoing receptions of the capture model
+   */
+  uint32_t GetNCapturedReceptions (void) const;
+
+  /**
+   * \return the number of signals that the capture model accounts for as
+   * interference, including the received signals
+   */
+  uint32_t GetNSignals (void) const;
+
+  // inherited from SpectrumPhy
+  void SetDevice (Ptr<NetDevice> d);
+  Ptr<NetDevice> GetDevice (void) const;
+  void SetMobility (Ptr<MobilityModel> m);
+  Ptr<MobilityModel> GetMobility (void);
+  void SetChannel (Ptr<SpectrumChannel> c);
+  Ptr<const SpectrumModel> GetRxSpectrumModel (void) const;
+  Ptr<AntennaModel> GetRxAntenna (void);
+  void StartRx (Ptr<SpectrumSignalParameters> params);
+
+  /**
+   * Notify the front-end of an incoming LoRa signal, see
+   * LoRaWANPhy::StartLoRaWANRx. The signal is passed to the PHYs that are
+   * tuned to its channel, or received with the capture model.
+   *
+   * \param params the shared signal parameters of the transmission
+   * \param rxPsd the received power spectral density in the band of the
+   * channel of the transmission
+   */
+  void StartLoRaWANRx (Ptr<LoRaWANSpectrumSignalParameters> params, double rxPsd);
+
+private:
+  // Inherited from Object.
+  virtual void DoDispose (void);
+
+  /**
+   * A reception of the capture model.
+   */
+  struct CapturedReception
+  {
+    Ptr<LoRaWANSpectrumSignalParameters> params; //!< the received signal
+    Ptr<LoRaWANPhy> phy;                         //!< the PHY that pushes the packet up the stack
+    double power;                                //!< the received power spectral density
+    LoRaSpreadingFactor sf;                      //!< the spreading factor of the signal
+    Time preambleEnd;                            //!< the time at which the preamble is received
+    double minMargin;                            //!< minimum SIR margin (linear, >= 1 is successful)
+  };
+
+  /**
+   * Receive a LoRa signal with the capture model.
+   *
+   * \param params the parameters of the signal
+   * \param power the received power spectral density of the signal
+   */
+  void StartCapturedRx (Ptr<LoRaWANSpectrumSignalParameters> params, double power);
+
+  /**
+   * Called at the end of a signal that was received with StartCapturedRx.
+   *
+   * \param params the parameters of the signal
+   */
+  void EndCapturedRx (Ptr<LoRaWANSpectrumSignalParameters> params);
+
+  /**
+   * Get the SIR margin of a signal towards the signals of a spreading factor
+   * on its channel, i.e. the SIR divided by the SIR threshold.
+   *
+   * \param channelIndex the channel of the signal
+   * \param power the received power spectral density of the signal
+   * \param sf the spreading factor of the signal
+   * \param interfererSf the spreading factor of the interfering signals
+   * \return the SIR margin (linear)
+   */
+  double GetSirMargin (uint8_t channelIndex, double power, LoRaSpreadingFactor sf, LoRaSpreadingFactor interfererSf) const;
+
+  /**
+   * \param sf a spreading factor supported by the capture model
+   * \return the index of the spreading factor in m_sirThreshold
+   */
+  static uint8_t GetSfIndex (LoRaSpreadingFactor sf);
+
+  /**
+   * \param thresholdDb the co-SF SIR threshold in dB
+   */
+  void SetCaptureThreshold (double thresholdDb);
+
+  /**
+   * \return the co-SF SIR threshold in dB
+   */
+  double GetCaptureThreshold (void) const;
+
+  /**
+   * The PHYs served by this front-end, indexed as in LoRaWANNetDevice.
+   */
+  std::vector<Ptr<LoRaWANPhy> > m_phys;
+
+  /**
+   * Get the PHY of the channel and data rate of an incoming signal.
+   */
+  GatewayPhyRequestCallback m_phyRequestCallback;
+
+  /**
+   * The configured net device.
+   */
+  Ptr<NetDevice> m_device;
+
+  /**
+   * The mobility model of the gateway. When not set, the mobility model of
+   * the first PHY is used as all PHYs share the same antenna.
+   */
+  Ptr<MobilityModel> m_mobility;
+
+  /**
+   * The channel attached to this front-end.
+   */
+  Ptr<SpectrumChannel> m_channel;
+
+  /**
+   * The number of demodulator paths (8 for an SX1301).
+   */
+  uint32_t m_nDemodulators;
+
+  /**
+   * The number of demodulator paths currently locked onto a packet.
+   */
+  TracedValue<uint32_t> m_nBusyDemodulators;
+
+  /**
+   * The number of spreading factors in the SIR threshold matrix (SF7 to SF12).
+   */
+  static const uint8_t N_SF = 6;
+
+  /**
+   * Receive LoRa signals with the capture model.
+   */
+  bool m_captureModel;
+
+  /**
+   * The SIR thresholds of the capture model (linear), indexed by the
+   * spreading factor of the desired signal and the spreading factor of the
+   * interfering signals.
+   */
+  double m_sirThreshold[N_SF][N_SF];
+
+  /**
+   * The interference of all signals received with the capture model, per
+   * channel and spreading factor.
+   */
+  Ptr<LoRaWANInterferenceHelper> m_interference;
+
+  /**
+   * The error model, used for the SNR cut-off of the capture model.
+   */
+  Ptr<LoRaWANErrorModel> m_errorModel;
+
+  /**
+   * The noise power spectral density per channel.
+   */
+  std::vector<double> m_noise;
+
+  /**
+   * The ongoing receptions of the capture model, per channel.
+   */
+  std::vector<std::vector<CapturedReception> > m_receptions;
+}; // class LoRaWANGatewayPhy
+
+} // namespace ns3
+
+#endif /* LORAWAN_GATEWAY_PHY_H */
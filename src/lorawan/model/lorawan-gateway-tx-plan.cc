@@ -0,0 +1,113 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include "lorawan-gateway-tx-plan.h"
+#include <ns3/log.h>
+#include <iterator>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANGatewayTxPlan");
+
+LoRaWANGatewayTxPlan::LoRaWANGatewayTxPlan () {}
+
+bool
+LoRaWANGatewayTxPlan::IsFeasible (Time start, Time airTime, uint8_t subBandIndex, uint16_t dutyCycleLimit) const
+{
+  const Time end = start + airTime;
+  const Time timeOffEnd = end + airTime * (dutyCycleLimit - 1);
+
+  // The transmitter is free between the end of the previous reservation and
+  // the start of the next one
+  auto next = m_reservations.lower_bound (start);
+  if (next != m_reservations.end () && next->first < end)
+    return false;
+  if (next != m_reservations.begin () && std::prev (next)->second.m_end > start)
+    return false;
+
+  if (subBandIndex >= m_subBandReservations.size ())
+    return true;
+
+  const std::map<Time, Time> &subBand = m_subBandReservations[subBandIndex];
+  auto nextOnSubBand = subBand.lower_bound (start);
+  if (nextOnSubBand != subBand.end () && nextOnSubBand->first < timeOffEnd)
+    return false;
+  if (nextOnSubBand != subBand.begin () && std::prev (nextOnSubBand)->second > start)
+    return false;
+
+  return true;
+}
+
+void
+LoRaWANGatewayTxPlan::Reserve (Time start, Time airTime, uint8_t subBandIndex, uint16_t dutyCycleLimit)
+{
+  NS_LOG_FUNCTION (this << start << airTime << (uint32_t)subBandIndex << dutyCycleLimit);
+  NS_ASSERT (IsFeasible (start, airTime, subBandIndex, dutyCycleLimit));
+
+  const Time end = start + airTime;
+  Reservation reservation = {end, subBandIndex};
+  m_reservations[start] = reservation;
+
+  if (subBandIndex >= m_subBandReservations.size ())
+    m_subBandReservations.resize (subBandIndex + 1);
+  m_subBandReservations[subBandIndex][start] = end + airTime * (dutyCycleLimit - 1);
+}
+
+bool
+LoRaWANGatewayTxPlan::Release (Time start)
+{
+  NS_LOG_FUNCTION (this << start);
+
+  auto it = m_reservations.find (start);
+  if (it == m_reservations.end ())
+    return false;
+
+  m_subBandReservations[it->second.m_subBandIndex].erase (start);
+  m_reservations.erase (it);
+  return true;
+}
+
+void
+LoRaWANGatewayTxPlan::Prune (Time now)
+{
+  // Reservations do not overlap, so they end in order of their start. The
+  // same holds for the time off of the reservations of a sub band.
+  while (!m_reservations.empty () && m_reservations.begin ()->second.m_end <= now)
+    m_reservations.erase (m_reservations.begin ());
+
+  for (auto it = m_subBandReservations.begin (); it != m_subBandReservations.end (); it++) {
+    while (!it->empty () && it->begin ()->second <= now)
+      it->erase (it->begin ());
+  }
+}
+
+uint32_t
+LoRaWANGatewayTxPlan::GetNReservations (void) const
+{
+  return m_reservations.size ();
+}
+
+void
+LoRaWANGatewayTxPlan::Clear (void)
+{
+  m_reservations.clear ();
+  m_subBandReservations.clear ();
+}
+
+} // namespace ns3
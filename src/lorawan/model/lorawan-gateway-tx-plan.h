@@ -0,0 +1,107 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#ifndef LORAWAN_GATEWAY_TX_PLAN_H
+#define LORAWAN_GATEWAY_TX_PLAN_H
+
+#include <ns3/nstime.h>
+#include <stdint.h>
+#include <map>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup lorawan
+ *
+ * The planned DS transmissions of a gateway. A gateway has a single
+ * transmitter, so the reserved TX intervals can not overlap. They are kept in
+ * an ordered map from start to end time, and a new interval only has to be
+ * compared with its neighbours in the map.
+ *
+ * The duty cycle of a sub band is enforced per transmission, as in
+ * LoRaWANMac::LoRaWANMacRDC: after a transmission of duration T on a sub band
+ * with duty cycle limit N, the sub band is off for (N - 1) * T. The
+ * reservations of every sub band are kept in a second map, from start time to
+ * the end of the time off, so that a new reservation is checked against the
+ * time off of the previous reservation on its sub band and its own time off
+ * against the next reservation on the sub band. The time off of transmissions
+ * that already happened is not known here, the caller should check it with
+ * the RDC of the gateway.
+ */
+class LoRaWANGatewayTxPlan
+{
+public:
+  LoRaWANGatewayTxPlan ();
+
+  /**
+   * \param start the start of the transmission
+   * \param airTime the duration of the transmission
+   * \param subBandIndex the sub band of the transmission
+   * \param dutyCycleLimit the duty cycle limit of the sub band, see LoRaWANSubBand
+   * \return whether the transmission fits in the plan
+   */
+  bool IsFeasible (Time start, Time airTime, uint8_t subBandIndex, uint16_t dutyCycleLimit) const;
+
+  /**
+   * Reserve a transmission, which should be feasible.
+   *
+   * \param start the start of the transmission
+   * \param airTime the duration of the transmission
+   * \param subBandIndex the sub band of the transmission
+   * \param dutyCycleLimit the duty cycle limit of the sub band
+   */
+  void Reserve (Time start, Time airTime, uint8_t subBandIndex, uint16_t dutyCycleLimit);
+
+  /**
+   * Cancel a reservation.
+   *
+   * \param start the start of the reserved transmission
+   * \return whether a reservation was found
+   */
+  bool Release (Time start);
+
+  /**
+   * Remove the reservations of transmissions that ended, and the sub band
+   * reservations of which the time off ended, before a given time.
+   *
+   * \param now the current time
+   */
+  void Prune (Time now);
+
+  /**
+   * \return the number of reserved transmissions
+   */
+  uint32_t GetNReservations (void) const;
+
+  void Clear (void);
+
+private:
+  typedef struct Reservation {
+    Time m_end;              //!< end of the transmission
+    uint8_t m_subBandIndex;
+  } Reservation;
+
+  std::map<Time, Reservation> m_reservations;            //!< reserved transmissions by start time
+  std::vector<std::map<Time, Time> > m_subBandReservations; //!< end of the time off by start time, per sub band
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_GATEWAY_TX_PLAN_H */
@@ -28,34 +28,110 @@ NS_LOG_COMPONENT_DEFINE ("LoRaWANInterferenceHelper");
 
 LoRaWANInterferenceHelper::LoRaWANInterferenceHelper (Ptr<const SpectrumModel> spectrumModel)
   : m_spectrumModel (spectrumModel),
-    m_dirty (false)
+    m_nBands (spectrumModel->GetNumBands ())
 {
-  m_signal = Create<SpectrumValue> (m_spectrumModel);
+  m_signal.assign (m_nBands, 0.0);
+  m_sfSignal.assign (N_SF_SLOTS * m_nBands, 0.0);
+  m_nSignalsInBand.assign (m_nBands, 0);
+  ResizeIndexes (16);
 }
 
 LoRaWANInterferenceHelper::~LoRaWANInterferenceHelper (void)
 {
   m_spectrumModel = 0;
-  m_signal = 0;
   m_signals.clear ();
+  m_signalIndexes.clear ();
+}
+
+uint8_t
+LoRaWANInterferenceHelper::GetSfSlot (LoRaSpreadingFactor sf)
+{
+  NS_ASSERT (sf >= LORAWAN_SF6 && sf <= LORAWAN_SF12);
+  return sf - LORAWAN_SF6;
 }
 
 bool
 LoRaWANInterferenceHelper::AddSignal (Ptr<const SpectrumValue> signal)
 {
   NS_LOG_FUNCTION (this << signal);
+  return DoAddSignal (signal, NO_SF_SLOT);
+}
+
+bool
+LoRaWANInterferenceHelper::AddSignal (Ptr<const SpectrumValue> signal, LoRaSpreadingFactor sf)
+{
+  NS_LOG_FUNCTION (this << signal << static_cast<uint16_t> (sf));
+  return DoAddSignal (signal, GetSfSlot (sf));
+}
+
+bool
+LoRaWANInterferenceHelper::DoAddSignal (Ptr<const SpectrumValue> signal, uint8_t sfSlot)
+{
+  if (signal->GetSpectrumModel () != m_spectrumModel)
+    return false;
 
-  bool result = false;
+  AccumulatedSignal accumulated;
+  accumulated.signal = signal;
+  accumulated.params = 0;
+  accumulated.band = 0;
+  accumulated.psd = 0.0;
+  accumulated.sfSlot = sfSlot;
+  if (!InsertSignal (PeekPointer (signal), accumulated))
+    return false;
 
-  if (signal->GetSpectrumModel () == m_spectrumModel)
+  for (uint32_t i = 0; i < m_nBands; i++)
+    AddToBand (i, (*signal)[i], sfSlot);
+  return true;
+}
+
+bool
+LoRaWANInterferenceHelper::AddSignal (const SpectrumSignalParameters *signal, uint32_t bandIndex, double psd, LoRaSpreadingFactor sf)
+{
+  NS_LOG_FUNCTION (this << signal << bandIndex << psd << static_cast<uint16_t> (sf));
+  NS_ASSERT (signal != 0 && bandIndex < m_nBands);
+
+  AccumulatedSignal accumulated;
+  accumulated.signal = 0;
+  accumulated.params = signal;
+  accumulated.band = bandIndex;
+  accumulated.psd = psd;
+  accumulated.sfSlot = GetSfSlot (sf);
+  if (!InsertSignal (signal, accumulated))
+    return false;
+
+  AddToBand (bandIndex, psd, accumulated.sfSlot);
+  return true;
+}
+
+void
+LoRaWANInterferenceHelper::AddToBand (uint32_t band, double psd, uint8_t sfSlot)
+{
+  if (psd != 0.0)
     {
-      result = m_signals.insert (signal).second;
-      if (result && !m_dirty)
+      m_signal[band] += psd;
+      m_sfSignal[sfSlot * m_nBands + band] += psd;
+      m_nSignalsInBand[band]++;
+    }
+}
+
+void
+LoRaWANInterferenceHelper::RemoveFromBand (uint32_t band, double psd, uint8_t sfSlot)
+{
+  if (psd != 0.0)
+    {
+      if (--m_nSignalsInBand[band] == 0)
         {
-          *m_signal += *signal;
+          // Last signal in this band: reset instead of subtracting
+          m_signal[band] = 0.0;
+          for (uint8_t slot = 0; slot < N_SF_SLOTS; slot++)
+            m_sfSignal[slot * m_nBands + band] = 0.0;
+        }
+      else
+        {
+          m_signal[band] -= psd;
+          m_sfSignal[sfSlot * m_nBands + band] -= psd;
         }
     }
-  return result;
 }
 
 bool
@@ -63,17 +139,127 @@ LoRaWANInterferenceHelper::RemoveSignal (Ptr<const SpectrumValue> signal)
 {
   NS_LOG_FUNCTION (this << signal);
 
-  bool result = false;
+  if (signal->GetSpectrumModel () != m_spectrumModel)
+    return false;
+
+  const uint32_t index = FindIndex (PeekPointer (signal));
+  if (m_signalIndexes[index].key == 0)
+    return false;
+
+  const uint8_t sfSlot = m_signals[m_signalIndexes[index].slot].sfSlot;
+  for (uint32_t i = 0; i < m_nBands; i++)
+    RemoveFromBand (i, (*signal)[i], sfSlot);
+
+  EraseSignal (index);
+  return true;
+}
+
+bool
+LoRaWANInterferenceHelper::RemoveSignal (const SpectrumSignalParameters *signal)
+{
+  NS_LOG_FUNCTION (this << signal);
+
+  const uint32_t index = FindIndex (signal);
+  if (m_signalIndexes[index].key == 0)
+    return false;
+
+  const AccumulatedSignal &accumulated = m_signals[m_signalIndexes[index].slot];
+  RemoveFromBand (accumulated.band, accumulated.psd, accumulated.sfSlot);
+
+  EraseSignal (index);
+  return true;
+}
+
+uint32_t
+LoRaWANInterferenceHelper::GetHomeIndex (const void *key) const
+{
+  // Fibonacci hashing of the pointer, the upper bits are the best mixed
+  const uint64_t hash = reinterpret_cast<uintptr_t> (key) * 0x9E3779B97F4A7C15ULL;
+  return static_cast<uint32_t> (hash >> 32) & (m_signalIndexes.size () - 1);
+}
+
+uint32_t
+LoRaWANInterferenceHelper::FindIndex (const void *key) const
+{
+  const uint32_t mask = m_signalIndexes.size () - 1;
+  uint32_t index = GetHomeIndex (key);
+  while (m_signalIndexes[index].key != 0 && m_signalIndexes[index].key != key)
+    index = (index + 1) & mask;
+  return index;
+}
+
+bool
+LoRaWANInterferenceHelper::InsertSignal (const void *key, const AccumulatedSignal &accumulated)
+{
+  uint32_t index = FindIndex (key);
+  if (m_signalIndexes[index].key != 0)
+    return false;
+
+  if (2 * (m_signals.size () + 1) > m_signalIndexes.size ())
+    {
+      ResizeIndexes (2 * m_signalIndexes.size ());
+      index = FindIndex (key);
+    }
+
+  m_signalIndexes[index].key = key;
+  m_signalIndexes[index].slot = m_signals.size ();
+  m_signals.push_back (accumulated);
+  return true;
+}
 
-  if (signal->GetSpectrumModel () == m_spectrumModel)
+void
+LoRaWANInterferenceHelper::EraseSignal (uint32_t index)
+{
+  const uint32_t slot = m_signalIndexes[index].slot;
+  EraseIndex (index);
+  if (slot + 1 != m_signals.size ())
     {
-      result = (m_signals.erase (signal) == 1);
-      if (result)
+      m_signals[slot] = m_signals.back ();
+      const AccumulatedSignal &moved = m_signals[slot];
+      if (moved.params != 0)
+        m_signalIndexes[FindIndex (moved.params)].slot = slot;
+      else
+        m_signalIndexes[FindIndex (PeekPointer (moved.signal))].slot = slot;
+    }
+  m_signals.pop_back ();
+}
+
+void
+LoRaWANInterferenceHelper::EraseIndex (uint32_t index)
+{
+  const uint32_t mask = m_signalIndexes.size () - 1;
+  uint32_t next = (index + 1) & mask;
+  while (m_signalIndexes[next].key != 0)
+    {
+      // Move the entry back into the hole, unless its home entry lies
+      // cyclically in (index, next]
+      const uint32_t home = GetHomeIndex (m_signalIndexes[next].key);
+      if (((next - home) & mask) >= ((next - index) & mask))
         {
-          m_dirty = true;
+          m_signalIndexes[index] = m_signalIndexes[next];
+          index = next;
         }
+      next = (next + 1) & mask;
+    }
+  m_signalIndexes[index].key = 0;
+}
+
+void
+LoRaWANInterferenceHelper::ResizeIndexes (uint32_t size)
+{
+  NS_ASSERT ((size & (size - 1)) == 0);
+
+  std::vector<SignalIndex> indexes;
+  indexes.swap (m_signalIndexes);
+  SignalIndex empty;
+  empty.key = 0;
+  empty.slot = 0;
+  m_signalIndexes.assign (size, empty);
+  for (uint32_t i = 0; i < indexes.size (); i++)
+    {
+      if (indexes[i].key != 0)
+        m_signalIndexes[FindIndex (indexes[i].key)] = indexes[i];
     }
-  return result;
 }
 
 void
@@ -82,7 +268,13 @@ LoRaWANInterferenceHelper::ClearSignals (void)
   NS_LOG_FUNCTION (this);
 
   m_signals.clear ();
-  m_dirty = true;
+  SignalIndex empty;
+  empty.key = 0;
+  empty.slot = 0;
+  m_signalIndexes.assign (m_signalIndexes.size (), empty);
+  m_signal.assign (m_nBands, 0.0);
+  m_sfSignal.assign (N_SF_SLOTS * m_nBands, 0.0);
+  m_nSignalsInBand.assign (m_nBands, 0);
 }
 
 Ptr<SpectrumValue>
@@ -90,19 +282,37 @@ LoRaWANInterferenceHelper::GetSignalPsd (void) const
 {
   NS_LOG_FUNCTION (this);
 
-  if (m_dirty)
-    {
-      // Sum up the current interference PSD.
-      std::set<Ptr<const SpectrumValue> >::const_iterator it;
-      m_signal = Create<SpectrumValue> (m_spectrumModel);
-      for (it = m_signals.begin (); it != m_signals.end (); ++it)
-        {
-          *m_signal += *(*it);
-        }
-      m_dirty = false;
-    }
+  Ptr<SpectrumValue> signal = Create<SpectrumValue> (m_spectrumModel);
+  for (uint32_t i = 0; i < m_nBands; i++)
+    (*signal)[i] = m_signal[i];
+
+  return signal;
+}
 
-  return m_signal->Copy ();
+double
+LoRaWANInterferenceHelper::GetSignalPsd (uint32_t bandIndex) const
+{
+  NS_ASSERT (bandIndex < m_nBands);
+  return m_signal[bandIndex];
+}
+
+double
+LoRaWANInterferenceHelper::GetSignalPsd (uint32_t bandIndex, LoRaSpreadingFactor sf) const
+{
+  NS_ASSERT (bandIndex < m_nBands);
+  return m_sfSignal[GetSfSlot (sf) * m_nBands + bandIndex];
+}
+
+uint32_t
+LoRaWANInterferenceHelper::GetNSignals (void) const
+{
+  return m_signals.size ();
+}
+
+Ptr<const SpectrumModel>
+LoRaWANInterferenceHelper::GetSpectrumModel (void) const
+{
+  return m_spectrumModel;
 }
 
 }
@@ -22,17 +22,31 @@
 
 #include <ns3/simple-ref-count.h>
 #include <ns3/ptr.h>
-#include <set>
+#include "lorawan.h"
+#include <vector>
 
 namespace ns3 {
 
 class SpectrumValue;
 class SpectrumModel;
+struct SpectrumSignalParameters;
 
 /**
  * \ingroup lorawan
  *
  * \brief This class provides helper functions for LoRaWAN interference handling.
+ *
+ * The helper keeps the sum of all accumulated signals as a running power
+ * spectral density per band of the SpectrumModel, both in total and per
+ * spreading factor. Adding or removing a signal only updates these sums, so
+ * that the interference in a band can be queried without summing up the
+ * accumulated signals or allocating a new SpectrumValue. When the last signal
+ * in a band is removed, the sums for that band are reset to zero so that
+ * rounding errors do not accumulate over the course of a simulation.
+ *
+ * A LoRa signal only has power in the band of its channel, so it can also be
+ * added as a single received power spectral density, identified by its
+ * (shared) signal parameters. This avoids a per-receiver SpectrumValue.
  */
 class LoRaWANInterferenceHelper : public SimpleRefCount<LoRaWANInterferenceHelper>
 {
@@ -49,7 +63,8 @@ public:
   /**
    * Add the given signal to the set of accumulated signals. Never add the same
    * signal more than once. The SpectrumModels of the signal and the one used
-   * for instantiation of the helper have to be the same.
+   * for instantiation of the helper have to be the same. The signal is not
+   * accounted to any spreading factor (e.g. a non-LoRa signal).
    *
    * \param signal the signal to be added
    * \return false, if the signal was not added because the SpectrumModel of the
@@ -57,6 +72,30 @@ public:
    */
   bool AddSignal (Ptr<const SpectrumValue> signal);
 
+  /**
+   * Add the given LoRa signal to the set of accumulated signals.
+   *
+   * \param signal the signal to be added
+   * \param sf the spreading factor of the signal
+   * \return false, if the signal was not added because the SpectrumModel of the
+   * signal does not match the one of the helper, true otherwise.
+   */
+  bool AddSignal (Ptr<const SpectrumValue> signal, LoRaSpreadingFactor sf);
+
+  /**
+   * Add a LoRa signal that only has power in a single band to the set of
+   * accumulated signals. The signal is identified by its parameters, which
+   * have to stay alive until the signal is removed again.
+   *
+   * \param signal the parameters of the signal to be added
+   * \param bandIndex the index of the band of the signal in the SpectrumModel
+   * \param psd the received power spectral density of the signal in the band
+   * \param sf the spreading factor of the signal
+   * \return false, if the signal was not added because it was added before,
+   * true otherwise.
+   */
+  bool AddSignal (const SpectrumSignalParameters *signal, uint32_t bandIndex, double psd, LoRaSpreadingFactor sf);
+
   /**
    * Remove the given signal to the set of accumulated signals.
    *
@@ -66,18 +105,52 @@ public:
    */
   bool RemoveSignal (Ptr<const SpectrumValue> signal);
 
+  /**
+   * Remove a signal that was added as a single received power spectral
+   * density.
+   *
+   * \param signal the parameters of the signal to be removed
+   * \return false, if the signal was not removed (because it was not added
+   * before), true otherwise.
+   */
+  bool RemoveSignal (const SpectrumSignalParameters *signal);
+
   /**
    * Remove all currently accumulated signals.
    */
   void ClearSignals (void);
 
   /**
-   * Get the sum of all accumulated signals.
+   * Get the sum of all accumulated signals. Note that this allocates a new
+   * SpectrumValue, use GetSignalPsd (uint32_t) to look up a single band.
    *
    * \return the sum of the signals
    */
   Ptr<SpectrumValue> GetSignalPsd (void) const;
 
+  /**
+   * Get the sum of all accumulated signals in a single band.
+   *
+   * \param bandIndex the index of the band in the SpectrumModel
+   * \return the power spectral density of the sum of the signals in the band
+   */
+  double GetSignalPsd (uint32_t bandIndex) const;
+
+  /**
+   * Get the sum of the accumulated signals with the given spreading factor in
+   * a single band.
+   *
+   * \param bandIndex the index of the band in the SpectrumModel
+   * \param sf the spreading factor
+   * \return the power spectral density of the sum of the signals in the band
+   */
+  double GetSignalPsd (uint32_t bandIndex, LoRaSpreadingFactor sf) const;
+
+  /**
+   * \return the number of accumulated signals
+   */
+  uint32_t GetNSignals (void) const;
+
   /**
    * Get the SpectrumModel used by the helper.
    *
@@ -95,26 +168,159 @@ private:
    * \returns
    */
   LoRaWANInterferenceHelper& operator= (LoRaWANInterferenceHelper const &);
+
+  /**
+   * Add a signal to the running sums.
+   *
+   * \param signal the signal to be added
+   * \param sfSlot the spreading factor slot of the signal (see GetSfSlot)
+   * \return false, if the signal was not added, true otherwise.
+   */
+  bool DoAddSignal (Ptr<const SpectrumValue> signal, uint8_t sfSlot);
+
+  /**
+   * \param sf a spreading factor
+   * \return the slot of the spreading factor in m_sfSignal
+   */
+  static uint8_t GetSfSlot (LoRaSpreadingFactor sf);
+
+  /**
+   * An accumulated signal and the slot of its spreading factor. A signal is
+   * either a SpectrumValue, or the received power spectral density of a
+   * signal in a single band.
+   */
+  struct AccumulatedSignal
+  {
+    Ptr<const SpectrumValue> signal;          //!< the accumulated signal, 0 for a single band signal
+    const SpectrumSignalParameters *params;   //!< the parameters of a single band signal
+    uint32_t band;                            //!< the band of a single band signal
+    double psd;                               //!< the power spectral density of a single band signal
+    uint8_t sfSlot;                           //!< the spreading factor slot of the signal
+  };
+
+  /**
+   * Add power to the running sums of a band.
+   *
+   * \param band the index of the band
+   * \param psd the power spectral density
+   * \param sfSlot the spreading factor slot of the power
+   */
+  void AddToBand (uint32_t band, double psd, uint8_t sfSlot);
+
+  /**
+   * Remove power from the running sums of a band.
+   *
+   * \param band the index of the band
+   * \param psd the power spectral density
+   * \param sfSlot the spreading factor slot of the power
+   */
+  void RemoveFromBand (uint32_t band, double psd, uint8_t sfSlot);
+
+  /**
+   * An entry of the open addressing table m_signalIndexes.
+   */
+  struct SignalIndex
+  {
+    const void *key;  //!< the SpectrumValue or parameters of the signal, 0 for an empty entry
+    uint32_t slot;    //!< the slot of the signal in m_signals
+  };
+
+  /**
+   * \param key the SpectrumValue or parameters of a signal
+   * \return the first entry of m_signalIndexes in the probe sequence of key
+   */
+  uint32_t GetHomeIndex (const void *key) const;
+
+  /**
+   * \param key the SpectrumValue or parameters of a signal
+   * \return the entry of the signal in m_signalIndexes, or the empty entry
+   * where it would be inserted
+   */
+  uint32_t FindIndex (const void *key) const;
+
+  /**
+   * Add a signal at the end of m_signals and insert it in m_signalIndexes.
+   *
+   * \param key the SpectrumValue or parameters of the signal
+   * \param accumulated the signal
+   * \return false, if the signal was added before, true otherwise.
+   */
+  bool InsertSignal (const void *key, const AccumulatedSignal &accumulated);
+
+  /**
+   * Remove the signal at a slot of m_signals by moving the last signal in its
+   * place, the order of the signals does not matter.
+   *
+   * \param index the entry of the signal in m_signalIndexes
+   */
+  void EraseSignal (uint32_t index);
+
+  /**
+   * Remove an entry from m_signalIndexes, moving back the entries that follow
+   * it in its probe sequence.
+   *
+   * \param index the entry to be removed
+   */
+  void EraseIndex (uint32_t index);
+
+  /**
+   * Rebuild m_signalIndexes with the given number of entries.
+   *
+   * \param size the new number of entries, a power of two
+   */
+  void ResizeIndexes (uint32_t size);
+
+  /**
+   * The number of spreading factor slots: one per spreading factor (SF6 to
+   * SF12) and one for signals without a spreading factor.
+   */
+  static const uint8_t N_SF_SLOTS = 8;
+
+  /**
+   * The spreading factor slot for signals without a spreading factor.
+   */
+  static const uint8_t NO_SF_SLOT = N_SF_SLOTS - 1;
+
   /**
    * The helpers SpectrumModel.
    */
   Ptr<const SpectrumModel> m_spectrumModel;
 
   /**
-   * The set of accumulated signals.
+   * The number of bands of m_spectrumModel.
+   */
+  uint32_t m_nBands;
+
+  /**
+   * The accumulated signals. The vector only grows, so that no allocation
+   * happens once it has reached the maximum number of concurrent signals.
+   */
+  std::vector<AccumulatedSignal> m_signals;
+
+  /**
+   * The slot in m_signals of every accumulated signal, by its SpectrumValue
+   * or its parameters, so that signals are added and removed in constant time.
+   * This is an open addressing table with linear probing, kept at least twice
+   * as large as m_signals. Like m_signals it only grows, so that adding and
+   * removing signals does not allocate once the maximum is reached.
+   */
+  std::vector<SignalIndex> m_signalIndexes;
+
+  /**
+   * The sum of all accumulated signals, per band.
    */
-  std::set<Ptr<const SpectrumValue> > m_signals;
+  std::vector<double> m_signal;
 
   /**
-   * The precomputed sum of all accumulated signals.
+   * The sum of the accumulated signals per spreading factor slot and band
+   * (index = sfSlot * m_nBands + band).
    */
-  mutable Ptr<SpectrumValue> m_signal;
+  std::vector<double> m_sfSignal;
 
   /**
-   * Mark m_signal as dirty, whenever a signal is added or removed. m_signal has
-   * to be recomputed before next use.
+   * The number of accumulated signals with power in a band, per band.
    */
-  mutable bool m_dirty;
+  std::vector<uint32_t> m_nSignalsInBand;
 };
 
 }
@@ -0,0 +1,339 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include "lorawan-join-header.h"
+#include <ns3/log.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANJoinHeader");
+
+NS_OBJECT_ENSURE_REGISTERED (LoRaWANJoinRequestHeader);
+NS_OBJECT_ENSURE_REGISTERED (LoRaWANJoinAcceptHeader);
+NS_OBJECT_ENSURE_REGISTERED (LoRaWANDevEuiTag);
+
+LoRaWANJoinRequestHeader::LoRaWANJoinRequestHeader () : m_appEui(0), m_devEui(0), m_devNonce(0)
+{
+}
+
+LoRaWANJoinRequestHeader::LoRaWANJoinRequestHeader (uint64_t appEui, uint64_t devEui, uint16_t devNonce) : m_appEui(appEui), m_devEui(devEui), m_devNonce(devNonce)
+{
+}
+
+LoRaWANJoinRequestHeader::~LoRaWANJoinRequestHeader ()
+{
+}
+
+uint64_t
+LoRaWANJoinRequestHeader::GetAppEui (void) const
+{
+  return m_appEui;
+}
+
+void
+LoRaWANJoinRequestHeader::SetAppEui (uint64_t appEui)
+{
+  m_appEui = appEui;
+}
+
+uint64_t
+LoRaWANJoinRequestHeader::GetDevEui (void) const
+{
+  return m_devEui;
+}
+
+void
+LoRaWANJoinRequestHeader::SetDevEui (uint64_t devEui)
+{
+  m_devEui = devEui;
+}
+
+uint16_t
+LoRaWANJoinRequestHeader::GetDevNonce (void) const
+{
+  return m_devNonce;
+}
+
+void
+LoRaWANJoinRequestHeader::SetDevNonce (uint16_t devNonce)
+{
+  m_devNonce = devNonce;
+}
+
+TypeId
+LoRaWANJoinRequestHeader::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoRaWANJoinRequestHeader")
+    .SetParent<Header> ()
+    .SetGroupName ("LoRaWAN")
+    .AddConstructor<LoRaWANJoinRequestHeader> ();
+  return tid;
+}
+
+TypeId
+LoRaWANJoinRequestHeader::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+void
+LoRaWANJoinRequestHeader::Print (std::ostream &os) const
+{
+  os << "JoinRequest: AppEUI = " << std::hex << m_appEui << ", DevEUI = " << m_devEui << std::dec << ", DevNonce = " << m_devNonce;
+}
+
+uint32_t
+LoRaWANJoinRequestHeader::GetSerializedSize (void) const
+{
+  /*
+   * AppEUI (8 bytes), DevEUI (8 bytes) and DevNonce (2 bytes)
+   */
+
+  return 18;
+}
+
+void
+LoRaWANJoinRequestHeader::Serialize (Buffer::Iterator start) const
+{
+  Buffer::Iterator i = start;
+  i.WriteHtolsbU64 (m_appEui); // the fields of join messages are little endian
+  i.WriteHtolsbU64 (m_devEui);
+  i.WriteHtolsbU16 (m_devNonce);
+}
+
+uint32_t
+LoRaWANJoinRequestHeader::Deserialize (Buffer::Iterator start)
+{
+  Buffer::Iterator i = start;
+  m_appEui = i.ReadLsbtohU64 ();
+  m_devEui = i.ReadLsbtohU64 ();
+  m_devNonce = i.ReadLsbtohU16 ();
+
+  return 18;
+}
+
+// ----------------------------------------------------------------------------------------------------------
+
+LoRaWANJoinAcceptHeader::LoRaWANJoinAcceptHeader () : m_appNonce(0), m_netId(0), m_devAddr((uint32_t)0), m_rx1DROffset(0), m_rx2DataRateIndex(0), m_rxDelay(1)
+{
+}
+
+LoRaWANJoinAcceptHeader::~LoRaWANJoinAcceptHeader ()
+{
+}
+
+uint32_t
+LoRaWANJoinAcceptHeader::GetAppNonce (void) const
+{
+  return m_appNonce;
+}
+
+void
+LoRaWANJoinAcceptHeader::SetAppNonce (uint32_t appNonce)
+{
+  m_appNonce = appNonce & 0xFFFFFF;
+}
+
+uint32_t
+LoRaWANJoinAcceptHeader::GetNetId (void) const
+{
+  return m_netId;
+}
+
+void
+LoRaWANJoinAcceptHeader::SetNetId (uint32_t netId)
+{
+  m_netId = netId & 0xFFFFFF;
+}
+
+Ipv4Address
+LoRaWANJoinAcceptHeader::GetDevAddr (void) const
+{
+  return m_devAddr;
+}
+
+void
+LoRaWANJoinAcceptHeader::SetDevAddr (Ipv4Address devAddr)
+{
+  m_devAddr = devAddr;
+}
+
+uint8_t
+LoRaWANJoinAcceptHeader::GetRx1DROffset (void) const
+{
+  return m_rx1DROffset;
+}
+
+void
+LoRaWANJoinAcceptHeader::SetRx1DROffset (uint8_t offset)
+{
+  m_rx1DROffset = offset & 0x07;
+}
+
+uint8_t
+LoRaWANJoinAcceptHeader::GetRx2DataRateIndex (void) const
+{
+  return m_rx2DataRateIndex;
+}
+
+void
+LoRaWANJoinAcceptHeader::SetRx2DataRateIndex (uint8_t dataRateIndex)
+{
+  m_rx2DataRateIndex = dataRateIndex & 0x0F;
+}
+
+uint8_t
+LoRaWANJoinAcceptHeader::GetRxDelay (void) const
+{
+  return m_rxDelay;
+}
+
+void
+LoRaWANJoinAcceptHeader::SetRxDelay (uint8_t rxDelay)
+{
+  m_rxDelay = rxDelay & 0x0F;
+}
+
+TypeId
+LoRaWANJoinAcceptHeader::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoRaWANJoinAcceptHeader")
+    .SetParent<Header> ()
+    .SetGroupName ("LoRaWAN")
+    .AddConstructor<LoRaWANJoinAcceptHeader> ();
+  return tid;
+}
+
+TypeId
+LoRaWANJoinAcceptHeader::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+void
+LoRaWANJoinAcceptHeader::Print (std::ostream &os) const
+{
+  os << "JoinAccept: AppNonce = " << m_appNonce << ", NetID = " << m_netId << ", DevAddr = " << m_devAddr
+     << ", RX1DROffset = " << (uint32_t)m_rx1DROffset << ", RX2DataRate = " << (uint32_t)m_rx2DataRateIndex << ", RxDelay = " << (uint32_t)m_rxDelay;
+}
+
+uint32_t
+LoRaWANJoinAcceptHeader::GetSerializedSize (void) const
+{
+  /*
+   * AppNonce (3 bytes), NetID (3 bytes), DevAddr (4 bytes), DLSettings (1 byte) and RxDelay (1 byte)
+   */
+
+  return 12;
+}
+
+void
+LoRaWANJoinAcceptHeader::Serialize (Buffer::Iterator start) const
+{
+  Buffer::Iterator i = start;
+  i.WriteHtolsbU16 (m_appNonce & 0xFFFF);
+  i.WriteU8 ((m_appNonce >> 16) & 0xFF);
+  i.WriteHtolsbU16 (m_netId & 0xFFFF);
+  i.WriteU8 ((m_netId >> 16) & 0xFF);
+  i.WriteHtolsbU32 (m_devAddr.Get ());
+  i.WriteU8 (((m_rx1DROffset & 0x07) << 4) | (m_rx2DataRateIndex & 0x0F));
+  i.WriteU8 (m_rxDelay & 0x0F);
+}
+
+uint32_t
+LoRaWANJoinAcceptHeader::Deserialize (Buffer::Iterator start)
+{
+  Buffer::Iterator i = start;
+  m_appNonce = i.ReadLsbtohU16 ();
+  m_appNonce |= (uint32_t)i.ReadU8 () << 16;
+  m_netId = i.ReadLsbtohU16 ();
+  m_netId |= (uint32_t)i.ReadU8 () << 16;
+  m_devAddr.Set (i.ReadLsbtohU32 ());
+  uint8_t dlSettings = i.ReadU8 ();
+  m_rx1DROffset = (dlSettings >> 4) & 0x07;
+  m_rx2DataRateIndex = dlSettings & 0x0F;
+  m_rxDelay = i.ReadU8 () & 0x0F;
+
+  return 12;
+}
+
+// ----------------------------------------------------------------------------------------------------------
+
+LoRaWANDevEuiTag::LoRaWANDevEuiTag () : m_devEui(0)
+{
+}
+
+LoRaWANDevEuiTag::LoRaWANDevEuiTag (uint64_t devEui) : m_devEui(devEui)
+{
+}
+
+uint64_t
+LoRaWANDevEuiTag::GetDevEui (void) const
+{
+  return m_devEui;
+}
+
+void
+LoRaWANDevEuiTag::SetDevEui (uint64_t devEui)
+{
+  m_devEui = devEui;
+}
+
+TypeId
+LoRaWANDevEuiTag::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoRaWANDevEuiTag")
+    .SetParent<Tag> ()
+    .SetGroupName("LoRaWAN")
+    .AddConstructor<LoRaWANDevEuiTag> ()
+    ;
+  return tid;
+}
+
+TypeId
+LoRaWANDevEuiTag::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+uint32_t
+LoRaWANDevEuiTag::GetSerializedSize (void) const
+{
+  return sizeof (uint64_t);
+}
+
+void
+LoRaWANDevEuiTag::Serialize (TagBuffer i) const
+{
+  i.WriteU64 (m_devEui);
+}
+
+void
+LoRaWANDevEuiTag::Deserialize (TagBuffer i)
+{
+  m_devEui = i.ReadU64 ();
+}
+
+void
+LoRaWANDevEuiTag::Print (std::ostream &os) const
+{
+  os << "LORAWAN_DEV_EUI: " << std::hex << m_devEui << std::dec;
+}
+
+}; // namespace ns-3
@@ -0,0 +1,174 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#ifndef LORAWAN_JOIN_HEADER_H
+#define LORAWAN_JOIN_HEADER_H
+
+#include <ns3/header.h>
+#include <ns3/tag.h>
+#include <ns3/ipv4-address.h>
+
+namespace ns3 {
+
+/**
+ * \ingroup lorawan
+ * Represent the payload of a JoinRequest message ($6.2.4 in LoRaWAN spec),
+ * which an end device sends to join a network by over-the-air activation.
+ * The DevNonce is a random value that the network server keeps track of, as
+ * to ignore replayed JoinRequests.
+ */
+class LoRaWANJoinRequestHeader : public Header
+{
+public:
+  LoRaWANJoinRequestHeader (void);
+  LoRaWANJoinRequestHeader (uint64_t appEui, uint64_t devEui, uint16_t devNonce);
+  ~LoRaWANJoinRequestHeader (void);
+
+  uint64_t GetAppEui (void) const;
+  void SetAppEui (uint64_t appEui);
+
+  uint64_t GetDevEui (void) const;
+  void SetDevEui (uint64_t devEui);
+
+  uint16_t GetDevNonce (void) const;
+  void SetDevNonce (uint16_t devNonce);
+
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+
+  void Print (std::ostream &os) const;
+  uint32_t GetSerializedSize (void) const;
+  void Serialize (Buffer::Iterator start) const;
+  uint32_t Deserialize (Buffer::Iterator start);
+
+private:
+  uint64_t m_appEui;
+  uint64_t m_devEui;
+  uint16_t m_devNonce;
+}; //LoRaWANJoinRequestHeader
+
+/**
+ * \ingroup lorawan
+ * Represent the payload of a JoinAccept message ($6.2.5 in LoRaWAN spec),
+ * without the optional list of channel frequencies. The network server
+ * answers a JoinRequest with a JoinAccept, which assigns a device address to
+ * the end device.
+ */
+class LoRaWANJoinAcceptHeader : public Header
+{
+public:
+  LoRaWANJoinAcceptHeader (void);
+  ~LoRaWANJoinAcceptHeader (void);
+
+  /**
+   * \return the AppNonce, only the 24 least significant bits are sent
+   */
+  uint32_t GetAppNonce (void) const;
+  void SetAppNonce (uint32_t appNonce);
+
+  /**
+   * \return the NetID, only the 24 least significant bits are sent
+   */
+  uint32_t GetNetId (void) const;
+  void SetNetId (uint32_t netId);
+
+  Ipv4Address GetDevAddr (void) const;
+  void SetDevAddr (Ipv4Address devAddr);
+
+  uint8_t GetRx1DROffset (void) const;
+  void SetRx1DROffset (uint8_t offset);
+
+  uint8_t GetRx2DataRateIndex (void) const;
+  void SetRx2DataRateIndex (uint8_t dataRateIndex);
+
+  /**
+   * \return the delay between the end of an US transmission and RW1 in seconds
+   */
+  uint8_t GetRxDelay (void) const;
+  void SetRxDelay (uint8_t rxDelay);
+
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+
+  void Print (std::ostream &os) const;
+  uint32_t GetSerializedSize (void) const;
+  void Serialize (Buffer::Iterator start) const;
+  uint32_t Deserialize (Buffer::Iterator start);
+
+private:
+  uint32_t m_appNonce;
+  uint32_t m_netId;
+  Ipv4Address m_devAddr;
+  uint8_t m_rx1DROffset;
+  uint8_t m_rx2DataRateIndex;
+  uint8_t m_rxDelay;
+}; //LoRaWANJoinAcceptHeader
+
+/**
+ * \ingroup lorawan
+ * The DevEUI of the end device for which a JoinAccept is meant. An end
+ * device recognizes its JoinAccept by checking the MIC with its AppKey, but
+ * without crypto (the Crypto attributes of LoRaWANMac and the network server)
+ * JoinAccepts have no MIC. Then the network server adds this tag to a
+ * JoinAccept and end devices compare it to their own DevEUI.
+ */
+class LoRaWANDevEuiTag : public Tag
+{
+public:
+  LoRaWANDevEuiTag (void);
+  LoRaWANDevEuiTag (uint64_t devEui);
+
+  uint64_t GetDevEui (void) const;
+  void SetDevEui (uint64_t devEui);
+
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  // inherited function, no need to doc.
+  virtual TypeId GetInstanceTypeId (void) const;
+
+  // inherited function, no need to doc.
+  virtual uint32_t GetSerializedSize (void) const;
+
+  // inherited function, no need to doc.
+  virtual void Serialize (TagBuffer i) const;
+
+  // inherited function, no need to doc.
+  virtual void Deserialize (TagBuffer i);
+
+  // inherited function, no need to doc.
+  virtual void Print (std::ostream &os) const;
+private:
+  uint64_t m_devEui;
+}; // class LoRaWANDevEuiTag
+
+}; // namespace ns-3
+
+#endif /* LORAWAN_JOIN_HEADER_H */
@@ -0,0 +1,536 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include "lorawan-mac-command.h"
+#include <ns3/log.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANMacCommand");
+
+NS_OBJECT_ENSURE_REGISTERED (LoRaWANLinkAdrReqHeader);
+NS_OBJECT_ENSURE_REGISTERED (LoRaWANDutyCycleReqHeader);
+NS_OBJECT_ENSURE_REGISTERED (LoRaWANRxParamSetupReqHeader);
+NS_OBJECT_ENSURE_REGISTERED (LoRaWANDevStatusReqHeader);
+NS_OBJECT_ENSURE_REGISTERED (LoRaWANDevStatusAnsHeader);
+
+uint8_t
+LoRaWANGetMacCommandLength (uint8_t cid, bool downstream)
+{
+  switch (cid) {
+    case LORAWAN_CID_LINK_CHECK:
+      return downstream ? 3 : 1;
+    case LORAWAN_CID_LINK_ADR:
+      return downstream ? 5 : 2;
+    case LORAWAN_CID_DUTY_CYCLE:
+      return downstream ? 2 : 1;
+    case LORAWAN_CID_RX_PARAM_SETUP:
+      return downstream ? 5 : 2;
+    case LORAWAN_CID_DEV_STATUS:
+      return downstream ? 1 : 3;
+    default:
+      return 0;
+  }
+}
+
+// ChMaskCntl = 6 enables all defined channels in EU868, the ChMask is then ignored
+LoRaWANLinkAdrReqHeader::LoRaWANLinkAdrReqHeader () : m_dataRateIndex(0xF), m_txPowerIndex(0xF), m_chMask(0), m_chMaskCntl(6), m_nbRep(0)
+{
+}
+
+LoRaWANLinkAdrReqHeader::LoRaWANLinkAdrReqHeader (uint8_t dataRateIndex, uint8_t txPowerIndex) : m_dataRateIndex(dataRateIndex), m_txPowerIndex(txPowerIndex), m_chMask(0), m_chMaskCntl(6), m_nbRep(0)
+{
+}
+
+LoRaWANLinkAdrReqHeader::~LoRaWANLinkAdrReqHeader ()
+{
+}
+
+uint8_t
+LoRaWANLinkAdrReqHeader::GetDataRateIndex (void) const
+{
+  return m_dataRateIndex;
+}
+
+void
+LoRaWANLinkAdrReqHeader::SetDataRateIndex (uint8_t dataRateIndex)
+{
+  m_dataRateIndex = dataRateIndex & 0x0F;
+}
+
+uint8_t
+LoRaWANLinkAdrReqHeader::GetTxPowerIndex (void) const
+{
+  return m_txPowerIndex;
+}
+
+void
+LoRaWANLinkAdrReqHeader::SetTxPowerIndex (uint8_t txPowerIndex)
+{
+  m_txPowerIndex = txPowerIndex & 0x0F;
+}
+
+uint16_t
+LoRaWANLinkAdrReqHeader::GetChMask (void) const
+{
+  return m_chMask;
+}
+
+void
+LoRaWANLinkAdrReqHeader::SetChMask (uint16_t chMask)
+{
+  m_chMask = chMask;
+}
+
+uint8_t
+LoRaWANLinkAdrReqHeader::GetChMaskCntl (void) const
+{
+  return m_chMaskCntl;
+}
+
+void
+LoRaWANLinkAdrReqHeader::SetChMaskCntl (uint8_t chMaskCntl)
+{
+  m_chMaskCntl = chMaskCntl & 0x07;
+}
+
+uint8_t
+LoRaWANLinkAdrReqHeader::GetNbRep (void) const
+{
+  return m_nbRep;
+}
+
+void
+LoRaWANLinkAdrReqHeader::SetNbRep (uint8_t nbRep)
+{
+  m_nbRep = nbRep & 0x0F;
+}
+
+TypeId
+LoRaWANLinkAdrReqHeader::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoRaWANLinkAdrReqHeader")
+    .SetParent<Header> ()
+    .SetGroupName ("LoRaWAN")
+    .AddConstructor<LoRaWANLinkAdrReqHeader> ();
+  return tid;
+}
+
+TypeId
+LoRaWANLinkAdrReqHeader::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+void
+LoRaWANLinkAdrReqHeader::Print (std::ostream &os) const
+{
+  os << "LinkADRReq: DataRate = " << (uint32_t)m_dataRateIndex << ", TXPower = " << (uint32_t)m_txPowerIndex
+     << ", ChMask = " << std::hex << m_chMask << std::dec << ", ChMaskCntl = " << (uint32_t)m_chMaskCntl << ", NbRep = " << (uint32_t)m_nbRep;
+}
+
+uint32_t
+LoRaWANLinkAdrReqHeader::GetSerializedSize (void) const
+{
+  /*
+   * CID (1 byte), DataRate_TXPower (1 byte), ChMask (2 bytes) and Redundancy (1 byte)
+   */
+
+  return 5;
+}
+
+void
+LoRaWANLinkAdrReqHeader::Serialize (Buffer::Iterator start) const
+{
+  Buffer::Iterator i = start;
+  i.WriteU8 (LORAWAN_CID_LINK_ADR);
+  i.WriteU8 ((m_dataRateIndex << 4) | (m_txPowerIndex & 0x0F));
+  i.WriteHtolsbU16 (m_chMask); // MAC command fields are little endian
+  i.WriteU8 (((m_chMaskCntl & 0x07) << 4) | (m_nbRep & 0x0F));
+}
+
+uint32_t
+LoRaWANLinkAdrReqHeader::Deserialize (Buffer::Iterator start)
+{
+  Buffer::Iterator i = start;
+
+  uint8_t cid = i.ReadU8 ();
+  if (cid != LORAWAN_CID_LINK_ADR) {
+    NS_LOG_WARN (this << " Unexpected CID " << (uint32_t)cid << " for LinkADRReq");
+  }
+
+  uint8_t dataRateTxPower = i.ReadU8 ();
+  m_dataRateIndex = dataRateTxPower >> 4;
+  m_txPowerIndex = dataRateTxPower & 0x0F;
+  m_chMask = i.ReadLsbtohU16 ();
+  uint8_t redundancy = i.ReadU8 ();
+  m_chMaskCntl = (redundancy >> 4) & 0x07;
+  m_nbRep = redundancy & 0x0F;
+
+  return 5;
+}
+
+// ----------------------------------------------------------------------------------------------------------
+
+LoRaWANDutyCycleReqHeader::LoRaWANDutyCycleReqHeader () : m_maxDutyCycle(0)
+{
+}
+
+LoRaWANDutyCycleReqHeader::LoRaWANDutyCycleReqHeader (uint8_t maxDutyCycle) : m_maxDutyCycle(maxDutyCycle & 0x0F)
+{
+}
+
+LoRaWANDutyCycleReqHeader::~LoRaWANDutyCycleReqHeader ()
+{
+}
+
+uint8_t
+LoRaWANDutyCycleReqHeader::GetMaxDutyCycle (void) const
+{
+  return m_maxDutyCycle;
+}
+
+void
+LoRaWANDutyCycleReqHeader::SetMaxDutyCycle (uint8_t maxDutyCycle)
+{
+  m_maxDutyCycle = maxDutyCycle & 0x0F;
+}
+
+TypeId
+LoRaWANDutyCycleReqHeader::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoRaWANDutyCycleReqHeader")
+    .SetParent<Header> ()
+    .SetGroupName ("LoRaWAN")
+    .AddConstructor<LoRaWANDutyCycleReqHeader> ();
+  return tid;
+}
+
+TypeId
+LoRaWANDutyCycleReqHeader::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+void
+LoRaWANDutyCycleReqHeader::Print (std::ostream &os) const
+{
+  os << "DutyCycleReq: MaxDCycle = " << (uint32_t)m_maxDutyCycle;
+}
+
+uint32_t
+LoRaWANDutyCycleReqHeader::GetSerializedSize (void) const
+{
+  // CID (1 byte) and DutyCyclePL (1 byte)
+  return 2;
+}
+
+void
+LoRaWANDutyCycleReqHeader::Serialize (Buffer::Iterator start) const
+{
+  Buffer::Iterator i = start;
+  i.WriteU8 (LORAWAN_CID_DUTY_CYCLE);
+  i.WriteU8 (m_maxDutyCycle & 0x0F);
+}
+
+uint32_t
+LoRaWANDutyCycleReqHeader::Deserialize (Buffer::Iterator start)
+{
+  Buffer::Iterator i = start;
+
+  uint8_t cid = i.ReadU8 ();
+  if (cid != LORAWAN_CID_DUTY_CYCLE) {
+    NS_LOG_WARN (this << " Unexpected CID " << (uint32_t)cid << " for DutyCycleReq");
+  }
+  m_maxDutyCycle = i.ReadU8 () & 0x0F;
+
+  return 2;
+}
+
+// ----------------------------------------------------------------------------------------------------------
+
+LoRaWANRxParamSetupReqHeader::LoRaWANRxParamSetupReqHeader () : m_rx1DROffset(0), m_rx2DataRateIndex(0), m_frequency(0)
+{
+}
+
+LoRaWANRxParamSetupReqHeader::LoRaWANRxParamSetupReqHeader (uint8_t rx1DROffset, uint8_t rx2DataRateIndex, uint32_t frequency) : m_rx1DROffset(rx1DROffset & 0x07), m_rx2DataRateIndex(rx2DataRateIndex & 0x0F), m_frequency(frequency)
+{
+}
+
+LoRaWANRxParamSetupReqHeader::~LoRaWANRxParamSetupReqHeader ()
+{
+}
+
+uint8_t
+LoRaWANRxParamSetupReqHeader::GetRx1DROffset (void) const
+{
+  return m_rx1DROffset;
+}
+
+void
+LoRaWANRxParamSetupReqHeader::SetRx1DROffset (uint8_t rx1DROffset)
+{
+  m_rx1DROffset = rx1DROffset & 0x07;
+}
+
+uint8_t
+LoRaWANRxParamSetupReqHeader::GetRx2DataRateIndex (void) const
+{
+  return m_rx2DataRateIndex;
+}
+
+void
+LoRaWANRxParamSetupReqHeader::SetRx2DataRateIndex (uint8_t rx2DataRateIndex)
+{
+  m_rx2DataRateIndex = rx2DataRateIndex & 0x0F;
+}
+
+uint32_t
+LoRaWANRxParamSetupReqHeader::GetFrequency (void) const
+{
+  return m_frequency;
+}
+
+void
+LoRaWANRxParamSetupReqHeader::SetFrequency (uint32_t frequency)
+{
+  m_frequency = frequency;
+}
+
+TypeId
+LoRaWANRxParamSetupReqHeader::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoRaWANRxParamSetupReqHeader")
+    .SetParent<Header> ()
+    .SetGroupName ("LoRaWAN")
+    .AddConstructor<LoRaWANRxParamSetupReqHeader> ();
+  return tid;
+}
+
+TypeId
+LoRaWANRxParamSetupReqHeader::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+void
+LoRaWANRxParamSetupReqHeader::Print (std::ostream &os) const
+{
+  os << "RXParamSetupReq: RX1DROffset = " << (uint32_t)m_rx1DROffset << ", RX2DataRate = " << (uint32_t)m_rx2DataRateIndex << ", Frequency = " << m_frequency;
+}
+
+uint32_t
+LoRaWANRxParamSetupReqHeader::GetSerializedSize (void) const
+{
+  /*
+   * CID (1 byte), DLsettings (1 byte) and Frequency (3 bytes)
+   */
+
+  return 5;
+}
+
+void
+LoRaWANRxParamSetupReqHeader::Serialize (Buffer::Iterator start) const
+{
+  Buffer::Iterator i = start;
+  i.WriteU8 (LORAWAN_CID_RX_PARAM_SETUP);
+  i.WriteU8 (((m_rx1DROffset & 0x07) << 4) | (m_rx2DataRateIndex & 0x0F));
+  // The frequency is a 24 bit little endian value in steps of 100 Hz
+  const uint32_t frequency = m_frequency / 100;
+  i.WriteU8 (frequency & 0xFF);
+  i.WriteU8 ((frequency >> 8) & 0xFF);
+  i.WriteU8 ((frequency >> 16) & 0xFF);
+}
+
+uint32_t
+LoRaWANRxParamSetupReqHeader::Deserialize (Buffer::Iterator start)
+{
+  Buffer::Iterator i = start;
+
+  uint8_t cid = i.ReadU8 ();
+  if (cid != LORAWAN_CID_RX_PARAM_SETUP) {
+    NS_LOG_WARN (this << " Unexpected CID " << (uint32_t)cid << " for RXParamSetupReq");
+  }
+
+  uint8_t dlSettings = i.ReadU8 ();
+  m_rx1DROffset = (dlSettings >> 4) & 0x07;
+  m_rx2DataRateIndex = dlSettings & 0x0F;
+  uint32_t frequency = i.ReadU8 ();
+  frequency |= (uint32_t)i.ReadU8 () << 8;
+  frequency |= (uint32_t)i.ReadU8 () << 16;
+  m_frequency = frequency * 100;
+
+  return 5;
+}
+
+// ----------------------------------------------------------------------------------------------------------
+
+LoRaWANDevStatusReqHeader::LoRaWANDevStatusReqHeader ()
+{
+}
+
+LoRaWANDevStatusReqHeader::~LoRaWANDevStatusReqHeader ()
+{
+}
+
+TypeId
+LoRaWANDevStatusReqHeader::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoRaWANDevStatusReqHeader")
+    .SetParent<Header> ()
+    .SetGroupName ("LoRaWAN")
+    .AddConstructor<LoRaWANDevStatusReqHeader> ();
+  return tid;
+}
+
+TypeId
+LoRaWANDevStatusReqHeader::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+void
+LoRaWANDevStatusReqHeader::Print (std::ostream &os) const
+{
+  os << "DevStatusReq";
+}
+
+uint32_t
+LoRaWANDevStatusReqHeader::GetSerializedSize (void) const
+{
+  return 1;
+}
+
+void
+LoRaWANDevStatusReqHeader::Serialize (Buffer::Iterator start) const
+{
+  start.WriteU8 (LORAWAN_CID_DEV_STATUS);
+}
+
+uint32_t
+LoRaWANDevStatusReqHeader::Deserialize (Buffer::Iterator start)
+{
+  uint8_t cid = start.ReadU8 ();
+  if (cid != LORAWAN_CID_DEV_STATUS) {
+    NS_LOG_WARN (this << " Unexpected CID " << (uint32_t)cid << " for DevStatusReq");
+  }
+
+  return 1;
+}
+
+// ----------------------------------------------------------------------------------------------------------
+
+LoRaWANDevStatusAnsHeader::LoRaWANDevStatusAnsHeader () : m_battery(255), m_margin(0)
+{
+}
+
+LoRaWANDevStatusAnsHeader::LoRaWANDevStatusAnsHeader (uint8_t battery, int8_t margin) : m_battery(battery)
+{
+  SetMargin (margin);
+}
+
+LoRaWANDevStatusAnsHeader::~LoRaWANDevStatusAnsHeader ()
+{
+}
+
+uint8_t
+LoRaWANDevStatusAnsHeader::GetBattery (void) const
+{
+  return m_battery;
+}
+
+void
+LoRaWANDevStatusAnsHeader::SetBattery (uint8_t battery)
+{
+  m_battery = battery;
+}
+
+int8_t
+LoRaWANDevStatusAnsHeader::GetMargin (void) const
+{
+  return m_margin;
+}
+
+void
+LoRaWANDevStatusAnsHeader::SetMargin (int8_t margin)
+{
+  // The margin is a 6 bit signed integer
+  if (margin < -32)
+    m_margin = -32;
+  else if (margin > 31)
+    m_margin = 31;
+  else
+    m_margin = margin;
+}
+
+TypeId
+LoRaWANDevStatusAnsHeader::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoRaWANDevStatusAnsHeader")
+    .SetParent<Header> ()
+    .SetGroupName ("LoRaWAN")
+    .AddConstructor<LoRaWANDevStatusAnsHeader> ();
+  return tid;
+}
+
+TypeId
+LoRaWANDevStatusAnsHeader::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+void
+LoRaWANDevStatusAnsHeader::Print (std::ostream &os) const
+{
+  os << "DevStatusAns: Battery = " << (uint32_t)m_battery << ", Margin = " << (int32_t)m_margin;
+}
+
+uint32_t
+LoRaWANDevStatusAnsHeader::GetSerializedSize (void) const
+{
+  // CID (1 byte), Battery (1 byte) and Margin (1 byte)
+  return 3;
+}
+
+void
+LoRaWANDevStatusAnsHeader::Serialize (Buffer::Iterator start) const
+{
+  Buffer::Iterator i = start;
+  i.WriteU8 (LORAWAN_CID_DEV_STATUS);
+  i.WriteU8 (m_battery);
+  i.WriteU8 ((uint8_t)m_margin & 0x3F);
+}
+
+uint32_t
+LoRaWANDevStatusAnsHeader::Deserialize (Buffer::Iterator start)
+{
+  Buffer::Iterator i = start;
+
+  uint8_t cid = i.ReadU8 ();
+  if (cid != LORAWAN_CID_DEV_STATUS) {
+    NS_LOG_WARN (this << " Unexpected CID " << (uint32_t)cid << " for DevStatusAns");
+  }
+  m_battery = i.ReadU8 ();
+  uint8_t margin = i.ReadU8 () & 0x3F;
+  m_margin = (margin & 0x20) ? (int8_t)(margin | 0xC0) : (int8_t)margin; // sign extend
+
+  return 3;
+}
+
+}; // namespace ns-3
@@ -0,0 +1,255 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#ifndef LORAWAN_MAC_COMMAND_H
+#define LORAWAN_MAC_COMMAND_H
+
+#include <ns3/header.h>
+
+namespace ns3 {
+
+/**
+ * \ingroup lorawan
+ *
+ * LoRaWAN MAC command identifiers (CID) as per $5 in LoRaWAN spec
+ */
+typedef enum
+{
+  LORAWAN_CID_LINK_CHECK = 0x02,
+  LORAWAN_CID_LINK_ADR = 0x03,
+  LORAWAN_CID_DUTY_CYCLE = 0x04,
+  LORAWAN_CID_RX_PARAM_SETUP = 0x05,
+  LORAWAN_CID_DEV_STATUS = 0x06,
+} LoRaWANMacCommandCID;
+
+/**
+ * \ingroup lorawan
+ *
+ * The frame port of a FRMPayload that only contains MAC commands
+ */
+#define LORAWAN_MAC_COMMAND_FRAME_PORT 0
+
+/**
+ * \ingroup lorawan
+ *
+ * \param cid the CID of a MAC command
+ * \param downstream whether the command is sent by the network server (a
+ * request) or by the end device (an answer)
+ * \return the length of the MAC command including its CID, or 0 for an
+ * unsupported CID
+ */
+uint8_t LoRaWANGetMacCommandLength (uint8_t cid, bool downstream);
+
+/**
+ * \ingroup lorawan
+ * Represent the LinkADRReq MAC command ($5.2 in LoRaWAN spec), including its
+ * CID. A network server uses this command to change the data rate and TX
+ * power of an end device.
+ *
+ * A data rate or TX power of 0xF means that the end device should keep its
+ * current value.
+ */
+class LoRaWANLinkAdrReqHeader : public Header
+{
+public:
+  LoRaWANLinkAdrReqHeader (void);
+  LoRaWANLinkAdrReqHeader (uint8_t dataRateIndex, uint8_t txPowerIndex);
+  ~LoRaWANLinkAdrReqHeader (void);
+
+  uint8_t GetDataRateIndex (void) const;
+  void SetDataRateIndex (uint8_t dataRateIndex);
+
+  /**
+   * \return the TX power index, see LoRaWANMac::SetTxPowerIndex
+   */
+  uint8_t GetTxPowerIndex (void) const;
+  void SetTxPowerIndex (uint8_t txPowerIndex);
+
+  uint16_t GetChMask (void) const;
+  void SetChMask (uint16_t chMask);
+
+  uint8_t GetChMaskCntl (void) const;
+  void SetChMaskCntl (uint8_t chMaskCntl);
+
+  uint8_t GetNbRep (void) const;
+  void SetNbRep (uint8_t nbRep);
+
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+
+  void Print (std::ostream &os) const;
+  uint32_t GetSerializedSize (void) const;
+  void Serialize (Buffer::Iterator start) const;
+  uint32_t Deserialize (Buffer::Iterator start);
+
+private:
+  uint8_t m_dataRateIndex;
+  uint8_t m_txPowerIndex;
+  uint16_t m_chMask;
+  uint8_t m_chMaskCntl;
+  uint8_t m_nbRep;
+}; //LoRaWANLinkAdrReqHeader
+
+/**
+ * \ingroup lorawan
+ * Represent the DutyCycleReq MAC command ($5.3 in LoRaWAN spec), including its
+ * CID. A network server uses this command to limit the aggregated duty cycle
+ * of an end device to 1/2^MaxDCycle, a MaxDCycle of 0 removes the limit.
+ */
+class LoRaWANDutyCycleReqHeader : public Header
+{
+public:
+  LoRaWANDutyCycleReqHeader (void);
+  LoRaWANDutyCycleReqHeader (uint8_t maxDutyCycle);
+  ~LoRaWANDutyCycleReqHeader (void);
+
+  uint8_t GetMaxDutyCycle (void) const;
+  void SetMaxDutyCycle (uint8_t maxDutyCycle);
+
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+
+  void Print (std::ostream &os) const;
+  uint32_t GetSerializedSize (void) const;
+  void Serialize (Buffer::Iterator start) const;
+  uint32_t Deserialize (Buffer::Iterator start);
+
+private:
+  uint8_t m_maxDutyCycle;
+}; //LoRaWANDutyCycleReqHeader
+
+/**
+ * \ingroup lorawan
+ * Represent the RXParamSetupReq MAC command ($5.4 in LoRaWAN spec), including
+ * its CID. A network server uses this command to change the RX1DROffset and
+ * the data rate and frequency of the second receive window of an end device.
+ */
+class LoRaWANRxParamSetupReqHeader : public Header
+{
+public:
+  LoRaWANRxParamSetupReqHeader (void);
+  LoRaWANRxParamSetupReqHeader (uint8_t rx1DROffset, uint8_t rx2DataRateIndex, uint32_t frequency);
+  ~LoRaWANRxParamSetupReqHeader (void);
+
+  uint8_t GetRx1DROffset (void) const;
+  void SetRx1DROffset (uint8_t rx1DROffset);
+
+  uint8_t GetRx2DataRateIndex (void) const;
+  void SetRx2DataRateIndex (uint8_t rx2DataRateIndex);
+
+  /**
+   * \return the frequency of the second receive window in Hz
+   */
+  uint32_t GetFrequency (void) const;
+  void SetFrequency (uint32_t frequency);
+
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+
+  void Print (std::ostream &os) const;
+  uint32_t GetSerializedSize (void) const;
+  void Serialize (Buffer::Iterator start) const;
+  uint32_t Deserialize (Buffer::Iterator start);
+
+private:
+  uint8_t m_rx1DROffset;
+  uint8_t m_rx2DataRateIndex;
+  uint32_t m_frequency;
+}; //LoRaWANRxParamSetupReqHeader
+
+/**
+ * \ingroup lorawan
+ * Represent the DevStatusReq MAC command ($5.5 in LoRaWAN spec), which only
+ * consists of its CID. A network server uses this command to request the
+ * battery level and the demodulation margin of an end device.
+ */
+class LoRaWANDevStatusReqHeader : public Header
+{
+public:
+  LoRaWANDevStatusReqHeader (void);
+  ~LoRaWANDevStatusReqHeader (void);
+
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+
+  void Print (std::ostream &os) const;
+  uint32_t GetSerializedSize (void) const;
+  void Serialize (Buffer::Iterator start) const;
+  uint32_t Deserialize (Buffer::Iterator start);
+}; //LoRaWANDevStatusReqHeader
+
+/**
+ * \ingroup lorawan
+ * Represent the DevStatusAns MAC command ($5.5 in LoRaWAN spec), including its
+ * CID.
+ *
+ * A battery level of 0 means that the end device is connected to an external
+ * power source and 255 means that the end device could not measure its
+ * battery level. The margin is the SNR in dB of the last received
+ * DevStatusReq, clipped to [-32, 31].
+ */
+class LoRaWANDevStatusAnsHeader : public Header
+{
+public:
+  LoRaWANDevStatusAnsHeader (void);
+  LoRaWANDevStatusAnsHeader (uint8_t battery, int8_t margin);
+  ~LoRaWANDevStatusAnsHeader (void);
+
+  uint8_t GetBattery (void) const;
+  void SetBattery (uint8_t battery);
+
+  int8_t GetMargin (void) const;
+  void SetMargin (int8_t margin);
+
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+
+  void Print (std::ostream &os) const;
+  uint32_t GetSerializedSize (void) const;
+  void Serialize (Buffer::Iterator start) const;
+  uint32_t Deserialize (Buffer::Iterator start);
+
+private:
+  uint8_t m_battery;
+  int8_t m_margin;
+}; //LoRaWANDevStatusAnsHeader
+
+}; // namespace ns-3
+
+#endif /* LORAWAN_MAC_COMMAND_H */
@@ -133,13 +133,13 @@ LoRaWANMacHeader::IsConfirmed () const
 bool
 LoRaWANMacHeader::IsDownstream() const
 {
-  return (m_msgType == LORAWAN_UNCONFIRMED_DATA_DOWN || m_msgType == LORAWAN_CONFIRMED_DATA_DOWN);
+  return (m_msgType == LORAWAN_UNCONFIRMED_DATA_DOWN || m_msgType == LORAWAN_CONFIRMED_DATA_DOWN || m_msgType == LORAWAN_JOIN_ACCEPT);
 }
 
 bool
 LoRaWANMacHeader::IsUpstream() const
 {
-  return (m_msgType == LORAWAN_CONFIRMED_DATA_UP || m_msgType == LORAWAN_UNCONFIRMED_DATA_UP);
+  return (m_msgType == LORAWAN_CONFIRMED_DATA_UP || m_msgType == LORAWAN_UNCONFIRMED_DATA_UP || m_msgType == LORAWAN_JOIN_REQUEST);
 }
 
 // ----------------------------------------------------------------------------------------------------------
@@ -22,11 +22,15 @@
 #include "lorawan-mac-header.h"
 #include "lorawan-net-device.h"
 #include "lorawan-frame-header.h"
+#include "lorawan-adr.h"
 #include <ns3/simulator.h>
 #include <ns3/log.h>
 #include <ns3/packet.h>
 #include <ns3/random-variable-stream.h>
 #include <ns3/double.h>
+#include <ns3/uinteger.h>
+#include <ns3/enum.h>
+#include <ns3/boolean.h>
 
 namespace ns3 {
 
@@ -34,7 +38,6 @@ NS_LOG_COMPONENT_DEFINE ("LoRaWANMac");
 
 NS_OBJECT_ENSURE_REGISTERED (LoRaWANMac);
 
-const uint8_t LoRaWANMac::maxMACPayloadSize[] = {59, 59, 59, 123, 230, 230, 230}; // we don't take the FSK row (for DR7) into account
 
 std::ostream&
 operator<< (std::ostream& os, const LoRaWANDataRequestParams& p)
@@ -58,6 +61,28 @@ LoRaWANMac::GetTypeId (void)
     .SetParent<Object> ()
     .SetGroupName ("LoRaWAN")
     .AddConstructor<LoRaWANMac> ()
+    .AddAttribute ("MaxTxQueueSize",
+                   "The maximum number of packets in the TX queue, zero means unlimited.",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&LoRaWANMac::m_maxTxQueueSize),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("TxQueueDropPolicy",
+                   "What to drop when a packet is requested while the TX queue is full.",
+                   EnumValue (LORAWAN_QUEUE_DROP_TAIL),
+                   MakeEnumAccessor (&LoRaWANMac::m_txQueueDropPolicy),
+                   MakeEnumChecker (LORAWAN_QUEUE_DROP_TAIL, "DropTail",
+                                    LORAWAN_QUEUE_DROP_HEAD, "DropHead"))
+    .AddAttribute ("Crypto",
+                   "Compute and verify the MIC and encrypt the FRMPayload of data frames of end devices, "
+                   "and the MIC of JoinRequests and JoinAccepts. False sends frames with a zero MIC and the "
+                   "FRMPayload in clear, e.g. for radio studies.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&LoRaWANMac::m_crypto),
+                   MakeBooleanChecker ())
+    .AddTraceSource ("TxQueueSize",
+                     "The number of packets in the TX queue",
+                     MakeTraceSourceAccessor (&LoRaWANMac::m_txQueueSize),
+                     "ns3::TracedValueCallback::Uint32")
     .AddTraceSource ("MacTxEnqueue",
                      "Trace source indicating a packet has been "
                      "enqueued in the transaction queue",
@@ -141,10 +166,19 @@ LoRaWANMac::LoRaWANMac (uint8_t index) : m_index (index)
 
   m_deviceType = LORAWAN_DT_END_DEVICE_CLASS_A;
   m_RX1DROffset = 0; // default value is zero
+  m_txPowerIndex = 0; // maximum power
 
   // m_macPromiscuousMode = false;
   m_retransmission = 0;
   m_txPkt = 0;
+  m_lastUplinkJoinRequest = false;
+  m_maxTxQueueSize = 0;
+  m_txQueueDropPolicy = LORAWAN_QUEUE_DROP_TAIL;
+  m_txQueueSize = 0;
+  m_nTxQueueDrops = 0;
+  m_crypto = false;
+  m_sessionKeysSet = false;
+  m_nMicFailures = 0;
 
   m_ackTimeOutRandomVariable = CreateObject<UniformRandomVariable> ();
 }
@@ -184,6 +218,13 @@ LoRaWANMac::sendTRXStateRequestForIdleMAC ()
 {
   if (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_A) {
       m_phy->SetTRXStateRequest (LORAWAN_PHY_TRX_OFF);
+  } else if (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_C) {
+      // Class C: keep on listening in RW2 in between uplinks, a frame that is
+      // being received (e.g. when the Ack timeout expires) is not interrupted
+      if (m_phy->preambleDetected ())
+        return;
+      if (ConfigurePhyForRW2 ())
+        m_phy->SetTRXStateRequest (LORAWAN_PHY_RX_ON);
   } else if (m_deviceType == LORAWAN_DT_GATEWAY) {
       m_phy->SetTRXStateRequest (LORAWAN_PHY_RX_ON);
   }
@@ -193,12 +234,8 @@ void
 LoRaWANMac::DoDispose ()
 {
   m_txPkt = 0;
-  for (uint32_t i = 0; i < m_txQueue.size (); i++)
-    {
-      m_txQueue[i]->txQPkt = 0;
-      delete m_txQueue[i];
-    }
-  m_txQueue.clear ();
+  m_txQueue.Clear ();
+  m_txQueueSize = 0;
   m_phy = 0;
   m_dataIndicationCallback = MakeNullCallback< void, LoRaWANDataIndicationParams, Ptr<Packet> > ();
   m_dataConfirmCallback = MakeNullCallback< void, LoRaWANDataConfirmParams > ();
@@ -216,6 +253,46 @@ void
 LoRaWANMac::SetDevAddr (Ipv4Address devAddr)
 {
   m_devAddr = devAddr;
+  if (!m_sessionKeysSet)
+    LoRaWANCrypto::DeriveDefaultSessionKeys (devAddr.Get (), m_nwkSKey, m_appSKey);
+}
+
+void
+LoRaWANMac::SetSessionKeys (const LoRaWANKey &nwkSKey, const LoRaWANKey &appSKey)
+{
+  m_nwkSKey = nwkSKey;
+  m_appSKey = appSKey;
+  m_sessionKeysSet = true;
+}
+
+const LoRaWANKey &
+LoRaWANMac::GetNwkSKey (void) const
+{
+  return m_nwkSKey;
+}
+
+const LoRaWANKey &
+LoRaWANMac::GetAppSKey (void) const
+{
+  return m_appSKey;
+}
+
+void
+LoRaWANMac::SetAppKey (const LoRaWANKey &appKey)
+{
+  m_appKey = appKey;
+}
+
+const LoRaWANKey &
+LoRaWANMac::GetAppKey (void) const
+{
+  return m_appKey;
+}
+
+uint32_t
+LoRaWANMac::GetMicFailures (void) const
+{
+  return m_nMicFailures;
 }
 
 LoRaWANDeviceType
@@ -251,6 +328,46 @@ LoRaWANMac::SetRX1DROffset (uint8_t offset)
     NS_LOG_WARN (this << "Invalid RX1DROffset: " << static_cast<uint32_t>(offset));
 }
 
+void
+LoRaWANMac::SetMaxDutyCycle (uint8_t maxDutyCycle)
+{
+  if (maxDutyCycle <= 15)
+    m_lorawanMacRDC->SetAggregatedDutyCycleLimit (1 << maxDutyCycle);
+  else
+    NS_LOG_WARN (this << "Invalid MaxDCycle: " << static_cast<uint32_t>(maxDutyCycle));
+}
+
+uint8_t
+LoRaWANMac::GetMaxDutyCycle (void) const
+{
+  uint8_t maxDutyCycle = 0;
+  while ((1 << maxDutyCycle) < m_lorawanMacRDC->GetAggregatedDutyCycleLimit ())
+    maxDutyCycle++;
+  return maxDutyCycle;
+}
+
+uint8_t
+LoRaWANMac::GetMaxMACPayloadSize (uint8_t dataRateIndex)
+{
+  NS_ASSERT (dataRateIndex < LoRaWAN::m_supportedDataRates.size ());
+  return LoRaWAN::m_supportedDataRates[dataRateIndex].maxMACPayloadSize;
+}
+
+uint8_t
+LoRaWANMac::GetTxPowerIndex (void) const
+{
+  return m_txPowerIndex;
+}
+
+void
+LoRaWANMac::SetTxPowerIndex (uint8_t index)
+{
+  if (index <= LoRaWAN::GetRegionProfile (LoRaWAN::GetRegion ()).m_maxTxPowerIndex)
+    this->m_txPowerIndex = index;
+  else
+    NS_LOG_WARN (this << "Invalid TX power index: " << static_cast<uint32_t>(index));
+}
+
 void
 LoRaWANMac::SetLoRaWANMacState (LoRaWANMacState macState)
 {
@@ -282,6 +399,13 @@ LoRaWANMac::SetLoRaWANMacState (LoRaWANMacState macState)
         this->m_beginTxCallback (this);
       }
 
+      // A Class C end device can not receive while it transmits, so an
+      // ongoing reception in RW2 is aborted
+      if (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_C && m_phy->preambleDetected ()) {
+        NS_LOG_DEBUG (this << " Aborting reception to transmit");
+        m_phy->SetTRXStateRequest (LORAWAN_PHY_FORCE_TRX_OFF);
+      }
+
       ChangeMacState (macState);
 
       if (ConfigurePhyForTX ()) {
@@ -290,6 +414,25 @@ LoRaWANMac::SetLoRaWANMacState (LoRaWANMacState macState)
 
         // Wait for a state confirmation via SetTRXStateConfirm before starting transmission
         //StartTransmission ();
+      } else if (m_txPkt != 0) {
+        // The packet can not be sent with this configuration, drop it
+        // instead of leaving the MAC in MAC_TX
+        NS_LOG_WARN (this << " Dropping packet that the PHY can not be configured for");
+        TxQueueElement &txQElement = m_txQueue.Front ();
+        m_macTxDropTrace (txQElement.txQPkt);
+        if (!m_dataConfirmCallback.IsNull ()) {
+          LoRaWANDataConfirmParams confirmParams;
+          confirmParams.m_requestHandle = txQElement.lorawanDataRequestParams.m_requestHandle;
+          confirmParams.m_status = LORAWAN_INVALID_PARAMETER;
+          m_dataConfirmCallback (confirmParams);
+        }
+        RemoveFirstTxQElement (false);
+
+        m_setMacState = Simulator::ScheduleNow (&LoRaWANMac::SetLoRaWANMacState, this, MAC_IDLE);
+        if (m_deviceType == LORAWAN_DT_GATEWAY) {
+          NS_ASSERT (!this->m_endTxCallback.IsNull ());
+          this->m_endTxCallback (this);
+        }
       }
   } else if (macState == MAC_WAITFORRW1) {
       NS_ASSERT (m_LoRaWANMacState == MAC_TX);
@@ -300,7 +443,7 @@ LoRaWANMac::SetLoRaWANMacState (LoRaWANMacState macState)
       m_phy->SetTRXStateRequest (LORAWAN_PHY_IDLE);
 
       // schedule a MAC event to open RW1
-      Time receiveDelay = MicroSeconds (RECEIVE_DELAY1);
+      Time receiveDelay = MicroSeconds (m_lastUplinkJoinRequest ? JOIN_ACCEPT_DELAY1 : RECEIVE_DELAY1);
       m_setMacState = Simulator::Schedule (receiveDelay, &LoRaWANMac::SetLoRaWANMacState, this, MAC_RW1);
   } else if (macState == MAC_RW1) {
       NS_ASSERT (m_LoRaWANMacState == MAC_WAITFORRW1);
@@ -317,7 +460,7 @@ LoRaWANMac::SetLoRaWANMacState (LoRaWANMacState macState)
 
       // schedule a MAC event to open RW2
       // RW2 starts RECEIVE_DELAY2 after the end of the uplink modulation
-      Time receiveDelay = (m_lastUplinkBitTime + MicroSeconds (RECEIVE_DELAY2)) - Simulator::Now ();
+      Time receiveDelay = (m_lastUplinkBitTime + MicroSeconds (m_lastUplinkJoinRequest ? JOIN_ACCEPT_DELAY2 : RECEIVE_DELAY2)) - Simulator::Now ();
       if (receiveDelay >= 0)
         m_setMacState = Simulator::Schedule (receiveDelay, &LoRaWANMac::SetLoRaWANMacState, this, MAC_RW2);
       else {
@@ -410,7 +553,7 @@ LoRaWANMac::PdDataDestroyed (void)
 {
   NS_LOG_FUNCTION (this);
 
-  if (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_A) { // end device started receiving a frame in its RW, but the frame was destroyed => always close RW
+  if (m_deviceType != LORAWAN_DT_GATEWAY && (m_LoRaWANMacState == MAC_RW1 || m_LoRaWANMacState == MAC_RW2)) { // end device started receiving a frame in its RW, but the frame was destroyed => always close RW
       CloseRW ();
   }
 }
@@ -422,6 +565,8 @@ LoRaWANMac::PdDataIndication (uint32_t phyPayloadLength, Ptr<Packet> p, uint8_t
   //
   if (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_A) {
     NS_ASSERT (m_LoRaWANMacState == MAC_RW1 || m_LoRaWANMacState == MAC_RW2); // gateway would be in MAC_IDLE, class A in either RW1 or RW2
+  } else if (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_C) {
+    NS_ASSERT (m_LoRaWANMacState == MAC_RW1 || m_LoRaWANMacState == MAC_RW2 || m_LoRaWANMacState == MAC_IDLE || m_LoRaWANMacState == MAC_ACK_TIMEOUT); // class C also receives in between uplinks
   } else if (m_deviceType == LORAWAN_DT_GATEWAY) {
     NS_ASSERT (m_LoRaWANMacState == MAC_IDLE);
   }  else {
@@ -442,13 +587,30 @@ LoRaWANMac::PdDataIndication (uint32_t phyPayloadLength, Ptr<Packet> p, uint8_t
 
   bool acceptFrame = true;
 
+  // An end device drops the DS data frames of other end devices based on the
+  // first bytes of the frame (MAC header and DevAddr), without copying and
+  // parsing it. This keeps the receive path cheap when many Class C end
+  // devices listen on the RW2 channel.
+  if (m_deviceType != LORAWAN_DT_GATEWAY && p->GetSize () >= 5) {
+    uint8_t bytes[5];
+    p->CopyData (bytes, 5);
+    const uint8_t msgType = bytes[0] >> 5;
+    const uint32_t devAddr = bytes[1] | (bytes[2] << 8) | (bytes[3] << 16) | ((uint32_t)bytes[4] << 24);
+    if ((msgType == LORAWAN_UNCONFIRMED_DATA_DOWN || msgType == LORAWAN_CONFIRMED_DATA_DOWN) && devAddr != m_devAddr.Get ()) {
+      m_macRxDropTrace (p);
+      if (m_LoRaWANMacState == MAC_RW1 || m_LoRaWANMacState == MAC_RW2)
+        CloseRW ();
+      return;
+    }
+  }
+
   Ptr<Packet> pktCopy = p->Copy (); // don't alter the original packet when removing headers
   LoRaWANMacHeader macHdr;
   pktCopy->RemoveHeader (macHdr);
 
   // Check MAC:
   // 1) Header: msg type
-  if (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_A) { // Class A only accepts downstream
+  if (m_deviceType != LORAWAN_DT_GATEWAY) { // End devices only accept downstream
     if (!macHdr.IsDownstream ()) {
       acceptFrame = false;
     }
@@ -461,36 +623,90 @@ LoRaWANMac::PdDataIndication (uint32_t phyPayloadLength, Ptr<Packet> p, uint8_t
     NS_FATAL_ERROR ( this << " Invalid device type " << m_deviceType);
     return;
   }
-  // 2) MIC: ignore, no encryption at the moment
+  // 2) MIC: the MIC of US frames is verified by the network server, an end
+  // device verifies the MIC of DS data frames and JoinAccepts below
   // Remove MIC from footer of frame:
-  uint32_t MIC = 0;
+  uint8_t frame[LORAWAN_MAX_PHY_PAYLOAD_SIZE];
+  const uint32_t frameSize = p->GetSize ();
+  if (frameSize < 5 || frameSize > sizeof (frame)) {
+    NS_LOG_ERROR (this << " Invalid PHYPayload size " << frameSize);
+    m_macRxDropTrace (p);
+    if (m_deviceType != LORAWAN_DT_GATEWAY && (m_LoRaWANMacState == MAC_RW1 || m_LoRaWANMacState == MAC_RW2))
+      CloseRW ();
+    return;
+  }
+  p->CopyData (frame, frameSize);
+  const uint8_t *micBytes = frame + frameSize - 4;
+  uint32_t MIC = micBytes[0] | (micBytes[1] << 8) | (micBytes[2] << 16) | ((uint32_t)micBytes[3] << 24);
   pktCopy->RemoveAtEnd (4);
 
+  // Join messages do not have a FHDR
+  const bool joinMessage = macHdr.getLoRaWANMsgType () == LORAWAN_JOIN_REQUEST || macHdr.getLoRaWANMsgType () == LORAWAN_JOIN_ACCEPT;
   LoRaWANFrameHeader frameHdr;
-  pktCopy->PeekHeader (frameHdr);
+  if (!joinMessage)
+    pktCopy->PeekHeader (frameHdr);
   // For end devices check FHDR:
   if (m_deviceType != LORAWAN_DT_GATEWAY) {
-    // 1) DevAddr
-    if (m_devAddr != frameHdr.getDevAddr ())
+    if (joinMessage) {
+      // A JoinAccept is only expected in the RWs after a JoinRequest
+      if (macHdr.getLoRaWANMsgType () != LORAWAN_JOIN_ACCEPT || !m_lastUplinkJoinRequest
+          || (m_LoRaWANMacState != MAC_RW1 && m_LoRaWANMacState != MAC_RW2))
+        acceptFrame = false;
+    } else {
+      // 1) DevAddr
+      if (m_devAddr != frameHdr.getDevAddr ())
+        acceptFrame = false;
+      // 2) Frame counter?
+    }
+  }
+
+  // An end device verifies the MIC of a DS data frame and decrypts its
+  // FRMPayload, the MHDR and MACPayload are frame[0, frameSize - 4)
+  if (acceptFrame && m_crypto && m_deviceType != LORAWAN_DT_GATEWAY && !joinMessage) {
+    if (frameSize < 12 || LoRaWANCrypto::ComputeFrameMic (m_nwkSKey, false, frame, frameSize - 4) != MIC) {
+      NS_LOG_INFO (this << " Dropping DS frame with an invalid MIC");
+      m_nMicFailures++;
+      acceptFrame = false;
+    } else {
+      const uint32_t offset = LoRaWANCrypto::CryptFrame (m_nwkSKey, m_appSKey, false, frame, frameSize - 4);
+      LoRaWANCrypto::SetPacketTail (pktCopy, frame + offset, frameSize - 4 - offset);
+    }
+  } else if (acceptFrame && m_crypto && m_deviceType != LORAWAN_DT_GATEWAY) {
+    // A JoinAccept is encrypted together with its MIC. The end device
+    // recognizes the JoinAccept that answers its JoinRequest by the MIC, the
+    // JoinAccepts of other end devices do not match its AppKey.
+    bool validMic = (frameSize - 1) % 16 == 0;
+    if (validMic) {
+      LoRaWANCrypto::DecryptJoinAccept (m_appKey, frame, frameSize);
+      MIC = micBytes[0] | (micBytes[1] << 8) | (micBytes[2] << 16) | ((uint32_t)micBytes[3] << 24);
+      validMic = LoRaWANCrypto::ComputeJoinMic (m_appKey, frame, frameSize - 4) == MIC;
+    }
+    if (!validMic) {
+      NS_LOG_INFO (this << " Dropping JoinAccept with an invalid MIC");
+      m_nMicFailures++;
       acceptFrame = false;
-    // 2) Frame counter?
+    } else {
+      LoRaWANCrypto::SetPacketTail (pktCopy, frame + 1, frameSize - 5);
+    }
   }
 
   if (acceptFrame) {
     m_macRxTrace (p);
-    if (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_A) {
+    if (m_deviceType != LORAWAN_DT_GATEWAY) {
       // Check Ack bit (?) -> for class A, can remove frame that is pending in TX queue
       // Class A: check FPending bit (?) -> should schedule a new TX op soon
       // Class A: we are freed from waiting on RW2.
-      if (frameHdr.IsAck ()) { // process Ack for Class A device
+      bool ackReceived = false;
+      if (frameHdr.IsAck ()) { // process Ack for end device
         if (m_txPkt != 0) {
+          ackReceived = true;
           m_macTxOkTrace (m_txPkt);
           m_ackTimeOut.Cancel ();
           if (!m_dataConfirmCallback.IsNull ())
           { // Call callback, informing succesfull delivery of frame
-              TxQueueElement *txQElement = m_txQueue.front ();
+              TxQueueElement &txQElement = m_txQueue.Front ();
               LoRaWANDataConfirmParams confirmParams;
-              confirmParams.m_requestHandle = txQElement->lorawanDataRequestParams.m_requestHandle;
+              confirmParams.m_requestHandle = txQElement.lorawanDataRequestParams.m_requestHandle;
               confirmParams.m_status = LORAWAN_SUCCESS;
               m_dataConfirmCallback (confirmParams);
           }
@@ -503,9 +719,17 @@ LoRaWANMac::PdDataIndication (uint32_t phyPayloadLength, Ptr<Packet> p, uint8_t
         }
       }
 
-      // Update MAC state from RW1 or RW2 to IDLE, this will set the Phy TRX state to OFF
-      m_setMacState.Cancel ();
-      m_setMacState = Simulator::ScheduleNow (&LoRaWANMac::SetLoRaWANMacState, this, MAC_IDLE);
+      // Update MAC state from RW1 or RW2 to IDLE, this will set the Phy TRX
+      // state to OFF for Class A. A Class C end device that receives a frame
+      // in between uplinks remains idle, unless the frame Acks its uplink.
+      if (m_LoRaWANMacState == MAC_RW1 || m_LoRaWANMacState == MAC_RW2 || (m_LoRaWANMacState == MAC_ACK_TIMEOUT && ackReceived)) {
+        m_setMacState.Cancel ();
+        m_setMacState = Simulator::ScheduleNow (&LoRaWANMac::SetLoRaWANMacState, this, MAC_IDLE);
+      } else if (m_LoRaWANMacState == MAC_IDLE && ackReceived) {
+        // A retransmission of the Acked frame may have been scheduled
+        m_setMacState.Cancel ();
+        CheckQueue ();
+      }
     } else if (m_deviceType == LORAWAN_DT_GATEWAY) {
       // MAC state does not change (remains IDLE),
       // When Phy reaches EndRx it will switch its state to RX_ON, which is fine for the gateway
@@ -528,7 +752,7 @@ LoRaWANMac::PdDataIndication (uint32_t phyPayloadLength, Ptr<Packet> p, uint8_t
     }
   } else {
     m_macRxDropTrace (p);
-    if (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_A) { // An end device received a frame in its RW, but the frame was not destined to this end device
+    if (m_deviceType != LORAWAN_DT_GATEWAY && (m_LoRaWANMacState == MAC_RW1 || m_LoRaWANMacState == MAC_RW2)) { // An end device received a frame in its RW, but the frame was not destined to this end device
       // Just close the receive window
       CloseRW ();
     }
@@ -557,9 +781,9 @@ LoRaWANMac::SetTRXStateConfirm (LoRaWANPhyEnumeration status)
       Ptr<Packet> p = m_txPkt;
 
       // Get airtime for TX of PHY frame and update RDC
-      TxQueueElement *txQElement = m_txQueue.front ();
+      TxQueueElement &txQElement = m_txQueue.Front ();
       Time airTime = m_phy->CalculateTxTime (p->GetSize ()); // which PHY does not matter here
-      uint8_t subBandIndex = LoRaWAN::m_supportedChannels [txQElement->lorawanDataRequestParams.m_loraWANChannelIndex].m_subBandIndex;
+      uint8_t subBandIndex = LoRaWAN::m_supportedChannels [txQElement.lorawanDataRequestParams.m_loraWANChannelIndex].m_subBandIndex;
       m_lorawanMacRDC->UpdateRDCTimerForSubBand (subBandIndex, airTime);
 
       // Ask Phy to send Phy payload
@@ -581,8 +805,8 @@ LoRaWANMac::SetTRXStateConfirm (LoRaWANPhyEnumeration status)
     }
   else if (m_LoRaWANMacState == MAC_ACK_TIMEOUT)
     {
-      // When MAC is in the ACK_TIMEOUT state, then the Phy should be OFF
-      NS_ASSERT (status == LORAWAN_PHY_TRX_OFF);
+      // When MAC is in the ACK_TIMEOUT state, then the Phy should be OFF (Class A) or listening in RW2 (Class C)
+      NS_ASSERT (status == LORAWAN_PHY_TRX_OFF || (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_C && status == LORAWAN_PHY_RX_ON));
     }
   else if (m_LoRaWANMacState == MAC_UNAVAILABLE)
     {
@@ -602,7 +826,7 @@ LoRaWANMac::PdDataConfirm (LoRaWANPhyEnumeration status)
 {
   NS_ASSERT (m_LoRaWANMacState == MAC_TX);
 
-  NS_LOG_FUNCTION (this << status << m_txQueue.size ());
+  NS_LOG_FUNCTION (this << status << m_txQueue.GetSize ());
 
   NS_ASSERT (m_txPkt);
   LoRaWANMacHeader macHdr;
@@ -614,8 +838,8 @@ LoRaWANMac::PdDataConfirm (LoRaWANPhyEnumeration status)
 
   if (status == LORAWAN_PHY_SUCCESS)
     {
-      NS_ASSERT_MSG (m_txQueue.size () > 0, "TxQsize = 0");
-      TxQueueElement *txQElement = m_txQueue.front ();
+      NS_ASSERT_MSG (m_txQueue.GetSize () > 0, "TxQsize = 0");
+      TxQueueElement &txQElement = m_txQueue.Front ();
       // As no Ack is comming, notify upper layer that packet was sent and check if packet can be removed from queue
       if (!macHdr.IsConfirmed ())
       {
@@ -623,26 +847,26 @@ LoRaWANMac::PdDataConfirm (LoRaWANPhyEnumeration status)
         if (!m_dataConfirmCallback.IsNull ())
           {
             LoRaWANDataConfirmParams confirmParams;
-            confirmParams.m_requestHandle = txQElement->lorawanDataRequestParams.m_requestHandle;
+            confirmParams.m_requestHandle = txQElement.lorawanDataRequestParams.m_requestHandle;
             confirmParams.m_status = LORAWAN_SUCCESS;
             m_dataConfirmCallback (confirmParams);
           }
 
         // Reduce number of transmissions by one
-        txQElement->lorawanDataRequestParams.m_numberOfTransmissions--;
+        txQElement.lorawanDataRequestParams.m_numberOfTransmissions--;
 
         // Check if we can remove the packet from the queue
-        if (txQElement->lorawanDataRequestParams.m_numberOfTransmissions == 0) {
+        if (txQElement.lorawanDataRequestParams.m_numberOfTransmissions == 0) {
           // UNC packet has reached 0 tx attempts, so we can remove it from our queue
           NS_LOG_DEBUG (this << " UNC packet reached zero transmissions, removing packet from queue.");
           RemoveFirstTxQElement (true);
         }
       } else {
-        if (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_A) {
+        if (m_deviceType != LORAWAN_DT_GATEWAY) {
           // For confirmed messages, decrease the number of transmissions
-          NS_ASSERT (txQElement->lorawanDataRequestParams.m_numberOfTransmissions > 0);
-          NS_LOG_DEBUG( this << " Decreasing number of transmission for packet from " << static_cast<int> (txQElement->lorawanDataRequestParams.m_numberOfTransmissions) << " to " << static_cast<int> (txQElement->lorawanDataRequestParams.m_numberOfTransmissions) - 1);
-          txQElement->lorawanDataRequestParams.m_numberOfTransmissions--;
+          NS_ASSERT (txQElement.lorawanDataRequestParams.m_numberOfTransmissions > 0);
+          NS_LOG_DEBUG( this << " Decreasing number of transmission for packet from " << static_cast<int> (txQElement.lorawanDataRequestParams.m_numberOfTransmissions) << " to " << static_cast<int> (txQElement.lorawanDataRequestParams.m_numberOfTransmissions) - 1);
+          txQElement.lorawanDataRequestParams.m_numberOfTransmissions--;
         } else if (m_deviceType == LORAWAN_DT_GATEWAY) {
           // As retransmissions are handled by the network server, it does not make sense to keep the packet in the queue on this gateway MAC
           RemoveFirstTxQElement (true);
@@ -653,9 +877,10 @@ LoRaWANMac::PdDataConfirm (LoRaWANPhyEnumeration status)
       }
 
       // Update MAC and PHY state: depending on device class go to either WAITFORRW1 or directly to IDLE
-      if (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_A) { // always go to WAITFORRW1 for Class A
+      if (m_deviceType != LORAWAN_DT_GATEWAY) { // always go to WAITFORRW1 for Class A and Class C
         // Note that the Ack timeout timer will only start running at the beginning of RW2
         m_lastUplinkBitTime = Simulator::Now ();
+        m_lastUplinkJoinRequest = macHdr.getLoRaWANMsgType () == LORAWAN_JOIN_REQUEST;
         m_setMacState = Simulator::ScheduleNow (&LoRaWANMac::SetLoRaWANMacState, this, MAC_WAITFORRW1);
       } else if (m_deviceType == LORAWAN_DT_GATEWAY) { // Gateway
         // Always go to IDLE state for gateway, retransmissions are handled by the network server
@@ -691,9 +916,9 @@ LoRaWANMac::sendMACPayloadRequest (LoRaWANDataRequestParams params, Ptr<Packet>
   //}
 
   // TODO: inform upper layers via DataConfirmCallback
-  // For now Join request/Join Accept messages are not supported
-  if (!(params.m_msgType == LORAWAN_UNCONFIRMED_DATA_UP || params.m_msgType == LORAWAN_UNCONFIRMED_DATA_DOWN || params.m_msgType == LORAWAN_CONFIRMED_DATA_UP || params.m_msgType == LORAWAN_CONFIRMED_DATA_DOWN) ) {
-    // We only know how to send (un)confirmed data up or down
+  if (!(params.m_msgType == LORAWAN_UNCONFIRMED_DATA_UP || params.m_msgType == LORAWAN_UNCONFIRMED_DATA_DOWN || params.m_msgType == LORAWAN_CONFIRMED_DATA_UP || params.m_msgType == LORAWAN_CONFIRMED_DATA_DOWN
+        || params.m_msgType == LORAWAN_JOIN_REQUEST || params.m_msgType == LORAWAN_JOIN_ACCEPT) ) {
+    // We only know how to send (un)confirmed data up or down and join messages
     NS_LOG_ERROR (this << " unsupported LoRaWAN Message type: " << params.m_msgType);
     return;
   }
@@ -717,17 +942,17 @@ LoRaWANMac::sendMACPayloadRequest (LoRaWANDataRequestParams params, Ptr<Packet>
       }
     }
   } else {
-      params.m_numberOfTransmissions = 1; // DS UNC is always 1 tx
+      params.m_numberOfTransmissions = 1; // DS UNC and join messages are always 1 tx, join retries are handled by the application
   }
 
   // Gateways may send downstream, end devices only send upstream data
   if (m_deviceType == LORAWAN_DT_GATEWAY) {
-    if (!(params.m_msgType == LORAWAN_CONFIRMED_DATA_DOWN || params.m_msgType == LORAWAN_UNCONFIRMED_DATA_DOWN) ) {
+    if (!(params.m_msgType == LORAWAN_CONFIRMED_DATA_DOWN || params.m_msgType == LORAWAN_UNCONFIRMED_DATA_DOWN || params.m_msgType == LORAWAN_JOIN_ACCEPT) ) {
       NS_LOG_ERROR (this << " Gateway only supports downstream data, requested LoRaWAN Message type: " << params.m_msgType);
       return;
     }
-  } else if (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_A) {
-    if (!(params.m_msgType == LORAWAN_CONFIRMED_DATA_UP || params.m_msgType == LORAWAN_UNCONFIRMED_DATA_UP) ) {
+  } else if (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_A || m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_C) {
+    if (!(params.m_msgType == LORAWAN_CONFIRMED_DATA_UP || params.m_msgType == LORAWAN_UNCONFIRMED_DATA_UP || params.m_msgType == LORAWAN_JOIN_REQUEST) ) {
       NS_LOG_ERROR (this << " End device only supports upstream data, requested LoRaWAN Message type: " << params.m_msgType);
       return;
     }
@@ -745,8 +970,8 @@ LoRaWANMac::sendMACPayloadRequest (LoRaWANDataRequestParams params, Ptr<Packet>
   }
 
   // Check length of MACPayload
-  if (p->GetSize () > maxMACPayloadSize[params.m_loraWANDataRateIndex]) {
-    NS_LOG_ERROR (this << " Requested to transmit MACPayload with length = " << p->GetSize () << ", maxiumum size is limited to " << maxMACPayloadSize[params.m_loraWANDataRateIndex] << " for DataRate " << params.m_loraWANDataRateIndex);
+  if (p->GetSize () > GetMaxMACPayloadSize (params.m_loraWANDataRateIndex)) {
+    NS_LOG_ERROR (this << " Requested to transmit MACPayload with length = " << p->GetSize () << ", maxiumum size is limited to " << (uint16_t)GetMaxMACPayloadSize (params.m_loraWANDataRateIndex) << " for DataRate " << (uint16_t)params.m_loraWANDataRateIndex);
     return;
   }
 
@@ -755,11 +980,35 @@ LoRaWANMac::sendMACPayloadRequest (LoRaWANDataRequestParams params, Ptr<Packet>
 
   m_macTxEnqueueTrace (phyPayload);
 
+  // Make room in a full queue. The head of the queue is not dropped when it
+  // is being transmitted (m_txPkt is set).
+  if (m_maxTxQueueSize > 0 && m_txQueue.GetSize () >= m_maxTxQueueSize) {
+    m_nTxQueueDrops++;
+    LoRaWANDataConfirmParams confirmParams;
+    confirmParams.m_status = LORAWAN_TRANSACTION_OVERFLOW;
+    if (m_txQueueDropPolicy == LORAWAN_QUEUE_DROP_HEAD && m_txPkt == 0) {
+      NS_LOG_DEBUG (this << " TX queue is full, dropping the oldest packet");
+      TxQueueElement &txQElement = m_txQueue.Front ();
+      confirmParams.m_requestHandle = txQElement.lorawanDataRequestParams.m_requestHandle;
+      m_macTxDropTrace (txQElement.txQPkt);
+      RemoveFirstTxQElement (false);
+    } else {
+      NS_LOG_DEBUG (this << " TX queue is full, dropping the new packet");
+      confirmParams.m_requestHandle = params.m_requestHandle;
+      m_macTxDropTrace (phyPayload);
+      if (!m_dataConfirmCallback.IsNull ())
+        m_dataConfirmCallback (confirmParams);
+      return;
+    }
+    if (!m_dataConfirmCallback.IsNull ())
+      m_dataConfirmCallback (confirmParams);
+  }
+
   // All checks have been passed, add packet to the queue
-  TxQueueElement *txQElement = new TxQueueElement;
-  txQElement->lorawanDataRequestParams = params;
-  txQElement->txQPkt = phyPayload;
-  m_txQueue.push_back (txQElement);
+  TxQueueElement &txQElement = m_txQueue.PushBack ();
+  txQElement.lorawanDataRequestParams = params;
+  txQElement.txQPkt = phyPayload;
+  m_txQueueSize = m_txQueue.GetSize ();
 
   CheckQueue ();
 }
@@ -773,12 +1022,39 @@ LoRaWANMac::constructPhyPayload (LoRaWANDataRequestParams params, Ptr<Packet> p)
 
   // 4B MIC
   uint32_t size = p->GetSize ();
-  p->AddPaddingAtEnd (4); // as MIC support is not implemented, we do not add a MIC trailer
+  const bool dataFrame = params.m_msgType != LORAWAN_JOIN_REQUEST && params.m_msgType != LORAWAN_JOIN_ACCEPT;
+  LoRaWANMicTag micTag;
+  if (m_deviceType == LORAWAN_DT_GATEWAY && p->RemovePacketTag (micTag)) {
+    // The network server computed the MIC of the DS frame
+    AddMic (p, micTag.GetMic ());
+  } else if (m_deviceType != LORAWAN_DT_GATEWAY && m_crypto && params.m_msgType == LORAWAN_JOIN_REQUEST && size <= LORAWAN_MAX_PHY_PAYLOAD_SIZE - 4) {
+    // The MIC of a JoinRequest is computed with the AppKey, the JoinRequest
+    // is not encrypted
+    uint8_t frame[LORAWAN_MAX_PHY_PAYLOAD_SIZE];
+    p->CopyData (frame, size);
+    AddMic (p, LoRaWANCrypto::ComputeJoinMic (m_appKey, frame, size));
+  } else if (m_deviceType != LORAWAN_DT_GATEWAY && m_crypto && dataFrame && size <= LORAWAN_MAX_PHY_PAYLOAD_SIZE - 4) {
+    // Encrypt the FRMPayload and compute the MIC over the encrypted frame
+    uint8_t frame[LORAWAN_MAX_PHY_PAYLOAD_SIZE];
+    p->CopyData (frame, size);
+    const uint32_t offset = LoRaWANCrypto::CryptFrame (m_nwkSKey, m_appSKey, true, frame, size);
+    LoRaWANCrypto::SetPacketTail (p, frame + offset, size - offset);
+    AddMic (p, LoRaWANCrypto::ComputeFrameMic (m_nwkSKey, true, frame, size));
+  } else {
+    p->AddPaddingAtEnd (4); // zero MIC, e.g. when crypto is disabled
+  }
   NS_ASSERT (p->GetSize () == (uint32_t)(size + 4)); // make sure the MIC is accounted for in the packet
 
   return p;
 }
 
+void
+LoRaWANMac::AddMic (Ptr<Packet> p, uint32_t mic)
+{
+  const uint8_t micBytes[4] = {(uint8_t)mic, (uint8_t)(mic >> 8), (uint8_t)(mic >> 16), (uint8_t)(mic >> 24)};
+  p->AddAtEnd (Create<Packet> (micBytes, 4));
+}
+
 void
 LoRaWANMac::CheckQueue ()
 {
@@ -786,20 +1062,20 @@ LoRaWANMac::CheckQueue ()
 
   // Check if we can send a packet: MAC State, Phy state and RDC
 
-  NS_LOG_DEBUG (this << " INFO: tx queue size is equal to " << m_txQueue.size());
+  NS_LOG_DEBUG (this << " INFO: tx queue size is equal to " << m_txQueue.GetSize ());
 
-  if (m_LoRaWANMacState == MAC_IDLE && !m_txQueue.empty () && m_txPkt == 0 && !m_setMacState.IsRunning ())
+  if (m_LoRaWANMacState == MAC_IDLE && !m_txQueue.IsEmpty () && m_txPkt == 0 && !m_setMacState.IsRunning ())
   {
     // Check RDC constraints for first packet in the queue
-    TxQueueElement *txQElement = m_txQueue.front ();
-    int8_t subBandIndex = m_lorawanMacRDC->GetSubBandIndexForChannelIndex (txQElement->lorawanDataRequestParams.m_loraWANChannelIndex);
+    TxQueueElement &txQElement = m_txQueue.Front ();
+    int8_t subBandIndex = m_lorawanMacRDC->GetSubBandIndexForChannelIndex (txQElement.lorawanDataRequestParams.m_loraWANChannelIndex);
     NS_ASSERT (subBandIndex >= 0);
     if (m_lorawanMacRDC->IsSubBandAvailable (subBandIndex))
     {
       NS_LOG_DEBUG (this << " sub band #" << (uint16_t)subBandIndex << " is available");
 
       // we can sent the next frame
-      m_txPkt = txQElement->txQPkt;
+      m_txPkt = txQElement.txQPkt;
       m_setMacState = Simulator::ScheduleNow (&LoRaWANMac::SetLoRaWANMacState, this, MAC_TX);
 
       // in case of gateway, we should set the other MACs to BUSY and the other PHYs to BUSY, see SetLoRaWANMacState
@@ -815,7 +1091,7 @@ LoRaWANMac::CheckQueue ()
   } else {
     if (m_LoRaWANMacState != MAC_IDLE)
       NS_LOG_DEBUG (this << " Cannot sent packet because MAC is not idle, MAC state is equal to " << m_LoRaWANMacState);
-    if (m_txQueue.empty ())
+    if (m_txQueue.IsEmpty ())
       NS_LOG_DEBUG (this << " tx queue is empty, so there is no packet to send.");
     if (m_txPkt)
       NS_LOG_DEBUG (this << " Cannot sent packet because of ongoing tx (m_txPkt is set)");
@@ -825,7 +1101,7 @@ LoRaWANMac::CheckQueue ()
 
   // If a gateway can not send a packet immediately, then there is no use in trying to send it later as the RW of the end device will not be open later
   if (m_deviceType == LORAWAN_DT_GATEWAY) {
-    if (!m_txQueue.empty ()) {
+    if (!m_txQueue.IsEmpty ()) {
       // this is a dangereous state to be in, experience has shown that the gateway MACs gets stuck at this point
       this->RemoveFirstTxQElement (false);
       NS_FATAL_ERROR (this << " Gateway is unable to send packet immediately, aborting packet transmission.");
@@ -843,9 +1119,8 @@ LoRaWANMac::CheckRetransmission ()
   NS_LOG_FUNCTION (this);
 
   // The packet:
-  TxQueueElement *txQElement = m_txQueue.front ();
-  NS_ASSERT (txQElement != 0);
-  LoRaWANDataRequestParams params = txQElement->lorawanDataRequestParams;
+  TxQueueElement &txQElement = m_txQueue.Front ();
+  LoRaWANDataRequestParams params = txQElement.lorawanDataRequestParams;
 
   // This function is only callable for CON US/DS and UNC UP
   if ((params.m_msgType != LORAWAN_CONFIRMED_DATA_UP) && (params.m_msgType != LORAWAN_CONFIRMED_DATA_DOWN) && (params.m_msgType != LORAWAN_UNCONFIRMED_DATA_UP)) {
@@ -858,7 +1133,7 @@ LoRaWANMac::CheckRetransmission ()
   // check whether there are still transmissions remaining for m_txPkt in case of confirmed data
   if ((params.m_msgType == LORAWAN_CONFIRMED_DATA_UP)  || (params.m_msgType == LORAWAN_CONFIRMED_DATA_DOWN)) {
     if (params.m_numberOfTransmissions == 0) { // confirmed frame has reached its number of transmission attempts, remove it
-      m_macTxDropTrace (txQElement->txQPkt);
+      m_macTxDropTrace (txQElement.txQPkt);
       // TODO: Inform upper layer:
       if (!m_dataConfirmCallback.IsNull ())
       {
@@ -901,15 +1176,14 @@ LoRaWANMac::RemoveFirstTxQElement (bool sentPacket)
 {
   NS_LOG_FUNCTION (this);
 
-  TxQueueElement *txQElement = m_txQueue.front ();
-  Ptr<const Packet> p = txQElement->txQPkt;
+  TxQueueElement &txQElement = m_txQueue.Front ();
+  Ptr<const Packet> p = txQElement.txQPkt;
 
   if (sentPacket)
     m_sentPktTrace (p, m_retransmission + 1);
 
-  txQElement->txQPkt = 0;
-  delete txQElement;
-  m_txQueue.pop_front ();
+  m_txQueue.PopFront ();
+  m_txQueueSize = m_txQueue.GetSize ();
   m_txPkt = 0;
   m_retransmission = 0;
   m_macTxDequeueTrace (p);
@@ -920,15 +1194,15 @@ LoRaWANMac::ConfigurePhyForTX () {
   NS_LOG_FUNCTION (this);
 
   if (m_txPkt != 0) {
-    TxQueueElement *txQElement = m_txQueue.front ();
+    TxQueueElement &txQElement = m_txQueue.Front ();
     // Select and configure PHY
-    uint8_t channelIndex = txQElement->lorawanDataRequestParams.m_loraWANChannelIndex;
-    uint8_t dataRateIndex = txQElement->lorawanDataRequestParams.m_loraWANDataRateIndex;
-    uint8_t codeRate = txQElement->lorawanDataRequestParams.m_loraWANCodeRate;
+    uint8_t channelIndex = txQElement.lorawanDataRequestParams.m_loraWANChannelIndex;
+    uint8_t dataRateIndex = txQElement.lorawanDataRequestParams.m_loraWANDataRateIndex;
+    uint8_t codeRate = txQElement.lorawanDataRequestParams.m_loraWANCodeRate;
 
-    uint8_t subBandIndex = LoRaWAN::m_supportedChannels[txQElement->lorawanDataRequestParams.m_loraWANChannelIndex].m_subBandIndex; // Sub band belonging to channel
-    uint8_t maxTxPower = m_lorawanMacRDC->GetMaxPowerForSubBand (subBandIndex);
-    if (!m_phy->SetTxConf (maxTxPower, channelIndex, dataRateIndex, codeRate, 8, false, true) ) {
+    uint8_t subBandIndex = LoRaWAN::m_supportedChannels[txQElement.lorawanDataRequestParams.m_loraWANChannelIndex].m_subBandIndex; // Sub band belonging to channel
+    int8_t txPower = LoRaWAN::GetTxPower (m_lorawanMacRDC->GetMaxPowerForSubBand (subBandIndex), m_txPowerIndex);
+    if (!m_phy->SetTxConf (txPower, channelIndex, dataRateIndex, codeRate, 8, false, true) ) {
       NS_LOG_ERROR (this << " unable to configure Phy");
       return false;
     } else {
@@ -938,6 +1212,23 @@ LoRaWANMac::ConfigurePhyForTX () {
   return false;
 }
 
+bool
+LoRaWANMac::ConfigurePhyForRW2 ()
+{
+  // The default fixed RW2 channel is 869.525 MHz / DR0 (SF12, 125kHz)
+  uint8_t channelIndex = LoRaWAN::m_RW2ChannelIndex;
+  uint8_t dataRateIndex = LoRaWAN::m_RW2DataRateIndex; // fixed
+
+  uint8_t subBandIndex = LoRaWAN::m_supportedChannels [channelIndex].m_subBandIndex;
+  uint8_t maxTxPower = m_lorawanMacRDC->GetMaxPowerForSubBand (subBandIndex);
+
+  if (!m_phy->SetTxConf (maxTxPower, channelIndex, dataRateIndex, 3, 8, false, true) ) {
+    NS_LOG_ERROR (this << " unable to configure Phy");
+    return false;
+  }
+  return true;
+}
+
 //void
 //LoRaWANMac::StartTransmission()
 //{
@@ -988,12 +1279,12 @@ LoRaWANMac::OpenRW ()
 {
   NS_LOG_FUNCTION (this);
 
-  NS_ASSERT (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_A);
+  NS_ASSERT (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_A || m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_C);
 
   if (m_LoRaWANMacState == MAC_RW1) {
-    // RW1 uses the same channel as the preceding uplink
+    // RW1 uses the same channel as the preceding uplink, or a downlink channel that is mapped on it (e.g. US915)
     // The data rate is a function of the uplink data rate and the RX1DROffset
-    uint8_t channelIndex = m_phy->GetCurrentChannelIndex ();
+    uint8_t channelIndex = LoRaWAN::GetRX1ChannelIndex (m_phy->GetCurrentChannelIndex ());
     uint8_t dataRateIndex = LoRaWAN::GetRX1DataRateIndex (m_phy->GetCurrentDataRateIndex (), m_RX1DROffset);
 
     uint8_t subBandIndex = LoRaWAN::m_supportedChannels [channelIndex].m_subBandIndex;
@@ -1004,17 +1295,8 @@ LoRaWANMac::OpenRW ()
       return;
     }
   } else if (m_LoRaWANMacState == MAC_RW2) {
-    // The default fixed RW2 channel is 869.525 MHz / DR0 (SF12, 125kHz)
-    uint8_t channelIndex = LoRaWAN::m_RW2ChannelIndex;
-    uint8_t dataRateIndex = LoRaWAN::m_RW2DataRateIndex; // fixed
-
-    uint8_t subBandIndex = LoRaWAN::m_supportedChannels [channelIndex].m_subBandIndex;
-    uint8_t maxTxPower = m_lorawanMacRDC->GetMaxPowerForSubBand (subBandIndex);
-
-    if (!m_phy->SetTxConf (maxTxPower, channelIndex, dataRateIndex, 3, 8, false, true) ) {
-      NS_LOG_ERROR (this << " unable to configure Phy");
+    if (!ConfigurePhyForRW2 ())
       return;
-    }
 
     // For confirmed frames, start the ACK_TIMEOUT timer at the beginning of RW2
     if (m_txPkt) { // if the transmitted packet was unconfirmed, then it has been removed in RemoveFirstTxQElement which set m_txPkt to NULL
@@ -1051,7 +1333,7 @@ LoRaWANMac::CloseRW ()
   // This function is called to close the RW in case no frame was received during the RW
   NS_LOG_FUNCTION (this);
 
-  NS_ASSERT (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_A);
+  NS_ASSERT (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_A || m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_C);
 
   // Update MAC state?
   if (m_LoRaWANMacState == MAC_RW1) { // no frame received, so should continue to RW2
@@ -1151,26 +1433,17 @@ LoRaWANMac::AckTimeoutExpired ()
 }
 
 // LoRaWANMacRDC class implementation:
-LoRaWANMac::LoRaWANMacRDC::LoRaWANMacRDC (void) {
-  // init sub bands, EU868
-  LoRaWANSubBand g0 = {100, 14, Time (), Time ()}; // g(Note 7), 14dBm?
-  LoRaWANSubBand g1 = {100, 14, Time (), Time ()}; // 1%
-  LoRaWANSubBand g2 = {1000, 14, Time (), Time ()}; // 0.1%
-  LoRaWANSubBand g3 = {10, 27, Time (), Time ()}; // 10%, high power subband
-  LoRaWANSubBand g4 = {100, 14, Time (), Time ()}; // 1%
-
-  this->m_subBands.push_back (g0);
-  this->m_subBands.push_back (g1);
-  this->m_subBands.push_back (g2);
-  this->m_subBands.push_back (g3);
-  this->m_subBands.push_back (g4);
+LoRaWANMac::LoRaWANMacRDC::LoRaWANMacRDC (void) : m_aggregatedDutyCycleLimit(1) {
+  // init sub bands of the region, e.g. g, g1 to g4 in EU868
+  const LoRaWANRegionProfile &profile = LoRaWAN::GetRegionProfile (LoRaWAN::GetRegion ());
+  for (uint8_t i = 0; i < profile.m_nSubBands; i++)
+    {
+      LoRaWANSubBand subBand = {profile.m_subBands[i].m_dutyCycleLimit, profile.m_subBands[i].m_maxTxPower, Time (), Time ()};
+      this->m_subBands.push_back (subBand);
+    }
 
   // init sub band timers:
-  this->m_subBandTimers.push_back (EventId ());
-  this->m_subBandTimers.push_back (EventId ());
-  this->m_subBandTimers.push_back (EventId ());
-  this->m_subBandTimers.push_back (EventId ());
-  this->m_subBandTimers.push_back (EventId ());
+  this->m_subBandTimers.resize (this->m_subBands.size ());
 }
 
 int8_t
@@ -1205,6 +1478,18 @@ LoRaWANMac::LoRaWANMacRDC::IsSubBandAvailable (uint8_t subBandIndex) const
   return result;
 }
 
+uint16_t
+LoRaWANMac::LoRaWANMacRDC::GetDutyCycleLimitForSubBand (uint8_t subBandIndex) const
+{
+  return m_subBands[subBandIndex].dutyCycleLimit;
+}
+
+Time
+LoRaWANMac::LoRaWANMacRDC::GetSubBandAvailableTime (uint8_t subBandIndex) const
+{
+  return m_subBands[subBandIndex].LastTxFinishedTimestamp + m_subBands[subBandIndex].timeoff;
+}
+
 void
 LoRaWANMac::LoRaWANMacRDC::ScheduleSubBandTimer (Ptr<LoRaWANMac> macObj, uint8_t subBandIndex)
 {
@@ -1247,6 +1532,49 @@ LoRaWANMac::LoRaWANMacRDC::UpdateRDCTimerForSubBand (uint8_t subBandIndex, Time
   NS_LOG_LOGIC (this << " updated RDC for subBand " << (uint16_t)subBandIndex << ": "
                      << LastTxFinishedTimestamp << ", "
                      << timeoff);
+
+  // The aggregated limit applies to all sub bands, including the one of this
+  // transmission when its own limit is less strict
+  if (m_aggregatedDutyCycleLimit > 1) {
+    Time aggregatedTimeoff = airTime*m_aggregatedDutyCycleLimit - airTime;
+    for (uint32_t k = 0; k < m_subBands.size (); k++) {
+      if (GetSubBandAvailableTime (k) < LastTxFinishedTimestamp + aggregatedTimeoff) {
+        m_subBands[k].LastTxFinishedTimestamp = LastTxFinishedTimestamp;
+        m_subBands[k].timeoff = aggregatedTimeoff;
+      }
+    }
+  }
+}
+
+void
+LoRaWANMac::LoRaWANMacRDC::SetAggregatedDutyCycleLimit (uint16_t limit)
+{
+  NS_ASSERT (limit > 0);
+  m_aggregatedDutyCycleLimit = limit;
+}
+
+uint16_t
+LoRaWANMac::LoRaWANMacRDC::GetAggregatedDutyCycleLimit (void) const
+{
+  return m_aggregatedDutyCycleLimit;
+}
+
+uint32_t
+LoRaWANMac::GetTxQueueSize (void) const
+{
+  return m_txQueue.GetSize ();
+}
+
+uint32_t
+LoRaWANMac::GetTxQueuePeakSize (void) const
+{
+  return m_txQueue.GetPeakSize ();
+}
+
+uint32_t
+LoRaWANMac::GetTxQueueDrops (void) const
+{
+  return m_nTxQueueDrops;
 }
 
 int64_t
@@ -22,6 +22,8 @@
 
 #include "lorawan.h"
 #include "lorawan-phy.h"
+#include "lorawan-ring-queue.h"
+#include "lorawan-crypto.h"
 #include <ns3/object.h>
 #include <ns3/traced-callback.h>
 #include <ns3/traced-value.h>
@@ -29,7 +31,6 @@
 #include <ns3/nstime.h>
 #include <ns3/event-id.h>
 #include <ns3/timer.h>
-#include <deque>
 
 // Default settings for EU863-870
 #define ACK_TIMEOUT 2000000 // in uS
@@ -92,6 +93,8 @@ typedef enum
 {
   LORAWAN_SUCCESS                = 0,
   LORAWAN_NO_ACK                 = 2,
+  LORAWAN_TRANSACTION_OVERFLOW   = 3, //!< dropped because the TX queue was full
+  LORAWAN_INVALID_PARAMETER      = 4, //!< dropped because the PHY could not be configured for the transmission
 } LoRaWANMcpsDataConfirmStatus;
 
 /**
@@ -183,6 +186,12 @@ typedef Callback<void, LoRaWANDataIndicationParams, Ptr<Packet> > DataIndication
  * Note that a MAC object is strongly coupled with its underlying PHY, as such
  * there is one LoRaWANMac per PHY. End devices typically support one MAC/PHY
  * combo, but a gateway supports many MAC/PHY objects.
+ *
+ * Class A and Class C end devices share the state machine after an uplink
+ * (RW1 and RW2). While a Class C end device is idle (MAC_IDLE or
+ * MAC_ACK_TIMEOUT), its PHY listens on the RW2 channel and data rate, so that
+ * the network server can send it a DS packet at any time. An uplink aborts an
+ * ongoing reception of a Class C end device.
  */
 class LoRaWANMac : public Object
 {
@@ -202,8 +211,26 @@ public:
     int8_t GetMaxPowerForSubBand (uint8_t subBandIndex) const;
     bool IsSubBandAvailable (uint8_t subBandIndex) const;
 
+    /**
+     * \return the duty cycle limit of the sub band, see LoRaWANSubBand
+     */
+    uint16_t GetDutyCycleLimitForSubBand (uint8_t subBandIndex) const;
+
+    /**
+     * \return the time at which the sub band becomes available again, which
+     * may be in the past
+     */
+    Time GetSubBandAvailableTime (uint8_t subBandIndex) const;
+
     void UpdateRDCTimerForSubBand (uint8_t subBandIndex, Time airTime);
 
+    /**
+     * Limit the duty cycle aggregated over all sub bands to 1/limit on top of
+     * the limits of the sub bands. A limit of 1 does not add a limit.
+     */
+    void SetAggregatedDutyCycleLimit (uint16_t limit);
+    uint16_t GetAggregatedDutyCycleLimit (void) const;
+
     void ScheduleSubBandTimer (Ptr<LoRaWANMac> macObj, uint8_t subBandIndex);
     void SubBandTimerExpired (Ptr<LoRaWANMac> macObj, uint8_t subBandIndex);
   private:
@@ -213,6 +240,8 @@ public:
     std::vector<LoRaWANSubBand> m_subBands;
 
     std::vector<EventId> m_subBandTimers;
+
+    uint16_t m_aggregatedDutyCycleLimit;
   };
 
   /**
@@ -282,8 +311,37 @@ public:
   void PdDataConfirm (LoRaWANPhyEnumeration status);
 
   Ipv4Address GetDevAddr (void) const;
+  /**
+   * Set the device address. Unless session keys were set with
+   * SetSessionKeys, the MAC of an end device uses the default session keys
+   * of the address (see LoRaWANCrypto::DeriveDefaultSessionKeys).
+   */
   void SetDevAddr (Ipv4Address);
 
+  /**
+   * Set the session keys of an end device, e.g. the keys that were derived
+   * when it joined. They are used to compute the MIC and to encrypt the
+   * FRMPayload of US data frames, and to verify and decrypt DS data frames.
+   */
+  void SetSessionKeys (const LoRaWANKey &nwkSKey, const LoRaWANKey &appSKey);
+  const LoRaWANKey &GetNwkSKey (void) const;
+  const LoRaWANKey &GetAppSKey (void) const;
+
+  /**
+   * Set the AppKey of an end device that joins by over-the-air activation.
+   * It is used to compute the MIC of JoinRequests, and to decrypt and verify
+   * JoinAccepts: an end device only accepts the JoinAccepts of which the MIC
+   * matches its AppKey.
+   */
+  void SetAppKey (const LoRaWANKey &appKey);
+  const LoRaWANKey &GetAppKey (void) const;
+
+  /**
+   * \return the number of DS frames that an end device dropped because of an
+   * invalid MIC
+   */
+  uint32_t GetMicFailures (void) const;
+
   LoRaWANDeviceType GetDeviceType (void) const;
   void SetDeviceType (LoRaWANDeviceType);
 
@@ -292,6 +350,33 @@ public:
   uint8_t GetRX1DROffset (void) const;
   void SetRX1DROffset (uint8_t);
 
+  /**
+   * Set the TX power of US transmissions, as requested by the network server
+   * in a LinkADRReq. Index 0 is the maximum power of the sub band and every
+   * next index is the next lower power in the TX power table of the region,
+   * see LoRaWAN::GetTxPower.
+   *
+   * \param index the TX power index, at most
+   * LoRaWANRegionProfile::m_maxTxPowerIndex
+   */
+  void SetTxPowerIndex (uint8_t index);
+  uint8_t GetTxPowerIndex (void) const;
+
+  /**
+   * Limit the aggregated duty cycle of US transmissions to 1/2^maxDutyCycle,
+   * as requested by the network server in a DutyCycleReq. A value of 0 only
+   * leaves the limits of the sub bands.
+   *
+   * \param maxDutyCycle MaxDCycle in [0, 15]
+   */
+  void SetMaxDutyCycle (uint8_t maxDutyCycle);
+  uint8_t GetMaxDutyCycle (void) const;
+
+  /**
+   * \return the maximum MACPayload size in bytes for a data rate
+   */
+  static uint8_t GetMaxMACPayloadSize (uint8_t dataRateIndex);
+
   /**
    *  Request to transfer a MAC payload.
    *
@@ -300,6 +385,21 @@ public:
    */
   void sendMACPayloadRequest (LoRaWANDataRequestParams params, Ptr<Packet> p);
 
+  /**
+   * \return the number of packets in the TX queue
+   */
+  uint32_t GetTxQueueSize (void) const;
+
+  /**
+   * \return the largest number of packets that were in the TX queue at the same time
+   */
+  uint32_t GetTxQueuePeakSize (void) const;
+
+  /**
+   * \return the number of packets that were dropped because the TX queue was full
+   */
+  uint32_t GetTxQueueDrops (void) const;
+
   /**
    * TracedCallback signature for sent packets.
    *
@@ -325,12 +425,22 @@ protected:
 
   void sendTRXStateRequestForIdleMAC ();
   Ptr<Packet> constructPhyPayload (LoRaWANDataRequestParams params, Ptr<Packet> p);
+  /**
+   * Append a MIC to a frame, the bytes of mic are in little endian order.
+   */
+  static void AddMic (Ptr<Packet> p, uint32_t mic);
 
   void CheckQueue ();
   void CheckRetransmission ();
   void RemoveFirstTxQElement (bool sentPacket);
 
   bool ConfigurePhyForTX ();
+  /**
+   * Tune the PHY to the channel and data rate of RW2.
+   *
+   * \return false if the PHY could not be configured
+   */
+  bool ConfigurePhyForRW2 ();
 
   void SubBandTimerCallback ();
 
@@ -427,11 +537,6 @@ private:
    */
   Ptr<LoRaWANMacRDC> m_lorawanMacRDC;
 
-  /*
-   * Maximum MACPayload size length as per $7.1.6
-   */
-  const static uint8_t maxMACPayloadSize[]; // defined for LoRaWAN DR0 to DR7
-
   /**
    * The type of device: End Device or Gateway
    */
@@ -442,6 +547,7 @@ private:
    * Only applicable to end devices
    */
   uint8_t m_RX1DROffset;
+  uint8_t m_txPowerIndex;
 
   /**
    * The current states of the MAC layer. One per Phy.
@@ -481,9 +587,30 @@ private:
   };
 
   /**
-   * The transmit queue used by the MAC.
+   * The transmit queue used by the MAC. Its elements are stored by value in
+   * a ring buffer that is reused for the lifetime of the MAC.
+   */
+  LoRaWANRingQueue<TxQueueElement> m_txQueue;
+
+  /**
+   * The maximum number of packets in m_txQueue, zero means unlimited.
+   */
+  uint32_t m_maxTxQueueSize;
+
+  /**
+   * What to drop when a packet is requested while m_txQueue is full.
+   */
+  LoRaWANQueueDropPolicy m_txQueueDropPolicy;
+
+  /**
+   * The number of packets in m_txQueue.
+   */
+  TracedValue<uint32_t> m_txQueueSize;
+
+  /**
+   * The number of packets that were dropped because m_txQueue was full.
    */
-  std::deque<TxQueueElement*> m_txQueue;
+  uint32_t m_nTxQueueDrops;
 
   /**
    * The packet which is currently being sent by the MAC layer.
@@ -518,12 +645,46 @@ private:
    */
   EventId m_ackTimeOut;
 
+  /**
+   * Whether an end device computes and verifies MICs and encrypts the
+   * FRMPayload, otherwise the MIC is zero and the FRMPayload is sent in clear
+   */
+  bool m_crypto;
+
+  /**
+   * The session keys of an end device
+   */
+  LoRaWANKey m_nwkSKey;
+  LoRaWANKey m_appSKey;
+
+  /**
+   * The AppKey of an end device, the all zero key unless set by SetAppKey
+   */
+  LoRaWANKey m_appKey;
+
+  /**
+   * Whether the session keys were set by SetSessionKeys, instead of derived
+   * from the device address
+   */
+  bool m_sessionKeysSet;
+
+  /**
+   * The number of DS data frames and JoinAccepts with an invalid MIC
+   */
+  uint32_t m_nMicFailures;
+
   /**
    * The Time when the last uplink bit was transmitted
    * Only used in class A end devices for calculating the start of RW1 and RW2
    */
   Time m_lastUplinkBitTime;
 
+  /**
+   * Whether the last uplink was a JoinRequest, which uses the longer
+   * JOIN_ACCEPT_DELAY1 and JOIN_ACCEPT_DELAY2 for RW1 and RW2
+   */
+  bool m_lastUplinkJoinRequest;
+
   /**
    * The random variable used to calculate the random fraction of the Ack
    * time-out timer
@@ -61,37 +61,35 @@ LoRaWANNetDevice::GetTypeId (void)
                    UintegerValue (1), // default value is one
                    MakeUintegerAccessor (&LoRaWANNetDevice::m_nbRep),
                    MakeUintegerChecker<uint8_t> (1, 15))
+    .AddAttribute ("SharedGatewayReceiver",
+                   "Whether the phys of a gateway share a single receiver "
+                   "front-end (LoRaWANGatewayPhy) that is attached to the channel",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&LoRaWANNetDevice::m_sharedGatewayReceiver),
+                   MakeBooleanChecker ())
   ;
   return tid;
 }
 
-LoRaWANNetDevice::LoRaWANNetDevice () : m_deviceType (LORAWAN_DT_END_DEVICE_CLASS_A), m_configComplete(false)
+LoRaWANNetDevice::LoRaWANNetDevice () : m_stream (-1), m_gatewayTx (false), m_sharedGatewayReceiver (true), m_deviceType (LORAWAN_DT_END_DEVICE_CLASS_A), m_configComplete(false)
 {}
 
 LoRaWANNetDevice::LoRaWANNetDevice (LoRaWANDeviceType deviceType)
-  : m_deviceType (deviceType), m_configComplete (false)
+  : m_stream (-1), m_gatewayTx (false), m_sharedGatewayReceiver (true), m_deviceType (deviceType), m_configComplete (false)
 {
   NS_LOG_FUNCTION (this);
 
-  if (deviceType == LORAWAN_DT_END_DEVICE_CLASS_A) {
+  if (deviceType == LORAWAN_DT_END_DEVICE_CLASS_A || deviceType == LORAWAN_DT_END_DEVICE_CLASS_C) {
     uint8_t index = 0;
     m_phy = CreateObject<LoRaWANPhy> (index);
     m_mac = CreateObject<LoRaWANMac> (index);
     m_macRDC = CreateObject<LoRaWANMac::LoRaWANMacRDC> ();
   } else if (deviceType == LORAWAN_DT_GATEWAY) {
-    uint8_t index = 0;
-    for (uint8_t i = 0; i < LoRaWAN::m_supportedChannels.size (); i++) {
-      for (uint8_t j = 0; j < LoRaWAN::m_supportedDataRates.size (); j++) {
-        index = i*LoRaWAN::m_supportedDataRates.size () + j;
-        Ptr<LoRaWANPhy> phy = CreateObject<LoRaWANPhy> (index);
-        Ptr<LoRaWANMac> mac = CreateObject<LoRaWANMac> (index);
-        // index in std::vector is i*LoRaWAN::m_supportedDataRates.size () + j
-        // phy and mac belong together
-        m_phys.push_back (phy);
-        m_macs.push_back (mac);
-      }
-    }
+    // The PHYs and MACs are built in CompleteConfig, as SharedGatewayReceiver
+    // is only known after construction
     m_macRDC = CreateObject<LoRaWANMac::LoRaWANMacRDC> ();
+  } else {
+    NS_FATAL_ERROR (this << " Unsupported LoRaWAN device type " << deviceType);
   }
   CompleteConfig ();
 }
@@ -106,19 +104,28 @@ void
 LoRaWANNetDevice::DoDispose (void)
 {
   NS_LOG_FUNCTION (this);
-  if (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_A) {
+  if (m_deviceType != LORAWAN_DT_GATEWAY) {
     m_mac->Dispose ();
     m_phy->Dispose ();
     m_phy = 0;
     m_mac = 0;
   } else if (m_deviceType == LORAWAN_DT_GATEWAY) {
     for (uint8_t i = 0; i < m_phys.size(); i++) {
+      if (!m_phys[i])
+        continue;
       m_phys[i]->Dispose();
       m_macs[i]->Dispose();
     }
 
     m_phys.clear ();
     m_macs.clear ();
+    m_channel = 0;
+
+    if (m_gatewayPhy)
+      {
+        m_gatewayPhy->Dispose ();
+        m_gatewayPhy = 0;
+      }
   }
   m_macRDC = 0;
   m_node = 0;
@@ -130,11 +137,13 @@ void
 LoRaWANNetDevice::DoInitialize (void)
 {
   NS_LOG_FUNCTION (this);
-  if (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_A) {
+  if (m_deviceType != LORAWAN_DT_GATEWAY) {
     m_phy->Initialize ();
     m_mac->Initialize ();
   } else if (m_deviceType == LORAWAN_DT_GATEWAY) {
     for (uint8_t i = 0; i < m_phys.size(); i++) {
+      if (!m_phys[i])
+        continue;
       m_phys[i]->Initialize();
       m_macs[i]->Initialize();
     }
@@ -146,10 +155,10 @@ LoRaWANNetDevice::DoInitialize (void)
 void
 LoRaWANNetDevice::CompleteConfig (void)
 {
-  // TODO: this function could share more code the CLASS_A and GW cases
+  // TODO: this function could share more code the end device and GW cases
   NS_LOG_FUNCTION (this);
 
-  if (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_A) {
+  if (m_deviceType != LORAWAN_DT_GATEWAY) {
     if (m_mac == 0
         || m_macRDC == 0
         || m_phy == 0
@@ -182,64 +191,136 @@ LoRaWANNetDevice::CompleteConfig (void)
 
     m_configComplete = true;
   } else if (m_deviceType == LORAWAN_DT_GATEWAY) {
-    if (m_macs.size () == 0
-        || m_macRDC == 0
-        || m_phys.size () == 0
+    if (m_macRDC == 0
+        || m_channel == 0
         || m_node == 0
         || m_configComplete)
       {
         return;
       }
-    for (uint8_t i = 0; i < m_macs.size (); i++) {
-      Ptr<LoRaWANPhy> phy = m_phys[i];
-      Ptr<LoRaWANMac> mac = m_macs[i];
-      NS_ASSERT(phy);
-      NS_ASSERT(mac);
-
-      // Phy: set channel and data rate for listining (using SetTxConf):
-      uint8_t channelIndex = i / LoRaWAN::m_supportedDataRates.size();
-      uint8_t dataRateIndex = i % LoRaWAN::m_supportedDataRates.size();
-      if (!phy->SetTxConf (2, channelIndex, dataRateIndex, 3, 8, false, true) ) {
-        NS_LOG_ERROR (this << " Phy #" << static_cast<uint16_t>(i) << ": failed setting channelIndex to " << static_cast<uint16_t>(channelIndex) << " and dataRateIndex to " << static_cast<uint16_t>(dataRateIndex));
-      }
-
-      mac->SetPhy (phy);
-      mac->SetRDC (m_macRDC);
-      mac->SetDeviceType (m_deviceType);
-      mac->SetDataIndicationCallback (MakeCallback (&LoRaWANNetDevice::DataIndication, this));
 
-      // Set begin and end tx callbacks (only for gateway)
-      mac->SetBeginTxCallback (MakeCallback (&LoRaWANNetDevice::MacBeginsTx, this));
-      mac->SetEndTxCallback (MakeCallback (&LoRaWANNetDevice::MacEndsTx, this));
+    // One PHY and MAC per channel and data rate the gateway listens on (see
+    // LoRaWAN::GetGatewayPhyConfigs), index in std::vector is the index of the config
+    const uint8_t nConfigs = LoRaWAN::GetGatewayPhyConfigs ().size ();
+    m_phys.resize (nConfigs);
+    m_macs.resize (nConfigs);
+    m_configComplete = true;
 
+    if (m_gatewayPhy) {
+      // The shared receiver requests the PHYs of a channel when the first
+      // signal arrives on it, so gateway memory only grows with the channels
+      // that are in use
       Ptr<MobilityModel> mobility = m_node->GetObject<MobilityModel> ();
-      if (!mobility)
-        {
-          NS_LOG_WARN ("LoRaWANNetDevice: no Mobility found on the node, probably it's not a good idea.");
-        }
-      phy->SetMobility (mobility);
-      Ptr<LoRaWANErrorModel> model = CreateObject<LoRaWANErrorModel> ();
-      phy->SetErrorModel (model);
-      phy->SetDevice (this);
-
-      phy->SetPdDataIndicationCallback (MakeCallback (&LoRaWANMac::PdDataIndication, mac));
-      phy->SetPdDataDestroyedCallback (MakeCallback (&LoRaWANMac::PdDataDestroyed,  mac));
-      phy->SetPdDataConfirmCallback (MakeCallback (&LoRaWANMac::PdDataConfirm, mac));
-      phy->SetSetTRXStateConfirmCallback (MakeCallback (&LoRaWANMac::SetTRXStateConfirm, mac));
+      if (mobility)
+        m_gatewayPhy->SetMobility (mobility);
+      m_gatewayPhy->SetPhyRequestCallback (MakeCallback (&LoRaWANNetDevice::RequestGatewayPhy, this));
+    } else {
+      for (uint8_t i = 0; i < nConfigs; i++)
+        BuildGatewayPhyAndMac (i);
     }
-    m_configComplete = true;
   }
 }
 
+void
+LoRaWANNetDevice::BuildGatewayPhyAndMac (uint8_t index)
+{
+  NS_LOG_FUNCTION (this << static_cast<uint16_t> (index));
+  NS_ASSERT (m_deviceType == LORAWAN_DT_GATEWAY && m_configComplete);
+  NS_ASSERT (index < m_phys.size ());
+
+  if (m_phys[index])
+    return;
+
+  Ptr<LoRaWANPhy> phy = CreateObject<LoRaWANPhy> (index);
+  Ptr<LoRaWANMac> mac = CreateObject<LoRaWANMac> (index);
+  // phy and mac belong together
+  m_phys[index] = phy;
+  m_macs[index] = mac;
+
+  // Phy: set channel and data rate for listining (using SetTxConf):
+  uint8_t channelIndex = LoRaWAN::GetGatewayPhyConfigs ()[index].first;
+  uint8_t dataRateIndex = LoRaWAN::GetGatewayPhyConfigs ()[index].second;
+  if (!phy->SetTxConf (2, channelIndex, dataRateIndex, 3, 8, false, true) ) {
+    NS_LOG_ERROR (this << " Phy #" << static_cast<uint16_t>(index) << ": failed setting channelIndex to " << static_cast<uint16_t>(channelIndex) << " and dataRateIndex to " << static_cast<uint16_t>(dataRateIndex));
+  }
+
+  mac->SetPhy (phy);
+  mac->SetRDC (m_macRDC);
+  mac->SetDeviceType (m_deviceType);
+  mac->SetDataIndicationCallback (MakeCallback (&LoRaWANNetDevice::DataIndication, this));
+
+  // Set begin and end tx callbacks (only for gateway)
+  mac->SetBeginTxCallback (MakeCallback (&LoRaWANNetDevice::MacBeginsTx, this));
+  mac->SetEndTxCallback (MakeCallback (&LoRaWANNetDevice::MacEndsTx, this));
+
+  Ptr<MobilityModel> mobility = m_node->GetObject<MobilityModel> ();
+  if (!mobility)
+    {
+      NS_LOG_WARN ("LoRaWANNetDevice: no Mobility found on the node, probably it's not a good idea.");
+    }
+  phy->SetMobility (mobility);
+  Ptr<LoRaWANErrorModel> model = CreateObject<LoRaWANErrorModel> ();
+  phy->SetErrorModel (model);
+  phy->SetDevice (this);
+
+  phy->SetPdDataIndicationCallback (MakeCallback (&LoRaWANMac::PdDataIndication, mac));
+  phy->SetPdDataDestroyedCallback (MakeCallback (&LoRaWANMac::PdDataDestroyed,  mac));
+  phy->SetPdDataConfirmCallback (MakeCallback (&LoRaWANMac::PdDataConfirm, mac));
+  phy->SetSetTRXStateConfirmCallback (MakeCallback (&LoRaWANMac::SetTRXStateConfirm, mac));
+
+  // The phys transmit on the channel themselves, but only the shared
+  // receiver front-end is registered as a receiver
+  phy->SetChannel (m_channel);
+  if (m_gatewayPhy)
+    m_gatewayPhy->AddPhy (phy);
+  else
+    m_channel->AddRx (phy);
+
+  if (m_stream >= 0)
+    phy->AssignStreams (m_stream + index);
+
+  // A phy and mac that are built during the simulation start listening right
+  // away, unless the gateway is transmitting
+  if (IsInitialized ()) {
+    phy->Initialize ();
+    mac->Initialize ();
+    if (m_gatewayTx)
+      mac->SwitchToUnavailableState ();
+  }
+}
+
+void
+LoRaWANNetDevice::BuildGatewayChannel (uint8_t channelIndex)
+{
+  NS_LOG_FUNCTION (this << static_cast<uint16_t> (channelIndex));
+  const std::vector<std::pair<uint8_t, uint8_t> > &configs = LoRaWAN::GetGatewayPhyConfigs ();
+  for (uint8_t i = 0; i < configs.size (); i++) {
+    if (configs[i].first == channelIndex)
+      BuildGatewayPhyAndMac (i);
+  }
+}
+
+Ptr<LoRaWANPhy>
+LoRaWANNetDevice::RequestGatewayPhy (uint8_t channelIndex, uint8_t dataRateIndex)
+{
+  uint8_t index = 0;
+  if (!getMACSIndexForChannelAndDataRate (index, channelIndex, dataRateIndex) || index >= m_phys.size ())
+    return 0;
+
+  if (!m_phys[index])
+    BuildGatewayChannel (channelIndex);
+  return m_phys[index];
+}
+
 void
 LoRaWANNetDevice::SetMac (Ptr<LoRaWANMac> mac)
 {
   NS_LOG_FUNCTION (this);
-  if (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_A) {
+  if (m_deviceType != LORAWAN_DT_GATEWAY) {
     m_mac = mac;
     CompleteConfig ();
   } else {
-    NS_ASSERT_MSG (0, "Not implemented for non Class A end devices");
+    NS_ASSERT_MSG (0, "Not implemented for gateways");
   }
 }
 
@@ -247,11 +328,11 @@ void
 LoRaWANNetDevice::SetPhy (Ptr<LoRaWANPhy> phy)
 {
   NS_LOG_FUNCTION (this);
-  if (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_A) {
+  if (m_deviceType != LORAWAN_DT_GATEWAY) {
     m_phy = phy;
     CompleteConfig ();
   } else {
-    NS_ASSERT_MSG (0, "Not implemented for non Class A end devices");
+    NS_ASSERT_MSG (0, "Not implemented for gateways");
   }
 }
 
@@ -259,17 +340,21 @@ void
 LoRaWANNetDevice::SetChannel (Ptr<SpectrumChannel> channel)
 {
   NS_LOG_FUNCTION (this << channel);
-  if (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_A) {
+  if (m_deviceType != LORAWAN_DT_GATEWAY) {
     m_phy->SetChannel (channel);
     channel->AddRx (m_phy);
   } else if (m_deviceType == LORAWAN_DT_GATEWAY) {
-    for (uint8_t i = 0; i < m_phys.size (); i++) {
-      Ptr<LoRaWANPhy> phy = m_phys[i];
-      phy->SetChannel (channel);
-      channel->AddRx (phy);
+    // The phys are attached to the channel when they are built
+    NS_ASSERT_MSG (!m_channel, "The channel of a gateway can only be set once");
+    m_channel = channel;
+    if (m_sharedGatewayReceiver) {
+      m_gatewayPhy = CreateObject<LoRaWANGatewayPhy> ();
+      m_gatewayPhy->SetDevice (this);
+      m_gatewayPhy->SetChannel (channel);
+      channel->AddRx (m_gatewayPhy);
     }
   } else {
-    NS_ASSERT_MSG (0, "Not implemented for non Class A end devices");
+    NS_ASSERT_MSG (0, "Not implemented for gateways");
   }
   CompleteConfig ();
 }
@@ -278,19 +363,21 @@ Ptr<LoRaWANMac>
 LoRaWANNetDevice::GetMac (void) const
 {
    NS_LOG_FUNCTION (this);
-  if (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_A) {
+  if (m_deviceType != LORAWAN_DT_GATEWAY) {
     return m_mac;
   } else {
-    NS_ASSERT_MSG (0, "Not implemented for non Class A end devices");
+    NS_ASSERT_MSG (0, "Not implemented for gateways");
     return NULL;
   }
 }
 
 std::vector<Ptr<LoRaWANMac> >
-LoRaWANNetDevice::GetMacs (void) const
+LoRaWANNetDevice::GetMacs (void)
 {
    NS_LOG_FUNCTION (this);
   if (m_deviceType == LORAWAN_DT_GATEWAY) {
+    for (uint8_t i = 0; i < m_macs.size (); i++)
+      BuildGatewayPhyAndMac (i);
     return m_macs;
   } else {
     NS_ASSERT_MSG (0, "Not implemented for non-gateway devices");
@@ -302,25 +389,35 @@ Ptr<LoRaWANPhy>
 LoRaWANNetDevice::GetPhy (void) const
 {
   NS_LOG_FUNCTION (this);
-  if (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_A) {
+  if (m_deviceType != LORAWAN_DT_GATEWAY) {
     return m_phy;
   } else {
-    NS_ASSERT_MSG (0, "Not implemented for non Class A end devices");
+    NS_ASSERT_MSG (0, "Not implemented for gateways");
     return NULL;
   }
 }
 
 std::vector<Ptr<LoRaWANPhy> >
-LoRaWANNetDevice::GetPhys (void) const
+LoRaWANNetDevice::GetPhys (void)
 {
   NS_LOG_FUNCTION (this);
   if (m_deviceType == LORAWAN_DT_GATEWAY) {
+    for (uint8_t i = 0; i < m_phys.size (); i++)
+      BuildGatewayPhyAndMac (i);
     return m_phys;
   } else {
     NS_ASSERT_MSG (0, "Not implemented for non-gateway devices");
     return m_phys;
   }
 }
+
+Ptr<LoRaWANGatewayPhy>
+LoRaWANNetDevice::GetGatewayPhy (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return m_gatewayPhy;
+}
+
 void
 LoRaWANNetDevice::SetIfIndex (const uint32_t index)
 {
@@ -339,10 +436,10 @@ Ptr<Channel>
 LoRaWANNetDevice::GetChannel (void) const
 {
   NS_LOG_FUNCTION (this);
-  if (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_A) {
+  if (m_deviceType != LORAWAN_DT_GATEWAY) {
     return m_phy->GetChannel ();
   } else if (m_deviceType == LORAWAN_DT_GATEWAY) {
-    return m_phys[0]->GetChannel (); // assume all phys are on same Channel
+    return m_channel; // all phys are on the same Channel
   } else {
     NS_ASSERT_MSG (0, "Not implemented");
     return NULL;
@@ -369,10 +466,10 @@ Ptr<SpectrumChannel>
 LoRaWANNetDevice::DoGetChannel (void) const
 {
   NS_LOG_FUNCTION (this);
-  if (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_A) {
+  if (m_deviceType != LORAWAN_DT_GATEWAY) {
     return m_phy->GetChannel ();
   } else if (m_deviceType == LORAWAN_DT_GATEWAY) {
-    return m_phys[0]->GetChannel (); // assume all phys are on same Channel
+    return m_channel; // all phys are on the same Channel
   } else {
     NS_ASSERT_MSG (0, "Not implemented");
     return NULL;
@@ -383,11 +480,11 @@ void
 LoRaWANNetDevice::SetAddress (Address address)
 {
   NS_LOG_FUNCTION (this);
-  if (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_A) {
+  if (m_deviceType != LORAWAN_DT_GATEWAY) {
     // LoRaWANMac uses ns3::Ipv4Address to store the 32-bit LoRaWAN Network addresses
     m_mac->SetDevAddr (Ipv4Address::ConvertFrom (address));
   } else {
-    NS_ASSERT_MSG (0, "Only Class A end devices have a network address");
+    NS_ASSERT_MSG (0, "Only end devices have a network address");
   }
 }
 
@@ -395,7 +492,7 @@ Address
 LoRaWANNetDevice::GetAddress (void) const
 {
   NS_LOG_FUNCTION (this);
-  if (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_A) {
+  if (m_deviceType != LORAWAN_DT_GATEWAY) {
     return m_mac->GetDevAddr ();
   } else if (m_deviceType == LORAWAN_DT_GATEWAY) {
     return Ipv4Address(0xffffffff); // gateways don't really have addresses, but ns3 expects most net devices to have an adresses (TODO: is this true?) so we allocated the all ones address for all gateways ...
@@ -503,6 +600,12 @@ LoRaWANNetDevice::GetDeviceType (void) const
   return m_deviceType;
 }
 
+uint8_t
+LoRaWANNetDevice::GetNbRep (void) const
+{
+  return m_nbRep;
+}
+
 //void
 //LoRaWANNetDevice::SetDeviceType (LoRaWANDeviceType type)
 //{
@@ -555,7 +658,7 @@ LoRaWANNetDevice::Send (Ptr<Packet> packet, const Address& dest, uint16_t protoc
     loRaWANDataRequestParams.m_numberOfTransmissions = m_nbRep;
 
 
-  if (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_A) {
+  if (m_deviceType != LORAWAN_DT_GATEWAY) {
     m_mac->sendMACPayloadRequest (loRaWANDataRequestParams, packet);
     return true;
   } else if (m_deviceType == LORAWAN_DT_GATEWAY) {
@@ -563,6 +666,8 @@ LoRaWANNetDevice::Send (Ptr<Packet> packet, const Address& dest, uint16_t protoc
     uint8_t macIndex = 0;
     if (getMACSIndexForChannelAndDataRate (macIndex, channelIndex, dataRateIndex)) {
       if (macIndex >= 0 && macIndex < this->m_macs.size ()) {
+        if (!this->m_macs[macIndex])
+          BuildGatewayChannel (channelIndex);
         this->m_macs[macIndex]->sendMACPayloadRequest (loRaWANDataRequestParams, packet);
         return true;
       } else {
@@ -582,10 +687,11 @@ LoRaWANNetDevice::Send (Ptr<Packet> packet, const Address& dest, uint16_t protoc
 bool
 LoRaWANNetDevice::getMACSIndexForChannelAndDataRate (uint8_t& macsIndex, uint8_t channelIndex, uint8_t dataRateIndex)
 {
-  if (channelIndex >= LoRaWAN::m_supportedChannels.size() || dataRateIndex >= LoRaWAN::m_supportedDataRates.size())
+  const int16_t index = LoRaWAN::GetGatewayPhyIndex (channelIndex, dataRateIndex);
+  if (index < 0)
     return false;
 
-  macsIndex = channelIndex*LoRaWAN::m_supportedDataRates.size() + dataRateIndex;
+  macsIndex = index;
   return true;
 }
 
@@ -594,10 +700,13 @@ LoRaWANNetDevice::MacBeginsTx (Ptr<LoRaWANMac> macPtr)
 {
   NS_ASSERT (m_deviceType == LORAWAN_DT_GATEWAY);
 
+  m_gatewayTx = true;
+
   // Switch all MACs (including macPtr) to MAC_UNAVAILABLE state
   for (uint8_t i = 0; i < m_macs.size (); i++) {
     Ptr<LoRaWANMac> mac = m_macs[i];
-    NS_ASSERT(mac);
+    if (!mac)
+      continue;
 
     // include macPtr, as we need to switch the PHY corresponding to macPtr OFF first, before we can switch it to TX_ON
     // if (mac == macPtr)
@@ -612,10 +721,13 @@ LoRaWANNetDevice::MacEndsTx (Ptr<LoRaWANMac> macPtr)
 {
   NS_ASSERT (m_deviceType == LORAWAN_DT_GATEWAY);
 
+  m_gatewayTx = false;
+
   // Switch all MACs and Phys except macPtr to MAC_IDLE state
   for (uint8_t i = 0; i < m_macs.size (); i++) {
     Ptr<LoRaWANMac> mac = m_macs[i];
-    NS_ASSERT(mac);
+    if (!mac)
+      continue;
 
     if (mac == macPtr)
       continue;
@@ -633,11 +745,18 @@ LoRaWANNetDevice::CanSendImmediatelyOnChannel (uint8_t channelIndex, uint8_t dat
     // step 1: check RDC restrictions
     if (this->m_macRDC->IsSubBandAvailable (subBandIndex)) {
       uint8_t macIndex = 0;
-      if (getMACSIndexForChannelAndDataRate (macIndex, channelIndex, dataRateIndex)) {
+      if (getMACSIndexForChannelAndDataRate (macIndex, channelIndex, dataRateIndex) && macIndex < m_macs.size ()) {
+        if (!this->m_macs[macIndex])
+          BuildGatewayChannel (channelIndex);
         // step2: check whether MAC object is in Idle state (could be in TX or unavailable)
         if (this->m_macs[macIndex]->GetLoRaWANMacState () == MAC_IDLE) {
           // step3: check whether a MAC event is scheduled (MAC state could be scheduled to go to TX state)
           if (!this->m_macs[macIndex]->IsLoRaWANMacStateRunning ()) {
+            // step4: a gateway has a single transmitter, so no other MAC may be about to transmit
+            for (uint8_t i = 0; i < m_macs.size (); i++) {
+              if (m_macs[i] && m_macs[i]->IsLoRaWANMacStateRunning ())
+                return false;
+            }
             return true;
           }
         }
@@ -651,6 +770,12 @@ LoRaWANNetDevice::CanSendImmediatelyOnChannel (uint8_t channelIndex, uint8_t dat
   return false;
 }
 
+Ptr<LoRaWANMac::LoRaWANMacRDC>
+LoRaWANNetDevice::GetMacRDC (void) const
+{
+  return m_macRDC;
+}
+
 bool
 LoRaWANNetDevice::SendFrom (Ptr<Packet> packet, const Address& source, const Address& dest, uint16_t protocolNumber)
 {
@@ -704,6 +829,10 @@ LoRaWANNetDevice::DataIndication (LoRaWANDataIndicationParams params, Ptr<Packet
   msgTypeTag.SetMsgType (params.m_msgType);
   pkt->AddPacketTag (msgTypeTag);
 
+  // The network server verifies the MIC of US frames
+  if (m_deviceType == LORAWAN_DT_GATEWAY)
+    pkt->AddPacketTag (LoRaWANMicTag (params.m_MIC));
+
   Address senderAddress(params.m_endDeviceAddress);
 
   m_receiveCallback (this, pkt, 0, senderAddress);
@@ -730,15 +859,20 @@ LoRaWANNetDevice::AssignStreams (int64_t stream)
 {
   NS_LOG_FUNCTION (stream);
   int64_t streamIndex = stream;
-  if (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_A) {
+  if (m_deviceType != LORAWAN_DT_GATEWAY) {
     streamIndex += m_phy->AssignStreams (stream);
   } else if (m_deviceType == LORAWAN_DT_GATEWAY) {
+    // Phys that are built later on draw their stream from the same range, one
+    // stream per phy
+    m_stream = stream;
     for (uint8_t i = 0; i < m_phys.size (); i++) {
       Ptr<LoRaWANPhy> phy = m_phys[i];
-      streamIndex += phy->AssignStreams (stream + i);
+      if (phy)
+        phy->AssignStreams (stream + i);
     }
+    streamIndex += LoRaWAN::GetGatewayPhyConfigs ().size ();
   } else {
-    NS_ASSERT_MSG (0, "Not implemented for non Class A end devices");
+    NS_ASSERT_MSG (0, "Not implemented for gateways");
   }
   NS_LOG_DEBUG ("Number of assigned RV streams:  " << (streamIndex - stream));
   return (streamIndex - stream);
@@ -24,6 +24,7 @@
 #include <ns3/traced-callback.h>
 #include <ns3/lorawan-phy.h>
 #include <ns3/lorawan-mac.h>
+#include <ns3/lorawan-gateway-phy.h>
 #include <ns3/lorawan.h>
 
 namespace ns3 {
@@ -42,6 +43,10 @@ public:
   static TypeId GetTypeId (void);
 
   LoRaWANNetDevice ();
+  /**
+   * \param deviceType a Class A or Class C end device, or a gateway. Class B
+   * end devices are not supported.
+   */
   LoRaWANNetDevice (LoRaWANDeviceType deviceType);
   virtual ~LoRaWANNetDevice ();
 
@@ -60,13 +65,29 @@ public:
    * \returns the mac we are currently using.
    */
   Ptr<LoRaWANMac> GetMac (void) const;
-  std::vector<Ptr<LoRaWANMac> > GetMacs (void) const;
+  /**
+   * \returns the macs of a gateway, one per channel and data rate (see
+   * LoRaWAN::GetGatewayPhyConfigs). A gateway with a shared receiver builds
+   * its macs and phys on demand, this builds all of them.
+   */
+  std::vector<Ptr<LoRaWANMac> > GetMacs (void);
 
   /**
    * \returns the phy we are currently using.
    */
   Ptr<LoRaWANPhy> GetPhy (void) const;
-  std::vector<Ptr<LoRaWANPhy> > GetPhys (void) const;
+  /**
+   * \returns the phys of a gateway, one per channel and data rate. A gateway
+   * with a shared receiver builds its macs and phys on demand, this builds all
+   * of them.
+   */
+  std::vector<Ptr<LoRaWANPhy> > GetPhys (void);
+
+  /**
+   * \returns the shared receiver front-end of a gateway, or 0 when the
+   * gateway PHYs are attached to the channel individually.
+   */
+  Ptr<LoRaWANGatewayPhy> GetGatewayPhy (void) const;
 
   //inherited from NetDevice base class.
   virtual void SetIfIndex (const uint32_t index);
@@ -100,7 +121,18 @@ public:
 
   bool CanSendImmediatelyOnChannel (uint8_t channelIndex, uint8_t dataRateIndex);
 
+  /**
+   * \return the RDC limitations shared by all MACs of this device
+   */
+  Ptr<LoRaWANMac::LoRaWANMacRDC> GetMacRDC (void) const;
+
   LoRaWANDeviceType GetDeviceType (void) const;
+
+  /**
+   * \return the number of transmissions of an unconfirmed US frame, see the
+   * NbRep attribute
+   */
+  uint8_t GetNbRep (void) const;
   // void SetDeviceType (LoRaWANDeviceType type);
 
   virtual Address GetMulticast (Ipv6Address addr) const;
@@ -155,13 +187,56 @@ private:
    */
   void CompleteConfig (void);
 
+  /**
+   * Build and configure the phy and mac of a gateway for a channel and data
+   * rate, unless they already exist.
+   *
+   * \param index the index of the config in LoRaWAN::GetGatewayPhyConfigs
+   */
+  void BuildGatewayPhyAndMac (uint8_t index);
+
+  /**
+   * Build the phys and macs of a gateway for all data rates of a channel.
+   * They are built per channel, so that the phys of a channel see all
+   * signals on the channel from its first signal onwards.
+   *
+   * \param channelIndex the channel
+   */
+  void BuildGatewayChannel (uint8_t channelIndex);
+
+  /**
+   * Get the phy of a gateway for a channel and data rate, building the phys
+   * and macs of the channel when needed (see GatewayPhyRequestCallback).
+   *
+   * \param channelIndex the channel
+   * \param dataRateIndex the data rate
+   * \return the phy, or 0 when the gateway does not support the channel and
+   * data rate
+   */
+  Ptr<LoRaWANPhy> RequestGatewayPhy (uint8_t channelIndex, uint8_t dataRateIndex);
+
   Ptr<Node> m_node;
   // For end device: One phy/mac
   Ptr<LoRaWANPhy> m_phy;
   Ptr<LoRaWANMac> m_mac;
-  // For gateways: multiple phys/macs (note one mac per phy)
+  // For gateways: multiple phys/macs (note one mac per phy), the entries of
+  // a gateway with a shared receiver are 0 until they are built
   std::vector<Ptr<LoRaWANPhy> > m_phys;
   std::vector<Ptr<LoRaWANMac> > m_macs;
+  // For gateways: receiver front-end shared by all phys
+  Ptr<LoRaWANGatewayPhy> m_gatewayPhy;
+  // For gateways: the channel that phys are attached to when they are built
+  Ptr<SpectrumChannel> m_channel;
+  // For gateways: the first stream of the phys (-1 when not assigned)
+  int64_t m_stream;
+  // For gateways: true while one of the macs is transmitting
+  bool m_gatewayTx;
+
+  /**
+   * Attach a single LoRaWANGatewayPhy to the channel on behalf of all gateway
+   * phys, instead of attaching every phy to the channel.
+   */
+  bool m_sharedGatewayReceiver;
 
   Ptr<LoRaWANMac::LoRaWANMacRDC> m_macRDC;
   LoRaWANDeviceType m_deviceType;
@@ -22,6 +22,8 @@
 #include "lorawan-spectrum-value-helper.h"
 #include "lorawan-error-model.h"
 #include "lorawan-lqi-tag.h"
+#include "lorawan-spectrum-channel.h"
+#include "lorawan-airtime.h"
 #include <ns3/log.h>
 #include <ns3/abort.h>
 #include <ns3/simulator.h>
@@ -122,12 +124,14 @@ LoRaWANPhy::LoRaWANPhy (uint8_t index)
   const uint32_t freq = LoRaWAN::m_supportedChannels [m_currentChannelIndex].m_fc;
   m_txPsd = psdHelper.CreateTxPowerSpectralDensity (m_txPower,
                                                     freq);
-  m_noise = psdHelper.CreateNoisePowerSpectralDensity (freq);
+  // The PHY can be tuned to any channel, so set the noise in all bands
+  m_noise = psdHelper.CreateNoisePowerSpectralDensity ();
   m_signal = Create<LoRaWANInterferenceHelper> (m_noise->GetSpectrumModel ());
   m_rxLastUpdate = Seconds (0);
   Ptr<Packet> none_packet = 0;
   Ptr<LoRaWANSpectrumSignalParameters> none_params = 0;
   m_currentRxPacket = std::make_pair (none_params, LoRaWANPhyRxStatus (true, false));
+  m_currentRxPsd = 0.0;
   m_currentTxPacket = std::make_pair (none_packet, true);
   m_errorModel = 0;
 
@@ -156,13 +160,17 @@ LoRaWANPhy::DoDispose (void)
   m_mobility = 0;
   m_device = 0;
   m_channel = 0;
+  m_loraWanChannel = 0;
   m_txPsd = 0;
   m_noise = 0;
   m_signal = 0;
+  m_expiringSignals = std::priority_queue<ExpiringSignal, std::vector<ExpiringSignal>, std::greater<ExpiringSignal> > ();
   m_errorModel = 0;
   m_pdDataIndicationCallback = MakeNullCallback< void, uint32_t, Ptr<Packet>, uint8_t, uint8_t, uint8_t, uint8_t > ();
   m_pdDataConfirmCallback = MakeNullCallback< void, LoRaWANPhyEnumeration > ();
   m_setTRXStateConfirmCallback = MakeNullCallback< void, LoRaWANPhyEnumeration > ();
+  m_demodulatorRequestCallback = MakeNullCallback< bool > ();
+  m_demodulatorReleaseCallback = MakeNullCallback< void > ();
 
   SpectrumPhy::DoDispose ();
 }
@@ -204,6 +212,7 @@ LoRaWANPhy::SetChannel (Ptr<SpectrumChannel> c)
 {
   NS_LOG_FUNCTION (this << c);
   m_channel = c;
+  m_loraWanChannel = DynamicCast<LoRaWANSpectrumChannel> (c);
 }
 
 
@@ -285,9 +294,7 @@ LoRaWANPhy::SetTxConf (int8_t power, uint8_t channelIndex, uint8_t dataRateIndex
 
   PrintCurrentTxConf();
 
-  const LoRaWANChannel* channel = &LoRaWAN::m_supportedChannels[channelIndex];
-  const LoRaWANDataRate* dataRate = &LoRaWAN::m_supportedDataRates[dataRateIndex];
-  if (channel == NULL || dataRate == NULL) {
+  if (channelIndex >= LoRaWAN::m_supportedChannels.size () || dataRateIndex >= LoRaWAN::m_supportedDataRates.size ()) {
     NS_LOG_ERROR(this << " Cannot set TX config due to invalid channel or data rate index");
     return false;
   }
@@ -300,10 +307,14 @@ LoRaWANPhy::SetTxConf (int8_t power, uint8_t channelIndex, uint8_t dataRateIndex
 
   // validate input:
   bool validConf = true;
-  if (!(power == 27 || power == 20 || power == 14 || power == 11 || power == 8 || power == 5 || power == 2)) // as per LoRaWAN $7.1.3
+  if (!LoRaWAN::IsValidTxPower (power)) // as per the TX power table of the region
+    validConf = false;
+
+  const LoRaWANChannel* channel = &LoRaWAN::m_supportedChannels[channelIndex];
+  if (channel->m_bw != 125e3 && channel->m_bw != 250e3 && channel->m_bw != 500e3)
     validConf = false;
 
-  if (channel->m_bw != 125e3) // only 125KHz is supported for the moment
+  if (LoRaWAN::m_supportedDataRates[dataRateIndex].bandWith == 0) // RFU data rate
     validConf = false;
 
   if (codeRate != 1 && codeRate != 2 && codeRate != 3 && codeRate != 4)
@@ -319,6 +330,12 @@ LoRaWANPhy::SetTxConf (int8_t power, uint8_t channelIndex, uint8_t dataRateIndex
 
   m_txPower = power;
   // TODO: changing the channel should corrupt any ongoing packet reception/transmission
+  if (channelIndex != m_currentChannelIndex)
+    {
+      // A LoRaWANSpectrumChannel only delivers transmissions on the channel we are tuned to
+      if (m_loraWanChannel)
+        m_loraWanChannel->RetuneRx (this, channelIndex);
+    }
   m_currentChannelIndex = channelIndex;
   m_currentDataRateIndex = dataRateIndex;
   m_codeRate = codeRate;
@@ -468,7 +485,22 @@ LoRaWANPhy::ChangeTrxState (LoRaWANPhyEnumeration newState)
 {
   NS_LOG_LOGIC (this << " state: " << m_trxState << " -> " << newState);
   //m_trxStateLogger (Simulator::Now (), m_trxState, newState);
+  if (!m_loraWanChannel)
+    {
+      m_trxState = newState;
+      return;
+    }
+
+  const bool wasListening = IsRxListening ();
   m_trxState = newState;
+  if (wasListening != IsRxListening ())
+    m_loraWanChannel->NotifyRxListening (this, !wasListening);
+}
+
+bool
+LoRaWANPhy::IsRxListening (void) const
+{
+  return m_trxState == LORAWAN_PHY_RX_ON || m_trxState == LORAWAN_PHY_BUSY_RX;
 }
 
 bool
@@ -507,39 +539,123 @@ LoRaWANPhy::SetSetTRXStateConfirmCallback (SetTRXStateConfirmCallback c)
   m_setTRXStateConfirmCallback = c;
 }
 
+void
+LoRaWANPhy::SetDemodulatorCallbacks (DemodulatorRequestCallback request, DemodulatorReleaseCallback release)
+{
+  NS_LOG_FUNCTION (this);
+  m_demodulatorRequestCallback = request;
+  m_demodulatorReleaseCallback = release;
+}
+
+bool
+LoRaWANPhy::StartCapturedRx (Ptr<LoRaWANSpectrumSignalParameters> params)
+{
+  NS_LOG_FUNCTION (this << params);
+
+  if (m_trxState != LORAWAN_PHY_RX_ON || m_setTRXState.IsRunning ())
+    {
+      NS_LOG_DEBUG (this << " transceiver not in RX state (state = " << m_trxState << ")");
+      m_phyRxDropTrace (params->packet, LORAWAN_RX_DROP_NOT_IN_RX_STATE);
+      return false;
+    }
+
+  m_phyRxBeginTrace (params->packet);
+  return true;
+}
+
+void
+LoRaWANPhy::EndCapturedRx (Ptr<LoRaWANSpectrumSignalParameters> params, double rxPsd, bool destroyed)
+{
+  NS_LOG_FUNCTION (this << params << rxPsd << destroyed);
+
+  Ptr<Packet> p = params->packet;
+  NS_ASSERT (p != 0);
+
+  // A transmission on this PHY aborts the reception
+  if (m_trxState == LORAWAN_PHY_BUSY_TX || m_trxState == LORAWAN_PHY_TX_ON)
+    {
+      m_phyRxDropTrace (p, LORAWAN_RX_DROP_PACKET_ABORTED);
+      return;
+    }
+
+  LoRaWANLqiTag tag (std::numeric_limits<uint8_t>::max ());
+  p->PeekPacketTag (tag);
+  m_phyRxEndTrace (p, tag.Get ());
+
+  if (destroyed)
+    {
+      m_phyRxDropTrace (p, LORAWAN_RX_DROP_PACKET_DESTOYED);
+      if (!m_pdDataDestroyedCallback.IsNull ())
+        m_pdDataDestroyedCallback ();
+    }
+  else if (!m_pdDataIndicationCallback.IsNull ())
+    {
+      AddRxMetadataTag (p, params->channelIndex, rxPsd);
+      m_pdDataIndicationCallback (p->GetSize (), p, 0, params->channelIndex, params->dataRateIndex, params->codeRate);
+    }
+}
+
+void
+LoRaWANPhy::DropCapturedRx (Ptr<const Packet> p, LoRaWANPhyDropRxReason reason)
+{
+  NS_LOG_FUNCTION (this << p << reason);
+  m_phyRxDropTrace (p, reason);
+}
+
 void
 LoRaWANPhy::StartRx (Ptr<SpectrumSignalParameters> spectrumRxParams)
 {
   NS_LOG_FUNCTION (this << spectrumRxParams);
 
-  LoRaWANSpectrumValueHelper psdHelper;
-
   Ptr<LoRaWANSpectrumSignalParameters> loraWanRxParams = DynamicCast<LoRaWANSpectrumSignalParameters> (spectrumRxParams);
+  if (loraWanRxParams)
+    {
+      // The bands of the LoRaWAN SpectrumModel coincide with the channels in
+      // LoRaWAN::m_supportedChannels, so the channel index is the band index.
+      StartLoRaWANRx (loraWanRxParams, (*spectrumRxParams->psd)[loraWanRxParams->channelIndex]);
+      return;
+    }
+
+  // reception is not a LoRaWAN packet: count it as noise
+  CheckInterference ();
+  m_signal->AddSignal (spectrumRxParams->psd);
+
+  // Schedule EndInterference to update m_signal when the transmission of the incoming signal has ended
+  Simulator::Schedule (spectrumRxParams->duration, &LoRaWANPhy::EndInterference, this, spectrumRxParams);
+}
+
+void
+LoRaWANPhy::StartLoRaWANRx (Ptr<LoRaWANSpectrumSignalParameters> loraWanRxParams, double rxPsd)
+{
+  NS_LOG_FUNCTION (this << loraWanRxParams << rxPsd);
+
   // If the channel of the transmission and the don't match, just return immediatly.
   // This is a workaround for a SpectrumPhy limitation where even in cases when the PSD of the incoming signalling has very very small power (-infinity in this case), we are still adding it as interference and calling EndRx (this clutters tracing output and wastes CPU time)
   // If the data rate of the transmission and the PHY don't match, do not attempt to receive the transmission; instead just count the transmission as noise
   // IRL the RX Phy would not lock onto a Preamble with different SF. In simulator we have to explicitly check the SF.
-  bool channelMismatch = false;
-  bool dataRateMismatch = false;
-  if (loraWanRxParams) {
-    channelMismatch = loraWanRxParams->channelIndex != m_currentChannelIndex;
-    dataRateMismatch = loraWanRxParams->dataRateIndex != m_currentDataRateIndex;
-  }
-
-  if (channelMismatch) {
+  if (loraWanRxParams->channelIndex != m_currentChannelIndex) {
     return; // just do nothing
   }
 
-  if (loraWanRxParams == 0 || dataRateMismatch)
-    { // reception is not a LoRaWAN packet or is a LoRaWAN transmission with a different data rate
+  // The signal parameters are shared by all receivers, so the interference
+  // helper identifies the signal by its parameters
+  const LoRaSpreadingFactor sf = LoRaWAN::m_supportedDataRates [loraWanRxParams->dataRateIndex].spreadingFactor;
+  ExpiringSignal expiring;
+  expiring.end = Simulator::Now () + loraWanRxParams->duration;
+  expiring.params = loraWanRxParams;
+
+  if (loraWanRxParams->dataRateIndex != m_currentDataRateIndex)
+    { // reception is a LoRaWAN transmission with a different data rate
       CheckInterference ();
-      m_signal->AddSignal (spectrumRxParams->psd);
+      m_signal->AddSignal (PeekPointer (loraWanRxParams), m_currentChannelIndex, rxPsd, sf);
 
-      // Schedule EndRx to update m_signal when the transmission of the incoming signal has ended
-      Simulator::Schedule (spectrumRxParams->duration, &LoRaWANPhy::EndRx, this, spectrumRxParams);
+      // Remove the signal from m_signal once it has ended, without an event
+      m_expiringSignals.push (expiring);
       return;
     }
 
+  RemoveExpiredSignals ();
+
   Ptr<Packet> p = loraWanRxParams->packet;
   NS_ASSERT (p != 0);
 
@@ -562,37 +678,37 @@ LoRaWANPhy::StartRx (Ptr<SpectrumSignalParameters> spectrumRxParams)
 
       // Add any incoming packet to the current interference before checking the
       // SINR.
-      const uint32_t freq = LoRaWAN::m_supportedChannels [m_currentChannelIndex].m_fc;
       const uint32_t bw = LoRaWAN::m_supportedChannels [m_currentChannelIndex].m_bw;
-      const uint8_t transmissionDataRateIndex = loraWanRxParams->dataRateIndex;
       const uint8_t transmissionCodeRate = loraWanRxParams->codeRate;
-      const LoRaSpreadingFactor sf = LoRaWAN::m_supportedDataRates [transmissionDataRateIndex].spreadingFactor;
 
       NS_LOG_DEBUG (this << " channel index = " << static_cast<uint16_t>(m_currentChannelIndex));
-      NS_LOG_DEBUG (this << " receiving packet with power: " << 10 * log10 (LoRaWANSpectrumValueHelper::TotalAvgPower (loraWanRxParams->psd, freq)) + 30 << "dBm");
+      NS_LOG_DEBUG (this << " receiving packet with power: " << 10 * log10 (rxPsd * bw) + 30 << "dBm");
 
-      m_signal->AddSignal (loraWanRxParams->psd);
-      Ptr<SpectrumValue> interferenceAndNoise = m_signal->GetSignalPsd ();
-      *interferenceAndNoise -= *loraWanRxParams->psd;
-      *interferenceAndNoise += *m_noise;
+      m_signal->AddSignal (PeekPointer (loraWanRxParams), m_currentChannelIndex, rxPsd, sf);
 
-      double sinr_db = 10.0 * log10 (LoRaWANSpectrumValueHelper::TotalAvgPower (loraWanRxParams->psd, freq) / LoRaWANSpectrumValueHelper::TotalAvgPower (interferenceAndNoise, freq));
+      double sinr_db = 10.0 * log10 (CalculateSinr (rxPsd));
       double sinr_cutoff_db = m_errorModel->getSNRCutoffForRX (bw, sf, transmissionCodeRate);
 
       // When the BER is higher than 0.1 do not even try and decode the packet
       // BER=0.1 is reached for a different SINR threshold depending on the spreading factor
-      if (sinr_db > sinr_cutoff_db)
+      if (sinr_db <= sinr_cutoff_db)
+        {
+          m_phyRxDropTrace (p, LORAWAN_RX_DROP_SINR_TOO_LOW);
+        }
+      else if (!m_demodulatorRequestCallback.IsNull () && !m_demodulatorRequestCallback ())
+        {
+          // All demodulator paths of the gateway are locked onto other packets
+          m_phyRxDropTrace (p, LORAWAN_RX_DROP_NO_DEMODULATOR);
+        }
+      else
         {
           ChangeTrxState (LORAWAN_PHY_BUSY_RX);
           m_currentRxPacket = std::make_pair (loraWanRxParams, LoRaWANPhyRxStatus (false, false));
+          m_currentRxPsd = rxPsd;
           m_phyRxBeginTrace (p);
 
           m_rxLastUpdate = Simulator::Now ();
         }
-      else
-        {
-          m_phyRxDropTrace (p, LORAWAN_RX_DROP_SINR_TOO_LOW);
-        }
     }
   else if (m_trxState == LORAWAN_PHY_BUSY_RX)
     {
@@ -606,7 +722,7 @@ LoRaWANPhy::StartRx (Ptr<SpectrumSignalParameters> spectrumRxParams)
       // Add the incoming packet to the current interference after we have
       // checked for successfull reception of the current packet for the time
       // before the additional interference.
-      m_signal->AddSignal (loraWanRxParams->psd);
+      m_signal->AddSignal (PeekPointer (loraWanRxParams), m_currentChannelIndex, rxPsd, sf);
     }
   else
     {
@@ -615,20 +731,81 @@ LoRaWANPhy::StartRx (Ptr<SpectrumSignalParameters> spectrumRxParams)
       m_phyRxDropTrace (p, LORAWAN_RX_DROP_NOT_IN_RX_STATE);
 
       // Add the signal power to the interference, anyway.
-      m_signal->AddSignal (loraWanRxParams->psd);
+      m_signal->AddSignal (PeekPointer (loraWanRxParams), m_currentChannelIndex, rxPsd, sf);
     }
 
-  // Always call EndRx to update the interference.
+  // Only the received packet needs an EndRx event, other signals are removed
+  // from the interference once they have ended (see RemoveExpiredSignals).
   // \todo: Do we need to keep track of these events to unschedule them when disposing off the PHY?
+  if (m_currentRxPacket.first == loraWanRxParams)
+    Simulator::Schedule (loraWanRxParams->duration, &LoRaWANPhy::EndRx, this, loraWanRxParams);
+  else
+    m_expiringSignals.push (expiring);
+}
+
+void
+LoRaWANPhy::AddInterference (Ptr<LoRaWANSpectrumSignalParameters> loraWanRxParams, double rxPsd, Time end)
+{
+  NS_LOG_FUNCTION (this << loraWanRxParams << rxPsd << end);
+
+  if (loraWanRxParams->channelIndex != m_currentChannelIndex)
+    return;
+
+  CheckInterference ();
+  const LoRaSpreadingFactor sf = LoRaWAN::m_supportedDataRates [loraWanRxParams->dataRateIndex].spreadingFactor;
+  if (m_signal->AddSignal (PeekPointer (loraWanRxParams), m_currentChannelIndex, rxPsd, sf))
+    {
+      ExpiringSignal expiring;
+      expiring.end = end;
+      expiring.params = loraWanRxParams;
+      m_expiringSignals.push (expiring);
+    }
+}
+
+void
+LoRaWANPhy::RemoveExpiredSignals (void)
+{
+  const Time now = Simulator::Now ();
+  while (!m_expiringSignals.empty () && m_expiringSignals.top ().end <= now)
+    {
+      m_signal->RemoveSignal (PeekPointer (m_expiringSignals.top ().params));
+      m_expiringSignals.pop ();
+    }
+}
+
+double
+LoRaWANPhy::CalculateSinr (double rxPsd) const
+{
+  // The bands of the LoRaWAN SpectrumModel coincide with the channels in
+  // LoRaWAN::m_supportedChannels, so the channel index is the band index.
+  const uint32_t band = m_currentChannelIndex;
 
-  Simulator::Schedule (spectrumRxParams->duration, &LoRaWANPhy::EndRx, this, spectrumRxParams);
+  // Clamp rounding errors of the running interference sum
+  double interference = m_signal->GetSignalPsd (band) - rxPsd;
+  if (interference < 0.0)
+    interference = 0.0;
+
+  return rxPsd / (interference + (*m_noise)[band]);
+}
+
+void
+LoRaWANPhy::AddRxMetadataTag (Ptr<Packet> p, uint8_t channelIndex, double rxPsd) const
+{
+  // The packet is shared by all receivers of the transmission, but the MAC
+  // copies it (including its tags) before passing it up the stack
+  const uint32_t bw = LoRaWAN::m_supportedChannels [channelIndex].m_bw;
+  LoRaWANRxMetadataTag tag;
+  tag.SetRssi (10.0 * log10 (rxPsd * bw) + 30.0);
+  tag.SetSnr (10.0 * log10 (rxPsd / (*m_noise)[channelIndex]));
+  p->ReplacePacketTag (tag);
 }
 
 void
 LoRaWANPhy::CheckInterference (void)
 {
+  RemoveExpiredSignals ();
+
   // Calculate whether packet was lost.
-  LoRaWANSpectrumValueHelper psdHelper;
   Ptr<LoRaWANSpectrumSignalParameters> currentRxParams = m_currentRxPacket.first;
 
   // We are currently receiving a packet.
@@ -642,12 +819,7 @@ LoRaWANPhy::CheckInterference (void)
           // How many bits did we receive since the last calculation?
           double t = (Simulator::Now () - m_rxLastUpdate).ToDouble (Time::MS);
           uint32_t chunkSize = ceil (t * (GetNominalDataRate () / 1000)); // divide by 1000, to get data rate per ms
-          Ptr<SpectrumValue> interferenceAndNoise = m_signal->GetSignalPsd ();
-          *interferenceAndNoise -= *currentRxParams->psd;
-          *interferenceAndNoise += *m_noise;
-
-          double sinr = LoRaWANSpectrumValueHelper::TotalAvgPower (currentRxParams->psd, LoRaWAN::m_supportedChannels [m_currentChannelIndex].m_fc) / LoRaWANSpectrumValueHelper::TotalAvgPower (interferenceAndNoise, LoRaWAN::m_supportedChannels [m_currentChannelIndex].m_fc);
-          double sinr_db = 10.0*log10(sinr);
+          double sinr_db = 10.0*log10(CalculateSinr (m_currentRxPsd));
 
           const uint8_t transmissionDataRateIndex = currentRxParams->dataRateIndex;
           const uint8_t transmissionCodeRate = currentRxParams->codeRate;
@@ -677,11 +849,19 @@ LoRaWANPhy::CheckInterference (void)
 }
 
 void
-LoRaWANPhy::EndRx (Ptr<SpectrumSignalParameters> par)
+LoRaWANPhy::EndInterference (Ptr<SpectrumSignalParameters> params)
 {
   NS_LOG_FUNCTION (this);
 
-  Ptr<LoRaWANSpectrumSignalParameters> params = DynamicCast<LoRaWANSpectrumSignalParameters> (par);
+  // Update the interference.
+  m_signal->RemoveSignal (params->psd);
+  NS_LOG_LOGIC ("Node: " << m_device->GetAddress() << " Removing interferent: " << *(params->psd));
+}
+
+void
+LoRaWANPhy::EndRx (Ptr<LoRaWANSpectrumSignalParameters> params)
+{
+  NS_LOG_FUNCTION (this);
 
   Ptr<LoRaWANSpectrumSignalParameters> currentRxParams = m_currentRxPacket.first;
   if (currentRxParams == params)
@@ -690,16 +870,12 @@ LoRaWANPhy::EndRx (Ptr<SpectrumSignalParameters> par)
     }
 
   // Update the interference.
-  m_signal->RemoveSignal (par->psd);
+  m_signal->RemoveSignal (PeekPointer (params));
 
   // Check whether EndRx is called for the end of LoRaWAN TX with different data rate:
-  bool dataRateMismatch = false;
-  if (params)
-    dataRateMismatch = params->dataRateIndex != m_currentDataRateIndex;
-
-  if (params == 0 || dataRateMismatch)
+  if (params->dataRateIndex != m_currentDataRateIndex)
     {
-      NS_LOG_LOGIC ("Node: " << m_device->GetAddress() << " Removing interferent: " << *(par->psd));
+      NS_LOG_LOGIC ("Node: " << m_device->GetAddress() << " Removing interferent: " << params);
       return;
     }
 
@@ -719,6 +895,7 @@ LoRaWANPhy::EndRx (Ptr<SpectrumSignalParameters> par)
           // The packet was successfully received, push it up the stack.
           if (!m_pdDataIndicationCallback.IsNull ())
             {
+              AddRxMetadataTag (currentPacket, m_currentChannelIndex, m_currentRxPsd);
               m_pdDataIndicationCallback (currentPacket->GetSize (), currentPacket, 0, m_currentChannelIndex, params->dataRateIndex, params->codeRate);
             }
         }
@@ -735,6 +912,10 @@ LoRaWANPhy::EndRx (Ptr<SpectrumSignalParameters> par)
         }
       Ptr<LoRaWANSpectrumSignalParameters> none = 0;
       m_currentRxPacket = std::make_pair (none, LoRaWANPhyRxStatus (true, false));
+      if (!m_demodulatorReleaseCallback.IsNull ())
+        {
+          m_demodulatorReleaseCallback ();
+        }
 
       // In case the ongoing reception was aborted by a transmission on this PHY,
       // then m_currentRxPacket.second will have been false but also the PHY state
@@ -785,6 +966,8 @@ LoRaWANPhy::PdDataRequest (const uint32_t phyPayloadLength, Ptr<Packet> p)
       // Remove a possible LQI tag from a previous transmission of the packet.
       LoRaWANLqiTag lqiTag;
       p->RemovePacketTag (lqiTag);
+      LoRaWANRxMetadataTag rxMetadataTag;
+      p->RemovePacketTag (rxMetadataTag);
 
       m_phyTxBeginTrace (p);
       m_currentTxPacket.first = p;
@@ -862,61 +1045,28 @@ LoRaWANPhy::EndTx (void)
 Time
 LoRaWANPhy::CalculateTxTime (uint8_t payloadLength)
 {
-  // calculations per $4.1.1.7 'Time on air' in sx1272 data sheet
-  const uint32_t bandwidth = LoRaWAN::m_supportedChannels [m_currentChannelIndex].m_bw;
-  const LoRaSpreadingFactor sf = LoRaWAN::m_supportedDataRates [m_currentDataRateIndex].spreadingFactor;
-
-  double symbolRate = ((double)bandwidth)/pow(2.0, sf);
-  double symbolPeriod = 1.0e6/symbolRate; // the symbol period in microseconds
-
-  double nSymbolsPreamble = m_preambleLength + 4.25;
-  uint16_t nSymbolsPayload = 8;
+  // calculations per $4.1.1.7 'Time on air' in sx1272 data sheet, see LoRaWANAirtime
   // LoRaWAN mandates no imlicit header, assume low data rate optimization (DE) is not used
-  uint32_t crc = 1;
-  if (!m_crcOn)
-    crc = 0;
+  Time txTime = LoRaWANAirtime::GetTimeOnAir (m_currentDataRateIndex, m_codeRate, payloadLength, m_preambleLength, m_crcOn, false);
 
-  uint16_t nConditionalSymbolsPayload = ceil((8.0*payloadLength - 4.0*sf + 28 + 16*crc)/4.0/(double)sf)*(m_codeRate + 4);
-  if (nConditionalSymbolsPayload > 0.0)
-    nSymbolsPayload += nConditionalSymbolsPayload;
+  NS_LOG_DEBUG(this << ": " << (uint16_t)m_currentDataRateIndex  << "|" << (uint16_t)m_codeRate  << "|" << (uint16_t)payloadLength
+      << "|" << (uint16_t) m_preambleLength  << "|" << txTime);
 
-  double txTime = (nSymbolsPreamble + nSymbolsPayload) * symbolPeriod;
-
-  NS_LOG_DEBUG(this << ": " << sf  << "|" << (uint16_t)m_codeRate  << "|" << (uint16_t)payloadLength
-      << "|" << (uint16_t) m_preambleLength  << "|" << nSymbolsPayload  << "|" << nConditionalSymbolsPayload
-      << "|" << txTime << "uS");
-
-  return MicroSeconds(txTime);
+  return txTime;
 }
 
 Time
 LoRaWANPhy::CalculatePreambleTime ()
 {
-  const uint32_t bandwidth = LoRaWAN::m_supportedChannels [m_currentChannelIndex].m_bw;
-  const LoRaSpreadingFactor sf = LoRaWAN::m_supportedDataRates [m_currentDataRateIndex].spreadingFactor;
-
-  double symbolRate = ((double)bandwidth)/pow(2.0, sf);
-  double symbolPeriod = 1.0e6/symbolRate; // the symbol period in microseconds
-
-  double nSymbolsPreamble = m_preambleLength + 4.25;
-  double timePreamble = nSymbolsPreamble * symbolPeriod;
-
-  return MicroSeconds(timePreamble);
+  return LoRaWANAirtime::GetPreambleTime (m_currentDataRateIndex, m_preambleLength);
 }
 
 /* Returns the nominal PHY data rate */
 double
 LoRaWANPhy::GetNominalDataRate ()
 {
-  // calculations per $4.1.1.7 'Time on air' in sx1272 data sheet
-  const uint32_t bandwidth = LoRaWAN::m_supportedChannels [m_currentChannelIndex].m_bw;
-  const LoRaSpreadingFactor sf = LoRaWAN::m_supportedDataRates [m_currentDataRateIndex].spreadingFactor;
-
-  double symbolRate = bandwidth/pow(2.0, sf);
   // TODO: return data rate of information stream, not code words stream
-
-  // data rate is number of bits per symbol (i.e. SF) times number of symbols per second (i.e. Rs, symbol rate)
-  return sf * symbolRate;
+  return LoRaWANAirtime::GetNominalDataRate (m_currentDataRateIndex);
 }
 
 int64_t
@@ -26,6 +26,10 @@
 #include <ns3/traced-callback.h>
 #include <ns3/traced-value.h>
 #include <ns3/event-id.h>
+#include <ns3/nstime.h>
+#include <queue>
+#include <vector>
+#include <functional>
 
 namespace ns3 {
 /* ... */
@@ -36,6 +40,7 @@ class LoRaWANErrorModel;
 struct LoRaWANSpectrumSignalParameters;
 class MobilityModel;
 class SpectrumChannel;
+class LoRaWANSpectrumChannel;
 class SpectrumModel;
 class AntennaModel;
 class NetDevice;
@@ -66,6 +71,8 @@ typedef enum
   LORAWAN_RX_DROP_PACKET_DESTOYED = 0x03,
   LORAWAN_RX_DROP_ABORTED = 0x04,
   LORAWAN_RX_DROP_PACKET_ABORTED = 0x05,
+  LORAWAN_RX_DROP_NO_DEMODULATOR = 0x06,
+  LORAWAN_RX_DROP_CAPTURED = 0x07,
 } LoRaWANPhyDropRxReason;
 
 typedef struct LoRaWANPhyRxStatus {
@@ -143,6 +150,23 @@ typedef Callback< void, LoRaWANPhyEnumeration > PdDataConfirmCallback;
  */
 typedef Callback< void, LoRaWANPhyEnumeration > SetTRXStateConfirmCallback;
 
+/**
+ * \ingroup lorawan
+ *
+ * Reserve a demodulator path on the gateway receiver before locking onto a
+ * packet.
+ *
+ * @return true if a demodulator path was reserved
+ */
+typedef Callback< bool > DemodulatorRequestCallback;
+
+/**
+ * \ingroup lorawan
+ *
+ * Release a demodulator path reserved with DemodulatorRequestCallback.
+ */
+typedef Callback< void > DemodulatorReleaseCallback;
+
 /**
  * \ingroup lorawan
  *
@@ -171,6 +195,13 @@ public:
 
   uint8_t GetCurrentChannelIndex () const { return m_currentChannelIndex; }
   uint8_t GetCurrentDataRateIndex () const { return m_currentDataRateIndex; }
+  double GetTxPower () const { return m_txPower; } // in dBm
+  LoRaWANPhyEnumeration GetTRXState () const { return m_trxState; }
+
+  /**
+   * \return true if the transceiver is in the RX_ON or BUSY_RX state
+   */
+  bool IsRxListening (void) const;
 
   /**
    * Calculate the time for transmitting the given packet in microseconds
@@ -243,6 +274,31 @@ public:
     */
   virtual void StartRx (Ptr<SpectrumSignalParameters> params);
 
+  /**
+   * Notify the PHY of an incoming LoRa signal. The signal parameters are
+   * shared by all receivers of the transmission and are not modified, only
+   * the received power spectral density is specific to this receiver. The
+   * PSD of the signal parameters is the transmitted PSD.
+   *
+   * \param params the signal parameters of the transmission
+   * \param rxPsd the received power spectral density in the band of the
+   * channel of the transmission
+   */
+  void StartLoRaWANRx (Ptr<LoRaWANSpectrumSignalParameters> params, double rxPsd);
+
+  /**
+   * Add a LoRa signal that is already being received to the interference,
+   * without attempting to receive it. Used by a LoRaWANSpectrumChannel that
+   * did not deliver the signal while the PHY was not listening (see the
+   * DetachSleepingRx attribute).
+   *
+   * \param params the signal parameters of the transmission
+   * \param rxPsd the received power spectral density in the band of the
+   * channel of the transmission
+   * \param end the time at which the signal ends at this receiver
+   */
+  void AddInterference (Ptr<LoRaWANSpectrumSignalParameters> params, double rxPsd, Time end);
+
   /**
    * set the error model to use
    *
@@ -288,6 +344,44 @@ public:
    */
   void SetSetTRXStateConfirmCallback (SetTRXStateConfirmCallback c);
 
+  /**
+   * set the callbacks used to reserve and release a demodulator path on a
+   * shared gateway receiver (see LoRaWANGatewayPhy). When not set, the PHY
+   * can always lock onto an incoming packet.
+   * @param request the callback for reserving a demodulator
+   * @param release the callback for releasing a demodulator
+   */
+  void SetDemodulatorCallbacks (DemodulatorRequestCallback request, DemodulatorReleaseCallback release);
+
+  /**
+   * Start the reception of a packet that was locked onto by the capture
+   * model of a LoRaWANGatewayPhy. The PHY does not change its state, as the
+   * gateway PHY keeps track of the reception.
+   *
+   * @param params the parameters of the received signal
+   * @return true if the PHY is in the RX_ON state and accepts the reception,
+   * otherwise the packet is dropped
+   */
+  bool StartCapturedRx (Ptr<LoRaWANSpectrumSignalParameters> params);
+
+  /**
+   * End the reception of a packet that was accepted by StartCapturedRx, and
+   * push the packet up the stack when it was successfully received.
+   *
+   * @param params the parameters of the received signal
+   * @param rxPsd the received power spectral density of the signal
+   * @param destroyed true if the packet was destroyed by interference
+   */
+  void EndCapturedRx (Ptr<LoRaWANSpectrumSignalParameters> params, double rxPsd, bool destroyed);
+
+  /**
+   * Drop a packet on behalf of the capture model of a LoRaWANGatewayPhy.
+   *
+   * @param p the dropped packet
+   * @param reason the reason for dropping the packet
+   */
+  void DropCapturedRx (Ptr<const Packet> p, LoRaWANPhyDropRxReason reason);
+
   /**
    * Get the duration of the SHR (preamble and SFD) in symbols, depending on
    * the currently selected channel.
@@ -359,6 +453,26 @@ private:
    */
   void EndTx (void);
 
+  /**
+   * Calculate the SINR of a signal that is part of the current interference,
+   * on the channel the PHY is tuned to.
+   *
+   * \param rxPsd the received power spectral density of the signal in the
+   * band of the channel
+   * \return the SINR (linear)
+   */
+  double CalculateSinr (double rxPsd) const;
+
+  /**
+   * Tag a received packet with its RSSI and SNR (see LoRaWANRxMetadataTag).
+   *
+   * \param p the received packet
+   * \param channelIndex the channel of the transmission
+   * \param rxPsd the received power spectral density of the signal in the
+   * band of the channel
+   */
+  void AddRxMetadataTag (Ptr<Packet> p, uint8_t channelIndex, double rxPsd) const;
+
   /**
    * Check if the interference destroys a frame currently received. Called
    * whenever a change in interference is detected.
@@ -375,7 +489,24 @@ private:
    *
    * \param params signal parameters of the packet
    */
-  void EndRx (Ptr<SpectrumSignalParameters> params);
+  void EndRx (Ptr<LoRaWANSpectrumSignalParameters> params);
+
+  /**
+   * Remove the signals that have ended from the interference. Signals that
+   * are not received by the PHY (e.g. signals with another data rate) do not
+   * schedule an EndRx event, instead they are kept in m_expiringSignals and
+   * removed here whenever the interference is needed: in StartLoRaWANRx,
+   * CheckInterference and EndRx of the received packet.
+   */
+  void RemoveExpiredSignals (void);
+
+  /**
+   * Called at the end of a non-LoRaWAN signal, to remove it from the
+   * interference.
+   *
+   * \param params signal parameters of the signal
+   */
+  void EndInterference (Ptr<SpectrumSignalParameters> params);
 
   /**
    * Called after applying a deferred transceiver state switch. The result of
@@ -455,6 +586,12 @@ private:
    */
   Ptr<SpectrumChannel> m_channel;
 
+  /**
+   * m_channel if it is a LoRaWANSpectrumChannel, which is notified of channel
+   * and receiver state changes.
+   */
+  Ptr<LoRaWANSpectrumChannel> m_loraWanChannel;
+
   /**
    * The antenna used by the transceiver.
    */
@@ -509,6 +646,13 @@ private:
    */
   SetTRXStateConfirmCallback m_setTRXStateConfirmCallback;
 
+  /**
+   * These callbacks are used to reserve and release a demodulator path on a
+   * shared gateway receiver.
+   */
+  DemodulatorRequestCallback m_demodulatorRequestCallback;
+  DemodulatorReleaseCallback m_demodulatorReleaseCallback;
+
   /**
    * Helper value for the peak power value during CCA.
    */
@@ -526,6 +670,26 @@ private:
    */
   Ptr<LoRaWANInterferenceHelper> m_signal;
 
+  /**
+   * A signal in m_signal that is not received, and the time at which it ends.
+   */
+  struct ExpiringSignal
+  {
+    Time end;                                    //!< the end of the signal
+    Ptr<LoRaWANSpectrumSignalParameters> params; //!< the parameters of the signal
+    /**
+     * \param other another signal
+     * \return true if this signal ends after the other signal
+     */
+    bool operator> (const ExpiringSignal &other) const { return end > other.end; }
+  };
+
+  /**
+   * The signals in m_signal that are not received, as a min-heap on their end
+   * time (see RemoveExpiredSignals).
+   */
+  std::priority_queue<ExpiringSignal, std::vector<ExpiringSignal>, std::greater<ExpiringSignal> > m_expiringSignals;
+
   /**
    * Timestamp of the last calculation of the PER of a packet currently received.
    */
@@ -539,6 +703,11 @@ private:
    */
   std::pair<Ptr<LoRaWANSpectrumSignalParameters>, LoRaWANPhyRxStatus>  m_currentRxPacket;
 
+  /**
+   * The received power spectral density of the currently received packet.
+   */
+  double m_currentRxPsd;
+
   /**
    * Statusinformation of the currently transmitted packet. The first parameter
    * contains the frame. The second parameter is set to false, if the frame not
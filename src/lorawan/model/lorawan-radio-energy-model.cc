@@ -0,0 +1,301 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include "lorawan-radio-energy-model.h"
+#include <ns3/log.h>
+#include <ns3/double.h>
+#include <ns3/simulator.h>
+#include <ns3/trace-source-accessor.h>
+
+#include <cmath>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANRadioEnergyModel");
+
+NS_OBJECT_ENSURE_REGISTERED (LoRaWANRadioEnergyModel);
+
+TypeId
+LoRaWANRadioEnergyModel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoRaWANRadioEnergyModel")
+    .SetParent<DeviceEnergyModel> ()
+    .SetGroupName ("Energy")
+    .AddConstructor<LoRaWANRadioEnergyModel> ()
+    .AddAttribute ("SleepCurrentA",
+                   "The current draw in the sleep mode (TRX_OFF).",
+                   DoubleValue (0.0000002), // 0.2 uA
+                   MakeDoubleAccessor (&LoRaWANRadioEnergyModel::m_sleepCurrentA),
+                   MakeDoubleChecker<double> (0.0))
+    .AddAttribute ("IdleCurrentA",
+                   "The current draw in the standby mode (IDLE).",
+                   DoubleValue (0.0016), // 1.6 mA
+                   MakeDoubleAccessor (&LoRaWANRadioEnergyModel::m_idleCurrentA),
+                   MakeDoubleChecker<double> (0.0))
+    .AddAttribute ("RxCurrentA",
+                   "The current draw in the receive mode (RX_ON and BUSY_RX).",
+                   DoubleValue (0.0108), // 10.8 mA
+                   MakeDoubleAccessor (&LoRaWANRadioEnergyModel::m_rxCurrentA),
+                   MakeDoubleChecker<double> (0.0))
+    .AddAttribute ("SupplyVoltage",
+                   "The supply voltage in V when no energy source is set.",
+                   DoubleValue (3.3),
+                   MakeDoubleAccessor (&LoRaWANRadioEnergyModel::m_supplyVoltage),
+                   MakeDoubleChecker<double> (0.0))
+    .AddTraceSource ("TotalEnergyConsumption",
+                     "Total energy consumption of the radio device in J.",
+                     MakeTraceSourceAccessor (&LoRaWANRadioEnergyModel::m_totalEnergyConsumption),
+                     "ns3::TracedValueCallback::Double")
+  ;
+  return tid;
+}
+
+LoRaWANRadioEnergyModel::LoRaWANRadioEnergyModel ()
+  : m_currentState (LORAWAN_PHY_TRX_OFF),
+    m_txPower (0.0),
+    m_startTime (Simulator::Now ()),
+    m_lastUpdateTime (Simulator::Now ()),
+    m_totalChargeC (0.0),
+    m_totalEnergyConsumption (0.0),
+    m_nPendingChangeState (0),
+    m_isSupersededChangeState (false)
+{
+  NS_LOG_FUNCTION (this);
+
+  // Typical currents of the SX1276 data sheet: RFO pin up to 13 dBm and
+  // PA_BOOST pin above
+  m_txCurrentA[7] = 0.020;
+  m_txCurrentA[13] = 0.029;
+  m_txCurrentA[17] = 0.087;
+  m_txCurrentA[20] = 0.120;
+}
+
+LoRaWANRadioEnergyModel::~LoRaWANRadioEnergyModel ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+LoRaWANRadioEnergyModel::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_phy)
+    m_phy->TraceDisconnectWithoutContext ("TrxState", MakeCallback (&LoRaWANRadioEnergyModel::TrxStateChanged, this));
+  m_phy = 0;
+  m_source = 0;
+  m_energyDepletionCallback.Nullify ();
+  m_energyRechargedCallback.Nullify ();
+  DeviceEnergyModel::DoDispose ();
+}
+
+void
+LoRaWANRadioEnergyModel::SetPhy (Ptr<LoRaWANPhy> phy)
+{
+  NS_LOG_FUNCTION (this << phy);
+  NS_ASSERT (phy);
+  NS_ASSERT (!m_phy);
+  m_phy = phy;
+  m_phy->TraceConnectWithoutContext ("TrxState", MakeCallback (&LoRaWANRadioEnergyModel::TrxStateChanged, this));
+  ChangeState (m_phy->GetTRXState ());
+}
+
+void
+LoRaWANRadioEnergyModel::SetEnergySource (Ptr<EnergySource> source)
+{
+  NS_LOG_FUNCTION (this << source);
+  NS_ASSERT (source);
+  m_source = source;
+}
+
+double
+LoRaWANRadioEnergyModel::GetTotalEnergyConsumption (void) const
+{
+  const Time duration = Simulator::Now () - m_lastUpdateTime;
+  return m_totalEnergyConsumption + duration.GetSeconds () * GetStateCurrentA (m_currentState) * GetSupplyVoltage ();
+}
+
+void
+LoRaWANRadioEnergyModel::TrxStateChanged (LoRaWANPhyEnumeration oldState, LoRaWANPhyEnumeration newState)
+{
+  ChangeState (newState);
+}
+
+void
+LoRaWANRadioEnergyModel::ChangeState (int newState)
+{
+  NS_LOG_FUNCTION (this << newState);
+  NS_ASSERT (newState >= LORAWAN_PHY_TRX_OFF && newState <= LORAWAN_PHY_FORCE_TRX_OFF);
+
+  // Integrate the charge drawn in the state that is left
+  const Time now = Simulator::Now ();
+  const Time duration = now - m_lastUpdateTime;
+  NS_ASSERT (!duration.IsStrictlyNegative ());
+  const double chargeC = duration.GetSeconds () * GetStateCurrentA (m_currentState);
+  m_totalChargeC += chargeC;
+  m_totalEnergyConsumption += chargeC * GetSupplyVoltage ();
+  m_timeInState[m_currentState] += duration;
+  m_lastUpdateTime = now;
+
+  m_nPendingChangeState++;
+
+  // The source integrates the current draw of the state that is left, this
+  // may invoke the depletion callback, which may in turn change the state
+  if (m_source)
+    m_source->UpdateEnergySource ();
+
+  // A state change in a nested call happened after this one, so it should
+  // not be overwritten
+  if (!m_isSupersededChangeState)
+    {
+      m_currentState = static_cast<LoRaWANPhyEnumeration> (newState);
+      if ((m_currentState == LORAWAN_PHY_TX_ON || m_currentState == LORAWAN_PHY_BUSY_TX) && m_phy)
+        m_txPower = m_phy->GetTxPower ();
+      NS_LOG_DEBUG (this << " total energy consumption is " << m_totalEnergyConsumption << " J");
+    }
+
+  m_isSupersededChangeState = (m_nPendingChangeState > 1);
+
+  m_nPendingChangeState--;
+}
+
+void
+LoRaWANRadioEnergyModel::HandleEnergyDepletion (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (!m_energyDepletionCallback.IsNull ())
+    m_energyDepletionCallback ();
+}
+
+void
+LoRaWANRadioEnergyModel::HandleEnergyRecharged (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (!m_energyRechargedCallback.IsNull ())
+    m_energyRechargedCallback ();
+}
+
+void
+LoRaWANRadioEnergyModel::SetEnergyDepletionCallback (LoRaWANRadioEnergyCallback callback)
+{
+  m_energyDepletionCallback = callback;
+}
+
+void
+LoRaWANRadioEnergyModel::SetEnergyRechargedCallback (LoRaWANRadioEnergyCallback callback)
+{
+  m_energyRechargedCallback = callback;
+}
+
+void
+LoRaWANRadioEnergyModel::SetTxCurrentA (int8_t txPower, double currentA)
+{
+  NS_LOG_FUNCTION (this << (int16_t)txPower << currentA);
+  NS_ASSERT (currentA >= 0.0);
+  m_txCurrentA[txPower] = currentA;
+}
+
+double
+LoRaWANRadioEnergyModel::GetTxCurrentA (double txPower) const
+{
+  NS_ASSERT (!m_txCurrentA.empty ());
+
+  std::map<int8_t, double>::const_iterator upper = m_txCurrentA.lower_bound (static_cast<int8_t> (std::ceil (txPower)));
+  if (upper == m_txCurrentA.end ())
+    return m_txCurrentA.rbegin ()->second;
+  if (upper->first == txPower || upper == m_txCurrentA.begin ())
+    return upper->second;
+
+  std::map<int8_t, double>::const_iterator lower = upper;
+  --lower;
+  const double frac = (txPower - lower->first) / (upper->first - lower->first);
+  return lower->second + frac * (upper->second - lower->second);
+}
+
+LoRaWANPhyEnumeration
+LoRaWANRadioEnergyModel::GetCurrentState (void) const
+{
+  return m_currentState;
+}
+
+double
+LoRaWANRadioEnergyModel::GetTotalChargeConsumption (void) const
+{
+  const Time duration = Simulator::Now () - m_lastUpdateTime;
+  return m_totalChargeC + duration.GetSeconds () * GetStateCurrentA (m_currentState);
+}
+
+double
+LoRaWANRadioEnergyModel::GetAverageCurrentA (void) const
+{
+  const Time elapsed = Simulator::Now () - m_startTime;
+  if (!elapsed.IsStrictlyPositive ())
+    return GetStateCurrentA (m_currentState);
+  return GetTotalChargeConsumption () / elapsed.GetSeconds ();
+}
+
+Time
+LoRaWANRadioEnergyModel::GetProjectedLifetime (double capacityAh) const
+{
+  const double averageCurrentA = GetAverageCurrentA ();
+  if (averageCurrentA <= 0.0)
+    return Time::Max ();
+  return Seconds (capacityAh * 3600.0 / averageCurrentA);
+}
+
+Time
+LoRaWANRadioEnergyModel::GetTimeInState (LoRaWANPhyEnumeration state) const
+{
+  NS_ASSERT (state <= LORAWAN_PHY_FORCE_TRX_OFF);
+  Time time = m_timeInState[state];
+  if (state == m_currentState)
+    time += Simulator::Now () - m_lastUpdateTime;
+  return time;
+}
+
+double
+LoRaWANRadioEnergyModel::DoGetCurrentA (void) const
+{
+  return GetStateCurrentA (m_currentState);
+}
+
+double
+LoRaWANRadioEnergyModel::GetStateCurrentA (LoRaWANPhyEnumeration state) const
+{
+  switch (state)
+    {
+    case LORAWAN_PHY_IDLE:
+      return m_idleCurrentA;
+    case LORAWAN_PHY_RX_ON:
+    case LORAWAN_PHY_BUSY_RX:
+      return m_rxCurrentA;
+    case LORAWAN_PHY_TX_ON:
+    case LORAWAN_PHY_BUSY_TX:
+      return GetTxCurrentA (m_txPower);
+    default: // TRX_OFF, FORCE_TRX_OFF
+      return m_sleepCurrentA;
+    }
+}
+
+double
+LoRaWANRadioEnergyModel::GetSupplyVoltage (void) const
+{
+  return m_source ? m_source->GetSupplyVoltage () : m_supplyVoltage;
+}
+
+} // namespace ns3
@@ -0,0 +1,176 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#ifndef LORAWAN_RADIO_ENERGY_MODEL_H
+#define LORAWAN_RADIO_ENERGY_MODEL_H
+
+#include <ns3/device-energy-model.h>
+#include <ns3/energy-source.h>
+#include <ns3/traced-value.h>
+#include <ns3/nstime.h>
+#include <ns3/lorawan-phy.h>
+
+#include <map>
+
+namespace ns3 {
+
+/**
+ * \ingroup lorawan
+ *
+ * Energy model of the LoRa transceiver of an end device. The state of the
+ * model follows the TRX state of the LoRaWANPhy (see the TrxState trace
+ * source): TRX_OFF is the sleep mode, IDLE is the standby mode, RX_ON and
+ * BUSY_RX are the receive mode and TX_ON and BUSY_TX are the transmit mode.
+ * The current draw in transmit mode depends on the TX power of the PHY, see
+ * SetTxCurrentA. The default currents are the typical values of the Semtech
+ * SX1276 data sheet.
+ *
+ * The charge that is drawn in a state is only integrated when the PHY leaves
+ * the state, the model does not schedule any events. The model can be used
+ * without an EnergySource, in which case it only keeps track of the consumed
+ * charge and energy (at SupplyVoltage), e.g. to project the battery lifetime
+ * of an end device. When an EnergySource is set, the source is updated on
+ * every state change. Note that BasicEnergySource and LiIonEnergySource also
+ * update themselves periodically (PeriodicEnergyUpdateInterval), which should
+ * be set to a long interval in large simulations.
+ */
+class LoRaWANRadioEnergyModel : public DeviceEnergyModel
+{
+public:
+  /**
+   * Callback type for energy depletion and recharged handling.
+   */
+  typedef Callback<void> LoRaWANRadioEnergyCallback;
+
+  static TypeId GetTypeId (void);
+  LoRaWANRadioEnergyModel ();
+  virtual ~LoRaWANRadioEnergyModel ();
+
+  /**
+   * \param phy the PHY of which the TRX state is followed
+   *
+   * Connects the model to the TrxState trace source of the PHY.
+   */
+  void SetPhy (Ptr<LoRaWANPhy> phy);
+
+  // Inherited from DeviceEnergyModel
+  virtual void SetEnergySource (Ptr<EnergySource> source);
+  virtual double GetTotalEnergyConsumption (void) const;
+  virtual void ChangeState (int newState);
+  virtual void HandleEnergyDepletion (void);
+  virtual void HandleEnergyRecharged (void);
+
+  void SetEnergyDepletionCallback (LoRaWANRadioEnergyCallback callback);
+  void SetEnergyRechargedCallback (LoRaWANRadioEnergyCallback callback);
+
+  /**
+   * Set the current draw when transmitting at a TX power. The current for a
+   * TX power without a current is interpolated linearly between the nearest
+   * TX powers with a current (and clamped below the lowest and above the
+   * highest TX power).
+   *
+   * \param txPower the TX power in dBm
+   * \param currentA the current draw in A
+   */
+  void SetTxCurrentA (int8_t txPower, double currentA);
+
+  /**
+   * \param txPower the TX power in dBm
+   * \return the current draw in A when transmitting at txPower
+   */
+  double GetTxCurrentA (double txPower) const;
+
+  /**
+   * \return the current LoRaWANPhy state of the model
+   */
+  LoRaWANPhyEnumeration GetCurrentState (void) const;
+
+  /**
+   * \return the charge (in C) drawn since the model was created, including
+   * the charge drawn in the current state so far
+   */
+  double GetTotalChargeConsumption (void) const;
+
+  /**
+   * \return the average current draw (in A) since the model was created
+   */
+  double GetAverageCurrentA (void) const;
+
+  /**
+   * Project the lifetime of a battery at the average current draw so far.
+   *
+   * \param capacityAh the battery capacity in Ah
+   * \return the projected lifetime, or Time::Max when no charge was drawn
+   */
+  Time GetProjectedLifetime (double capacityAh) const;
+
+  /**
+   * \param state a LoRaWANPhy state
+   * \return the time spent in the state so far
+   */
+  Time GetTimeInState (LoRaWANPhyEnumeration state) const;
+
+private:
+  virtual void DoDispose (void);
+  virtual double DoGetCurrentA (void) const;
+
+  /**
+   * Sink of the TrxState trace source of the PHY.
+   */
+  void TrxStateChanged (LoRaWANPhyEnumeration oldState, LoRaWANPhyEnumeration newState);
+
+  /**
+   * \return the current draw (in A) in a state, for TX states at the TX
+   * power at the start of the transmission
+   */
+  double GetStateCurrentA (LoRaWANPhyEnumeration state) const;
+
+  /**
+   * \return the supply voltage of the energy source, or SupplyVoltage when
+   * no source is set
+   */
+  double GetSupplyVoltage (void) const;
+
+  Ptr<EnergySource> m_source;
+  Ptr<LoRaWANPhy> m_phy;
+
+  double m_sleepCurrentA;
+  double m_idleCurrentA;
+  double m_rxCurrentA;
+  double m_supplyVoltage;
+  std::map<int8_t, double> m_txCurrentA; //!< current draw by TX power in dBm
+
+  LoRaWANPhyEnumeration m_currentState;
+  double m_txPower; //!< TX power of the current transmission, in dBm
+  Time m_startTime; //!< creation time of the model
+  Time m_lastUpdateTime; //!< time of the last state change
+  double m_totalChargeC;
+  TracedValue<double> m_totalEnergyConsumption; //!< in J
+  Time m_timeInState[LORAWAN_PHY_FORCE_TRX_OFF + 1];
+
+  uint8_t m_nPendingChangeState; //!< number of nested ChangeState calls
+  bool m_isSupersededChangeState; //!< whether a nested ChangeState call set the state
+
+  LoRaWANRadioEnergyCallback m_energyDepletionCallback;
+  LoRaWANRadioEnergyCallback m_energyRechargedCallback;
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_RADIO_ENERGY_MODEL_H */
@@ -0,0 +1,127 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#ifndef LORAWAN_RING_QUEUE_H
+#define LORAWAN_RING_QUEUE_H
+
+#include <ns3/assert.h>
+#include <vector>
+#include <stdint.h>
+
+namespace ns3 {
+
+/**
+ * \ingroup lorawan
+ *
+ * FIFO of values in a ring buffer. The slots of the ring are allocated when
+ * the queue first grows beyond its capacity and are reused afterwards, so a
+ * queue that has reached its peak size does not allocate anymore. A popped
+ * slot is reset to T (), which releases the packets it holds.
+ *
+ * References to elements are invalidated by PushBack.
+ */
+template <typename T>
+class LoRaWANRingQueue
+{
+public:
+  LoRaWANRingQueue () : m_slots(), m_head(0), m_size(0), m_peakSize(0) {}
+
+  bool IsEmpty (void) const { return m_size == 0; }
+
+  /**
+   * \return the number of queued elements
+   */
+  uint32_t GetSize (void) const { return m_size; }
+
+  /**
+   * \return the largest number of elements that were queued at the same time
+   */
+  uint32_t GetPeakSize (void) const { return m_peakSize; }
+
+  /**
+   * \return the number of slots in the ring
+   */
+  uint32_t GetCapacity (void) const { return m_slots.size (); }
+
+  T &Front (void)
+  {
+    NS_ASSERT (m_size > 0);
+    return m_slots[m_head];
+  }
+
+  /**
+   * Append a new element, which is default constructed.
+   *
+   * \return the new element
+   */
+  T &PushBack (void)
+  {
+    if (m_size == m_slots.size ())
+      Grow ();
+    uint32_t index = m_head + m_size;
+    if (index >= m_slots.size ())
+      index -= m_slots.size ();
+    m_size++;
+    if (m_size > m_peakSize)
+      m_peakSize = m_size;
+    return m_slots[index];
+  }
+
+  /**
+   * Remove the first element, the queue should not be empty.
+   */
+  void PopFront (void)
+  {
+    NS_ASSERT (m_size > 0);
+    m_slots[m_head] = T ();
+    m_head++;
+    if (m_head == m_slots.size ())
+      m_head = 0;
+    m_size--;
+  }
+
+  void Clear (void)
+  {
+    while (m_size > 0)
+      PopFront ();
+  }
+
+private:
+  /**
+   * Double the number of slots, moving the queued elements to the front of
+   * the new ring.
+   */
+  void Grow (void)
+  {
+    std::vector<T> slots (m_slots.empty () ? 4 : 2 * m_slots.size ());
+    for (uint32_t k = 0; k < m_size; k++)
+      slots[k] = m_slots[(m_head + k) % m_slots.size ()];
+    m_slots.swap (slots);
+    m_head = 0;
+  }
+
+  std::vector<T> m_slots;
+  uint32_t m_head;     //!< slot of the first element
+  uint32_t m_size;     //!< number of queued elements
+  uint32_t m_peakSize; //!< largest m_size so far
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_RING_QUEUE_H */
@@ -0,0 +1,640 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include "lorawan-spectrum-channel.h"
+#include "lorawan-spectrum-signal-parameters.h"
+#include "lorawan-phy.h"
+#include "lorawan-gateway-phy.h"
+#include <ns3/simulator.h>
+#include <ns3/log.h>
+#include <ns3/double.h>
+#include <ns3/boolean.h>
+#include <ns3/uinteger.h>
+#include <ns3/node.h>
+#include <ns3/net-device.h>
+#include <ns3/mobility-model.h>
+#include <ns3/spectrum-phy.h>
+#include <ns3/spectrum-propagation-loss-model.h>
+#include <ns3/propagation-loss-model.h>
+#include <ns3/propagation-delay-model.h>
+#include <ns3/antenna-model.h>
+#include <ns3/angles.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANSpectrumChannel");
+
+NS_OBJECT_ENSURE_REGISTERED (LoRaWANSpectrumChannel);
+
+LoRaWANSpectrumChannel::LoRaWANSpectrumChannel ()
+  : m_channelPhyLists (LoRaWAN::m_supportedChannels.size ()),
+    m_cacheLinkGains (false),
+    m_maxCachedLinks (0),
+    m_detachSleepingRx (false),
+    m_nDetachedRx (0),
+    m_activeTx (LoRaWAN::m_supportedChannels.size ())
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+LoRaWANSpectrumChannel::DoDispose ()
+{
+  NS_LOG_FUNCTION (this);
+  m_phyList.clear ();
+  m_channelPhyLists.clear ();
+  m_allChannelsPhyList.clear ();
+  m_rxLocations.clear ();
+  m_linkGains.clear ();
+  for (std::set<Ptr<MobilityModel> >::iterator it = m_trackedMobilities.begin (); it != m_trackedMobilities.end (); ++it)
+    {
+      (*it)->TraceDisconnectWithoutContext ("CourseChange", MakeCallback (&LoRaWANSpectrumChannel::CourseChanged, this));
+    }
+  m_trackedMobilities.clear ();
+  m_activeTx.clear ();
+  m_spectrumModel = 0;
+  m_propagationDelay = 0;
+  m_propagationLoss = 0;
+  m_spectrumPropagationLoss = 0;
+  SpectrumChannel::DoDispose ();
+}
+
+TypeId
+LoRaWANSpectrumChannel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoRaWANSpectrumChannel")
+    .SetParent<SpectrumChannel> ()
+    .SetGroupName ("LoRaWAN")
+    .AddConstructor<LoRaWANSpectrumChannel> ()
+    .AddAttribute ("MaxLossDb",
+                   "If a single-frequency PropagationLossModel is used, "
+                   "this value represents the maximum loss in dB for which "
+                   "transmissions will be passed to the receiving PHY.",
+                   DoubleValue (1.0e9),
+                   MakeDoubleAccessor (&LoRaWANSpectrumChannel::m_maxLossDb),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("CacheLinkGains",
+                   "Cache the path loss between pairs of mobility models. Only "
+                   "valid for deterministic propagation loss models.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&LoRaWANSpectrumChannel::m_cacheLinkGains),
+                   MakeBooleanChecker ())
+    .AddAttribute ("MaxCachedLinks",
+                   "If not 0, only cache the links towards the MaxCachedLinks "
+                   "strongest receivers that listen on all channels (i.e. "
+                   "gateways), per transmitter.",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&LoRaWANSpectrumChannel::m_maxCachedLinks),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("DetachSleepingRx",
+                   "Do not deliver transmissions to a LoRaWANPhy that is not "
+                   "listening (i.e. not in the RX_ON or BUSY_RX state). When "
+                   "it starts listening, the active transmissions on its "
+                   "channel are added to its interference.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&LoRaWANSpectrumChannel::m_detachSleepingRx),
+                   MakeBooleanChecker ())
+    .AddTraceSource ("PathLoss",
+                     "This trace is fired whenever a new path loss value "
+                     "is calculated. The first and second parameters "
+                     "to the trace are pointers respectively to the TX and "
+                     "RX SpectrumPhy instances, whereas the third parameters "
+                     "is the loss value in dB.",
+                     MakeTraceSourceAccessor (&LoRaWANSpectrumChannel::m_pathLossTrace),
+                     "ns3::SpectrumChannel::LossTracedCallback")
+  ;
+  return tid;
+}
+
+void
+LoRaWANSpectrumChannel::AddRx (Ptr<SpectrumPhy> phy)
+{
+  NS_LOG_FUNCTION (this << phy);
+  m_phyList.push_back (phy);
+
+  RxLocation location;
+  location.detached = false;
+  Ptr<LoRaWANPhy> loraWanPhy = DynamicCast<LoRaWANPhy> (phy);
+  if (loraWanPhy)
+    {
+      location.allChannels = false;
+      location.channelIndex = loraWanPhy->GetCurrentChannelIndex ();
+      if (m_detachSleepingRx && !loraWanPhy->IsRxListening ())
+        {
+          location.detached = true;
+          location.position = 0;
+          m_nDetachedRx++;
+        }
+      else
+        {
+          AddToBucket (phy, location);
+        }
+    }
+  else
+    {
+      // e.g. LoRaWANGatewayPhy or a non-LoRaWAN receiver
+      location.allChannels = true;
+      location.channelIndex = 0;
+      location.position = m_allChannelsPhyList.size ();
+      m_allChannelsPhyList.push_back (phy);
+    }
+  m_rxLocations[phy] = location;
+}
+
+void
+LoRaWANSpectrumChannel::AddToBucket (Ptr<SpectrumPhy> phy, RxLocation &location)
+{
+  if (location.channelIndex >= m_channelPhyLists.size ())
+    m_channelPhyLists.resize (location.channelIndex + 1);
+
+  location.position = m_channelPhyLists[location.channelIndex].size ();
+  m_channelPhyLists[location.channelIndex].push_back (phy);
+}
+
+void
+LoRaWANSpectrumChannel::RemoveFromBucket (Ptr<SpectrumPhy> phy, const RxLocation &location)
+{
+  PhyList &list = m_channelPhyLists[location.channelIndex];
+  NS_ASSERT (list[location.position] == phy);
+  if (location.position != list.size () - 1)
+    {
+      list[location.position] = list.back ();
+      m_rxLocations[list[location.position]].position = location.position;
+    }
+  list.pop_back ();
+}
+
+void
+LoRaWANSpectrumChannel::RetuneRx (Ptr<SpectrumPhy> phy, uint8_t channelIndex)
+{
+  NS_LOG_FUNCTION (this << phy << static_cast<uint16_t> (channelIndex));
+
+  std::map<Ptr<SpectrumPhy>, RxLocation>::iterator it = m_rxLocations.find (phy);
+  if (it == m_rxLocations.end () || it->second.allChannels)
+    return;
+
+  RxLocation &location = it->second;
+  if (location.channelIndex == channelIndex)
+    return;
+
+  if (location.detached)
+    {
+      // The receiver is added to the bucket of its channel when it starts listening
+      location.channelIndex = channelIndex;
+      return;
+    }
+
+  RemoveFromBucket (phy, location);
+  location.channelIndex = channelIndex;
+  AddToBucket (phy, location);
+}
+
+void
+LoRaWANSpectrumChannel::NotifyRxListening (Ptr<LoRaWANPhy> phy, bool listening)
+{
+  NS_LOG_FUNCTION (this << phy << listening);
+
+  if (!m_detachSleepingRx)
+    return;
+
+  std::map<Ptr<SpectrumPhy>, RxLocation>::iterator it = m_rxLocations.find (phy);
+  if (it == m_rxLocations.end () || it->second.allChannels)
+    return;
+
+  RxLocation &location = it->second;
+  if (listening && location.detached)
+    {
+      location.detached = false;
+      m_nDetachedRx--;
+      AddToBucket (phy, location);
+      AddActiveTxToRx (phy);
+    }
+  else if (!listening && !location.detached)
+    {
+      RemoveFromBucket (phy, location);
+      location.detached = true;
+      m_nDetachedRx++;
+    }
+}
+
+uint32_t
+LoRaWANSpectrumChannel::GetNDetachedRx (void) const
+{
+  return m_nDetachedRx;
+}
+
+void
+LoRaWANSpectrumChannel::PruneActiveTx (uint8_t channelIndex)
+{
+  // The interference of a transmission that has ended at the transmitter is
+  // not added to a receiver that starts listening, even if it is still
+  // propagating towards the receiver.
+  const Time now = Simulator::Now ();
+  std::vector<ActiveTx> &activeTx = m_activeTx[channelIndex];
+  for (uint32_t i = 0; i < activeTx.size (); )
+    {
+      if (activeTx[i].start + activeTx[i].params->duration <= now)
+        {
+          activeTx[i] = activeTx.back ();
+          activeTx.pop_back ();
+        }
+      else
+        {
+          i++;
+        }
+    }
+}
+
+void
+LoRaWANSpectrumChannel::AddActiveTxToRx (Ptr<LoRaWANPhy> phy)
+{
+  const uint8_t channelIndex = phy->GetCurrentChannelIndex ();
+  if (channelIndex >= m_activeTx.size ())
+    return;
+
+  PruneActiveTx (channelIndex);
+
+  const Time now = Simulator::Now ();
+  Ptr<MobilityModel> receiverMobility = phy->GetMobility ();
+  Ptr<NetDevice> netDev = phy->GetDevice ();
+  const uint32_t context = netDev ? netDev->GetNode ()->GetId () : Simulator::GetContext ();
+  const std::vector<ActiveTx> &activeTx = m_activeTx[channelIndex];
+  for (std::vector<ActiveTx>::const_iterator it = activeTx.begin (); it != activeTx.end (); ++it)
+    {
+      if (it->params->txPhy == phy)
+        continue;
+
+      Time delay = MicroSeconds (0);
+      double pathGainLinear = 1.0;
+      if (it->senderMobility && receiverMobility)
+        {
+          TxLinkGains *txLinks = 0;
+          if (m_cacheLinkGains && m_maxCachedLinks == 0)
+            txLinks = &GetTxLinkGains (it->senderMobility);
+
+          LinkGain gain = GetLinkGain (it->params, it->senderMobility, phy, receiverMobility, txLinks);
+          if (gain.pathLossDb > m_maxLossDb)
+            continue;
+
+          pathGainLinear = gain.pathGainLinear;
+          if (m_propagationDelay)
+            delay = m_propagationDelay->GetDelay (it->senderMobility, receiverMobility);
+        }
+
+      // The bands of the LoRaWAN SpectrumModel coincide with the channels
+      double rxPsd = (*it->params->psd)[channelIndex] * pathGainLinear;
+      if (m_spectrumPropagationLoss && it->senderMobility && receiverMobility)
+        {
+          Ptr<SpectrumValue> psd = Copy<SpectrumValue> (it->params->psd);
+          *psd *= pathGainLinear;
+          rxPsd = (*m_spectrumPropagationLoss->CalcRxPowerSpectralDensity (psd, it->senderMobility, receiverMobility))[channelIndex];
+        }
+      const Time arrival = it->start + delay;
+      if (arrival > now)
+        {
+          // Still propagating towards the receiver: deliver it as usual
+          Simulator::ScheduleWithContext (context, arrival - now, &LoRaWANPhy::StartLoRaWANRx, phy, it->params, rxPsd);
+        }
+      else
+        {
+          phy->AddInterference (it->params, rxPsd, arrival + it->params->duration);
+        }
+    }
+}
+
+uint32_t
+LoRaWANSpectrumChannel::GetNRxOnChannel (uint8_t channelIndex) const
+{
+  if (channelIndex >= m_channelPhyLists.size ())
+    return 0;
+
+  return m_channelPhyLists[channelIndex].size ();
+}
+
+void
+LoRaWANSpectrumChannel::StartTx (Ptr<SpectrumSignalParameters> txParams)
+{
+  NS_LOG_FUNCTION (this << txParams->psd << txParams->duration << txParams->txPhy);
+  NS_ASSERT_MSG (txParams->psd, "NULL txPsd");
+  NS_ASSERT_MSG (txParams->txPhy, "NULL txPhy");
+
+  if (m_spectrumModel == 0)
+    {
+      // first pak, record SpectrumModel
+      m_spectrumModel = txParams->psd->GetSpectrumModel ();
+    }
+  else
+    {
+      // all attached SpectrumPhy instances must use the same SpectrumModel
+      NS_ASSERT (*(txParams->psd->GetSpectrumModel ()) == *m_spectrumModel);
+    }
+
+  Ptr<MobilityModel> senderMobility = txParams->txPhy->GetMobility ();
+
+  Ptr<LoRaWANSpectrumSignalParameters> loraWanTxParams = DynamicCast<LoRaWANSpectrumSignalParameters> (txParams);
+  if (loraWanTxParams)
+    {
+      if (m_detachSleepingRx)
+        {
+          if (loraWanTxParams->channelIndex >= m_activeTx.size ())
+            m_activeTx.resize (loraWanTxParams->channelIndex + 1);
+          PruneActiveTx (loraWanTxParams->channelIndex);
+          ActiveTx activeTx;
+          activeTx.params = loraWanTxParams;
+          activeTx.senderMobility = senderMobility;
+          activeTx.start = Simulator::Now ();
+          m_activeTx[loraWanTxParams->channelIndex].push_back (activeTx);
+        }
+      if (loraWanTxParams->channelIndex < m_channelPhyLists.size ())
+        StartTxToRxList (txParams, loraWanTxParams, senderMobility, m_channelPhyLists[loraWanTxParams->channelIndex]);
+    }
+  else
+    {
+      // Not a LoRaWAN transmission: deliver to all receivers
+      for (std::vector<PhyList>::const_iterator it = m_channelPhyLists.begin (); it != m_channelPhyLists.end (); ++it)
+        StartTxToRxList (txParams, loraWanTxParams, senderMobility, *it);
+    }
+  StartTxToRxList (txParams, loraWanTxParams, senderMobility, m_allChannelsPhyList);
+}
+
+uint32_t
+LoRaWANSpectrumChannel::GetNCachedLinkGains (void) const
+{
+  uint32_t n = 0;
+  for (std::unordered_map<const MobilityModel *, TxLinkGains>::const_iterator it = m_linkGains.begin (); it != m_linkGains.end (); ++it)
+    n += it->second.links.size ();
+  return n;
+}
+
+LoRaWANSpectrumChannel::TxLinkGains &
+LoRaWANSpectrumChannel::GetTxLinkGains (Ptr<MobilityModel> senderMobility)
+{
+  std::unordered_map<const MobilityModel *, TxLinkGains>::iterator it = m_linkGains.find (PeekPointer (senderMobility));
+  if (it != m_linkGains.end ())
+    return it->second;
+
+  TrackMobility (senderMobility);
+  TxLinkGains &txLinks = m_linkGains[PeekPointer (senderMobility)];
+  txLinks.weakest = 0;
+  txLinks.weakestPathLossDb = 0.0;
+  return txLinks;
+}
+
+void
+LoRaWANSpectrumChannel::CacheLinkGain (TxLinkGains &txLinks, Ptr<MobilityModel> receiverMobility, const LinkGain &gain)
+{
+  if (m_maxCachedLinks != 0 && txLinks.links.size () >= m_maxCachedLinks)
+    {
+      // Only keep the strongest links
+      if (gain.pathLossDb >= txLinks.weakestPathLossDb)
+        return;
+
+      txLinks.links.erase (txLinks.weakest);
+      txLinks.links[PeekPointer (receiverMobility)] = gain;
+      UpdateWeakestLink (txLinks);
+    }
+  else
+    {
+      txLinks.links[PeekPointer (receiverMobility)] = gain;
+      if (txLinks.weakest == 0 || gain.pathLossDb > txLinks.weakestPathLossDb)
+        {
+          txLinks.weakest = PeekPointer (receiverMobility);
+          txLinks.weakestPathLossDb = gain.pathLossDb;
+        }
+    }
+  TrackMobility (receiverMobility);
+}
+
+void
+LoRaWANSpectrumChannel::UpdateWeakestLink (TxLinkGains &txLinks)
+{
+  txLinks.weakest = 0;
+  txLinks.weakestPathLossDb = 0.0;
+  for (LinkGainMap::const_iterator it = txLinks.links.begin (); it != txLinks.links.end (); ++it)
+    {
+      if (txLinks.weakest == 0 || it->second.pathLossDb > txLinks.weakestPathLossDb)
+        {
+          txLinks.weakest = it->first;
+          txLinks.weakestPathLossDb = it->second.pathLossDb;
+        }
+    }
+}
+
+void
+LoRaWANSpectrumChannel::TrackMobility (Ptr<MobilityModel> mobility)
+{
+  if (m_trackedMobilities.insert (mobility).second)
+    {
+      mobility->TraceConnectWithoutContext ("CourseChange", MakeCallback (&LoRaWANSpectrumChannel::CourseChanged, this));
+    }
+}
+
+void
+LoRaWANSpectrumChannel::CourseChanged (Ptr<const MobilityModel> mobility)
+{
+  NS_LOG_FUNCTION (this << mobility);
+
+  const MobilityModel *m = PeekPointer (mobility);
+  m_linkGains.erase (m);
+  for (std::unordered_map<const MobilityModel *, TxLinkGains>::iterator it = m_linkGains.begin (); it != m_linkGains.end (); ++it)
+    {
+      if (it->second.links.erase (m) && it->second.weakest == m)
+        UpdateWeakestLink (it->second);
+    }
+}
+
+void
+LoRaWANSpectrumChannel::StartTxToRxList (Ptr<SpectrumSignalParameters> txParams, Ptr<LoRaWANSpectrumSignalParameters> loraWanTxParams, Ptr<MobilityModel> senderMobility, const PhyList &phyList)
+{
+  // With a bounded cache, only the links towards gateways are cached
+  TxLinkGains *txLinks = 0;
+  if (m_cacheLinkGains && senderMobility && (m_maxCachedLinks == 0 || &phyList == &m_allChannelsPhyList))
+    txLinks = &GetTxLinkGains (senderMobility);
+
+  // A LoRa signal only has power in the band of its channel, so its
+  // parameters are shared by all receivers and only the received power
+  // spectral density in that band is passed per receiver. A frequency
+  // dependent propagation loss model needs a per-receiver PSD though.
+  const bool shareParams = loraWanTxParams && !m_spectrumPropagationLoss;
+  const bool loraWanPhyList = &phyList != &m_allChannelsPhyList;
+  double txPsd = 0.0;
+  if (shareParams)
+    {
+      // The bands of the LoRaWAN SpectrumModel coincide with the channels
+      txPsd = (*txParams->psd)[loraWanTxParams->channelIndex];
+    }
+
+  for (PhyList::const_iterator rxPhyIterator = phyList.begin ();
+       rxPhyIterator != phyList.end ();
+       ++rxPhyIterator)
+    {
+      if ((*rxPhyIterator) == txParams->txPhy)
+        continue;
+
+      Time delay = MicroSeconds (0);
+      double pathGainLinear = 1.0;
+
+      Ptr<MobilityModel> receiverMobility = (*rxPhyIterator)->GetMobility ();
+
+      if (senderMobility && receiverMobility)
+        {
+          LinkGain gain = GetLinkGain (txParams, senderMobility, *rxPhyIterator, receiverMobility, txLinks);
+          if (gain.pathLossDb > m_maxLossDb)
+            {
+              // beyond range
+              continue;
+            }
+          pathGainLinear = gain.pathGainLinear;
+
+          if (m_propagationDelay)
+            {
+              delay = m_propagationDelay->GetDelay (senderMobility, receiverMobility);
+            }
+        }
+
+      // If the receiver has a NetDevice, we expect that it is attached to a Node
+      Ptr<NetDevice> netDev = (*rxPhyIterator)->GetDevice ();
+      const uint32_t context = netDev ? netDev->GetNode ()->GetId () : Simulator::GetContext ();
+
+      if (shareParams)
+        {
+          const double rxPsd = txPsd * pathGainLinear;
+          if (loraWanPhyList)
+            {
+              // Only LoRaWANPhy receivers are kept in the per-channel lists
+              Ptr<LoRaWANPhy> phy (static_cast<LoRaWANPhy *> (PeekPointer (*rxPhyIterator)));
+              Simulator::ScheduleWithContext (context, delay, &LoRaWANPhy::StartLoRaWANRx, phy, loraWanTxParams, rxPsd);
+              continue;
+            }
+
+          Ptr<LoRaWANGatewayPhy> gatewayPhy = DynamicCast<LoRaWANGatewayPhy> (*rxPhyIterator);
+          if (gatewayPhy)
+            {
+              Simulator::ScheduleWithContext (context, delay, &LoRaWANGatewayPhy::StartLoRaWANRx, gatewayPhy, loraWanTxParams, rxPsd);
+              continue;
+            }
+        }
+
+      // Other receivers get their own copy of the signal parameters
+      Ptr<SpectrumSignalParameters> rxParams = txParams->Copy ();
+      *(rxParams->psd) *= pathGainLinear;
+      if (m_spectrumPropagationLoss && senderMobility && receiverMobility)
+        {
+          rxParams->psd = m_spectrumPropagationLoss->CalcRxPowerSpectralDensity (rxParams->psd, senderMobility, receiverMobility);
+        }
+      Simulator::ScheduleWithContext (context, delay, &LoRaWANSpectrumChannel::StartRx, this, rxParams, *rxPhyIterator);
+    }
+}
+
+LoRaWANSpectrumChannel::LinkGain
+LoRaWANSpectrumChannel::GetLinkGain (Ptr<SpectrumSignalParameters> txParams, Ptr<MobilityModel> senderMobility, Ptr<SpectrumPhy> receiver, Ptr<MobilityModel> receiverMobility, TxLinkGains *txLinks)
+{
+  LinkGain gain;
+  LinkGainMap::const_iterator cached;
+  if (txLinks && (cached = txLinks->links.find (PeekPointer (receiverMobility))) != txLinks->links.end ())
+    {
+      gain = cached->second;
+    }
+  else
+    {
+      double pathLossDb = 0;
+      if (txParams->txAntenna != 0)
+        {
+          Angles txAngles (receiverMobility->GetPosition (), senderMobility->GetPosition ());
+          pathLossDb -= txParams->txAntenna->GetGainDb (txAngles);
+        }
+      Ptr<AntennaModel> rxAntenna = receiver->GetRxAntenna ();
+      if (rxAntenna != 0)
+        {
+          Angles rxAngles (senderMobility->GetPosition (), receiverMobility->GetPosition ());
+          pathLossDb -= rxAntenna->GetGainDb (rxAngles);
+        }
+      if (m_propagationLoss)
+        {
+          pathLossDb -= m_propagationLoss->CalcRxPower (0, senderMobility, receiverMobility);
+        }
+      gain.pathLossDb = pathLossDb;
+      gain.pathGainLinear = std::pow (10.0, (-pathLossDb) / 10.0);
+      if (txLinks)
+        CacheLinkGain (*txLinks, receiverMobility, gain);
+    }
+  NS_LOG_LOGIC ("total pathLoss = " << gain.pathLossDb << " dB");
+  m_pathLossTrace (txParams->txPhy, receiver, gain.pathLossDb);
+  return gain;
+}
+
+void
+LoRaWANSpectrumChannel::StartRx (Ptr<SpectrumSignalParameters> params, Ptr<SpectrumPhy> receiver)
+{
+  NS_LOG_FUNCTION (this << params);
+  receiver->StartRx (params);
+}
+
+uint32_t
+LoRaWANSpectrumChannel::GetNDevices (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return m_phyList.size ();
+}
+
+Ptr<NetDevice>
+LoRaWANSpectrumChannel::GetDevice (uint32_t i) const
+{
+  NS_LOG_FUNCTION (this << i);
+  return m_phyList.at (i)->GetDevice ()->GetObject<NetDevice> ();
+}
+
+void
+LoRaWANSpectrumChannel::AddPropagationLossModel (Ptr<PropagationLossModel> loss)
+{
+  NS_LOG_FUNCTION (this << loss);
+  if (m_propagationLoss)
+    {
+      loss->SetNext (m_propagationLoss);
+    }
+  m_propagationLoss = loss;
+}
+
+void
+LoRaWANSpectrumChannel::AddSpectrumPropagationLossModel (Ptr<SpectrumPropagationLossModel> loss)
+{
+  NS_LOG_FUNCTION (this << loss);
+  if (m_spectrumPropagationLoss)
+    {
+      loss->SetNext (m_spectrumPropagationLoss);
+    }
+  m_spectrumPropagationLoss = loss;
+}
+
+void
+LoRaWANSpectrumChannel::SetPropagationDelayModel (Ptr<PropagationDelayModel> delay)
+{
+  NS_LOG_FUNCTION (this << delay);
+  NS_ASSERT (m_propagationDelay == 0);
+  m_propagationDelay = delay;
+}
+
+Ptr<SpectrumPropagationLossModel>
+LoRaWANSpectrumChannel::GetSpectrumPropagationLossModel (void)
+{
+  NS_LOG_FUNCTION (this);
+  return m_spectrumPropagationLoss;
+}
+
+} // namespace ns3
@@ -0,0 +1,391 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#ifndef LORAWAN_SPECTRUM_CHANNEL_H
+#define LORAWAN_SPECTRUM_CHANNEL_H
+
+#include <ns3/spectrum-channel.h>
+#include <ns3/spectrum-model.h>
+#include <ns3/traced-callback.h>
+#include <ns3/nstime.h>
+#include <map>
+#include <set>
+#include <unordered_map>
+
+namespace ns3 {
+
+class MobilityModel;
+class LoRaWANPhy;
+struct LoRaWANSpectrumSignalParameters;
+
+/**
+ * \ingroup lorawan
+ *
+ * SpectrumChannel for LoRaWAN networks that only delivers a LoRaWAN
+ * transmission to the receivers that are tuned to the channel (i.e. the
+ * LoRaWAN::m_supportedChannels index) of the transmission.
+ *
+ * SingleModelSpectrumChannel delivers every transmission to every receiver,
+ * after which LoRaWANPhy::StartRx discards all transmissions on other
+ * channels. This channel keeps the receivers bucketed per LoRaWAN channel
+ * instead, so that the cost of a transmission scales with the number of
+ * co-channel receivers. A LoRaWANPhy informs the channel when it is retuned
+ * (see LoRaWANPhy::SetTxConf). Other receivers, such as the shared
+ * LoRaWANGatewayPhy, listen on all channels and receive every transmission.
+ *
+ * Propagation is modelled as in SingleModelSpectrumChannel. As a LoRa signal
+ * only has power in the band of its channel, the signal parameters of a LoRa
+ * transmission are not copied for every receiver: all LoRaWANPhy and
+ * LoRaWANGatewayPhy receivers share the (immutable) parameters of the
+ * transmitter and only get their received power spectral density as a scalar
+ * (see LoRaWANPhy::StartLoRaWANRx). Other receivers, and all receivers when a
+ * SpectrumPropagationLossModel is set, get a copy of the parameters.
+ *
+ * When the CacheLinkGains attribute is set, the path loss (including antenna
+ * gains) and the linear path gain of a link between two mobility models are
+ * calculated once and cached. A cached link is invalidated when the
+ * CourseChange trace of one of its mobility models fires, so moving nodes are
+ * supported. Caching is only valid for deterministic propagation loss models
+ * (e.g. LogDistancePropagationLossModel, but not for models with random
+ * fading). When MaxCachedLinks is non-zero, only the links towards receivers
+ * that listen on all channels (i.e. gateways with a LoRaWANGatewayPhy) are
+ * cached, and only for the MaxCachedLinks strongest of these receivers per
+ * transmitter. This bounds the memory of the cache for networks with many end
+ * devices.
+ *
+ * When the DetachSleepingRx attribute is set, a LoRaWANPhy that is not
+ * listening (i.e. not in the RX_ON or BUSY_RX state, such as a sleeping class A
+ * end device) is removed from its bucket, so that it does not cost anything
+ * for transmissions in the network. The channel then keeps an index of the
+ * active LoRaWAN transmissions per channel. When the PHY starts listening
+ * again (e.g. when the MAC opens a receive window), the channel adds the
+ * active transmissions on its channel to the interference of the PHY (see
+ * LoRaWANPhy::AddInterference). Note that the PHY does not report the drop of
+ * the transmissions that it missed while detached.
+ */
+class LoRaWANSpectrumChannel : public SpectrumChannel
+{
+public:
+  LoRaWANSpectrumChannel ();
+
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  // inherited from SpectrumChannel
+  virtual void AddPropagationLossModel (Ptr<PropagationLossModel> loss);
+  virtual void AddSpectrumPropagationLossModel (Ptr<SpectrumPropagationLossModel> loss);
+  virtual void SetPropagationDelayModel (Ptr<PropagationDelayModel> delay);
+  virtual void AddRx (Ptr<SpectrumPhy> phy);
+  virtual void StartTx (Ptr<SpectrumSignalParameters> params);
+  virtual Ptr<SpectrumPropagationLossModel> GetSpectrumPropagationLossModel (void);
+
+  // inherited from Channel
+  virtual uint32_t GetNDevices (void) const;
+  virtual Ptr<NetDevice> GetDevice (uint32_t i) const;
+
+  /**
+   * Move a receiver to the bucket of another LoRaWAN channel. Receivers that
+   * were not added with AddRx are ignored.
+   *
+   * \param phy the receiver that was retuned
+   * \param channelIndex the LoRaWAN channel the receiver is now tuned to
+   */
+  void RetuneRx (Ptr<SpectrumPhy> phy, uint8_t channelIndex);
+
+  /**
+   * \param channelIndex the index of a LoRaWAN channel
+   * \return the number of receivers that are tuned to the LoRaWAN channel,
+   * not including receivers that listen on all channels
+   */
+  uint32_t GetNRxOnChannel (uint8_t channelIndex) const;
+
+  /**
+   * Called by a LoRaWANPhy when it starts or stops listening. When the
+   * DetachSleepingRx attribute is set, a PHY that stops listening is detached
+   * from the delivery of transmissions. When it starts listening again, the
+   * active transmissions on its channel are added to its interference.
+   *
+   * \param phy the receiver
+   * \param listening true if the receiver is in the RX_ON or BUSY_RX state
+   */
+  void NotifyRxListening (Ptr<LoRaWANPhy> phy, bool listening);
+
+  /**
+   * \return the number of receivers that are detached because they are not
+   * listening
+   */
+  uint32_t GetNDetachedRx (void) const;
+
+  /**
+   * \return the number of links of which the path gain is cached
+   */
+  uint32_t GetNCachedLinkGains (void) const;
+
+  /// Container: SpectrumPhy objects
+  typedef std::vector<Ptr<SpectrumPhy> > PhyList;
+
+private:
+  virtual void DoDispose ();
+
+  /**
+   * Deliver a transmission to all receivers in a list.
+   *
+   * \param txParams the parameters of the transmission
+   * \param loraWanTxParams the parameters of the transmission if it is a
+   * LoRaWAN transmission, 0 otherwise
+   * \param senderMobility the mobility model of the transmitter
+   * \param phyList the receivers
+   */
+  void StartTxToRxList (Ptr<SpectrumSignalParameters> txParams, Ptr<LoRaWANSpectrumSignalParameters> loraWanTxParams, Ptr<MobilityModel> senderMobility, const PhyList &phyList);
+
+  /**
+   * The cached path loss of a link.
+   */
+  struct LinkGain
+  {
+    double pathLossDb;     //!< the path loss, including antenna gains, in dB
+    double pathGainLinear; //!< the linear path gain
+  };
+
+  /// Container: cached links of a transmitter, by receiver mobility model
+  typedef std::unordered_map<const MobilityModel *, LinkGain> LinkGainMap;
+
+  /**
+   * The cached links of a transmitter.
+   */
+  struct TxLinkGains
+  {
+    LinkGainMap links;            //!< the cached links
+    const MobilityModel *weakest; //!< the receiver of the cached link with the highest path loss
+    double weakestPathLossDb;     //!< the path loss of the weakest cached link
+  };
+
+  /**
+   * Get the cached links of a transmitter, start tracking the transmitter if
+   * needed.
+   *
+   * \param senderMobility the mobility model of the transmitter
+   * \return the cached links of the transmitter
+   */
+  TxLinkGains &GetTxLinkGains (Ptr<MobilityModel> senderMobility);
+
+  /**
+   * Add a link to the cache of a transmitter. When the cache of the
+   * transmitter is full, the link replaces the weakest cached link if it is
+   * stronger.
+   *
+   * \param txLinks the cached links of the transmitter
+   * \param receiverMobility the mobility model of the receiver
+   * \param gain the path loss of the link
+   */
+  void CacheLinkGain (TxLinkGains &txLinks, Ptr<MobilityModel> receiverMobility, const LinkGain &gain);
+
+  /**
+   * Find the weakest cached link of a transmitter.
+   *
+   * \param txLinks the cached links of the transmitter
+   */
+  static void UpdateWeakestLink (TxLinkGains &txLinks);
+
+  /**
+   * Connect to the CourseChange trace of a mobility model, so that its cached
+   * links can be invalidated.
+   *
+   * \param mobility the mobility model
+   */
+  void TrackMobility (Ptr<MobilityModel> mobility);
+
+  /**
+   * Invalidate all cached links of a mobility model that changed its course.
+   *
+   * \param mobility the mobility model
+   */
+  void CourseChanged (Ptr<const MobilityModel> mobility);
+
+  /**
+   * Used internally to reschedule transmission after the propagation delay.
+   *
+   * \param params the parameters of the signal
+   * \param receiver the receiver of the signal
+   */
+  void StartRx (Ptr<SpectrumSignalParameters> params, Ptr<SpectrumPhy> receiver);
+
+  /**
+   * Location of a receiver in m_channelPhyLists or in m_allChannelsPhyList.
+   */
+  struct RxLocation
+  {
+    bool allChannels;     //!< receiver listens on all channels
+    bool detached;        //!< receiver is not in its bucket, see DetachSleepingRx
+    uint8_t channelIndex; //!< the bucket of the receiver
+    uint32_t position;    //!< the position of the receiver in its bucket
+  };
+
+  /**
+   * Add a receiver at the end of the bucket of its channel.
+   *
+   * \param phy the receiver
+   * \param location the location of the receiver, its position is updated
+   */
+  void AddToBucket (Ptr<SpectrumPhy> phy, RxLocation &location);
+
+  /**
+   * Remove a receiver from its bucket by moving the last receiver of the
+   * bucket in its place.
+   *
+   * \param phy the receiver
+   * \param location the location of the receiver
+   */
+  void RemoveFromBucket (Ptr<SpectrumPhy> phy, const RxLocation &location);
+
+  /**
+   * Calculate the path loss of a link, or look it up in the cache, and fire
+   * the PathLoss trace.
+   *
+   * \param txParams the parameters of the transmission
+   * \param senderMobility the mobility model of the transmitter
+   * \param receiver the receiver
+   * \param receiverMobility the mobility model of the receiver
+   * \param txLinks the cached links of the transmitter, 0 to not use the cache
+   * \return the path loss of the link
+   */
+  LinkGain GetLinkGain (Ptr<SpectrumSignalParameters> txParams, Ptr<MobilityModel> senderMobility, Ptr<SpectrumPhy> receiver, Ptr<MobilityModel> receiverMobility, TxLinkGains *txLinks);
+
+  /**
+   * Add the active transmissions on the channel of a receiver that starts
+   * listening to its interference.
+   *
+   * \param phy the receiver
+   */
+  void AddActiveTxToRx (Ptr<LoRaWANPhy> phy);
+
+  /**
+   * Remove the transmissions that have ended from m_activeTx.
+   *
+   * \param channelIndex the LoRaWAN channel
+   */
+  void PruneActiveTx (uint8_t channelIndex);
+
+  /**
+   * An active LoRaWAN transmission.
+   */
+  struct ActiveTx
+  {
+    Ptr<LoRaWANSpectrumSignalParameters> params; //!< the shared parameters of the transmission
+    Ptr<MobilityModel> senderMobility;           //!< the mobility model of the transmitter
+    Time start;                                  //!< the start of the transmission
+  };
+
+  /**
+   * All receivers attached to the channel, in order of AddRx.
+   */
+  PhyList m_phyList;
+
+  /**
+   * Receivers tuned to a single LoRaWAN channel, per LoRaWAN channel index.
+   */
+  std::vector<PhyList> m_channelPhyLists;
+
+  /**
+   * Receivers that listen on all LoRaWAN channels.
+   */
+  PhyList m_allChannelsPhyList;
+
+  /**
+   * The bucket and position of every receiver, so that a retuned receiver
+   * can be moved without searching the buckets.
+   */
+  std::map<Ptr<SpectrumPhy>, RxLocation> m_rxLocations;
+
+  /**
+   * SpectrumModel that this channel instance is supporting.
+   */
+  Ptr<const SpectrumModel> m_spectrumModel;
+
+  /**
+   * Propagation delay model to be used with this channel.
+   */
+  Ptr<PropagationDelayModel> m_propagationDelay;
+
+  /**
+   * Single-frequency propagation loss model to be used with this channel.
+   */
+  Ptr<PropagationLossModel> m_propagationLoss;
+
+  /**
+   * Frequency-dependent propagation loss model to be used with this channel.
+   */
+  Ptr<SpectrumPropagationLossModel> m_spectrumPropagationLoss;
+
+  /**
+   * Maximum loss [dB].
+   *
+   * Any device above this loss is considered out of range.
+   */
+  double m_maxLossDb;
+
+  /**
+   * Cache the path gain of links.
+   */
+  bool m_cacheLinkGains;
+
+  /**
+   * The maximum number of cached links per transmitter, 0 for no limit.
+   */
+  uint32_t m_maxCachedLinks;
+
+  /**
+   * The cached links, per transmitter mobility model.
+   */
+  std::unordered_map<const MobilityModel *, TxLinkGains> m_linkGains;
+
+  /**
+   * The mobility models of which the CourseChange trace is connected.
+   */
+  std::set<Ptr<MobilityModel> > m_trackedMobilities;
+
+  /**
+   * Detach receivers that are not listening.
+   */
+  bool m_detachSleepingRx;
+
+  /**
+   * The number of detached receivers.
+   */
+  uint32_t m_nDetachedRx;
+
+  /**
+   * The active LoRaWAN transmissions per LoRaWAN channel, only kept when
+   * m_detachSleepingRx is set.
+   */
+  std::vector<std::vector<ActiveTx> > m_activeTx;
+
+  /**
+   * Trace fired whenever a path loss value is calculated (see
+   * SingleModelSpectrumChannel).
+   */
+  TracedCallback<Ptr<SpectrumPhy>, Ptr<SpectrumPhy>, double > m_pathLossTrace;
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_SPECTRUM_CHANNEL_H */
@@ -28,54 +28,34 @@ namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("LoRaWANSpectrumValueHelper");
 
-Ptr<SpectrumModel> g_LoRaWANSpectrumModel; //!< Global object that stores the LoRaWAN Spectrum Model
-
 /**
  * \ingroup lorawan
- * \brief Helper class used to automatically initialize the LoRaWAN Spectrum Model objects
+ * \brief Get the LoRaWAN Spectrum Model: one band per channel of the region in
+ * use, centered on the channel frequency and as wide as the channel
+ *
+ * The model is (re)built when the region changes, see LoRaWAN::SetRegion.
  */
-class LoRaWANSpectrumModelInitializer
+static Ptr<SpectrumModel>
+GetLoRaWANSpectrumModel (void)
 {
-public:
-  LoRaWANSpectrumModelInitializer(void)
-  {
-    NS_LOG_FUNCTION (this);
-
-    Bands bands;
-    // The three default 125kHz data channels available in EU863-870:
-    // 868.10, 868.30 & 868.50MHz
-    for (int i = 0; i < 3; i++)
-      {
-        BandInfo bi;
-        bi.fc = 868.10e6 + i * 200.0e3;
-        bi.fl = bi.fc - 62.5e3; // 62.5 kHz is half of 125 kHz bandwidth
-        bi.fh = bi.fc + 62.5e3;
-        bands.push_back (bi);
-      }
-
-    // Four 125kHz channels available in EU863-870:
-    // 867.10, 867.30 & 867.50 & 867.70MHz
-    for (int i = 0; i < 4; i++)
-      {
-        BandInfo bi;
-        bi.fc = 867.10e6 + i * 200.0e3;
-        bi.fl = bi.fc - 62.5e3; // 62.5 kHz is half of 125 kHz bandwidth
-        bi.fh = bi.fc + 62.5e3;
-        bands.push_back (bi);
-      }
-
-    // One 125kHz high power (27dBm) channel on 869.525MHz
+  static Ptr<SpectrumModel> model;
+  static LoRaWANRegion modelRegion;
+  if (!model || modelRegion != LoRaWAN::GetRegion ())
     {
-        BandInfo bi;
-        bi.fc = 869.525e6;
-        bi.fl = bi.fc - 62.5e3; // 62.5 kHz is half of 125 kHz bandwidth
-        bi.fh = bi.fc + 62.5e3;
-        bands.push_back (bi);
+      Bands bands;
+      for (const LoRaWANChannel &channel : LoRaWAN::m_supportedChannels)
+        {
+          BandInfo bi;
+          bi.fc = channel.m_fc;
+          bi.fl = bi.fc - channel.m_bw / 2.0;
+          bi.fh = bi.fc + channel.m_bw / 2.0;
+          bands.push_back (bi);
+        }
+      model = Create<SpectrumModel> (bands);
+      modelRegion = LoRaWAN::GetRegion ();
     }
-    g_LoRaWANSpectrumModel = Create<SpectrumModel> (bands);
-  }
-
-} g_LoRaWANSpectrumModelInitializerInstance; //!< Global object used to initialize the LoRaWAN Spectrum Model
+  return model;
+}
 
 /* ... */
 LoRaWANSpectrumValueHelper::LoRaWANSpectrumValueHelper(void)
@@ -102,14 +82,15 @@ LoRaWANSpectrumValueHelper::CreateTxPowerSpectralDensity (double txPower, uint32
   // all signal power is concentrated in the channel
 
   NS_LOG_FUNCTION (this);
-  Ptr<SpectrumValue> txPsd = Create <SpectrumValue> (g_LoRaWANSpectrumModel);
+  Ptr<SpectrumValue> txPsd = Create <SpectrumValue> (GetLoRaWANSpectrumModel ());
 
   // txPower is expressed in dBm. We must convert it into natural unit (W).
   txPower = pow (10.0, (txPower - 30) / 10);
 
-  double txPowerDensity = txPower / 125e3;
+  const uint32_t index = LoRaWANSpectrumValueHelper::GetPsdIndexForCenterFrequency (freq);
+  double txPowerDensity = txPower / LoRaWAN::m_supportedChannels[index].m_bw;
 
-  (*txPsd)[LoRaWANSpectrumValueHelper::GetPsdIndexForCenterFrequency(freq)] = txPowerDensity;
+  (*txPsd)[index] = txPowerDensity;
 
   return txPsd;
 }
@@ -119,17 +100,30 @@ LoRaWANSpectrumValueHelper::CreateNoisePowerSpectralDensity (uint32_t freq)
 {
   // TODO
   NS_LOG_FUNCTION (this);
-  Ptr<SpectrumValue> noisePsd = Create <SpectrumValue> (g_LoRaWANSpectrumModel);
+  Ptr<SpectrumValue> noisePsd = Create <SpectrumValue> (GetLoRaWANSpectrumModel ());
+
+  (*noisePsd)[LoRaWANSpectrumValueHelper::GetPsdIndexForCenterFrequency(freq)] = GetNoisePowerDensity ();
+
+  return noisePsd;
+}
+
+Ptr<SpectrumValue>
+LoRaWANSpectrumValueHelper::CreateNoisePowerSpectralDensity (void)
+{
+  NS_LOG_FUNCTION (this);
+  Ptr<SpectrumValue> noisePsd = Create <SpectrumValue> (GetLoRaWANSpectrumModel ());
+  *noisePsd = GetNoisePowerDensity ();
+  return noisePsd;
+}
 
+double
+LoRaWANSpectrumValueHelper::GetNoisePowerDensity (void) const
+{
   static const double BOLTZMANN = 1.3803e-23;
   // Nt  is the power of thermal noise in W
   double Nt = BOLTZMANN * 290.0;
   // noise Floor (W) which accounts for thermal noise and non-idealities of the receiver
-  double noisePowerDensity = m_noiseFactor * Nt;
-
-  (*noisePsd)[LoRaWANSpectrumValueHelper::GetPsdIndexForCenterFrequency(freq)] = noisePowerDensity;
-
-  return noisePsd;
+  return m_noiseFactor * Nt;
 }
 
 uint32_t
@@ -137,11 +131,9 @@ LoRaWANSpectrumValueHelper::GetPsdIndexForCenterFrequency(uint32_t freq)
 {
   NS_LOG_FUNCTION ("LoRaWANSpectrumValueHelper::GetPsdIndexForCenterFrequency");
 
-  for (uint8_t i = 0; i < LoRaWAN::m_supportedChannels.size (); i++) {
-    if (freq == LoRaWAN::m_supportedChannels[i].m_fc) {
-      return i;
-    }
-  }
+  const int16_t channelIndex = LoRaWAN::GetChannelIndexForFrequency (freq);
+  if (channelIndex >= 0)
+    return channelIndex;
 
   NS_LOG_ERROR ("LoRaWANSpectrumValueHelper::GetPsdIndexForCenterFrequency: " << "Invalid center frequency:" << freq);
   NS_ASSERT(0);
@@ -155,12 +147,13 @@ LoRaWANSpectrumValueHelper::TotalAvgPower (Ptr<const SpectrumValue> psd, uint32_
   NS_LOG_FUNCTION (psd);
   double totalAvgPower = 0.0;
 
-  NS_ASSERT (psd->GetSpectrumModel () == g_LoRaWANSpectrumModel);
+  NS_ASSERT (psd->GetSpectrumModel () == GetLoRaWANSpectrumModel ());
 
-  // numerically integrate to get area under psd using 125kHz resolution
+  // numerically integrate to get area under psd using the channel bandwidth as resolution
 
-  totalAvgPower += (*psd)[LoRaWANSpectrumValueHelper::GetPsdIndexForCenterFrequency(freq)];
-  totalAvgPower *= 125e3;
+  const uint32_t index = LoRaWANSpectrumValueHelper::GetPsdIndexForCenterFrequency (freq);
+  totalAvgPower += (*psd)[index];
+  totalAvgPower *= LoRaWAN::m_supportedChannels[index].m_bw;
 
   return totalAvgPower;
 }
@@ -54,6 +54,12 @@ public:
    */
   Ptr<SpectrumValue> CreateNoisePowerSpectralDensity (uint32_t channel);
 
+  /**
+   * \brief create spectrum value for noise in all channels
+   * \return a Ptr to a newly created SpectrumValue instance
+   */
+  Ptr<SpectrumValue> CreateNoisePowerSpectralDensity (void);
+
   /**
    * \brief total average power of the signal is the integral of the PSD using
    * the limits of the given channel
@@ -65,6 +71,10 @@ public:
 
 private:
   static uint32_t GetPsdIndexForCenterFrequency(uint32_t freq);
+  /**
+   * \return the noise power density (W/Hz)
+   */
+  double GetNoisePowerDensity (void) const;
   /**
    * A scaling factor for the noise power.
    */
@@ -0,0 +1,254 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include "lorawan-timer-wheel.h"
+#include <ns3/log.h>
+#include <ns3/simulator.h>
+#include <algorithm>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANTimerWheel");
+
+const uint32_t LoRaWANTimerWheel::m_nSlots;
+
+LoRaWANTimerWheel::LoRaWANTimerWheel ()
+  : m_resolution (MilliSeconds (1)),
+    m_resolutionSteps (MilliSeconds (1).GetTimeStep ()),
+    m_slots (m_nSlots),
+    m_occupied (m_nSlots / 64, 0),
+    m_nInWheel (0),
+    m_currentTick (0),
+    m_seq (0),
+    m_expiring (false),
+    m_eventTick (0),
+    m_nEvents (0),
+    m_nExpired (0),
+    m_nPendingEvents (0),
+    m_generation (0)
+{
+}
+
+LoRaWANTimerWheel::~LoRaWANTimerWheel ()
+{
+  m_event.Cancel ();
+}
+
+void
+LoRaWANTimerWheel::SetResolution (Time resolution)
+{
+  NS_LOG_FUNCTION (this << resolution);
+  NS_ASSERT_MSG (GetNPending () == 0, "The resolution of the timer wheel can not change while timers are pending");
+  NS_ASSERT (!resolution.IsStrictlyNegative ());
+  m_resolution = resolution;
+  m_resolutionSteps = resolution.GetTimeStep ();
+}
+
+Time
+LoRaWANTimerWheel::GetResolution (void) const
+{
+  return m_resolution;
+}
+
+void
+LoRaWANTimerWheel::SetExpireCallback (ExpireCallback callback)
+{
+  m_expireCallback = callback;
+}
+
+Time
+LoRaWANTimerWheel::Schedule (Time delay, uint32_t id, uint8_t type)
+{
+  NS_ASSERT (!delay.IsStrictlyNegative ());
+
+  if (m_resolutionSteps == 0) {
+    m_nEvents++;
+    m_nPendingEvents++;
+    Simulator::Schedule (delay, &LoRaWANTimerWheel::ExpireTimer, this, m_generation, id, type);
+    return Simulator::Now () + delay;
+  }
+
+  // The wheel was idle, so no timers expired during the ticks since
+  // m_currentTick. Catch up so that the timer is more likely to fit in the
+  // wheel.
+  const int64_t now = Simulator::Now ().GetTimeStep ();
+  if (m_nInWheel == 0 && m_overflow.empty () && !m_expiring) {
+    const uint64_t nowTick = now / m_resolutionSteps;
+    if (nowTick > m_currentTick + 1)
+      m_currentTick = nowTick - 1;
+  }
+
+  // Round up, timers never expire early
+  Entry entry;
+  entry.m_tick = (now + delay.GetTimeStep () + m_resolutionSteps - 1) / m_resolutionSteps;
+  if (entry.m_tick <= m_currentTick)
+    entry.m_tick = m_currentTick + 1;
+  entry.m_seq = m_seq++;
+  entry.m_id = id;
+  entry.m_type = type;
+
+  if (entry.m_tick < m_currentTick + m_nSlots)
+    Insert (entry);
+  else
+    m_overflow.push (entry);
+
+  // While timers are expiring, the next event is scheduled afterwards
+  if (!m_expiring && (!m_event.IsRunning () || entry.m_tick < m_eventTick))
+    ScheduleEvent (entry.m_tick);
+
+  return GetTickTime (entry.m_tick);
+}
+
+void
+LoRaWANTimerWheel::Insert (const Entry &entry)
+{
+  const uint32_t slot = entry.m_tick & (m_nSlots - 1);
+  m_slots[slot].push_back (entry);
+  m_occupied[slot >> 6] |= (uint64_t)1 << (slot & 63);
+  m_nInWheel++;
+}
+
+Time
+LoRaWANTimerWheel::GetExpiryTime (Time delay) const
+{
+  if (m_resolutionSteps == 0)
+    return Simulator::Now () + delay;
+
+  // Same rounding as in Schedule. Catching up m_currentTick in Schedule does
+  // not matter here, as it stays below the tick of the current time.
+  const uint64_t tick = (Simulator::Now ().GetTimeStep () + delay.GetTimeStep () + m_resolutionSteps - 1) / m_resolutionSteps;
+  return GetTickTime (std::max (tick, m_currentTick + 1));
+}
+
+void
+LoRaWANTimerWheel::ScheduleEvent (uint64_t tick)
+{
+  m_event.Cancel ();
+  m_eventTick = tick;
+  m_event = Simulator::Schedule (GetTickTime (tick) - Simulator::Now (), &LoRaWANTimerWheel::ExpireTick, this);
+  m_nEvents++;
+}
+
+Time
+LoRaWANTimerWheel::GetTickTime (uint64_t tick) const
+{
+  return TimeStep (tick * m_resolutionSteps);
+}
+
+uint64_t
+LoRaWANTimerWheel::FindNextTick (uint64_t tick) const
+{
+  if (m_nInWheel == 0)
+    return 0;
+
+  // The slots of the ticks after tick are searched 64 at a time. Slots do not
+  // wrap within a word of the bitmap, as m_nSlots is a multiple of 64.
+  for (uint64_t t = tick + 1; t < tick + m_nSlots; ) {
+    const uint32_t slot = t & (m_nSlots - 1);
+    const uint64_t word = m_occupied[slot >> 6] >> (slot & 63);
+    if (word)
+      return t + __builtin_ctzll (word);
+    t += 64 - (slot & 63);
+  }
+
+  NS_ASSERT_MSG (false, "Timer wheel holds timers, but no slot is occupied");
+  return 0;
+}
+
+void
+LoRaWANTimerWheel::ExpireTick (void)
+{
+  const uint64_t tick = m_eventTick;
+  NS_LOG_FUNCTION (this << tick);
+  NS_ASSERT (tick > m_currentTick);
+  m_currentTick = tick;
+
+  // Move the timers that now fit in the wheel out of the heap
+  while (!m_overflow.empty () && m_overflow.top ().m_tick < tick + m_nSlots) {
+    Insert (m_overflow.top ());
+    m_overflow.pop ();
+  }
+
+  // Timers scheduled by the callback never end up in the slot of this tick,
+  // so the slot can be iterated while the callback runs
+  m_expiring = true;
+  const uint32_t slot = tick & (m_nSlots - 1);
+  std::vector<Entry> &entries = m_slots[slot];
+  for (size_t k = 0; k < entries.size (); k++) {
+    NS_ASSERT (entries[k].m_tick == tick);
+    m_nInWheel--;
+    m_nExpired++;
+    m_expireCallback (entries[k].m_id, entries[k].m_type);
+  }
+  entries.clear ();
+  m_occupied[slot >> 6] &= ~((uint64_t)1 << (slot & 63));
+  m_expiring = false;
+
+  uint64_t nextTick = FindNextTick (tick);
+  if (!m_overflow.empty () && (nextTick == 0 || m_overflow.top ().m_tick < nextTick))
+    nextTick = m_overflow.top ().m_tick;
+  if (nextTick != 0)
+    ScheduleEvent (nextTick);
+}
+
+void
+LoRaWANTimerWheel::ExpireTimer (uint32_t generation, uint32_t id, uint8_t type)
+{
+  if (generation != m_generation)
+    return;
+
+  m_nPendingEvents--;
+  m_nExpired++;
+  m_expireCallback (id, type);
+}
+
+uint32_t
+LoRaWANTimerWheel::GetNPending (void) const
+{
+  return m_nInWheel + m_overflow.size () + m_nPendingEvents;
+}
+
+uint64_t
+LoRaWANTimerWheel::GetNEvents (void) const
+{
+  return m_nEvents;
+}
+
+uint64_t
+LoRaWANTimerWheel::GetNExpired (void) const
+{
+  return m_nExpired;
+}
+
+void
+LoRaWANTimerWheel::Clear (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_event.Cancel ();
+  for (auto it = m_slots.begin (); it != m_slots.end (); it++)
+    it->clear ();
+  std::fill (m_occupied.begin (), m_occupied.end (), 0);
+  m_overflow = std::priority_queue<Entry, std::vector<Entry>, Later> ();
+  m_nInWheel = 0;
+  m_nPendingEvents = 0;
+  m_generation++;
+}
+
+} // namespace ns3
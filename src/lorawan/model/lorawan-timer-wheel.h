@@ -0,0 +1,167 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#ifndef LORAWAN_TIMER_WHEEL_H
+#define LORAWAN_TIMER_WHEEL_H
+
+#include <ns3/nstime.h>
+#include <ns3/event-id.h>
+#include <ns3/callback.h>
+#include <stdint.h>
+#include <vector>
+#include <queue>
+
+namespace ns3 {
+
+/**
+ * \ingroup lorawan
+ *
+ * A hashed timer wheel for the many short timers of a network server (RW1,
+ * RW2 and DS traffic timers of every end device). Time is divided in ticks
+ * of a fixed resolution and a timer expires at the start of the first tick
+ * at or after its expiration time, i.e. never early. All timers that expire
+ * in the same tick share a single simulator event, and no simulator event is
+ * scheduled for ticks without timers.
+ *
+ * The wheel has m_nSlots slots, a timer is stored in the slot of its tick.
+ * Timers that expire more than one revolution of the wheel ahead are kept in
+ * a heap and moved to the wheel when the wheel gets close. A bitmap of the
+ * occupied slots is used to find the next tick with timers.
+ *
+ * Timers expire in the order in which they were scheduled when they fall in
+ * the same tick. Timers can not be cancelled, the owner should ignore a timer
+ * that is no longer needed when it expires.
+ */
+class LoRaWANTimerWheel
+{
+public:
+  /**
+   * Called when a timer expires, with the id and type passed to Schedule.
+   */
+  typedef Callback<void, uint32_t, uint8_t> ExpireCallback;
+
+  static const uint32_t m_nSlots = 4096;
+
+  LoRaWANTimerWheel ();
+  ~LoRaWANTimerWheel ();
+
+  /**
+   * Set the duration of a tick. A resolution of zero disables the wheel and
+   * schedules a simulator event for every timer. The resolution can only be
+   * changed while no timers are pending.
+   *
+   * \param resolution the duration of a tick
+   */
+  void SetResolution (Time resolution);
+  Time GetResolution (void) const;
+
+  void SetExpireCallback (ExpireCallback callback);
+
+  /**
+   * Schedule a timer.
+   *
+   * \param delay the delay after which the timer expires
+   * \param id passed to the expire callback, e.g. the index of an end device
+   * \param type passed to the expire callback, the kind of timer
+   * \return the time at which the timer will expire
+   */
+  Time Schedule (Time delay, uint32_t id, uint8_t type);
+
+  /**
+   * \param delay the delay of a timer
+   * \return the time at which the timer would expire if it was scheduled now
+   */
+  Time GetExpiryTime (Time delay) const;
+
+  /**
+   * \return the number of pending timers
+   */
+  uint32_t GetNPending (void) const;
+
+  /**
+   * \return the number of simulator events scheduled for expiring timers
+   */
+  uint64_t GetNEvents (void) const;
+
+  /**
+   * \return the number of expired timers
+   */
+  uint64_t GetNExpired (void) const;
+
+  /**
+   * Remove all pending timers.
+   */
+  void Clear (void);
+
+private:
+  typedef struct Entry {
+    uint64_t m_tick;
+    uint64_t m_seq;  //!< order in which the timers were scheduled
+    uint32_t m_id;
+    uint8_t m_type;
+  } Entry;
+
+  /**
+   * Orders the heap by tick, earliest first, and then by schedule order.
+   */
+  struct Later {
+    bool operator() (const Entry &a, const Entry &b) const
+    {
+      return a.m_tick > b.m_tick || (a.m_tick == b.m_tick && a.m_seq > b.m_seq);
+    }
+  };
+
+  void Insert (const Entry &entry);
+  void ScheduleEvent (uint64_t tick);
+  Time GetTickTime (uint64_t tick) const;
+
+  /**
+   * \param tick a tick
+   * \return the first tick after tick for which there are timers in the
+   * wheel, or 0 if the wheel is empty
+   */
+  uint64_t FindNextTick (uint64_t tick) const;
+
+  void ExpireTick (void);
+  void ExpireTimer (uint32_t generation, uint32_t id, uint8_t type);
+
+  Time m_resolution;
+  int64_t m_resolutionSteps;   //!< m_resolution in simulator time steps
+  ExpireCallback m_expireCallback;
+
+  std::vector<std::vector<Entry> > m_slots;
+  std::vector<uint64_t> m_occupied; //!< bitmap of slots with timers
+  std::priority_queue<Entry, std::vector<Entry>, Later> m_overflow; //!< timers beyond one revolution
+  uint32_t m_nInWheel;         //!< number of timers in m_slots
+  uint64_t m_currentTick;      //!< the last tick for which timers expired
+  uint64_t m_seq;
+  bool m_expiring;             //!< whether timers of m_currentTick are expiring
+
+  EventId m_event;             //!< simulator event of the next tick with timers
+  uint64_t m_eventTick;
+
+  uint64_t m_nEvents;
+  uint64_t m_nExpired;
+  uint32_t m_nPendingEvents;   //!< timers scheduled as simulator events, when the wheel is disabled
+  uint32_t m_generation;       //!< incremented by Clear, to ignore the simulator events of cleared timers
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_TIMER_WHEEL_H */
@@ -0,0 +1,306 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include "lorawan-uplink-log-reader.h"
+#include "lorawan.h"
+#include <ns3/log.h>
+#include <ns3/assert.h>
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANUplinkLogReader");
+
+const uint32_t LoRaWANUplinkLogReader::m_binaryRecordSize;
+
+LoRaWANUplinkLogReader::LoRaWANUplinkLogReader ()
+  : m_fd (-1),
+    m_format (LORAWAN_UPLINK_LOG_CSV),
+    m_fileSize (0),
+    m_windowSize (0),
+    m_pageSize (sysconf (_SC_PAGESIZE)),
+    m_window (0),
+    m_windowOffset (0),
+    m_windowLength (0),
+    m_offset (0),
+    m_nRecords (0),
+    m_nMalformed (0)
+{
+}
+
+LoRaWANUplinkLogReader::~LoRaWANUplinkLogReader ()
+{
+  Close ();
+}
+
+bool
+LoRaWANUplinkLogReader::Open (std::string filename, LoRaWANUplinkLogFormat format, uint64_t windowSize)
+{
+  NS_LOG_FUNCTION (this << filename << format << windowSize);
+
+  Close ();
+
+  m_fd = open (filename.c_str (), O_RDONLY);
+  if (m_fd < 0) {
+    NS_LOG_ERROR (this << " Unable to open " << filename << ": " << strerror (errno));
+    return false;
+  }
+
+  struct stat st;
+  if (fstat (m_fd, &st) != 0) {
+    NS_LOG_ERROR (this << " Unable to stat " << filename << ": " << strerror (errno));
+    Close ();
+    return false;
+  }
+
+  m_format = format;
+  m_fileSize = st.st_size;
+  m_windowSize = std::max<uint64_t> (1, (windowSize + m_pageSize - 1) / m_pageSize) * m_pageSize;
+  m_offset = 0;
+  m_nRecords = 0;
+  m_nMalformed = 0;
+
+  if (m_format == LORAWAN_UPLINK_LOG_BINARY && m_fileSize % m_binaryRecordSize != 0)
+    NS_LOG_WARN (this << " The size of " << filename << " is not a multiple of the record size, the last record is ignored");
+
+  return true;
+}
+
+void
+LoRaWANUplinkLogReader::Close (void)
+{
+  UnmapWindow ();
+  if (m_fd >= 0)
+    close (m_fd);
+  m_fd = -1;
+}
+
+bool
+LoRaWANUplinkLogReader::IsOpen (void) const
+{
+  return m_fd >= 0;
+}
+
+void
+LoRaWANUplinkLogReader::MapWindow (uint64_t offset)
+{
+  NS_LOG_FUNCTION (this << offset);
+  NS_ASSERT (offset < m_fileSize);
+
+  UnmapWindow ();
+  // One more page than the window size, so that a line of the window size
+  // fits when it starts anywhere in the first page
+  m_windowOffset = offset - offset % m_pageSize;
+  m_windowLength = std::min (m_windowSize + m_pageSize, m_fileSize - m_windowOffset);
+  void *window = mmap (0, m_windowLength, PROT_READ, MAP_PRIVATE, m_fd, m_windowOffset);
+  NS_ABORT_MSG_IF (window == MAP_FAILED, "Unable to map the uplink log: " << strerror (errno));
+  // The window is read once from start to end
+  madvise (window, m_windowLength, MADV_SEQUENTIAL);
+  m_window = static_cast<const char *> (window);
+}
+
+void
+LoRaWANUplinkLogReader::UnmapWindow (void)
+{
+  if (m_window)
+    munmap (const_cast<char *> (m_window), m_windowLength);
+  m_window = 0;
+  m_windowLength = 0;
+}
+
+bool
+LoRaWANUplinkLogReader::Next (LoRaWANUplinkRecord &record)
+{
+  if (m_fd < 0)
+    return false;
+
+  const bool found = m_format == LORAWAN_UPLINK_LOG_BINARY ? NextBinary (record) : NextCsv (record);
+  if (found)
+    m_nRecords++;
+  else
+    UnmapWindow (); // at the end of the log
+  return found;
+}
+
+bool
+LoRaWANUplinkLogReader::NextBinary (LoRaWANUplinkRecord &record)
+{
+  if (m_offset + m_binaryRecordSize > m_fileSize)
+    return false;
+
+  if (!m_window || m_offset + m_binaryRecordSize > m_windowOffset + m_windowLength)
+    MapWindow (m_offset);
+
+  const uint8_t *p = reinterpret_cast<const uint8_t *> (m_window + (m_offset - m_windowOffset));
+  uint64_t timestamp = 0;
+  for (int i = 7; i >= 0; i--)
+    timestamp = (timestamp << 8) | p[i];
+  record.m_timestamp = static_cast<int64_t> (timestamp);
+  record.m_devAddr = p[8] | (p[9] << 8) | (p[10] << 16) | ((uint32_t)p[11] << 24);
+  record.m_size = p[12];
+  record.m_dataRateIndex = p[13];
+  record.m_channelIndex = p[14];
+
+  m_offset += m_binaryRecordSize;
+  return true;
+}
+
+bool
+LoRaWANUplinkLogReader::NextCsv (LoRaWANUplinkRecord &record)
+{
+  while (m_offset < m_fileSize) {
+    if (!m_window || m_offset >= m_windowOffset + m_windowLength)
+      MapWindow (m_offset);
+
+    const char *line = m_window + (m_offset - m_windowOffset);
+    const uint64_t available = m_windowOffset + m_windowLength - m_offset;
+    const char *newline = static_cast<const char *> (memchr (line, '\n', available));
+    if (!newline && m_windowOffset + m_windowLength < m_fileSize) {
+      // The line continues in the next window. When the line starts in the
+      // first page of the window, it is longer than the window size.
+      NS_ABORT_MSG_IF (m_offset - m_windowOffset < m_pageSize,
+                       "A line of the uplink log at offset " << m_offset << " does not fit in a window of " << m_windowSize << " bytes");
+      MapWindow (m_offset);
+      continue;
+    }
+
+    const uint32_t length = newline ? newline - line : available;
+    m_offset += length + (newline ? 1 : 0);
+
+    if (length == 0 || line[0] == '#' || line[0] == '\r')
+      continue;
+    if (ParseCsvLine (line, length, record))
+      return true;
+
+    m_nMalformed++;
+    NS_LOG_DEBUG (this << " Skipping line that can not be parsed: " << std::string (line, length));
+  }
+  return false;
+}
+
+bool
+LoRaWANUplinkLogReader::ParseCsvLine (const char *line, uint32_t length, LoRaWANUplinkRecord &record)
+{
+  char buffer[256];
+  if (length >= sizeof (buffer))
+    return false;
+  memcpy (buffer, line, length);
+  buffer[length] = '\0';
+
+  // The fields, further fields (e.g. the RSSI) are ignored
+  char *fields[5];
+  char *p = buffer;
+  for (uint32_t i = 0; i < 5; i++) {
+    if (!p)
+      return false;
+    fields[i] = p;
+    p = strchr (p, ',');
+    if (p)
+      *p++ = '\0';
+  }
+
+  char *end;
+  const unsigned long long devAddr = strtoull (fields[0], &end, 16);
+  if (end == fields[0] || devAddr > 0xFFFFFFFFULL)
+    return false;
+  const double timestamp = strtod (fields[1], &end);
+  if (end == fields[1])
+    return false;
+  const unsigned long size = strtoul (fields[2], &end, 10);
+  if (end == fields[2] || size > 255)
+    return false;
+  const unsigned long dataRateIndex = strtoul (fields[3], &end, 10);
+  if (end == fields[3] || dataRateIndex > 15)
+    return false;
+  const double channel = strtod (fields[4], &end);
+  if (end == fields[4] || channel < 0)
+    return false;
+
+  // A channel index, or a center frequency in MHz or in Hz
+  int32_t channelIndex;
+  if (channel < 256 && channel == std::floor (channel))
+    channelIndex = static_cast<int32_t> (channel);
+  else
+    channelIndex = LoRaWAN::GetChannelIndexForFrequency (static_cast<uint32_t> (std::round (channel < 1e5 ? channel * 1e6 : channel)));
+  if (channelIndex < 0)
+    return false;
+
+  record.m_devAddr = static_cast<uint32_t> (devAddr);
+  record.m_timestamp = static_cast<int64_t> (std::llround (timestamp * 1e6));
+  record.m_size = static_cast<uint8_t> (size);
+  record.m_dataRateIndex = static_cast<uint8_t> (dataRateIndex);
+  record.m_channelIndex = static_cast<uint8_t> (channelIndex);
+  return true;
+}
+
+uint64_t
+LoRaWANUplinkLogReader::GetFileSize (void) const
+{
+  return m_fileSize;
+}
+
+uint64_t
+LoRaWANUplinkLogReader::GetOffset (void) const
+{
+  return m_offset;
+}
+
+uint64_t
+LoRaWANUplinkLogReader::GetWindowSize (void) const
+{
+  return m_windowSize;
+}
+
+uint64_t
+LoRaWANUplinkLogReader::GetNRecords (void) const
+{
+  return m_nRecords;
+}
+
+uint64_t
+LoRaWANUplinkLogReader::GetNMalformed (void) const
+{
+  return m_nMalformed;
+}
+
+void
+LoRaWANUplinkLogReader::WriteBinaryRecord (std::ostream &os, const LoRaWANUplinkRecord &record)
+{
+  uint8_t buffer[m_binaryRecordSize];
+  const uint64_t timestamp = static_cast<uint64_t> (record.m_timestamp);
+  for (int i = 0; i < 8; i++)
+    buffer[i] = (timestamp >> (8 * i)) & 0xFF;
+  for (int i = 0; i < 4; i++)
+    buffer[8 + i] = (record.m_devAddr >> (8 * i)) & 0xFF;
+  buffer[12] = record.m_size;
+  buffer[13] = record.m_dataRateIndex;
+  buffer[14] = record.m_channelIndex;
+  buffer[15] = 0; // reserved
+  os.write (reinterpret_cast<const char *> (buffer), m_binaryRecordSize);
+}
+
+} // namespace ns3
@@ -0,0 +1,173 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#ifndef LORAWAN_UPLINK_LOG_READER_H
+#define LORAWAN_UPLINK_LOG_READER_H
+
+#include <stdint.h>
+#include <string>
+#include <ostream>
+
+namespace ns3 {
+
+/**
+ * \ingroup lorawan
+ *
+ * An uplink of a network server log.
+ */
+typedef struct LoRaWANUplinkRecord {
+  uint32_t m_devAddr;       //!< Device address
+  int64_t m_timestamp;      //!< Reception time in microseconds, e.g. since the UNIX epoch
+  uint8_t m_size;           //!< Size of the PHYPayload
+  uint8_t m_dataRateIndex;  //!< Data rate index
+  uint8_t m_channelIndex;   //!< Channel index
+} LoRaWANUplinkRecord;
+
+/**
+ * \ingroup lorawan
+ *
+ * The formats of an uplink log.
+ */
+typedef enum
+{
+  /**
+   * One uplink per line: devAddr,timestamp,size,DR,channel. The device
+   * address is hexadecimal (e.g. 26011BDA), the timestamp is in seconds and
+   * may have a fraction, the channel is a channel index or a center frequency
+   * in MHz or in Hz. Empty lines, lines starting with # and lines that can not
+   * be parsed (e.g. a header line) are skipped.
+   */
+  LORAWAN_UPLINK_LOG_CSV = 0,
+  /**
+   * Records of 16 bytes, little endian: timestamp in microseconds (int64),
+   * devAddr (uint32), size, DR and channel index (uint8) and a reserved byte.
+   * See LoRaWANUplinkLogReader::WriteBinaryRecord.
+   */
+  LORAWAN_UPLINK_LOG_BINARY = 1,
+} LoRaWANUplinkLogFormat;
+
+/**
+ * \ingroup lorawan
+ *
+ * Streams the records of an uplink log that may be much larger than the
+ * memory. The file is memory mapped in windows of a fixed size: only the
+ * window of the next record is mapped, and the window moves forward through
+ * the file as records are read. Records are read in the order of the file.
+ */
+class LoRaWANUplinkLogReader
+{
+public:
+  static const uint32_t m_binaryRecordSize = 16;
+
+  LoRaWANUplinkLogReader ();
+  ~LoRaWANUplinkLogReader ();
+
+  /**
+   * Open a log, a log that is open is closed first.
+   *
+   * \param filename the log
+   * \param format the format of the log
+   * \param windowSize the size of the mapped window in bytes, rounded up to
+   * whole pages. A line of a CSV log should fit in a window.
+   * \return false if the log can not be opened
+   */
+  bool Open (std::string filename, LoRaWANUplinkLogFormat format, uint64_t windowSize);
+  void Close (void);
+  bool IsOpen (void) const;
+
+  /**
+   * Read the next record.
+   *
+   * \param record the record
+   * \return false at the end of the log
+   */
+  bool Next (LoRaWANUplinkRecord &record);
+
+  /**
+   * \return the size of the log in bytes
+   */
+  uint64_t GetFileSize (void) const;
+
+  /**
+   * \return the offset of the next record in the log
+   */
+  uint64_t GetOffset (void) const;
+
+  /**
+   * \return the size of the mapped window
+   */
+  uint64_t GetWindowSize (void) const;
+
+  /**
+   * \return the number of records that were read
+   */
+  uint64_t GetNRecords (void) const;
+
+  /**
+   * \return the number of lines of a CSV log that were skipped because they
+   * could not be parsed
+   */
+  uint64_t GetNMalformed (void) const;
+
+  /**
+   * Write a record in the binary format.
+   *
+   * \param os the stream, opened in binary mode
+   * \param record the record
+   */
+  static void WriteBinaryRecord (std::ostream &os, const LoRaWANUplinkRecord &record);
+
+private:
+  /**
+   * Map the window that starts at the page of an offset.
+   *
+   * \param offset the offset
+   */
+  void MapWindow (uint64_t offset);
+  void UnmapWindow (void);
+
+  bool NextBinary (LoRaWANUplinkRecord &record);
+  bool NextCsv (LoRaWANUplinkRecord &record);
+
+  /**
+   * \param line a line of a CSV log
+   * \param length the length of the line
+   * \param record the record
+   * \return false if the line can not be parsed
+   */
+  static bool ParseCsvLine (const char *line, uint32_t length, LoRaWANUplinkRecord &record);
+
+  int m_fd;
+  LoRaWANUplinkLogFormat m_format;
+  uint64_t m_fileSize;
+  uint64_t m_windowSize;
+  uint64_t m_pageSize;
+
+  const char *m_window;     //!< The mapped window, or 0
+  uint64_t m_windowOffset;  //!< Offset of the window in the log
+  uint64_t m_windowLength;  //!< Length of the window, m_windowSize and a page except at the end of the log
+  uint64_t m_offset;        //!< Offset of the next record
+
+  uint64_t m_nRecords;
+  uint64_t m_nMalformed;
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_UPLINK_LOG_READER_H */
@@ -0,0 +1,272 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include "lorawan-uplink-replay.h"
+#include "lorawan.h"
+#include "lorawan-net-device.h"
+#include "lorawan-bulk-traffic-generator.h"
+#include <ns3/log.h>
+#include <ns3/simulator.h>
+#include <ns3/ipv4-address.h>
+#include <ns3/string.h>
+#include <ns3/uinteger.h>
+#include <ns3/double.h>
+#include <ns3/enum.h>
+#include <cmath>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANUplinkReplay");
+
+NS_OBJECT_ENSURE_REGISTERED (LoRaWANUplinkReplay);
+
+TypeId
+LoRaWANUplinkReplay::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoRaWANUplinkReplay")
+    .SetParent<Object> ()
+    .SetGroupName ("LoRaWAN")
+    .AddConstructor<LoRaWANUplinkReplay> ()
+    .AddAttribute ("Filename",
+                   "The uplink log.",
+                   StringValue (""),
+                   MakeStringAccessor (&LoRaWANUplinkReplay::m_filename),
+                   MakeStringChecker ())
+    .AddAttribute ("Format",
+                   "The format of the uplink log, see LoRaWANUplinkLogFormat.",
+                   EnumValue (LORAWAN_UPLINK_LOG_CSV),
+                   MakeEnumAccessor (&LoRaWANUplinkReplay::m_format),
+                   MakeEnumChecker (LORAWAN_UPLINK_LOG_CSV, "Csv",
+                                    LORAWAN_UPLINK_LOG_BINARY, "Binary"))
+    .AddAttribute ("WindowSize",
+                   "The size in bytes of the window of the uplink log that is memory mapped.",
+                   UintegerValue (16 * 1024 * 1024),
+                   MakeUintegerAccessor (&LoRaWANUplinkReplay::m_windowSize),
+                   MakeUintegerChecker<uint64_t> (1))
+    .AddAttribute ("LogStartTime",
+                   "The time of the log in seconds (e.g. since the UNIX epoch) that is replayed at the start of the replay. "
+                   "Earlier uplinks are skipped. A negative value means the time of the first uplink of the log.",
+                   DoubleValue (-1.0),
+                   MakeDoubleAccessor (&LoRaWANUplinkReplay::m_logStartTime),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("AddressMapping",
+                   "How the device addresses of the log are mapped to the end devices of the generator.",
+                   EnumValue (LORAWAN_REPLAY_MAP_EXACT),
+                   MakeEnumAccessor (&LoRaWANUplinkReplay::m_addressMapping),
+                   MakeEnumChecker (LORAWAN_REPLAY_MAP_EXACT, "Exact",
+                                    LORAWAN_REPLAY_MAP_FIRST_SEEN, "FirstSeen"))
+  ;
+  return tid;
+}
+
+LoRaWANUplinkReplay::LoRaWANUplinkReplay ()
+  : m_format (LORAWAN_UPLINK_LOG_CSV),
+    m_windowSize (16 * 1024 * 1024),
+    m_logStartTime (-1.0),
+    m_addressMapping (LORAWAN_REPLAY_MAP_EXACT),
+    m_origin (0),
+    m_haveNext (false),
+    m_nextDeviceIndex (0),
+    m_nInjected (0),
+    m_nDropped (0),
+    m_nSkipped (0),
+    m_nLate (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+LoRaWANUplinkReplay::~LoRaWANUplinkReplay ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+LoRaWANUplinkReplay::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_event.Cancel ();
+  m_reader.Close ();
+  m_generator = 0;
+  Object::DoDispose ();
+}
+
+void
+LoRaWANUplinkReplay::SetGenerator (Ptr<LoRaWANBulkTrafficGenerator> generator)
+{
+  m_generator = generator;
+}
+
+Ptr<LoRaWANBulkTrafficGenerator>
+LoRaWANUplinkReplay::GetGenerator (void) const
+{
+  return m_generator;
+}
+
+void
+LoRaWANUplinkReplay::Start (Time delay)
+{
+  NS_LOG_FUNCTION (this << delay);
+  Simulator::Schedule (delay, &LoRaWANUplinkReplay::StartReplay, this);
+}
+
+void
+LoRaWANUplinkReplay::Stop (Time delay)
+{
+  NS_LOG_FUNCTION (this << delay);
+  Simulator::Schedule (delay, &LoRaWANUplinkReplay::StopReplay, this);
+}
+
+uint64_t
+LoRaWANUplinkReplay::GetNInjected (void) const
+{
+  return m_nInjected;
+}
+
+uint64_t
+LoRaWANUplinkReplay::GetNDropped (void) const
+{
+  return m_nDropped;
+}
+
+uint64_t
+LoRaWANUplinkReplay::GetNSkipped (void) const
+{
+  return m_nSkipped;
+}
+
+uint64_t
+LoRaWANUplinkReplay::GetNLate (void) const
+{
+  return m_nLate;
+}
+
+const LoRaWANUplinkLogReader &
+LoRaWANUplinkReplay::GetReader (void) const
+{
+  return m_reader;
+}
+
+void
+LoRaWANUplinkReplay::StartReplay (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  NS_ABORT_MSG_UNLESS (m_generator, "LoRaWANUplinkReplay needs a LoRaWANBulkTrafficGenerator");
+  if (!m_reader.Open (m_filename, m_format, m_windowSize))
+    NS_FATAL_ERROR ("Unable to open uplink log " << m_filename);
+
+  m_deviceIndexes.clear ();
+  m_nextDeviceIndex = 0;
+  if (m_addressMapping == LORAWAN_REPLAY_MAP_EXACT)
+    for (uint32_t i = 0; i < m_generator->GetNDevices (); i++)
+      m_deviceIndexes[Ipv4Address::ConvertFrom (m_generator->GetDevice (i)->GetAddress ()).Get ()] = i;
+
+  m_startTime = Simulator::Now ();
+  m_haveNext = m_reader.Next (m_next);
+  if (!m_haveNext) {
+    NS_LOG_WARN (this << " The uplink log " << m_filename << " is empty");
+    return;
+  }
+
+  m_origin = m_logStartTime < 0 ? m_next.m_timestamp : static_cast<int64_t> (std::llround (m_logStartTime * 1e6));
+  while (m_haveNext && m_next.m_timestamp < m_origin) {
+    m_nSkipped++;
+    m_haveNext = m_reader.Next (m_next);
+  }
+  ScheduleNext ();
+}
+
+void
+LoRaWANUplinkReplay::StopReplay (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_event.Cancel ();
+  m_haveNext = false;
+  m_reader.Close ();
+}
+
+Time
+LoRaWANUplinkReplay::GetRecordTime (const LoRaWANUplinkRecord &record) const
+{
+  return m_startTime + MicroSeconds (record.m_timestamp - m_origin);
+}
+
+void
+LoRaWANUplinkReplay::ScheduleNext (void)
+{
+  if (!m_haveNext) {
+    NS_LOG_INFO ("Replayed " << m_nInjected << " uplinks of " << m_filename);
+    m_reader.Close ();
+    return;
+  }
+
+  const Time delay = GetRecordTime (m_next) - Simulator::Now ();
+  m_event = Simulator::Schedule (std::max (Seconds (0), delay), &LoRaWANUplinkReplay::Inject, this);
+}
+
+bool
+LoRaWANUplinkReplay::GetDeviceIndex (uint32_t devAddr, uint32_t &deviceIndex)
+{
+  std::unordered_map<uint32_t, uint32_t>::const_iterator it = m_deviceIndexes.find (devAddr);
+  if (it != m_deviceIndexes.end ()) {
+    deviceIndex = it->second;
+    return true;
+  }
+
+  if (m_addressMapping == LORAWAN_REPLAY_MAP_FIRST_SEEN && m_nextDeviceIndex < m_generator->GetNDevices ()) {
+    deviceIndex = m_nextDeviceIndex++;
+    m_deviceIndexes[devAddr] = deviceIndex;
+    return true;
+  }
+  return false;
+}
+
+void
+LoRaWANUplinkReplay::Inject (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  const Time now = Simulator::Now ();
+  do {
+    if (GetRecordTime (m_next) < now)
+      m_nLate++;
+
+    uint32_t deviceIndex;
+    const LoRaWANUplinkRecord &r = m_next;
+    if (!GetDeviceIndex (r.m_devAddr, deviceIndex)) {
+      NS_LOG_DEBUG (this << " No end device for device address " << Ipv4Address (r.m_devAddr));
+      m_nDropped++;
+    } else if (r.m_dataRateIndex >= LoRaWAN::m_supportedDataRates.size () || !LoRaWAN::IsUplinkDataRate (r.m_dataRateIndex)
+               || r.m_channelIndex >= LoRaWAN::m_supportedChannels.size ()) {
+      NS_LOG_DEBUG (this << " Invalid data rate " << (uint32_t)r.m_dataRateIndex << " or channel " << (uint32_t)r.m_channelIndex);
+      m_nDropped++;
+    } else {
+      m_generator->SendUplink (deviceIndex, r.m_size, r.m_dataRateIndex, r.m_channelIndex);
+      m_nInjected++;
+    }
+
+    m_haveNext = m_reader.Next (m_next);
+  } while (m_haveNext && GetRecordTime (m_next) <= now);
+
+  ScheduleNext ();
+}
+
+} // namespace ns3
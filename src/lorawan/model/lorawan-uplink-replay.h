@@ -0,0 +1,179 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#ifndef LORAWAN_UPLINK_REPLAY_H
+#define LORAWAN_UPLINK_REPLAY_H
+
+#include <ns3/object.h>
+#include <ns3/nstime.h>
+#include <ns3/ptr.h>
+#include <ns3/event-id.h>
+#include "lorawan-uplink-log-reader.h"
+#include <string>
+#include <unordered_map>
+
+namespace ns3 {
+
+class LoRaWANBulkTrafficGenerator;
+
+/**
+ * \ingroup lorawan
+ *
+ * How the device addresses of an uplink log are mapped to end devices.
+ */
+typedef enum
+{
+  LORAWAN_REPLAY_MAP_EXACT = 0,      //!< To the end device with the same device address
+  LORAWAN_REPLAY_MAP_FIRST_SEEN = 1, //!< To the end devices in the order of installation, as the device addresses first appear in the log
+} LoRaWANReplayAddressMapping;
+
+/**
+ * \ingroup lorawan
+ *
+ * Replays the uplinks of a network server log: every uplink is sent by an
+ * end device at the time of the log, with the size, data rate and channel
+ * of the log. The uplinks are sent with LoRaWANBulkTrafficGenerator::SendUplink,
+ * so the end devices should be installed on a LoRaWANBulkTrafficGenerator
+ * (that does not have to be started).
+ *
+ * The log is streamed by a LoRaWANUplinkLogReader, so that logs that do not
+ * fit in the memory can be replayed. Only the next record of the log is kept
+ * in memory, and one simulator event is scheduled for all uplinks that are
+ * sent at the same time. The log should be sorted by time: uplinks with a
+ * time before the previous uplink are sent right away and counted as late.
+ *
+ * The LogStartTime of the log is the start time of the replay, earlier
+ * uplinks are skipped, e.g. to replay only a burst at a certain time of a
+ * long log.
+ */
+class LoRaWANUplinkReplay : public Object
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  LoRaWANUplinkReplay ();
+  virtual ~LoRaWANUplinkReplay ();
+
+  /**
+   * \param generator the generator with the end devices that send the uplinks
+   */
+  void SetGenerator (Ptr<LoRaWANBulkTrafficGenerator> generator);
+  Ptr<LoRaWANBulkTrafficGenerator> GetGenerator (void) const;
+
+  /**
+   * Start the replay after a delay. The log is opened when the replay starts.
+   *
+   * \param delay the delay
+   */
+  void Start (Time delay);
+
+  /**
+   * Stop the replay after a delay.
+   *
+   * \param delay the delay
+   */
+  void Stop (Time delay);
+
+  /**
+   * \return the number of uplinks that were sent
+   */
+  uint64_t GetNInjected (void) const;
+
+  /**
+   * \return the number of uplinks that were not sent because no end device
+   * was found for the device address, or the data rate or channel is not
+   * valid in the region
+   */
+  uint64_t GetNDropped (void) const;
+
+  /**
+   * \return the number of uplinks before the LogStartTime
+   */
+  uint64_t GetNSkipped (void) const;
+
+  /**
+   * \return the number of uplinks that were sent late, as the log is not
+   * sorted
+   */
+  uint64_t GetNLate (void) const;
+
+  const LoRaWANUplinkLogReader &GetReader (void) const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  void StartReplay (void);
+  void StopReplay (void);
+
+  /**
+   * Send the next uplink and all further uplinks that are due, and schedule
+   * an event for the uplink after these.
+   */
+  void Inject (void);
+
+  /**
+   * Schedule an event for the next uplink of the log.
+   */
+  void ScheduleNext (void);
+
+  /**
+   * \param record an uplink of the log
+   * \return the simulation time of the uplink
+   */
+  Time GetRecordTime (const LoRaWANUplinkRecord &record) const;
+
+  /**
+   * \param devAddr a device address of the log
+   * \param deviceIndex the index of the end device in the generator
+   * \return false if there is no end device for the address
+   */
+  bool GetDeviceIndex (uint32_t devAddr, uint32_t &deviceIndex);
+
+  Ptr<LoRaWANBulkTrafficGenerator> m_generator;
+  LoRaWANUplinkLogReader m_reader;
+
+  std::string m_filename;
+  LoRaWANUplinkLogFormat m_format;
+  uint64_t m_windowSize;
+  double m_logStartTime;       //!< In seconds, negative for the time of the first uplink
+  LoRaWANReplayAddressMapping m_addressMapping;
+
+  int64_t m_origin;            //!< Timestamp of the log at m_startTime, in microseconds
+  Time m_startTime;
+  LoRaWANUplinkRecord m_next;  //!< The next uplink of the log
+  bool m_haveNext;
+  EventId m_event;
+
+  std::unordered_map<uint32_t, uint32_t> m_deviceIndexes; //!< Device addresses of the log to device indexes
+  uint32_t m_nextDeviceIndex;  //!< Next end device for LORAWAN_REPLAY_MAP_FIRST_SEEN
+
+  uint64_t m_nInjected;
+  uint64_t m_nDropped;
+  uint64_t m_nSkipped;
+  uint64_t m_nLate;
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_UPLINK_REPLAY_H */
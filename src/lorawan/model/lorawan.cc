@@ -20,50 +20,394 @@
 #include "lorawan.h"
 #include <ns3/log.h>
 
+#include <algorithm>
+#include <unordered_map>
+
 namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("LoRaWAN");
 
 /* ... */
 
-const std::vector<LoRaWANChannel> LoRaWAN::m_supportedChannels = {
-  {0, 868100000, 125000, 1},
-  {1, 868300000, 125000, 1},
-  {2, 868500000, 125000, 1},
-  {3, 867100000, 125000, 1},
-  {4, 867300000, 125000, 1},
-  {5, 867500000, 125000, 1},
-  {6, 867700000, 125000, 1},
-  // {7, 867900000, 125000, 1}, // sacrifice for high power channel on 869525000
-  {7, 869525000, 125000, 3}, // NOTE: always keep this special high power channel as the last element in the m_supportedChannels vector
+/*
+ * Regional parameter profiles, see the LoRaWAN Regional Parameters
+ * specification. Only the default channels of a region are modelled, e.g. the
+ * eight 125 kHz channels in EU868 (where the 869.525 MHz channel replaces
+ * 867.9 MHz, as it is used for RW2) and the eight channels of the channel
+ * group that is used in US915 and AU915. Dwell time limits are not modelled.
+ */
+static constexpr LoRaWANChannelBlock g_eu868Channels[] = {
+  {3, 868100000, 200000, 125000, 1, 0, 6, true, true},
+  {4, 867100000, 200000, 125000, 1, 0, 6, true, true},
+  {1, 869525000, 0, 125000, 3, 0, 6, false, true}, // high power channel, for RW2
+};
+
+static constexpr LoRaWANDataRate g_eu868DataRates[] = {
+  {0, LORAWAN_SF12, 125000, 59},
+  {1, LORAWAN_SF11, 125000, 59},
+  {2, LORAWAN_SF10, 125000, 59},
+  {3, LORAWAN_SF9, 125000, 123},
+  {4, LORAWAN_SF8, 125000, 230},
+  {5, LORAWAN_SF7, 125000, 230},
+  {6, LORAWAN_SF7, 250000, 230},
+}; // we don't take FSK (DR7) into account, other indexes are RFU
+
+static constexpr LoRaWANSubBandPlan g_eu868SubBands[] = {
+  {100, 14}, // g (Note 7)
+  {100, 14}, // g1: 1%
+  {1000, 14}, // g2: 0.1%
+  {10, 27}, // g3: 10%, high power sub band
+  {100, 14}, // g4: 1%
+};
+
+static constexpr int8_t g_eu868TxPowers[] = {27, 20, 14, 11, 8, 5, 2};
+
+static constexpr LoRaWANChannelBlock g_us915Channels[] = {
+  {64, 902300000, 200000, 125000, 0, 0, 3, true, false},
+  {8, 903000000, 1600000, 500000, 1, 4, 4, true, false},
+  {8, 923300000, 600000, 500000, 2, 8, 13, false, true},
+};
+
+static constexpr LoRaWANDataRate g_us915DataRates[] = {
+  {0, LORAWAN_SF10, 125000, 19},
+  {1, LORAWAN_SF9, 125000, 61},
+  {2, LORAWAN_SF8, 125000, 133},
+  {3, LORAWAN_SF7, 125000, 250},
+  {4, LORAWAN_SF8, 500000, 250},
+  {5, LORAWAN_SF7, 0, 0}, // RFU
+  {6, LORAWAN_SF7, 0, 0}, // RFU
+  {7, LORAWAN_SF7, 0, 0}, // RFU
+  {8, LORAWAN_SF12, 500000, 41},
+  {9, LORAWAN_SF11, 500000, 117},
+  {10, LORAWAN_SF10, 500000, 230},
+  {11, LORAWAN_SF9, 500000, 230},
+  {12, LORAWAN_SF8, 500000, 230},
+  {13, LORAWAN_SF7, 500000, 230},
+};
+
+// No duty cycle limits in US915 and AU915
+static constexpr LoRaWANSubBandPlan g_us915SubBands[] = {
+  {1, 30}, // 125 kHz US channels
+  {1, 30}, // 500 kHz US channels
+  {1, 30}, // DS channels
+};
+
+static constexpr int8_t g_us915TxPowers[] = {30, 28, 26, 24, 22, 20, 18, 16, 14, 12, 10, 8, 6, 4, 2};
+
+static constexpr LoRaWANChannelBlock g_as923Channels[] = {
+  {2, 923200000, 200000, 125000, 0, 0, 7, true, true},
+  {6, 922000000, 200000, 125000, 0, 0, 7, true, true},
+};
+
+static constexpr LoRaWANDataRate g_as923DataRates[] = {
+  {0, LORAWAN_SF12, 125000, 59},
+  {1, LORAWAN_SF11, 125000, 59},
+  {2, LORAWAN_SF10, 125000, 59},
+  {3, LORAWAN_SF9, 125000, 123},
+  {4, LORAWAN_SF8, 125000, 230},
+  {5, LORAWAN_SF7, 125000, 230},
+  {6, LORAWAN_SF7, 250000, 230},
+  {7, LORAWAN_SF7, 0, 0}, // FSK is not modelled
+};
+
+static constexpr LoRaWANSubBandPlan g_as923SubBands[] = {
+  {100, 16}, // 1%
+};
+
+static constexpr int8_t g_as923TxPowers[] = {16, 14, 12, 10, 8, 6, 4, 2};
+
+static constexpr LoRaWANChannelBlock g_au915Channels[] = {
+  {64, 915200000, 200000, 125000, 0, 0, 5, true, false},
+  {8, 915900000, 1600000, 500000, 1, 6, 6, true, false},
+  {8, 923300000, 600000, 500000, 2, 8, 13, false, true},
+};
+
+static constexpr LoRaWANDataRate g_au915DataRates[] = {
+  {0, LORAWAN_SF12, 125000, 59},
+  {1, LORAWAN_SF11, 125000, 59},
+  {2, LORAWAN_SF10, 125000, 59},
+  {3, LORAWAN_SF9, 125000, 123},
+  {4, LORAWAN_SF8, 125000, 230},
+  {5, LORAWAN_SF7, 125000, 230},
+  {6, LORAWAN_SF8, 500000, 230},
+  {7, LORAWAN_SF7, 0, 0}, // RFU
+  {8, LORAWAN_SF12, 500000, 41},
+  {9, LORAWAN_SF11, 500000, 117},
+  {10, LORAWAN_SF10, 500000, 230},
+  {11, LORAWAN_SF9, 500000, 230},
+  {12, LORAWAN_SF8, 500000, 230},
+  {13, LORAWAN_SF7, 500000, 230},
 };
 
-const std::vector<LoRaWANDataRate> LoRaWAN::m_supportedDataRates = {
-  {0, LORAWAN_SF12, 125000},
-  {1, LORAWAN_SF11, 125000},
-  {2, LORAWAN_SF10, 125000},
-  {3, LORAWAN_SF9, 125000},
-  {4, LORAWAN_SF8, 125000},
-  {5, LORAWAN_SF7, 125000},
-  {6, LORAWAN_SF7, 250000}
-}; // other indexes are RFU
+#define LORAWAN_ARRAY_SIZE(a) (sizeof (a) / sizeof (a[0]))
+
+static constexpr LoRaWANRegionProfile g_regionProfiles[] = {
+  {"EU868", g_eu868Channels, LORAWAN_ARRAY_SIZE (g_eu868Channels), g_eu868DataRates, LORAWAN_ARRAY_SIZE (g_eu868DataRates),
+   g_eu868SubBands, LORAWAN_ARRAY_SIZE (g_eu868SubBands), g_eu868TxPowers, LORAWAN_ARRAY_SIZE (g_eu868TxPowers),
+   1, 0, 7, 0, true, 0, 0, 6, 5, 4},
+  {"US915", g_us915Channels, LORAWAN_ARRAY_SIZE (g_us915Channels), g_us915DataRates, LORAWAN_ARRAY_SIZE (g_us915DataRates),
+   g_us915SubBands, LORAWAN_ARRAY_SIZE (g_us915SubBands), g_us915TxPowers, LORAWAN_ARRAY_SIZE (g_us915TxPowers),
+   8, 1, 72, 8, false, 10, 8, 13, 3, 14},
+  {"AS923", g_as923Channels, LORAWAN_ARRAY_SIZE (g_as923Channels), g_as923DataRates, LORAWAN_ARRAY_SIZE (g_as923DataRates),
+   g_as923SubBands, LORAWAN_ARRAY_SIZE (g_as923SubBands), g_as923TxPowers, LORAWAN_ARRAY_SIZE (g_as923TxPowers),
+   1, 0, 0, 2, true, 0, 0, 7, 5, 7},
+  {"AU915", g_au915Channels, LORAWAN_ARRAY_SIZE (g_au915Channels), g_au915DataRates, LORAWAN_ARRAY_SIZE (g_au915DataRates),
+   g_us915SubBands, LORAWAN_ARRAY_SIZE (g_us915SubBands), g_us915TxPowers, LORAWAN_ARRAY_SIZE (g_us915TxPowers),
+   8, 1, 72, 8, false, 8, 8, 13, 5, 14},
+};
+
+static_assert (LORAWAN_ARRAY_SIZE (g_regionProfiles) == LORAWAN_REGION_AU915 + 1, "Missing region profile");
+static_assert (g_regionProfiles[LORAWAN_REGION_EU868].m_rw2ChannelIndex == 3 + 4, "RW2 should use the high power channel");
+// The 14 dBm sub bands of EU868 leave 14, 11, 8, 5 and 2 dBm
+static_assert (g_regionProfiles[LORAWAN_REGION_EU868].m_maxTxPowerIndex == 4, "ADR should not run past the EU868 TX power table");
+static_assert (g_regionProfiles[LORAWAN_REGION_US915].m_maxTxPowerIndex < LORAWAN_ARRAY_SIZE (g_us915TxPowers), "ADR should not run past the US915 TX power table");
+static_assert (g_regionProfiles[LORAWAN_REGION_AS923].m_maxTxPowerIndex < LORAWAN_ARRAY_SIZE (g_as923TxPowers), "ADR should not run past the AS923 TX power table");
+static_assert (g_regionProfiles[LORAWAN_REGION_AU915].m_maxTxPowerIndex < LORAWAN_ARRAY_SIZE (g_us915TxPowers), "ADR should not run past the AU915 TX power table");
+
+static std::vector<LoRaWANChannel>
+ExpandChannels (const LoRaWANRegionProfile &profile)
+{
+  std::vector<LoRaWANChannel> channels;
+  for (uint8_t b = 0; b < profile.m_nChannelBlocks; b++)
+    {
+      const LoRaWANChannelBlock &block = profile.m_channelBlocks[b];
+      for (uint8_t k = 0; k < block.m_nChannels; k++)
+        {
+          LoRaWANChannel channel = {static_cast<uint8_t> (channels.size ()), block.m_fc + k * block.m_spacing, block.m_bw, block.m_subBandIndex};
+          channels.push_back (channel);
+        }
+    }
+  return channels;
+}
+
+/**
+ * \ingroup lorawan
+ *
+ * Lookup tables that are derived from the region profile and the channel
+ * group in use
+ */
+struct LoRaWANRegionTables
+{
+  LoRaWANRegion region;
+  uint8_t channelGroup;
+  bool built;
+  std::unordered_map<uint32_t, uint8_t> channelIndexByFrequency;
+  std::vector<std::vector<uint8_t> > uplinkChannels; //!< per data rate index
+  std::vector<std::pair<uint8_t, uint8_t> > gatewayPhyConfigs;
+  std::vector<int16_t> gatewayPhyIndexes; //!< by channelIndex * number of data rates + dataRateIndex
+  uint8_t firstDownlinkChannel;
+  uint8_t nDownlinkChannels;
+
+  void Build (LoRaWANRegion region, uint8_t channelGroup);
+};
+
+void
+LoRaWANRegionTables::Build (LoRaWANRegion r, uint8_t group)
+{
+  const LoRaWANRegionProfile &profile = LoRaWAN::GetRegionProfile (r);
+  region = r;
+  channelGroup = group;
+  built = true;
+  channelIndexByFrequency.clear ();
+  uplinkChannels.assign (profile.m_nDataRates, std::vector<uint8_t> ());
+  gatewayPhyConfigs.clear ();
+  firstDownlinkChannel = 0;
+  nDownlinkChannels = 0;
+
+  uint8_t nChannels = 0;
+  for (uint8_t b = 0; b < profile.m_nChannelBlocks; b++)
+    nChannels += profile.m_channelBlocks[b].m_nChannels;
+  gatewayPhyIndexes.assign (nChannels * profile.m_nDataRates, -1);
+
+  uint8_t channelIndex = 0;
+  for (uint8_t b = 0; b < profile.m_nChannelBlocks; b++)
+    {
+      const LoRaWANChannelBlock &block = profile.m_channelBlocks[b];
+
+      // The US channels of a block are divided over the channel groups
+      uint8_t first = 0;
+      uint8_t last = block.m_nChannels;
+      if (block.m_uplink && profile.m_nChannelGroups > 1)
+        {
+          const uint8_t perGroup = block.m_nChannels / profile.m_nChannelGroups;
+          first = group * perGroup;
+          last = first + perGroup;
+        }
+      if (block.m_downlink && nDownlinkChannels == 0)
+        {
+          firstDownlinkChannel = channelIndex;
+          nDownlinkChannels = block.m_nChannels;
+        }
+
+      for (uint8_t k = 0; k < block.m_nChannels; k++, channelIndex++)
+        {
+          channelIndexByFrequency[block.m_fc + k * block.m_spacing] = channelIndex;
+
+          const bool uplink = block.m_uplink && k >= first && k < last;
+          if (!uplink && !block.m_downlink)
+            continue;
+          for (uint8_t dr = block.m_minDataRateIndex; dr <= block.m_maxDataRateIndex; dr++)
+            {
+              if (profile.m_dataRates[dr].bandWith == 0)
+                continue;
+              if (uplink)
+                uplinkChannels[dr].push_back (channelIndex);
+              gatewayPhyIndexes[channelIndex * profile.m_nDataRates + dr] = gatewayPhyConfigs.size ();
+              gatewayPhyConfigs.push_back (std::make_pair (channelIndex, dr));
+            }
+        }
+    }
+}
+
+static LoRaWANRegionTables &
+GetRegionTables (LoRaWANRegion region, uint8_t channelGroup)
+{
+  static LoRaWANRegionTables tables = LoRaWANRegionTables ();
+  if (!tables.built || tables.region != region || tables.channelGroup != channelGroup)
+    tables.Build (region, channelGroup);
+  return tables;
+}
+
+LoRaWANRegion LoRaWAN::m_region = LORAWAN_REGION_EU868;
+uint8_t LoRaWAN::m_channelGroup = 0;
 
-uint8_t LoRaWAN::m_RW2ChannelIndex = LoRaWAN::m_supportedChannels.size () - 1; // high power channel, assume this is last channel in m_supportedChannels
-uint8_t LoRaWAN::m_RW2DataRateIndex = 0; // lowest spreading factor
+std::vector<LoRaWANChannel> LoRaWAN::m_supportedChannels = ExpandChannels (g_regionProfiles[LORAWAN_REGION_EU868]);
+
+std::vector<LoRaWANDataRate> LoRaWAN::m_supportedDataRates (g_eu868DataRates, g_eu868DataRates + LORAWAN_ARRAY_SIZE (g_eu868DataRates));
+
+uint8_t LoRaWAN::m_RW2ChannelIndex = g_regionProfiles[LORAWAN_REGION_EU868].m_rw2ChannelIndex; // high power channel
+uint8_t LoRaWAN::m_RW2DataRateIndex = g_regionProfiles[LORAWAN_REGION_EU868].m_rw2DataRateIndex; // lowest spreading factor
+
+void
+LoRaWAN::SetRegion (LoRaWANRegion region, uint8_t channelGroup)
+{
+  const LoRaWANRegionProfile &profile = GetRegionProfile (region);
+  NS_LOG_FUNCTION (profile.m_name << static_cast<uint16_t> (channelGroup));
+  NS_ASSERT_MSG (channelGroup < profile.m_nChannelGroups, "Invalid channel group " << static_cast<uint16_t> (channelGroup) << " for region " << profile.m_name);
+
+  m_region = region;
+  m_channelGroup = channelGroup;
+  m_supportedChannels = ExpandChannels (profile);
+  m_supportedDataRates.assign (profile.m_dataRates, profile.m_dataRates + profile.m_nDataRates);
+  m_RW2ChannelIndex = profile.m_rw2ChannelIndex;
+  m_RW2DataRateIndex = profile.m_rw2DataRateIndex;
+  GetRegionTables (m_region, m_channelGroup);
+}
+
+void
+LoRaWAN::SetRegion (LoRaWANRegion region)
+{
+  SetRegion (region, GetRegionProfile (region).m_defaultChannelGroup);
+}
+
+LoRaWANRegion
+LoRaWAN::GetRegion (void)
+{
+  return m_region;
+}
+
+uint8_t
+LoRaWAN::GetChannelGroup (void)
+{
+  return m_channelGroup;
+}
+
+const LoRaWANRegionProfile &
+LoRaWAN::GetRegionProfile (LoRaWANRegion region)
+{
+  NS_ASSERT (region < LORAWAN_ARRAY_SIZE (g_regionProfiles));
+  return g_regionProfiles[region];
+}
+
+int16_t
+LoRaWAN::GetChannelIndexForFrequency (uint32_t frequency)
+{
+  const LoRaWANRegionTables &tables = GetRegionTables (m_region, m_channelGroup);
+  std::unordered_map<uint32_t, uint8_t>::const_iterator it = tables.channelIndexByFrequency.find (frequency);
+  return it != tables.channelIndexByFrequency.end () ? it->second : -1;
+}
+
+const std::vector<uint8_t> &
+LoRaWAN::GetUplinkChannels (uint8_t dataRateIndex)
+{
+  const LoRaWANRegionTables &tables = GetRegionTables (m_region, m_channelGroup);
+  NS_ASSERT (dataRateIndex < tables.uplinkChannels.size ());
+  return tables.uplinkChannels[dataRateIndex];
+}
+
+bool
+LoRaWAN::IsUplinkDataRate (uint8_t dataRateIndex)
+{
+  const LoRaWANRegionTables &tables = GetRegionTables (m_region, m_channelGroup);
+  return dataRateIndex < tables.uplinkChannels.size () && !tables.uplinkChannels[dataRateIndex].empty ();
+}
+
+const std::vector<std::pair<uint8_t, uint8_t> > &
+LoRaWAN::GetGatewayPhyConfigs (void)
+{
+  return GetRegionTables (m_region, m_channelGroup).gatewayPhyConfigs;
+}
+
+int16_t
+LoRaWAN::GetGatewayPhyIndex (uint8_t channelIndex, uint8_t dataRateIndex)
+{
+  if (channelIndex >= m_supportedChannels.size () || dataRateIndex >= m_supportedDataRates.size ())
+    return -1;
+  return GetRegionTables (m_region, m_channelGroup).gatewayPhyIndexes[channelIndex * m_supportedDataRates.size () + dataRateIndex];
+}
+
+bool
+LoRaWAN::IsValidTxPower (int8_t txPower)
+{
+  const LoRaWANRegionProfile &profile = GetRegionProfile (m_region);
+  for (uint8_t i = 0; i < profile.m_nTxPowers; i++)
+    if (profile.m_txPowers[i] == txPower)
+      return true;
+  return false;
+}
+
+int8_t
+LoRaWAN::GetTxPower (int8_t maxTxPower, uint8_t txPowerIndex)
+{
+  const LoRaWANRegionProfile &profile = GetRegionProfile (m_region);
+  uint8_t i = 0;
+  while (i + 1 < profile.m_nTxPowers && profile.m_txPowers[i] > maxTxPower)
+    i++;
+  return profile.m_txPowers[std::min<uint16_t> (i + txPowerIndex, profile.m_nTxPowers - 1)];
+}
 
 uint8_t
 LoRaWAN::GetRX1DataRateIndex (uint8_t upstreamDRIndex, uint8_t rx1DROffset)
 {
-  if (rx1DROffset == 0 || rx1DROffset == 1 ||rx1DROffset == 2 ||rx1DROffset == 3 ||rx1DROffset == 4 ||rx1DROffset == 5)
-    if (upstreamDRIndex <= rx1DROffset)
-      return 0;
-    else
-      return upstreamDRIndex - rx1DROffset;
-  else {
+  if (rx1DROffset > 5) {
     NS_LOG_WARN ("LoRaWAN::GetRX1DataRateIndex Invalid rx1DROffset: " << static_cast<uint16_t>(rx1DROffset));
     return upstreamDRIndex;
   }
+
+  const LoRaWANRegionProfile &profile = GetRegionProfile (m_region);
+  const int16_t dataRateIndex = std::min<int16_t> (upstreamDRIndex + profile.m_rx1DataRateBase, profile.m_rx1MaxDataRateIndex) - rx1DROffset;
+  return std::max<int16_t> (dataRateIndex, profile.m_rx1MinDataRateIndex);
 }
+
+uint8_t
+LoRaWAN::GetRX1ChannelIndex (uint8_t upstreamChannelIndex)
+{
+  if (GetRegionProfile (m_region).m_rx1SameChannel)
+    return upstreamChannelIndex;
+
+  const LoRaWANRegionTables &tables = GetRegionTables (m_region, m_channelGroup);
+  return tables.firstDownlinkChannel + upstreamChannelIndex % tables.nDownlinkChannels;
+}
+
+double
+LoRaWAN::GetDemodulationFloor (uint8_t dataRateIndex)
+{
+  NS_ASSERT (dataRateIndex < m_supportedDataRates.size ());
+
+  // -7.5 dB for SF7 and 2.5 dB less for every next spreading factor
+  return -7.5 - 2.5 * (m_supportedDataRates [dataRateIndex].spreadingFactor - LORAWAN_SF7);
+}
+
 /****************************************************************************
  ************************ LoRaWANMsgTypeTag *********************************
  ****************************************************************************/
@@ -210,6 +554,150 @@ LoRaWANPhyParamsTag::Print (std::ostream &os) const
   os << "LORWAN_PHY_RX_PARMS: channelIndex = " << m_channelIndex << ", dataRateIndex = " << m_dataRateIndex << ", codeRate = " << m_codeRate;
 }
 
+/****************************************************************************
+ *********************** LoRaWANRxMetadataTag *******************************
+ ****************************************************************************/
+
+LoRaWANRxMetadataTag::LoRaWANRxMetadataTag ()
+  : m_rssi (0.0),
+    m_snr (0.0)
+{
+}
+
+void
+LoRaWANRxMetadataTag::SetRssi (double rssi)
+{
+  m_rssi = rssi;
+}
+
+double
+LoRaWANRxMetadataTag::GetRssi (void) const
+{
+  return m_rssi;
+}
+
+void
+LoRaWANRxMetadataTag::SetSnr (double snr)
+{
+  m_snr = snr;
+}
+
+double
+LoRaWANRxMetadataTag::GetSnr (void) const
+{
+  return m_snr;
+}
+
+TypeId
+LoRaWANRxMetadataTag::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoRaWANRxMetadataTag")
+    .SetParent<Tag> ()
+    .SetGroupName("LoRaWAN")
+    .AddConstructor<LoRaWANRxMetadataTag> ()
+    ;
+  return tid;
+}
+
+TypeId
+LoRaWANRxMetadataTag::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+uint32_t
+LoRaWANRxMetadataTag::GetSerializedSize (void) const
+{
+  return 2 * sizeof (double);
+}
+
+void
+LoRaWANRxMetadataTag::Serialize (TagBuffer i) const
+{
+  i.WriteDouble (m_rssi);
+  i.WriteDouble (m_snr);
+}
+
+void
+LoRaWANRxMetadataTag::Deserialize (TagBuffer i)
+{
+  m_rssi = i.ReadDouble ();
+  m_snr = i.ReadDouble ();
+}
+
+void
+LoRaWANRxMetadataTag::Print (std::ostream &os) const
+{
+  os << "LORWAN_PHY_RX_METADATA: rssi = " << m_rssi << " dBm, snr = " << m_snr << " dB";
+}
+
+/****************************************************************************
+ *********************** LoRaWANMicTag **************************************
+ ****************************************************************************/
+
+LoRaWANMicTag::LoRaWANMicTag ()
+  : m_mic (0)
+{
+}
+
+LoRaWANMicTag::LoRaWANMicTag (uint32_t mic)
+  : m_mic (mic)
+{
+}
+
+void
+LoRaWANMicTag::SetMic (uint32_t mic)
+{
+  m_mic = mic;
+}
+
+uint32_t
+LoRaWANMicTag::GetMic (void) const
+{
+  return m_mic;
+}
+
+TypeId
+LoRaWANMicTag::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoRaWANMicTag")
+    .SetParent<Tag> ()
+    .SetGroupName("LoRaWAN")
+    .AddConstructor<LoRaWANMicTag> ()
+    ;
+  return tid;
+}
+
+TypeId
+LoRaWANMicTag::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+uint32_t
+LoRaWANMicTag::GetSerializedSize (void) const
+{
+  return sizeof (uint32_t);
+}
+
+void
+LoRaWANMicTag::Serialize (TagBuffer i) const
+{
+  i.WriteU32 (m_mic);
+}
+
+void
+LoRaWANMicTag::Deserialize (TagBuffer i)
+{
+  m_mic = i.ReadU32 ();
+}
+
+void
+LoRaWANMicTag::Print (std::ostream &os) const
+{
+  os << "LORWAN_MIC: mic = " << std::hex << m_mic << std::dec;
+}
+
 uint64_t LoRaWANCounterSingleton::m_counter = -1; // highest possible 64 bit number: 0xffffffffffffffff
 
 //LoRaWANCounterSingleton*
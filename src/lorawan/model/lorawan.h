@@ -25,14 +25,19 @@
 #include <ns3/flow-id-tag.h>
 
 #include <vector>
+#include <utility>
 
 // For confirmed messages: number of transmissions
 #define DEFAULT_NUMBER_US_TRANSMISSIONS 4
 #define DEFAULT_NUMBER_DS_TRANSMISSIONS DEFAULT_NUMBER_US_TRANSMISSIONS
 
-// Default settings for EU863-870
+// Default settings for EU863-870, and for the other regions of LoRaWAN::SetRegion
 #define RECEIVE_DELAY1 1000000 // in uS
 #define RECEIVE_DELAY2 2000000 // in uS
+#define JOIN_ACCEPT_DELAY1 5000000 // in uS
+#define JOIN_ACCEPT_DELAY2 6000000 // in uS
+
+#define LORAWAN_MAX_PHY_PAYLOAD_SIZE 255 // MHDR, MACPayload and MIC, in bytes
 
 namespace ns3 {
 
@@ -76,9 +81,98 @@ namespace ns3 {
   {
     uint8_t dataRateIndex;
     LoRaSpreadingFactor spreadingFactor;
-    uint32_t bandWith;
+    uint32_t bandWith; // zero for a data rate index that is RFU in the region
+    uint8_t maxMACPayloadSize; // M in the regional parameters, without the MAC header and MIC
   } LoRaWANDataRate;
 
+  /**
+   * \ingroup lorawan
+   *
+   * Regional parameter profiles, see LoRaWAN::SetRegion
+   */
+  typedef enum
+  {
+    LORAWAN_REGION_EU868 = 0,
+    LORAWAN_REGION_US915,
+    LORAWAN_REGION_AS923,
+    LORAWAN_REGION_AU915,
+  } LoRaWANRegion;
+
+  /**
+   * \ingroup lorawan
+   *
+   * A block of m_nChannels equally spaced channels of a channel plan. The
+   * channels of a block can be used for US transmissions, for DS
+   * transmissions or for both, at the data rates in [m_minDataRateIndex,
+   * m_maxDataRateIndex].
+   */
+  typedef struct
+  {
+    uint8_t m_nChannels;
+    uint32_t m_fc; // center frequency of the first channel, in Hz
+    uint32_t m_spacing; // in Hz
+    uint32_t m_bw;
+    uint8_t m_subBandIndex;
+    uint8_t m_minDataRateIndex;
+    uint8_t m_maxDataRateIndex;
+    bool m_uplink;
+    bool m_downlink;
+  } LoRaWANChannelBlock;
+
+  /**
+   * \ingroup lorawan
+   *
+   * Duty cycle limit and maximum TX power of a sub band, see LoRaWANSubBand
+   */
+  typedef struct
+  {
+    uint16_t m_dutyCycleLimit; // 1 means that the sub band has no duty cycle limit
+    int8_t m_maxTxPower; // in dBm
+  } LoRaWANSubBandPlan;
+
+  /**
+   * \ingroup lorawan
+   *
+   * The regional parameters of a region. The tables are compile-time
+   * constants, LoRaWAN::SetRegion expands them into the channels and data
+   * rates that the model uses.
+   */
+  typedef struct
+  {
+    const char *m_name;
+    const LoRaWANChannelBlock *m_channelBlocks;
+    uint8_t m_nChannelBlocks;
+    const LoRaWANDataRate *m_dataRates; // indexed by data rate index
+    uint8_t m_nDataRates;
+    const LoRaWANSubBandPlan *m_subBands; // indexed by sub band index
+    uint8_t m_nSubBands;
+    const int8_t *m_txPowers; // the TX powers (in dBm) that a PHY can be configured with, in decreasing order
+    uint8_t m_nTxPowers;
+    /**
+     * The US channels are divided in this number of channel groups, of which
+     * end devices and gateways only use one (e.g. 8 groups of 8 + 1 channels
+     * in US915). One means that all US channels are used.
+     */
+    uint8_t m_nChannelGroups;
+    uint8_t m_defaultChannelGroup;
+    uint8_t m_rw2ChannelIndex;
+    uint8_t m_rw2DataRateIndex;
+    /**
+     * RW1 is on the US channel when m_rx1SameChannel is true, otherwise on DS
+     * channel number (US channel index modulo the number of DS channels).
+     */
+    bool m_rx1SameChannel;
+    /**
+     * The RW1 data rate is the US data rate plus m_rx1DataRateBase minus the
+     * RX1DROffset, limited to [m_rx1MinDataRateIndex, m_rx1MaxDataRateIndex]
+     */
+    uint8_t m_rx1DataRateBase;
+    uint8_t m_rx1MinDataRateIndex;
+    uint8_t m_rx1MaxDataRateIndex;
+    uint8_t m_maxAdrDataRateIndex; // highest data rate that ADR assigns
+    uint8_t m_maxTxPowerIndex; // lowest TX power that ADR assigns, see LoRaWAN::GetTxPower
+  } LoRaWANRegionProfile;
+
 
   /**
    * \ingroup lorawan
@@ -110,24 +204,119 @@ namespace ns3 {
    LORAWAN_PROPRIETARY,
   } LoRaWANMsgType;
 
+  /**
+   * \ingroup lorawan
+   *
+   * What to drop when a packet is queued in a full queue. A queued packet
+   * that is being transmitted is never dropped, so DROP_HEAD falls back to
+   * dropping the new packet when the head of the queue is in transmission.
+   */
+  typedef enum
+  {
+   LORAWAN_QUEUE_DROP_TAIL = 0, //!< drop the new packet
+   LORAWAN_QUEUE_DROP_HEAD,     //!< drop the oldest queued packet
+  } LoRaWANQueueDropPolicy;
+
   class LoRaWAN {
 
   public:
     /**
-     * The supported LoRa channels
+     * The supported LoRa channels of the region, the channel index is the
+     * index in this vector. Set by SetRegion, do not modify.
+     */
+    static std::vector<LoRaWANChannel> m_supportedChannels;
+
+    /**
+     * The supported LoRaWAN data rates of the region, indexed by data rate
+     * index. Set by SetRegion, do not modify.
+     */
+    static std::vector<LoRaWANDataRate> m_supportedDataRates;
+
+    /**
+     * Select the regional parameters that are used by all LoRaWAN devices of
+     * the simulation. The region should be selected before LoRaWAN devices
+     * are created (see LoRaWANHelper::SetRegion), the default region is
+     * EU868.
+     *
+     * \param region the region
+     * \param channelGroup the group of US channels that end devices and
+     * gateways use, see LoRaWANRegionProfile::m_nChannelGroups
      */
-    static const std::vector<LoRaWANChannel> m_supportedChannels;
+    static void SetRegion (LoRaWANRegion region, uint8_t channelGroup);
+    static void SetRegion (LoRaWANRegion region);
+    static LoRaWANRegion GetRegion (void);
+    static uint8_t GetChannelGroup (void);
+    static const LoRaWANRegionProfile &GetRegionProfile (LoRaWANRegion region);
 
     /**
-     * The supported LoRaWAN data rates
+     * \param frequency a center frequency in Hz
+     * \return the index of the channel with the center frequency, or -1 when
+     * there is no such channel
      */
-    static const std::vector<LoRaWANDataRate> m_supportedDataRates;
+    static int16_t GetChannelIndexForFrequency (uint32_t frequency);
+
+    /**
+     * \param dataRateIndex a data rate index
+     * \return the indexes of the channels that end devices use for US
+     * transmissions at the data rate
+     */
+    static const std::vector<uint8_t> &GetUplinkChannels (uint8_t dataRateIndex);
+
+    /**
+     * \return whether end devices can send at the data rate
+     */
+    static bool IsUplinkDataRate (uint8_t dataRateIndex);
+
+    /**
+     * \return the channel and data rate of every PHY of a gateway: the US
+     * channels in use at their data rates and the DS channels at the DS data
+     * rates
+     */
+    static const std::vector<std::pair<uint8_t, uint8_t> > &GetGatewayPhyConfigs (void);
+
+    /**
+     * \return the index in GetGatewayPhyConfigs of the channel and data rate,
+     * or -1 when a gateway has no PHY for them
+     */
+    static int16_t GetGatewayPhyIndex (uint8_t channelIndex, uint8_t dataRateIndex);
+
+    /**
+     * \return whether a PHY can be configured with the TX power (in dBm)
+     */
+    static bool IsValidTxPower (int8_t txPower);
+
+    /**
+     * Map a TX power index on the TX power table of the region. Index 0 is
+     * the highest TX power in the table that does not exceed maxTxPower,
+     * every next index is the next lower TX power in the table. Indexes past
+     * the end of the table give the lowest TX power.
+     *
+     * \param maxTxPower the maximum TX power of the sub band in dBm
+     * \param txPowerIndex the TX power index, see LoRaWANMac::SetTxPowerIndex
+     * \return the TX power in dBm, for which IsValidTxPower holds
+     */
+    static int8_t GetTxPower (int8_t maxTxPower, uint8_t txPowerIndex);
 
     /*
-     * Get the RX1 receive window data rate, note frequency is always the same for RW1
+     * Get the RX1 receive window data rate
      */
     static uint8_t GetRX1DataRateIndex (uint8_t upstreamDRIndex, uint8_t rx1DROffset);
 
+    /**
+     * Get the RX1 receive window channel, which is the channel of the US
+     * transmission in e.g. EU868 and a DS channel in e.g. US915
+     */
+    static uint8_t GetRX1ChannelIndex (uint8_t upstreamChannelIndex);
+
+    /**
+     * Get the demodulation floor of a data rate, i.e. the minimum SNR at which
+     * a LoRa receiver can demodulate (see the SX1272 data sheet).
+     *
+     * \param dataRateIndex the index of the data rate in m_supportedDataRates
+     * \return the minimum SNR in dB
+     */
+    static double GetDemodulationFloor (uint8_t dataRateIndex);
+
     /**
      * The channel and data rate index for transmissions in the second receive
      * window (RW2) of a class A end device
@@ -135,6 +324,10 @@ namespace ns3 {
     static uint8_t m_RW2ChannelIndex;
     static uint8_t m_RW2DataRateIndex;
 
+  private:
+    static LoRaWANRegion m_region;
+    static uint8_t m_channelGroup;
+
   }; // class LoRaWAN
 
   class LoRaWANMsgTypeTag : public Tag {
@@ -207,6 +400,96 @@ namespace ns3 {
     uint8_t m_codeRate;
   }; // class LoRaWANPhyParamsTag
 
+  /**
+   * \ingroup lorawan
+   *
+   * Link quality of a received packet, added by the PHY of the receiver. A
+   * gateway forwards it to the network server together with the packet.
+   */
+  class LoRaWANRxMetadataTag : public Tag {
+  public:
+    LoRaWANRxMetadataTag (void);
+
+    /**
+     * \param rssi the received signal strength in dBm
+     */
+    void SetRssi (double rssi);
+    double GetRssi (void) const;
+
+    /**
+     * \param snr the signal to noise ratio in dB (i.e. without interference)
+     */
+    void SetSnr (double snr);
+    double GetSnr (void) const;
+
+    /**
+     * \brief Get the type ID.
+     * \return the object TypeId
+     */
+    static TypeId GetTypeId (void);
+
+    // inherited function, no need to doc.
+    virtual TypeId GetInstanceTypeId (void) const;
+
+    // inherited function, no need to doc.
+    virtual uint32_t GetSerializedSize (void) const;
+
+    // inherited function, no need to doc.
+    virtual void Serialize (TagBuffer i) const;
+
+    // inherited function, no need to doc.
+    virtual void Deserialize (TagBuffer i);
+
+    // inherited function, no need to doc.
+    virtual void Print (std::ostream &os) const;
+  private:
+    double m_rssi;
+    double m_snr;
+  }; // class LoRaWANRxMetadataTag
+
+  /**
+   * \ingroup lorawan
+   *
+   * The MIC of a received frame, added by the MAC of the receiver. A gateway
+   * forwards it to the network server, which verifies it. A MIC that is
+   * computed by the network server is added to a DS packet, which the MAC of
+   * the gateway appends to the frame.
+   */
+  class LoRaWANMicTag : public Tag {
+  public:
+    LoRaWANMicTag (void);
+    LoRaWANMicTag (uint32_t mic);
+
+    /**
+     * \param mic the MIC, the bytes of the MIC in little endian order
+     */
+    void SetMic (uint32_t mic);
+    uint32_t GetMic (void) const;
+
+    /**
+     * \brief Get the type ID.
+     * \return the object TypeId
+     */
+    static TypeId GetTypeId (void);
+
+    // inherited function, no need to doc.
+    virtual TypeId GetInstanceTypeId (void) const;
+
+    // inherited function, no need to doc.
+    virtual uint32_t GetSerializedSize (void) const;
+
+    // inherited function, no need to doc.
+    virtual void Serialize (TagBuffer i) const;
+
+    // inherited function, no need to doc.
+    virtual void Deserialize (TagBuffer i);
+
+    // inherited function, no need to doc.
+    virtual void Print (std::ostream &os) const;
+  private:
+    uint32_t m_mic;
+  }; // class LoRaWANMicTag
+
   typedef FlowIdTag LoRaWANPhyTraceIdTag;
 
   class LoRaWANCounterSingleton {
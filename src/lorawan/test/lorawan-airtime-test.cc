@@ -0,0 +1,133 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include <ns3/log.h>
+#include <ns3/test.h>
+#include <ns3/lorawan.h>
+#include <ns3/lorawan-airtime.h>
+#include <cmath>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-airtime-test");
+
+class LoRaWANAirtimeTestCase : public TestCase
+{
+public:
+  LoRaWANAirtimeTestCase ();
+  virtual ~LoRaWANAirtimeTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * The time on air per the formula in the Semtech SX1272 data sheet (and
+   * the Semtech LoRa calculator), without low data rate optimization.
+   *
+   * \return the time on air in seconds
+   */
+  static double SemtechTimeOnAir (uint8_t payloadLength, uint8_t sf, uint32_t bandwidth, uint8_t codeRate, uint8_t preambleLength, bool crcOn, bool implicitHeader);
+};
+
+LoRaWANAirtimeTestCase::LoRaWANAirtimeTestCase ()
+  : TestCase ("Test the LoRaWANAirtime table against the Semtech time on air formula")
+{
+}
+
+LoRaWANAirtimeTestCase::~LoRaWANAirtimeTestCase ()
+{
+}
+
+double
+LoRaWANAirtimeTestCase::SemtechTimeOnAir (uint8_t payloadLength, uint8_t sf, uint32_t bandwidth, uint8_t codeRate, uint8_t preambleLength, bool crcOn, bool implicitHeader)
+{
+  const double tSym = std::pow (2.0, sf) / bandwidth;
+  const double tPreamble = (preambleLength + 4.25) * tSym;
+  const double payloadSymbNb = 8 + std::max (std::ceil ((8.0 * payloadLength - 4.0 * sf + 28 + 16 * crcOn - 20 * implicitHeader) / (4.0 * sf)) * (codeRate + 4), 0.0);
+  return tPreamble + payloadSymbNb * tSym;
+}
+
+void
+LoRaWANAirtimeTestCase::DoRun (void)
+{
+  // Known values of the Semtech LoRa calculator: 20 byte payload, CR 4/5, 8
+  // preamble symbols, CRC and explicit header
+  NS_TEST_ASSERT_MSG_EQ (LoRaWANAirtime::GetTimeOnAir (5, 1, 20), MicroSeconds (56576), "Wrong time on air for SF7");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWANAirtime::GetTimeOnAir (3, 1, 20), MicroSeconds (185344), "Wrong time on air for SF9");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWANAirtime::GetPreambleTime (5), MicroSeconds (12544), "Wrong preamble time for SF7");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWANAirtime::GetSymbolTime (0), MicroSeconds (32768), "Wrong symbol time for SF12");
+  NS_TEST_ASSERT_MSG_EQ_TOL (LoRaWANAirtime::GetNominalDataRate (5), 6835.9375, 1e-9, "Wrong nominal data rate for SF7");
+
+  // The calculator can be evaluated at compile time
+  static_assert (LoRaWANAirtime::CalculateTimeOnAirNs (20, 9, 125000, 1, 8, true, false) == 185344000, "Wrong constexpr time on air");
+
+  // All combinations of data rate, code rate, payload length, CRC and header
+  // mode. The preamble only adds a fixed number of symbols, so only a few
+  // preamble lengths are tested to keep the test quick.
+  const uint8_t preambleLengths[] = {0, 1, 6, 8, 12, 64, 255};
+  const uint32_t nPreambleLengths = sizeof (preambleLengths) / sizeof (preambleLengths[0]);
+  uint32_t nMismatches = 0;
+  uint32_t nCombinations = 0;
+  for (uint8_t dr = 0; dr < LoRaWAN::m_supportedDataRates.size (); dr++)
+    {
+      const uint8_t sf = LoRaWAN::m_supportedDataRates [dr].spreadingFactor;
+      const uint32_t bandwidth = LoRaWAN::m_supportedDataRates [dr].bandWith;
+      for (uint8_t cr = 1; cr <= 4; cr++)
+        {
+          for (uint32_t pl = 0; pl <= 255; pl++)
+            {
+              for (uint32_t i = 0; i < nPreambleLengths; i++)
+                {
+                  const uint8_t preamble = preambleLengths[i];
+                  for (uint8_t mode = 0; mode < 4; mode++)
+                    {
+                      const bool crcOn = mode & 1;
+                      const bool implicitHeader = mode & 2;
+                      const int64_t expected = std::llround (SemtechTimeOnAir (pl, sf, bandwidth, cr, preamble, crcOn, implicitHeader) * 1e9);
+                      const int64_t actual = LoRaWANAirtime::GetTimeOnAir (dr, cr, pl, preamble, crcOn, implicitHeader).GetNanoSeconds ();
+                      if (actual != expected)
+                        {
+                          if (nMismatches++ == 0)
+                            NS_LOG_UNCOND ("First mismatch: DR" << (uint16_t) dr << " CR " << (uint16_t) cr << " PL " << pl << " preamble " << (uint16_t) preamble
+                                           << " mode " << (uint16_t) mode << ": " << actual << " ns != " << expected << " ns");
+                        }
+                      nCombinations++;
+                    }
+                }
+            }
+        }
+    }
+  NS_TEST_ASSERT_MSG_EQ (nCombinations, LoRaWAN::m_supportedDataRates.size () * 4 * 256 * nPreambleLengths * 4, "Not all combinations were tested");
+  NS_TEST_ASSERT_MSG_EQ (nMismatches, 0, "Time on air does not match the Semtech formula");
+}
+
+// ==============================================================================
+class LoRaWANAirtimeTestSuite : public TestSuite
+{
+public:
+  LoRaWANAirtimeTestSuite ();
+};
+
+LoRaWANAirtimeTestSuite::LoRaWANAirtimeTestSuite ()
+  : TestSuite ("lorawan-airtime", UNIT)
+{
+  AddTestCase (new LoRaWANAirtimeTestCase, TestCase::QUICK);
+}
+
+static LoRaWANAirtimeTestSuite lorawanAirtimeTestSuite;
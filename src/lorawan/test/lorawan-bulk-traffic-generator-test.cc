@@ -0,0 +1,269 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include <ns3/log.h>
+#include <ns3/test.h>
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/lorawan-module.h>
+#include "lorawan-test-utils.h"
+#include <map>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-bulk-traffic-generator-test");
+
+/**
+ * Uplink times and frame counters of every end device, by device address.
+ */
+typedef std::map<uint32_t, std::vector<std::pair<Time, uint32_t> > > UplinkLog;
+
+static void
+UplinkSent (UplinkLog *log, uint32_t deviceAddr, uint8_t msgType, Ptr<const Packet> p)
+{
+  LoRaWANFrameHeader fhdr;
+  p->PeekHeader (fhdr);
+  (*log)[deviceAddr].push_back (std::make_pair (Simulator::Now (), fhdr.getFrameCounter ()));
+}
+
+/**
+ * Create end devices and a gateway that is attached to a network server, and
+ * install the end devices on the generator.
+ */
+static NetDeviceContainer
+CreateNetwork (uint32_t nEndDevices, Ptr<LoRaWANBulkTrafficGenerator> generator)
+{
+  NodeContainer endDeviceNodes;
+  NodeContainer gatewayNodes;
+  endDeviceNodes.Create (nEndDevices);
+  gatewayNodes.Create (1);
+
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator ("ns3::UniformDiscPositionAllocator", "rho", DoubleValue (500.0));
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (endDeviceNodes);
+  mobility.SetPositionAllocator ("ns3::GridPositionAllocator");
+  mobility.Install (gatewayNodes);
+
+  LoRaWANHelper lorawanHelper;
+  lorawanHelper.SetNbRep (1);
+  NetDeviceContainer endDevices = lorawanHelper.Install (endDeviceNodes);
+  lorawanHelper.SetDeviceType (LORAWAN_DT_GATEWAY);
+  lorawanHelper.Install (gatewayNodes);
+
+  // The end devices do not need a PacketSocket
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (gatewayNodes);
+
+  LoRaWANNetworkServerHelper nsHelper;
+  Ptr<LoRaWANNetworkServer> networkServer = nsHelper.Create ();
+  nsHelper.InstallGateways (networkServer, gatewayNodes);
+
+  generator->Install (endDevices);
+  return endDevices;
+}
+
+// ==============================================================================
+class LoRaWANBulkTrafficGeneratorPeriodicTestCase : public TestCase
+{
+public:
+  LoRaWANBulkTrafficGeneratorPeriodicTestCase ();
+  virtual ~LoRaWANBulkTrafficGeneratorPeriodicTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANBulkTrafficGeneratorPeriodicTestCase::LoRaWANBulkTrafficGeneratorPeriodicTestCase ()
+  : TestCase ("Test the periodic profile of the LoRaWANBulkTrafficGenerator")
+{
+}
+
+LoRaWANBulkTrafficGeneratorPeriodicTestCase::~LoRaWANBulkTrafficGeneratorPeriodicTestCase ()
+{
+}
+
+void
+LoRaWANBulkTrafficGeneratorPeriodicTestCase::DoRun (void)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  const uint32_t nEndDevices = 20;
+  Ptr<LoRaWANBulkTrafficGenerator> generator = CreateObject<LoRaWANBulkTrafficGenerator> ();
+  generator->SetAttribute ("Period", TimeValue (Seconds (10)));
+  generator->SetAttribute ("DataRateIndex", UintegerValue (5));
+  NetDeviceContainer endDevices = CreateNetwork (nEndDevices, generator);
+  NS_TEST_ASSERT_MSG_EQ (generator->GetNDevices (), nEndDevices, "All end devices should be installed");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)generator->GetDataRateIndex (0), 5, "End devices should use the DataRateIndex attribute");
+
+  UplinkLog log;
+  generator->TraceConnectWithoutContext ("USMsgTransmitted", MakeBoundCallback (&UplinkSent, &log));
+  uint32_t nMacTx = 0;
+  for (uint32_t i = 0; i < nEndDevices; i++)
+    DynamicCast<LoRaWANNetDevice> (endDevices.Get (i))->GetMac ()->TraceConnectWithoutContext ("MacTx", MakeBoundCallback (&LoRaWANTestUtils::CountPacket, &nMacTx));
+
+  generator->Start (Seconds (1.0));
+  generator->Stop (Seconds (36.0));
+  Simulator::Stop (Seconds (40.0));
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (log.size (), nEndDevices, "Every end device should have sent uplinks");
+  uint32_t nUplinks = 0;
+  for (UplinkLog::const_iterator it = log.begin (); it != log.end (); it++)
+    {
+      const std::vector<std::pair<Time, uint32_t> > &uplinks = it->second;
+      NS_TEST_ASSERT_MSG_EQ ((uplinks.size () >= 3 && uplinks.size () <= 4), true, "An end device should send every 10 s");
+      NS_TEST_ASSERT_MSG_EQ ((uplinks[0].first >= Seconds (1.0) && uplinks[0].first <= Seconds (11.0)), true, "The first uplink should be within one period of the start");
+      for (uint32_t k = 0; k < uplinks.size (); k++)
+        {
+          NS_TEST_ASSERT_MSG_EQ (uplinks[k].second, k, "The frame counter should be incremented for every uplink");
+          if (k > 0)
+            NS_TEST_ASSERT_MSG_EQ (uplinks[k].first - uplinks[k - 1].first, Seconds (10), "Uplinks should be one period apart without jitter");
+        }
+      nUplinks += uplinks.size ();
+    }
+  NS_TEST_ASSERT_MSG_EQ (generator->GetNUplinks (), nUplinks, "Wrong number of uplinks");
+  NS_TEST_ASSERT_MSG_EQ (nMacTx, nUplinks, "Every uplink should be transmitted by the MAC of the end device");
+  // The wheel may also reschedule its event while the first uplinks are scheduled
+  NS_TEST_ASSERT_MSG_LT_OR_EQ (generator->GetTimerWheel ().GetNEvents (), nUplinks + nEndDevices, "Uplinks should not need more than one simulator event each");
+
+  Simulator::Destroy ();
+}
+
+// ==============================================================================
+class LoRaWANBulkTrafficGeneratorTraceTestCase : public TestCase
+{
+public:
+  LoRaWANBulkTrafficGeneratorTraceTestCase ();
+  virtual ~LoRaWANBulkTrafficGeneratorTraceTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANBulkTrafficGeneratorTraceTestCase::LoRaWANBulkTrafficGeneratorTraceTestCase ()
+  : TestCase ("Test the trace profile of the LoRaWANBulkTrafficGenerator")
+{
+}
+
+LoRaWANBulkTrafficGeneratorTraceTestCase::~LoRaWANBulkTrafficGeneratorTraceTestCase ()
+{
+}
+
+void
+LoRaWANBulkTrafficGeneratorTraceTestCase::DoRun (void)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  Ptr<LoRaWANBulkTrafficGenerator> generator = CreateObject<LoRaWANBulkTrafficGenerator> ();
+  generator->SetAttribute ("Profile", EnumValue (LORAWAN_BULK_TRAFFIC_TRACE));
+  NetDeviceContainer endDevices = CreateNetwork (3, generator);
+  generator->SetDataRateIndex (1, 5);
+
+  // Entries are sorted when the generator starts, entries before the start
+  // are skipped
+  generator->AddTraceEntry (0, Seconds (12.5));
+  generator->AddTraceEntry (0, Seconds (5.0));
+  generator->AddTraceEntry (0, Seconds (0.5));
+  generator->AddTraceEntry (1, Seconds (7.0));
+
+  UplinkLog log;
+  generator->TraceConnectWithoutContext ("USMsgTransmitted", MakeBoundCallback (&UplinkSent, &log));
+  generator->Start (Seconds (1.0));
+  Simulator::Stop (Seconds (20.0));
+  Simulator::Run ();
+
+  const uint32_t addr0 = Ipv4Address::ConvertFrom (endDevices.Get (0)->GetAddress ()).Get ();
+  const uint32_t addr1 = Ipv4Address::ConvertFrom (endDevices.Get (1)->GetAddress ()).Get ();
+  NS_TEST_ASSERT_MSG_EQ (log.size (), 2, "Only end devices with trace entries should send");
+  NS_TEST_ASSERT_MSG_EQ (log[addr0].size (), 2, "The entry before the start should be skipped");
+  NS_TEST_ASSERT_MSG_EQ (log[addr0][0].first, Seconds (5.0), "Wrong time of the first uplink");
+  NS_TEST_ASSERT_MSG_EQ (log[addr0][1].first, Seconds (12.5), "Wrong time of the second uplink");
+  NS_TEST_ASSERT_MSG_EQ (log[addr1].size (), 1, "Wrong number of uplinks");
+  NS_TEST_ASSERT_MSG_EQ (log[addr1][0].first, Seconds (7.0), "Wrong time of the uplink");
+  NS_TEST_ASSERT_MSG_EQ (generator->GetTimerWheel ().GetNPending (), 0, "No uplinks should be pending at the end of the trace");
+
+  Simulator::Destroy ();
+}
+
+// ==============================================================================
+class LoRaWANBulkTrafficGeneratorPoissonTestCase : public TestCase
+{
+public:
+  LoRaWANBulkTrafficGeneratorPoissonTestCase ();
+  virtual ~LoRaWANBulkTrafficGeneratorPoissonTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANBulkTrafficGeneratorPoissonTestCase::LoRaWANBulkTrafficGeneratorPoissonTestCase ()
+  : TestCase ("Test the Poisson profile of the LoRaWANBulkTrafficGenerator")
+{
+}
+
+LoRaWANBulkTrafficGeneratorPoissonTestCase::~LoRaWANBulkTrafficGeneratorPoissonTestCase ()
+{
+}
+
+void
+LoRaWANBulkTrafficGeneratorPoissonTestCase::DoRun (void)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  const uint32_t nEndDevices = 20;
+  Ptr<LoRaWANBulkTrafficGenerator> generator = CreateObject<LoRaWANBulkTrafficGenerator> ();
+  generator->SetAttribute ("Profile", EnumValue (LORAWAN_BULK_TRAFFIC_POISSON));
+  generator->SetAttribute ("Period", TimeValue (Seconds (20)));
+  generator->SetAttribute ("DataRateIndex", UintegerValue (5));
+  CreateNetwork (nEndDevices, generator);
+  generator->AssignStreams (0);
+
+  generator->Start (Seconds (0.0));
+  generator->Stop (Seconds (2000.0));
+  Simulator::Stop (Seconds (2000.0));
+  Simulator::Run ();
+
+  // 20 end devices send 100 uplinks each on average
+  NS_TEST_ASSERT_MSG_EQ_TOL ((double)generator->GetNUplinks (), 2000.0, 200.0, "The mean inter arrival time should be Period");
+
+  Simulator::Destroy ();
+}
+
+// ==============================================================================
+class LoRaWANBulkTrafficGeneratorTestSuite : public TestSuite
+{
+public:
+  LoRaWANBulkTrafficGeneratorTestSuite ();
+};
+
+LoRaWANBulkTrafficGeneratorTestSuite::LoRaWANBulkTrafficGeneratorTestSuite ()
+  : TestSuite ("lorawan-bulk-traffic-generator", UNIT)
+{
+  AddTestCase (new LoRaWANBulkTrafficGeneratorPeriodicTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANBulkTrafficGeneratorTraceTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANBulkTrafficGeneratorPoissonTestCase, TestCase::QUICK);
+}
+
+static LoRaWANBulkTrafficGeneratorTestSuite lorawanBulkTrafficGeneratorTestSuite;
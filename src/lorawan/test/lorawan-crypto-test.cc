@@ -0,0 +1,588 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include <ns3/log.h>
+#include <ns3/test.h>
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/lorawan-module.h>
+#include "lorawan-test-utils.h"
+#include <cstring>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-crypto-test");
+
+static std::string
+ToHex (const uint8_t *bytes, uint32_t length)
+{
+  static const char digits[] = "0123456789abcdef";
+  std::string hex;
+  for (uint32_t i = 0; i < length; i++) {
+    hex += digits[bytes[i] >> 4];
+    hex += digits[bytes[i] & 0x0f];
+  }
+  return hex;
+}
+
+static LoRaWANKey
+KeyFromHex (std::string hex)
+{
+  LoRaWANKey key;
+  bool valid = key.SetHex (hex);
+  NS_ASSERT (valid);
+  return key;
+}
+
+/**
+ * Build a data frame: MHDR, FHDR without frame options, FPort and a
+ * FRMPayload of length bytes.
+ */
+static std::vector<uint8_t>
+MakeFrame (uint8_t msgType, uint32_t devAddr, uint16_t fCnt, uint8_t framePort, uint32_t length)
+{
+  std::vector<uint8_t> frame;
+  frame.push_back (msgType << 5);
+  for (uint32_t i = 0; i < 4; i++)
+    frame.push_back (devAddr >> (8 * i));
+  frame.push_back (0);
+  frame.push_back (fCnt);
+  frame.push_back (fCnt >> 8);
+  frame.push_back (framePort);
+  for (uint32_t i = 0; i < length; i++)
+    frame.push_back (i * 7 + 3);
+  return frame;
+}
+
+class LoRaWANCryptoAesTestCase : public TestCase
+{
+public:
+  LoRaWANCryptoAesTestCase ();
+  virtual ~LoRaWANCryptoAesTestCase ();
+
+private:
+  void CheckVectors (void);
+  virtual void DoRun (void);
+};
+
+LoRaWANCryptoAesTestCase::LoRaWANCryptoAesTestCase ()
+  : TestCase ("Test AES-128 and AES-CMAC against the FIPS-197 and RFC 4493 test vectors")
+{
+}
+
+LoRaWANCryptoAesTestCase::~LoRaWANCryptoAesTestCase ()
+{
+}
+
+void
+LoRaWANCryptoAesTestCase::CheckVectors (void)
+{
+  uint8_t out[16];
+
+  // FIPS-197, appendix C.1
+  const LoRaWANKey fipsKey = KeyFromHex ("000102030405060708090a0b0c0d0e0f");
+  const uint8_t plaintext[16] = {0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff};
+  LoRaWANCrypto::Encrypt (fipsKey, plaintext, out);
+  NS_TEST_ASSERT_MSG_EQ (ToHex (out, 16), "69c4e0d86a7b0430d8cdb78070b4c55a", "Wrong AES-128 ciphertext");
+  LoRaWANCrypto::Decrypt (fipsKey, out, out);
+  NS_TEST_ASSERT_MSG_EQ (ToHex (out, 16), ToHex (plaintext, 16), "Decrypting should give the plaintext");
+
+  // RFC 4493, section 4
+  const LoRaWANKey key = KeyFromHex ("2b7e151628aed2a6abf7158809cf4f3c");
+  const uint8_t message[64] = {
+    0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+    0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+    0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+    0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10};
+  NS_TEST_ASSERT_MSG_EQ (ToHex (key.m_k1, 16), "fbeed618357133667c85e08f7236a8de", "Wrong CMAC subkey K1");
+  NS_TEST_ASSERT_MSG_EQ (ToHex (key.m_k2, 16), "f7ddac306ae266ccf90bc11ee46d513b", "Wrong CMAC subkey K2");
+  LoRaWANCrypto::Cmac (key, message, 0, out);
+  NS_TEST_ASSERT_MSG_EQ (ToHex (out, 16), "bb1d6929e95937287fa37d129b756746", "Wrong CMAC of the empty message");
+  LoRaWANCrypto::Cmac (key, message, 16, out);
+  NS_TEST_ASSERT_MSG_EQ (ToHex (out, 16), "070a16b46b4d4144f79bdd9dd04a287c", "Wrong CMAC of a 16 byte message");
+  LoRaWANCrypto::Cmac (key, message, 40, out);
+  NS_TEST_ASSERT_MSG_EQ (ToHex (out, 16), "dfa66747de9ae63030ca32611497c827", "Wrong CMAC of a 40 byte message");
+  LoRaWANCrypto::Cmac (key, message, 64, out);
+  NS_TEST_ASSERT_MSG_EQ (ToHex (out, 16), "51f0bebf7e3b9d92fc49741779363cfe", "Wrong CMAC of a 64 byte message");
+}
+
+void
+LoRaWANCryptoAesTestCase::DoRun (void)
+{
+  const bool useAesNi = LoRaWANCrypto::GetUseAesNi ();
+
+  LoRaWANCrypto::SetUseAesNi (false);
+  NS_TEST_ASSERT_MSG_EQ (LoRaWANCrypto::GetUseAesNi (), false, "AES-NI should be disabled");
+  CheckVectors ();
+
+  if (LoRaWANCrypto::HaveAesNi ()) {
+    LoRaWANCrypto::SetUseAesNi (true);
+    NS_TEST_ASSERT_MSG_EQ (LoRaWANCrypto::GetUseAesNi (), true, "AES-NI should be enabled");
+    CheckVectors ();
+  }
+  LoRaWANCrypto::SetUseAesNi (useAesNi);
+
+  LoRaWANKey key;
+  NS_TEST_ASSERT_MSG_EQ (key.GetHex (), "00000000000000000000000000000000", "The default key should be the all zero key");
+  NS_TEST_ASSERT_MSG_EQ (key.SetHex ("2B7E151628AED2A6ABF7158809CF4F3C"), true, "Upper case digits should be accepted");
+  NS_TEST_ASSERT_MSG_EQ (key.GetHex (), "2b7e151628aed2a6abf7158809cf4f3c", "Wrong key");
+  NS_TEST_ASSERT_MSG_EQ (key.SetHex ("2b7e1516"), false, "A short key should be rejected");
+  NS_TEST_ASSERT_MSG_EQ (key.SetHex ("2b7e151628aed2a6abf7158809cf4f3g"), false, "A key with an invalid digit should be rejected");
+  NS_TEST_ASSERT_MSG_EQ (key.GetHex (), "2b7e151628aed2a6abf7158809cf4f3c", "An invalid key should not change the key");
+}
+
+class LoRaWANCryptoFrameTestCase : public TestCase
+{
+public:
+  LoRaWANCryptoFrameTestCase ();
+  virtual ~LoRaWANCryptoFrameTestCase ();
+
+private:
+  void ComputeMics (std::vector<uint32_t> &single, std::vector<uint32_t> &batch);
+  virtual void DoRun (void);
+
+  std::vector<LoRaWANKey> m_keys;
+  std::vector<std::vector<uint8_t> > m_frames;
+};
+
+LoRaWANCryptoFrameTestCase::LoRaWANCryptoFrameTestCase ()
+  : TestCase ("Test the MICs and the encryption of data frames, batched and one by one")
+{
+}
+
+LoRaWANCryptoFrameTestCase::~LoRaWANCryptoFrameTestCase ()
+{
+}
+
+void
+LoRaWANCryptoFrameTestCase::ComputeMics (std::vector<uint32_t> &single, std::vector<uint32_t> &batch)
+{
+  std::vector<LoRaWANMicJob> jobs (m_frames.size ());
+  single.clear ();
+  batch.clear ();
+  for (uint32_t k = 0; k < m_frames.size (); k++) {
+    single.push_back (LoRaWANCrypto::ComputeFrameMic (m_keys[k], k % 2 == 0, &m_frames[k][0], m_frames[k].size ()));
+    jobs[k].m_key = &m_keys[k];
+    jobs[k].m_frame = &m_frames[k][0];
+    jobs[k].m_length = m_frames[k].size ();
+    jobs[k].m_uplink = k % 2 == 0;
+  }
+  LoRaWANCrypto::ComputeFrameMics (&jobs[0], jobs.size ());
+  for (uint32_t k = 0; k < jobs.size (); k++)
+    batch.push_back (jobs[k].m_mic);
+}
+
+void
+LoRaWANCryptoFrameTestCase::DoRun (void)
+{
+  // Frames of different lengths and keys, so that the lanes of a batch
+  // finish after a different number of blocks
+  for (uint32_t k = 0; k < 11; k++) {
+    LoRaWANKey nwkSKey;
+    LoRaWANKey appSKey;
+    LoRaWANCrypto::DeriveDefaultSessionKeys (k + 1, nwkSKey, appSKey);
+    m_keys.push_back (nwkSKey);
+    m_frames.push_back (MakeFrame (k % 2 == 0 ? LORAWAN_UNCONFIRMED_DATA_UP : LORAWAN_UNCONFIRMED_DATA_DOWN, k + 1, k, 1, 9 * k));
+  }
+
+  std::vector<uint32_t> single;
+  std::vector<uint32_t> batch;
+  const bool useAesNi = LoRaWANCrypto::GetUseAesNi ();
+  LoRaWANCrypto::SetUseAesNi (false);
+  ComputeMics (single, batch);
+  for (uint32_t k = 0; k < single.size (); k++)
+    NS_TEST_ASSERT_MSG_EQ (batch[k], single[k], "The MIC of a batch should equal the MIC of a single frame");
+  if (LoRaWANCrypto::HaveAesNi ()) {
+    std::vector<uint32_t> singleAesNi;
+    std::vector<uint32_t> batchAesNi;
+    LoRaWANCrypto::SetUseAesNi (true);
+    ComputeMics (singleAesNi, batchAesNi);
+    for (uint32_t k = 0; k < single.size (); k++) {
+      NS_TEST_ASSERT_MSG_EQ (singleAesNi[k], single[k], "AES-NI should compute the same MIC");
+      NS_TEST_ASSERT_MSG_EQ (batchAesNi[k], single[k], "AES-NI should compute the same MIC for a batch");
+    }
+  }
+  LoRaWANCrypto::SetUseAesNi (useAesNi);
+
+  // The MIC depends on the direction, the frame counter and every byte of the frame
+  std::vector<uint8_t> frame = m_frames[4];
+  NS_TEST_ASSERT_MSG_NE (LoRaWANCrypto::ComputeFrameMic (m_keys[4], false, &frame[0], frame.size ()), single[4], "The MIC should depend on the direction");
+  frame[6]++;
+  NS_TEST_ASSERT_MSG_NE (LoRaWANCrypto::ComputeFrameMic (m_keys[4], true, &frame[0], frame.size ()), single[4], "The MIC should depend on the frame counter");
+  frame = m_frames[4];
+  frame.back () ^= 0x01;
+  NS_TEST_ASSERT_MSG_NE (LoRaWANCrypto::ComputeFrameMic (m_keys[4], true, &frame[0], frame.size ()), single[4], "The MIC should depend on the FRMPayload");
+
+  // Encryption is its own inverse, the FRMPayload of FPort 0 is encrypted
+  // with the NwkSKey
+  LoRaWANKey nwkSKey;
+  LoRaWANKey appSKey;
+  LoRaWANCrypto::DeriveSessionKeys (KeyFromHex ("2b7e151628aed2a6abf7158809cf4f3c"), 0x123456, 0x13, 0xabcd, nwkSKey, appSKey);
+  NS_TEST_ASSERT_MSG_NE (nwkSKey.GetHex (), appSKey.GetHex (), "The NwkSKey and AppSKey should differ");
+  const std::vector<uint8_t> plain = MakeFrame (LORAWAN_CONFIRMED_DATA_UP, 0x01020304, 7, 1, 40);
+  frame = plain;
+  uint32_t offset = LoRaWANCrypto::CryptFrame (nwkSKey, appSKey, true, &frame[0], frame.size ());
+  NS_TEST_ASSERT_MSG_EQ (offset, 9, "The FRMPayload should start after the FPort");
+  NS_TEST_ASSERT_MSG_EQ (memcmp (&frame[0], &plain[0], offset), 0, "The MHDR and FHDR should not be encrypted");
+  NS_TEST_ASSERT_MSG_NE (memcmp (&frame[offset], &plain[offset], 40), 0, "The FRMPayload should be encrypted");
+  const std::vector<uint8_t> encrypted = frame;
+  LoRaWANCrypto::CryptFrame (nwkSKey, appSKey, true, &frame[0], frame.size ());
+  NS_TEST_ASSERT_MSG_EQ ((frame == plain), true, "Decrypting should give the original FRMPayload");
+  LoRaWANCrypto::CryptFrame (nwkSKey, appSKey, false, &frame[0], frame.size ());
+  NS_TEST_ASSERT_MSG_EQ ((frame != encrypted), true, "The encryption should depend on the direction");
+  frame = plain;
+  frame[8] = 0;
+  const std::vector<uint8_t> macCommands = frame;
+  LoRaWANCrypto::CryptFrame (nwkSKey, appSKey, true, &frame[0], frame.size ());
+  LoRaWANCrypto::CryptFrame (nwkSKey, nwkSKey, true, &frame[0], frame.size ());
+  NS_TEST_ASSERT_MSG_EQ ((frame == macCommands), true, "The FRMPayload of FPort 0 should be encrypted with the NwkSKey");
+
+  frame = MakeFrame (LORAWAN_UNCONFIRMED_DATA_DOWN, 1, 0, 0, 0);
+  frame.pop_back ();
+  NS_TEST_ASSERT_MSG_EQ (LoRaWANCrypto::CryptFrame (nwkSKey, appSKey, false, &frame[0], frame.size ()), frame.size (), "A frame without FPort has no FRMPayload");
+
+  // The FRMPayload of a packet with headers is replaced
+  Ptr<Packet> p = Create<Packet> (&plain[offset], 40);
+  LoRaWANFrameHeader fhdr;
+  fhdr.setDevAddr (Ipv4Address (0x01020304));
+  fhdr.setFrameCounter (7);
+  fhdr.setFramePort (1);
+  p->AddHeader (fhdr);
+  LoRaWANCrypto::SetPacketTail (p, &encrypted[offset], 40);
+  std::vector<uint8_t> bytes (p->GetSize ());
+  p->CopyData (&bytes[0], bytes.size ());
+  NS_TEST_ASSERT_MSG_EQ (bytes.size (), encrypted.size () - 1, "SetPacketTail should not change the size");
+  NS_TEST_ASSERT_MSG_EQ (memcmp (&bytes[0], &encrypted[1], bytes.size ()), 0, "SetPacketTail should replace the FRMPayload");
+
+  // End devices without an AppKey have their own AppKey
+  LoRaWANKey defaultAppKey1;
+  LoRaWANKey defaultAppKey2;
+  LoRaWANCrypto::DeriveDefaultAppKey (1, defaultAppKey1);
+  LoRaWANCrypto::DeriveDefaultAppKey (2, defaultAppKey2);
+  NS_TEST_ASSERT_MSG_NE (defaultAppKey1.GetHex (), defaultAppKey2.GetHex (), "The default AppKeys of two DevEUIs should differ");
+  NS_TEST_ASSERT_MSG_NE (defaultAppKey1.GetHex (), LoRaWANKey ().GetHex (), "The default AppKey should not be the all zero key");
+
+  // A JoinAccept is encrypted together with its MIC, by decrypting it with
+  // the AppKey
+  const LoRaWANKey appKey = KeyFromHex ("2b7e151628aed2a6abf7158809cf4f3c");
+  LoRaWANJoinAcceptHeader joinAccept;
+  joinAccept.SetAppNonce (0x123456);
+  joinAccept.SetDevAddr (Ipv4Address (0x01020304));
+  p = Create<Packet> (0);
+  p->AddHeader (joinAccept);
+  std::vector<uint8_t> accept (1 + p->GetSize () + 4);
+  NS_TEST_ASSERT_MSG_EQ (accept.size (), 17, "A JoinAccept and its MIC should be one block");
+  accept[0] = LORAWAN_JOIN_ACCEPT << 5;
+  p->CopyData (&accept[1], p->GetSize ());
+  const uint32_t mic = LoRaWANCrypto::ComputeJoinMic (appKey, &accept[0], accept.size () - 4);
+  NS_TEST_ASSERT_MSG_NE (LoRaWANCrypto::ComputeJoinMic (KeyFromHex ("3c4fcf098815f7aba6d2ae2816157e2b"), &accept[0], accept.size () - 4), mic,
+                         "The MIC should depend on the AppKey");
+  for (uint32_t k = 0; k < 4; k++)
+    accept[accept.size () - 4 + k] = mic >> (8 * k);
+  const std::vector<uint8_t> plainAccept = accept;
+  LoRaWANCrypto::EncryptJoinAccept (appKey, &accept[0], accept.size ());
+  NS_TEST_ASSERT_MSG_EQ (accept[0], plainAccept[0], "The MHDR should not be encrypted");
+  NS_TEST_ASSERT_MSG_NE (memcmp (&accept[1], &plainAccept[1], 16), 0, "The JoinAccept and its MIC should be encrypted");
+  uint8_t block[16];
+  LoRaWANCrypto::Encrypt (appKey, &accept[1], block);
+  NS_TEST_ASSERT_MSG_EQ (memcmp (block, &plainAccept[1], 16), 0, "The end device should decrypt the JoinAccept with AES encryption");
+  LoRaWANCrypto::DecryptJoinAccept (appKey, &accept[0], accept.size ());
+  NS_TEST_ASSERT_MSG_EQ ((accept == plainAccept), true, "Decrypting should give the original JoinAccept");
+}
+
+class LoRaWANCryptoEndToEndTestCase : public TestCase
+{
+public:
+  LoRaWANCryptoEndToEndTestCase ();
+  virtual ~LoRaWANCryptoEndToEndTestCase ();
+
+private:
+  /**
+   * What a scenario counts.
+   */
+  typedef struct
+  {
+    uint32_t m_nUSReceived;     //!< US data packets received by the network server
+    bool m_usPayloadCorrect;    //!< The US FRMPayloads received by the network server are the sent ones
+    uint32_t m_nDSReceived;     //!< DS data packets with a FRMPayload received by the end device
+    bool m_dsPayloadCorrect;    //!< The DS FRMPayloads received by the end device are the queued ones
+    uint32_t m_nOnAir;          //!< US data frames received by the gateway
+    bool m_onAirEncrypted;      //!< The US FRMPayloads on air differ from the sent ones and have a MIC
+    uint32_t m_nsMicFailures;
+    uint32_t m_edMicFailures;
+    bool m_joined;              //!< The end device received a JoinAccept
+  } Result;
+
+  static void USMsgReceived (Result *result, uint32_t deviceAddr, uint8_t msgType, Ptr<const Packet> p);
+  static void DSMsgReceived (Result *result, uint32_t deviceAddr, uint8_t msgType, Ptr<const Packet> p, uint8_t rw);
+  static void GatewayMacRx (Result *result, Ptr<const Packet> p);
+  static void QueueDSPacket (Ptr<LoRaWANNetworkServer> networkServer, Ptr<NetDevice> device);
+  static void ChangeSessionKeys (Ptr<LoRaWANNetworkServer> networkServer, Ptr<NetDevice> device);
+  static void Joined (Result *result, uint32_t deviceAddr, Time latency, uint32_t nJoinRequests);
+  static void ChangeAppKey (Ptr<LoRaWANMac> mac);
+
+  /**
+   * \param crypto whether crypto is enabled in the network server and the MAC
+   * \param otaa whether the end device joins
+   * \param nsKeys how the session keys or AppKey of the network server are
+   * set: 0 the same as the end device, 1 different from the end device,
+   * 2 changed after the first uplink (for a joining end device, its AppKey
+   * changes after the first JoinRequest)
+   */
+  Result RunScenario (bool crypto, bool otaa, uint32_t nsKeys);
+  virtual void DoRun (void);
+};
+
+static const uint32_t g_usPacketSize = 12;
+static const uint32_t g_dsPacketSize = 20;
+
+LoRaWANCryptoEndToEndTestCase::LoRaWANCryptoEndToEndTestCase ()
+  : TestCase ("Test the MIC and FRMPayload encryption of US and DS packets between end devices and the network server")
+{
+}
+
+LoRaWANCryptoEndToEndTestCase::~LoRaWANCryptoEndToEndTestCase ()
+{
+}
+
+void
+LoRaWANCryptoEndToEndTestCase::USMsgReceived (Result *result, uint32_t deviceAddr, uint8_t msgType, Ptr<const Packet> p)
+{
+  if (msgType == LORAWAN_JOIN_REQUEST)
+    return;
+  result->m_nUSReceived++;
+  std::vector<uint8_t> payload (p->GetSize ());
+  p->CopyData (&payload[0], payload.size ());
+  // The end device application sends a counter followed by zeros
+  if (payload.size () != g_usPacketSize || std::vector<uint8_t> (payload.begin () + 8, payload.end ()) != std::vector<uint8_t> (g_usPacketSize - 8, 0))
+    result->m_usPayloadCorrect = false;
+}
+
+void
+LoRaWANCryptoEndToEndTestCase::DSMsgReceived (Result *result, uint32_t deviceAddr, uint8_t msgType, Ptr<const Packet> p, uint8_t rw)
+{
+  if (msgType == LORAWAN_JOIN_ACCEPT || p->GetSize () < g_dsPacketSize)
+    return;
+  result->m_nDSReceived++;
+  std::vector<uint8_t> payload (p->GetSize ());
+  p->CopyData (&payload[0], payload.size ());
+  for (uint32_t i = 0; i < g_dsPacketSize; i++)
+    if (payload[payload.size () - g_dsPacketSize + i] != (uint8_t)(i + 1))
+      result->m_dsPayloadCorrect = false;
+}
+
+void
+LoRaWANCryptoEndToEndTestCase::GatewayMacRx (Result *result, Ptr<const Packet> p)
+{
+  // MHDR, FHDR, FPort, FRMPayload and MIC of a US data frame
+  std::vector<uint8_t> frame (p->GetSize ());
+  p->CopyData (&frame[0], frame.size ());
+  if ((frame[0] >> 5) == LORAWAN_JOIN_REQUEST || frame.size () != 1 + 7 + 1 + g_usPacketSize + 4)
+    return;
+  result->m_nOnAir++;
+  const std::vector<uint8_t> zeros (frame.begin () + 9 + 8, frame.begin () + 9 + g_usPacketSize);
+  const std::vector<uint8_t> mic (frame.end () - 4, frame.end ());
+  if (zeros == std::vector<uint8_t> (g_usPacketSize - 8, 0) || mic == std::vector<uint8_t> (4, 0))
+    result->m_onAirEncrypted = false;
+}
+
+void
+LoRaWANCryptoEndToEndTestCase::QueueDSPacket (Ptr<LoRaWANNetworkServer> networkServer, Ptr<NetDevice> device)
+{
+  uint8_t payload[g_dsPacketSize];
+  for (uint32_t i = 0; i < g_dsPacketSize; i++)
+    payload[i] = i + 1;
+  networkServer->QueueDSPacket (Ipv4Address::ConvertFrom (device->GetAddress ()), Create<Packet> (payload, g_dsPacketSize), 1, false);
+}
+
+void
+LoRaWANCryptoEndToEndTestCase::ChangeSessionKeys (Ptr<LoRaWANNetworkServer> networkServer, Ptr<NetDevice> device)
+{
+  networkServer->SetSessionKeys (Ipv4Address::ConvertFrom (device->GetAddress ()),
+                                 KeyFromHex ("000102030405060708090a0b0c0d0e0f"), KeyFromHex ("0f0e0d0c0b0a09080706050403020100"));
+}
+
+void
+LoRaWANCryptoEndToEndTestCase::Joined (Result *result, uint32_t deviceAddr, Time latency, uint32_t nJoinRequests)
+{
+  result->m_joined = true;
+}
+
+void
+LoRaWANCryptoEndToEndTestCase::ChangeAppKey (Ptr<LoRaWANMac> mac)
+{
+  mac->SetAppKey (KeyFromHex ("000102030405060708090a0b0c0d0e0f"));
+}
+
+LoRaWANCryptoEndToEndTestCase::Result
+LoRaWANCryptoEndToEndTestCase::RunScenario (bool crypto, bool otaa, uint32_t nsKeys)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  Result result;
+  result.m_nUSReceived = 0;
+  result.m_usPayloadCorrect = true;
+  result.m_nDSReceived = 0;
+  result.m_dsPayloadCorrect = true;
+  result.m_nOnAir = 0;
+  result.m_onAirEncrypted = true;
+  result.m_nsMicFailures = 0;
+  result.m_joined = false;
+
+  NodeContainer endDeviceNodes;
+  NodeContainer gatewayNodes;
+  endDeviceNodes.Create (1);
+  gatewayNodes.Create (1);
+
+  Ptr<ListPositionAllocator> positions = CreateObject<ListPositionAllocator> ();
+  positions->Add (Vector (0.0, 0.0, 0.0));
+  positions->Add (Vector (50.0, 0.0, 0.0));
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator (positions);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (endDeviceNodes);
+  mobility.Install (gatewayNodes);
+
+  LoRaWANHelper lorawanHelper;
+  lorawanHelper.SetNbRep (1);
+  NetDeviceContainer endDevices = lorawanHelper.Install (endDeviceNodes);
+  lorawanHelper.SetDeviceType (LORAWAN_DT_GATEWAY);
+  NetDeviceContainer gateways = lorawanHelper.Install (gatewayNodes);
+  Ptr<LoRaWANNetDevice> endDevice = DynamicCast<LoRaWANNetDevice> (endDevices.Get (0));
+  endDevice->GetMac ()->SetAttribute ("Crypto", BooleanValue (crypto));
+  for (auto &mac : DynamicCast<LoRaWANNetDevice> (gateways.Get (0))->GetMacs ())
+    mac->TraceConnectWithoutContext ("MacRx", MakeBoundCallback (&LoRaWANCryptoEndToEndTestCase::GatewayMacRx, &result));
+
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (endDeviceNodes);
+  packetSocket.Install (gatewayNodes);
+
+  LoRaWANNetworkServerHelper nsHelper;
+  nsHelper.SetAttribute ("Crypto", BooleanValue (crypto));
+  Ptr<LoRaWANNetworkServer> networkServer = nsHelper.Create ();
+  ApplicationContainer apps = nsHelper.InstallGateways (networkServer, gatewayNodes);
+  apps.Start (Seconds (0.0));
+  apps.Stop (Seconds (20.0));
+  networkServer->TraceConnectWithoutContext ("USMsgReceived", MakeBoundCallback (&LoRaWANCryptoEndToEndTestCase::USMsgReceived, &result));
+  networkServer->TraceConnectWithoutContext ("nrUSMicFailures", MakeBoundCallback (&LoRaWANTestUtils::CounterChanged, &result.m_nsMicFailures));
+
+  Ptr<LoRaWANEndDeviceApplication> edApp = CreateObject<LoRaWANEndDeviceApplication> ();
+  edApp->SetAttribute ("DataRateIndex", UintegerValue (5));
+  edApp->SetAttribute ("PacketSize", UintegerValue (1 + 8 + g_usPacketSize + 4)); // MHDR, FHDR and FPort, FRMPayload and MIC
+  edApp->SetAttribute ("UpstreamIAT", StringValue ("ns3::ConstantRandomVariable[Constant=100.0]"));
+  edApp->TraceConnectWithoutContext ("DSMsgReceived", MakeBoundCallback (&LoRaWANCryptoEndToEndTestCase::DSMsgReceived, &result));
+  endDeviceNodes.Get (0)->AddApplication (edApp);
+  edApp->SetStartTime (Seconds (1.0));
+  edApp->SetStopTime (Seconds (20.0));
+
+  if (otaa) {
+    // The JoinAccept is sent in RW1 of the JoinRequest, the first US data
+    // packet a few seconds later
+    edApp->SetAttribute ("OTAA", BooleanValue (true));
+    edApp->SetAttribute ("AppKey", StringValue ("2b7e151628aed2a6abf7158809cf4f3c"));
+    networkServer->SetAppKey (edApp->GetDevEui (), KeyFromHex (nsKeys == 1 ? "3c4fcf098815f7aba6d2ae2816157e2b" : "2b7e151628aed2a6abf7158809cf4f3c"));
+    edApp->TraceConnectWithoutContext ("Joined", MakeBoundCallback (&LoRaWANCryptoEndToEndTestCase::Joined, &result));
+    if (nsKeys == 2)
+      Simulator::Schedule (Seconds (1.5), &LoRaWANCryptoEndToEndTestCase::ChangeAppKey, endDevice->GetMac ());
+  } else {
+    // The DS packet is sent in RW1 of the first US packet at 1 s
+    Simulator::Schedule (Seconds (0.5), &LoRaWANCryptoEndToEndTestCase::QueueDSPacket, networkServer, endDevices.Get (0));
+    if (nsKeys == 1)
+      Simulator::Schedule (Seconds (0.5), &LoRaWANCryptoEndToEndTestCase::ChangeSessionKeys, networkServer, endDevices.Get (0));
+    else if (nsKeys == 2)
+      Simulator::Schedule (Seconds (1.5), &LoRaWANCryptoEndToEndTestCase::ChangeSessionKeys, networkServer, endDevices.Get (0));
+  }
+
+  Simulator::Stop (Seconds (20.0));
+  Simulator::Run ();
+  result.m_edMicFailures = endDevice->GetMac ()->GetMicFailures ();
+  Simulator::Destroy ();
+  return result;
+}
+
+void
+LoRaWANCryptoEndToEndTestCase::DoRun (void)
+{
+  Result result = RunScenario (true, false, 0);
+  NS_TEST_ASSERT_MSG_EQ (result.m_nOnAir, 1, "The gateway should receive the US packet");
+  NS_TEST_ASSERT_MSG_EQ (result.m_onAirEncrypted, true, "The US FRMPayload should be encrypted and have a MIC");
+  NS_TEST_ASSERT_MSG_EQ (result.m_nUSReceived, 1, "The network server should accept the US packet");
+  NS_TEST_ASSERT_MSG_EQ (result.m_usPayloadCorrect, true, "The network server should decrypt the US FRMPayload");
+  NS_TEST_ASSERT_MSG_EQ (result.m_nDSReceived, 1, "The end device should accept the DS packet");
+  NS_TEST_ASSERT_MSG_EQ (result.m_dsPayloadCorrect, true, "The end device should decrypt the DS FRMPayload");
+  NS_TEST_ASSERT_MSG_EQ (result.m_nsMicFailures, 0, "There should be no MIC failures");
+  NS_TEST_ASSERT_MSG_EQ (result.m_edMicFailures, 0, "There should be no MIC failures");
+
+  result = RunScenario (false, false, 0);
+  NS_TEST_ASSERT_MSG_EQ (result.m_nOnAir, 1, "The gateway should receive the US packet");
+  NS_TEST_ASSERT_MSG_EQ (result.m_onAirEncrypted, false, "Without crypto the US FRMPayload should be sent in clear");
+  NS_TEST_ASSERT_MSG_EQ (result.m_nUSReceived, 1, "The network server should accept the US packet");
+  NS_TEST_ASSERT_MSG_EQ (result.m_usPayloadCorrect, true, "Wrong US FRMPayload");
+  NS_TEST_ASSERT_MSG_EQ (result.m_nDSReceived, 1, "The end device should accept the DS packet");
+  NS_TEST_ASSERT_MSG_EQ (result.m_dsPayloadCorrect, true, "Wrong DS FRMPayload");
+
+  result = RunScenario (true, false, 1);
+  NS_TEST_ASSERT_MSG_EQ (result.m_nUSReceived, 0, "The network server should drop a US packet with an invalid MIC");
+  NS_TEST_ASSERT_MSG_EQ (result.m_nsMicFailures, 1, "The network server should count the MIC failure");
+  NS_TEST_ASSERT_MSG_EQ (result.m_nDSReceived, 0, "There should be no DS packet");
+
+  result = RunScenario (true, false, 2);
+  NS_TEST_ASSERT_MSG_EQ (result.m_nUSReceived, 1, "The network server should accept the US packet");
+  NS_TEST_ASSERT_MSG_EQ (result.m_nDSReceived, 0, "The end device should drop a DS packet with an invalid MIC");
+  NS_TEST_ASSERT_MSG_EQ (result.m_edMicFailures, 1, "The end device should count the MIC failure");
+
+  result = RunScenario (true, true, 0);
+  NS_TEST_ASSERT_MSG_EQ (result.m_joined, true, "The end device should accept the JoinAccept");
+  NS_TEST_ASSERT_MSG_EQ (result.m_nUSReceived, 1, "The network server should accept the US packet of the joined end device");
+  NS_TEST_ASSERT_MSG_EQ (result.m_usPayloadCorrect, true, "The network server should decrypt the US FRMPayload with the derived keys");
+  NS_TEST_ASSERT_MSG_EQ (result.m_nsMicFailures, 0, "There should be no MIC failures");
+  NS_TEST_ASSERT_MSG_EQ (result.m_edMicFailures, 0, "There should be no MIC failures");
+
+  result = RunScenario (false, true, 0);
+  NS_TEST_ASSERT_MSG_EQ (result.m_joined, true, "Without crypto the end device should recognize its JoinAccept by its DevEUI");
+  NS_TEST_ASSERT_MSG_EQ (result.m_nUSReceived, 1, "The network server should accept the US packet of the joined end device");
+
+  result = RunScenario (true, true, 1);
+  NS_TEST_ASSERT_MSG_EQ (result.m_joined, false, "The network server should reject the JoinRequests of an end device with another AppKey");
+  NS_TEST_ASSERT_MSG_EQ (result.m_nUSReceived, 0, "There should be no US packets without a join");
+  NS_TEST_ASSERT_MSG_GT (result.m_nsMicFailures, 0, "The network server should count the MIC failures of the JoinRequests");
+
+  result = RunScenario (true, true, 2);
+  NS_TEST_ASSERT_MSG_EQ (result.m_joined, false, "The end device should drop a JoinAccept with an invalid MIC");
+  NS_TEST_ASSERT_MSG_EQ (result.m_edMicFailures, 1, "The end device should count the MIC failure of the JoinAccept");
+}
+
+class LoRaWANCryptoTestSuite : public TestSuite
+{
+public:
+  LoRaWANCryptoTestSuite ();
+};
+
+LoRaWANCryptoTestSuite::LoRaWANCryptoTestSuite ()
+  : TestSuite ("lorawan-crypto", UNIT)
+{
+  AddTestCase (new LoRaWANCryptoAesTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANCryptoFrameTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANCryptoEndToEndTestCase, TestCase::QUICK);
+}
+
+static LoRaWANCryptoTestSuite lorawanCryptoTestSuite;
@@ -196,6 +196,71 @@ LoRaWANErrorModelTestCase::DoRun (void)
 
 }
 
+// ==============================================================================
+class LoRaWANErrorModelLookupTableTestCase : public TestCase
+{
+public:
+  LoRaWANErrorModelLookupTableTestCase ();
+  virtual ~LoRaWANErrorModelLookupTableTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANErrorModelLookupTableTestCase::LoRaWANErrorModelLookupTableTestCase ()
+  : TestCase ("Test the deviation of the LoRaWAN error model lookup table from the BER curves")
+{
+}
+
+LoRaWANErrorModelLookupTableTestCase::~LoRaWANErrorModelLookupTableTestCase ()
+{
+}
+
+void
+LoRaWANErrorModelLookupTableTestCase::DoRun (void)
+{
+  Ptr<LoRaWANErrorModel> model = CreateObject<LoRaWANErrorModel> ();
+  Ptr<LoRaWANErrorModel> tableModel = CreateObject<LoRaWANErrorModel> ();
+  tableModel->SetAttribute ("UseLookupTable", BooleanValue (true));
+  uint32_t bandwidth = 125e3;
+
+  const uint32_t nbits[] = {1, 8, 64, 512, 4096};
+  std::vector<LoRaWANErrorModelChunk> chunks;
+  std::vector<double> expected;
+  double maxDeviation = 0.0;
+  for (uint8_t sf = 7; sf <= 12; sf++)
+    {
+      LoRaSpreadingFactor spreadingFactor = static_cast <LoRaSpreadingFactor> (sf);
+      for (uint8_t codeRate = 1; codeRate <= 3; codeRate += 2)
+        {
+          // Also cover SNRs outside of the table
+          for (double snr = -30.0; snr <= 5.0; snr += 0.0037)
+            {
+              for (uint32_t i = 0; i < sizeof (nbits) / sizeof (nbits[0]); i++)
+                {
+                  double analytic = model->GetChunkSuccessRate (snr, nbits[i], bandwidth, spreadingFactor, codeRate);
+                  double lookup = tableModel->GetChunkSuccessRate (snr, nbits[i], bandwidth, spreadingFactor, codeRate);
+                  maxDeviation = std::max (maxDeviation, std::fabs (analytic - lookup));
+
+                  LoRaWANErrorModelChunk chunk = {snr, nbits[i], spreadingFactor, codeRate};
+                  chunks.push_back (chunk);
+                  expected.push_back (lookup);
+                }
+            }
+        }
+    }
+  NS_TEST_ASSERT_MSG_LT (maxDeviation, 1.0e-4, "Lookup table deviates too much from the BER curves");
+
+  // The batch API should give the same results as individual lookups
+  std::vector<double> successRates;
+  tableModel->GetChunkSuccessRates (chunks, successRates);
+  NS_TEST_ASSERT_MSG_EQ (successRates.size (), chunks.size (), "Expected a success rate per chunk");
+  for (uint32_t i = 0; i < chunks.size (); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ_TOL (successRates[i], expected[i], 1.0e-12, "Batch lookup differs for chunk " << i);
+    }
+}
+
 // ==============================================================================
 class LoRaWANErrorModelTestSuite : public TestSuite
 {
@@ -207,6 +272,7 @@ LoRaWANErrorModelTestSuite::LoRaWANErrorModelTestSuite ()
   : TestSuite ("lorawan-error-model", UNIT)
 {
   AddTestCase (new LoRaWANErrorModelTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANErrorModelLookupTableTestCase, TestCase::QUICK);
   AddTestCase (new LoRaWANErrorDistanceTestCase, TestCase::QUICK);
 }
 
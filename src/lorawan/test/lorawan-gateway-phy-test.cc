@@ -0,0 +1,565 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include <ns3/log.h>
+#include <ns3/core-module.h>
+#include <ns3/lorawan-module.h>
+#include <ns3/propagation-loss-model.h>
+#include <ns3/propagation-delay-model.h>
+#include <ns3/simulator.h>
+#include <ns3/single-model-spectrum-channel.h>
+#include <ns3/constant-position-mobility-model.h>
+#include <ns3/node.h>
+#include <ns3/packet.h>
+#include "ns3/rng-seed-manager.h"
+
+#include <iostream>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-gateway-phy-test");
+
+/**
+ * Reception outcomes of a gateway: the number of packets indicated by every
+ * gateway MAC, the number of dropped packets per drop reason and the number
+ * of PHYs of the shared receiver.
+ */
+struct LoRaWANGatewayRxOutcome
+{
+  std::vector<uint32_t> m_received;
+  std::map<LoRaWANPhyDropRxReason, uint32_t> m_dropped;
+  uint32_t m_nPhys;
+};
+
+static bool
+GatewayReceive (LoRaWANGatewayRxOutcome *outcome, Ptr<NetDevice> device, Ptr<const Packet> p, uint16_t protocol, const Address &from)
+{
+  outcome->m_received[0]++;
+  return true;
+}
+
+static void
+GatewayDataIndication (LoRaWANGatewayRxOutcome *outcome, uint32_t macIndex, LoRaWANDataIndicationParams params, Ptr<Packet> p)
+{
+  outcome->m_received[macIndex]++;
+}
+
+static void
+GatewayRxDrop (LoRaWANGatewayRxOutcome *outcome, Ptr<const Packet> p, LoRaWANPhyDropRxReason reason)
+{
+  outcome->m_dropped[reason]++;
+}
+
+/**
+ * Build a gateway and a set of end devices on a single channel.
+ *
+ * \param sharedReceiver whether the gateway uses a LoRaWANGatewayPhy
+ * \param positions x coordinates of the end devices (gateway is at the origin)
+ * \param outcome the reception outcomes of the gateway
+ * \param endDevices the created end devices
+ * \param onDemand leave it to the shared receiver to build the gateway PHYs
+ * and MACs, outcome then only counts the received packets of the gateway
+ * \return the gateway net device
+ */
+static Ptr<LoRaWANNetDevice>
+BuildGatewayScenario (bool sharedReceiver, const std::vector<double> &positions, LoRaWANGatewayRxOutcome *outcome, std::vector<Ptr<LoRaWANNetDevice> > &endDevices, bool onDemand = false)
+{
+  Ptr<SingleModelSpectrumChannel> channel = CreateObject<SingleModelSpectrumChannel> ();
+  Ptr<LogDistancePropagationLossModel> propModel = CreateObject<LogDistancePropagationLossModel> ();
+  Ptr<ConstantSpeedPropagationDelayModel> delayModel = CreateObject<ConstantSpeedPropagationDelayModel> ();
+  channel->AddPropagationLossModel (propModel);
+  channel->SetPropagationDelayModel (delayModel);
+
+  Ptr<Node> gw = CreateObject <Node> ();
+  Ptr<ConstantPositionMobilityModel> gwMobility = CreateObject<ConstantPositionMobilityModel> ();
+  gwMobility->SetPosition (Vector (0,0,0));
+  if (onDemand)
+    gw->AggregateObject (gwMobility); // for the PHYs that are built later on
+
+  Ptr<LoRaWANNetDevice> dev_gw = CreateObject<LoRaWANNetDevice> (LORAWAN_DT_GATEWAY);
+  dev_gw->SetAttribute ("SharedGatewayReceiver", BooleanValue (sharedReceiver));
+  dev_gw->SetChannel (channel);
+  gw->AddDevice (dev_gw);
+  dev_gw->AssignStreams (1000);
+
+  if (onDemand) {
+    // GetPhys and GetMacs would build the PHYs and MACs of every channel
+    outcome->m_received.assign (1, 0);
+    dev_gw->SetReceiveCallback (MakeBoundCallback (&GatewayReceive, outcome));
+  } else {
+    for (auto &it : dev_gw->GetPhys() ) {
+      it->SetMobility (gwMobility);
+      it->TraceConnectWithoutContext ("PhyRxDrop", MakeBoundCallback (&GatewayRxDrop, outcome));
+    }
+
+    std::vector<Ptr<LoRaWANMac> > macs = dev_gw->GetMacs ();
+    outcome->m_received.assign (macs.size (), 0);
+    for (uint32_t i = 0; i < macs.size (); i++) {
+      macs[i]->SetDataIndicationCallback (MakeBoundCallback (&GatewayDataIndication, outcome, i));
+    }
+  }
+
+  for (uint32_t i = 0; i < positions.size (); i++) {
+    Ptr<Node> n = CreateObject <Node> ();
+    Ptr<LoRaWANNetDevice> dev = CreateObject<LoRaWANNetDevice> (LORAWAN_DT_END_DEVICE_CLASS_A);
+    dev->SetAddress (Ipv4Address (i + 1));
+    dev->SetChannel (channel);
+    n->AddDevice (dev);
+    dev->AssignStreams (i);
+
+    Ptr<ConstantPositionMobilityModel> mobility = CreateObject<ConstantPositionMobilityModel> ();
+    mobility->SetPosition (Vector (positions[i],0,0));
+    dev->GetPhy ()->SetMobility (mobility);
+
+    endDevices.push_back (dev);
+  }
+
+  return dev_gw;
+}
+
+static void
+ScheduleUplink (Ptr<LoRaWANNetDevice> dev, Time t, uint8_t channelIndex, uint8_t dataRateIndex)
+{
+  LoRaWANDataRequestParams params;
+  params.m_loraWANChannelIndex = channelIndex;
+  params.m_loraWANDataRateIndex = dataRateIndex;
+  params.m_loraWANCodeRate = 3;
+  params.m_msgType = LORAWAN_UNCONFIRMED_DATA_UP;
+  params.m_requestHandle = 1;
+  params.m_numberOfTransmissions = 1;
+
+  Ptr<Packet> p = Create<Packet> (20);
+  Simulator::Schedule (t, &LoRaWANMac::sendMACPayloadRequest, dev->GetMac (), params, p);
+}
+
+// ==============================================================================
+class LoRaWANGatewayPhyRegressionTestCase : public TestCase
+{
+public:
+  LoRaWANGatewayPhyRegressionTestCase ();
+  virtual ~LoRaWANGatewayPhyRegressionTestCase ();
+
+private:
+  LoRaWANGatewayRxOutcome RunScenario (bool sharedReceiver, bool onDemand);
+  virtual void DoRun (void);
+};
+
+LoRaWANGatewayPhyRegressionTestCase::LoRaWANGatewayPhyRegressionTestCase ()
+  : TestCase ("Test that a shared gateway receiver yields the same reception outcomes as per-PHY receivers")
+{
+}
+
+LoRaWANGatewayPhyRegressionTestCase::~LoRaWANGatewayPhyRegressionTestCase ()
+{
+}
+
+LoRaWANGatewayRxOutcome
+LoRaWANGatewayPhyRegressionTestCase::RunScenario (bool sharedReceiver, bool onDemand)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (6);
+
+  // Mix of strong and weak links, co-channel/co-DR collisions and cross-DR interference
+  const double positions[] = {400, 1500, 2200, 800, 2600, 1000, 1800, 2400};
+  const uint8_t channels[] = {0, 0, 0, 1, 1, 2, 2, 2};
+  const uint8_t dataRates[] = {5, 5, 4, 5, 3, 4, 4, 5};
+  const uint32_t nDevices = sizeof (positions) / sizeof (positions[0]);
+
+  LoRaWANGatewayRxOutcome outcome;
+  std::vector<Ptr<LoRaWANNetDevice> > endDevices;
+  Ptr<LoRaWANNetDevice> dev_gw = BuildGatewayScenario (sharedReceiver, std::vector<double> (positions, positions + nDevices), &outcome, endDevices, onDemand);
+
+  NS_TEST_EXPECT_MSG_EQ ((dev_gw->GetGatewayPhy () != 0), sharedReceiver, "Unexpected gateway receiver configuration");
+
+  for (uint32_t j = 0; j < 50; j++) {
+    for (uint32_t i = 0; i < nDevices; i++) {
+      ScheduleUplink (endDevices[i], Seconds (3*j) + MilliSeconds (37*i), channels[i], dataRates[i]);
+    }
+  }
+
+  Simulator::Run ();
+  outcome.m_nPhys = sharedReceiver ? dev_gw->GetGatewayPhy ()->GetNPhys () : 0;
+  Simulator::Destroy ();
+
+  return outcome;
+}
+
+void
+LoRaWANGatewayPhyRegressionTestCase::DoRun (void)
+{
+  LoRaWANGatewayRxOutcome perPhy = RunScenario (false, false);
+  LoRaWANGatewayRxOutcome shared = RunScenario (true, false);
+
+  uint32_t totalReceived = 0;
+  for (uint32_t i = 0; i < perPhy.m_received.size (); i++) {
+    NS_TEST_ASSERT_MSG_EQ (shared.m_received[i], perPhy.m_received[i], "Different number of packets received by gateway MAC #" << i);
+    totalReceived += perPhy.m_received[i];
+  }
+  NS_TEST_ASSERT_MSG_GT (totalReceived, 0, "Gateway did not receive any packets");
+
+  NS_TEST_ASSERT_MSG_EQ (shared.m_dropped.size (), perPhy.m_dropped.size (), "Different drop reasons observed");
+  for (auto &it : perPhy.m_dropped) {
+    NS_TEST_ASSERT_MSG_EQ (shared.m_dropped[it.first], it.second, "Different number of drops for reason " << it.first);
+  }
+  NS_TEST_ASSERT_MSG_EQ (perPhy.m_dropped.count (LORAWAN_RX_DROP_PHY_BUSY_RX), 1, "Scenario should contain co-DR collisions");
+
+  // A shared receiver that builds the PHYs of a channel when its first signal
+  // arrives, only builds the PHYs of the three channels in use
+  LoRaWANGatewayRxOutcome onDemand = RunScenario (true, true);
+  NS_TEST_ASSERT_MSG_EQ (onDemand.m_received[0], totalReceived, "Different number of packets received by the gateway with PHYs built on demand");
+
+  const std::vector<std::pair<uint8_t, uint8_t> > &configs = LoRaWAN::GetGatewayPhyConfigs ();
+  uint32_t nChannelPhys = 0;
+  for (uint32_t i = 0; i < configs.size (); i++) {
+    if (configs[i].first <= 2)
+      nChannelPhys++;
+  }
+  NS_TEST_ASSERT_MSG_LT (nChannelPhys, configs.size (), "Scenario should not use every channel of the gateway");
+  NS_TEST_ASSERT_MSG_EQ (onDemand.m_nPhys, nChannelPhys, "Gateway should only build the PHYs of the channels in use");
+}
+
+// ==============================================================================
+class LoRaWANGatewayPhyDemodulatorTestCase : public TestCase
+{
+public:
+  LoRaWANGatewayPhyDemodulatorTestCase ();
+  virtual ~LoRaWANGatewayPhyDemodulatorTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANGatewayPhyDemodulatorTestCase::LoRaWANGatewayPhyDemodulatorTestCase ()
+  : TestCase ("Test that the shared gateway receiver limits the number of parallel receptions")
+{
+}
+
+LoRaWANGatewayPhyDemodulatorTestCase::~LoRaWANGatewayPhyDemodulatorTestCase ()
+{
+}
+
+void
+LoRaWANGatewayPhyDemodulatorTestCase::DoRun (void)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (6);
+
+  const double positions[] = {10, 20, 30};
+  LoRaWANGatewayRxOutcome outcome;
+  std::vector<Ptr<LoRaWANNetDevice> > endDevices;
+  Ptr<LoRaWANNetDevice> dev_gw = BuildGatewayScenario (true, std::vector<double> (positions, positions + 3), &outcome, endDevices);
+  dev_gw->GetGatewayPhy ()->SetAttribute ("DemodulatorPaths", UintegerValue (2));
+
+  // Three simultaneous uplinks on three different channels, only two
+  // demodulators are available
+  ScheduleUplink (endDevices[0], Seconds (1.0), 0, 5);
+  ScheduleUplink (endDevices[1], Seconds (1.0), 1, 5);
+  ScheduleUplink (endDevices[2], Seconds (1.0), 2, 5);
+  // After the first uplinks, the demodulators should be released again
+  ScheduleUplink (endDevices[2], Seconds (5.0), 2, 5);
+
+  Simulator::Run ();
+
+  uint32_t totalReceived = 0;
+  for (auto &it : outcome.m_received) {
+    totalReceived += it;
+  }
+  NS_TEST_ASSERT_MSG_EQ (totalReceived, 3, "Expected two parallel receptions and one later reception");
+  NS_TEST_ASSERT_MSG_EQ (outcome.m_dropped[LORAWAN_RX_DROP_NO_DEMODULATOR], 1, "Expected one drop due to lack of demodulators");
+  NS_TEST_ASSERT_MSG_EQ (dev_gw->GetGatewayPhy ()->GetBusyDemodulators (), 0, "Demodulators were not released");
+
+  Simulator::Destroy ();
+}
+
+// ==============================================================================
+class LoRaWANGatewayPhyCaptureTestCase : public TestCase
+{
+public:
+  LoRaWANGatewayPhyCaptureTestCase ();
+  virtual ~LoRaWANGatewayPhyCaptureTestCase ();
+
+private:
+  /**
+   * Let two end devices send an uplink on channel 0.
+   *
+   * \param positions x coordinates of the end devices
+   * \param dataRates data rates of the uplinks
+   * \param offset the time between the start of the first and the second uplink
+   * \return the reception outcomes of the gateway
+   */
+  LoRaWANGatewayRxOutcome RunScenario (const double positions[2], const uint8_t dataRates[2], Time offset);
+  virtual void DoRun (void);
+};
+
+LoRaWANGatewayPhyCaptureTestCase::LoRaWANGatewayPhyCaptureTestCase ()
+  : TestCase ("Test preamble locking, co-SF capture and inter-SF rejection of the gateway capture model")
+{
+}
+
+LoRaWANGatewayPhyCaptureTestCase::~LoRaWANGatewayPhyCaptureTestCase ()
+{
+}
+
+LoRaWANGatewayRxOutcome
+LoRaWANGatewayPhyCaptureTestCase::RunScenario (const double positions[2], const uint8_t dataRates[2], Time offset)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (6);
+
+  LoRaWANGatewayRxOutcome outcome;
+  std::vector<Ptr<LoRaWANNetDevice> > endDevices;
+  Ptr<LoRaWANNetDevice> dev_gw = BuildGatewayScenario (true, std::vector<double> (positions, positions + 2), &outcome, endDevices);
+  dev_gw->GetGatewayPhy ()->SetAttribute ("CaptureModel", BooleanValue (true));
+
+  ScheduleUplink (endDevices[0], Seconds (1.0), 0, dataRates[0]);
+  ScheduleUplink (endDevices[1], Seconds (1.0) + offset, 0, dataRates[1]);
+
+  Simulator::Run ();
+
+  NS_TEST_EXPECT_MSG_EQ (dev_gw->GetGatewayPhy ()->GetNCapturedReceptions (), 0, "Receptions were not finished");
+  NS_TEST_EXPECT_MSG_EQ (dev_gw->GetGatewayPhy ()->GetBusyDemodulators (), 0, "Demodulators were not released");
+
+  Simulator::Destroy ();
+  return outcome;
+}
+
+static uint32_t
+GetTotalReceived (const LoRaWANGatewayRxOutcome &outcome)
+{
+  uint32_t totalReceived = 0;
+  for (auto &it : outcome.m_received) {
+    totalReceived += it;
+  }
+  return totalReceived;
+}
+
+void
+LoRaWANGatewayPhyCaptureTestCase::DoRun (void)
+{
+  // A strong co-SF signal during the preamble of a weak signal captures the
+  // demodulator (the SF7 preamble takes 12.544 ms)
+  const double strongLate[] = {1000, 100};
+  const uint8_t sf7[] = {5, 5};
+  LoRaWANGatewayRxOutcome outcome = RunScenario (strongLate, sf7, MilliSeconds (5));
+  NS_TEST_ASSERT_MSG_EQ (GetTotalReceived (outcome), 1, "Strong signal should have been received");
+  NS_TEST_ASSERT_MSG_EQ (outcome.m_received[5], 1, "Strong signal should have been received at SF7");
+  NS_TEST_ASSERT_MSG_EQ (outcome.m_dropped[LORAWAN_RX_DROP_CAPTURED], 1, "Weak signal should have been captured");
+
+  // After the preamble, the strong signal is received on another demodulator
+  // and destroys the weak signal
+  outcome = RunScenario (strongLate, sf7, MilliSeconds (30));
+  NS_TEST_ASSERT_MSG_EQ (GetTotalReceived (outcome), 1, "Strong signal should have been received");
+  NS_TEST_ASSERT_MSG_EQ (outcome.m_dropped[LORAWAN_RX_DROP_CAPTURED], 0, "Weak signal should not have been captured");
+  NS_TEST_ASSERT_MSG_EQ (outcome.m_dropped[LORAWAN_RX_DROP_PACKET_DESTOYED], 1, "Weak signal should have been destroyed");
+
+  // A strong co-SF signal that arrives first is not disturbed by a weak one
+  const double strongFirst[] = {100, 1000};
+  outcome = RunScenario (strongFirst, sf7, MilliSeconds (5));
+  NS_TEST_ASSERT_MSG_EQ (GetTotalReceived (outcome), 1, "Strong signal should have been received");
+  NS_TEST_ASSERT_MSG_EQ (outcome.m_dropped[LORAWAN_RX_DROP_SINR_TOO_LOW], 1, "Weak signal should not have been locked onto");
+
+  // Two co-SF signals within the capture threshold destroy each other
+  const double similar[] = {1000, 800};
+  outcome = RunScenario (similar, sf7, MilliSeconds (30));
+  NS_TEST_ASSERT_MSG_EQ (GetTotalReceived (outcome), 0, "No signal should have been received");
+  NS_TEST_ASSERT_MSG_EQ (outcome.m_dropped[LORAWAN_RX_DROP_SINR_TOO_LOW], 1, "Second signal should not have been locked onto");
+  NS_TEST_ASSERT_MSG_EQ (outcome.m_dropped[LORAWAN_RX_DROP_PACKET_DESTOYED], 1, "First signal should have been destroyed");
+
+  // Signals with different spreading factors are quasi-orthogonal
+  const uint8_t sf7sf12[] = {5, 0};
+  outcome = RunScenario (similar, sf7sf12, MilliSeconds (5));
+  NS_TEST_ASSERT_MSG_EQ (GetTotalReceived (outcome), 2, "Both signals should have been received");
+
+  // ... unless the interferer exceeds the inter-SF rejection
+  const double interSfStrong[] = {2000, 100};
+  outcome = RunScenario (interSfStrong, sf7sf12, MilliSeconds (5));
+  NS_TEST_ASSERT_MSG_EQ (outcome.m_received[0], 1, "Strong SF12 signal should have been received");
+  NS_TEST_ASSERT_MSG_EQ (outcome.m_dropped[LORAWAN_RX_DROP_PACKET_DESTOYED], 1, "Weak SF7 signal should have been destroyed");
+}
+
+// ==============================================================================
+class LoRaWANGatewayPhyCaptureScaleTestCase : public TestCase
+{
+public:
+  LoRaWANGatewayPhyCaptureScaleTestCase ();
+  virtual ~LoRaWANGatewayPhyCaptureScaleTestCase ();
+
+private:
+  static void BusyDemodulators (uint32_t *maxBusy, uint32_t oldValue, uint32_t newValue);
+  virtual void DoRun (void);
+};
+
+LoRaWANGatewayPhyCaptureScaleTestCase::LoRaWANGatewayPhyCaptureScaleTestCase ()
+  : TestCase ("Test the gateway capture model with hundreds of concurrent signals")
+{
+}
+
+LoRaWANGatewayPhyCaptureScaleTestCase::~LoRaWANGatewayPhyCaptureScaleTestCase ()
+{
+}
+
+void
+LoRaWANGatewayPhyCaptureScaleTestCase::BusyDemodulators (uint32_t *maxBusy, uint32_t oldValue, uint32_t newValue)
+{
+  *maxBusy = std::max (*maxBusy, newValue);
+}
+
+void
+LoRaWANGatewayPhyCaptureScaleTestCase::DoRun (void)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (6);
+
+  const uint32_t nDevices = 300;
+  std::vector<double> positions;
+  for (uint32_t i = 0; i < nDevices; i++) {
+    positions.push_back (100 + 10*i);
+  }
+
+  LoRaWANGatewayRxOutcome outcome;
+  std::vector<Ptr<LoRaWANNetDevice> > endDevices;
+  Ptr<LoRaWANNetDevice> dev_gw = BuildGatewayScenario (true, positions, &outcome, endDevices);
+  Ptr<LoRaWANGatewayPhy> gatewayPhy = dev_gw->GetGatewayPhy ();
+  gatewayPhy->SetAttribute ("CaptureModel", BooleanValue (true));
+  uint32_t maxBusy = 0;
+  gatewayPhy->TraceConnectWithoutContext ("BusyDemodulators", MakeBoundCallback (&LoRaWANGatewayPhyCaptureScaleTestCase::BusyDemodulators, &maxBusy));
+
+  // All uplinks overlap in time
+  for (uint32_t i = 0; i < nDevices; i++) {
+    ScheduleUplink (endDevices[i], Seconds (1.0) + MicroSeconds (100*i), i % 3, i % 6);
+  }
+
+  Simulator::Run ();
+
+  uint32_t totalReceived = GetTotalReceived (outcome);
+  NS_TEST_ASSERT_MSG_GT (maxBusy, 0, "Gateway did not lock onto any packets");
+  NS_TEST_ASSERT_MSG_LT_OR_EQ (maxBusy, 8, "More receptions than demodulators");
+  NS_TEST_ASSERT_MSG_EQ (gatewayPhy->GetNCapturedReceptions (), 0, "Receptions were not finished");
+  NS_TEST_ASSERT_MSG_EQ (gatewayPhy->GetBusyDemodulators (), 0, "Demodulators were not released");
+
+  uint32_t totalDropped = 0;
+  for (auto &it : outcome.m_dropped) {
+    totalDropped += it.second;
+  }
+  NS_TEST_ASSERT_MSG_EQ (totalReceived + totalDropped, nDevices, "Every uplink should have been received or dropped");
+
+  Simulator::Destroy ();
+}
+
+// ==============================================================================
+class LoRaWANGatewayPhyConcurrencyTestCase : public TestCase
+{
+public:
+  LoRaWANGatewayPhyConcurrencyTestCase ();
+  virtual ~LoRaWANGatewayPhyConcurrencyTestCase ();
+
+private:
+  static void CheckSignals (Ptr<LoRaWANGatewayPhy> gatewayPhy, uint32_t *nSignals);
+  virtual void DoRun (void);
+};
+
+LoRaWANGatewayPhyConcurrencyTestCase::LoRaWANGatewayPhyConcurrencyTestCase ()
+  : TestCase ("Test the interference bookkeeping of the gateway capture model with thousands of concurrent signals")
+{
+}
+
+LoRaWANGatewayPhyConcurrencyTestCase::~LoRaWANGatewayPhyConcurrencyTestCase ()
+{
+}
+
+void
+LoRaWANGatewayPhyConcurrencyTestCase::CheckSignals (Ptr<LoRaWANGatewayPhy> gatewayPhy, uint32_t *nSignals)
+{
+  *nSignals = gatewayPhy->GetNSignals ();
+}
+
+void
+LoRaWANGatewayPhyConcurrencyTestCase::DoRun (void)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (6);
+
+  // The signals are passed to the gateway receiver directly, so that the
+  // cost of the channel does not hide the cost of the interference
+  // bookkeeping, which is constant per signal
+  const uint32_t nSignals = 5000;
+  const double positions[] = {10};
+  LoRaWANGatewayRxOutcome outcome;
+  std::vector<Ptr<LoRaWANNetDevice> > endDevices;
+  Ptr<LoRaWANNetDevice> dev_gw = BuildGatewayScenario (true, std::vector<double> (positions, positions + 1), &outcome, endDevices);
+  Ptr<LoRaWANGatewayPhy> gatewayPhy = dev_gw->GetGatewayPhy ();
+  gatewayPhy->SetAttribute ("CaptureModel", BooleanValue (true));
+
+  // All signals overlap, they end in a different order than they start
+  for (uint32_t i = 0; i < nSignals; i++) {
+    Ptr<Packet> p = Create<Packet> (20);
+    LoRaWANFrameHeader fhdr;
+    fhdr.setDevAddr (Ipv4Address (i + 1));
+    fhdr.setFramePort (1);
+    p->AddHeader (fhdr);
+    p->AddHeader (LoRaWANMacHeader (LORAWAN_UNCONFIRMED_DATA_UP, 0));
+    p->AddPaddingAtEnd (4);
+
+    Ptr<LoRaWANSpectrumSignalParameters> params = Create<LoRaWANSpectrumSignalParameters> ();
+    params->txPhy = endDevices[0]->GetPhy ();
+    params->duration = Seconds (1.0) + MicroSeconds ((i * 7919) % nSignals);
+    params->packet = p;
+    params->channelIndex = i % 3;
+    params->dataRateIndex = i % 6;
+    params->codeRate = 3;
+    Simulator::Schedule (Seconds (1.0) + MicroSeconds (i), &LoRaWANGatewayPhy::StartLoRaWANRx, gatewayPhy, params, 1e-16 * (1 + i % 13));
+  }
+  uint32_t nConcurrentSignals = 0;
+  Simulator::Schedule (Seconds (1.5), &LoRaWANGatewayPhyConcurrencyTestCase::CheckSignals, gatewayPhy, &nConcurrentSignals);
+
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (nConcurrentSignals, nSignals, "Every signal should be accounted for as interference");
+  NS_TEST_ASSERT_MSG_EQ (gatewayPhy->GetNSignals (), 0, "Signals were not removed");
+  NS_TEST_ASSERT_MSG_EQ (gatewayPhy->GetNCapturedReceptions (), 0, "Receptions were not finished");
+  NS_TEST_ASSERT_MSG_EQ (gatewayPhy->GetBusyDemodulators (), 0, "Demodulators were not released");
+
+  uint32_t totalDropped = 0;
+  for (auto &it : outcome.m_dropped) {
+    totalDropped += it.second;
+  }
+  NS_TEST_ASSERT_MSG_GT (totalDropped, 0, "Signals should have been dropped");
+  NS_TEST_ASSERT_MSG_EQ (GetTotalReceived (outcome) + totalDropped, nSignals, "Every signal should have been received or dropped");
+
+  Simulator::Destroy ();
+}
+
+// ==============================================================================
+class LoRaWANGatewayPhyTestSuite : public TestSuite
+{
+public:
+  LoRaWANGatewayPhyTestSuite ();
+};
+
+LoRaWANGatewayPhyTestSuite::LoRaWANGatewayPhyTestSuite ()
+  : TestSuite ("lorawan-gateway-phy", UNIT)
+{
+  AddTestCase (new LoRaWANGatewayPhyRegressionTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANGatewayPhyDemodulatorTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANGatewayPhyCaptureTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANGatewayPhyCaptureScaleTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANGatewayPhyConcurrencyTestCase, TestCase::QUICK);
+}
+
+static LoRaWANGatewayPhyTestSuite lorawanGatewayPhyTestSuite;
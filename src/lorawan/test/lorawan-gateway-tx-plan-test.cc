@@ -0,0 +1,100 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include <ns3/log.h>
+#include <ns3/test.h>
+#include <ns3/nstime.h>
+#include <ns3/lorawan-module.h>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-gateway-tx-plan-test");
+
+class LoRaWANGatewayTxPlanTestCase : public TestCase
+{
+public:
+  LoRaWANGatewayTxPlanTestCase ();
+  virtual ~LoRaWANGatewayTxPlanTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANGatewayTxPlanTestCase::LoRaWANGatewayTxPlanTestCase ()
+  : TestCase ("Test the reservation of DS transmissions in the TX plan of a gateway")
+{
+}
+
+LoRaWANGatewayTxPlanTestCase::~LoRaWANGatewayTxPlanTestCase ()
+{
+}
+
+void
+LoRaWANGatewayTxPlanTestCase::DoRun (void)
+{
+  LoRaWANGatewayTxPlan plan;
+
+  // 100 ms on sub band 1 (1%): the sub band is off until 11 s
+  NS_TEST_ASSERT_MSG_EQ (plan.IsFeasible (Seconds (1.0), MilliSeconds (100), 1, 100), true, "An empty plan should accept any transmission");
+  plan.Reserve (Seconds (1.0), MilliSeconds (100), 1, 100);
+
+  // The transmitter is busy from 1.0 s to 1.1 s
+  NS_TEST_ASSERT_MSG_EQ (plan.IsFeasible (Seconds (0.95), MilliSeconds (100), 3, 10), false, "Transmissions should not overlap the start of a reservation");
+  NS_TEST_ASSERT_MSG_EQ (plan.IsFeasible (Seconds (1.05), MilliSeconds (10), 3, 10), false, "Transmissions should not overlap a reservation");
+  NS_TEST_ASSERT_MSG_EQ (plan.IsFeasible (Seconds (0.9), MilliSeconds (100), 3, 10), true, "A transmission may end when a reservation starts");
+  NS_TEST_ASSERT_MSG_EQ (plan.IsFeasible (Seconds (1.1), MilliSeconds (100), 3, 10), true, "A transmission may start when a reservation ends");
+
+  // The duty cycle of sub band 1 is used up after the reservation, and a
+  // transmission before it should leave enough time off
+  NS_TEST_ASSERT_MSG_EQ (plan.IsFeasible (Seconds (5.0), MilliSeconds (100), 1, 100), false, "The time off of the previous reservation should be respected");
+  NS_TEST_ASSERT_MSG_EQ (plan.IsFeasible (Seconds (11.0), MilliSeconds (100), 1, 100), true, "The sub band should be available after the time off");
+  NS_TEST_ASSERT_MSG_EQ (plan.IsFeasible (Seconds (0.5), MilliSeconds (10), 1, 100), false, "The time off of a new transmission should end before the next reservation");
+  NS_TEST_ASSERT_MSG_EQ (plan.IsFeasible (Seconds (0.0), MilliSeconds (10), 1, 100), true, "A short transmission well before a reservation should fit");
+
+  plan.Reserve (Seconds (1.5), MilliSeconds (500), 3, 10);
+  plan.Reserve (Seconds (11.0), MilliSeconds (100), 1, 100);
+  NS_TEST_ASSERT_MSG_EQ (plan.GetNReservations (), 3, "Wrong number of reservations");
+  NS_TEST_ASSERT_MSG_EQ (plan.IsFeasible (Seconds (4.0), MilliSeconds (100), 3, 10), false, "The time off of sub band 3 should be respected");
+
+  // Cancelling a reservation frees its interval and its time off
+  NS_TEST_ASSERT_MSG_EQ (plan.Release (Seconds (1.5)), true, "The reservation should be found");
+  NS_TEST_ASSERT_MSG_EQ (plan.Release (Seconds (1.5)), false, "The reservation was already cancelled");
+  NS_TEST_ASSERT_MSG_EQ (plan.IsFeasible (Seconds (4.0), MilliSeconds (100), 3, 10), true, "The time off of a cancelled reservation should not count");
+
+  // Pruning keeps the reservations of which the time off has not ended
+  plan.Prune (Seconds (2.0));
+  NS_TEST_ASSERT_MSG_EQ (plan.GetNReservations (), 1, "Only the reservation at 11 s should remain");
+  NS_TEST_ASSERT_MSG_EQ (plan.IsFeasible (Seconds (5.0), MilliSeconds (100), 1, 100), false, "The time off of a pruned transmission should still count until it ends");
+  plan.Prune (Seconds (21.0));
+  NS_TEST_ASSERT_MSG_EQ (plan.GetNReservations (), 0, "All reservations should have ended");
+}
+
+class LoRaWANGatewayTxPlanTestSuite : public TestSuite
+{
+public:
+  LoRaWANGatewayTxPlanTestSuite ();
+};
+
+LoRaWANGatewayTxPlanTestSuite::LoRaWANGatewayTxPlanTestSuite ()
+  : TestSuite ("lorawan-gateway-tx-plan", UNIT)
+{
+  AddTestCase (new LoRaWANGatewayTxPlanTestCase, TestCase::QUICK);
+}
+
+static LoRaWANGatewayTxPlanTestSuite lorawanGatewayTxPlanTestSuite;
@@ -0,0 +1,172 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include <ns3/log.h>
+#include <ns3/test.h>
+#include <ns3/spectrum-value.h>
+#include <ns3/lorawan-interference-helper.h>
+#include <ns3/lorawan-spectrum-value-helper.h>
+#include <ns3/lorawan-spectrum-signal-parameters.h>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-interference-helper-test");
+
+class LoRaWANInterferenceHelperTestCase : public TestCase
+{
+public:
+  LoRaWANInterferenceHelperTestCase ();
+  virtual ~LoRaWANInterferenceHelperTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANInterferenceHelperTestCase::LoRaWANInterferenceHelperTestCase ()
+  : TestCase ("Test the running per band and per spreading factor sums of LoRaWANInterferenceHelper")
+{
+}
+
+LoRaWANInterferenceHelperTestCase::~LoRaWANInterferenceHelperTestCase ()
+{
+}
+
+void
+LoRaWANInterferenceHelperTestCase::DoRun (void)
+{
+  LoRaWANSpectrumValueHelper psdHelper;
+  const uint32_t fc0 = LoRaWAN::m_supportedChannels [0].m_fc;
+  const uint32_t fc1 = LoRaWAN::m_supportedChannels [1].m_fc;
+
+  Ptr<SpectrumValue> s1 = psdHelper.CreateTxPowerSpectralDensity (14, fc0);
+  Ptr<SpectrumValue> s2 = psdHelper.CreateTxPowerSpectralDensity (10, fc0);
+  Ptr<SpectrumValue> s3 = psdHelper.CreateTxPowerSpectralDensity (14, fc1);
+  Ptr<SpectrumValue> noise = psdHelper.CreateNoisePowerSpectralDensity (fc0);
+
+  Ptr<LoRaWANInterferenceHelper> helper = Create<LoRaWANInterferenceHelper> (s1->GetSpectrumModel ());
+  NS_TEST_ASSERT_MSG_EQ (helper->AddSignal (s1, LORAWAN_SF7), true, "Signal should be added");
+  NS_TEST_ASSERT_MSG_EQ (helper->AddSignal (s1, LORAWAN_SF7), false, "Signal should not be added twice");
+  NS_TEST_ASSERT_MSG_EQ (helper->AddSignal (s2, LORAWAN_SF9), true, "Signal should be added");
+  NS_TEST_ASSERT_MSG_EQ (helper->AddSignal (s3, LORAWAN_SF7), true, "Signal should be added");
+  NS_TEST_ASSERT_MSG_EQ (helper->AddSignal (noise), true, "Signal without spreading factor should be added");
+  NS_TEST_ASSERT_MSG_EQ (helper->GetNSignals (), 4, "Expected four accumulated signals");
+
+  // The running sums should match the sum of the SpectrumValues
+  Ptr<SpectrumValue> sum = Create<SpectrumValue> (s1->GetSpectrumModel ());
+  *sum += *s1;
+  *sum += *s2;
+  *sum += *s3;
+  *sum += *noise;
+  Ptr<SpectrumValue> psd = helper->GetSignalPsd ();
+  for (uint32_t i = 0; i < LoRaWAN::m_supportedChannels.size (); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ_TOL (helper->GetSignalPsd (i), (*sum)[i], (*sum)[i] * 1e-12, "Wrong sum in band " << i);
+      NS_TEST_ASSERT_MSG_EQ_TOL ((*psd)[i], (*sum)[i], (*sum)[i] * 1e-12, "Wrong sum in band " << i);
+    }
+  NS_TEST_ASSERT_MSG_EQ_TOL (helper->GetSignalPsd (0, LORAWAN_SF7), (*s1)[0], (*s1)[0] * 1e-12, "Wrong SF7 sum in band 0");
+  NS_TEST_ASSERT_MSG_EQ_TOL (helper->GetSignalPsd (0, LORAWAN_SF9), (*s2)[0], (*s2)[0] * 1e-12, "Wrong SF9 sum in band 0");
+  NS_TEST_ASSERT_MSG_EQ (helper->GetSignalPsd (0, LORAWAN_SF12), 0.0, "Expected no SF12 signal in band 0");
+  NS_TEST_ASSERT_MSG_EQ_TOL (helper->GetSignalPsd (1, LORAWAN_SF7), (*s3)[1], (*s3)[1] * 1e-12, "Wrong SF7 sum in band 1");
+
+  // Removing signals updates the sums, removing the last signal in a band
+  // resets the band to exactly zero
+  NS_TEST_ASSERT_MSG_EQ (helper->RemoveSignal (s1), true, "Signal should be removed");
+  NS_TEST_ASSERT_MSG_EQ (helper->RemoveSignal (s1), false, "Signal should not be removed twice");
+  NS_TEST_ASSERT_MSG_EQ (helper->GetSignalPsd (0, LORAWAN_SF7), 0.0, "Expected no SF7 signal in band 0");
+  NS_TEST_ASSERT_MSG_EQ (helper->RemoveSignal (s2), true, "Signal should be removed");
+  NS_TEST_ASSERT_MSG_EQ (helper->RemoveSignal (noise), true, "Signal should be removed");
+  NS_TEST_ASSERT_MSG_EQ (helper->GetSignalPsd (0), 0.0, "Expected no signal in band 0");
+  NS_TEST_ASSERT_MSG_EQ (helper->GetSignalPsd (0, LORAWAN_SF9), 0.0, "Expected no SF9 signal in band 0");
+  NS_TEST_ASSERT_MSG_EQ_TOL (helper->GetSignalPsd (1), (*s3)[1], (*s3)[1] * 1e-12, "Band 1 should be unaffected");
+
+  helper->ClearSignals ();
+  NS_TEST_ASSERT_MSG_EQ (helper->GetNSignals (), 0, "Expected no accumulated signals");
+  NS_TEST_ASSERT_MSG_EQ (helper->GetSignalPsd (1), 0.0, "Expected no signal in band 1");
+}
+
+// ==============================================================================
+class LoRaWANInterferenceHelperSharedSignalTestCase : public TestCase
+{
+public:
+  LoRaWANInterferenceHelperSharedSignalTestCase ();
+  virtual ~LoRaWANInterferenceHelperSharedSignalTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANInterferenceHelperSharedSignalTestCase::LoRaWANInterferenceHelperSharedSignalTestCase ()
+  : TestCase ("Test signals that are added as a single received power spectral density")
+{
+}
+
+LoRaWANInterferenceHelperSharedSignalTestCase::~LoRaWANInterferenceHelperSharedSignalTestCase ()
+{
+}
+
+void
+LoRaWANInterferenceHelperSharedSignalTestCase::DoRun (void)
+{
+  LoRaWANSpectrumValueHelper psdHelper;
+  const uint32_t fc0 = LoRaWAN::m_supportedChannels [0].m_fc;
+
+  Ptr<SpectrumValue> s1 = psdHelper.CreateTxPowerSpectralDensity (14, fc0);
+  Ptr<LoRaWANSpectrumSignalParameters> p1 = Create<LoRaWANSpectrumSignalParameters> ();
+  Ptr<LoRaWANSpectrumSignalParameters> p2 = Create<LoRaWANSpectrumSignalParameters> ();
+  const double psd1 = 1e-15;
+  const double psd2 = 3e-15;
+
+  // Signals identified by their parameters and SpectrumValues can be mixed
+  Ptr<LoRaWANInterferenceHelper> helper = Create<LoRaWANInterferenceHelper> (s1->GetSpectrumModel ());
+  NS_TEST_ASSERT_MSG_EQ (helper->AddSignal (PeekPointer (p1), 0, psd1, LORAWAN_SF7), true, "Signal should be added");
+  NS_TEST_ASSERT_MSG_EQ (helper->AddSignal (PeekPointer (p1), 0, psd1, LORAWAN_SF7), false, "Signal should not be added twice");
+  NS_TEST_ASSERT_MSG_EQ (helper->AddSignal (PeekPointer (p2), 0, psd2, LORAWAN_SF9), true, "Signal should be added");
+  NS_TEST_ASSERT_MSG_EQ (helper->AddSignal (s1, LORAWAN_SF7), true, "Signal should be added");
+  NS_TEST_ASSERT_MSG_EQ (helper->GetNSignals (), 3, "Expected three accumulated signals");
+
+  const double sum = psd1 + psd2 + (*s1)[0];
+  NS_TEST_ASSERT_MSG_EQ_TOL (helper->GetSignalPsd (0), sum, sum * 1e-12, "Wrong sum in band 0");
+  NS_TEST_ASSERT_MSG_EQ_TOL (helper->GetSignalPsd (0, LORAWAN_SF7), psd1 + (*s1)[0], sum * 1e-12, "Wrong SF7 sum in band 0");
+  NS_TEST_ASSERT_MSG_EQ_TOL (helper->GetSignalPsd (0, LORAWAN_SF9), psd2, sum * 1e-12, "Wrong SF9 sum in band 0");
+  NS_TEST_ASSERT_MSG_EQ (helper->GetSignalPsd (1), 0.0, "Expected no signal in band 1");
+
+  NS_TEST_ASSERT_MSG_EQ (helper->RemoveSignal (PeekPointer (p1)), true, "Signal should be removed");
+  NS_TEST_ASSERT_MSG_EQ (helper->RemoveSignal (PeekPointer (p1)), false, "Signal should not be removed twice");
+  NS_TEST_ASSERT_MSG_EQ_TOL (helper->GetSignalPsd (0, LORAWAN_SF7), (*s1)[0], sum * 1e-12, "Wrong SF7 sum in band 0");
+  NS_TEST_ASSERT_MSG_EQ (helper->RemoveSignal (s1), true, "Signal should be removed");
+  NS_TEST_ASSERT_MSG_EQ (helper->RemoveSignal (PeekPointer (p2)), true, "Signal should be removed");
+  NS_TEST_ASSERT_MSG_EQ (helper->GetSignalPsd (0), 0.0, "Expected no signal in band 0");
+  NS_TEST_ASSERT_MSG_EQ (helper->GetNSignals (), 0, "Expected no accumulated signals");
+}
+
+// ==============================================================================
+class LoRaWANInterferenceHelperTestSuite : public TestSuite
+{
+public:
+  LoRaWANInterferenceHelperTestSuite ();
+};
+
+LoRaWANInterferenceHelperTestSuite::LoRaWANInterferenceHelperTestSuite ()
+  : TestSuite ("lorawan-interference-helper", UNIT)
+{
+  AddTestCase (new LoRaWANInterferenceHelperTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANInterferenceHelperSharedSignalTestCase, TestCase::QUICK);
+}
+
+static LoRaWANInterferenceHelperTestSuite lorawanInterferenceHelperTestSuite;
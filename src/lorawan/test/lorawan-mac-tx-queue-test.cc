@@ -0,0 +1,198 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include <ns3/log.h>
+#include <ns3/test.h>
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/lorawan-module.h>
+#include "ns3/rng-seed-manager.h"
+#include "lorawan-test-utils.h"
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-mac-tx-queue-test");
+
+class LoRaWANRingQueueTestCase : public TestCase
+{
+public:
+  LoRaWANRingQueueTestCase ();
+  virtual ~LoRaWANRingQueueTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANRingQueueTestCase::LoRaWANRingQueueTestCase ()
+  : TestCase ("Test the ring queue of the MAC TX queue")
+{
+}
+
+LoRaWANRingQueueTestCase::~LoRaWANRingQueueTestCase ()
+{
+}
+
+void
+LoRaWANRingQueueTestCase::DoRun (void)
+{
+  // The ring wraps around before it grows, and keeps the FIFO order when
+  // it grows
+  LoRaWANRingQueue<uint32_t> queue;
+  for (uint32_t k = 0; k < 3; k++)
+    queue.PushBack () = k;
+  queue.PopFront ();
+  queue.PopFront ();
+  for (uint32_t k = 3; k < 6; k++)
+    queue.PushBack () = k;
+  NS_TEST_ASSERT_MSG_EQ (queue.GetCapacity (), 4, "The ring should wrap around instead of growing");
+  NS_TEST_ASSERT_MSG_EQ (queue.GetSize (), 4, "Wrong queue size");
+  queue.PushBack () = 6;
+  NS_TEST_ASSERT_MSG_EQ (queue.GetCapacity (), 8, "A full ring should double");
+  for (uint32_t k = 2; k < 7; k++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (queue.Front (), k, "Wrong first element");
+      queue.PopFront ();
+    }
+  NS_TEST_ASSERT_MSG_EQ (queue.IsEmpty (), true, "The queue should be empty");
+  NS_TEST_ASSERT_MSG_EQ (queue.GetPeakSize (), 5, "Wrong peak queue size");
+
+  // A popped slot releases its packet
+  LoRaWANRingQueue<Ptr<Packet> > packets;
+  Ptr<Packet> p = Create<Packet> (10);
+  packets.PushBack () = p;
+  NS_TEST_ASSERT_MSG_EQ (p->GetReferenceCount (), 2, "The queue should hold a reference");
+  packets.PopFront ();
+  NS_TEST_ASSERT_MSG_EQ (p->GetReferenceCount (), 1, "The popped slot should release the packet");
+}
+
+class LoRaWANMacTxQueueTestCase : public TestCase
+{
+public:
+  LoRaWANMacTxQueueTestCase ();
+  virtual ~LoRaWANMacTxQueueTestCase ();
+
+private:
+  static void MacTxDrop (std::vector<uint32_t> *dropped, Ptr<const Packet> p);
+  static void SendMACPayload (Ptr<LoRaWANMac> mac, Ptr<Packet> p);
+  void RunScenario (LoRaWANQueueDropPolicy policy);
+  virtual void DoRun (void);
+};
+
+LoRaWANMacTxQueueTestCase::LoRaWANMacTxQueueTestCase ()
+  : TestCase ("Test the depth statistics and drop policies of the MAC TX queue")
+{
+}
+
+LoRaWANMacTxQueueTestCase::~LoRaWANMacTxQueueTestCase ()
+{
+}
+
+void
+LoRaWANMacTxQueueTestCase::MacTxDrop (std::vector<uint32_t> *dropped, Ptr<const Packet> p)
+{
+  dropped->push_back (p->GetUid ());
+}
+
+void
+LoRaWANMacTxQueueTestCase::SendMACPayload (Ptr<LoRaWANMac> mac, Ptr<Packet> p)
+{
+  LoRaWANDataRequestParams params;
+  params.m_loraWANChannelIndex = 0;
+  params.m_loraWANDataRateIndex = 0;
+  params.m_loraWANCodeRate = 3;
+  params.m_msgType = LORAWAN_UNCONFIRMED_DATA_UP;
+  params.m_requestHandle = p->GetUid ();
+  params.m_numberOfTransmissions = 1;
+  mac->sendMACPayloadRequest (params, p);
+}
+
+void
+LoRaWANMacTxQueueTestCase::RunScenario (LoRaWANQueueDropPolicy policy)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  NodeContainer endDeviceNodes;
+  endDeviceNodes.Create (1);
+
+  MobilityHelper mobility;
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (endDeviceNodes);
+
+  LoRaWANHelper lorawanHelper;
+  lorawanHelper.SetNbRep (1);
+  NetDeviceContainer endDevices = lorawanHelper.Install (endDeviceNodes);
+  Ptr<LoRaWANMac> mac = DynamicCast<LoRaWANNetDevice> (endDevices.Get (0))->GetMac ();
+  mac->SetAttribute ("MaxTxQueueSize", UintegerValue (2));
+  mac->SetAttribute ("TxQueueDropPolicy", EnumValue (policy));
+
+  std::vector<uint32_t> dropped;
+  uint32_t maxQueueSize = 0;
+  mac->TraceConnectWithoutContext ("MacTxDrop", MakeBoundCallback (&LoRaWANMacTxQueueTestCase::MacTxDrop, &dropped));
+  mac->TraceConnectWithoutContext ("TxQueueSize", MakeBoundCallback (&LoRaWANTestUtils::MaxChanged, &maxQueueSize));
+
+  // The first packet is sent right away at SF12 and keeps the sub band
+  // busy for two minutes, so that the next packets stay queued
+  std::vector<Ptr<Packet> > packets;
+  for (uint32_t k = 0; k < 4; k++)
+    packets.push_back (Create<Packet> (10));
+  Simulator::Schedule (Seconds (1.0), &LoRaWANMacTxQueueTestCase::SendMACPayload, mac, packets[0]);
+  for (uint32_t k = 1; k < 4; k++)
+    Simulator::Schedule (Seconds (10.0), &LoRaWANMacTxQueueTestCase::SendMACPayload, mac, packets[k]);
+
+  Simulator::Stop (Seconds (11.0));
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (mac->GetTxQueueDrops (), 1, "One packet should be dropped from the full TX queue");
+  NS_TEST_ASSERT_MSG_EQ (mac->GetTxQueueSize (), 2, "The TX queue should be full");
+  NS_TEST_ASSERT_MSG_EQ (mac->GetTxQueuePeakSize (), 2, "The TX queue should not exceed its maximum size");
+  NS_TEST_ASSERT_MSG_EQ (maxQueueSize, 2, "The TxQueueSize trace should report the queue size");
+  NS_TEST_ASSERT_MSG_EQ (dropped.size (), 1, "The dropped packet should be traced");
+  if (dropped.size () == 1)
+    {
+      uint32_t expected = policy == LORAWAN_QUEUE_DROP_HEAD ? packets[1]->GetUid () : packets[3]->GetUid ();
+      NS_TEST_ASSERT_MSG_EQ (dropped[0], expected, "The wrong packet was dropped");
+    }
+
+  Simulator::Destroy ();
+}
+
+void
+LoRaWANMacTxQueueTestCase::DoRun (void)
+{
+  RunScenario (LORAWAN_QUEUE_DROP_TAIL);
+  RunScenario (LORAWAN_QUEUE_DROP_HEAD);
+}
+
+class LoRaWANMacTxQueueTestSuite : public TestSuite
+{
+public:
+  LoRaWANMacTxQueueTestSuite ();
+};
+
+LoRaWANMacTxQueueTestSuite::LoRaWANMacTxQueueTestSuite ()
+  : TestSuite ("lorawan-mac-tx-queue", UNIT)
+{
+  AddTestCase (new LoRaWANRingQueueTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANMacTxQueueTestCase, TestCase::QUICK);
+}
+
+static LoRaWANMacTxQueueTestSuite lorawanMacTxQueueTestSuite;
@@ -0,0 +1,1511 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include <ns3/log.h>
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/lorawan-module.h>
+#include <ns3/propagation-loss-model.h>
+#include <ns3/simulator.h>
+#include "ns3/rng-seed-manager.h"
+#include "lorawan-test-utils.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-network-server-test");
+
+// Create gateways that are connected to the network server. Test cases that
+// use these gateways pass the US packets of their end devices to the
+// network server directly.
+static ApplicationContainer
+CreateGateways (const LoRaWANNetworkServerHelper &nsHelper, Ptr<LoRaWANNetworkServer> networkServer, uint32_t nGateways)
+{
+  NodeContainer gatewayNodes;
+  gatewayNodes.Create (nGateways);
+
+  MobilityHelper mobility;
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (gatewayNodes);
+
+  LoRaWANHelper lorawanHelper;
+  lorawanHelper.SetDeviceType (LORAWAN_DT_GATEWAY);
+  lorawanHelper.Install (gatewayNodes);
+
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (gatewayNodes);
+
+  return nsHelper.InstallGateways (networkServer, gatewayNodes);
+}
+
+// Create a US data packet with the tags that a gateway adds before it
+// passes the packet to the network server
+static Ptr<Packet>
+CreateUSPacket (const LoRaWANFrameHeader &fhdr, LoRaWANMsgType msgType, uint8_t channelIndex, uint8_t dataRateIndex, double snr)
+{
+  Ptr<Packet> packet = Create<Packet> (8);
+  packet->AddHeader (fhdr);
+
+  LoRaWANPhyParamsTag phyParamsTag;
+  phyParamsTag.SetChannelIndex (channelIndex);
+  phyParamsTag.SetDataRateIndex (dataRateIndex);
+  phyParamsTag.SetCodeRate (1);
+  packet->AddPacketTag (phyParamsTag);
+
+  LoRaWANMsgTypeTag msgTypeTag;
+  msgTypeTag.SetMsgType (msgType);
+  packet->AddPacketTag (msgTypeTag);
+
+  LoRaWANRxMetadataTag rxMetadataTag;
+  rxMetadataTag.SetSnr (snr);
+  packet->AddPacketTag (rxMetadataTag);
+
+  return packet;
+}
+
+// Pass a JoinRequest to the network server, with the MIC computed with
+// appKey, or without a MIC if appKey is 0
+static void
+ReceiveJoinRequest (Ptr<LoRaWANNetworkServer> networkServer, Ptr<LoRaWANGatewayApplication> gateway,
+                    uint64_t devEui, uint16_t devNonce, const LoRaWANKey *appKey)
+{
+  Ptr<Packet> packet = Create<Packet> (0);
+
+  LoRaWANJoinRequestHeader joinRequest (0, devEui, devNonce);
+  packet->AddHeader (joinRequest);
+
+  // The MIC is computed over the MHDR and the JoinRequest, as the MAC of an
+  // end device does
+  if (appKey) {
+    uint8_t frame[1 + 18];
+    NS_ASSERT (packet->GetSize () + 1 == sizeof (frame));
+    frame[0] = LORAWAN_JOIN_REQUEST << 5;
+    packet->CopyData (frame + 1, sizeof (frame) - 1);
+    packet->AddPacketTag (LoRaWANMicTag (LoRaWANCrypto::ComputeJoinMic (*appKey, frame, sizeof (frame))));
+  }
+
+  LoRaWANPhyParamsTag phyParamsTag;
+  phyParamsTag.SetChannelIndex (0);
+  phyParamsTag.SetDataRateIndex (5);
+  phyParamsTag.SetCodeRate (3);
+  packet->AddPacketTag (phyParamsTag);
+
+  LoRaWANMsgTypeTag msgTypeTag;
+  msgTypeTag.SetMsgType (LORAWAN_JOIN_REQUEST);
+  packet->AddPacketTag (msgTypeTag);
+
+  networkServer->HandleUSPacket (gateway, Address (), packet);
+}
+
+class LoRaWANNetworkServerGatewaySelectionTestCase : public TestCase
+{
+public:
+  LoRaWANNetworkServerGatewaySelectionTestCase ();
+  virtual ~LoRaWANNetworkServerGatewaySelectionTestCase ();
+
+private:
+  static void CheckRxMetadata (double *snr, Ptr<const Packet> p);
+  void RunScenario (bool selectBestGateway, uint32_t nTx[2], double snr[2]);
+  virtual void DoRun (void);
+};
+
+LoRaWANNetworkServerGatewaySelectionTestCase::LoRaWANNetworkServerGatewaySelectionTestCase ()
+  : TestCase ("Test that the network server sends a DS packet via the gateway with the best link margin")
+{
+}
+
+LoRaWANNetworkServerGatewaySelectionTestCase::~LoRaWANNetworkServerGatewaySelectionTestCase ()
+{
+}
+
+void
+LoRaWANNetworkServerGatewaySelectionTestCase::CheckRxMetadata (double *snr, Ptr<const Packet> p)
+{
+  LoRaWANRxMetadataTag tag;
+  if (p->PeekPacketTag (tag))
+    *snr = tag.GetSnr ();
+}
+
+void
+LoRaWANNetworkServerGatewaySelectionTestCase::RunScenario (bool selectBestGateway, uint32_t nTx[2], double snr[2])
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (6);
+
+  // Without a propagation delay model, both gateways receive the US packet at
+  // the same time and the network server sees the far gateway first
+  Ptr<LoRaWANSpectrumChannel> channel = CreateObject<LoRaWANSpectrumChannel> ();
+  channel->AddPropagationLossModel (CreateObject<LogDistancePropagationLossModel> ());
+
+  NodeContainer endDeviceNodes;
+  NodeContainer gatewayNodes;
+  endDeviceNodes.Create (1);
+  gatewayNodes.Create (2);
+
+  Ptr<ListPositionAllocator> positions = CreateObject<ListPositionAllocator> ();
+  positions->Add (Vector (0.0, 0.0, 0.0));
+  positions->Add (Vector (1000.0, 0.0, 0.0)); // far gateway
+  positions->Add (Vector (50.0, 0.0, 0.0)); // near gateway
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator (positions);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (endDeviceNodes);
+  mobility.Install (gatewayNodes);
+
+  LoRaWANHelper lorawanHelper;
+  lorawanHelper.SetChannel (channel);
+  lorawanHelper.SetNbRep (1);
+  NetDeviceContainer endDevices = lorawanHelper.Install (endDeviceNodes);
+  lorawanHelper.SetDeviceType (LORAWAN_DT_GATEWAY);
+  NetDeviceContainer gateways = lorawanHelper.Install (gatewayNodes);
+
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (endDeviceNodes);
+  packetSocket.Install (gatewayNodes);
+
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      Ptr<LoRaWANGatewayApplication> app = CreateObject<LoRaWANGatewayApplication> ();
+      app->TraceConnectWithoutContext ("Tx", MakeBoundCallback (&LoRaWANTestUtils::CountPacket, &nTx[i]));
+      gatewayNodes.Get (i)->AddApplication (app);
+      app->SetStartTime (Seconds (0.0));
+      app->SetStopTime (Seconds (10.0));
+
+      Ptr<LoRaWANNetDevice> gw = DynamicCast<LoRaWANNetDevice> (gateways.Get (i));
+      for (auto &mac : gw->GetMacs ())
+        mac->TraceConnectWithoutContext ("MacRx", MakeBoundCallback (&LoRaWANNetworkServerGatewaySelectionTestCase::CheckRxMetadata, &snr[i]));
+    }
+
+  Ptr<LoRaWANNetworkServer> lorawanNSPtr = LoRaWANNetworkServer::getLoRaWANNetworkServerPointer ();
+  lorawanNSPtr->SetAttribute ("SelectBestGateway", BooleanValue (selectBestGateway));
+
+  // A single confirmed US packet, which the network server acknowledges in RW1
+  Ptr<LoRaWANEndDeviceApplication> edApp = CreateObject<LoRaWANEndDeviceApplication> ();
+  edApp->SetAttribute ("ConfirmedDataUp", BooleanValue (true));
+  edApp->SetAttribute ("ChannelRandomVariable", StringValue ("ns3::ConstantRandomVariable[Constant=0.0]"));
+  edApp->SetAttribute ("UpstreamIAT", StringValue ("ns3::ConstantRandomVariable[Constant=100.0]"));
+  endDeviceNodes.Get (0)->AddApplication (edApp);
+  edApp->SetStartTime (Seconds (1.0));
+  edApp->SetStopTime (Seconds (10.0));
+
+  Simulator::Stop (Seconds (10.0));
+  Simulator::Run ();
+  Simulator::Destroy ();
+}
+
+void
+LoRaWANNetworkServerGatewaySelectionTestCase::DoRun (void)
+{
+  uint32_t nTx[2] = {0, 0};
+  double snr[2] = {0.0, 0.0};
+  RunScenario (false, nTx, snr);
+  NS_TEST_ASSERT_MSG_EQ (nTx[0], 1, "The first gateway that received the US packet should send the DS packet");
+  NS_TEST_ASSERT_MSG_EQ (nTx[1], 0, "The second gateway should not send a DS packet");
+
+  nTx[0] = nTx[1] = 0;
+  RunScenario (true, nTx, snr);
+  NS_TEST_ASSERT_MSG_GT (snr[1], snr[0], "The near gateway should report a higher SNR");
+  NS_TEST_ASSERT_MSG_EQ (nTx[0], 0, "The far gateway should not send a DS packet");
+  NS_TEST_ASSERT_MSG_EQ (nTx[1], 1, "The gateway with the best link margin should send the DS packet");
+}
+
+class LoRaWANAdrHistoryTestCase : public TestCase
+{
+public:
+  LoRaWANAdrHistoryTestCase ();
+  virtual ~LoRaWANAdrHistoryTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANAdrHistoryTestCase::LoRaWANAdrHistoryTestCase ()
+  : TestCase ("Test the ADR SNR history and link margin calculation")
+{
+}
+
+LoRaWANAdrHistoryTestCase::~LoRaWANAdrHistoryTestCase ()
+{
+}
+
+void
+LoRaWANAdrHistoryTestCase::DoRun (void)
+{
+  LoRaWANAdrHistory history;
+  NS_TEST_ASSERT_MSG_EQ (history.IsFull (), false, "A history without capacity is never full");
+
+  history.SetCapacity (3);
+  history.Add (1.0);
+  history.Add (5.0);
+  NS_TEST_ASSERT_MSG_EQ (history.IsFull (), false, "The history should not be full after 2 samples");
+  history.Add (2.0);
+  NS_TEST_ASSERT_MSG_EQ (history.IsFull (), true, "The history should be full after 3 samples");
+  NS_TEST_ASSERT_MSG_EQ (history.GetMaxSnr (), 5.0, "Wrong maximum SNR");
+  history.Add (0.0); // {5, 2, 0}
+  NS_TEST_ASSERT_MSG_EQ (history.GetMaxSnr (), 5.0, "Wrong maximum SNR");
+  history.Add (-1.0); // {2, 0, -1}
+  NS_TEST_ASSERT_MSG_EQ (history.GetMaxSnr (), 2.0, "The oldest sample should have been dropped");
+  history.UpdateLast (-3.0);
+  NS_TEST_ASSERT_MSG_EQ (history.GetMaxSnr (), 2.0, "A lower SNR should not update the last sample");
+  history.UpdateLast (7.0); // {2, 0, 7}
+  NS_TEST_ASSERT_MSG_EQ (history.GetMaxSnr (), 7.0, "The last sample should have been updated");
+  history.Add (1.0); // {0, 7, 1}
+  history.Add (1.0); // {7, 1, 1}
+  NS_TEST_ASSERT_MSG_EQ (history.GetMaxSnr (), 7.0, "Wrong maximum SNR");
+  history.Add (1.0); // {1, 1, 1}
+  NS_TEST_ASSERT_MSG_EQ (history.GetMaxSnr (), 1.0, "Wrong maximum SNR");
+  NS_TEST_ASSERT_MSG_EQ (history.GetSize (), 3, "The history should hold capacity samples");
+  history.Clear ();
+  NS_TEST_ASSERT_MSG_EQ (history.GetSize (), 0, "The history should be empty");
+
+  // 30 dB above the SF12 floor (-20 dB) and a 10 dB installation margin
+  // leaves 6 steps of 3 dB: DR0 -> DR5 and one step of TX power
+  uint8_t dataRateIndex = 0;
+  uint8_t txPowerIndex = 0;
+  bool changed = LoRaWANAdr::GetLinkAdrSettings (10.0, 10.0, dataRateIndex, txPowerIndex);
+  NS_TEST_ASSERT_MSG_EQ (changed, true, "The settings should change");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)dataRateIndex, 5, "Wrong data rate index");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)txPowerIndex, 1, "Wrong TX power index");
+
+  // A negative margin only increases the TX power
+  txPowerIndex = 3;
+  changed = LoRaWANAdr::GetLinkAdrSettings (-25.0, 10.0, dataRateIndex, txPowerIndex);
+  NS_TEST_ASSERT_MSG_EQ (changed, true, "The settings should change");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)dataRateIndex, 5, "The data rate should not decrease");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)txPowerIndex, 0, "Wrong TX power index");
+
+  changed = LoRaWANAdr::GetLinkAdrSettings (2.5, 10.0, dataRateIndex, txPowerIndex);
+  NS_TEST_ASSERT_MSG_EQ (changed, false, "A margin below 3 dB should not change the settings");
+}
+
+class LoRaWANNetworkServerAdrTestCase : public TestCase
+{
+public:
+  LoRaWANNetworkServerAdrTestCase ();
+  virtual ~LoRaWANNetworkServerAdrTestCase ();
+
+private:
+  static void PhyTxBegin (Ptr<LoRaWANPhy> phy, uint32_t *nReducedPowerTx, Ptr<const Packet> packet);
+  void RunScenario (bool adr, uint32_t *nRequests, uint32_t *dataRateIndex, uint32_t *txPowerIndex, uint32_t *nReducedPowerTx);
+  virtual void DoRun (void);
+};
+
+LoRaWANNetworkServerAdrTestCase::LoRaWANNetworkServerAdrTestCase ()
+  : TestCase ("Test that the network server changes the data rate and TX power of an end device with ADR")
+{
+}
+
+LoRaWANNetworkServerAdrTestCase::~LoRaWANNetworkServerAdrTestCase ()
+{
+}
+
+void
+LoRaWANNetworkServerAdrTestCase::PhyTxBegin (Ptr<LoRaWANPhy> phy, uint32_t *nReducedPowerTx, Ptr<const Packet> packet)
+{
+  // The US channels are in 14 dBm sub bands
+  if (phy->GetTxPower () < 14)
+    (*nReducedPowerTx)++;
+}
+
+void
+LoRaWANNetworkServerAdrTestCase::RunScenario (bool adr, uint32_t *nRequests, uint32_t *dataRateIndex, uint32_t *txPowerIndex, uint32_t *nReducedPowerTx)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (7);
+
+  NodeContainer endDeviceNodes;
+  NodeContainer gatewayNodes;
+  endDeviceNodes.Create (1);
+  gatewayNodes.Create (1);
+
+  Ptr<ListPositionAllocator> positions = CreateObject<ListPositionAllocator> ();
+  positions->Add (Vector (0.0, 0.0, 0.0));
+  positions->Add (Vector (50.0, 0.0, 0.0));
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator (positions);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (endDeviceNodes);
+  mobility.Install (gatewayNodes);
+
+  LoRaWANHelper lorawanHelper;
+  lorawanHelper.SetNbRep (1);
+  NetDeviceContainer endDevices = lorawanHelper.Install (endDeviceNodes);
+  lorawanHelper.SetDeviceType (LORAWAN_DT_GATEWAY);
+  lorawanHelper.Install (gatewayNodes);
+
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (endDeviceNodes);
+  packetSocket.Install (gatewayNodes);
+
+  Ptr<LoRaWANGatewayApplication> gwApp = CreateObject<LoRaWANGatewayApplication> ();
+  gatewayNodes.Get (0)->AddApplication (gwApp);
+  gwApp->SetStartTime (Seconds (0.0));
+  gwApp->SetStopTime (Seconds (1500.0));
+
+  Ptr<LoRaWANNetworkServer> lorawanNSPtr = LoRaWANNetworkServer::getLoRaWANNetworkServerPointer ();
+  lorawanNSPtr->SetAttribute ("AdrHistoryLength", UintegerValue (4));
+  lorawanNSPtr->TraceConnectWithoutContext ("nrAdrRequestsSent", MakeBoundCallback (&LoRaWANTestUtils::CounterChanged, nRequests));
+
+  // Unconfirmed US packets at SF12 from an end device close to the gateway.
+  // The duty cycle limits the end device to one US packet every 160 seconds,
+  // a longer interval keeps stale US packets out of the MAC TX queue, so that
+  // the LinkADRAns is sent in the first US packet after the LinkADRReq.
+  Ptr<LoRaWANEndDeviceApplication> edApp = CreateObject<LoRaWANEndDeviceApplication> ();
+  edApp->SetAttribute ("ADR", BooleanValue (adr));
+  edApp->SetAttribute ("UpstreamIAT", StringValue ("ns3::ConstantRandomVariable[Constant=200.0]"));
+  endDeviceNodes.Get (0)->AddApplication (edApp);
+  edApp->SetStartTime (Seconds (1.0));
+  edApp->SetStopTime (Seconds (1500.0));
+
+  Ptr<LoRaWANPhy> phy = DynamicCast<LoRaWANNetDevice> (endDevices.Get (0))->GetPhy ();
+  phy->TraceConnectWithoutContext ("PhyTxBegin", MakeBoundCallback (&LoRaWANNetworkServerAdrTestCase::PhyTxBegin, phy, nReducedPowerTx));
+
+  Simulator::Stop (Seconds (1500.0));
+  Simulator::Run ();
+
+  *dataRateIndex = edApp->GetDataRateIndex ();
+  *txPowerIndex = DynamicCast<LoRaWANNetDevice> (endDevices.Get (0))->GetMac ()->GetTxPowerIndex ();
+
+  Simulator::Destroy ();
+}
+
+void
+LoRaWANNetworkServerAdrTestCase::DoRun (void)
+{
+  uint32_t nRequests = 0;
+  uint32_t dataRateIndex = 0;
+  uint32_t txPowerIndex = 0;
+  uint32_t nReducedPowerTx = 0;
+  RunScenario (false, &nRequests, &dataRateIndex, &txPowerIndex, &nReducedPowerTx);
+  NS_TEST_ASSERT_MSG_EQ (nRequests, 0, "No LinkADRReq should be sent without the ADR bit");
+  NS_TEST_ASSERT_MSG_EQ (dataRateIndex, 0, "The data rate should not change without the ADR bit");
+  NS_TEST_ASSERT_MSG_EQ (txPowerIndex, 0, "The TX power should not change without the ADR bit");
+  NS_TEST_ASSERT_MSG_EQ (nReducedPowerTx, 0, "The end device should send at the maximum TX power without the ADR bit");
+
+  nRequests = 0;
+  RunScenario (true, &nRequests, &dataRateIndex, &txPowerIndex, &nReducedPowerTx);
+  const LoRaWANRegionProfile &profile = LoRaWAN::GetRegionProfile (LoRaWAN::GetRegion ());
+  NS_TEST_ASSERT_MSG_EQ (nRequests, 1, "A single LinkADRReq should be sent");
+  NS_TEST_ASSERT_MSG_EQ (dataRateIndex, (uint32_t)profile.m_maxAdrDataRateIndex, "The end device should use the highest data rate");
+  NS_TEST_ASSERT_MSG_EQ (txPowerIndex, (uint32_t)profile.m_maxTxPowerIndex, "The end device should use the lowest TX power");
+  NS_TEST_ASSERT_MSG_GT (nReducedPowerTx, 1, "The end device should keep sending US packets at the TX power of the LinkADRReq");
+}
+
+class LoRaWANNetworkServerLinkAdrAnsTestCase : public TestCase
+{
+public:
+  LoRaWANNetworkServerLinkAdrAnsTestCase ();
+  virtual ~LoRaWANNetworkServerLinkAdrAnsTestCase ();
+
+private:
+  /**
+   * Pass an unconfirmed US packet with the ADR bit to the network server.
+   * The packet carries a LinkADRAns with linkAdrStatus, or no LinkADRAns if
+   * linkAdrStatus is negative.
+   */
+  void ReceiveUSPacket (uint16_t frameCounter, int32_t linkAdrStatus);
+  void CheckAnswer (void);
+  void RunScenario (int32_t linkAdrStatus);
+  virtual void DoRun (void);
+
+  Ptr<LoRaWANNetworkServer> m_networkServer;
+  Ptr<LoRaWANGatewayApplication> m_gateway;
+  uint32_t m_nRequests; //!< LinkADRReqs sent by the network server
+  uint32_t m_nRequestsAtAnswer; //!< LinkADRReqs sent before the US packet with the answer was handled
+  uint8_t m_txPowerIndex; //!< TX power index of the end device in the network server after the answer
+  uint8_t m_requestedTxPowerIndex; //!< TX power index of the LinkADRReq
+};
+
+static const uint32_t g_adrDeviceAddr = 1001;
+
+LoRaWANNetworkServerLinkAdrAnsTestCase::LoRaWANNetworkServerLinkAdrAnsTestCase ()
+  : TestCase ("Test that the network server only applies the TX power of a LinkADRReq that the end device acks")
+{
+}
+
+LoRaWANNetworkServerLinkAdrAnsTestCase::~LoRaWANNetworkServerLinkAdrAnsTestCase ()
+{
+}
+
+void
+LoRaWANNetworkServerLinkAdrAnsTestCase::ReceiveUSPacket (uint16_t frameCounter, int32_t linkAdrStatus)
+{
+  LoRaWANFrameHeader fhdr;
+  fhdr.setDevAddr (Ipv4Address (g_adrDeviceAddr));
+  fhdr.setAdr (true);
+  fhdr.setFrameCounter (frameCounter);
+  fhdr.setFramePort (1);
+  if (linkAdrStatus >= 0) {
+    const uint8_t frameOptions[] = {LORAWAN_CID_LINK_ADR, static_cast<uint8_t> (linkAdrStatus)};
+    fhdr.setFrameOptions (frameOptions, sizeof (frameOptions));
+  }
+
+  // A close end device at SF12, the network server requests a higher data
+  // rate and a lower TX power
+  m_networkServer->HandleUSPacket (m_gateway, Address (), CreateUSPacket (fhdr, LORAWAN_UNCONFIRMED_DATA_UP, 0, 0, 10.0));
+}
+
+void
+LoRaWANNetworkServerLinkAdrAnsTestCase::CheckAnswer (void)
+{
+  const LoRaWANEndDeviceTableNS &endDevices = m_networkServer->GetEndDevices ();
+  const LoRaWANEndDeviceInfoNS &info = endDevices.m_info[endDevices.Find (g_adrDeviceAddr)];
+  m_nRequestsAtAnswer = m_nRequests;
+  m_txPowerIndex = info.m_txPowerIndex;
+  m_requestedTxPowerIndex = info.m_adrTxPowerIndex;
+}
+
+void
+LoRaWANNetworkServerLinkAdrAnsTestCase::RunScenario (int32_t linkAdrStatus)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  // The end device only exists in the network server
+  LoRaWANNetworkServerHelper nsHelper;
+  nsHelper.SetAttribute ("AdrHistoryLength", UintegerValue (4));
+  m_networkServer = nsHelper.Create ();
+  m_networkServer->AddHomeEndDevice (Ipv4Address (g_adrDeviceAddr));
+  ApplicationContainer apps = CreateGateways (nsHelper, m_networkServer, 1);
+  m_gateway = DynamicCast<LoRaWANGatewayApplication> (apps.Get (0));
+  apps.Start (Seconds (0.0));
+  apps.Stop (Seconds (2000.0));
+
+  m_nRequests = 0;
+  m_networkServer->TraceConnectWithoutContext ("nrAdrRequestsSent", MakeBoundCallback (&LoRaWANTestUtils::CounterChanged, &m_nRequests));
+
+  // The fourth US packet fills the SNR history and is answered with a
+  // LinkADRReq, the fifth US packet carries the LinkADRAns. The US packets
+  // are far enough apart for the duty cycle of the gateway.
+  for (uint16_t k = 0; k < 9; k++)
+    Simulator::Schedule (Seconds (1.0 + 200.0 * k), &LoRaWANNetworkServerLinkAdrAnsTestCase::ReceiveUSPacket, this, k + 1, k == 4 ? linkAdrStatus : -1);
+  Simulator::Schedule (Seconds (1.0 + 200.0 * 4 + 0.5), &LoRaWANNetworkServerLinkAdrAnsTestCase::CheckAnswer, this);
+
+  Simulator::Stop (Seconds (2000.0));
+  Simulator::Run ();
+
+  m_gateway = 0;
+  m_networkServer = 0;
+  Simulator::Destroy ();
+}
+
+void
+LoRaWANNetworkServerLinkAdrAnsTestCase::DoRun (void)
+{
+  // The end device acks the data rate, channel mask and TX power
+  RunScenario (0x07);
+  NS_TEST_ASSERT_MSG_EQ (m_nRequestsAtAnswer, 1, "A LinkADRReq should be sent after the SNR history is full");
+  NS_TEST_ASSERT_MSG_GT ((uint32_t)m_requestedTxPowerIndex, 0, "The LinkADRReq should lower the TX power");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)m_txPowerIndex, (uint32_t)m_requestedTxPowerIndex, "The network server should apply the acked TX power");
+
+  // The end device NACKs the TX power: the network server keeps the old TX
+  // power and sends the LinkADRReq again once the SNR history is full again
+  RunScenario (0x03);
+  NS_TEST_ASSERT_MSG_EQ (m_nRequestsAtAnswer, 1, "A LinkADRReq should be sent after the SNR history is full");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)m_txPowerIndex, 0, "The network server should keep the TX power after a NACK");
+  NS_TEST_ASSERT_MSG_EQ (m_nRequests, 2, "The LinkADRReq should be sent again after the SNR history is refilled");
+
+  // The LinkADRReq or its answer is lost: the network server keeps the old
+  // TX power and sends the LinkADRReq again right away
+  RunScenario (-1);
+  NS_TEST_ASSERT_MSG_EQ (m_nRequestsAtAnswer, 1, "A LinkADRReq should be sent after the SNR history is full");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)m_txPowerIndex, 0, "The network server should keep the TX power without a LinkADRAns");
+  NS_TEST_ASSERT_MSG_GT (m_nRequests, 2, "The LinkADRReq should be sent again after every US packet without a LinkADRAns");
+}
+
+class LoRaWANEndDeviceTableTestCase : public TestCase
+{
+public:
+  LoRaWANEndDeviceTableTestCase ();
+  virtual ~LoRaWANEndDeviceTableTestCase ();
+
+private:
+  static void DSMsgGenerated (uint32_t *nGenerated, uint32_t deviceAddr, uint8_t txRemaining, uint8_t msgType, Ptr<const Packet> p);
+  static void DSMsgTransmitted (uint32_t *nTransmitted, uint32_t deviceAddr, uint8_t txRemaining, uint8_t msgType, Ptr<const Packet> p, uint8_t rw);
+  virtual void DoRun (void);
+};
+
+LoRaWANEndDeviceTableTestCase::LoRaWANEndDeviceTableTestCase ()
+  : TestCase ("Test the end device table and DS queue pool of the network server")
+{
+}
+
+LoRaWANEndDeviceTableTestCase::~LoRaWANEndDeviceTableTestCase ()
+{
+}
+
+void
+LoRaWANEndDeviceTableTestCase::DSMsgGenerated (uint32_t *nGenerated, uint32_t deviceAddr, uint8_t txRemaining, uint8_t msgType, Ptr<const Packet> p)
+{
+  (*nGenerated)++;
+}
+
+void
+LoRaWANEndDeviceTableTestCase::DSMsgTransmitted (uint32_t *nTransmitted, uint32_t deviceAddr, uint8_t txRemaining, uint8_t msgType, Ptr<const Packet> p, uint8_t rw)
+{
+  (*nTransmitted)++;
+}
+
+void
+LoRaWANEndDeviceTableTestCase::DoRun (void)
+{
+  LoRaWANEndDeviceTableNS table;
+  for (uint32_t addr = 1; addr <= 100; addr++)
+    table.Add (Ipv4Address (addr));
+  uint32_t sparseIndex = table.Add (Ipv4Address (0x26011234));
+  NS_TEST_ASSERT_MSG_EQ (table.GetSize (), 101, "Wrong number of end devices");
+  NS_TEST_ASSERT_MSG_EQ (table.Find (1), 0, "Wrong device index");
+  NS_TEST_ASSERT_MSG_EQ (table.Find (100), 99, "Wrong device index");
+  NS_TEST_ASSERT_MSG_EQ (table.Find (0x26011234), sparseIndex, "Wrong device index for a sparse address");
+  NS_TEST_ASSERT_MSG_EQ (table.m_deviceAddress[sparseIndex], 0x26011234, "Wrong device address");
+  NS_TEST_ASSERT_MSG_EQ (table.Find (0), LoRaWANEndDeviceTableNS::m_invalidIndex, "Address 0 is unknown");
+  NS_TEST_ASSERT_MSG_EQ (table.Find (101), LoRaWANEndDeviceTableNS::m_invalidIndex, "Address 101 is unknown");
+
+  // Elements of two queues are interleaved in the pool and reused after
+  // they are popped
+  LoRaWANNSDSQueuePool pool;
+  LoRaWANNSDSQueue queueA;
+  LoRaWANNSDSQueue queueB;
+  pool.Get (pool.PushBack (queueA)).m_downstreamFramePort = 1;
+  pool.Get (pool.PushBack (queueB)).m_downstreamFramePort = 2;
+  pool.Get (pool.PushBack (queueA)).m_downstreamFramePort = 3;
+  NS_TEST_ASSERT_MSG_EQ (queueA.m_size, 2, "Wrong queue size");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)pool.Front (queueA).m_downstreamFramePort, 1, "Wrong first element");
+  pool.PopFront (queueA);
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)pool.Front (queueA).m_downstreamFramePort, 3, "Wrong first element");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)pool.Front (queueB).m_downstreamFramePort, 2, "Wrong first element");
+  pool.PushBack (queueB);
+  NS_TEST_ASSERT_MSG_EQ (pool.GetCapacity (), 3, "A freed element should be reused");
+  NS_TEST_ASSERT_MSG_EQ (pool.GetSize (), 3, "Wrong number of queued elements");
+  NS_TEST_ASSERT_MSG_EQ (pool.GetPeakSize (), 3, "Wrong peak number of queued elements");
+  pool.Clear (queueA);
+  pool.Clear (queueB);
+  NS_TEST_ASSERT_MSG_EQ (queueA.m_size + queueB.m_size, 0, "The queues should be empty");
+  pool.PushBack (queueA);
+  pool.PushBack (queueA);
+  pool.PushBack (queueA);
+  NS_TEST_ASSERT_MSG_EQ (pool.GetCapacity (), 3, "Freed elements should be reused");
+
+  // Confirmed DS traffic for a few end devices goes through the table and the pool
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (8);
+
+  NodeContainer endDeviceNodes;
+  NodeContainer gatewayNodes;
+  endDeviceNodes.Create (4);
+  gatewayNodes.Create (1);
+
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator ("ns3::UniformDiscPositionAllocator", "rho", DoubleValue (500.0));
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (endDeviceNodes);
+  mobility.Install (gatewayNodes);
+
+  LoRaWANHelper lorawanHelper;
+  lorawanHelper.SetNbRep (1);
+  lorawanHelper.Install (endDeviceNodes);
+  lorawanHelper.SetDeviceType (LORAWAN_DT_GATEWAY);
+  lorawanHelper.Install (gatewayNodes);
+
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (endDeviceNodes);
+  packetSocket.Install (gatewayNodes);
+
+  Ptr<LoRaWANNetworkServer> lorawanNSPtr = LoRaWANNetworkServer::getLoRaWANNetworkServerPointer ();
+  lorawanNSPtr->SetAttribute ("GenerateDataDown", BooleanValue (true));
+  lorawanNSPtr->SetAttribute ("ConfirmedDataDown", BooleanValue (true));
+  lorawanNSPtr->SetAttribute ("DownstreamIAT", StringValue ("ns3::ConstantRandomVariable[Constant=100.0]"));
+  uint32_t nGenerated = 0;
+  uint32_t nTransmitted = 0;
+  lorawanNSPtr->TraceConnectWithoutContext ("DSMsgGenerated", MakeBoundCallback (&LoRaWANEndDeviceTableTestCase::DSMsgGenerated, &nGenerated));
+  lorawanNSPtr->TraceConnectWithoutContext ("DSMsgTransmitted", MakeBoundCallback (&LoRaWANEndDeviceTableTestCase::DSMsgTransmitted, &nTransmitted));
+
+  Ptr<LoRaWANGatewayApplication> gwApp = CreateObject<LoRaWANGatewayApplication> ();
+  gatewayNodes.Get (0)->AddApplication (gwApp);
+  gwApp->SetStartTime (Seconds (0.0));
+  gwApp->SetStopTime (Seconds (1000.0));
+
+  for (uint32_t i = 0; i < endDeviceNodes.GetN (); i++)
+    {
+      Ptr<LoRaWANEndDeviceApplication> edApp = CreateObject<LoRaWANEndDeviceApplication> ();
+      edApp->SetAttribute ("DataRateIndex", UintegerValue (5));
+      edApp->SetAttribute ("UpstreamIAT", StringValue ("ns3::ConstantRandomVariable[Constant=60.0]"));
+      endDeviceNodes.Get (i)->AddApplication (edApp);
+      edApp->SetStartTime (Seconds (1.0 + i));
+      edApp->SetStopTime (Seconds (1000.0));
+    }
+
+  Simulator::Stop (Seconds (1000.0));
+  Simulator::Run ();
+
+  const LoRaWANEndDeviceTableNS &endDevices = lorawanNSPtr->GetEndDevices ();
+  NS_TEST_ASSERT_MSG_EQ (endDevices.GetSize (), endDeviceNodes.GetN (), "Every end device should be in the table");
+  uint32_t nGeneratedTable = 0;
+  uint32_t nSentTable = 0;
+  for (uint32_t i = 0; i < endDevices.GetSize (); i++)
+    {
+      nGeneratedTable += endDevices.m_stats[i].m_nDSPacketsGenerated;
+      nSentTable += endDevices.m_stats[i].m_nDSPacketsSent;
+      NS_TEST_ASSERT_MSG_GT (endDevices.m_fCntUp[i], 0, "The NS should have received several US packets of every end device");
+    }
+  NS_TEST_ASSERT_MSG_GT (nGenerated, 0, "DS packets should have been generated");
+  NS_TEST_ASSERT_MSG_GT (nTransmitted, 0, "DS packets should have been transmitted");
+  NS_TEST_ASSERT_MSG_EQ (nGeneratedTable, nGenerated, "The statistics should count all generated DS packets");
+  NS_TEST_ASSERT_MSG_EQ (nSentTable, nTransmitted, "The statistics should count all transmitted DS packets");
+
+  Simulator::Destroy ();
+}
+
+class LoRaWANNetworkServerRoamingTestCase : public TestCase
+{
+public:
+  LoRaWANNetworkServerRoamingTestCase ();
+  virtual ~LoRaWANNetworkServerRoamingTestCase ();
+
+private:
+  static void USMsgReceived (uint32_t *nRx, uint32_t deviceAddr, uint8_t msgType, Ptr<const Packet> p);
+  void RunScenario (bool roaming, uint32_t nGatewayTx[2], uint32_t nUSReceived[2], uint32_t nUSForwarded[2], uint32_t nUSDropped[2]);
+  virtual void DoRun (void);
+};
+
+LoRaWANNetworkServerRoamingTestCase::LoRaWANNetworkServerRoamingTestCase ()
+  : TestCase ("Test that network servers only serve their own end devices and forward US packets to roaming partners")
+{
+}
+
+LoRaWANNetworkServerRoamingTestCase::~LoRaWANNetworkServerRoamingTestCase ()
+{
+}
+
+void
+LoRaWANNetworkServerRoamingTestCase::USMsgReceived (uint32_t *nRx, uint32_t deviceAddr, uint8_t msgType, Ptr<const Packet> p)
+{
+  (*nRx)++;
+}
+
+void
+LoRaWANNetworkServerRoamingTestCase::RunScenario (bool roaming, uint32_t nGatewayTx[2], uint32_t nUSReceived[2], uint32_t nUSForwarded[2], uint32_t nUSDropped[2])
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (9);
+
+  // Two networks share the spectrum. Both end devices are close to the
+  // gateway of network 0, the gateway of network 1 is out of range.
+  NodeContainer endDeviceNodes;
+  NodeContainer gatewayNodes;
+  endDeviceNodes.Create (2);
+  gatewayNodes.Create (2);
+
+  Ptr<ListPositionAllocator> positions = CreateObject<ListPositionAllocator> ();
+  positions->Add (Vector (0.0, 0.0, 0.0));
+  positions->Add (Vector (100.0, 0.0, 0.0));
+  positions->Add (Vector (50.0, 0.0, 0.0));
+  positions->Add (Vector (100000.0, 0.0, 0.0));
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator (positions);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (endDeviceNodes);
+  mobility.Install (gatewayNodes);
+
+  LoRaWANHelper lorawanHelper;
+  lorawanHelper.SetNbRep (1);
+  lorawanHelper.Install (endDeviceNodes);
+  lorawanHelper.SetDeviceType (LORAWAN_DT_GATEWAY);
+  lorawanHelper.Install (gatewayNodes);
+
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (endDeviceNodes);
+  packetSocket.Install (gatewayNodes);
+
+  LoRaWANNetworkServerHelper nsHelper;
+  Ptr<LoRaWANNetworkServer> networkServers[2];
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      networkServers[i] = nsHelper.Create ();
+      nsHelper.AddEndDevices (networkServers[i], NodeContainer (endDeviceNodes.Get (i)));
+      ApplicationContainer apps = nsHelper.InstallGateways (networkServers[i], NodeContainer (gatewayNodes.Get (i)));
+      apps.Get (0)->TraceConnectWithoutContext ("Tx", MakeBoundCallback (&LoRaWANTestUtils::CountPacket, &nGatewayTx[i]));
+      apps.Start (Seconds (0.0));
+      apps.Stop (Seconds (10.0));
+
+      networkServers[i]->TraceConnectWithoutContext ("USMsgReceived", MakeBoundCallback (&LoRaWANNetworkServerRoamingTestCase::USMsgReceived, &nUSReceived[i]));
+      networkServers[i]->TraceConnectWithoutContext ("nrUSForwarded", MakeBoundCallback (&LoRaWANTestUtils::CounterChanged, &nUSForwarded[i]));
+      networkServers[i]->TraceConnectWithoutContext ("nrUSDropped", MakeBoundCallback (&LoRaWANTestUtils::CounterChanged, &nUSDropped[i]));
+    }
+  if (roaming)
+    LoRaWANNetworkServerHelper::EnableRoaming (networkServers[0], networkServers[1]);
+
+  // A single confirmed US packet per end device, which its network server
+  // acknowledges in RW1. The second end device starts after gateway 0 has
+  // acknowledged the first SF12 packet.
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      Ptr<LoRaWANEndDeviceApplication> edApp = CreateObject<LoRaWANEndDeviceApplication> ();
+      edApp->SetAttribute ("ConfirmedDataUp", BooleanValue (true));
+      edApp->SetAttribute ("UpstreamIAT", StringValue ("ns3::ConstantRandomVariable[Constant=100.0]"));
+      endDeviceNodes.Get (i)->AddApplication (edApp);
+      edApp->SetStartTime (Seconds (1.0 + 5.0 * i));
+      edApp->SetStopTime (Seconds (10.0));
+    }
+
+  Simulator::Stop (Seconds (10.0));
+  Simulator::Run ();
+
+  Ipv4Address deviceAddrs[2];
+  for (uint32_t i = 0; i < 2; i++)
+    deviceAddrs[i] = Ipv4Address::ConvertFrom (endDeviceNodes.Get (i)->GetDevice (0)->GetAddress ());
+  NS_TEST_ASSERT_MSG_EQ (networkServers[0]->IsHomeNetworkServer (deviceAddrs[0]), true, "Network server 0 should serve end device 0");
+  NS_TEST_ASSERT_MSG_EQ (networkServers[0]->IsHomeNetworkServer (deviceAddrs[1]), false, "Network server 0 should not serve end device 1");
+  NS_TEST_ASSERT_MSG_EQ (networkServers[0]->GetEndDevices ().GetSize (), 1, "Network server 0 should only know its own end device");
+
+  Simulator::Destroy ();
+}
+
+void
+LoRaWANNetworkServerRoamingTestCase::DoRun (void)
+{
+  uint32_t nGatewayTx[2] = {0, 0};
+  uint32_t nUSReceived[2] = {0, 0};
+  uint32_t nUSForwarded[2] = {0, 0};
+  uint32_t nUSDropped[2] = {0, 0};
+  RunScenario (false, nGatewayTx, nUSReceived, nUSForwarded, nUSDropped);
+  NS_TEST_ASSERT_MSG_EQ (nUSReceived[0], 1, "Network server 0 should receive the US packet of its end device");
+  NS_TEST_ASSERT_MSG_EQ (nUSReceived[1], 0, "Network server 1 should not receive US packets without roaming");
+  NS_TEST_ASSERT_MSG_GT (nUSDropped[0], 0, "Network server 0 should drop the US packets of the other network");
+  NS_TEST_ASSERT_MSG_EQ (nGatewayTx[0], 1, "Gateway 0 should only acknowledge the US packet of its own network");
+
+  nGatewayTx[0] = nGatewayTx[1] = 0;
+  nUSReceived[0] = nUSReceived[1] = 0;
+  nUSDropped[0] = nUSDropped[1] = 0;
+  RunScenario (true, nGatewayTx, nUSReceived, nUSForwarded, nUSDropped);
+  NS_TEST_ASSERT_MSG_EQ (nUSReceived[0], 1, "Network server 0 should receive the US packet of its end device");
+  NS_TEST_ASSERT_MSG_EQ (nUSForwarded[0], 1, "Network server 0 should forward the US packet of the other network");
+  NS_TEST_ASSERT_MSG_EQ (nUSDropped[0], 0, "Network server 0 should not drop US packets");
+  NS_TEST_ASSERT_MSG_EQ (nUSReceived[1], 1, "Network server 1 should receive the US packet of its end device via roaming");
+  NS_TEST_ASSERT_MSG_EQ (nGatewayTx[0], 2, "Gateway 0 should acknowledge the US packets of both networks");
+  NS_TEST_ASSERT_MSG_EQ (nGatewayTx[1], 0, "Gateway 1 should not send DS packets");
+}
+
+class LoRaWANNetworkServerDownlinkPlanningTestCase : public TestCase
+{
+public:
+  LoRaWANNetworkServerDownlinkPlanningTestCase ();
+  virtual ~LoRaWANNetworkServerDownlinkPlanningTestCase ();
+
+private:
+  static void ReceiveUSPacket (Ptr<LoRaWANNetworkServer> networkServer, Ptr<LoRaWANGatewayApplication> gateway,
+                               uint32_t deviceAddr, uint8_t channelIndex, uint8_t dataRateIndex, double snr);
+  static void SendDSPacket (Ptr<LoRaWANGatewayApplication> gateway, uint8_t channelIndex, uint8_t dataRateIndex);
+  void RunScenario (bool planDownlinks, bool sf12, uint32_t nGatewayTx[2], uint32_t nSent[2], uint32_t nMissed[2], uint32_t *nDeferred);
+  virtual void DoRun (void);
+};
+
+LoRaWANNetworkServerDownlinkPlanningTestCase::LoRaWANNetworkServerDownlinkPlanningTestCase ()
+  : TestCase ("Test that a DS transmission in RW1 does not take the gateway that is planned for RW2 of another end device")
+{
+}
+
+LoRaWANNetworkServerDownlinkPlanningTestCase::~LoRaWANNetworkServerDownlinkPlanningTestCase ()
+{
+}
+
+void
+LoRaWANNetworkServerDownlinkPlanningTestCase::ReceiveUSPacket (Ptr<LoRaWANNetworkServer> networkServer, Ptr<LoRaWANGatewayApplication> gateway,
+                                                             uint32_t deviceAddr, uint8_t channelIndex, uint8_t dataRateIndex, double snr)
+{
+  LoRaWANFrameHeader fhdr;
+  fhdr.setDevAddr (Ipv4Address (deviceAddr));
+  fhdr.setFrameCounter (1);
+  fhdr.setFramePort (1);
+  networkServer->HandleUSPacket (gateway, Address (), CreateUSPacket (fhdr, LORAWAN_CONFIRMED_DATA_UP, channelIndex, dataRateIndex, snr));
+}
+
+void
+LoRaWANNetworkServerDownlinkPlanningTestCase::SendDSPacket (Ptr<LoRaWANGatewayApplication> gateway, uint8_t channelIndex, uint8_t dataRateIndex)
+{
+  Ptr<Packet> packet = Create<Packet> (8);
+
+  LoRaWANFrameHeader fhdr;
+  fhdr.setDevAddr (Ipv4Address (0xffff));
+  fhdr.setFramePort (1);
+  packet->AddHeader (fhdr);
+
+  LoRaWANPhyParamsTag phyParamsTag;
+  phyParamsTag.SetChannelIndex (channelIndex);
+  phyParamsTag.SetDataRateIndex (dataRateIndex);
+  phyParamsTag.SetCodeRate (1);
+  packet->AddPacketTag (phyParamsTag);
+
+  LoRaWANMsgTypeTag msgTypeTag;
+  msgTypeTag.SetMsgType (LORAWAN_UNCONFIRMED_DATA_DOWN);
+  packet->AddPacketTag (msgTypeTag);
+
+  gateway->SendDSPacket (packet);
+}
+
+void
+LoRaWANNetworkServerDownlinkPlanningTestCase::RunScenario (bool planDownlinks, bool sf12, uint32_t nGatewayTx[2], uint32_t nSent[2], uint32_t nMissed[2], uint32_t *nDeferred)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  // The end devices only exist in the network server
+  LoRaWANNetworkServerHelper nsHelper;
+  nsHelper.SetAttribute ("PlanDownlinks", BooleanValue (planDownlinks));
+  Ptr<LoRaWANNetworkServer> networkServer = nsHelper.Create ();
+  networkServer->AddHomeEndDevice (Ipv4Address (1001));
+  networkServer->AddHomeEndDevice (Ipv4Address (1002));
+  ApplicationContainer apps = CreateGateways (nsHelper, networkServer, 2);
+  Ptr<LoRaWANGatewayApplication> gateways[2];
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      gateways[i] = DynamicCast<LoRaWANGatewayApplication> (apps.Get (i));
+      gateways[i]->TraceConnectWithoutContext ("Tx", MakeBoundCallback (&LoRaWANTestUtils::CountPacket, &nGatewayTx[i]));
+    }
+  apps.Start (Seconds (0.0));
+  apps.Stop (Seconds (10.0));
+
+  networkServer->TraceConnectWithoutContext ("nrRW1Sent", MakeBoundCallback (&LoRaWANTestUtils::CounterChanged, &nSent[0]));
+  networkServer->TraceConnectWithoutContext ("nrRW2Sent", MakeBoundCallback (&LoRaWANTestUtils::CounterChanged, &nSent[1]));
+  networkServer->TraceConnectWithoutContext ("nrRW1Missed", MakeBoundCallback (&LoRaWANTestUtils::CounterChanged, &nMissed[0]));
+  networkServer->TraceConnectWithoutContext ("nrRW2Missed", MakeBoundCallback (&LoRaWANTestUtils::CounterChanged, &nMissed[1]));
+  networkServer->TraceConnectWithoutContext ("nrRW1Deferred", MakeBoundCallback (&LoRaWANTestUtils::CounterChanged, nDeferred));
+
+  // End device 1001 is only heard by gateway 0. Gateway 0 is transmitting
+  // when RW1 of 1001 opens at 1.1 s, so its ack is sent in RW2 at 2.1 s.
+  // End device 1002 is heard best by gateway 0, its ack in RW1 overlaps RW2
+  // of 1001: at SF7 RW1 opens at 2.08 s, at SF12 RW1 opens at 1.7 s and the
+  // ack takes about one second. Without planning, gateway 0 sends this ack
+  // and is busy in RW2 of 1001.
+  const Time usTime = sf12 ? Seconds (0.7) : Seconds (1.08);
+  const uint8_t dataRateIndex = sf12 ? 0 : 5;
+  Simulator::Schedule (Seconds (0.1), &LoRaWANNetworkServerDownlinkPlanningTestCase::ReceiveUSPacket, networkServer, gateways[0], 1001, 0, 5, 10.0);
+  Simulator::Schedule (usTime, &LoRaWANNetworkServerDownlinkPlanningTestCase::ReceiveUSPacket, networkServer, gateways[0], 1002, 0, dataRateIndex, 10.0);
+  Simulator::Schedule (usTime, &LoRaWANNetworkServerDownlinkPlanningTestCase::ReceiveUSPacket, networkServer, gateways[1], 1002, 0, dataRateIndex, -5.0);
+  Simulator::Schedule (Seconds (1.08), &LoRaWANNetworkServerDownlinkPlanningTestCase::SendDSPacket, gateways[0], LoRaWAN::m_RW2ChannelIndex, 5);
+
+  Simulator::Stop (Seconds (10.0));
+  Simulator::Run ();
+  Simulator::Destroy ();
+}
+
+void
+LoRaWANNetworkServerDownlinkPlanningTestCase::DoRun (void)
+{
+  uint32_t nGatewayTx[2] = {0, 0};
+  uint32_t nSent[2] = {0, 0};
+  uint32_t nMissed[2] = {0, 0};
+  uint32_t nDeferred = 0;
+  RunScenario (false, false, nGatewayTx, nSent, nMissed, &nDeferred);
+  NS_TEST_ASSERT_MSG_EQ (nSent[0], 1, "The ack of 1002 should be sent in RW1");
+  NS_TEST_ASSERT_MSG_EQ (nMissed[0], 1, "RW1 of 1001 should be missed");
+  NS_TEST_ASSERT_MSG_EQ (nSent[1], 0, "Gateway 0 should be busy in RW2 of 1001");
+  NS_TEST_ASSERT_MSG_EQ (nMissed[1], 1, "RW2 of 1001 should be missed without planning");
+  NS_TEST_ASSERT_MSG_EQ (nGatewayTx[0], 2, "Gateway 0 should send the ack of 1002");
+  NS_TEST_ASSERT_MSG_EQ (nGatewayTx[1], 0, "Gateway 1 should not send DS packets");
+
+  nGatewayTx[0] = nGatewayTx[1] = 0;
+  nSent[0] = nSent[1] = 0;
+  nMissed[0] = nMissed[1] = 0;
+  RunScenario (true, false, nGatewayTx, nSent, nMissed, &nDeferred);
+  NS_TEST_ASSERT_MSG_EQ (nSent[0], 1, "The ack of 1002 should be sent in RW1");
+  NS_TEST_ASSERT_MSG_EQ (nMissed[0], 1, "RW1 of 1001 should be missed");
+  NS_TEST_ASSERT_MSG_EQ (nSent[1], 1, "The ack of 1001 should be sent in RW2");
+  NS_TEST_ASSERT_MSG_EQ (nMissed[1], 0, "No RW2 should be missed with planning");
+  NS_TEST_ASSERT_MSG_EQ (nDeferred, 0, "An SF7 ack in RW1 uses less duty cycle than in RW2");
+  NS_TEST_ASSERT_MSG_EQ (nGatewayTx[0], 2, "Gateway 0 should send the ack of 1001");
+  NS_TEST_ASSERT_MSG_EQ (nGatewayTx[1], 1, "Gateway 1 should send the ack of 1002");
+
+  // An SF12 ack keeps the RW1 sub band (1%) off for longer than the RW2 sub
+  // band (10%), so it is sent in RW2 via the other gateway
+  nGatewayTx[0] = nGatewayTx[1] = 0;
+  nSent[0] = nSent[1] = 0;
+  nMissed[0] = nMissed[1] = 0;
+  RunScenario (true, true, nGatewayTx, nSent, nMissed, &nDeferred);
+  NS_TEST_ASSERT_MSG_EQ (nSent[0], 0, "No ack should be sent in RW1");
+  NS_TEST_ASSERT_MSG_EQ (nDeferred, 1, "The ack of 1002 should be deferred to RW2");
+  NS_TEST_ASSERT_MSG_EQ (nMissed[0], 1, "RW1 of 1001 should be missed");
+  NS_TEST_ASSERT_MSG_EQ (nSent[1], 2, "Both acks should be sent in RW2");
+  NS_TEST_ASSERT_MSG_EQ (nMissed[1], 0, "No RW2 should be missed with planning");
+  NS_TEST_ASSERT_MSG_EQ (nGatewayTx[0], 2, "Gateway 0 should send the ack of 1001");
+  NS_TEST_ASSERT_MSG_EQ (nGatewayTx[1], 1, "Gateway 1 should send the ack of 1002");
+}
+
+// ==============================================================================
+class LoRaWANNetworkServerJoinTestCase : public TestCase
+{
+public:
+  LoRaWANNetworkServerJoinTestCase ();
+  virtual ~LoRaWANNetworkServerJoinTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANNetworkServerJoinTestCase::LoRaWANNetworkServerJoinTestCase ()
+  : TestCase ("Test that the network server answers JoinRequests with a new DevNonce with a JoinAccept")
+{
+}
+
+LoRaWANNetworkServerJoinTestCase::~LoRaWANNetworkServerJoinTestCase ()
+{
+}
+
+void
+LoRaWANNetworkServerJoinTestCase::DoRun (void)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  LoRaWANNetworkServerHelper nsHelper;
+  nsHelper.SetAttribute ("JoinAddressBase", UintegerValue (0x10000));
+  Ptr<LoRaWANNetworkServer> networkServer = nsHelper.Create ();
+  ApplicationContainer apps = CreateGateways (nsHelper, networkServer, 2);
+  uint32_t nGatewayTx = 0;
+  Ptr<LoRaWANGatewayApplication> gateways[2];
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      gateways[i] = DynamicCast<LoRaWANGatewayApplication> (apps.Get (i));
+      gateways[i]->TraceConnectWithoutContext ("Tx", MakeBoundCallback (&LoRaWANTestUtils::CountPacket, &nGatewayTx));
+    }
+  apps.Start (Seconds (0.0));
+  apps.Stop (Seconds (20.0));
+
+  uint32_t nReceived = 0, nRejected = 0, nAccepts = 0;
+  networkServer->TraceConnectWithoutContext ("nrJoinRequestsReceived", MakeBoundCallback (&LoRaWANTestUtils::CounterChanged, &nReceived));
+  networkServer->TraceConnectWithoutContext ("nrJoinRequestsRejected", MakeBoundCallback (&LoRaWANTestUtils::CounterChanged, &nRejected));
+  networkServer->TraceConnectWithoutContext ("nrJoinAcceptsSent", MakeBoundCallback (&LoRaWANTestUtils::CounterChanged, &nAccepts));
+
+  // DevEUI 42 is heard by both gateways, then replays its DevNonce and
+  // finally joins again with a new DevNonce. DevEUI 43 joins once.
+  const LoRaWANKey *noMic = 0;
+  Simulator::Schedule (Seconds (0.1), &ReceiveJoinRequest, networkServer, gateways[0], 42, 7, noMic);
+  Simulator::Schedule (Seconds (0.1), &ReceiveJoinRequest, networkServer, gateways[1], 42, 7, noMic);
+  Simulator::Schedule (Seconds (0.2), &ReceiveJoinRequest, networkServer, gateways[1], 43, 7, noMic);
+  Simulator::Schedule (Seconds (8.0), &ReceiveJoinRequest, networkServer, gateways[0], 42, 7, noMic);
+  Simulator::Schedule (Seconds (10.0), &ReceiveJoinRequest, networkServer, gateways[0], 42, 8, noMic);
+
+  Simulator::Stop (Seconds (20.0));
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (nReceived, 3, "The network server should accept three JoinRequests with a new DevNonce");
+  NS_TEST_ASSERT_MSG_EQ (nRejected, 1, "The network server should reject the replayed DevNonce");
+  NS_TEST_ASSERT_MSG_EQ (nAccepts, 3, "The network server should answer every accepted JoinRequest with a JoinAccept");
+  NS_TEST_ASSERT_MSG_EQ (nGatewayTx, 3, "Every JoinAccept should be sent by a single gateway");
+
+  const LoRaWANEndDeviceTableNS &endDevices = networkServer->GetEndDevices ();
+  NS_TEST_ASSERT_MSG_EQ (endDevices.GetSize (), 2, "Joining again should not allocate a second device address");
+  const uint32_t i = networkServer->FindJoinedEndDevice (42);
+  const uint32_t j = networkServer->FindJoinedEndDevice (43);
+  NS_TEST_ASSERT_MSG_NE (i, LoRaWANEndDeviceTableNS::m_invalidIndex, "DevEUI 42 should have joined");
+  NS_TEST_ASSERT_MSG_NE (j, LoRaWANEndDeviceTableNS::m_invalidIndex, "DevEUI 43 should have joined");
+  if (i == LoRaWANEndDeviceTableNS::m_invalidIndex || j == LoRaWANEndDeviceTableNS::m_invalidIndex)
+    {
+      Simulator::Destroy ();
+      return;
+    }
+  NS_TEST_ASSERT_MSG_EQ (endDevices.m_deviceAddress[i], 0x10000, "The first device address should be the join address base");
+  NS_TEST_ASSERT_MSG_EQ (endDevices.m_deviceAddress[j], 0x10001, "The second device address should follow the first one");
+  NS_TEST_ASSERT_MSG_EQ (endDevices.m_stats[i].m_nUSDuplicates, 1, "The JoinRequest received by the second gateway is a duplicate");
+
+  Simulator::Destroy ();
+}
+
+// ==============================================================================
+class LoRaWANNetworkServerJoinMicTestCase : public TestCase
+{
+public:
+  LoRaWANNetworkServerJoinMicTestCase ();
+  virtual ~LoRaWANNetworkServerJoinMicTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANNetworkServerJoinMicTestCase::LoRaWANNetworkServerJoinMicTestCase ()
+  : TestCase ("Test that the network server only accepts JoinRequests with a MIC of the AppKey of the end device")
+{
+}
+
+LoRaWANNetworkServerJoinMicTestCase::~LoRaWANNetworkServerJoinMicTestCase ()
+{
+}
+
+void
+LoRaWANNetworkServerJoinMicTestCase::DoRun (void)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  LoRaWANNetworkServerHelper nsHelper;
+  nsHelper.SetAttribute ("JoinAddressBase", UintegerValue (0x10000));
+  nsHelper.SetAttribute ("Crypto", BooleanValue (true));
+  Ptr<LoRaWANNetworkServer> networkServer = nsHelper.Create ();
+  ApplicationContainer apps = CreateGateways (nsHelper, networkServer, 1);
+  Ptr<LoRaWANGatewayApplication> gateway = DynamicCast<LoRaWANGatewayApplication> (apps.Get (0));
+  apps.Start (Seconds (0.0));
+  apps.Stop (Seconds (20.0));
+
+  uint32_t nReceived = 0, nMicFailures = 0, nAccepts = 0;
+  networkServer->TraceConnectWithoutContext ("nrJoinRequestsReceived", MakeBoundCallback (&LoRaWANTestUtils::CounterChanged, &nReceived));
+  networkServer->TraceConnectWithoutContext ("nrUSMicFailures", MakeBoundCallback (&LoRaWANTestUtils::CounterChanged, &nMicFailures));
+  networkServer->TraceConnectWithoutContext ("nrJoinAcceptsSent", MakeBoundCallback (&LoRaWANTestUtils::CounterChanged, &nAccepts));
+
+  // DevEUI 42 has a configured AppKey, DevEUI 43 the default AppKey of its
+  // DevEUI. The JoinRequest of DevEUI 44 is signed with another AppKey, the
+  // one of DevEUI 45 has no MIC.
+  LoRaWANKey appKey;
+  appKey.SetHex ("2b7e151628aed2a6abf7158809cf4f3c");
+  networkServer->SetAppKey (42, appKey);
+  LoRaWANKey defaultAppKey;
+  LoRaWANCrypto::DeriveDefaultAppKey (43, defaultAppKey);
+  Simulator::Schedule (Seconds (0.1), &ReceiveJoinRequest, networkServer, gateway, 42, 1, &appKey);
+  Simulator::Schedule (Seconds (0.2), &ReceiveJoinRequest, networkServer, gateway, 43, 1, &defaultAppKey);
+  Simulator::Schedule (Seconds (0.3), &ReceiveJoinRequest, networkServer, gateway, 44, 1, &appKey);
+  Simulator::Schedule (Seconds (0.4), &ReceiveJoinRequest, networkServer, gateway, 45, 1, (const LoRaWANKey *)0);
+
+  Simulator::Stop (Seconds (20.0));
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (nReceived, 2, "The network server should accept the JoinRequests with a valid MIC");
+  NS_TEST_ASSERT_MSG_EQ (nMicFailures, 2, "The network server should count the JoinRequests with an invalid or without a MIC");
+  NS_TEST_ASSERT_MSG_EQ (nAccepts, 2, "The network server should answer the accepted JoinRequests");
+  NS_TEST_ASSERT_MSG_NE (networkServer->FindJoinedEndDevice (42), LoRaWANEndDeviceTableNS::m_invalidIndex, "DevEUI 42 should have joined");
+  NS_TEST_ASSERT_MSG_NE (networkServer->FindJoinedEndDevice (43), LoRaWANEndDeviceTableNS::m_invalidIndex, "DevEUI 43 should have joined");
+  NS_TEST_ASSERT_MSG_EQ (networkServer->FindJoinedEndDevice (44), LoRaWANEndDeviceTableNS::m_invalidIndex, "DevEUI 44 should not have a device address");
+  NS_TEST_ASSERT_MSG_EQ (networkServer->FindJoinedEndDevice (45), LoRaWANEndDeviceTableNS::m_invalidIndex, "DevEUI 45 should not have a device address");
+  NS_TEST_ASSERT_MSG_EQ (networkServer->GetEndDevices ().GetSize (), 2, "Only the joined end devices should have a device address");
+
+  Simulator::Destroy ();
+}
+
+class LoRaWANEndDeviceJoinTestCase : public TestCase
+{
+public:
+  LoRaWANEndDeviceJoinTestCase ();
+  virtual ~LoRaWANEndDeviceJoinTestCase ();
+
+private:
+  static void Joined (uint32_t *nJoined, uint32_t deviceAddr, Time latency, uint32_t nJoinRequests);
+  static void USMsgReceived (uint32_t *nRx, uint32_t deviceAddr, uint8_t msgType, Ptr<const Packet> p);
+  virtual void DoRun (void);
+};
+
+LoRaWANEndDeviceJoinTestCase::LoRaWANEndDeviceJoinTestCase ()
+  : TestCase ("Test that end devices join by over-the-air activation before sending US data")
+{
+}
+
+LoRaWANEndDeviceJoinTestCase::~LoRaWANEndDeviceJoinTestCase ()
+{
+}
+
+void
+LoRaWANEndDeviceJoinTestCase::Joined (uint32_t *nJoined, uint32_t deviceAddr, Time latency, uint32_t nJoinRequests)
+{
+  (*nJoined)++;
+}
+
+void
+LoRaWANEndDeviceJoinTestCase::USMsgReceived (uint32_t *nRx, uint32_t deviceAddr, uint8_t msgType, Ptr<const Packet> p)
+{
+  if (msgType != LORAWAN_JOIN_REQUEST)
+    (*nRx)++;
+}
+
+void
+LoRaWANEndDeviceJoinTestCase::DoRun (void)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  NodeContainer endDeviceNodes;
+  NodeContainer gatewayNodes;
+  endDeviceNodes.Create (2);
+  gatewayNodes.Create (1);
+
+  Ptr<ListPositionAllocator> positions = CreateObject<ListPositionAllocator> ();
+  positions->Add (Vector (0.0, 0.0, 0.0));
+  positions->Add (Vector (100.0, 0.0, 0.0));
+  positions->Add (Vector (50.0, 0.0, 0.0));
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator (positions);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (endDeviceNodes);
+  mobility.Install (gatewayNodes);
+
+  LoRaWANHelper lorawanHelper;
+  lorawanHelper.SetNbRep (1);
+  lorawanHelper.Install (endDeviceNodes);
+  lorawanHelper.SetDeviceType (LORAWAN_DT_GATEWAY);
+  lorawanHelper.Install (gatewayNodes);
+
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (endDeviceNodes);
+  packetSocket.Install (gatewayNodes);
+
+  LoRaWANNetworkServerHelper nsHelper;
+  Ptr<LoRaWANNetworkServer> networkServer = nsHelper.Create ();
+  ApplicationContainer apps = nsHelper.InstallGateways (networkServer, gatewayNodes);
+  apps.Start (Seconds (0.0));
+  apps.Stop (Seconds (30.0));
+
+  uint32_t nUSReceived = 0;
+  networkServer->TraceConnectWithoutContext ("USMsgReceived", MakeBoundCallback (&LoRaWANEndDeviceJoinTestCase::USMsgReceived, &nUSReceived));
+
+  // The second end device starts after the JoinAccept of the first one. At
+  // SF7 the RDC lets the end devices send US data a few seconds after their
+  // JoinRequest.
+  uint32_t nJoined = 0;
+  Ptr<LoRaWANEndDeviceApplication> edApps[2];
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      edApps[i] = CreateObject<LoRaWANEndDeviceApplication> ();
+      edApps[i]->SetAttribute ("OTAA", BooleanValue (true));
+      edApps[i]->SetAttribute ("DataRateIndex", UintegerValue (5));
+      edApps[i]->SetAttribute ("UpstreamIAT", StringValue ("ns3::ConstantRandomVariable[Constant=100.0]"));
+      edApps[i]->TraceConnectWithoutContext ("Joined", MakeBoundCallback (&LoRaWANEndDeviceJoinTestCase::Joined, &nJoined));
+      endDeviceNodes.Get (i)->AddApplication (edApps[i]);
+      edApps[i]->SetStartTime (Seconds (1.0 + 10.0 * i));
+      edApps[i]->SetStopTime (Seconds (30.0));
+    }
+
+  Simulator::Stop (Seconds (30.0));
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (nJoined, 2, "Both end devices should join");
+  NS_TEST_ASSERT_MSG_EQ (nUSReceived, 2, "Both end devices should send a US data packet after joining");
+  Ipv4Address deviceAddrs[2];
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (edApps[i]->IsJoined (), true, "The end device should have joined");
+      deviceAddrs[i] = Ipv4Address::ConvertFrom (endDeviceNodes.Get (i)->GetDevice (0)->GetAddress ());
+      NS_TEST_ASSERT_MSG_NE (networkServer->FindJoinedEndDevice (edApps[i]->GetDevEui ()), LoRaWANEndDeviceTableNS::m_invalidIndex, "The network server should know the joined end device");
+    }
+  NS_TEST_ASSERT_MSG_NE (deviceAddrs[0], deviceAddrs[1], "The end devices should get different device addresses");
+  NS_TEST_ASSERT_MSG_NE (deviceAddrs[0], Ipv4Address::GetAny (), "The end device should have a device address after joining");
+
+  Simulator::Destroy ();
+}
+
+class LoRaWANNetworkServerDSQueueTestCase : public TestCase
+{
+public:
+  LoRaWANNetworkServerDSQueueTestCase ();
+  virtual ~LoRaWANNetworkServerDSQueueTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANNetworkServerDSQueueTestCase::LoRaWANNetworkServerDSQueueTestCase ()
+  : TestCase ("Test the depth statistics and the maximum size of the DS queues of the network server")
+{
+}
+
+LoRaWANNetworkServerDSQueueTestCase::~LoRaWANNetworkServerDSQueueTestCase ()
+{
+}
+
+void
+LoRaWANNetworkServerDSQueueTestCase::DoRun (void)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  // DS packets are generated every second for end devices that never send
+  // an US packet, so their DS queues fill up
+  LoRaWANNetworkServerHelper nsHelper;
+  nsHelper.SetAttribute ("GenerateDataDown", BooleanValue (true));
+  nsHelper.SetAttribute ("DownstreamIAT", StringValue ("ns3::ConstantRandomVariable[Constant=1.0]"));
+  nsHelper.SetAttribute ("MaxDSQueueSize", UintegerValue (3));
+  Ptr<LoRaWANNetworkServer> networkServer = nsHelper.Create ();
+  networkServer->AddHomeEndDevice (Ipv4Address (1001));
+  networkServer->AddHomeEndDevice (Ipv4Address (1002));
+  ApplicationContainer apps = CreateGateways (nsHelper, networkServer, 1);
+  apps.Start (Seconds (0.0));
+  apps.Stop (Seconds (10.0));
+
+  uint32_t maxQueueSize = 0;
+  uint32_t nDrops = 0;
+  networkServer->TraceConnectWithoutContext ("DSQueueSize", MakeBoundCallback (&LoRaWANTestUtils::MaxChanged, &maxQueueSize));
+  networkServer->TraceConnectWithoutContext ("nrDSQueueDrops", MakeBoundCallback (&LoRaWANTestUtils::CounterChanged, &nDrops));
+
+  Simulator::Stop (Seconds (10.0));
+  Simulator::Run ();
+
+  const LoRaWANEndDeviceTableNS &endDevices = networkServer->GetEndDevices ();
+  uint32_t nDropsTable = 0;
+  for (uint32_t i = 0; i < endDevices.GetSize (); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (endDevices.m_info[i].m_downstreamQueue.m_size, 3, "The DS queue should be full");
+      nDropsTable += endDevices.m_stats[i].m_nDSQueueDrops;
+    }
+  NS_TEST_ASSERT_MSG_EQ (maxQueueSize, 6, "The DS queues should not exceed their maximum size");
+  NS_TEST_ASSERT_MSG_GT (nDrops, 0, "DS packets should be dropped");
+  NS_TEST_ASSERT_MSG_EQ (nDropsTable, nDrops, "The statistics should count all dropped DS packets");
+
+  Simulator::Destroy ();
+}
+
+class LoRaWANMacCommandTestCase : public TestCase
+{
+public:
+  LoRaWANMacCommandTestCase ();
+  virtual ~LoRaWANMacCommandTestCase ();
+
+private:
+  static void DevStatus (uint32_t *nDevStatus, uint32_t deviceAddr, uint8_t battery, int8_t margin);
+  void RunScenario (bool confirmedData);
+  virtual void DoRun (void);
+};
+
+LoRaWANMacCommandTestCase::LoRaWANMacCommandTestCase ()
+  : TestCase ("Test that the network server piggybacks queued MAC commands in the frame options of DS packets")
+{
+}
+
+LoRaWANMacCommandTestCase::~LoRaWANMacCommandTestCase ()
+{
+}
+
+void
+LoRaWANMacCommandTestCase::DevStatus (uint32_t *nDevStatus, uint32_t deviceAddr, uint8_t battery, int8_t margin)
+{
+  (*nDevStatus)++;
+}
+
+void
+LoRaWANMacCommandTestCase::RunScenario (bool confirmedData)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  NodeContainer endDeviceNodes;
+  NodeContainer gatewayNodes;
+  endDeviceNodes.Create (1);
+  gatewayNodes.Create (1);
+
+  Ptr<ListPositionAllocator> positions = CreateObject<ListPositionAllocator> ();
+  positions->Add (Vector (0.0, 0.0, 0.0));
+  positions->Add (Vector (50.0, 0.0, 0.0));
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator (positions);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (endDeviceNodes);
+  mobility.Install (gatewayNodes);
+
+  LoRaWANHelper lorawanHelper;
+  lorawanHelper.SetNbRep (1);
+  NetDeviceContainer endDevices = lorawanHelper.Install (endDeviceNodes);
+  lorawanHelper.SetDeviceType (LORAWAN_DT_GATEWAY);
+  lorawanHelper.Install (gatewayNodes);
+
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (endDeviceNodes);
+  packetSocket.Install (gatewayNodes);
+
+  LoRaWANNetworkServerHelper nsHelper;
+  Ptr<LoRaWANNetworkServer> networkServer = nsHelper.Create ();
+  ApplicationContainer apps = nsHelper.InstallGateways (networkServer, gatewayNodes);
+  apps.Start (Seconds (0.0));
+  apps.Stop (Seconds (50.0));
+
+  uint32_t nSent = 0, nPiggybacked = 0, nDevStatus = 0;
+  networkServer->TraceConnectWithoutContext ("nrMacCommandsSent", MakeBoundCallback (&LoRaWANTestUtils::CounterChanged, &nSent));
+  networkServer->TraceConnectWithoutContext ("nrMacCommandsPiggybacked", MakeBoundCallback (&LoRaWANTestUtils::CounterChanged, &nPiggybacked));
+  networkServer->TraceConnectWithoutContext ("DevStatus", MakeBoundCallback (&LoRaWANMacCommandTestCase::DevStatus, &nDevStatus));
+
+  // Three MAC commands of 8 bytes in total fit in the frame options of one
+  // DS packet
+  const Ipv4Address deviceAddr = Ipv4Address::ConvertFrom (endDevices.Get (0)->GetAddress ());
+  const uint32_t rw2Frequency = LoRaWAN::m_supportedChannels[LoRaWAN::m_RW2ChannelIndex].m_fc;
+  NS_TEST_ASSERT_MSG_EQ (networkServer->QueueMacCommand (deviceAddr, LoRaWANDevStatusReqHeader ()), true, "DevStatusReq should be queued");
+  NS_TEST_ASSERT_MSG_EQ (networkServer->QueueMacCommand (deviceAddr, LoRaWANDutyCycleReqHeader (3)), true, "DutyCycleReq should be queued");
+  NS_TEST_ASSERT_MSG_EQ (networkServer->QueueMacCommand (deviceAddr, LoRaWANRxParamSetupReqHeader (1, LoRaWAN::m_RW2DataRateIndex, rw2Frequency)), true, "RXParamSetupReq should be queued");
+  NS_TEST_ASSERT_MSG_EQ (networkServer->QueueMacCommand (Ipv4Address ("10.0.0.1"), LoRaWANDevStatusReqHeader ()), false, "Unknown end device");
+  NS_TEST_ASSERT_MSG_EQ (networkServer->QueueMacCommand (deviceAddr, LoRaWANLinkAdrReqHeader ()), false, "LinkADRReq is sent by ADR");
+
+  // The second US packet carries the answers to the MAC commands
+  Ptr<LoRaWANEndDeviceApplication> edApp = CreateObject<LoRaWANEndDeviceApplication> ();
+  edApp->SetAttribute ("DataRateIndex", UintegerValue (5));
+  edApp->SetAttribute ("ConfirmedDataUp", BooleanValue (confirmedData));
+  edApp->SetAttribute ("UpstreamIAT", StringValue ("ns3::ConstantRandomVariable[Constant=20.0]"));
+  endDeviceNodes.Get (0)->AddApplication (edApp);
+  edApp->SetStartTime (Seconds (1.0));
+  edApp->SetStopTime (Seconds (50.0));
+
+  Simulator::Stop (Seconds (50.0));
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (nSent, 3, "All MAC commands should be sent");
+  NS_TEST_ASSERT_MSG_EQ (nPiggybacked, (confirmedData ? 3 : 0), "The MAC commands should be piggybacked on the ack, if any");
+  NS_TEST_ASSERT_MSG_EQ (nDevStatus, 1, "The end device should answer the DevStatusReq");
+  Ptr<LoRaWANMac> mac = DynamicCast<LoRaWANNetDevice> (endDevices.Get (0))->GetMac ();
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)mac->GetMaxDutyCycle (), 3, "The end device should apply the DutyCycleReq");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)mac->GetRX1DROffset (), 1, "The end device should apply the RXParamSetupReq");
+  const uint32_t i = networkServer->GetEndDevices ().Find (deviceAddr.Get ());
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)networkServer->GetEndDevices ().m_rx1DROffset[i], 1, "The network server should apply the RXParamSetupAns");
+
+  Simulator::Destroy ();
+}
+
+void
+LoRaWANMacCommandTestCase::DoRun (void)
+{
+  RunScenario (true);
+  RunScenario (false);
+}
+
+class LoRaWANClassCTestCase : public TestCase
+{
+public:
+  LoRaWANClassCTestCase ();
+  virtual ~LoRaWANClassCTestCase ();
+
+private:
+  static void DSMsgReceived (uint32_t *nRx, Time *rxTime, uint32_t deviceAddr, uint8_t msgType, Ptr<const Packet> p, uint8_t rw);
+  virtual void DoRun (void);
+};
+
+LoRaWANClassCTestCase::LoRaWANClassCTestCase ()
+  : TestCase ("Test that the network server pushes DS packets to Class C end devices in between their US transmissions")
+{
+}
+
+LoRaWANClassCTestCase::~LoRaWANClassCTestCase ()
+{
+}
+
+void
+LoRaWANClassCTestCase::DSMsgReceived (uint32_t *nRx, Time *rxTime, uint32_t deviceAddr, uint8_t msgType, Ptr<const Packet> p, uint8_t rw)
+{
+  if (rw == 0) {
+    (*nRx)++;
+    *rxTime = Simulator::Now ();
+  }
+}
+
+void
+LoRaWANClassCTestCase::DoRun (void)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  // The first end device is a Class C end device, the second one a Class A
+  // end device
+  NodeContainer classCNodes;
+  NodeContainer classANodes;
+  NodeContainer gatewayNodes;
+  classCNodes.Create (1);
+  classANodes.Create (1);
+  gatewayNodes.Create (1);
+
+  Ptr<ListPositionAllocator> positions = CreateObject<ListPositionAllocator> ();
+  positions->Add (Vector (0.0, 0.0, 0.0));
+  positions->Add (Vector (100.0, 0.0, 0.0));
+  positions->Add (Vector (50.0, 0.0, 0.0));
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator (positions);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (classCNodes);
+  mobility.Install (classANodes);
+  mobility.Install (gatewayNodes);
+
+  LoRaWANHelper lorawanHelper;
+  lorawanHelper.SetNbRep (1);
+  lorawanHelper.SetDeviceType (LORAWAN_DT_END_DEVICE_CLASS_C);
+  lorawanHelper.Install (classCNodes);
+  lorawanHelper.SetDeviceType (LORAWAN_DT_END_DEVICE_CLASS_A);
+  lorawanHelper.Install (classANodes);
+  lorawanHelper.SetDeviceType (LORAWAN_DT_GATEWAY);
+  lorawanHelper.Install (gatewayNodes);
+
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (classCNodes);
+  packetSocket.Install (classANodes);
+  packetSocket.Install (gatewayNodes);
+
+  LoRaWANNetworkServerHelper nsHelper;
+  Ptr<LoRaWANNetworkServer> networkServer = nsHelper.Create ();
+  ApplicationContainer apps = nsHelper.InstallGateways (networkServer, gatewayNodes);
+  apps.Start (Seconds (0.0));
+  apps.Stop (Seconds (30.0));
+
+  // Both end devices send one US packet at the start of the simulation
+  NodeContainer endDeviceNodes (classCNodes, classANodes);
+  uint32_t nClassCReceived[2] = {0, 0};
+  Time rxTime[2];
+  Ipv4Address deviceAddrs[2];
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      Ptr<LoRaWANEndDeviceApplication> edApp = CreateObject<LoRaWANEndDeviceApplication> ();
+      edApp->SetAttribute ("DataRateIndex", UintegerValue (5));
+      edApp->SetAttribute ("UpstreamIAT", StringValue ("ns3::ConstantRandomVariable[Constant=100.0]"));
+      edApp->TraceConnectWithoutContext ("DSMsgReceived", MakeBoundCallback (&LoRaWANClassCTestCase::DSMsgReceived, &nClassCReceived[i], &rxTime[i]));
+      endDeviceNodes.Get (i)->AddApplication (edApp);
+      edApp->SetStartTime (Seconds (1.0));
+      edApp->SetStopTime (Seconds (30.0));
+      deviceAddrs[i] = Ipv4Address::ConvertFrom (endDeviceNodes.Get (i)->GetDevice (0)->GetAddress ());
+    }
+
+  // Queue a DS packet for both end devices long after their receive windows
+  // closed: only the Class C end device can receive it before its next US
+  // transmission
+  for (uint32_t i = 0; i < 2; i++)
+    Simulator::Schedule (Seconds (10.0), &LoRaWANNetworkServer::QueueDSPacket, networkServer, deviceAddrs[i], Create<Packet> (8), 1, false);
+
+  Simulator::Stop (Seconds (30.0));
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (nClassCReceived[0], 1, "The Class C end device should receive the DS packet in between US transmissions");
+  // The DS packet is sent at SF12, its airtime is about 1.5 s
+  NS_TEST_ASSERT_MSG_LT (rxTime[0], Seconds (12.0), "The DS packet should be pushed right after it was queued");
+  NS_TEST_ASSERT_MSG_EQ (nClassCReceived[1], 0, "The Class A end device can only receive in its receive windows");
+  const uint32_t i = networkServer->GetEndDevices ().Find (deviceAddrs[0].Get ());
+  NS_TEST_ASSERT_MSG_EQ (networkServer->GetEndDevices ().m_stats[i].m_nDSPacketsSentClassC, 1, "The network server should count the pushed DS packet");
+
+  Simulator::Destroy ();
+}
+
+class LoRaWANNetworkServerTestSuite : public TestSuite
+{
+public:
+  LoRaWANNetworkServerTestSuite ();
+};
+
+LoRaWANNetworkServerTestSuite::LoRaWANNetworkServerTestSuite ()
+  : TestSuite ("lorawan-network-server", UNIT)
+{
+  AddTestCase (new LoRaWANNetworkServerGatewaySelectionTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANAdrHistoryTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANNetworkServerAdrTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANNetworkServerLinkAdrAnsTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANEndDeviceTableTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANNetworkServerRoamingTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANNetworkServerDownlinkPlanningTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANNetworkServerJoinTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANNetworkServerJoinMicTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANEndDeviceJoinTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANNetworkServerDSQueueTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANMacCommandTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANClassCTestCase, TestCase::QUICK);
+}
+
+static LoRaWANNetworkServerTestSuite lorawanNetworkServerTestSuite;
@@ -21,6 +21,7 @@
 #include "ns3/lorawan.h"
 #include "ns3/lorawan-frame-header.h"
 #include "ns3/lorawan-mac-header.h"
+#include "ns3/lorawan-mac-command.h"
 
 // An essential include is test.h
 #include "ns3/test.h"
@@ -123,6 +124,25 @@ LorawanPacketTestCase::DoRun (void)
   NS_TEST_ASSERT_MSG_EQ (receiverFHdr.getFramePending(), false, "Frame pendings do not match");
   NS_TEST_ASSERT_MSG_EQ (receiverFHdr.getFrameCounter(), 10, "Frame counters do not match");
   NS_TEST_ASSERT_MSG_EQ (receiverFHdr.getFramePort (), 1, "Frame ports do not match");
+
+  // Frame options: a DevStatusReq and a DutyCycleReq piggybacked on an empty
+  // frame, i.e. without frame port
+  LoRaWANFrameHeader foptsFHdr;
+  foptsFHdr.setDevAddr (devAddr);
+  const uint8_t frameOptions[] = {LORAWAN_CID_DEV_STATUS, LORAWAN_CID_DUTY_CYCLE, 0x03};
+  foptsFHdr.setFrameOptions (frameOptions, sizeof (frameOptions));
+  Ptr<Packet> p3 = Create<Packet> (4);
+  p3->AddHeader (foptsFHdr);
+  NS_TEST_ASSERT_MSG_EQ (p3->GetSize (), 4 + 7 + 3, "Packet wrong size after adding frame header with frame options");
+
+  LoRaWANFrameHeader receivedFoptsFHdr;
+  p3->RemoveHeader (receivedFoptsFHdr);
+  NS_TEST_ASSERT_MSG_EQ (p3->GetSize (), 4, "Packet wrong size after removing frame header with frame options");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)receivedFoptsFHdr.getFrameOptionsLength (), 3, "Frame options lengths do not match");
+  uint8_t receivedFrameOptions[LORAWAN_FHDR_MAX_FOPTSLEN];
+  receivedFoptsFHdr.getFrameOptions (receivedFrameOptions);
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)receivedFrameOptions[1], LORAWAN_CID_DUTY_CYCLE, "Frame options do not match");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)receivedFrameOptions[2], 3, "Frame options do not match");
 }
 
 // The TestSuite class names the TestSuite, identifies what type of TestSuite,
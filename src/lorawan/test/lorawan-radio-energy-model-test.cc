@@ -0,0 +1,227 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include <ns3/log.h>
+#include <ns3/test.h>
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/energy-module.h>
+#include <ns3/lorawan-module.h>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-radio-energy-model-test");
+
+class LoRaWANRadioEnergyModelTestCase : public TestCase
+{
+public:
+  LoRaWANRadioEnergyModelTestCase ();
+  virtual ~LoRaWANRadioEnergyModelTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANRadioEnergyModelTestCase::LoRaWANRadioEnergyModelTestCase ()
+  : TestCase ("Test the charge integration and TX current of the LoRaWANRadioEnergyModel")
+{
+}
+
+LoRaWANRadioEnergyModelTestCase::~LoRaWANRadioEnergyModelTestCase ()
+{
+}
+
+void
+LoRaWANRadioEnergyModelTestCase::DoRun (void)
+{
+  Ptr<LoRaWANRadioEnergyModel> model = CreateObject<LoRaWANRadioEnergyModel> ();
+
+  NS_TEST_ASSERT_MSG_EQ_TOL (model->GetTxCurrentA (13), 0.029, 1e-12, "Wrong TX current at 13 dBm");
+  NS_TEST_ASSERT_MSG_EQ_TOL (model->GetTxCurrentA (15), 0.058, 1e-12, "TX current should be interpolated in between 13 and 17 dBm");
+  NS_TEST_ASSERT_MSG_EQ_TOL (model->GetTxCurrentA (2), 0.020, 1e-12, "TX current should be clamped below 7 dBm");
+  NS_TEST_ASSERT_MSG_EQ_TOL (model->GetTxCurrentA (27), 0.120, 1e-12, "TX current should be clamped above 20 dBm");
+  model->SetTxCurrentA (14, 0.040);
+  NS_TEST_ASSERT_MSG_EQ_TOL (model->GetTxCurrentA (14), 0.040, 1e-12, "Wrong TX current after SetTxCurrentA");
+
+  // 1 s standby, 2 s receiving, 7 s sleeping
+  model->ChangeState (LORAWAN_PHY_IDLE);
+  Simulator::Schedule (Seconds (1.0), &LoRaWANRadioEnergyModel::ChangeState, model, (int)LORAWAN_PHY_RX_ON);
+  Simulator::Schedule (Seconds (3.0), &LoRaWANRadioEnergyModel::ChangeState, model, (int)LORAWAN_PHY_TRX_OFF);
+  Simulator::Stop (Seconds (10.0));
+  Simulator::Run ();
+
+  const double expectedChargeC = 1.0 * 0.0016 + 2.0 * 0.0108 + 7.0 * 0.0000002;
+  NS_TEST_ASSERT_MSG_EQ_TOL (model->GetTotalChargeConsumption (), expectedChargeC, 1e-12, "Wrong charge consumption");
+  NS_TEST_ASSERT_MSG_EQ_TOL (model->GetTotalEnergyConsumption (), expectedChargeC * 3.3, 1e-12, "Wrong energy consumption");
+  NS_TEST_ASSERT_MSG_EQ_TOL (model->GetAverageCurrentA (), expectedChargeC / 10.0, 1e-12, "Wrong average current");
+  NS_TEST_ASSERT_MSG_EQ (model->GetTimeInState (LORAWAN_PHY_RX_ON), Seconds (2.0), "Wrong time in RX_ON");
+  NS_TEST_ASSERT_MSG_EQ (model->GetTimeInState (LORAWAN_PHY_TRX_OFF), Seconds (7.0), "The time in the current state should be included");
+  NS_TEST_ASSERT_MSG_EQ_TOL (model->GetProjectedLifetime (1.0).GetSeconds (), 3600.0 / (expectedChargeC / 10.0), 1e-3, "Wrong projected lifetime");
+
+  Simulator::Destroy ();
+}
+
+class LoRaWANRadioEnergyModelEndDeviceTestCase : public TestCase
+{
+public:
+  LoRaWANRadioEnergyModelEndDeviceTestCase ();
+  virtual ~LoRaWANRadioEnergyModelEndDeviceTestCase ();
+
+private:
+  static void PhyTxBegin (Time *txStart, Ptr<const Packet> p);
+  static void PhyTxEnd (Time *txEnd, Ptr<const Packet> p);
+  static void GetConsumedEnergy (Ptr<BasicEnergySource> source, Ptr<DeviceEnergyModel> model, double *sourceJ, double *modelJ);
+  virtual void DoRun (void);
+};
+
+LoRaWANRadioEnergyModelEndDeviceTestCase::LoRaWANRadioEnergyModelEndDeviceTestCase ()
+  : TestCase ("Test that the LoRaWANRadioEnergyModel follows the TRX state of an end device and updates its energy source")
+{
+}
+
+LoRaWANRadioEnergyModelEndDeviceTestCase::~LoRaWANRadioEnergyModelEndDeviceTestCase ()
+{
+}
+
+void
+LoRaWANRadioEnergyModelEndDeviceTestCase::PhyTxBegin (Time *txStart, Ptr<const Packet> p)
+{
+  *txStart = Simulator::Now ();
+}
+
+void
+LoRaWANRadioEnergyModelEndDeviceTestCase::PhyTxEnd (Time *txEnd, Ptr<const Packet> p)
+{
+  *txEnd = Simulator::Now ();
+}
+
+void
+LoRaWANRadioEnergyModelEndDeviceTestCase::GetConsumedEnergy (Ptr<BasicEnergySource> source, Ptr<DeviceEnergyModel> model, double *sourceJ, double *modelJ)
+{
+  *sourceJ = source->GetInitialEnergy () - source->GetRemainingEnergy ();
+  *modelJ = model->GetTotalEnergyConsumption ();
+}
+
+void
+LoRaWANRadioEnergyModelEndDeviceTestCase::DoRun (void)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  NodeContainer endDeviceNodes;
+  NodeContainer gatewayNodes;
+  endDeviceNodes.Create (2);
+  gatewayNodes.Create (1);
+
+  Ptr<ListPositionAllocator> positions = CreateObject<ListPositionAllocator> ();
+  positions->Add (Vector (0.0, 0.0, 0.0));
+  positions->Add (Vector (100.0, 0.0, 0.0));
+  positions->Add (Vector (50.0, 0.0, 0.0));
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator (positions);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (endDeviceNodes);
+  mobility.Install (gatewayNodes);
+
+  LoRaWANHelper lorawanHelper;
+  lorawanHelper.SetNbRep (1);
+  NetDeviceContainer endDevices = lorawanHelper.Install (endDeviceNodes);
+  lorawanHelper.SetDeviceType (LORAWAN_DT_GATEWAY);
+  lorawanHelper.Install (gatewayNodes);
+
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (endDeviceNodes);
+  packetSocket.Install (gatewayNodes);
+
+  LoRaWANNetworkServerHelper nsHelper;
+  Ptr<LoRaWANNetworkServer> networkServer = nsHelper.Create ();
+  ApplicationContainer apps = nsHelper.InstallGateways (networkServer, gatewayNodes);
+  apps.Start (Seconds (0.0));
+  apps.Stop (Seconds (20.0));
+
+  // The first end device has a battery, the second one only counts its consumption
+  BasicEnergySourceHelper sourceHelper;
+  sourceHelper.Set ("BasicEnergySourceInitialEnergyJ", DoubleValue (100.0));
+  sourceHelper.Set ("PeriodicEnergyUpdateInterval", TimeValue (Hours (24.0)));
+  EnergySourceContainer sources = sourceHelper.Install (endDeviceNodes.Get (0));
+  LoRaWANRadioEnergyModelHelper radioEnergyHelper;
+  DeviceEnergyModelContainer models = radioEnergyHelper.Install (endDevices.Get (0), sources.Get (0));
+  models.Add (radioEnergyHelper.Install (NetDeviceContainer (endDevices.Get (1))));
+  NS_TEST_ASSERT_MSG_EQ (models.GetN (), 2, "Both end devices should have a radio energy model");
+
+  Time txStart[2], txEnd[2];
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      Ptr<LoRaWANNetDevice> device = DynamicCast<LoRaWANNetDevice> (endDevices.Get (i));
+      device->GetPhy ()->TraceConnectWithoutContext ("PhyTxBegin", MakeBoundCallback (&LoRaWANRadioEnergyModelEndDeviceTestCase::PhyTxBegin, &txStart[i]));
+      device->GetPhy ()->TraceConnectWithoutContext ("PhyTxEnd", MakeBoundCallback (&LoRaWANRadioEnergyModelEndDeviceTestCase::PhyTxEnd, &txEnd[i]));
+
+      Ptr<LoRaWANEndDeviceApplication> edApp = CreateObject<LoRaWANEndDeviceApplication> ();
+      edApp->SetAttribute ("DataRateIndex", UintegerValue (5));
+      edApp->SetAttribute ("UpstreamIAT", StringValue ("ns3::ConstantRandomVariable[Constant=100.0]"));
+      endDeviceNodes.Get (i)->AddApplication (edApp);
+      edApp->SetStartTime (Seconds (1.0 + i));
+      edApp->SetStopTime (Seconds (20.0));
+    }
+
+  // BasicEnergySource integrates the current draw of the model on every state
+  // change, GetRemainingEnergy also integrates the sleep time since the last one
+  double sourceJ = 0.0, modelJ = 0.0;
+  Simulator::Schedule (Seconds (19.0), &LoRaWANRadioEnergyModelEndDeviceTestCase::GetConsumedEnergy,
+                       DynamicCast<BasicEnergySource> (sources.Get (0)), models.Get (0), &sourceJ, &modelJ);
+
+  Simulator::Stop (Seconds (20.0));
+  Simulator::Run ();
+
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      Ptr<LoRaWANRadioEnergyModel> model = endDevices.Get (i)->GetObject<LoRaWANRadioEnergyModel> ();
+      NS_TEST_ASSERT_MSG_NE (model, 0, "The model should be aggregated to the net device");
+      const Time txTime = txEnd[i] - txStart[i];
+      NS_TEST_ASSERT_MSG_EQ (txTime.IsStrictlyPositive (), true, "The end device should have transmitted");
+      NS_TEST_ASSERT_MSG_EQ (model->GetTimeInState (LORAWAN_PHY_BUSY_TX), txTime, "The model should be in BUSY_TX during the transmission");
+      NS_TEST_ASSERT_MSG_EQ (model->GetTimeInState (LORAWAN_PHY_RX_ON).IsStrictlyPositive (), true, "The end device should have opened its receive windows");
+      NS_TEST_ASSERT_MSG_EQ (model->GetCurrentState (), LORAWAN_PHY_TRX_OFF, "The end device should sleep in between transmissions");
+
+      const double txPower = DynamicCast<LoRaWANNetDevice> (endDevices.Get (i))->GetPhy ()->GetTxPower ();
+      NS_TEST_ASSERT_MSG_GT (model->GetTotalChargeConsumption (), txTime.GetSeconds () * model->GetTxCurrentA (txPower), "The charge should include the transmission");
+    }
+
+  NS_TEST_ASSERT_MSG_GT (sourceJ, 0.0, "The source should have been drained");
+  NS_TEST_ASSERT_MSG_EQ_TOL (sourceJ, modelJ, 1e-9, "The source and the model should agree on the consumed energy");
+
+  Simulator::Destroy ();
+}
+
+// ==============================================================================
+class LoRaWANRadioEnergyModelTestSuite : public TestSuite
+{
+public:
+  LoRaWANRadioEnergyModelTestSuite ();
+};
+
+LoRaWANRadioEnergyModelTestSuite::LoRaWANRadioEnergyModelTestSuite ()
+  : TestSuite ("lorawan-radio-energy-model", UNIT)
+{
+  AddTestCase (new LoRaWANRadioEnergyModelTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANRadioEnergyModelEndDeviceTestCase, TestCase::QUICK);
+}
+
+static LoRaWANRadioEnergyModelTestSuite lorawanRadioEnergyModelTestSuite;
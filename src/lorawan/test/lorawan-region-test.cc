@@ -0,0 +1,207 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include <ns3/log.h>
+#include <ns3/test.h>
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/lorawan-module.h>
+#include "ns3/rng-seed-manager.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-region-test");
+
+class LoRaWANRegionUS915TestCase : public TestCase
+{
+public:
+  LoRaWANRegionUS915TestCase ();
+  virtual ~LoRaWANRegionUS915TestCase ();
+
+private:
+  static void DSMsgReceived (uint32_t *nRx, uint8_t *lastRW, uint32_t deviceAddr, uint8_t msgType, Ptr<const Packet> p, uint8_t rw);
+  virtual void DoRun (void);
+  virtual void DoTeardown (void);
+};
+
+LoRaWANRegionUS915TestCase::LoRaWANRegionUS915TestCase ()
+  : TestCase ("Test the channels, data rates and RX1 mapping of the US915 region")
+{
+}
+
+LoRaWANRegionUS915TestCase::~LoRaWANRegionUS915TestCase ()
+{
+}
+
+void
+LoRaWANRegionUS915TestCase::DSMsgReceived (uint32_t *nRx, uint8_t *lastRW, uint32_t deviceAddr, uint8_t msgType, Ptr<const Packet> p, uint8_t rw)
+{
+  (*nRx)++;
+  *lastRW = rw;
+}
+
+void
+LoRaWANRegionUS915TestCase::DoRun (void)
+{
+  LoRaWANHelper::SetRegion (LORAWAN_REGION_US915); // channel group 1: channels 8 to 15 and 65
+
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::m_supportedChannels.size (), 80, "US915 has 64 + 8 US channels and 8 DS channels");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::m_supportedDataRates.size (), 14, "US915 defines DR0 to DR13");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::GetChannelIndexForFrequency (903900000), 8, "Wrong channel for 903.9 MHz");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::GetChannelIndexForFrequency (904600000), 65, "Wrong channel for 904.6 MHz");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::GetChannelIndexForFrequency (923900000), 73, "Wrong channel for 923.9 MHz");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::GetChannelIndexForFrequency (868100000), -1, "868.1 MHz is not a US915 channel");
+
+  const std::vector<uint8_t> &uplinkChannels = LoRaWAN::GetUplinkChannels (3);
+  NS_TEST_ASSERT_MSG_EQ (uplinkChannels.size (), 8, "Eight 125 kHz channels per channel group");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)uplinkChannels.front (), 8, "Channel group 1 starts at channel 8");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::GetUplinkChannels (4).size (), 1, "One 500 kHz channel per channel group");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::IsUplinkDataRate (6), false, "DR6 is RFU in US915");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::IsUplinkDataRate (10), false, "DR10 is a DS data rate in US915");
+
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)LoRaWAN::GetRX1ChannelIndex (8), 72, "Channel 8 maps on DS channel 0");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)LoRaWAN::GetRX1ChannelIndex (15), 79, "Channel 15 maps on DS channel 7");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)LoRaWAN::GetRX1DataRateIndex (0, 0), 10, "DR0 maps on DR10 in RX1");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)LoRaWAN::GetRX1DataRateIndex (3, 0), 13, "DR3 maps on DR13 in RX1");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)LoRaWAN::GetRX1DataRateIndex (4, 0), 13, "DR4 maps on DR13 in RX1");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)LoRaWAN::GetRX1DataRateIndex (0, 3), 8, "RX1 data rate should not go below DR8");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)LoRaWAN::m_RW2ChannelIndex, 72, "RW2 uses 923.3 MHz");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)LoRaWAN::m_RW2DataRateIndex, 8, "RW2 uses DR8");
+
+  // 8 channels x DR0-3, 1 channel x DR4, 8 DS channels x DR8-13
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::GetGatewayPhyConfigs ().size (), 8 * 4 + 1 + 8 * 6, "Wrong number of gateway PHYs");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::GetGatewayPhyIndex (0, 0), -1, "Channel 0 is not in channel group 1");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::GetGatewayPhyIndex (8, 0), 0, "Channel 8 at DR0 is the first gateway PHY");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::IsValidTxPower (30), true, "30 dBm is allowed in US915");
+  NS_TEST_ASSERT_MSG_EQ ((int16_t)LoRaWAN::GetTxPower (30, 14), 2, "TX power index 14 is 28 dB below the maximum in US915");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)LoRaWANMac::GetMaxMACPayloadSize (0), 19, "Wrong maximum MACPayload size for DR0");
+
+  // A confirmed US packet at DR3 on a 125 kHz channel is acknowledged in RW1
+  // on a 500 kHz DS channel, together with a queued DS packet
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  NodeContainer endDeviceNodes;
+  NodeContainer gatewayNodes;
+  endDeviceNodes.Create (1);
+  gatewayNodes.Create (1);
+
+  Ptr<ListPositionAllocator> positions = CreateObject<ListPositionAllocator> ();
+  positions->Add (Vector (0.0, 0.0, 0.0));
+  positions->Add (Vector (50.0, 0.0, 0.0));
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator (positions);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (endDeviceNodes);
+  mobility.Install (gatewayNodes);
+
+  LoRaWANHelper lorawanHelper;
+  lorawanHelper.SetNbRep (1);
+  lorawanHelper.Install (endDeviceNodes);
+  lorawanHelper.SetDeviceType (LORAWAN_DT_GATEWAY);
+  lorawanHelper.Install (gatewayNodes);
+
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (endDeviceNodes);
+  packetSocket.Install (gatewayNodes);
+
+  LoRaWANNetworkServerHelper nsHelper;
+  Ptr<LoRaWANNetworkServer> networkServer = nsHelper.Create ();
+  ApplicationContainer apps = nsHelper.InstallGateways (networkServer, gatewayNodes);
+  apps.Start (Seconds (0.0));
+  apps.Stop (Seconds (10.0));
+
+  uint32_t nReceived = 0;
+  uint8_t lastRW = 0;
+  Ptr<LoRaWANEndDeviceApplication> edApp = CreateObject<LoRaWANEndDeviceApplication> ();
+  edApp->SetAttribute ("DataRateIndex", UintegerValue (3));
+  edApp->SetAttribute ("ConfirmedDataUp", BooleanValue (true));
+  edApp->SetAttribute ("UpstreamIAT", StringValue ("ns3::ConstantRandomVariable[Constant=100.0]"));
+  edApp->TraceConnectWithoutContext ("DSMsgReceived", MakeBoundCallback (&LoRaWANRegionUS915TestCase::DSMsgReceived, &nReceived, &lastRW));
+  endDeviceNodes.Get (0)->AddApplication (edApp);
+  edApp->SetStartTime (Seconds (1.0));
+  edApp->SetStopTime (Seconds (10.0));
+
+  const Ipv4Address deviceAddr = Ipv4Address::ConvertFrom (endDeviceNodes.Get (0)->GetDevice (0)->GetAddress ());
+  Simulator::Schedule (Seconds (0.5), &LoRaWANNetworkServer::QueueDSPacket, networkServer, deviceAddr, Create<Packet> (8), 1, false);
+
+  Simulator::Stop (Seconds (10.0));
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (nReceived, 1, "The end device should receive the DS packet");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)lastRW, 1, "The DS packet should be received in RW1");
+}
+
+void
+LoRaWANRegionUS915TestCase::DoTeardown (void)
+{
+  // DoRun returns early when an assert fails, so the simulator is destroyed
+  // and the default region is restored for the other test cases here
+  Simulator::Destroy ();
+  LoRaWANHelper::SetRegion (LORAWAN_REGION_EU868);
+}
+
+class LoRaWANRegionEU868TestCase : public TestCase
+{
+public:
+  LoRaWANRegionEU868TestCase ();
+  virtual ~LoRaWANRegionEU868TestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANRegionEU868TestCase::LoRaWANRegionEU868TestCase ()
+  : TestCase ("Test the channels and TX powers of the default EU868 region")
+{
+}
+
+LoRaWANRegionEU868TestCase::~LoRaWANRegionEU868TestCase ()
+{
+}
+
+void
+LoRaWANRegionEU868TestCase::DoRun (void)
+{
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::GetRegion (), LORAWAN_REGION_EU868, "EU868 should be restored after a test case that changed the region");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::m_supportedChannels.size (), 8, "EU868 has 8 channels");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)LoRaWAN::GetRX1ChannelIndex (2), 2, "RX1 uses the US channel in EU868");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::GetGatewayPhyConfigs ().size (), 8 * 7, "Wrong number of gateway PHYs");
+  NS_TEST_ASSERT_MSG_EQ ((int16_t)LoRaWAN::GetTxPower (14, 0), 14, "TX power index 0 is the maximum power of the sub band");
+  NS_TEST_ASSERT_MSG_EQ ((int16_t)LoRaWAN::GetTxPower (14, 1), 11, "TX power index 1 is the next power in the EU868 table");
+  NS_TEST_ASSERT_MSG_EQ ((int16_t)LoRaWAN::GetTxPower (14, 4), 2, "TX power index 4 is the lowest power in the EU868 table");
+  NS_TEST_ASSERT_MSG_EQ ((int16_t)LoRaWAN::GetTxPower (14, 7), 2, "TX power indexes past the EU868 table give the lowest power");
+  NS_TEST_ASSERT_MSG_EQ ((int16_t)LoRaWAN::GetTxPower (27, 1), 20, "The high power sub band starts at 27 dBm");
+}
+
+class LoRaWANRegionTestSuite : public TestSuite
+{
+public:
+  LoRaWANRegionTestSuite ();
+};
+
+LoRaWANRegionTestSuite::LoRaWANRegionTestSuite ()
+  : TestSuite ("lorawan-region", UNIT)
+{
+  AddTestCase (new LoRaWANRegionUS915TestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANRegionEU868TestCase, TestCase::QUICK);
+}
+
+static LoRaWANRegionTestSuite lorawanRegionTestSuite;
@@ -0,0 +1,419 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include <ns3/log.h>
+#include <ns3/core-module.h>
+#include <ns3/lorawan-module.h>
+#include <ns3/propagation-loss-model.h>
+#include <ns3/propagation-delay-model.h>
+#include <ns3/simulator.h>
+#include <ns3/constant-position-mobility-model.h>
+#include <ns3/node.h>
+#include <ns3/packet.h>
+#include "ns3/rng-seed-manager.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-spectrum-channel-test");
+
+class LoRaWANSpectrumChannelTestCase : public TestCase
+{
+public:
+  LoRaWANSpectrumChannelTestCase ();
+  virtual ~LoRaWANSpectrumChannelTestCase ();
+
+  static void SendUplink (Ptr<LoRaWANNetDevice> dev, uint8_t channelIndex);
+
+private:
+  static void PathLoss (LoRaWANSpectrumChannelTestCase *testCase, Ptr<SpectrumPhy> txPhy, Ptr<SpectrumPhy> rxPhy, double lossDb);
+  static void GatewayDataIndication (LoRaWANSpectrumChannelTestCase *testCase, LoRaWANDataIndicationParams params, Ptr<Packet> p);
+  virtual void DoRun (void);
+
+  uint32_t m_nDeliveries;
+  uint32_t m_nReceived;
+};
+
+LoRaWANSpectrumChannelTestCase::LoRaWANSpectrumChannelTestCase ()
+  : TestCase ("Test that LoRaWANSpectrumChannel only delivers transmissions to co-channel receivers"),
+    m_nDeliveries (0),
+    m_nReceived (0)
+{
+}
+
+LoRaWANSpectrumChannelTestCase::~LoRaWANSpectrumChannelTestCase ()
+{
+}
+
+void
+LoRaWANSpectrumChannelTestCase::PathLoss (LoRaWANSpectrumChannelTestCase *testCase, Ptr<SpectrumPhy> txPhy, Ptr<SpectrumPhy> rxPhy, double lossDb)
+{
+  testCase->m_nDeliveries++;
+}
+
+void
+LoRaWANSpectrumChannelTestCase::GatewayDataIndication (LoRaWANSpectrumChannelTestCase *testCase, LoRaWANDataIndicationParams params, Ptr<Packet> p)
+{
+  testCase->m_nReceived++;
+}
+
+void
+LoRaWANSpectrumChannelTestCase::SendUplink (Ptr<LoRaWANNetDevice> dev, uint8_t channelIndex)
+{
+  LoRaWANDataRequestParams params;
+  params.m_loraWANChannelIndex = channelIndex;
+  params.m_loraWANDataRateIndex = 5;
+  params.m_loraWANCodeRate = 3;
+  params.m_msgType = LORAWAN_UNCONFIRMED_DATA_UP;
+  params.m_requestHandle = 1;
+  params.m_numberOfTransmissions = 1;
+  dev->GetMac ()->sendMACPayloadRequest (params, Create<Packet> (20));
+}
+
+void
+LoRaWANSpectrumChannelTestCase::DoRun (void)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (6);
+
+  Ptr<LoRaWANSpectrumChannel> channel = CreateObject<LoRaWANSpectrumChannel> ();
+  channel->AddPropagationLossModel (CreateObject<LogDistancePropagationLossModel> ());
+  channel->SetPropagationDelayModel (CreateObject<ConstantSpeedPropagationDelayModel> ());
+  channel->TraceConnectWithoutContext ("PathLoss", MakeBoundCallback (&LoRaWANSpectrumChannelTestCase::PathLoss, this));
+
+  // Four end devices and a gateway with a shared receiver
+  std::vector<Ptr<LoRaWANNetDevice> > devs;
+  for (uint32_t i = 0; i < 4; i++) {
+    Ptr<Node> n = CreateObject<Node> ();
+    Ptr<LoRaWANNetDevice> dev = CreateObject<LoRaWANNetDevice> (LORAWAN_DT_END_DEVICE_CLASS_A);
+    dev->SetAddress (Ipv4Address (i + 1));
+    dev->SetChannel (channel);
+    n->AddDevice (dev);
+    Ptr<ConstantPositionMobilityModel> mobility = CreateObject<ConstantPositionMobilityModel> ();
+    mobility->SetPosition (Vector (10*(i+1),0,0));
+    dev->GetPhy ()->SetMobility (mobility);
+    devs.push_back (dev);
+  }
+
+  Ptr<Node> gw = CreateObject<Node> ();
+  Ptr<LoRaWANNetDevice> dev_gw = CreateObject<LoRaWANNetDevice> (LORAWAN_DT_GATEWAY);
+  dev_gw->SetChannel (channel);
+  gw->AddDevice (dev_gw);
+  Ptr<ConstantPositionMobilityModel> gwMobility = CreateObject<ConstantPositionMobilityModel> ();
+  for (auto &it : dev_gw->GetPhys ()) {
+    it->SetMobility (gwMobility);
+  }
+  for (auto &it : dev_gw->GetMacs ()) {
+    it->SetDataIndicationCallback (MakeBoundCallback (&LoRaWANSpectrumChannelTestCase::GatewayDataIndication, this));
+  }
+
+  // All end device phys start on channel 0
+  NS_TEST_ASSERT_MSG_EQ (channel->GetNRxOnChannel (0), 4, "End devices should be registered on channel 0");
+  NS_TEST_ASSERT_MSG_EQ (channel->GetNDevices (), 5, "Expected four end devices and one gateway receiver");
+
+  // Retune one end device to channel 1
+  devs[3]->GetPhy ()->SetTxConf (14, 1, 5, 3, 8, false, true);
+  NS_TEST_ASSERT_MSG_EQ (channel->GetNRxOnChannel (0), 3, "Retuned phy should be removed from channel 0");
+  NS_TEST_ASSERT_MSG_EQ (channel->GetNRxOnChannel (1), 1, "Retuned phy should be added to channel 1");
+
+  // An uplink from device 0 on channel 0 should reach the two other end
+  // devices on channel 0 and the gateway, but not the end device on channel 1
+  Simulator::Schedule (Seconds (1.0), &LoRaWANSpectrumChannelTestCase::SendUplink, devs[0], 0);
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (m_nDeliveries, 3, "Transmission should only be delivered to co-channel receivers");
+  NS_TEST_ASSERT_MSG_EQ (m_nReceived, 1, "Gateway should have received the uplink");
+
+  Simulator::Destroy ();
+}
+
+// ==============================================================================
+class LoRaWANSpectrumChannelLinkCacheTestCase : public TestCase
+{
+public:
+  LoRaWANSpectrumChannelLinkCacheTestCase ();
+  virtual ~LoRaWANSpectrumChannelLinkCacheTestCase ();
+
+private:
+  static void PathLoss (std::vector<double> *losses, Ptr<SpectrumPhy> txPhy, Ptr<SpectrumPhy> rxPhy, double lossDb);
+  static void GatewayDataIndication (uint32_t *nReceived, LoRaWANDataIndicationParams params, Ptr<Packet> p);
+  /**
+   * Let four end devices send uplinks to two gateways, move one gateway
+   * halfway through.
+   *
+   * \param cacheLinkGains whether the channel caches link gains
+   * \param maxCachedLinks the maximum number of cached links per transmitter
+   * \param losses the path losses reported by the channel (output)
+   * \return the number of packets received by the gateways
+   */
+  uint32_t RunScenario (bool cacheLinkGains, uint32_t maxCachedLinks, std::vector<double> &losses);
+  void CheckCachedLinks (Ptr<LoRaWANSpectrumChannel> channel, uint32_t maxCachedLinks);
+  void CheckInvalidatedLinks (Ptr<LoRaWANSpectrumChannel> channel, uint32_t nInvalidated);
+  virtual void DoRun (void);
+
+  uint32_t m_nCachedLinks;
+};
+
+LoRaWANSpectrumChannelLinkCacheTestCase::LoRaWANSpectrumChannelLinkCacheTestCase ()
+  : TestCase ("Test that cached link gains give the same results and are invalidated on course changes"),
+    m_nCachedLinks (0)
+{
+}
+
+LoRaWANSpectrumChannelLinkCacheTestCase::~LoRaWANSpectrumChannelLinkCacheTestCase ()
+{
+}
+
+void
+LoRaWANSpectrumChannelLinkCacheTestCase::PathLoss (std::vector<double> *losses, Ptr<SpectrumPhy> txPhy, Ptr<SpectrumPhy> rxPhy, double lossDb)
+{
+  losses->push_back (lossDb);
+}
+
+void
+LoRaWANSpectrumChannelLinkCacheTestCase::GatewayDataIndication (uint32_t *nReceived, LoRaWANDataIndicationParams params, Ptr<Packet> p)
+{
+  (*nReceived)++;
+}
+
+void
+LoRaWANSpectrumChannelLinkCacheTestCase::CheckCachedLinks (Ptr<LoRaWANSpectrumChannel> channel, uint32_t maxCachedLinks)
+{
+  m_nCachedLinks = channel->GetNCachedLinkGains ();
+  if (maxCachedLinks == 0)
+    {
+      // Links between end devices are cached as well
+      NS_TEST_EXPECT_MSG_GT (m_nCachedLinks, 4*2, "Expected links to the gateways and between end devices");
+    }
+  else
+    {
+      // Only the links of every end device to the strongest gateways
+      NS_TEST_EXPECT_MSG_EQ (m_nCachedLinks, 4*std::min (maxCachedLinks, 2u), "Expected only links to the strongest gateways");
+    }
+}
+
+void
+LoRaWANSpectrumChannelLinkCacheTestCase::CheckInvalidatedLinks (Ptr<LoRaWANSpectrumChannel> channel, uint32_t nInvalidated)
+{
+  NS_TEST_EXPECT_MSG_EQ (channel->GetNCachedLinkGains (), m_nCachedLinks - nInvalidated, "Links of the moved gateway should have been invalidated");
+}
+
+uint32_t
+LoRaWANSpectrumChannelLinkCacheTestCase::RunScenario (bool cacheLinkGains, uint32_t maxCachedLinks, std::vector<double> &losses)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (6);
+
+  Ptr<LoRaWANSpectrumChannel> channel = CreateObject<LoRaWANSpectrumChannel> ();
+  channel->SetAttribute ("CacheLinkGains", BooleanValue (cacheLinkGains));
+  channel->SetAttribute ("MaxCachedLinks", UintegerValue (maxCachedLinks));
+  channel->AddPropagationLossModel (CreateObject<LogDistancePropagationLossModel> ());
+  channel->SetPropagationDelayModel (CreateObject<ConstantSpeedPropagationDelayModel> ());
+  channel->TraceConnectWithoutContext ("PathLoss", MakeBoundCallback (&LoRaWANSpectrumChannelLinkCacheTestCase::PathLoss, &losses));
+
+  std::vector<Ptr<LoRaWANNetDevice> > devs;
+  for (uint32_t i = 0; i < 4; i++) {
+    Ptr<Node> n = CreateObject<Node> ();
+    Ptr<LoRaWANNetDevice> dev = CreateObject<LoRaWANNetDevice> (LORAWAN_DT_END_DEVICE_CLASS_A);
+    dev->SetAddress (Ipv4Address (i + 1));
+    dev->SetChannel (channel);
+    n->AddDevice (dev);
+    dev->AssignStreams (i);
+    Ptr<ConstantPositionMobilityModel> mobility = CreateObject<ConstantPositionMobilityModel> ();
+    mobility->SetPosition (Vector (500*(i+1),0,0));
+    dev->GetPhy ()->SetMobility (mobility);
+    devs.push_back (dev);
+  }
+
+  uint32_t nReceived = 0;
+  std::vector<Ptr<ConstantPositionMobilityModel> > gwMobilities;
+  for (uint32_t i = 0; i < 2; i++) {
+    Ptr<Node> gw = CreateObject<Node> ();
+    Ptr<LoRaWANNetDevice> dev_gw = CreateObject<LoRaWANNetDevice> (LORAWAN_DT_GATEWAY);
+    dev_gw->SetChannel (channel);
+    gw->AddDevice (dev_gw);
+    dev_gw->AssignStreams (100 + 100*i);
+    Ptr<ConstantPositionMobilityModel> gwMobility = CreateObject<ConstantPositionMobilityModel> ();
+    gwMobility->SetPosition (Vector (0,1000.0*i,0));
+    for (auto &it : dev_gw->GetPhys ()) {
+      it->SetMobility (gwMobility);
+    }
+    for (auto &it : dev_gw->GetMacs ()) {
+      it->SetDataIndicationCallback (MakeBoundCallback (&LoRaWANSpectrumChannelLinkCacheTestCase::GatewayDataIndication, &nReceived));
+    }
+    gwMobilities.push_back (gwMobility);
+  }
+
+  for (uint32_t j = 0; j < 4; j++) {
+    for (uint32_t i = 0; i < devs.size (); i++) {
+      Simulator::Schedule (Seconds (10*j + i), &LoRaWANSpectrumChannelTestCase::SendUplink, devs[i], 0);
+    }
+  }
+  // Move the second gateway out of range of the end devices
+  Simulator::Schedule (Seconds (15), &ConstantPositionMobilityModel::SetPosition, gwMobilities[1], Vector (0,100000,0));
+
+  if (cacheLinkGains)
+    {
+      Simulator::Schedule (Seconds (14), &LoRaWANSpectrumChannelLinkCacheTestCase::CheckCachedLinks, this, channel, maxCachedLinks);
+      // The links of the end devices to the moved gateway are invalidated.
+      // The moved gateway is the weakest gateway of every end device, so its
+      // links are not cached when only one link per end device is cached.
+      Simulator::Schedule (Seconds (15.5), &LoRaWANSpectrumChannelLinkCacheTestCase::CheckInvalidatedLinks, this, channel, maxCachedLinks == 1 ? 0 : 4);
+    }
+
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  return nReceived;
+}
+
+void
+LoRaWANSpectrumChannelLinkCacheTestCase::DoRun (void)
+{
+  std::vector<double> uncachedLosses;
+  uint32_t uncachedReceived = RunScenario (false, 0, uncachedLosses);
+  NS_TEST_ASSERT_MSG_GT (uncachedReceived, 0, "Gateways did not receive any packets");
+
+  const uint32_t maxCachedLinks[] = {0, 1, 2};
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      std::vector<double> cachedLosses;
+      uint32_t cachedReceived = RunScenario (true, maxCachedLinks[i], cachedLosses);
+      NS_TEST_ASSERT_MSG_EQ (cachedReceived, uncachedReceived, "Caching should not change receptions (MaxCachedLinks = " << maxCachedLinks[i] << ")");
+      NS_TEST_ASSERT_MSG_EQ (cachedLosses.size (), uncachedLosses.size (), "Caching should not change deliveries");
+      for (uint32_t j = 0; j < cachedLosses.size () && j < uncachedLosses.size (); j++)
+        {
+          NS_TEST_ASSERT_MSG_EQ_TOL (cachedLosses[j], uncachedLosses[j], 1e-9, "Caching should not change the path loss of delivery " << j);
+        }
+    }
+}
+
+// ==============================================================================
+class LoRaWANSpectrumChannelDetachTestCase : public TestCase
+{
+public:
+  LoRaWANSpectrumChannelDetachTestCase ();
+  virtual ~LoRaWANSpectrumChannelDetachTestCase ();
+
+private:
+  static void PhyRxDrop (std::vector<uint32_t> *drops, Ptr<const Packet> p, LoRaWANPhyDropRxReason reason);
+  void CheckDetachedRx (Ptr<LoRaWANSpectrumChannel> channel, uint32_t nDetached);
+  void RunScenario (bool detachSleepingRx, std::vector<uint32_t> &drops);
+  virtual void DoRun (void);
+};
+
+LoRaWANSpectrumChannelDetachTestCase::LoRaWANSpectrumChannelDetachTestCase ()
+  : TestCase ("Test that detaching sleeping receivers from LoRaWANSpectrumChannel does not change the interference")
+{
+}
+
+LoRaWANSpectrumChannelDetachTestCase::~LoRaWANSpectrumChannelDetachTestCase ()
+{
+}
+
+void
+LoRaWANSpectrumChannelDetachTestCase::PhyRxDrop (std::vector<uint32_t> *drops, Ptr<const Packet> p, LoRaWANPhyDropRxReason reason)
+{
+  // A detached receiver does not trace the transmissions it misses
+  if (reason != LORAWAN_RX_DROP_NOT_IN_RX_STATE)
+    drops->push_back (reason);
+}
+
+void
+LoRaWANSpectrumChannelDetachTestCase::CheckDetachedRx (Ptr<LoRaWANSpectrumChannel> channel, uint32_t nDetached)
+{
+  NS_TEST_ASSERT_MSG_EQ (channel->GetNDetachedRx (), nDetached, "Unexpected number of detached receivers");
+}
+
+void
+LoRaWANSpectrumChannelDetachTestCase::RunScenario (bool detachSleepingRx, std::vector<uint32_t> &drops)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (6);
+
+  Ptr<LoRaWANSpectrumChannel> channel = CreateObject<LoRaWANSpectrumChannel> ();
+  channel->SetAttribute ("DetachSleepingRx", BooleanValue (detachSleepingRx));
+  channel->AddPropagationLossModel (CreateObject<LogDistancePropagationLossModel> ());
+  channel->SetPropagationDelayModel (CreateObject<ConstantSpeedPropagationDelayModel> ());
+
+  // Device 1 is the receiver, device 0 is a strong and device 2 a weak
+  // transmitter on the same channel and data rate
+  const double distances[] = {10.0, 0.0, 1000.0};
+  std::vector<Ptr<LoRaWANNetDevice> > devs;
+  for (uint32_t i = 0; i < 3; i++) {
+    Ptr<Node> n = CreateObject<Node> ();
+    Ptr<LoRaWANNetDevice> dev = CreateObject<LoRaWANNetDevice> (LORAWAN_DT_END_DEVICE_CLASS_A);
+    dev->SetAddress (Ipv4Address (i + 1));
+    dev->SetChannel (channel);
+    n->AddDevice (dev);
+    Ptr<ConstantPositionMobilityModel> mobility = CreateObject<ConstantPositionMobilityModel> ();
+    mobility->SetPosition (Vector (distances[i],0,0));
+    dev->GetPhy ()->SetMobility (mobility);
+    devs.push_back (dev);
+  }
+
+  devs[1]->GetPhy ()->TraceConnectWithoutContext ("PhyRxDrop", MakeBoundCallback (&LoRaWANSpectrumChannelDetachTestCase::PhyRxDrop, &drops));
+
+  // All end device phys are off, so none of them is registered on channel 0
+  CheckDetachedRx (channel, detachSleepingRx ? 3 : 0);
+  NS_TEST_ASSERT_MSG_EQ (channel->GetNRxOnChannel (0), (detachSleepingRx ? 0 : 3), "Unexpected number of receivers on channel 0");
+
+  // Device 1 starts listening during the uplink of device 0, and should not
+  // be able to receive the uplink of device 2. Device 0 is transmitting and
+  // device 2 is off, so both are detached.
+  Simulator::Schedule (Seconds (1.0), &LoRaWANSpectrumChannelTestCase::SendUplink, devs[0], 0);
+  Simulator::Schedule (Seconds (1.02), &LoRaWANPhy::SetTRXStateRequest, devs[1]->GetPhy (), LORAWAN_PHY_RX_ON);
+  Simulator::Schedule (Seconds (1.025), &LoRaWANSpectrumChannelDetachTestCase::CheckDetachedRx, this, channel, detachSleepingRx ? 2 : 0);
+  Simulator::Schedule (Seconds (1.03), &LoRaWANSpectrumChannelTestCase::SendUplink, devs[2], 0);
+  Simulator::Run ();
+  Simulator::Destroy ();
+}
+
+void
+LoRaWANSpectrumChannelDetachTestCase::DoRun (void)
+{
+  std::vector<uint32_t> attachedDrops;
+  std::vector<uint32_t> detachedDrops;
+  RunScenario (false, attachedDrops);
+  RunScenario (true, detachedDrops);
+
+  NS_TEST_ASSERT_MSG_EQ (attachedDrops.size (), 1, "The receiver should drop the uplink of device 2");
+  NS_TEST_ASSERT_MSG_EQ (detachedDrops.size (), attachedDrops.size (), "Detaching should not change the drops");
+  for (uint32_t i = 0; i < attachedDrops.size () && i < detachedDrops.size (); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (attachedDrops[i], LORAWAN_RX_DROP_SINR_TOO_LOW, "The uplink of device 0 should interfere with the uplink of device 2");
+      NS_TEST_ASSERT_MSG_EQ (detachedDrops[i], attachedDrops[i], "Detaching should not change the drop reason");
+    }
+}
+
+// ==============================================================================
+class LoRaWANSpectrumChannelTestSuite : public TestSuite
+{
+public:
+  LoRaWANSpectrumChannelTestSuite ();
+};
+
+LoRaWANSpectrumChannelTestSuite::LoRaWANSpectrumChannelTestSuite ()
+  : TestSuite ("lorawan-spectrum-channel", UNIT)
+{
+  AddTestCase (new LoRaWANSpectrumChannelTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANSpectrumChannelLinkCacheTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANSpectrumChannelDetachTestCase, TestCase::QUICK);
+}
+
+static LoRaWANSpectrumChannelTestSuite lorawanSpectrumChannelTestSuite;
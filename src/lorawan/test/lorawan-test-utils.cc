@@ -0,0 +1,43 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include "lorawan-test-utils.h"
+
+namespace ns3 {
+
+void
+LoRaWANTestUtils::CountPacket (uint32_t *nPackets, Ptr<const Packet> p)
+{
+  (*nPackets)++;
+}
+
+void
+LoRaWANTestUtils::CounterChanged (uint32_t *counter, uint32_t oldValue, uint32_t newValue)
+{
+  *counter = newValue;
+}
+
+void
+LoRaWANTestUtils::MaxChanged (uint32_t *max, uint32_t oldValue, uint32_t newValue)
+{
+  if (newValue > *max)
+    *max = newValue;
+}
+
+} // namespace ns3
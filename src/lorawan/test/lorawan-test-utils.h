@@ -0,0 +1,54 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#ifndef LORAWAN_TEST_UTILS_H
+#define LORAWAN_TEST_UTILS_H
+
+#include <ns3/ptr.h>
+#include <ns3/packet.h>
+#include <stdint.h>
+
+namespace ns3 {
+
+/**
+ * \ingroup lorawan
+ *
+ * Trace sinks shared by the LoRaWAN test suites. They are bound to a
+ * counter of the test case with MakeBoundCallback.
+ */
+class LoRaWANTestUtils
+{
+public:
+  /**
+   * Count the packets of a packet trace source, e.g. Tx of a gateway
+   */
+  static void CountPacket (uint32_t *nPackets, Ptr<const Packet> p);
+  /**
+   * Copy the new value of a TracedValue counter
+   */
+  static void CounterChanged (uint32_t *counter, uint32_t oldValue, uint32_t newValue);
+  /**
+   * Keep the largest value of a TracedValue, e.g. the size of a queue
+   */
+  static void MaxChanged (uint32_t *max, uint32_t oldValue, uint32_t newValue);
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_TEST_UTILS_H */
@@ -0,0 +1,120 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include <ns3/log.h>
+#include <ns3/test.h>
+#include <ns3/simulator.h>
+#include <ns3/lorawan-module.h>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-timer-wheel-test");
+
+class LoRaWANTimerWheelTestCase : public TestCase
+{
+public:
+  LoRaWANTimerWheelTestCase ();
+  virtual ~LoRaWANTimerWheelTestCase ();
+
+private:
+  void Expire (uint32_t id, uint8_t type);
+  virtual void DoRun (void);
+
+  LoRaWANTimerWheel m_wheel;
+  std::vector<uint32_t> m_ids;
+  std::vector<Time> m_times;
+};
+
+LoRaWANTimerWheelTestCase::LoRaWANTimerWheelTestCase ()
+  : TestCase ("Test the timer wheel of the network server")
+{
+}
+
+LoRaWANTimerWheelTestCase::~LoRaWANTimerWheelTestCase ()
+{
+}
+
+void
+LoRaWANTimerWheelTestCase::Expire (uint32_t id, uint8_t type)
+{
+  m_ids.push_back (id);
+  m_times.push_back (Simulator::Now ());
+  if (id == 3) // timers scheduled while expiring go to a later tick
+    m_wheel.Schedule (Seconds (0), 6, 0);
+}
+
+void
+LoRaWANTimerWheelTestCase::DoRun (void)
+{
+  m_wheel.SetExpireCallback (MakeCallback (&LoRaWANTimerWheelTestCase::Expire, this));
+
+  NS_TEST_ASSERT_MSG_EQ (m_wheel.Schedule (MicroSeconds (1000300), 1, 0), MilliSeconds (1001), "Timers should be rounded up");
+  m_wheel.Schedule (MicroSeconds (1000100), 2, 0);
+  m_wheel.Schedule (MicroSeconds (500), 3, 0);
+  m_wheel.Schedule (Seconds (10), 4, 0); // beyond one revolution of the wheel
+  m_wheel.Schedule (MicroSeconds (1000200), 5, 0);
+  NS_TEST_ASSERT_MSG_EQ (m_wheel.GetNPending (), 5, "Wrong number of pending timers");
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (m_wheel.GetNExpired (), 6, "All timers should have expired");
+  NS_TEST_ASSERT_MSG_EQ (m_wheel.GetNPending (), 0, "No timers should be pending");
+  const uint32_t ids[] = {3, 6, 1, 2, 5, 4};
+  const Time times[] = {MilliSeconds (1), MilliSeconds (2), MilliSeconds (1001), MilliSeconds (1001), MilliSeconds (1001), Seconds (10)};
+  for (uint32_t k = 0; k < 6; k++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (m_ids[k], ids[k], "Timers expired in the wrong order");
+      NS_TEST_ASSERT_MSG_EQ (m_times[k], times[k], "Timer expired at the wrong time");
+    }
+
+  // Timers in the same tick share a simulator event
+  uint64_t nEvents = m_wheel.GetNEvents ();
+  for (uint32_t k = 0; k < 100; k++)
+    m_wheel.Schedule (MicroSeconds (1000001 + k), 100 + k, 0);
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (m_wheel.GetNEvents () - nEvents, 1, "Timers in the same tick should share a simulator event");
+  NS_TEST_ASSERT_MSG_EQ (m_wheel.GetNExpired (), 106, "All timers should have expired");
+
+  // Without a resolution, every timer expires at its exact time
+  m_ids.clear ();
+  m_times.clear ();
+  m_wheel.SetResolution (Seconds (0));
+  m_wheel.Schedule (MicroSeconds (1000300), 1, 0);
+  m_wheel.Schedule (MicroSeconds (1000100), 2, 0);
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (m_ids.size (), 2, "All timers should have expired");
+  NS_TEST_ASSERT_MSG_EQ (m_ids[0], 2, "Timers expired in the wrong order");
+  NS_TEST_ASSERT_MSG_EQ (m_times[0], Simulator::Now () - MicroSeconds (200), "Timer expired at the wrong time");
+
+  Simulator::Destroy ();
+}
+
+class LoRaWANTimerWheelTestSuite : public TestSuite
+{
+public:
+  LoRaWANTimerWheelTestSuite ();
+};
+
+LoRaWANTimerWheelTestSuite::LoRaWANTimerWheelTestSuite ()
+  : TestSuite ("lorawan-timer-wheel", UNIT)
+{
+  AddTestCase (new LoRaWANTimerWheelTestCase, TestCase::QUICK);
+}
+
+static LoRaWANTimerWheelTestSuite lorawanTimerWheelTestSuite;
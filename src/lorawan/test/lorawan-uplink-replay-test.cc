@@ -0,0 +1,328 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 IDLab-imec
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
+ */
+#include <ns3/log.h>
+#include <ns3/test.h>
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/lorawan-module.h>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-uplink-replay-test");
+
+/**
+ * An uplink that was sent by the generator.
+ */
+typedef struct
+{
+  Time m_time;
+  uint32_t m_devAddr;
+  uint32_t m_size;
+  uint8_t m_dataRateIndex;
+  uint8_t m_channelIndex;
+} SentUplink;
+
+static void
+PhyTxBegin (std::vector<SentUplink> *log, uint32_t devAddr, Ptr<LoRaWANPhy> phy, Ptr<const Packet> p)
+{
+  SentUplink uplink;
+  uplink.m_time = Simulator::Now ();
+  uplink.m_devAddr = devAddr;
+  uplink.m_size = p->GetSize ();
+  uplink.m_dataRateIndex = phy->GetCurrentDataRateIndex ();
+  uplink.m_channelIndex = phy->GetCurrentChannelIndex ();
+  log->push_back (uplink);
+}
+
+/**
+ * Create end devices, install them on the generator and log the uplinks that
+ * their PHYs send. The replay is checked at the end devices, so there is no
+ * gateway or network server.
+ */
+static NetDeviceContainer
+CreateEndDevices (uint32_t nEndDevices, Ptr<LoRaWANBulkTrafficGenerator> generator, std::vector<SentUplink> *log)
+{
+  NodeContainer endDeviceNodes;
+  endDeviceNodes.Create (nEndDevices);
+
+  MobilityHelper mobility;
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (endDeviceNodes);
+
+  LoRaWANHelper lorawanHelper;
+  lorawanHelper.SetNbRep (1);
+  NetDeviceContainer endDevices = lorawanHelper.Install (endDeviceNodes);
+  generator->Install (endDevices);
+
+  for (uint32_t i = 0; i < nEndDevices; i++)
+    {
+      Ptr<LoRaWANNetDevice> device = DynamicCast<LoRaWANNetDevice> (endDevices.Get (i));
+      const uint32_t devAddr = Ipv4Address::ConvertFrom (device->GetAddress ()).Get ();
+      device->GetPhy ()->TraceConnectWithoutContext ("PhyTxBegin", MakeBoundCallback (&PhyTxBegin, log, devAddr, device->GetPhy ()));
+    }
+  return endDevices;
+}
+
+static uint32_t
+GetDevAddr (NetDeviceContainer devices, uint32_t i)
+{
+  return Ipv4Address::ConvertFrom (devices.Get (i)->GetAddress ()).Get ();
+}
+
+// ==============================================================================
+class LoRaWANUplinkReplayCsvTestCase : public TestCase
+{
+public:
+  LoRaWANUplinkReplayCsvTestCase ();
+  virtual ~LoRaWANUplinkReplayCsvTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANUplinkReplayCsvTestCase::LoRaWANUplinkReplayCsvTestCase ()
+  : TestCase ("Test the replay of a CSV uplink log")
+{
+}
+
+LoRaWANUplinkReplayCsvTestCase::~LoRaWANUplinkReplayCsvTestCase ()
+{
+}
+
+void
+LoRaWANUplinkReplayCsvTestCase::DoRun (void)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  std::vector<SentUplink> log;
+  Ptr<LoRaWANBulkTrafficGenerator> generator = CreateObject<LoRaWANBulkTrafficGenerator> ();
+  // Every uplink is sent by another end device, as the duty cycle delays a
+  // next uplink of an end device
+  NetDeviceContainer endDevices = CreateEndDevices (5, generator, &log);
+
+  const std::string filename = CreateTempDirFilename ("uplinks.csv");
+  std::ofstream csv (filename.c_str ());
+  csv << std::hex << std::setfill ('0');
+  csv << "devaddr,time,size,dr,channel" << std::endl; // header, skipped as malformed
+  csv << "# a comment" << std::endl;
+  csv << std::setw (8) << GetDevAddr (endDevices, 0) << ",1000.0,20,5,0" << std::endl; // before LogStartTime
+  csv << std::setw (8) << GetDevAddr (endDevices, 0) << ",1001.0,30,5,1" << std::endl;
+  csv << std::endl;
+  csv << std::setw (8) << GetDevAddr (endDevices, 1) << ",1001.5,25,4,868.5" << std::endl; // channel in MHz
+  csv << std::setw (8) << GetDevAddr (endDevices, 2) << ",1001.5,40,3,868300000,-110.5,7.25" << std::endl; // frequency in Hz, extra fields
+  csv << "deadbeef,1002.0,20,5,0" << std::endl; // unknown device address
+  csv << std::setw (8) << GetDevAddr (endDevices, 3) << ",1003.0,20,5,1" << std::endl;
+  csv << std::setw (8) << GetDevAddr (endDevices, 4) << ",1002.5,20,5,2" << std::endl; // out of order
+  csv << std::setw (8) << GetDevAddr (endDevices, 0) << ",1004.0,20,9,0" << std::endl; // downlink data rate
+  csv << std::setw (8) << GetDevAddr (endDevices, 0) << ",1004.0,20,5"; // missing field and no newline
+  csv.close ();
+
+  Ptr<LoRaWANUplinkReplay> replay = CreateObject<LoRaWANUplinkReplay> ();
+  replay->SetAttribute ("Filename", StringValue (filename));
+  replay->SetAttribute ("LogStartTime", DoubleValue (1000.5));
+  replay->SetGenerator (generator);
+  replay->Start (Seconds (10.0));
+  Simulator::Stop (Seconds (20.0));
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (replay->GetNSkipped (), 1, "The uplink before LogStartTime should be skipped");
+  NS_TEST_ASSERT_MSG_EQ (replay->GetNDropped (), 2, "The uplinks of the unknown device and the downlink data rate should be dropped");
+  NS_TEST_ASSERT_MSG_EQ (replay->GetNLate (), 1, "The out of order uplink should be late");
+  NS_TEST_ASSERT_MSG_EQ (replay->GetNInjected (), 5, "Wrong number of injected uplinks");
+  NS_TEST_ASSERT_MSG_EQ (replay->GetReader ().GetNMalformed (), 2, "The header and the incomplete line should be malformed");
+  NS_TEST_ASSERT_MSG_EQ (replay->GetReader ().IsOpen (), false, "The log should be closed at its end");
+
+  NS_TEST_ASSERT_MSG_EQ (log.size (), 5, "Every injected uplink should be transmitted");
+  NS_TEST_ASSERT_MSG_EQ (log[0].m_time, Seconds (10.5), "The first uplink should be sent 0.5 s after the start");
+  NS_TEST_ASSERT_MSG_EQ (log[0].m_devAddr, GetDevAddr (endDevices, 0), "Wrong end device");
+  NS_TEST_ASSERT_MSG_EQ (log[0].m_size, 30, "The size of the log should be the size of the PHYPayload");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)log[0].m_channelIndex, 1, "Wrong channel");
+  NS_TEST_ASSERT_MSG_EQ (log[1].m_time, Seconds (11.0), "Wrong time");
+  NS_TEST_ASSERT_MSG_EQ (log[1].m_devAddr, GetDevAddr (endDevices, 1), "Wrong end device");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)log[1].m_dataRateIndex, 4, "Wrong data rate");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)log[1].m_channelIndex, 2, "868.5 MHz should be channel 2");
+  NS_TEST_ASSERT_MSG_EQ (log[2].m_time, Seconds (11.0), "Uplinks of the same time should be sent at the same time");
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)log[2].m_channelIndex, 1, "868300000 Hz should be channel 1");
+  NS_TEST_ASSERT_MSG_EQ (log[2].m_size, 40, "Wrong size");
+  NS_TEST_ASSERT_MSG_EQ (log[3].m_time, Seconds (12.5), "Wrong time");
+  NS_TEST_ASSERT_MSG_EQ (log[3].m_devAddr, GetDevAddr (endDevices, 3), "Wrong end device");
+  NS_TEST_ASSERT_MSG_EQ (log[4].m_time, Seconds (12.5), "The out of order uplink should be sent with the previous uplink");
+  NS_TEST_ASSERT_MSG_EQ (log[4].m_devAddr, GetDevAddr (endDevices, 4), "Wrong end device");
+
+  Simulator::Destroy ();
+}
+
+// ==============================================================================
+class LoRaWANUplinkReplayBinaryTestCase : public TestCase
+{
+public:
+  LoRaWANUplinkReplayBinaryTestCase ();
+  virtual ~LoRaWANUplinkReplayBinaryTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANUplinkReplayBinaryTestCase::LoRaWANUplinkReplayBinaryTestCase ()
+  : TestCase ("Test the replay of a binary uplink log with a small window")
+{
+}
+
+LoRaWANUplinkReplayBinaryTestCase::~LoRaWANUplinkReplayBinaryTestCase ()
+{
+}
+
+void
+LoRaWANUplinkReplayBinaryTestCase::DoRun (void)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  // 1000 uplinks of 16 bytes do not fit in one window of 4096 bytes
+  const uint32_t nRecords = 1000;
+  const std::string filename = CreateTempDirFilename ("uplinks.bin");
+  std::ofstream bin (filename.c_str (), std::ios::binary);
+  for (uint32_t i = 0; i < nRecords; i++)
+    {
+      LoRaWANUplinkRecord record;
+      record.m_devAddr = 0x26000000 + (i % 10);
+      record.m_timestamp = 1500000000000000LL + i * 500000LL;
+      record.m_size = 13 + i % 20;
+      record.m_dataRateIndex = 5;
+      record.m_channelIndex = i % 3;
+      LoRaWANUplinkLogReader::WriteBinaryRecord (bin, record);
+    }
+  bin.close ();
+
+  // The reader on its own
+  LoRaWANUplinkLogReader reader;
+  NS_TEST_ASSERT_MSG_EQ (reader.Open (filename, LORAWAN_UPLINK_LOG_BINARY, 4096), true, "Unable to open the log");
+  NS_TEST_ASSERT_MSG_EQ (reader.GetFileSize (), nRecords * LoRaWANUplinkLogReader::m_binaryRecordSize, "Wrong file size");
+  LoRaWANUplinkRecord record;
+  uint32_t n = 0;
+  while (reader.Next (record))
+    {
+      NS_TEST_ASSERT_MSG_EQ (record.m_devAddr, 0x26000000 + (n % 10), "Wrong device address");
+      NS_TEST_ASSERT_MSG_EQ (record.m_timestamp, 1500000000000000LL + n * 500000LL, "Wrong timestamp");
+      NS_TEST_ASSERT_MSG_EQ ((uint32_t)record.m_size, 13 + n % 20, "Wrong size");
+      NS_TEST_ASSERT_MSG_EQ ((uint32_t)record.m_channelIndex, n % 3, "Wrong channel");
+      n++;
+    }
+  NS_TEST_ASSERT_MSG_EQ (n, nRecords, "Every record should be read");
+  reader.Close ();
+
+  // The replay, the first 10 device addresses of the log are mapped to the end devices
+  std::vector<SentUplink> log;
+  Ptr<LoRaWANBulkTrafficGenerator> generator = CreateObject<LoRaWANBulkTrafficGenerator> ();
+  CreateEndDevices (10, generator, &log);
+
+  Ptr<LoRaWANUplinkReplay> replay = CreateObject<LoRaWANUplinkReplay> ();
+  replay->SetAttribute ("Filename", StringValue (filename));
+  replay->SetAttribute ("Format", EnumValue (LORAWAN_UPLINK_LOG_BINARY));
+  replay->SetAttribute ("WindowSize", UintegerValue (4096));
+  replay->SetAttribute ("AddressMapping", EnumValue (LORAWAN_REPLAY_MAP_FIRST_SEEN));
+  replay->SetGenerator (generator);
+  replay->Start (Seconds (0.0));
+  replay->Stop (Seconds (250.0));
+  Simulator::Stop (Seconds (300.0));
+  Simulator::Run ();
+
+  // The uplinks at 0, 0.5, ..., 249.5 s
+  NS_TEST_ASSERT_MSG_EQ (replay->GetNInjected (), 500, "Uplinks after the stop should not be sent");
+  NS_TEST_ASSERT_MSG_EQ (replay->GetNDropped (), 0, "No uplinks should be dropped");
+  // The duty cycle of the end devices delays some uplinks, so these are not
+  // all transmitted before the end of the simulation
+  NS_TEST_ASSERT_MSG_EQ (generator->GetNUplinks (), 500, "The uplinks should be sent by the generator");
+  NS_TEST_ASSERT_MSG_EQ (log[0].m_time, Seconds (0.0), "Wrong time of the first uplink");
+  NS_TEST_ASSERT_MSG_EQ (log[0].m_size, 13, "Wrong size of the first uplink");
+
+  Simulator::Destroy ();
+}
+
+// ==============================================================================
+class LoRaWANUplinkLogReaderWindowTestCase : public TestCase
+{
+public:
+  LoRaWANUplinkLogReaderWindowTestCase ();
+  virtual ~LoRaWANUplinkLogReaderWindowTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANUplinkLogReaderWindowTestCase::LoRaWANUplinkLogReaderWindowTestCase ()
+  : TestCase ("Test that lines of a CSV uplink log may cross windows")
+{
+}
+
+LoRaWANUplinkLogReaderWindowTestCase::~LoRaWANUplinkLogReaderWindowTestCase ()
+{
+}
+
+void
+LoRaWANUplinkLogReaderWindowTestCase::DoRun (void)
+{
+  // Lines of 27 to 31 characters end at every offset in a page
+  const uint32_t nRecords = 2000;
+  const std::string filename = CreateTempDirFilename ("window.csv");
+  std::ofstream csv (filename.c_str ());
+  for (uint32_t i = 0; i < nRecords; i++)
+    csv << std::hex << 0x26000000 + i << std::dec << "," << i << "." << (i % 1000) << "," << 13 + i % 100 << ",5," << i % 3 << std::endl;
+  csv.close ();
+
+  LoRaWANUplinkLogReader reader;
+  NS_TEST_ASSERT_MSG_EQ (reader.Open (filename, LORAWAN_UPLINK_LOG_CSV, 1), true, "Unable to open the log");
+  NS_TEST_ASSERT_MSG_EQ ((reader.GetWindowSize () < reader.GetFileSize ()), true, "The log should not fit in one window");
+
+  LoRaWANUplinkRecord record;
+  uint32_t n = 0;
+  while (reader.Next (record))
+    {
+      NS_TEST_ASSERT_MSG_EQ (record.m_devAddr, 0x26000000 + n, "Wrong device address");
+      NS_TEST_ASSERT_MSG_EQ ((uint32_t)record.m_size, 13 + n % 100, "Wrong size");
+      NS_TEST_ASSERT_MSG_EQ ((uint32_t)record.m_channelIndex, n % 3, "Wrong channel");
+      n++;
+    }
+  NS_TEST_ASSERT_MSG_EQ (n, nRecords, "Every line should be read");
+  NS_TEST_ASSERT_MSG_EQ (reader.GetNMalformed (), 0, "No line should be malformed");
+  NS_TEST_ASSERT_MSG_EQ (reader.GetOffset (), reader.GetFileSize (), "The whole log should be read");
+}
+
+// ==============================================================================
+class LoRaWANUplinkReplayTestSuite : public TestSuite
+{
+public:
+  LoRaWANUplinkReplayTestSuite ();
+};
+
+LoRaWANUplinkReplayTestSuite::LoRaWANUplinkReplayTestSuite ()
+  : TestSuite ("lorawan-uplink-replay", UNIT)
+{
+  AddTestCase (new LoRaWANUplinkReplayCsvTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANUplinkReplayBinaryTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANUplinkLogReaderWindowTestCase, TestCase::QUICK);
+}
+
+static LoRaWANUplinkReplayTestSuite lorawanUplinkReplayTestSuite;